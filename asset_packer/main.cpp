@@ -0,0 +1,41 @@
+// Packs the assets into a single file, see `src/stream/asset_pack.h`. Normally this runs from `make asset-pack`.
+// Usage: asset_packer <dir> <output> <paths>...
+//     <dir>      The directory that the paths are relative to. The entries are named by those relative paths.
+//     <output>   The resulting pack, relative to <dir>.
+//     <paths>    Files and directories to pack. Directories are packed recursively. The files with names starting with `_` are skipped, like `ASSETS_IGNORED_PATTERNS` does.
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "program/entry_point.h"
+#include "program/errors.h"
+#include "stream/asset_pack.h"
+#include "utils/filesystem.h"
+
+IMP_MAIN(argc, argv)
+{
+    if (argc < 4)
+        Program::Error("Expected `asset_packer <dir> <output> <paths>...`.");
+
+    std::string dir = argv[1];
+    std::string output = argv[2];
+
+    std::vector<std::string> names;
+    for (int i = 3; i < argc; i++)
+    {
+        Filesystem::TreeNode tree = Filesystem::GetObjectTree(dir + '/' + argv[i], 32);
+        Filesystem::ForEachObject(tree, [&](const Filesystem::TreeNode &node)
+        {
+            if (node.info.category != Filesystem::file || node.name.starts_with('_'))
+                return;
+            std::string name = node.path.substr(dir.size() + 1); // `+ 1` is for `/`.
+            if (name != output)
+                names.push_back(std::move(name));
+        });
+    }
+
+    Stream::AssetPack::Write(dir + '/' + output, dir, names);
+    std::cout << "Packed " << names.size() << " files into `" << dir << '/' << output << "`.\n";
+    return 0;
+}
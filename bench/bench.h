@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "macros/generated.h"
+#include "program/alloc_stats.h"
+#include "program/platform.h"
+#include "utils/clock.h"
+
+// A minimal microbenchmark harness, for the `bench` project.
+// Usage:
+//     BENCHMARK_GROUP( Json )
+//     {
+//         std::string str = ...; // The setup isn't measured.
+//         state.Measure("parse", [&]{Bench::DoNotOptimize(Json(str.c_str(), 64));});
+//     }
+// The results are named `<group>/<case>`, and are printed as one JSON object per line. See `bench/main.cpp` for the command line flags.
+
+namespace Bench
+{
+    // Prevents the compiler from optimizing away the computation of `value`.
+    template <typename T>
+    void DoNotOptimize(const T &value)
+    {
+        #if IMP_PLATFORM_IS(gcc) || IMP_PLATFORM_IS(clang)
+        asm volatile("" : : "r,m"(value) : "memory");
+        #else
+        static const volatile void *sink;
+        sink = &value;
+        #endif
+    }
+
+    struct Result
+    {
+        std::string name;
+        std::uint64_t iterations = 0;
+        double ns_per_iter = 0;
+        double items_per_sec = 0; // Zero if the number of items per iteration wasn't specified.
+        double allocs_per_iter = 0; // Only in the `count_allocs` build mode, otherwise zero.
+    };
+
+    class State
+    {
+      public:
+        struct Options
+        {
+            double min_secs = 0.5; // Each case runs at least this long.
+            std::string filter; // Only the cases with names starting with this run.
+        };
+
+      private:
+        Options options;
+        std::string group;
+        std::function<void(const Result &result)> on_result;
+
+        struct Sample
+        {
+            std::uint64_t ticks = 0;
+            std::uint64_t allocs = 0;
+        };
+
+        // Measures the time and the allocations in `func()`, adds them to `sample`.
+        template <typename F>
+        static void AddToSample(Sample &sample, F &&func)
+        {
+            std::uint64_t allocs = Program::AllocStats::ThisThread().allocs;
+            std::uint64_t begin = Clock::Time();
+            func();
+            sample.ticks += Clock::Time() - begin;
+            sample.allocs += Program::AllocStats::ThisThread().allocs - allocs;
+        }
+
+        // Calls `run(n)` with increasing `n` until it takes at least `options.min_secs`, then reports the result.
+        void MeasureLow(std::string_view name, double items, const std::function<Sample(std::uint64_t n)> &run);
+
+      public:
+        State(Options options, std::function<void(const Result &result)> on_result) : options(std::move(options)), on_result(std::move(on_result)) {}
+
+        // Called by the runner before each group.
+        void SetGroup(std::string_view new_group)
+        {
+            group = new_group;
+        }
+
+        // Returns the full name of a case, `<group>/<name>`.
+        [[nodiscard]] std::string FullName(std::string_view name) const
+        {
+            return group + "/" + std::string(name);
+        }
+
+        // Whether any case in this group can pass the filter. The runner checks this.
+        [[nodiscard]] bool GroupEnabled(std::string_view group_name) const
+        {
+            std::string prefix = std::string(group_name) + "/";
+            return prefix.starts_with(options.filter) || options.filter.starts_with(prefix);
+        }
+
+        // Whether this case passes the filter. `Measure...()` checks this automatically, call it to skip an expensive setup.
+        [[nodiscard]] bool Enabled(std::string_view name) const
+        {
+            return FullName(name).starts_with(options.filter);
+        }
+
+        // Calls `func()` repeatedly and reports the time per call.
+        // `items` is the amount of work per call (e.g. bytes or particles), if specified it's used to report the throughput.
+        template <typename F>
+        void Measure(std::string_view name, F &&func, double items = 0)
+        {
+            MeasureLow(name, items, [&](std::uint64_t n)
+            {
+                Sample sample;
+                AddToSample(sample, [&]{for (std::uint64_t i = 0; i < n; i++) func();});
+                return sample;
+            });
+        }
+
+        // Same, but calls `setup()` before every `batch_size` calls of `func()`, without measuring it.
+        // Use this when `func()` consumes something that must be replenished.
+        template <typename S, typename F>
+        void MeasureBatches(std::string_view name, std::size_t batch_size, S &&setup, F &&func, double items = 0)
+        {
+            MeasureLow(name, items, [&](std::uint64_t n)
+            {
+                Sample sample;
+                for (std::uint64_t i = 0; i < n; i += batch_size)
+                {
+                    setup();
+                    std::uint64_t count = std::min<std::uint64_t>(batch_size, n - i);
+                    AddToSample(sample, [&]{for (std::uint64_t j = 0; j < count; j++) func();});
+                }
+                return sample;
+            });
+        }
+    };
+
+    namespace impl
+    {
+        struct Group
+        {
+            const char *name = nullptr;
+            void (*func)(State &state) = nullptr;
+        };
+
+        [[nodiscard]] inline std::vector<Group> &Groups()
+        {
+            static std::vector<Group> ret;
+            return ret;
+        }
+
+        struct Registrar
+        {
+            Registrar(const char *name, void (*func)(State &state))
+            {
+                Groups().push_back({name, func});
+            }
+        };
+    }
+}
+
+// Defines a group of benchmarks. The body receives `Bench::State &state`.
+#define BENCHMARK_GROUP(name) \
+    static void MA_CAT(BenchGroup_, name)(::Bench::State &state); \
+    [[maybe_unused]] static const ::Bench::impl::Registrar MA_CAT(bench_registrar_, name)(#name, MA_CAT(BenchGroup_, name)); \
+    static void MA_CAT(BenchGroup_, name)([[maybe_unused]] ::Bench::State &state)
@@ -0,0 +1,10 @@
+// `src/game/particles.cpp` is a part of this project, and it needs those globals from `game/main.h`.
+// They're defined in `src/game/main.cpp` in the game, which we can't link.
+
+#include "game/main.h"
+
+const Graphics::ShaderConfig shader_config = Graphics::ShaderConfig::Core();
+
+Render r; // Empty, the particles are never drawn here.
+
+float render_tick_fraction = 1;
@@ -0,0 +1,61 @@
+#include "bench.h"
+
+#include <string>
+
+#include "strings/format.h"
+#include "utils/json.h"
+#include "utils/random.h"
+
+BENCHMARK_GROUP( Json )
+{
+    Random::DefaultGenerator gen(1);
+    Random::DefaultInterfaces ra(gen);
+
+    // Similar to a Tiled map: a few large integer arrays, and small objects with mixed properties.
+    std::string map_str;
+    FMT_APPEND(map_str, R"({{"width":256,"height":256,"tilewidth":12,"tileheight":12,"layers":[)");
+    for (int layer = 0; layer < 3; layer++)
+    {
+        if (layer > 0)
+            map_str += ',';
+        FMT_APPEND(map_str, R"({{"name":"layer{}","type":"tilelayer","visible":true,"opacity":1.0,"data":[)", layer);
+        for (int i = 0; i < 256 * 256; i++)
+        {
+            if (i > 0)
+                map_str += ',';
+            FMT_APPEND(map_str, "{}", ra.i <= 64);
+        }
+        map_str += "]}";
+    }
+    map_str += R"(,{"name":"objects","type":"objectgroup","objects":[)";
+    for (int i = 0; i < 500; i++)
+    {
+        if (i > 0)
+            map_str += ',';
+        FMT_APPEND(map_str, R"({{"id":{},"name":"obj{}","x":{:.3f},"y":{:.3f},"point":true,"properties":[{{"name":"kind","type":"string","value":"secret"}}]}})",
+            i, i, ra.f <= 3072, ra.f <= 3072);
+    }
+    map_str += "]}]}";
+
+    state.Measure("parse_map", [&]{Bench::DoNotOptimize(Json(map_str.c_str(), 64));}, double(map_str.size()));
+
+    // Many small nested objects, no integer arrays.
+    std::string objects_str = "[";
+    for (int i = 0; i < 2000; i++)
+    {
+        if (i > 0)
+            objects_str += ',';
+        FMT_APPEND(objects_str, R"({{"a":{},"b":"string {}","c":[1.5,2.5,{{"d":null,"e":false}}]}})", i, i);
+    }
+    objects_str += "]";
+
+    state.Measure("parse_objects", [&]{Bench::DoNotOptimize(Json(objects_str.c_str(), 64));}, double(objects_str.size()));
+
+    Json map(map_str.c_str(), 64);
+    state.Measure("lookup", [&]
+    {
+        Json::View view = map.GetView();
+        Bench::DoNotOptimize(view["layers"][1]["data"].GetIntArray().size());
+        Bench::DoNotOptimize(view["layers"][3]["objects"][250]["x"].GetReal());
+    });
+}
@@ -0,0 +1,112 @@
+// Microbenchmarks for the framework hot paths. Build and run with `make run-bench`.
+// Flags:
+//     --filter <prefix>      Only run the cases with names (`<group>/<case>`) starting with this, e.g. `Json/` or `Json/parse`.
+//     --min-time <seconds>   The min duration of each case, 0.5 by default.
+//     --list                 Print the case groups and exit.
+// Every result is printed to stdout as a JSON object on a separate line:
+//     {"name":"Json/parse_map","iterations":1000,"ns_per_iter":1234.5,"items_per_sec":0,"allocs_per_iter":0}
+// The allocations are only counted in the `count_allocs` build mode.
+// If a group fails, it prints `{"name":"<group>","error":"..."}` instead, and the exit code is non-zero.
+
+#include "bench.h"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+#include <string_view>
+
+#include "program/entry_point.h"
+#include "program/errors.h"
+#include "strings/escape.h"
+#include "strings/format.h"
+#include "strings/lexical_cast.h"
+
+namespace Bench
+{
+    void State::MeasureLow(std::string_view name, double items, const std::function<Sample(std::uint64_t n)> &run)
+    {
+        if (!Enabled(name))
+            return;
+
+        std::uint64_t min_ticks = Clock::SecondsToTicks(options.min_secs);
+
+        std::uint64_t n = 1;
+        Sample sample = run(n); // This also warms up the caches.
+        while (sample.ticks < min_ticks)
+        {
+            // Aim a bit past the min time, but don't grow too fast, in case the first runs were unusually slow.
+            double scale = sample.ticks ? min_ticks * 1.2 / sample.ticks : 100;
+            n = std::max(n + 1, std::uint64_t(n * std::clamp(scale, 1.5, 100.)));
+            sample = run(n);
+        }
+
+        double secs = Clock::TicksToSeconds(sample.ticks);
+        on_result({
+            .name = FullName(name),
+            .iterations = n,
+            .ns_per_iter = secs * 1e9 / n,
+            .items_per_sec = items > 0 ? items * n / secs : 0,
+            .allocs_per_iter = sample.allocs / double(n),
+        });
+    }
+}
+
+IMP_MAIN(argc, argv)
+{
+    Bench::State::Options options;
+    bool list = false;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc)
+            options.filter = argv[++i];
+        else if (arg == "--min-time" && i + 1 < argc)
+            options.min_secs = Strings::FromString<double>(argv[++i]);
+        else if (arg == "--list")
+            list = true;
+        else
+            Program::Error("Unknown command line argument: `", arg, "`. Expected `--filter <prefix>`, `--min-time <seconds>`, or `--list`.");
+    }
+
+    // The registration order depends on the order of the translation units, so sort for a stable output.
+    std::vector<Bench::impl::Group> groups = Bench::impl::Groups();
+    std::sort(groups.begin(), groups.end(), [](const Bench::impl::Group &a, const Bench::impl::Group &b){return std::string_view(a.name) < std::string_view(b.name);});
+
+    if (list)
+    {
+        for (const Bench::impl::Group &group : groups)
+            std::cout << group.name << '\n';
+        return 0;
+    }
+
+    auto Quote = [](std::string_view str)
+    {
+        return '"' + Strings::Escape(str, Strings::EscapeFlags::escape_double_quotes) + '"';
+    };
+
+    Bench::State state(options, [&](const Bench::Result &result)
+    {
+        std::cout << FMT("{{\"name\":{},\"iterations\":{},\"ns_per_iter\":{:.6g},\"items_per_sec\":{:.6g},\"allocs_per_iter\":{:.6g}}}\n",
+            Quote(result.name), result.iterations, result.ns_per_iter, result.items_per_sec, result.allocs_per_iter) << std::flush;
+    });
+
+    bool failed = false;
+    for (const Bench::impl::Group &group : groups)
+    {
+        if (!state.GroupEnabled(group.name))
+            continue;
+        state.SetGroup(group.name);
+        try
+        {
+            group.func(state);
+        }
+        catch (std::exception &e)
+        {
+            failed = true;
+            std::cout << FMT("{{\"name\":{},\"error\":{}}}\n", Quote(group.name), Quote(e.what())) << std::flush;
+        }
+    }
+
+    return failed;
+}
@@ -0,0 +1,50 @@
+#include "game/particles.h"
+
+#include "bench.h"
+
+BENCHMARK_GROUP( Particles )
+{
+    constexpr int count = 4096;
+
+    Random::DefaultGenerator gen(1);
+    Random::DefaultInterfaces ra(gen);
+
+    // Spawns long-living particles around the camera, like the fire effects do.
+    auto Spawn = [&](ParticleController &controller)
+    {
+        controller.Clear();
+        for (int i = 0; i < count; i++)
+        {
+            Particle par;
+            par.s.pos = -fvec2(screen_size / 2) <= ra.fvec2 <= fvec2(screen_size / 2);
+            par.s.vel = fvec2::dir(ra.angle(), 0.5 <= ra.f <= 1);
+            par.s.acc = fvec2(0, -0.01f);
+            par.damp = 0.01f;
+            par.color = fvec3(1, 0.5f, 0);
+            par.end_color = fvec3(1, 0, 0);
+            par.end_alpha = 0;
+            par.life = 1'000'000; // Not removed while measuring.
+            controller.Add(par);
+        }
+    };
+
+    ParticleController plain(false);
+    Spawn(plain);
+    state.Measure("tick", [&]{plain.BeginTick(); plain.Tick(ivec2(0));}, count);
+
+    // The rewinding needs some history, so the history is recreated before each batch.
+    constexpr int history_len = 64;
+    ParticleController rewindable(true);
+    auto MakeHistory = [&]
+    {
+        Spawn(rewindable);
+        for (int i = 0; i < history_len; i++)
+        {
+            rewindable.BeginTick();
+            rewindable.Tick(ivec2(0));
+        }
+    };
+    // The particles don't die, so the history would grow without bound. Respawn them periodically.
+    state.MeasureBatches("tick_with_timeline", 256, [&]{Spawn(rewindable);}, [&]{rewindable.BeginTick(); rewindable.Tick(ivec2(0));}, count);
+    state.MeasureBatches("reverse_tick", history_len - 1, MakeHistory, [&]{rewindable.BeginTick(); rewindable.ReverseTick();}, count);
+}
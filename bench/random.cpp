@@ -0,0 +1,27 @@
+#include "bench.h"
+
+#include <array>
+#include <cstdint>
+
+#include "utils/mat.h"
+#include "utils/random.h"
+
+BENCHMARK_GROUP( Random )
+{
+    Random::DefaultGenerator gen(1);
+    Random::DefaultInterfaces ra(gen);
+
+    state.Measure("generator", [&]{Bench::DoNotOptimize(gen());});
+    state.Measure("squares64", [&, counter = std::uint64_t(0)]() mutable {Bench::DoNotOptimize(Random::Squares64(counter++, 0x548c9decbce65297));});
+
+    state.Measure("int", [&]{Bench::DoNotOptimize(10 <= ra.i <= 1000);});
+    state.Measure("int_abs", [&]{Bench::DoNotOptimize(ra.i.abs() <= 1000);});
+    state.Measure("float", [&]{Bench::DoNotOptimize(-1 <= ra.f <= 1);});
+    state.Measure("fvec2", [&]{Bench::DoNotOptimize(-1 <= ra.fvec2 <= 1);});
+    state.Measure("fvec3", [&]{Bench::DoNotOptimize(fvec3(0) <= ra.fvec3 <= fvec3(1, 2, 3));});
+    state.Measure("choose", [&]{Bench::DoNotOptimize(ra.choose({1, 2, 3, 4, 5}));});
+    state.Measure("index_weighted", [&]{Bench::DoNotOptimize(ra.index_weighted({1.f, 2.f, 3.f, 4.f}));});
+
+    std::array<float, 1024> floats{};
+    state.Measure("fill_float", [&]{ra.f.fill(floats, 0, 1); Bench::DoNotOptimize(floats);}, double(floats.size()));
+}
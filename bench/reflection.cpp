@@ -0,0 +1,64 @@
+#include "bench.h"
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "reflection/full.h"
+#include "reflection/short_macros.h"
+#include "strings/format.h"
+#include "utils/mat.h"
+#include "utils/random.h"
+
+namespace
+{
+    REFL_SIMPLE_STRUCT( Entity
+        REFL_DECL(std::string) name
+        REFL_DECL(fvec2 REFL_INIT{}) pos
+        REFL_DECL(ivec3 REFL_INIT{}) color
+        REFL_DECL(std::optional<int>) target
+        REFL_DECL(std::vector<float>) weights
+    )
+
+    REFL_SIMPLE_STRUCT( Level
+        REFL_DECL(std::string) title
+        REFL_DECL(std::vector<Entity>) entities
+        REFL_DECL(std::map<std::string, int>) counters
+        REFL_DECL(std::vector<std::uint8_t>) tiles
+    )
+}
+
+BENCHMARK_GROUP( Refl )
+{
+    Random::DefaultGenerator gen(1);
+    Random::DefaultInterfaces ra(gen);
+
+    Level level;
+    level.title = "Benchmark level";
+    for (int i = 0; i < 1000; i++)
+    {
+        Entity &entity = level.entities.emplace_back();
+        entity.name = FMT("entity_{}", i);
+        entity.pos = -1000 <= ra.fvec2 <= 1000;
+        entity.color = 0 <= ra.ivec3 <= 255;
+        if (ra.i <= 1)
+            entity.target = ra.i <= 1000;
+        for (int j = 0; j < 4; j++)
+            entity.weights.push_back(ra.f <= 1);
+    }
+    for (int i = 0; i < 100; i++)
+        level.counters.try_emplace(FMT("counter_{}", i), i);
+    level.tiles.resize(128 * 128);
+    for (std::uint8_t &tile : level.tiles)
+        tile = ra.i <= 16;
+
+    std::string text = Refl::ToString(level);
+    std::vector<std::uint8_t> binary = Refl::ToBinary<std::vector<std::uint8_t>>(level);
+
+    state.Measure("to_string", [&]{Bench::DoNotOptimize(Refl::ToString(level));}, double(text.size()));
+    state.Measure("from_string", [&]{Bench::DoNotOptimize(Refl::FromString<Level>(text));}, double(text.size()));
+    state.Measure("to_binary", [&]{Bench::DoNotOptimize(Refl::ToBinary<std::vector<std::uint8_t>>(level));}, double(binary.size()));
+    state.Measure("from_binary", [&]{Bench::DoNotOptimize(Refl::FromBinary<Level>(Stream::ReadOnlyData::mem_reference(binary)));}, double(binary.size()));
+}
@@ -0,0 +1,91 @@
+#include "bench.h"
+
+#include <cstddef>
+
+#include "gameutils/render.h"
+#include "graphics/complete.h"
+#include "interface/window.h"
+#include "macros/adjust.h"
+#include "reflection/full.h"
+#include "reflection/short_macros.h"
+#include "utils/mat.h"
+
+extern const Graphics::ShaderConfig shader_config; // See `game_globals.cpp`.
+
+namespace
+{
+    REFL_SIMPLE_STRUCT( Attribs
+        REFL_DECL(fvec2) pos
+        REFL_DECL(fvec4) color
+    )
+
+    REFL_SIMPLE_STRUCT( Uniforms
+        REFL_DECL(Graphics::Uniform<fmat4> REFL_ATTR Graphics::Vert) matrix
+    )
+
+    constexpr const char *vertex_source = R"(
+varying vec4 v_color;
+void main()
+{
+    gl_Position = u_matrix * vec4(a_pos, 0, 1);
+    v_color = a_color;
+})";
+
+    constexpr const char *fragment_source = R"(
+varying vec4 v_color;
+void main()
+{
+    gl_FragColor = v_color;
+})";
+}
+
+BENCHMARK_GROUP( Render )
+{
+    // Those need an OpenGL context. The window is never shown.
+    Interface::Window window("Benchmarks", ivec2(256), Interface::windowed, adjust_(Interface::WindowSettings{}, hidden = true, vsync = Interface::VSync::disabled));
+
+    { // The plain queue. This measures the filling together with the upload, which happens on every flush.
+        Uniforms uni;
+        Graphics::Shader shader("Benchmark", shader_config, Graphics::ShaderPreferences{}, Meta::tag<Attribs>{}, uni, vertex_source, fragment_source);
+        shader.Bind();
+        uni.matrix = fmat4();
+
+        constexpr std::size_t queue_size = 0x2000;
+        Graphics::SimpleRenderQueue<Attribs, 3> queue(queue_size, Graphics::StreamingMode::round_robin);
+        Attribs a, b, c;
+        a.pos = fvec2(0, 0);
+        b.pos = fvec2(1, 0);
+        c.pos = fvec2(0, 1);
+        a.color = b.color = c.color = fvec4(1);
+
+        state.Measure("simple_queue_fill", [&]
+        {
+            for (std::size_t i = 0; i < queue_size; i++)
+                queue.Add(a, b, c);
+            queue.Flush();
+        }, double(queue_size));
+    }
+
+    { // The main renderer. The queue flushes itself when full.
+        for (Render::VertexFormat format : {Render::VertexFormat::full, Render::VertexFormat::packed})
+        {
+            Render render(0x2000, shader_config, Graphics::StreamingMode::round_robin, format);
+            const char *suffix = format == Render::VertexFormat::packed ? "_packed" : "";
+
+            int i = 0;
+            state.Measure(FMT("quad{}", suffix), [&]
+            {
+                render.iquad(ivec2(i++ % 256, 0), ivec2(16)).color(fvec3(1, 0.5f, 0)).alpha(0.5f);
+            });
+            state.Measure(FMT("quad_centered_rotated{}", suffix), [&]
+            {
+                render.fquad(fvec2(i++ % 256, 0), fvec2(16)).center().rotate(0.5f).color(fvec3(1, 0.5f, 0));
+            });
+            state.Measure(FMT("triangle{}", suffix), [&]
+            {
+                render.ftriangle(fvec2(0), fvec2(i++ % 256, 0), fvec2(0, 16)).color(fvec3(0, 0.5f, 1));
+            });
+            render.Finish();
+        }
+    }
+}
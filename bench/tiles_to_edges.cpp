@@ -0,0 +1,64 @@
+#include "bench.h"
+
+#include <cstddef>
+
+#include "gameutils/tiles_to_edges.h"
+#include "reflection/full.h"
+#include "utils/multiarray.h"
+#include "utils/random.h"
+
+BENCHMARK_GROUP( TilesToEdges )
+{
+    // A full square, and the four half-squares.
+    auto tileset_params = Refl::FromString<GameUtils::TilesToEdges::TileSet::Params>(R"(
+        {
+            tile_size = (16,16),
+            vertices = [(0,0), (16,0), (16,16), (0,16)],
+            tiles = [
+                [],
+                [[0,1,2,3]],
+                [[0,1,3]],
+                [[0,1,2]],
+                [[1,2,3]],
+                [[0,2,3]],
+            ],
+        }
+    )");
+    GameUtils::TilesToEdges::TileSet tileset(tileset_params);
+
+    Random::DefaultGenerator gen(1);
+    Random::DefaultInterfaces ra(gen);
+
+    // Mostly solid blobs with some slopes, similar to the level maps.
+    Array2D<std::size_t> tiles(index_vec2(256));
+    for (index_vec2 pos : vector_range(tiles.size()))
+    {
+        bool solid = (pos.x / 8 + pos.y / 8) % 3 == 0 || (ra.i <= 9) == 0;
+        bool slope = (ra.i <= 7) == 0;
+        tiles.unsafe_at(pos) = !solid ? 0 : slope ? std::size_t(2 <= ra.i <= 5) : 1;
+    }
+
+    double num_tiles = double(tiles.size().prod());
+
+    state.Measure("convert", [&]
+    {
+        std::size_t num_vertices = 0;
+        GameUtils::TilesToEdges::Params params;
+        params.tileset = &tileset;
+        params.tiles = tiles;
+        params.output_vertex = [&](ivec2, bool){num_vertices++;};
+        GameUtils::TilesToEdges::Convert(params);
+        Bench::DoNotOptimize(num_vertices);
+    }, num_tiles);
+
+    state.Measure("convert_to_loops", [&]{Bench::DoNotOptimize(GameUtils::TilesToEdges::ConvertToLoops(tileset, tiles));}, num_tiles);
+
+    GameUtils::TilesToEdges::IncrementalConverter converter(tileset, tiles);
+    (void)converter.Update(); // The first update traces the whole map.
+    state.Measure("incremental_set_tile", [&]
+    {
+        index_vec2 pos = index_vec2(ra.index(tiles.size().x), ra.index(tiles.size().y));
+        converter.SetTile(pos, converter.Tiles().safe_nonthrowing_at(pos) ? 0 : 1);
+        Bench::DoNotOptimize(converter.Update());
+    });
+}
@@ -0,0 +1,46 @@
+#include "bench.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "strings/format.h"
+#include "utils/random.h"
+#include "utils/transitive_closure.h"
+
+BENCHMARK_GROUP( TransitiveClosure )
+{
+    Random::DefaultGenerator gen(1);
+    Random::DefaultInterfaces ra(gen);
+
+    // A random graph with a few cycles. The edges of each node must be sorted, see `TransitiveClosure::func_t`.
+    auto MakeGraph = [&](std::size_t n, int edges_per_node)
+    {
+        std::vector<std::vector<std::size_t>> ret(n);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            for (int j = 0; j < edges_per_node; j++)
+            {
+                // Mostly point backwards, so the components stay small.
+                std::size_t target = ra.i <= 9 ? std::size_t(ra.index(n)) : std::size_t(ra.index(i + 1));
+                ret[i].push_back(target);
+            }
+            std::sort(ret[i].begin(), ret[i].end());
+            ret[i].erase(std::unique(ret[i].begin(), ret[i].end()), ret[i].end());
+        }
+        return ret;
+    };
+
+    for (std::size_t n : {100, 1000})
+    {
+        std::vector<std::vector<std::size_t>> graph = MakeGraph(n, 3);
+        auto ForEachEdge = [&](std::size_t a, TransitiveClosure::next_func_t func)
+        {
+            for (std::size_t b : graph[a])
+                func(b);
+        };
+
+        state.Measure(FMT("compute_{}", n), [&]{Bench::DoNotOptimize(TransitiveClosure::Compute(n, ForEachEdge));}, double(n));
+        state.Measure(FMT("compute_bits_{}", n), [&]{Bench::DoNotOptimize(TransitiveClosure::Compute(n, ForEachEdge, TransitiveClosure::bits | TransitiveClosure::no_next_lists));}, double(n));
+    }
+}
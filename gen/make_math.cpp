@@ -7,7 +7,7 @@
 #include <sstream>
 #include <type_traits>
 
-#define VERSION "3.3.3"
+#define VERSION "3.4.0"
 
 #pragma GCC diagnostic ignored "-Wpragmas" // Silence GCC warning about the next line disabling a warning that GCC doesn't have.
 #pragma GCC diagnostic ignored "-Wstring-plus-int" // Silence clang warning about `1+R"()"` pattern.
@@ -195,11 +195,24 @@ int main(int argc, char **argv)
             #include <cstdint>
             #include <istream>
             #include <ostream>
+            #include <span>
             #include <tuple>
             #include <type_traits>
             #include <utility>
         )");
         next_line();
+
+        output(1+R"(
+            // Define `MATH_NO_SIMD` to disable the SSE and NEON code paths.
+            #if !defined(MATH_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+            #define MATH_IMPL_SSE
+            #include <xmmintrin.h>
+            #elif !defined(MATH_NO_SIMD) && defined(__ARM_NEON) && defined(__aarch64__)
+            #define MATH_IMPL_NEON
+            #include <arm_neon.h>
+            #endif
+        )");
+        next_line();
     }
 
     output("// Vectors and matrices\n");
@@ -1249,6 +1262,74 @@ int main(int argc, char **argv)
 
                 next_line();
 
+                decorative_section("simd", []
+                {
+                    output(1+R"(
+                        // The SIMD versions of the most common `float` operations, used by the operators below when possible.
+                        // They add the products in the same order as the scalar code, so the results are the same.
+                        #if defined(MATH_IMPL_SSE) || defined(MATH_IMPL_NEON)
+                        template <typename A, typename B> inline constexpr bool impl_simd_available = std::is_same_v<A, float> && std::is_same_v<B, float>;
+                        #else
+                        template <typename A, typename B> inline constexpr bool impl_simd_available = false;
+                        #endif
+
+                        #if defined(MATH_IMPL_SSE)
+                        using impl_simd_float4 = __m128;
+                        [[nodiscard]] inline impl_simd_float4 impl_simd_load(const vec4<float> &v) {return _mm_loadu_ps(&v.x);}
+                        [[nodiscard]] inline impl_simd_float4 impl_simd_load2x2(const vec2<float> *v) {return _mm_loadu_ps(&v->x);} // Two consecutive vectors.
+                        [[nodiscard]] inline impl_simd_float4 impl_simd_splat(float x) {return _mm_set1_ps(x);}
+                        [[nodiscard]] inline impl_simd_float4 impl_simd_repeat2(vec2<float> v) {return _mm_setr_ps(v.x, v.y, v.x, v.y);}
+                        [[nodiscard]] inline impl_simd_float4 impl_simd_even(impl_simd_float4 v) {return _mm_shuffle_ps(v, v, _MM_SHUFFLE(2,2,0,0));} // `x0 x0 x1 x1`.
+                        [[nodiscard]] inline impl_simd_float4 impl_simd_odd(impl_simd_float4 v) {return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3,3,1,1));} // `y0 y0 y1 y1`.
+                        [[nodiscard]] inline impl_simd_float4 impl_simd_add(impl_simd_float4 a, impl_simd_float4 b) {return _mm_add_ps(a, b);}
+                        [[nodiscard]] inline impl_simd_float4 impl_simd_mul(impl_simd_float4 a, impl_simd_float4 b) {return _mm_mul_ps(a, b);}
+                        inline void impl_simd_store(vec4<float> &dst, impl_simd_float4 v) {_mm_storeu_ps(&dst.x, v);}
+                        inline void impl_simd_store2x2(vec2<float> *dst, impl_simd_float4 v) {_mm_storeu_ps(&dst->x, v);}
+                        #elif defined(MATH_IMPL_NEON)
+                        using impl_simd_float4 = float32x4_t;
+                        [[nodiscard]] inline impl_simd_float4 impl_simd_load(const vec4<float> &v) {return vld1q_f32(&v.x);}
+                        [[nodiscard]] inline impl_simd_float4 impl_simd_load2x2(const vec2<float> *v) {return vld1q_f32(&v->x);} // Two consecutive vectors.
+                        [[nodiscard]] inline impl_simd_float4 impl_simd_splat(float x) {return vdupq_n_f32(x);}
+                        [[nodiscard]] inline impl_simd_float4 impl_simd_repeat2(vec2<float> v) {float32x2_t h = vld1_f32(&v.x); return vcombine_f32(h, h);}
+                        [[nodiscard]] inline impl_simd_float4 impl_simd_even(impl_simd_float4 v) {return vtrn1q_f32(v, v);} // `x0 x0 x1 x1`.
+                        [[nodiscard]] inline impl_simd_float4 impl_simd_odd(impl_simd_float4 v) {return vtrn2q_f32(v, v);} // `y0 y0 y1 y1`.
+                        [[nodiscard]] inline impl_simd_float4 impl_simd_add(impl_simd_float4 a, impl_simd_float4 b) {return vaddq_f32(a, b);}
+                        [[nodiscard]] inline impl_simd_float4 impl_simd_mul(impl_simd_float4 a, impl_simd_float4 b) {return vmulq_f32(a, b);} // Not `vfmaq_f32()`, to match the scalar code.
+                        inline void impl_simd_store(vec4<float> &dst, impl_simd_float4 v) {vst1q_f32(&dst.x, v);}
+                        inline void impl_simd_store2x2(vec2<float> *dst, impl_simd_float4 v) {vst1q_f32(&dst->x, v);}
+                        #endif
+
+                        #if defined(MATH_IMPL_SSE) || defined(MATH_IMPL_NEON)
+                        // Returns `a.x * x + a.y * y + a.z * z + a.w * w`, where `a.?` are the matrix columns.
+                        [[nodiscard]] inline impl_simd_float4 impl_simd_combine_columns(const mat4x4<float> &a, float x, float y, float z, float w)
+                        {
+                            impl_simd_float4 ret = impl_simd_mul(impl_simd_load(a.x), impl_simd_splat(x));
+                            ret = impl_simd_add(ret, impl_simd_mul(impl_simd_load(a.y), impl_simd_splat(y)));
+                            ret = impl_simd_add(ret, impl_simd_mul(impl_simd_load(a.z), impl_simd_splat(z)));
+                            ret = impl_simd_add(ret, impl_simd_mul(impl_simd_load(a.w), impl_simd_splat(w)));
+                            return ret;
+                        }
+                        [[nodiscard]] inline vec4<float> impl_simd_mul(const mat4x4<float> &a, const vec4<float> &b)
+                        {
+                            vec4<float> ret;
+                            impl_simd_store(ret, impl_simd_combine_columns(a, b.x, b.y, b.z, b.w));
+                            return ret;
+                        }
+                        [[nodiscard]] inline mat4x4<float> impl_simd_mul(const mat4x4<float> &a, const mat4x4<float> &b)
+                        {
+                            mat4x4<float> ret;
+                            impl_simd_store(ret.x, impl_simd_combine_columns(a, b.x.x, b.x.y, b.x.z, b.x.w));
+                            impl_simd_store(ret.y, impl_simd_combine_columns(a, b.y.x, b.y.y, b.y.z, b.y.w));
+                            impl_simd_store(ret.z, impl_simd_combine_columns(a, b.z.x, b.z.y, b.z.z, b.z.w));
+                            impl_simd_store(ret.w, impl_simd_combine_columns(a, b.w.x, b.w.y, b.w.z, b.w.w));
+                            return ret;
+                        }
+                        #endif
+                    )");
+                });
+
+                next_line();
+
                 decorative_section("matrix multiplication", [&]
                 {
                     auto Matrix = [&](int x, int y, std::string t) -> std::string
@@ -1278,7 +1359,10 @@ int main(int argc, char **argv)
                     {
                         if (w2 == 1 && h1 == 1) // This disables generation of `vec * vec` templates (dot products), which would conflict with member-wise multiplication.
                             continue;
-                        output("template <typename A, typename B> [[nodiscard]] constexpr ",Matrix(w2,h1,"larger_t<A,B>")," operator*(const ",Matrix(w1h2,h1,"A")," &a, const ",Matrix(w2,w1h2,"B")," &b) {return {");
+                        output("template <typename A, typename B> [[nodiscard]] constexpr ",Matrix(w2,h1,"larger_t<A,B>")," operator*(const ",Matrix(w1h2,h1,"A")," &a, const ",Matrix(w2,w1h2,"B")," &b) {");
+                        if (h1 == 4 && w1h2 == 4 && (w2 == 1 || w2 == 4))
+                            output("if constexpr (impl_simd_available<A,B>) {if (!std::is_constant_evaluated()) return impl_simd_mul(a, b);} ");
+                        output("return {");
                         for (int y = 0; y < h1; y++)
                         for (int x = 0; x < w2; x++)
                         {
@@ -1976,6 +2060,84 @@ int main(int argc, char **argv)
 
         next_line();
 
+        section("inline namespace Batch // Transforming arrays of points", []
+        {
+            output(1+R"(
+                // Writes `(m * in[i].to_vec3(1)).to_vec2()` to `out[i]`. `out` must be at least as large as `in`, and can be the same array.
+                // Uses SIMD for `float` if possible, two points at a time.
+                template <typename T> constexpr void transform_points(const mat3<T> &m, std::span<const vec2<std::type_identity_t<T>>> in, std::span<vec2<std::type_identity_t<T>>> out)
+                {
+                    std::size_t i = 0;
+                    #if defined(MATH_IMPL_SSE) || defined(MATH_IMPL_NEON)
+                    if constexpr (impl_simd_available<T,T>)
+                    {
+                        if (!std::is_constant_evaluated())
+                        {
+                            auto c0 = impl_simd_repeat2(m.x.to_vec2()), c1 = impl_simd_repeat2(m.y.to_vec2()), c2 = impl_simd_repeat2(m.z.to_vec2());
+                            for (; i + 2 <= in.size(); i += 2)
+                            {
+                                auto p = impl_simd_load2x2(in.data() + i);
+                                impl_simd_store2x2(out.data() + i, impl_simd_add(impl_simd_add(impl_simd_mul(c0, impl_simd_even(p)), impl_simd_mul(c1, impl_simd_odd(p))), c2));
+                            }
+                        }
+                    }
+                    #endif
+                    for (; i < in.size(); i++)
+                    $   out[i] = (m * in[i].to_vec3(1)).to_vec2();
+                }
+
+                // Writes `(m * in[i].to_vec4(1)).to_vec3()` to `out[i]`. `out` must be at least as large as `in`, and can be the same array.
+                // Uses SIMD for `float` if possible.
+                template <typename T> constexpr void transform_points(const mat4<T> &m, std::span<const vec3<std::type_identity_t<T>>> in, std::span<vec3<std::type_identity_t<T>>> out)
+                {
+                    #if defined(MATH_IMPL_SSE) || defined(MATH_IMPL_NEON)
+                    if constexpr (impl_simd_available<T,T>)
+                    {
+                        if (!std::is_constant_evaluated())
+                        {
+                            for (std::size_t i = 0; i < in.size(); i++)
+                            {
+                                vec4<float> result;
+                                impl_simd_store(result, impl_simd_combine_columns(m, in[i].x, in[i].y, in[i].z, 1));
+                                out[i] = result.to_vec3();
+                            }
+                            return;
+                        }
+                    }
+                    #endif
+                    for (std::size_t i = 0; i < in.size(); i++)
+                    $   out[i] = (m * in[i].to_vec4(1)).to_vec3();
+                }
+            )");
+
+            next_line();
+
+            output(1+R"(
+                // Simple kernels over arrays, for the structure-of-arrays code. They are written to be auto-vectorized.
+                // They are not templates, to allow implicit conversions to spans. All spans must have the same size.
+            )");
+
+            for (std::string t : {"float", "double"})
+            for (int d = 2; d <= 4; d++)
+            {
+                std::string v = make_str("vec",d,"<",t,">");
+
+                next_line();
+                output("// `dst[i] += src[i]`.\n");
+                output("constexpr void add_to(std::span<",v,"> dst, std::span<const ",v,"> src) {for (std::size_t i = 0; i < dst.size(); i++) dst[i] += src[i];}\n");
+                output("// `dst[i] += src[i] * factor`.\n");
+                output("constexpr void add_scaled_to(std::span<",v,"> dst, std::span<const ",v,"> src, ",t," factor) {for (std::size_t i = 0; i < dst.size(); i++) dst[i] += src[i] * factor;}\n");
+                output("// `pos[i] += vel[i]; vel[i] += acc[i]; vel[i] *= 1 - damp[i]`.\n");
+                output("constexpr void integrate_damped(std::span<",v,"> pos, std::span<",v,"> vel, std::span<const ",v,"> acc, std::span<const ",t,"> damp) {for (std::size_t i = 0; i < pos.size(); i++) {pos[i] += vel[i]; vel[i] += acc[i]; vel[i] *= 1 - damp[i];}}\n");
+                output("// `out[i] = mix(factor, a[i], b[i])`. `out` can be the same as `a` or `b`.\n");
+                output("constexpr void mix_arrays(",t," factor, std::span<const ",v,"> a, std::span<const ",v,"> b, std::span<",v,"> out) {for (std::size_t i = 0; i < out.size(); i++) out[i] = mix(factor, a[i], b[i]);}\n");
+                output("// `out[i] = (abs(points[i] - center) > half_size).any()`, i.e. 1 if the point is outside of the box, 0 otherwise.\n");
+                output("constexpr void mask_outside(std::span<const ",v,"> points, ",v," center, ",v," half_size, std::span<std::uint8_t> out) {for (std::size_t i = 0; i < out.size(); i++) out[i] = (abs(points[i] - center) > half_size).any();}\n");
+            }
+        });
+
+        next_line();
+
         section("namespace Export", []
         {
             output(1+R"(
@@ -1983,6 +2145,7 @@ int main(int argc, char **argv)
                 using Vector::mat; // ...the overloaded operators into the global namespace, mostly for better error messages and build speed.
                 using namespace Alias; // Convenient type aliases.
                 using namespace Common; // Common functions.
+                using namespace Batch; // Transforming arrays of points.
 
                 // Common types.
                 using std::int8_t;
@@ -22,9 +22,31 @@ $(Mode)_proj_win_subsystem := -mwindows
 
 $(call NewMode,profile)
 $(Mode)COMMON_FLAGS := -O3 -pg
+$(Mode)CXXFLAGS := -DNDEBUG -DIMP_STARTUP_TRACE # See `src/gameutils/startup_trace.h`.
+$(Mode)_proj_win_subsystem := -mwindows
+
+# Profile-guided optimization. `make pgo-profile` builds in the `pgo_gen` mode and replays `PGO_SCENARIO` to collect the profile, then build in the `pgo_use` mode.
+# The paths are relative to the project directory, since that's where both the compiler and `pgo-profile` run.
+PGO_SCENARIO := pgo/scenario.rec
+_pgo_raw_dir := pgo/raw
+_pgo_profdata := pgo/flameline.profdata
+
+$(call NewMode,pgo_gen)
+$(Mode)COMMON_FLAGS := -O3 -fprofile-instr-generate=$(_pgo_raw_dir)/%p.profraw
+$(Mode)CXXFLAGS := -DNDEBUG
+
+$(call NewMode,pgo_use)
+$(Mode)COMMON_FLAGS := -O3 -fprofile-instr-use=$(_pgo_profdata)
+$(Mode)_proj_commonflags := -flto
 $(Mode)CXXFLAGS := -DNDEBUG
+$(Mode)LDFLAGS := -s
 $(Mode)_proj_win_subsystem := -mwindows
 
+# Counts the heap allocations, see `src/program/alloc_stats.h`.
+$(call NewMode,count_allocs)
+$(Mode)COMMON_FLAGS := -O3
+$(Mode)CXXFLAGS := -DNDEBUG -DIMP_COUNT_ALLOCATIONS
+
 $(call NewMode,sanitize_address)
 $(Mode)COMMON_FLAGS := -g -fsanitize=address
 $(Mode)CXXFLAGS := -D_GLIBCXX_DEBUG
@@ -66,10 +88,50 @@ ifeq ($(TARGET_OS),windows)
 $(call ProjectSetting,sources,src/icon.ico)
 endif
 
+# Microbenchmarks for the framework, see `bench/main.cpp`. Everything except the game itself, plus the particles.
+$(call Project,exe,bench)
+$(call ProjectSetting,source_dirs,bench lib $(filter-out src/game,$(wildcard src/*)))
+$(call ProjectSetting,sources,src/game/particles.cpp)
+$(call ProjectSetting,common_flags,$(_proj_commonflags))
+$(call ProjectSetting,cxxflags,$(_proj_cxxflags))
+# Without `-mwindows`, since the results go to the console.
+$(call ProjectSetting,ldflags,$(filter-out $(_proj_win_subsystem),$(_proj_ldflags)))
+$(call ProjectSetting,flags_func,_file_cxxflags)
+$(call ProjectSetting,pch,src/game/*;bench/particles.cpp;bench/game_globals.cpp->src/game/master.hpp)
+$(call ProjectSetting,libs,*)
+$(call ProjectSetting,bad_lib_flags,-Dmain=%>>>-DIMP_ENTRY_POINT_OVERRIDE=%)
+
+# Packs the assets into a single file, see `asset_packer/main.cpp`.
+$(call Project,exe,asset_packer)
+$(call ProjectSetting,source_dirs,asset_packer lib $(filter-out src/game,$(wildcard src/*)))
+$(call ProjectSetting,common_flags,$(_proj_commonflags))
+$(call ProjectSetting,cxxflags,$(_proj_cxxflags))
+$(call ProjectSetting,ldflags,$(filter-out $(_proj_win_subsystem),$(_proj_ldflags)))
+$(call ProjectSetting,flags_func,_file_cxxflags)
+$(call ProjectSetting,libs,*)
+$(call ProjectSetting,bad_lib_flags,-Dmain=%>>>-DIMP_ENTRY_POINT_OVERRIDE=%)
+
 src/icon.ico: $(wildcard src/icon_*.png)
 	$(info [Png to icon] $@)
 	@convert $^ $@
 
+# Collects the profile for the `pgo_use` mode. Record the scenario with `--record`, preferably with a lot of rewinding. See `--benchmark` in `src/game/main.cpp`.
+.PHONY: pgo-profile
+pgo-profile:
+	$(if $(wildcard $(PGO_SCENARIO)),,$(error Can't find the PGO scenario `$(PGO_SCENARIO)`, record it with `--record $(PGO_SCENARIO)`))
+	@$(MAKE) --no-print-directory MODE=pgo_gen build-flameline
+	@echo '[PGO] Replaying `$(PGO_SCENARIO)`'
+	@rm -rf $(_pgo_raw_dir)
+	@$(BIN_DIR)/$(TARGET_OS)/pgo_gen/$(PREFIX_exe)flameline$(EXT_exe) --benchmark $(PGO_SCENARIO)
+	@echo '[PGO] Merging the profile into `$(_pgo_profdata)`'
+	@$(call find_versioned_tool,llvm-profdata) merge -o $(_pgo_profdata) $(_pgo_raw_dir)/*.profraw
+
+# Packs the assets copied next to the executable into `assets.pack`, which the game reads instead of the loose files. See `src/stream/asset_pack.h`.
+# Re-run this after changing the assets, otherwise the game keeps using the old pack.
+.PHONY: asset-pack
+asset-pack: build-asset_packer build-flameline
+	@$(BIN_DIR)/$(os_mode_string)/$(PREFIX_exe)asset_packer$(EXT_exe) $(BIN_DIR)/$(os_mode_string) assets.pack assets map.json
+
 
 # --- Dependencies ---
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <utility>
 
@@ -58,6 +59,16 @@ namespace Audio
             return data.handle;
         }
 
+        // The memory allocated by the audio library for the data, for `Refl::EstimateMemory()`.
+        [[nodiscard]] std::size_t EstimateOwnedMemory() const
+        {
+            if (!*this)
+                return 0;
+            ALint size = 0;
+            alGetBufferi(data.handle, AL_SIZE, &size);
+            return std::size_t(size);
+        }
+
         // Sets the data from memory, with the format specified at runtime.
         // Note that the length of the data is measured in blocks. Each block consists of `channel_count` samples, each sample having `resolution` bits in it.
         void SetData(int sampling_rate, Channels channel_count, BitResolution resolution, std::size_t block_count, const std::uint8_t *source = nullptr)
@@ -3,9 +3,13 @@
 #include "audio/buffer.h"
 #include "audio/context.h"
 #include "audio/errors.h"
+#include "audio/mixer.h"
+#include "audio/ogg_decoder.h"
 #include "audio/openal.h"
 #include "audio/parameters.h"
+#include "audio/sound_cache.h"
 #include "audio/sound_loader.h"
 #include "audio/sound.h"
 #include "audio/source_manager.h"
 #include "audio/source.h"
+#include "audio/streaming_source.h"
@@ -40,6 +40,7 @@ namespace Audio
         {
             ALCdevice *device = nullptr;
             ALCcontext *context = nullptr;
+            bool can_defer_updates = false; // Whether `AL_SOFT_deferred_updates` is supported.
         };
         Data data;
 
@@ -88,6 +89,8 @@ namespace Audio
             if (!alcMakeContextCurrent(data.context))
                 Program::Error("Unable to activate the OpenAL context.");
 
+            data.can_defer_updates = alIsExtensionPresent("AL_SOFT_deferred_updates");
+
             // Save the instance pointer.
             instance = this;
         }
@@ -141,6 +144,19 @@ namespace Audio
             return data.context;
         }
 
+        // After this, the changes to the sources and the listener are not applied until `ProcessUpdates()`, and then they're applied all at once.
+        // This saves OpenAL from locking and updating the mixer state on every one of them. Both functions do nothing if `AL_SOFT_deferred_updates` is not supported.
+        void DeferUpdates()
+        {
+            if (data.can_defer_updates)
+                alDeferUpdatesSOFT();
+        }
+        void ProcessUpdates()
+        {
+            if (data.can_defer_updates)
+                alProcessUpdatesSOFT();
+        }
+
         // Changes configuration for an existing context.
         // Note that we pass the vector by value, because we need to append a null element at the end before passing it to AL.
         void Reconfigure(attribute_list_t attributes)
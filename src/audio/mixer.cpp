@@ -0,0 +1,248 @@
+#include "mixer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <numbers>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "audio/buffer.h"
+#include "program/errors.h"
+
+namespace Audio
+{
+    namespace
+    {
+        [[nodiscard]] float SampleToFloat(std::uint8_t sample) {return (int(sample) - 128) / 128.f;}
+        [[nodiscard]] float SampleToFloat(std::int16_t sample) {return sample / 32768.f;}
+    }
+
+    struct Mixer::State
+    {
+        static constexpr std::size_t num_buffers = 6;
+        static constexpr std::size_t chunk_blocks = 256; // About 6 ms at 44.1 kHz, so at most 35 ms are queued ahead.
+
+        struct Voice
+        {
+            std::shared_ptr<const Sound> sound;
+            double pos = 0; // In the blocks of `sound`.
+            double step = 1; // How much `pos` advances per output block.
+            float left = 0, right = 0; // The volume for each channel.
+            int priority = 0;
+            std::uint64_t start_index = 0; // When this voice was started. Older voices are stolen first.
+        };
+
+        // Immutable after construction.
+        std::size_t max_voices = 0;
+        int sampling_rate = 0;
+
+        bool initialized = false; // Whether the OpenAL objects were created.
+        Source source;
+        std::array<Buffer, num_buffers> buffers;
+        std::vector<Buffer *> free_buffers;
+
+        std::vector<Voice> voices;
+        std::uint64_t next_start_index = 1;
+
+        std::vector<float> mix = std::vector<float>(chunk_blocks * 2); // Interleaved stereo.
+        std::vector<std::int16_t> output = std::vector<std::int16_t>(chunk_blocks * 2);
+
+        State(std::size_t max_voices, int sampling_rate) : max_voices(max_voices), sampling_rate(sampling_rate)
+        {
+            voices.reserve(max_voices);
+        }
+
+        State(const State &) = delete;
+        State &operator=(const State &) = delete;
+
+        ~State()
+        {
+            // The buffers can't be destroyed while they're queued.
+            source.stop();
+            if (source)
+                alSourcei(source.Handle(), AL_BUFFER, 0);
+        }
+
+        // Adds the voice to `mix`. Returns false if the voice has finished.
+        template <typename T>
+        static bool MixVoice(Voice &voice, const T *samples, std::size_t count, float *target)
+        {
+            if (voice.step == 1)
+            {
+                // Playing at the original speed, so no interpolation is needed. This loop is simple enough to be vectorized.
+                std::size_t begin = std::size_t(voice.pos);
+                std::size_t len = std::min(chunk_blocks, count - std::min(count, begin));
+                for (std::size_t i = 0; i < len; i++)
+                {
+                    float value = SampleToFloat(samples[begin + i]);
+                    target[i * 2] += value * voice.left;
+                    target[i * 2 + 1] += value * voice.right;
+                }
+                voice.pos += double(len);
+                return len == chunk_blocks;
+            }
+
+            // Linear interpolation between the neighboring samples.
+            for (std::size_t i = 0; i < chunk_blocks; i++)
+            {
+                std::size_t index = std::size_t(voice.pos);
+                if (index >= count)
+                    return false;
+                float a = SampleToFloat(samples[index]);
+                float b = index + 1 < count ? SampleToFloat(samples[index + 1]) : 0;
+                float value = a + (b - a) * float(voice.pos - double(index));
+                target[i * 2] += value * voice.left;
+                target[i * 2 + 1] += value * voice.right;
+                voice.pos += voice.step;
+            }
+            return std::size_t(voice.pos) < count;
+        }
+
+        // Mixes the next chunk into `output`, and removes the voices that finished.
+        void MixChunk()
+        {
+            std::fill(mix.begin(), mix.end(), 0.f);
+
+            std::erase_if(voices, [&](Voice &voice)
+            {
+                const Sound &sound = *voice.sound;
+                if (sound.Resolution() == bits_8)
+                    return !MixVoice(voice, sound.Data<std::uint8_t>(), sound.BlockCount(), mix.data());
+                else
+                    return !MixVoice(voice, sound.Data<std::int16_t>(), sound.BlockCount(), mix.data());
+            });
+
+            for (std::size_t i = 0; i < mix.size(); i++)
+                output[i] = std::int16_t(std::clamp(mix[i] * 32767.f, -32768.f, 32767.f));
+        }
+
+        void Initialize()
+        {
+            initialized = true;
+            source = nullptr;
+            source.relative(); // Stereo buffers aren't positioned anyway, but just in case.
+            for (Buffer &buffer : buffers)
+            {
+                buffer = nullptr;
+                free_buffers.push_back(&buffer);
+            }
+        }
+    };
+
+    Mixer::Mixer() {}
+
+    Mixer::Mixer(std::size_t max_voices, int sampling_rate)
+        : state(std::make_unique<State>(max_voices, sampling_rate))
+    {}
+
+    Mixer::Mixer(Mixer &&) noexcept = default;
+    Mixer &Mixer::operator=(Mixer &&) noexcept = default;
+    Mixer::~Mixer() = default;
+
+    Source &Mixer::GetSource()
+    {
+        return state->source;
+    }
+
+    bool Mixer::Play(std::shared_ptr<const Sound> sound, int priority, float volume, float pitch, float pan)
+    {
+        if (!state || !sound || !*sound || state->max_voices == 0)
+            return false;
+        if (sound->ChannelCount() != mono)
+            Program::Error("`Audio::Mixer` can only play mono sounds.");
+
+        State &s = *state;
+
+        State::Voice *target = nullptr;
+        if (s.voices.size() < s.max_voices)
+        {
+            target = &s.voices.emplace_back();
+        }
+        else
+        {
+            auto least = std::min_element(s.voices.begin(), s.voices.end(), [](const State::Voice &a, const State::Voice &b)
+            {
+                return std::tie(a.priority, a.start_index) < std::tie(b.priority, b.start_index);
+            });
+            if (priority < least->priority)
+                return false;
+            target = &*least;
+        }
+
+        // Constant power panning.
+        float angle = (std::clamp(pan, -1.f, 1.f) + 1) * float(std::numbers::pi / 4);
+
+        target->sound = std::move(sound);
+        target->pos = 0;
+        target->step = double(pitch) * target->sound->SamplingRate() / s.sampling_rate;
+        target->left = volume * std::cos(angle);
+        target->right = volume * std::sin(angle);
+        target->priority = priority;
+        target->start_index = s.next_start_index++;
+        return true;
+    }
+
+    std::size_t Mixer::ActiveVoices() const
+    {
+        return state ? state->voices.size() : 0;
+    }
+
+    void Mixer::Tick()
+    {
+        if (!state)
+            return;
+
+        State &s = *state;
+        if (!s.initialized)
+            s.Initialize();
+        if (!s.source)
+        {
+            // No source, so nothing can play.
+            s.voices.clear();
+            return;
+        }
+
+        ALuint handle = s.source.Handle();
+
+        // Reclaim the buffers that finished playing.
+        ALint processed = 0;
+        alGetSourcei(handle, AL_BUFFERS_PROCESSED, &processed);
+        while (processed-- > 0)
+        {
+            ALuint buffer_handle = 0;
+            alSourceUnqueueBuffers(handle, 1, &buffer_handle);
+            for (Buffer &buffer : s.buffers)
+            {
+                if (buffer.Handle() == buffer_handle)
+                {
+                    s.free_buffers.push_back(&buffer);
+                    break;
+                }
+            }
+        }
+
+        // Mix ahead into the free buffers.
+        while (!s.free_buffers.empty() && !s.voices.empty())
+        {
+            s.MixChunk();
+
+            Buffer &buffer = *s.free_buffers.back();
+            s.free_buffers.pop_back();
+            buffer.SetData(s.sampling_rate, stereo, State::chunk_blocks, s.output.data());
+            ALuint buffer_handle = buffer.Handle();
+            alSourceQueueBuffers(handle, 1, &buffer_handle);
+        }
+
+        // Start the source, or restart it after an underrun.
+        if (!s.source.IsPlaying())
+        {
+            ALint queued = 0;
+            alGetSourcei(handle, AL_BUFFERS_QUEUED, &queued);
+            if (queued > 0)
+                s.source.play();
+        }
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+
+#include "audio/sound.h"
+#include "audio/source.h"
+
+namespace Audio
+{
+    // Mixes short mono sounds in software, and plays the result through a single streaming stereo source.
+    // Unlike `SourceManager::Allocate()`, the voices don't use up OpenAL sources, so there can be many of them. But there's no 3D positioning, only panning.
+    // The mixing happens in `Tick()`, which must be called regularly on the main thread. It mixes a few milliseconds ahead, which is the added latency.
+    class Mixer
+    {
+        struct State;
+        std::unique_ptr<State> state;
+
+      public:
+        // Create a null mixer.
+        Mixer();
+
+        // `max_voices` is the max number of sounds playing at the same time.
+        // The OpenAL objects are created by the first `Tick()`, so this can be constructed before the audio context.
+        explicit Mixer(std::size_t max_voices, int sampling_rate = 44100);
+
+        Mixer(Mixer &&) noexcept;
+        Mixer &operator=(Mixer &&) noexcept;
+        ~Mixer();
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(state);
+        }
+
+        // The underlying source, to change its volume. Don't touch its buffers.
+        [[nodiscard]] Source &GetSource();
+
+        // Starts playing a mono sound, from the next `Tick()`. The sound is kept alive while it plays.
+        // `pitch` is the playback speed factor, and `pan` is from -1 (left) to 1 (right).
+        // If all voices are busy, steals the least important one: with lower `priority`, then older. Returns false if all of them are more important.
+        bool Play(std::shared_ptr<const Sound> sound, int priority = 0, float volume = 1, float pitch = 1, float pan = 0);
+
+        // The number of playing voices.
+        [[nodiscard]] std::size_t ActiveVoices() const;
+
+        // Mixes the playing voices into the free buffers, and queues them. Restarts the playback after an underrun.
+        // When nothing is playing, doesn't queue anything and lets the source stop.
+        void Tick();
+    };
+}
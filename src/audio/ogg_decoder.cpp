@@ -0,0 +1,262 @@
+#include "ogg_decoder.h"
+
+#include <algorithm>
+
+#include <vorbis/vorbisfile.h>
+
+#include "strings/format.h"
+#include "utils/robust_math.h"
+
+namespace Audio
+{
+    struct OggDecoder::State
+    {
+        Stream::Input input;
+        std::string name;
+        OggVorbis_File file{};
+        bool file_open = false;
+
+        int sampling_rate = 0;
+        Channels channel_count = mono;
+
+        // An index of the current bitstream (basically a section) of the file.
+        // When it changes, the amount of channels and/or sample rate can also change; if it happens, we throw an exception.
+        int bitstream_index = -1;
+
+        ~State()
+        {
+            if (file_open)
+                ov_clear(&file);
+        }
+    };
+
+    OggDecoder::OggDecoder() {}
+
+    OggDecoder::OggDecoder(Stream::Input input)
+    {
+        state = std::make_unique<State>();
+        state->name = input.GetTarget();
+        state->input = std::move(input);
+
+        try
+        {
+            // Stream exceptions aren't supposed to escape the callbacks anyway,
+            // might as well make constructing them as cheap as possible.
+            state->input.WantExceptionPrefixStyle(Stream::no_prefix);
+
+            // Construct callbacks.
+            ov_callbacks callbacks;
+            callbacks.close_func = nullptr;
+            callbacks.tell_func = [](void *stream_ptr) -> long
+            {
+                try
+                {
+                    long ret;
+                    if (Robust::conversion_fails(static_cast<Stream::Input *>(stream_ptr)->Position(), ret))
+                        return -1;
+                    return ret;
+                }
+                catch (...)
+                {
+                    return -1;
+                }
+            };
+            callbacks.seek_func = [](void *stream_ptr, std::int64_t offset, int mode) -> int
+            {
+                try
+                {
+                    std::ptrdiff_t converted_offset;
+                    if (Robust::conversion_fails(offset, converted_offset))
+                        return -1;
+
+                    Stream::SeekMode converted_mode;
+                    switch (mode)
+                    {
+                      case SEEK_SET:
+                        converted_mode = Stream::absolute;
+                        break;
+                      case SEEK_CUR:
+                        converted_mode = Stream::relative;
+                        break;
+                      case SEEK_END:
+                        converted_mode = Stream::end;
+                        break;
+                      default:
+                        return -1;
+                    }
+
+                    static_cast<Stream::Input *>(stream_ptr)->Seek(converted_offset, converted_mode);
+                    return 0;
+                }
+                catch (...)
+                {
+                    return -1;
+                }
+            };
+            callbacks.read_func = [](void *buffer, std::size_t elem_size, std::size_t elem_count, void *stream_ptr) -> std::size_t
+            {
+                try
+                {
+                    if (elem_size == 0 || elem_count == 0)
+                        return 0;
+
+                    auto &stream = *static_cast<Stream::Input *>(stream_ptr);
+
+                    std::size_t total_size;
+                    bool enough_data = true;
+
+                    // If the read size is larger than the remaining amount of bytes
+                    // OR if the calculation of `total_size` overflowed, clamp the read size.
+                    if ((Robust::value(elem_size) * Robust::value(elem_count) >>= total_size) || total_size > stream.RemainingBytes())
+                    {
+                        total_size = stream.RemainingBytes();
+                        enough_data = false;
+                    }
+
+                    stream.Read(static_cast<char *>(buffer), total_size);
+
+                    if (enough_data)
+                        return elem_count;
+                    else
+                        return total_size / elem_size;
+                }
+                catch (...)
+                {
+                    return -1;
+                }
+            };
+
+            // Open a file with those callbacks.
+            switch (ov_open_callbacks(&state->input, &state->file, nullptr, 0, callbacks))
+            {
+              case 0:
+                break;
+              case OV_EREAD:
+                Program::Error("Unable to read data from the stream.");
+                break;
+              case OV_ENOTVORBIS:
+                Program::Error("This is not a vorbis sound.");
+                break;
+              case OV_EVERSION:
+                Program::Error("Vorbis version mismatch.");
+                break;
+              case OV_EBADHEADER:
+                Program::Error("Invalid header.");
+                break;
+              case OV_EFAULT:
+                Program::Error("Internal vorbis error.");
+                break;
+              default:
+                Program::Error("Unknown vorbis error.");
+                break;
+            }
+            state->file_open = true;
+
+            // Get some info about the file. No cleanup appears to be necessary.
+            vorbis_info *info = ov_info(&state->file, -1);
+            if (!info)
+                Program::Error("Unable to get information about the file.");
+
+            // Get channel count.
+            if (info->channels != 1 && info->channels != 2)
+                Program::Error("The file has too many channels. Only mono and stereo are supported.");
+            state->channel_count = Channels(info->channels);
+
+            // Get frequency.
+            if (Robust::conversion_fails(info->rate, state->sampling_rate))
+                Program::Error("The sample rate is too high.");
+        }
+        catch (std::exception &e)
+        {
+            Program::Error(FMT("While reading a vorbis sound from `{}`:\n{}", state->name, e.what()));
+        }
+    }
+
+    OggDecoder::OggDecoder(OggDecoder &&) noexcept = default;
+    OggDecoder &OggDecoder::operator=(OggDecoder &&) noexcept = default;
+    OggDecoder::~OggDecoder() = default;
+
+    const std::string &OggDecoder::Name() const
+    {
+        return state->name;
+    }
+
+    int OggDecoder::SamplingRate() const
+    {
+        return state->sampling_rate;
+    }
+
+    Channels OggDecoder::ChannelCount() const
+    {
+        return state->channel_count;
+    }
+
+    std::size_t OggDecoder::BlockCount() const
+    {
+        auto ret = ov_pcm_total(&state->file, -1);
+        if (ret == OV_EINVAL)
+            Program::Error(FMT("While reading a vorbis sound from `{}`:\nUnable to determine the file length.", state->name));
+
+        std::size_t converted;
+        if (Robust::conversion_fails(ret, converted))
+            Program::Error(FMT("While reading a vorbis sound from `{}`:\nThe file is too long.", state->name));
+        return converted;
+    }
+
+    std::size_t OggDecoder::Read(std::uint8_t *buffer, std::size_t size, BitResolution resolution)
+    {
+        try
+        {
+            std::size_t current_offset = 0;
+
+            while (current_offset < size)
+            {
+                int bitstream_index;
+                int max_segment_size = int(std::min(size - current_offset, std::size_t(1) << 30));
+                auto segment_size = ov_read(&state->file, reinterpret_cast<char *>(buffer + current_offset), max_segment_size, 0/*little endian*/,
+                    GetBytesPerSample(resolution), resolution == bits_16/*true means numbers are signed*/, &bitstream_index);
+
+                switch (segment_size)
+                {
+                  case 0:
+                    return current_offset; // End of file.
+                  case OV_HOLE:
+                    Program::Error("The file is corrupted.");
+                    break;
+                  case OV_EBADLINK:
+                    Program::Error("Bad link.");
+                    break;
+                  case OV_EINVAL:
+                    Program::Error("Invalid header.");
+                    break;
+                }
+                current_offset += segment_size;
+
+                if (bitstream_index != state->bitstream_index)
+                {
+                    state->bitstream_index = bitstream_index;
+
+                    vorbis_info *info = ov_info(&state->file, -1); // `-1` means the current bitstream, we could also use `bitstream_index` here.
+                    if (!info)
+                        Program::Error("Unable to get information about a section of the file.");
+                    if (Robust::not_equal(info->channels, int(state->channel_count)))
+                        Program::Error("Channel count has changed in the middle of the file.");
+                    if (Robust::not_equal(info->rate, state->sampling_rate))
+                        Program::Error("Sampling rate has changed in the middle of the file.");
+                }
+            }
+
+            return current_offset;
+        }
+        catch (std::exception &e)
+        {
+            Program::Error(FMT("While reading a vorbis sound from `{}`:\n{}", state->name, e.what()));
+        }
+    }
+
+    void OggDecoder::Rewind()
+    {
+        if (ov_pcm_seek(&state->file, 0) != 0)
+            Program::Error(FMT("While reading a vorbis sound from `{}`:\nUnable to rewind.", state->name));
+    }
+}
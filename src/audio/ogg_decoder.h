@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "audio/sound.h"
+#include "stream/input.h"
+
+namespace Audio
+{
+    // Decodes a Vorbis stream incrementally, a piece at a time.
+    // `Sound` uses this to decode whole files, and `StreamingSource` to play them without decoding everything in advance.
+    class OggDecoder
+    {
+        struct State;
+        std::unique_ptr<State> state;
+
+      public:
+        OggDecoder();
+        // Throws on failure.
+        OggDecoder(Stream::Input input);
+
+        OggDecoder(OggDecoder &&) noexcept;
+        OggDecoder &operator=(OggDecoder &&) noexcept;
+        ~OggDecoder();
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(state);
+        }
+
+        // The name of the input stream, for error messages.
+        [[nodiscard]] const std::string &Name() const;
+
+        [[nodiscard]] int SamplingRate() const;
+        [[nodiscard]] Channels ChannelCount() const;
+
+        // The total length, in blocks. Throws if this can't be determined.
+        [[nodiscard]] std::size_t BlockCount() const;
+
+        // Decodes up to `size` bytes into `buffer`, and returns the amount of bytes written.
+        // Returns less than `size` only at the end of the stream. `size` should be a multiple of the block size.
+        // Throws on failure, including when the sampling rate or the channel count changes in the middle of the stream.
+        [[nodiscard]] std::size_t Read(std::uint8_t *buffer, std::size_t size, BitResolution resolution);
+
+        // Goes back to the beginning of the stream.
+        void Rewind();
+    };
+}
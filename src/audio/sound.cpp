@@ -1,20 +1,51 @@
 #include "sound.h"
 
+#include <algorithm>
 #include <string_view>
 
-#include <vorbis/vorbisfile.h>
-
+#include "audio/ogg_decoder.h"
 #include "macros/finally.h"
 #include "strings/format.h"
 #include "utils/robust_math.h"
 
 namespace Audio
 {
+    namespace
+    {
+        // Averages the two channels of each block. `source` and `target` can be the same.
+        // The loop is simple enough for the compilers to vectorize.
+        template <typename T>
+        void DownmixToMono(const T *source, T *target, std::size_t block_count)
+        {
+            for (std::size_t i = 0; i < block_count; i++)
+                target[i] = T((int(source[i * 2]) + int(source[i * 2 + 1])) / 2);
+        }
+
+        void DownmixToMono(BitResolution resolution, const std::uint8_t *source, std::uint8_t *target, std::size_t block_count)
+        {
+            switch (resolution)
+            {
+              case bits_8:
+                DownmixToMono(source, target, block_count);
+                break;
+              case bits_16:
+                DownmixToMono(reinterpret_cast<const std::int16_t *>(source), reinterpret_cast<std::int16_t *>(target), block_count);
+                break;
+            }
+        }
+    }
+
     Sound::Sound(Format format, std::optional<Channels> expected_channel_count, Stream::Input input, BitResolution preferred_resolution)
     {
+        // Stereo sounds are downmixed if mono is expected, but not the other way around.
+        auto NeedDownmix = [&]
+        {
+            return expected_channel_count == mono && channel_count == stereo;
+        };
+
         auto CheckChannelCount = [&]
         {
-            if (expected_channel_count && *expected_channel_count != channel_count)
+            if (expected_channel_count && *expected_channel_count != channel_count && !NeedDownmix())
             {
                 Program::Error(FMT("{}Expected a {} sound, but got {}.", input.GetExceptionPrefix(),
                     (*expected_channel_count == mono ? "mono" : "stereo"), (channel_count == mono ? "mono" : "stereo")));
@@ -105,6 +136,15 @@ namespace Audio
                           case bits_16:
                             input.ReadLittle(Data<std::int16_t>(), chunk_size / BytesPerSample());
                         }
+
+                        if (NeedDownmix())
+                        {
+                            std::size_t block_count = BlockCount();
+                            DownmixToMono(resolution, data.data(), data.data(), block_count);
+                            channel_count = mono;
+                            data.resize(block_count * BytesPerBlock());
+                            data.shrink_to_fit();
+                        }
                     }
                     else
                     {
@@ -130,199 +170,54 @@ namespace Audio
             }
             break;
           case ogg:
-            try
             {
-                // Stream exceptions aren't supposed to escape the callbacks anyway,
-                // might as well make constructing them as cheap as possible.
-                input.WantExceptionPrefixStyle(Stream::no_prefix);
-
-                // Construct callbacks.
-                ov_callbacks callbacks;
-                callbacks.close_func = nullptr;
-                callbacks.tell_func = [](void *stream_ptr) -> long
-                {
-                    try
-                    {
-                        long ret;
-                        if (Robust::conversion_fails(static_cast<Stream::Input *>(stream_ptr)->Position(), ret))
-                            return -1;
-                        return ret;
-                    }
-                    catch (...)
-                    {
-                        return -1;
-                    }
-                };
-                callbacks.seek_func = [](void *stream_ptr, std::int64_t offset, int mode) -> int
-                {
-                    try
-                    {
-                        std::ptrdiff_t converted_offset;
-                        if (Robust::conversion_fails(offset, converted_offset))
-                            return -1;
+                OggDecoder decoder(std::move(input));
 
-                        Stream::SeekMode converted_mode;
-                        switch (mode)
-                        {
-                          case SEEK_SET:
-                            converted_mode = Stream::absolute;
-                            break;
-                          case SEEK_CUR:
-                            converted_mode = Stream::relative;
-                            break;
-                          case SEEK_END:
-                            converted_mode = Stream::end;
-                            break;
-                          default:
-                            return -1;
-                        }
-
-                        static_cast<Stream::Input *>(stream_ptr)->Seek(converted_offset, converted_mode);
-                        return 0;
-                    }
-                    catch (...)
-                    {
-                        return -1;
-                    }
-                };
-                callbacks.read_func = [](void *buffer, std::size_t elem_size, std::size_t elem_count, void *stream_ptr) -> std::size_t
+                channel_count = decoder.ChannelCount();
+                if (expected_channel_count && *expected_channel_count != channel_count && !NeedDownmix())
                 {
-                    try
-                    {
-                        if (elem_size == 0 || elem_count == 0)
-                            return 0;
-
-                        auto &stream = *static_cast<Stream::Input *>(stream_ptr);
-
-                        std::size_t total_size;
-                        bool enough_data = true;
-
-                        // If the read size is larger than the remaining amount of bytes
-                        // OR if the calculation of `total_size` overflowed, clamp the read size.
-                        if ((Robust::value(elem_size) * Robust::value(elem_count) >>= total_size) || total_size > stream.RemainingBytes())
-                        {
-                            total_size = stream.RemainingBytes();
-                            enough_data = false;
-                        }
-
-                        stream.Read(static_cast<char *>(buffer), total_size);
-
-                        if (enough_data)
-                            return elem_count;
-                        else
-                            return total_size / elem_size;
-                    }
-                    catch (...)
-                    {
-                        return -1;
-                    }
-                };
-
-                // Open a file with those callbacks.
-                OggVorbis_File ogg_file_handle;
-                switch (ov_open_callbacks(&input, &ogg_file_handle, nullptr, 0, callbacks))
-                {
-                  case 0:
-                    break;
-                  case OV_EREAD:
-                    Program::Error("Unable to read data from the stream.");
-                    break;
-                  case OV_ENOTVORBIS:
-                    Program::Error("This is not a vorbis sound.");
-                    break;
-                  case OV_EVERSION:
-                    Program::Error("Vorbis version mismatch.");
-                    break;
-                  case OV_EBADHEADER:
-                    Program::Error("Invalid header.");
-                    break;
-                  case OV_EFAULT:
-                    Program::Error("Internal vorbis error.");
-                    break;
-                  default:
-                    Program::Error("Unknown vorbis error.");
-                    break;
+                    Program::Error(FMT("While reading a vorbis sound from `{}`:\nExpected a {} sound, but got {}.", decoder.Name(),
+                        (*expected_channel_count == mono ? "mono" : "stereo"), (channel_count == mono ? "mono" : "stereo")));
                 }
-                FINALLY( ov_clear(&ogg_file_handle); )
-
-
-                // Get some info about the file. No cleanup appears to be necessary.
-                vorbis_info *info = ov_info(&ogg_file_handle, -1);
-                if (!info)
-                    Program::Error("Unable to get information about the file.");
-
-                // Get channel count.
-                if (info->channels != 1 && info->channels != 2)
-                    Program::Error("The file has too many channels. Only mono and stereo are supported.");
-                channel_count = Channels(info->channels);
-                CheckChannelCount();
-
-                // Get frequency.
-                if (Robust::conversion_fails(info->rate, sampling_rate))
-                    Program::Error("The sample rate is too high.");
 
-                // Get the block count.
-                auto total_block_count = ov_pcm_total(&ogg_file_handle, -1);
-                if (total_block_count == OV_EINVAL)
-                    Program::Error("Unable to determine the file length.");
+                sampling_rate = decoder.SamplingRate();
 
                 // Copy bit resolution from the parameter.
                 resolution = preferred_resolution;
 
+                // Decode in pieces, downmixing each one. This way the stereo version is never stored whole.
+                bool downmix = NeedDownmix();
+                std::vector<std::uint8_t> stereo_buffer;
+                if (downmix)
+                {
+                    stereo_buffer.resize(std::size_t(1) << 16);
+                    channel_count = mono;
+                }
+
                 // Compute the necessary storage size.
                 std::size_t storage_size;
-                if (Robust::value(total_block_count).cast_to<std::size_t>() * Robust::value(BytesPerBlock()).weakly_typed() >>= storage_size)
-                    Program::Error("The file is too long.");
+                if (Robust::value(decoder.BlockCount()) * Robust::value(BytesPerBlock()).weakly_typed() >>= storage_size)
+                    Program::Error(FMT("While reading a vorbis sound from `{}`:\nThe file is too long.", decoder.Name()));
 
                 data.resize(storage_size);
-
-                std::size_t current_offset = 0;
-
-                // An index of the current bitstream (basically a section) of the file.
-                // When it changes, the amount of channels and/or sample rate can also change; if it happens, we throw an exception.
-                int old_bitstream_index = -1;
-
-                while (current_offset < storage_size)
+                if (!downmix)
                 {
-                    int bitstream_index;
-                    auto segment_size = ov_read(&ogg_file_handle, reinterpret_cast<char *>(data.data() + current_offset), storage_size - current_offset, 0/*little endian*/,
-                        BytesPerSample(), resolution == bits_16/*true means numbers are signed*/, &bitstream_index);
-
-                    switch (segment_size)
-                    {
-                      case 0:
-                        Program::Error("Unexpected end of file.");
-                        break;
-                      case OV_HOLE:
-                        Program::Error("The file is corrupted.");
-                        break;
-                      case OV_EBADLINK:
-                        Program::Error("Bad link.");
-                        break;
-                      case OV_EINVAL:
-                        Program::Error("Invalid header.");
-                        break;
-                    }
-                    current_offset += segment_size;
-
-                    if (bitstream_index != old_bitstream_index)
+                    if (decoder.Read(data.data(), storage_size, resolution) != storage_size)
+                        Program::Error(FMT("While reading a vorbis sound from `{}`:\nUnexpected end of file.", decoder.Name()));
+                }
+                else
+                {
+                    int stereo_block_size = GetBytesPerBlock(resolution, stereo);
+                    std::size_t offset = 0;
+                    while (offset < storage_size)
                     {
-                        old_bitstream_index = bitstream_index;
-
-                        info = ov_info(&ogg_file_handle, -1); // `-1` means the current bitstream, we could also use `bitstream_index` here.
-                        if (!info)
-                            Program::Error("Unable to get information about a section of the file.");
-                        if (Robust::not_equal(info->channels, int(channel_count)))
-                            Program::Error("Channel count has changed in the middle of the file.");
-                        if (Robust::not_equal(info->rate, sampling_rate))
-                            Program::Error("Sampling rate has changed in the middle of the file.");
+                        std::size_t block_count = std::min((storage_size - offset) / BytesPerBlock(), stereo_buffer.size() / stereo_block_size);
+                        if (decoder.Read(stereo_buffer.data(), block_count * stereo_block_size, resolution) != block_count * stereo_block_size)
+                            Program::Error(FMT("While reading a vorbis sound from `{}`:\nUnexpected end of file.", decoder.Name()));
+                        DownmixToMono(resolution, stereo_buffer.data(), data.data() + offset, block_count);
+                        offset += block_count * BytesPerBlock();
                     }
                 }
-
-            }
-            catch (std::exception &e)
-            {
-                Program::Error(FMT("While reading a vorbis sound from `{}`:\n{}", input.GetTarget(), e.what()));
             }
             break;
         }
@@ -81,6 +81,7 @@ namespace Audio
 
         // Loads a sound from a stream, according to the specified `format.
         // If `expected_channel_count` is not null, will throw if the received data doesn't have the specified amount of channels.
+        // Except that if mono is expected, stereo sounds are downmixed to mono (by averaging the channels), without storing the stereo version.
         // `preferred_resolution` specifies the desired resolution; its effect depends on the format. (Currently it's ignored for WAV, and is used unconditionally for OGG.)
         Sound(Format format, std::optional<Channels> expected_channel_count, Stream::Input input, BitResolution preferred_resolution = bits_16);
 
@@ -141,6 +142,12 @@ namespace Audio
             return data.size();
         }
 
+        // For `Refl::EstimateMemory()`.
+        [[nodiscard]] std::size_t EstimateOwnedMemory() const
+        {
+            return data.capacity();
+        }
+
         // The amount of samples. (Corresponding samples from different channels count as one).
         [[nodiscard]] std::size_t BlockCount() const
         {
@@ -0,0 +1,97 @@
+#include "sound_cache.h"
+
+#include <algorithm>
+
+#include "reflection/full.h"
+#include "stream/input.h"
+#include "stream/save_to_file.h"
+#include "utils/filesystem.h"
+
+namespace Audio
+{
+    std::optional<std::int64_t> SoundCache::TimeModified(const std::string &file_name)
+    {
+        bool ok = false;
+        auto info = Filesystem::GetObjectInfo(file_name, &ok);
+        if (!ok || info.category != Filesystem::file)
+            return {};
+        return std::int64_t(info.time_modified);
+    }
+
+    SoundCache::SoundCache(const std::string &file_name)
+    {
+        if (!TimeModified(file_name))
+            return;
+
+        try
+        {
+            Refl::FromBinary(contents, Stream::Input(file_name));
+        }
+        catch (...)
+        {
+            contents = {};
+        }
+    }
+
+    bool SoundCache::Load(Sound &sound, const std::string &file_name, std::optional<Channels> channels, Format format, BitResolution preferred_resolution)
+    {
+        auto it = contents.sounds.find(file_name);
+        if (it == contents.sounds.end())
+            return false;
+
+        const Entry &entry = it->second;
+        if (entry.time_modified != TimeModified(file_name) ||
+            entry.requested_channels != (channels ? int(*channels) : 0) ||
+            entry.format != int(format) ||
+            entry.preferred_resolution != int(preferred_resolution))
+        {
+            return false;
+        }
+
+        // Validate the format, in case the file is corrupted.
+        if ((entry.channels != mono && entry.channels != stereo) || (entry.resolution != bits_8 && entry.resolution != bits_16) || entry.sampling_rate <= 0)
+            return false;
+        int block_size = GetBytesPerBlock(BitResolution(entry.resolution), Channels(entry.channels));
+        if (entry.data.empty() || entry.data.size() % block_size != 0)
+            return false;
+
+        sound = Sound(entry.sampling_rate, Channels(entry.channels), BitResolution(entry.resolution), entry.data.size() / block_size, entry.data.data());
+        used.try_emplace(file_name, false);
+        return true;
+    }
+
+    void SoundCache::Add(const std::string &file_name, std::optional<Channels> channels, Format format, const Sound &sound, BitResolution preferred_resolution)
+    {
+        std::optional<std::int64_t> time = TimeModified(file_name);
+        if (!time)
+            return;
+
+        Entry &entry = contents.sounds[file_name];
+        entry.time_modified = *time;
+        entry.requested_channels = channels ? int(*channels) : 0;
+        entry.format = int(format);
+        entry.preferred_resolution = int(preferred_resolution);
+        entry.sampling_rate = sound.SamplingRate();
+        entry.channels = int(sound.ChannelCount());
+        entry.resolution = int(sound.Resolution());
+        entry.data.assign(sound.RawUntypedData(), sound.RawUntypedData() + sound.ByteSize());
+        used[file_name] = true;
+    }
+
+    void SoundCache::SaveIfChanged(const std::string &file_name)
+    {
+        bool changed = std::erase_if(contents.sounds, [&](const auto &elem){return !used.contains(elem.first);}) > 0;
+        if (!changed)
+            changed = std::any_of(used.begin(), used.end(), [](const auto &elem){return elem.second;});
+        used.clear();
+
+        if (!changed)
+            return;
+
+        try
+        {
+            Stream::SaveFile(file_name, Refl::ToBinary<std::vector<std::uint8_t>>(contents));
+        }
+        catch (...) {}
+    }
+}
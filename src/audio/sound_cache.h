@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "audio/sound.h"
+#include "reflection/structs.h"
+
+namespace Audio
+{
+    // A file with decoded sounds, to skip decoding them on the next launch.
+    // A cached sound is only used if its source file didn't change since then, and was loaded with the same parameters.
+    class SoundCache
+    {
+        REFL_SIMPLE_STRUCT( Entry
+            REFL_DECL(std::int64_t REFL_INIT = 0) time_modified // Of the source file.
+            REFL_DECL(int REFL_INIT = 0) requested_channels // 0 if any.
+            REFL_DECL(int REFL_INIT = 0) format
+            REFL_DECL(int REFL_INIT = 0) preferred_resolution
+            REFL_DECL(int REFL_INIT = 0) sampling_rate
+            REFL_DECL(int REFL_INIT = 0) channels
+            REFL_DECL(int REFL_INIT = 0) resolution
+            REFL_DECL(std::vector<std::uint8_t>) data // Ready for `alBufferData()`.
+        )
+
+        REFL_SIMPLE_STRUCT( Contents
+            REFL_DECL(std::map<std::string, Entry>) sounds // The keys are the source file names.
+        )
+
+        Contents contents;
+        std::map<std::string, bool> used; // The entries used by `Load()` or added by `Add()`. True if added.
+
+        [[nodiscard]] static std::optional<std::int64_t> TimeModified(const std::string &file_name);
+
+      public:
+        // Creates an empty cache.
+        SoundCache() {}
+
+        // Loads the cache from a file. If it's missing or invalid, the cache is empty.
+        explicit SoundCache(const std::string &file_name);
+
+        // If this file is cached with those parameters, and didn't change since then, loads it into `sound` and returns true.
+        [[nodiscard]] bool Load(Sound &sound, const std::string &file_name, std::optional<Channels> channels, Format format, BitResolution preferred_resolution = bits_16);
+
+        // Adds a freshly decoded sound to the cache. Does nothing if the source file doesn't exist on disk.
+        void Add(const std::string &file_name, std::optional<Channels> channels, Format format, const Sound &sound, BitResolution preferred_resolution = bits_16);
+
+        // Drops the entries that weren't loaded or added since the cache was loaded.
+        // If this changed anything, or something was added, saves the cache to a file. Ignores the errors.
+        void SaveIfChanged(const std::string &file_name);
+    };
+}
@@ -3,14 +3,19 @@
 #include <cstddef>
 #include <functional>
 #include <map>
+#include <memory>
 #include <optional>
 #include <string>
+#include <vector>
 
 #include "audio/buffer.h"
+#include "audio/sound_cache.h"
 #include "audio/sound.h"
 #include "meta/common.h"
 #include "meta/string_template_params.h"
 #include "program/errors.h"
+#include "utils/jobs.h"
+#include "utils/symbol.h"
 
 namespace Audio
 {
@@ -19,13 +24,14 @@ namespace Audio
         struct AutoLoadedBuffer
         {
             Buffer buffer;
+            std::shared_ptr<const Sound> sound; // The same data in memory, for `Mixer`.
             // Those may override the parameters specified when calling `LoadMentionedFiles()`.
             std::optional<Channels> channels_override;
             std::optional<Format> format_override;
         };
 
-        // We rely on `std::map` never invalidating the references.
-        using AutoLoadedBuffersMap = std::map<std::string, AutoLoadedBuffer, std::less<>>;
+        // We rely on `std::map` never invalidating the references. The keys are the interned names, so they're compared as integers.
+        using AutoLoadedBuffersMap = std::map<Symbol, AutoLoadedBuffer>;
 
         inline AutoLoadedBuffersMap &GetAutoLoadedBuffers()
         {
@@ -33,45 +39,156 @@ namespace Audio
             return ret;
         }
 
+        using ProcessFilenameFunc = std::function<std::string(const std::string &name, std::optional<Channels> channels, Format format)>;
+
+        struct LazyLoadSettings
+        {
+            ProcessFilenameFunc process_filename;
+            std::optional<Channels> channels;
+            Format format = wav;
+        };
+
+        // Set by `LoadMentionedFilesLazily()`.
+        inline std::optional<LazyLoadSettings> &GetLazyLoadSettings()
+        {
+            static std::optional<LazyLoadSettings> ret;
+            return ret;
+        }
+
+        [[nodiscard]] inline std::optional<Channels> GetChannels(const AutoLoadedBuffer &data, std::optional<Channels> channels)
+        {
+            return data.channels_override ? data.channels_override : channels;
+        }
+
+        [[nodiscard]] inline Format GetFormat(const AutoLoadedBuffer &data, Format format)
+        {
+            return data.format_override.value_or(format);
+        }
+
+        inline void LoadLazily(const std::string &name, AutoLoadedBuffer &data)
+        {
+            const LazyLoadSettings &settings = *GetLazyLoadSettings();
+            std::optional<Channels> file_channels = GetChannels(data, settings.channels);
+            Format file_format = GetFormat(data, settings.format);
+            Sound sound(file_format, file_channels, Stream::ReadOnlyData::from_pack(settings.process_filename(name, file_channels, file_format)));
+            data.buffer = sound;
+            data.sound = std::make_shared<const Sound>(std::move(sound));
+        }
+
         template <typename T> concept ChannelsOrNullptr = Meta::same_as_any_of<T, Channels, std::nullptr_t>;
         template <typename T> concept FormatOrNullptr = Meta::same_as_any_of<T, Format, std::nullptr_t>;
 
         template <Meta::ConstString Name, ChannelsOrNullptr auto ChannelCount, FormatOrNullptr auto FileFormat>
         struct RegisterAutoLoadedBuffer
         {
-            [[maybe_unused]] inline static const Buffer &ref = []() -> Buffer &
+            [[maybe_unused]] inline static AutoLoadedBuffer &ref = []() -> AutoLoadedBuffer &
             {
-                auto it = GetAutoLoadedBuffers().find(Name.str);
+                Symbol name = Symbol::Of<Name>();
+                auto it = GetAutoLoadedBuffers().find(name);
                 ASSERT(it == GetAutoLoadedBuffers().end(), "Attempt to register a duplicate auto-loaded sound file. This shouldn't be possible.");
-                AutoLoadedBuffer &data = GetAutoLoadedBuffers().try_emplace(it, Name.str)->second;
+                AutoLoadedBuffer &data = GetAutoLoadedBuffers().try_emplace(it, name)->second;
                 if constexpr (!std::is_null_pointer_v<decltype(ChannelCount)>)
                     data.channels_override = ChannelCount;
                 if constexpr (!std::is_null_pointer_v<decltype(FileFormat)>)
                     data.format_override = FileFormat;
-                return data.buffer; // We rely on `std::map` never invalidating the references.
+                return data; // We rely on `std::map` never invalidating the references.
             }();
         };
+
+        template <Meta::ConstString Name, ChannelsOrNullptr auto ChannelCount, FormatOrNullptr auto FileFormat>
+        [[nodiscard]] AutoLoadedBuffer &GetAutoLoadedBuffer()
+        {
+            AutoLoadedBuffer &data = RegisterAutoLoadedBuffer<Name, ChannelCount, FileFormat>::ref;
+            if (!data.buffer && GetLazyLoadSettings()) [[unlikely]]
+                LoadLazily(Name.str, data);
+            return data;
+        }
     }
 
     // Returns a reference to a buffer, loaded from the filename passed as the parameter.
     // The load doesn't happen at the call point, and is done by `LoadMentionedFiles()`, which magically knows all files that it needs to load in this manner.
+    // In the lazy mode (see `LoadMentionedFilesLazily()`), the file is loaded here, on the first call.
     template <Meta::ConstString Name, impl::ChannelsOrNullptr auto ChannelCount = nullptr, impl::FormatOrNullptr auto FileFormat = nullptr>
     [[nodiscard]] const Buffer &File()
     {
-        return impl::RegisterAutoLoadedBuffer<Name, ChannelCount, FileFormat>::ref;
+        return impl::GetAutoLoadedBuffer<Name, ChannelCount, FileFormat>().buffer;
+    }
+
+    // Like `File()`, but returns the sound data in memory, for `Mixer::Play()`.
+    template <Meta::ConstString Name, impl::ChannelsOrNullptr auto ChannelCount = nullptr, impl::FormatOrNullptr auto FileFormat = nullptr>
+    [[nodiscard]] const std::shared_ptr<const Sound> &FileSound()
+    {
+        return impl::GetAutoLoadedBuffer<Name, ChannelCount, FileFormat>().sound;
     }
 
     // Loads (or reloads) all files mentioned in all known `Audio::File()` calls.
     // The number of channels and the file format can be overridden by the `File()` calls.
     // `process_filename` is a function that processes filenames before use. You can use the default function returned by `LoadFromPrefix()`.
     // The signatures is `std::string (const std::string &name, std::optional<Channels> channels, Format format)`, it processes the filenames before loading them.
-    inline void LoadMentionedFiles(auto &&process_filename, std::optional<Channels> channels, Format format)
+    // The files are decoded in parallel, then the buffers are created on the calling thread. `process_filename` is only called on the calling thread.
+    // If `cache_file` isn't empty, the decoded sounds are cached there (see `SoundCache`), and the ones that didn't change are loaded from it on the next call.
+    inline void LoadMentionedFiles(auto &&process_filename, std::optional<Channels> channels, Format format, const std::string &cache_file = "")
+    {
+        impl::GetLazyLoadSettings().reset();
+
+        struct Task
+        {
+            impl::AutoLoadedBuffer *data = nullptr;
+            std::optional<Channels> channels;
+            Format format = wav;
+            std::string file_name;
+            bool cached = false;
+            Sound sound;
+        };
+        std::vector<Task> tasks;
+        tasks.reserve(impl::GetAutoLoadedBuffers().size());
+
+        for (auto &[name, data] : impl::GetAutoLoadedBuffers())
+        {
+            Task &task = tasks.emplace_back();
+            task.data = &data;
+            task.channels = impl::GetChannels(data, channels);
+            task.format = impl::GetFormat(data, format);
+            task.file_name = process_filename(std::string(name.View()), task.channels, task.format);
+        }
+
+        SoundCache cache;
+        if (!cache_file.empty())
+        {
+            cache = SoundCache(cache_file);
+            for (Task &task : tasks)
+                task.cached = cache.Load(task.sound, task.file_name, task.channels, task.format);
+        }
+
+        Jobs::DefaultPool().ParallelFor(tasks.size(), [&](std::size_t i)
+        {
+            Task &task = tasks[i];
+            if (!task.cached)
+                task.sound = Audio::Sound(task.format, task.channels, Stream::ReadOnlyData::from_pack(task.file_name));
+        }, 1);
+
+        // OpenAL calls stay on this thread.
+        for (Task &task : tasks)
+        {
+            task.data->buffer = task.sound;
+            if (!task.cached && !cache_file.empty())
+                cache.Add(task.file_name, task.channels, task.format, task.sound);
+            task.data->sound = std::make_shared<const Sound>(std::move(task.sound));
+        }
+
+        if (!cache_file.empty())
+            cache.SaveIfChanged(cache_file);
+    }
+
+    // Like `LoadMentionedFiles()`, but each file is loaded by the first `File()` call that uses it, to start faster.
+    // Unloads the files that are already loaded.
+    inline void LoadMentionedFilesLazily(impl::ProcessFilenameFunc process_filename, std::optional<Channels> channels, Format format)
     {
+        impl::GetLazyLoadSettings() = impl::LazyLoadSettings{std::move(process_filename), channels, format};
         for (auto &[name, data] : impl::GetAutoLoadedBuffers())
         {
-            std::optional<Channels> file_channels = data.channels_override ? data.channels_override : channels;
-            Format file_format = data.format_override.value_or(format);
-            data.buffer = Audio::Sound(file_format, file_channels, process_filename(name, file_channels, file_format));
+            data.buffer = {};
+            data.sound = {};
         }
     }
 
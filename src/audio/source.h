@@ -38,23 +38,28 @@ namespace Audio
         // Create a null source.
         Source() {}
 
-        Source(const Audio::Buffer &buffer)
+        // Create a source without a buffer. Use this to queue the buffers manually, see `StreamingSource`.
+        Source(decltype(nullptr))
         {
-            ASSERT(buffer, "Attempt to use a null audio buffer.");
-
             // We don't throw if the handle is null. Instead, we make sure that any operation on a null handle has no effect.
             alGenSources(1, &data.handle);
 
             if (data.handle)
             {
-                alSourcei(data.handle, AL_BUFFER, buffer.Handle());
-
                 alSourcef(data.handle, AL_REFERENCE_DISTANCE, default_ref_dist);
                 alSourcef(data.handle, AL_ROLLOFF_FACTOR,     default_rolloff_fac);
                 alSourcef(data.handle, AL_MAX_DISTANCE,       default_max_dist);
             }
         }
 
+        Source(const Audio::Buffer &buffer) : Source(nullptr)
+        {
+            ASSERT(buffer, "Attempt to use a null audio buffer.");
+
+            if (data.handle)
+                alSourcei(data.handle, AL_BUFFER, buffer.Handle());
+        }
+
         Source(Source &&other) noexcept : data(std::exchange(other.data, {})) {}
         Source &operator=(Source other) noexcept
         {
@@ -203,6 +208,39 @@ namespace Audio
         }
 
 
+        // Reuse support, see `SourceManager`.
+
+        // Stops the source and replaces its buffer.
+        Source &buffer(const Audio::Buffer &buffer)
+        {
+            ASSERT(buffer, "Attempt to use a null audio buffer.");
+            if (data.handle)
+            {
+                alSourceStop(data.handle);
+                alSourcei(data.handle, AL_BUFFER, buffer.Handle());
+            }
+            return *this;
+        }
+
+        // Resets all parameters to the same values a new source would have.
+        Source &reset_parameters()
+        {
+            if (data.handle)
+            {
+                alSourcef(data.handle, AL_REFERENCE_DISTANCE, default_ref_dist);
+                alSourcef(data.handle, AL_ROLLOFF_FACTOR,     default_rolloff_fac);
+                alSourcef(data.handle, AL_MAX_DISTANCE,       default_max_dist);
+                alSourcef(data.handle, AL_GAIN, 1);
+                alSourcef(data.handle, AL_PITCH, 1);
+                alSourcei(data.handle, AL_LOOPING, false);
+                alSourcei(data.handle, AL_SOURCE_RELATIVE, false);
+                alSourcefv(data.handle, AL_POSITION, fvec3().as_array());
+                alSourcefv(data.handle, AL_VELOCITY, fvec3().as_array());
+            }
+            return *this;
+        }
+
+
         // 3D audio support (makes sense for mono sources only).
 
         Source &pos(fvec3 p)
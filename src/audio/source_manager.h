@@ -1,23 +1,50 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <optional>
+#include <tuple>
 #include <vector>
 
 #include "audio/buffer.h"
+#include "audio/openal.h"
 #include "audio/source.h"
 #include "program/errors.h"
+#include "utils/mat.h"
 
 namespace Audio
 {
     // Keeps a list of `std::shared_ptr`s to sources.
     // Automatically releases them when they stop playing.
+    // Also has a fixed-size pool of sources for short fire-and-forget sounds, see `Allocate()`.
     class SourceManager
     {
         std::vector<std::shared_ptr<Source>> sources;
 
+        struct Voice
+        {
+            Source source;
+            int priority = 0;
+            std::optional<fvec3> pos; // Null if relative to the listener.
+            std::uint64_t start_index = 0; // When this voice was allocated. Older voices are stolen first.
+        };
+        std::size_t pool_size = 0;
+        std::vector<Voice> voices; // The sources are generated lazily, since there's no audio context yet when the manager is constructed.
+        std::uint64_t next_start_index = 1;
+        std::size_t active_voices = 0; // Updated by `Tick()`.
+
+        // Larger is more important.
+        [[nodiscard]] static auto Importance(int priority, const std::optional<fvec3> &pos, fvec3 listener_pos, std::uint64_t start_index)
+        {
+            // Compare the priority first, then the closeness to the listener, then the age.
+            return std::tuple(priority, pos ? -(*pos - listener_pos).len_sqr() : 0.f, start_index);
+        }
+
       public:
-        SourceManager() {}
+        // `pool_size` is the max number of sources `Allocate()` can use at the same time.
+        SourceManager(std::size_t pool_size = 32) : pool_size(pool_size) {}
 
         // Adds a new source to the manager.
         // It should be `play()`ed immediately, otherwise it will be removed at the next `Tick()`.
@@ -31,15 +58,74 @@ namespace Audio
             return sources.emplace_back(std::make_shared<Source>(buffer));
         }
 
+        // Returns a pooled source with the buffer attached, the parameters reset, and the position set (or made relative if `pos` is null).
+        // It should be `play()`ed immediately, otherwise it can be reused by the next call.
+        // If all pooled sources are busy, steals the least important one: with lower `priority`, then farther from the listener, then older.
+        // Returns null if all busy sources are more important than this one, or if a source can't be created.
+        // The returned pointer should only be used immediately, since the source can be stolen later.
+        [[nodiscard]] Source *Allocate(const Buffer &buffer, int priority = 0, std::optional<fvec3> pos = {})
+        {
+            Voice *target = nullptr;
+
+            // Prefer an idle voice.
+            for (Voice &voice : voices)
+            {
+                if (!voice.source.IsPlaying())
+                {
+                    target = &voice;
+                    break;
+                }
+            }
+
+            // Otherwise make a new one, if there's space.
+            if (!target && voices.size() < pool_size)
+            {
+                Source source = nullptr;
+                if (!source)
+                    return nullptr;
+                target = &voices.emplace_back();
+                target->source = std::move(source);
+            }
+
+            // Otherwise try stealing one.
+            if (!target)
+            {
+                fvec3 listener_pos;
+                alGetListenerfv(AL_POSITION, listener_pos.as_array());
+
+                auto least = std::min_element(voices.begin(), voices.end(), [&](const Voice &a, const Voice &b)
+                {
+                    return Importance(a.priority, a.pos, listener_pos, a.start_index) < Importance(b.priority, b.pos, listener_pos, b.start_index);
+                });
+                if (least == voices.end() || Importance(priority, pos, listener_pos, next_start_index) < Importance(least->priority, least->pos, listener_pos, least->start_index))
+                    return nullptr;
+                target = &*least;
+            }
+
+            target->priority = priority;
+            target->pos = pos;
+            target->start_index = next_start_index++;
+
+            target->source.buffer(buffer).reset_parameters();
+            if (pos)
+                target->source.pos(*pos);
+            else
+                target->source.relative();
+            return &target->source;
+        }
+
         // Releases sources that aren't playing (i.e. are stopped, paused, or not played yet).
+        // The pooled sources are kept, to be reused.
         void Tick()
         {
             std::erase_if(sources, [](const std::shared_ptr<Source> &ptr){return !ptr->IsPlaying();});
+            active_voices = std::size_t(std::count_if(voices.begin(), voices.end(), [](const Voice &voice){return voice.source.IsPlaying();}));
         }
 
+        // The number of playing sources, including the pooled ones. The pooled ones are counted as of the last `Tick()`.
         [[nodiscard]] std::size_t ActiveSources() const
         {
-            return sources.size();
+            return sources.size() + active_voices;
         }
     };
 }
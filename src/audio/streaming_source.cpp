@@ -0,0 +1,268 @@
+#include "streaming_source.h"
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "audio/buffer.h"
+#include "audio/ogg_decoder.h"
+
+namespace Audio
+{
+    struct StreamingSource::State
+    {
+        static constexpr std::size_t num_buffers = 4;
+        static constexpr std::size_t chunk_blocks = 16384; // About 0.37 seconds at 44.1 kHz.
+        static constexpr BitResolution resolution = bits_16;
+
+        // Only the main thread touches those.
+        Source source = nullptr;
+        std::array<Buffer, num_buffers> buffers;
+        std::vector<Buffer *> free_buffers;
+        bool want_playing = false;
+
+        // Immutable after construction.
+        bool loop = false;
+        int sampling_rate = 0;
+        Channels channel_count = mono;
+        std::size_t chunk_bytes = 0;
+
+        // Only the decoding thread touches this, after it starts.
+        OggDecoder decoder;
+
+        // Shared, protected by `mutex`.
+        std::mutex mutex;
+        std::condition_variable cond;
+        std::deque<std::vector<std::uint8_t>> ready_chunks; // Decoded, but not queued yet. At most `num_buffers` of them.
+        std::vector<std::vector<std::uint8_t>> spare_chunks; // Already queued, kept around to reuse the memory.
+        bool finished = false; // The decoder reached the end of a non-looping file, or failed.
+        bool stop_thread = false;
+        std::exception_ptr exception;
+
+        std::thread thread;
+
+        State(Stream::Input input, bool loop) : loop(loop), decoder(std::move(input))
+        {
+            sampling_rate = decoder.SamplingRate();
+            channel_count = decoder.ChannelCount();
+            chunk_bytes = chunk_blocks * GetBytesPerBlock(resolution, channel_count);
+
+            for (Buffer &buffer : buffers)
+            {
+                buffer = nullptr;
+                free_buffers.push_back(&buffer);
+            }
+
+            // Decode the first chunk right away, so the playback can start immediately.
+            if (DecodeChunk())
+                thread = std::thread([this]{ThreadFunc();});
+        }
+
+        State(const State &) = delete;
+        State &operator=(const State &) = delete;
+
+        ~State()
+        {
+            {
+                std::lock_guard lock(mutex);
+                stop_thread = true;
+            }
+            cond.notify_all();
+            if (thread.joinable())
+                thread.join();
+
+            // The buffers can't be destroyed while they're queued.
+            source.stop();
+            if (source)
+                alSourcei(source.Handle(), AL_BUFFER, 0);
+        }
+
+        // Decodes one chunk and adds it to `ready_chunks`. Returns false if there's nothing more to decode.
+        bool DecodeChunk()
+        {
+            std::vector<std::uint8_t> chunk;
+            {
+                std::lock_guard lock(mutex);
+                if (!spare_chunks.empty())
+                {
+                    chunk = std::move(spare_chunks.back());
+                    spare_chunks.pop_back();
+                }
+            }
+            chunk.resize(chunk_bytes);
+
+            std::size_t size = 0;
+            bool at_end = false;
+            while (size < chunk_bytes)
+            {
+                std::size_t segment_size = decoder.Read(chunk.data() + size, chunk_bytes - size, resolution);
+                size += segment_size;
+                if (size < chunk_bytes)
+                {
+                    // Stop if the file is over, or if it's empty and rewinding it wouldn't help.
+                    if (!loop || (segment_size == 0 && size == 0))
+                    {
+                        at_end = true;
+                        break;
+                    }
+                    decoder.Rewind();
+                }
+            }
+            chunk.resize(size);
+
+            std::lock_guard lock(mutex);
+            if (size > 0)
+                ready_chunks.push_back(std::move(chunk));
+            if (at_end)
+                finished = true;
+            return !at_end;
+        }
+
+        void ThreadFunc()
+        {
+            try
+            {
+                while (true)
+                {
+                    {
+                        std::unique_lock lock(mutex);
+                        cond.wait(lock, [&]{return stop_thread || ready_chunks.size() < num_buffers;});
+                        if (stop_thread)
+                            return;
+                    }
+
+                    if (!DecodeChunk())
+                        return;
+                }
+            }
+            catch (...)
+            {
+                std::lock_guard lock(mutex);
+                exception = std::current_exception();
+                finished = true;
+            }
+        }
+    };
+
+    StreamingSource::StreamingSource() {}
+
+    StreamingSource::StreamingSource(Stream::Input input, bool loop)
+        : state(std::make_unique<State>(std::move(input), loop))
+    {}
+
+    StreamingSource::StreamingSource(StreamingSource &&) noexcept = default;
+    StreamingSource &StreamingSource::operator=(StreamingSource &&) noexcept = default;
+    StreamingSource::~StreamingSource() = default;
+
+    Source &StreamingSource::GetSource()
+    {
+        return state->source;
+    }
+
+    bool StreamingSource::IsPlaying() const
+    {
+        return state && state->want_playing;
+    }
+
+    StreamingSource &StreamingSource::volume(float v)
+    {
+        if (state)
+            state->source.volume(v);
+        return *this;
+    }
+
+    StreamingSource &StreamingSource::play()
+    {
+        if (state)
+        {
+            state->want_playing = true;
+            Tick(); // This starts the source, if there's anything to play.
+        }
+        return *this;
+    }
+
+    StreamingSource &StreamingSource::pause()
+    {
+        if (state)
+        {
+            state->want_playing = false;
+            state->source.pause();
+        }
+        return *this;
+    }
+
+    void StreamingSource::Tick()
+    {
+        if (!state || !state->source)
+            return;
+
+        State &s = *state;
+        ALuint handle = s.source.Handle();
+
+        // Reclaim the buffers that finished playing.
+        ALint processed = 0;
+        alGetSourcei(handle, AL_BUFFERS_PROCESSED, &processed);
+        while (processed-- > 0)
+        {
+            ALuint buffer_handle = 0;
+            alSourceUnqueueBuffers(handle, 1, &buffer_handle);
+            for (Buffer &buffer : s.buffers)
+            {
+                if (buffer.Handle() == buffer_handle)
+                {
+                    s.free_buffers.push_back(&buffer);
+                    break;
+                }
+            }
+        }
+
+        // Queue the decoded chunks.
+        bool queued_any = false;
+        bool finished = false;
+        {
+            std::lock_guard lock(s.mutex);
+            if (s.exception)
+            {
+                s.want_playing = false;
+                std::rethrow_exception(std::exchange(s.exception, {}));
+            }
+
+            while (!s.free_buffers.empty() && !s.ready_chunks.empty())
+            {
+                std::vector<std::uint8_t> &chunk = s.ready_chunks.front();
+                Buffer &buffer = *s.free_buffers.back();
+                s.free_buffers.pop_back();
+
+                buffer.SetData(s.sampling_rate, s.channel_count, s.resolution, chunk.size() / GetBytesPerBlock(s.resolution, s.channel_count), chunk.data());
+                ALuint buffer_handle = buffer.Handle();
+                alSourceQueueBuffers(handle, 1, &buffer_handle);
+
+                s.spare_chunks.push_back(std::move(chunk));
+                s.ready_chunks.pop_front();
+                queued_any = true;
+            }
+
+            finished = s.finished && s.ready_chunks.empty();
+        }
+        if (queued_any)
+            s.cond.notify_one();
+
+        // Start the source, or restart it after an underrun.
+        if (s.want_playing && !s.source.IsPlaying())
+        {
+            ALint queued = 0;
+            alGetSourcei(handle, AL_BUFFERS_QUEUED, &queued);
+            if (queued > 0)
+                s.source.play();
+            else if (finished)
+                s.want_playing = false;
+        }
+    }
+}
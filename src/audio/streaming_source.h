@@ -0,0 +1,49 @@
+#pragma once
+
+#include <memory>
+
+#include "audio/source.h"
+#include "stream/input.h"
+
+namespace Audio
+{
+    // Plays a long Vorbis file (e.g. music) without decoding it in advance.
+    // A background thread decodes the file piece by piece, and the pieces are queued into a small ring of OpenAL buffers.
+    // All OpenAL calls happen in `Tick()`, which must be called regularly on the main thread, otherwise the playback stops when the queue runs out.
+    class StreamingSource
+    {
+        struct State;
+        std::unique_ptr<State> state;
+
+      public:
+        // Create a null source.
+        StreamingSource();
+
+        // Throws if the file can't be opened. Decoding errors are rethrown from `Tick()`.
+        StreamingSource(Stream::Input input, bool loop = false);
+
+        StreamingSource(StreamingSource &&) noexcept;
+        StreamingSource &operator=(StreamingSource &&) noexcept;
+        ~StreamingSource();
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(state);
+        }
+
+        // The underlying source, to change its parameters.
+        // Don't play, stop or rewind it directly, and don't touch its buffers.
+        [[nodiscard]] Source &GetSource();
+
+        // Returns true if `play()` was called, and the source wasn't paused since then and didn't reach the end.
+        // Unlike `Source::IsPlaying()`, this stays true during buffer underruns.
+        [[nodiscard]] bool IsPlaying() const;
+
+        StreamingSource &volume(float v);
+        StreamingSource &play();
+        StreamingSource &pause();
+
+        // Recycles the buffers that finished playing, queues the newly decoded data, and restarts the playback after an underrun.
+        void Tick();
+    };
+}
@@ -1,13 +1,18 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <atomic>
 #include <concepts>
 #include <cstddef>
 #include <cstdint>
 #include <limits>
 #include <memory>
+#include <span>
+#include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "meta/common.h"
 #include "meta/lists.h"
@@ -119,6 +124,19 @@ namespace Ent
     template <typename T>
     concept ComponentType = (ComponentNonEntityType<T> || ComponentEntityType<T>) && !(ComponentNonEntityType<T> && ComponentEntityType<T>);
 
+    // Inherit a component from this to track its changes.
+    // The non-const `get()` and `set()`, and the `ForEach()` calls with non-const access, stamp it with the current `ChangeVersion()` of the controller.
+    // Creating an entity stamps all its components. Then `entity.ChangedSince<C>(version)` tells if the component was touched since then.
+    struct TrackChanges
+    {
+        // Managed automatically.
+        std::uint64_t changed_version = 0;
+    };
+
+    // A component that tracks its changes, see `TrackChanges`.
+    template <typename T>
+    concept ChangeTrackedComponentType = ComponentType<T> && std::derived_from<T, TrackChanges>;
+
 
     namespace impl
     {
@@ -256,7 +274,6 @@ namespace Ent
     class Entity : public Tag::EntityBase
     {
         __attribute__((const)) virtual int GetComponentCountLow(std::size_t index) const noexcept = 0;
-        __attribute__((const)) virtual const void *GetComponentPtrLow(std::size_t index) const noexcept = 0;
 
         template <ComponentType C>
         __attribute__((const)) int GetComponentCount() const noexcept
@@ -265,18 +282,47 @@ namespace Ent
         }
 
         template <ComponentType C>
-        __attribute__((const)) const C *GetComponentPtr() const noexcept
+        __attribute__((pure)) const C *GetComponentPtr() const noexcept
         {
-            return reinterpret_cast<const C *>(GetComponentPtrLow(ComponentRegistry<Tag>::template Index<C>()));
+            std::ptrdiff_t offset = GetComponentOffset(ComponentRegistry<Tag>::template Index<C>());
+            if (offset < 0)
+                return nullptr;
+            return reinterpret_cast<const C *>(reinterpret_cast<const char *>(this) + offset);
         }
 
       protected:
         // The unique entity index. Indices of destroyed entities can be reused.
         typename Tag::entity_index_t entity_index = 0;
 
+        // Points to the change version of the controller, see `TrackChanges`. Set by the controller.
+        const std::uint64_t *change_clock = nullptr;
+
+        // Component offsets relative to this object, indexed by the component indices. One table per entity type, set by the derived class constructor.
+        // `-1` means the component is missing, `-2` means it's ambiguous.
+        const std::vector<std::ptrdiff_t> *component_offsets = nullptr;
+
+        // Returns the offset of a component relative to this object, or a negative value if it's missing or ambiguous.
+        // This is not virtual, so it's cheap enough to be called in hot loops.
+        [[nodiscard]] __attribute__((pure)) std::ptrdiff_t GetComponentOffset(std::size_t index) const noexcept
+        {
+            if (index >= component_offsets->size())
+                return -1; // This component is not registered (this also handles `-1`).
+            return (*component_offsets)[index];
+        }
+
+        // Stamps a component with the current change version.
+        void StampChange(TrackChanges &component) const noexcept
+        {
+            if (change_clock)
+                component.changed_version = *change_clock;
+        }
+
         // Destroy the entity. Automatically remove it from all lists, etc.
         virtual void Destroy(impl::ControllerBase<Tag> &controller) noexcept = 0;
 
+        // Returns the indices of the lists containing this entity.
+        [[nodiscard]] virtual const std::vector<std::size_t> &ListIndices() const noexcept = 0;
+
       public:
         constexpr Entity() {}
 
@@ -297,10 +343,14 @@ namespace Ent
         }
 
         // Get component by type. Throws if no such component.
+        // If the component tracks changes, it's marked as changed.
         template <ComponentType C>
         [[nodiscard]] C &get()
         {
-            return const_cast<C &>(std::as_const(*this).template get<C>());
+            C &ret = const_cast<C &>(std::as_const(*this).template get<C>());
+            if constexpr (ChangeTrackedComponentType<C>)
+                StampChange(ret);
+            return ret;
         }
         // Get component by type. Throws if no such component.
         template <ComponentType C>
@@ -330,6 +380,20 @@ namespace Ent
             return *this;
         }
 
+        // Returns true if the component was changed at `version` or later. Throws if no such component.
+        template <ChangeTrackedComponentType C>
+        [[nodiscard]] bool ChangedSince(std::uint64_t version) const
+        {
+            return get<C>().changed_version >= version;
+        }
+
+        // Marks a component as changed, e.g. after modifying it through a reference obtained earlier. Throws if no such component.
+        template <ChangeTrackedComponentType C>
+        void MarkChanged()
+        {
+            (void)get<C>();
+        }
+
         // Describes an entity type.
         struct Desc
         {
@@ -358,7 +422,12 @@ namespace Ent
         {
           public:
             using Entity<Tag>::entity_index;
+            using Entity<Tag>::change_clock;
+            using Entity<Tag>::StampChange;
+            using Entity<Tag>::component_offsets;
+            using Entity<Tag>::GetComponentOffset;
             using Entity<Tag>::Destroy;
+            using Entity<Tag>::ListIndices;
         };
     }
 
@@ -383,6 +452,13 @@ namespace Ent
         // Remove an entity from the list. You don't need to support indices larger than the requested capacity.
         // Unlike `Insert` this can't throw.
         virtual void Erase(Entity<Tag> &entity) noexcept = 0;
+        // Remove several entities from the list at once. Each of them must be in the list, and must be mentioned only once.
+        // The default implementation calls `Erase()` for each of them. Override this if erasing in bulk can be done faster.
+        virtual void EraseMany(std::span<Entity<Tag> *const> entities) noexcept
+        {
+            for (Entity<Tag> *entity : entities)
+                Erase(*entity);
+        }
     };
 
     // A concept for list types derived from `List`.
@@ -433,25 +509,49 @@ namespace Ent
 
         void Erase(Entity<Tag> &entity) noexcept override
         {
-            auto entity_index = static_cast<impl::EntityHidden<Tag> &>(entity).entity_index;
-            ASSERT(Robust::less(entity_index, sparse.size()), "Internal error: Entity sparse set is too small.");
-            ASSERT(sparse[entity_index] != index_t(-1), "Internal error: Entity already exists in the sparse set.");
-            std::size_t dense_index = sparse[entity_index];
-            ASSERT(Robust::less(dense_index, dense.size()), "Internal error: Index in the sparse array in the entity sparse set is too small.");
+            Entity<Tag> *ptr = &entity;
+            EraseMany({&ptr, 1});
+        }
 
-            if constexpr (Ordered)
+        // In an ordered set, the elements following the first erased one are shifted only once.
+        void EraseMany(std::span<Entity<Tag> *const> entities) noexcept override
+        {
+            if (entities.empty())
+                return;
+
+            std::size_t first_dense_index = dense.size();
+
+            for (Entity<Tag> *entity : entities)
             {
-                sparse[entity_index] = index_t(-1);
-                dense.erase(dense.begin() + dense_index);
-                for (std::size_t i = dense_index; i < dense.size(); i++)
-                    sparse[static_cast<impl::EntityHidden<Tag> *>(dense[i])->entity_index] = i;
+                auto entity_index = static_cast<impl::EntityHidden<Tag> *>(entity)->entity_index;
+                ASSERT(Robust::less(entity_index, sparse.size()), "Internal error: Entity sparse set is too small.");
+                ASSERT(sparse[entity_index] != index_t(-1), "Internal error: Entity doesn't exist in the sparse set.");
+                std::size_t dense_index = sparse[entity_index];
+                ASSERT(Robust::less(dense_index, dense.size()), "Internal error: Index in the sparse array in the entity sparse set is too small.");
+
+                if constexpr (Ordered)
+                {
+                    // Only mark the entity as removed for now.
+                    sparse[entity_index] = index_t(-1);
+                    first_dense_index = std::min(first_dense_index, dense_index);
+                }
+                else
+                {
+                    sparse[static_cast<impl::EntityHidden<Tag> *>(dense.back())->entity_index] = dense_index;
+                    sparse[entity_index] = index_t(-1);
+                    std::swap(dense[dense_index], dense.back());
+                    dense.pop_back();
+                }
             }
-            else
+
+            if constexpr (Ordered)
             {
-                sparse[static_cast<impl::EntityHidden<Tag> *>(dense.back())->entity_index] = dense_index;
-                sparse[entity_index] = index_t(-1);
-                std::swap(dense[dense_index], dense.back());
-                dense.pop_back();
+                dense.erase(std::remove_if(dense.begin() + first_dense_index, dense.end(), [&](Entity<Tag> *e)
+                {
+                    return sparse[static_cast<impl::EntityHidden<Tag> *>(e)->entity_index] == index_t(-1);
+                }), dense.end());
+                for (std::size_t i = first_dense_index; i < dense.size(); i++)
+                    sparse[static_cast<impl::EntityHidden<Tag> *>(dense[i])->entity_index] = i;
             }
 
             ASSERT(
@@ -474,6 +574,13 @@ namespace Ent
             return dense.size();
         }
 
+        // Random access, in the same order as the iterators. Used by `ParallelForEach()`.
+        [[nodiscard]] Entity<Tag> &operator[](std::size_t i) const
+        {
+            ASSERT(i < dense.size(), "Entity list index is out of range.");
+            return *dense[i];
+        }
+
         [[nodiscard]] auto begin() const {return SimpleIterator::Forward(IterState{dense.begin()});}
         [[nodiscard]] auto end  () const {return SimpleIterator::Forward(IterState{dense.end  ()});}
     };
@@ -669,26 +776,24 @@ namespace Ent
 
             __attribute__((const))
             int GetComponentCountLow(std::size_t index) const noexcept override final
-            {
-                return GetComponentCountLowStatic(index);
-            }
-
-            __attribute__((const))
-            const void *GetComponentPtrLow(std::size_t index) const noexcept override final
             {
                 // Register the components (at compile-time).
                 // Because this function is virtual, this conveniently happens even if it's unused.
                 // The assertion should never fail.
                 static_assert((RegisterComponent<Tag, C>() && ...));
 
-                // Pre-compute the offsets (relative to the tuple) for all known components for this tag.
-                // `-1` means the component is missing.
-                // `-2` means the component is ambiguous.
+                return GetComponentCountLowStatic(index);
+            }
+
+            // Returns the component offsets for `Entity::component_offsets`.
+            static const std::vector<std::ptrdiff_t> &ComponentOffsetTable(const EntityWithComponents *self)
+            {
+                // Pre-compute the offsets (relative to the entity base) for all known components for this tag.
                 static const std::vector<std::ptrdiff_t> offsets = [&]{
                     std::vector<std::ptrdiff_t> offsets(ComponentRegistry<Tag>::Count(), -1);
 
                     // A shame that we have to use an actual instance to compute the offsets.
-                    ForEachComponentRecursively(this, [&]<ComponentType T>(const T *component)
+                    ForEachComponentRecursively(self, [&]<ComponentType T>(const T *component)
                     {
                         std::ptrdiff_t &offset = offsets[ComponentRegistry<Tag>::template Index<T>()];
                         if (offset != -1)
@@ -699,18 +804,13 @@ namespace Ent
                         else
                         {
                             // Save the offset for this base.
-                            offset = reinterpret_cast<const char *>(component) - reinterpret_cast<const char *>(&components);
+                            offset = reinterpret_cast<const char *>(component) - reinterpret_cast<const char *>(static_cast<const Entity<Tag> *>(self));
                         }
                     });
 
                     return offsets;
                 }();
-                if (index == std::size_t(-1))
-                    return nullptr; // This component is not registered.
-                std::ptrdiff_t offset = offsets[index];
-                if (offset < 0)
-                    return nullptr;
-                return reinterpret_cast<const char *>(&components) + offset;
+                return offsets;
             }
 
           public:
@@ -737,7 +837,9 @@ namespace Ent
                         }
                     }()...
                 )
-            {}
+            {
+                this->component_offsets = &ComponentOffsetTable(this);
+            }
 
             struct EntityDesc : Entity<Tag>::Desc
             {
@@ -940,6 +1042,22 @@ namespace Ent
             // Manages entity indices. Should have the same capacity as the size of `entities`.
             SparseSet<typename Tag::entity_index_t> entity_indices;
 
+            // The current change version, see `TrackChanges`. This is a pointer, since the entities point to it, and the controller can be moved.
+            std::unique_ptr<std::uint64_t> change_version;
+
+            // The entities queued by `QueueDestroy()`. Some of them can be expired or repeated.
+            std::vector<Pointer<Tag>> destroy_queue;
+            // Scratch buffers for `DestroyQueued()`. Reserved in `QueueDestroy()`, so that `DestroyQueued()` doesn't need to allocate.
+            std::vector<Entity<Tag> *> destroy_entities;
+            std::vector<std::vector<Entity<Tag> *>> destroy_entities_per_list;
+
+            // Releases the index of an entity and frees it. The entity must be already removed from all lists.
+            void ReleaseEntity(typename Tag::entity_index_t index) noexcept
+            {
+                entity_indices.EraseUnordered(index);
+                entities[index].ptr = nullptr;
+            }
+
             // Returns the class from which the final entity type should be inherited, based on a specific component.
             template <ComponentEntityType C>
             using incomplete_entity_t = typename Tag::template EntityAdditions<
@@ -975,6 +1093,18 @@ namespace Ent
             {
                 using incomplete_entity_t<C>::incomplete_entity_t;
 
+                // Stamps all components that track changes.
+                void StampAllChanges() noexcept
+                {
+                    std::apply([&](auto &... components)
+                    {
+                        ([&]{
+                            if constexpr (ChangeTrackedComponentType<std::remove_cvref_t<decltype(components)>>)
+                                this->StampChange(components);
+                        }(), ...);
+                    }, this->components);
+                }
+
                 void Destroy(ControllerBase &con) noexcept override
                 {
                     // Remove the entity from lists.
@@ -986,11 +1116,13 @@ namespace Ent
                     // Increment the generation.
                     con.entities[index].generation++;
 
-                    // Release the index.
-                    con.entity_indices.EraseUnordered(index);
+                    // Release the index and destroy self.
+                    con.ReleaseEntity(index);
+                }
 
-                    // Destroy self.
-                    con.entities[index].ptr = nullptr;
+                const std::vector<std::size_t> &ListIndices() const noexcept override
+                {
+                    return GetEntityListIndices<C>();
                 }
             };
 
@@ -1004,6 +1136,7 @@ namespace Ent
             [[nodiscard]] static Controller<Tag> MakeController()
             {
                 Controller<Tag> ret;
+                ret.change_version = std::make_unique<std::uint64_t>(1);
                 for (std::size_t i = 0; i < CategoryRegistry<Tag>::Count(); i++)
                     ret.lists.push_back(CategoryRegistry<Tag>::State().list_factory_funcs[i]());
                 return ret;
@@ -1021,6 +1154,20 @@ namespace Ent
                 return entities.size(); // Sic.
             }
 
+            // Returns the current change version, see `TrackChanges`. Starts at 1.
+            [[nodiscard]] std::uint64_t ChangeVersion() const
+            {
+                return change_version ? *change_version : 0;
+            }
+
+            // Increments the change version, normally once per tick.
+            // A system can remember the version it last ran at, then process only the entities with `ChangedSince<C>(version)`.
+            void NextChangeVersion()
+            {
+                if (change_version)
+                    ++*change_version;
+            }
+
             // Returns the max possible capacity, which depends on `Tag::entity_index_t`.
             [[nodiscard]] static std::size_t MaxPossibleCapacity()
             {
@@ -1068,6 +1215,8 @@ namespace Ent
                 new_entity.ptr = entity_unique_ptr_t(Tag::template Allocate<FinalEntity<C>>(impl::MemoryManagementTag{}, std::forward<P>(params)...));
                 FINALLY_ON_THROW( new_entity.ptr = nullptr; )
                 static_cast<impl::EntityHidden<Tag> &>(*new_entity.ptr).entity_index = new_index;
+                static_cast<impl::EntityHidden<Tag> &>(*new_entity.ptr).change_clock = change_version.get();
+                static_cast<FinalEntity<C> &>(*new_entity.ptr).StampAllChanges();
 
                 // Indices of lists to which the entity should be added.
                 const auto& list_indices = GetEntityListIndices<C>();
@@ -1103,6 +1252,74 @@ namespace Ent
                     Destroy(*e);
             }
 
+            // Queues an entity for destruction. It stays alive until `DestroyQueued()` is called.
+            // Use this to destroy entities while iterating over their lists.
+            // The same entity can be queued several times, and it can be destroyed with `Destroy()` before it's flushed.
+            void QueueDestroy(Entity<Tag> &e)
+            {
+                destroy_queue.push_back(operator()(e));
+
+                if (destroy_entities.capacity() < destroy_queue.capacity())
+                {
+                    destroy_entities.reserve(destroy_queue.capacity());
+                    destroy_entities_per_list.resize(lists.size());
+                    for (auto &list_entities : destroy_entities_per_list)
+                        list_entities.reserve(destroy_queue.capacity());
+                }
+            }
+            // Queues an entity for destruction. Does nothing if the pointer is null.
+            void QueueDestroy(Entity<Tag> *p)
+            {
+                if (p)
+                    QueueDestroy(*p);
+            }
+            // Queues an entity for destruction. Does nothing if the pointer is null or expired.
+            void QueueDestroy(const Pointer<Tag> &p)
+            {
+                if (auto e = operator()(p))
+                    QueueDestroy(*e);
+            }
+
+            // Returns the number of queued entities, including the repeated and already destroyed ones.
+            [[nodiscard]] std::size_t QueuedDestroyCount() const
+            {
+                return destroy_queue.size();
+            }
+
+            // Destroys the entities queued by `QueueDestroy()`, skipping the ones that are already destroyed.
+            // Erases them from each list in one go, which is cheaper than destroying them one by one.
+            void DestroyQueued() noexcept
+            {
+                if (destroy_queue.empty())
+                    return;
+
+                // Collect the entities and sort them by list.
+                // Incrementing the generation right away expires the pointers, which skips the duplicates.
+                for (const Pointer<Tag> &p : destroy_queue)
+                {
+                    Entity<Tag> *e = operator()(p);
+                    if (!e)
+                        continue;
+                    entities[p.index].generation++;
+                    destroy_entities.push_back(e);
+                    for (std::size_t i : static_cast<impl::EntityHidden<Tag> *>(e)->ListIndices())
+                        destroy_entities_per_list[i].push_back(e);
+                }
+                destroy_queue.clear();
+
+                for (std::size_t i = 0; i < destroy_entities_per_list.size(); i++)
+                {
+                    if (destroy_entities_per_list[i].empty())
+                        continue;
+                    lists[i]->EraseMany(destroy_entities_per_list[i]);
+                    destroy_entities_per_list[i].clear();
+                }
+
+                for (Entity<Tag> *e : destroy_entities)
+                    ReleaseEntity(static_cast<impl::EntityHidden<Tag> *>(e)->entity_index);
+                destroy_entities.clear();
+            }
+
             // Provides access to an entity list.
             // The parameter is non-const to discourage ad-hoc (rvalue) categories, since creating too many categories can get expensive.
             template <CategoryType<Tag> C>
@@ -1112,12 +1329,51 @@ namespace Ent
                 return static_cast<impl::ListFromCategory<C> &>(*lists[CategoryRegistry<Tag>::template Index<C>()]);
             }
 
+            // Calls `func(entity, components...)` for each entity in a category, where `components...` are references to the components `C...`.
+            // Throws if an entity doesn't have one of the components.
+            // This is faster than calling `get<C>()` in a loop, since the component offsets are only looked up when the entity type changes.
+            // Prefer `SparseSetGroupedByType` lists for this, then each type is looked up only once.
+            // Same as when iterating over the list manually, don't create or destroy the entities of this category in `func`.
+            template <ComponentType ...C, CategoryType<Tag> Cat, typename F>
+            void ForEach(Cat &category, F &&func) const
+            {
+                const std::array<std::size_t, sizeof...(C)> indices = {ComponentRegistry<Tag>::template Index<C>()...};
+                std::array<std::ptrdiff_t, sizeof...(C)> offsets{};
+                const std::vector<std::ptrdiff_t> *cur_table = nullptr;
+
+                for (Entity<Tag> &e : operator()(category))
+                {
+                    auto &hidden = static_cast<impl::EntityHidden<Tag> &>(e);
+                    if (hidden.component_offsets != cur_table) [[unlikely]]
+                    {
+                        cur_table = hidden.component_offsets;
+                        for (std::size_t i = 0; i < sizeof...(C); i++)
+                            offsets[i] = hidden.GetComponentOffset(indices[i]);
+                        if (std::any_of(offsets.begin(), offsets.end(), [](std::ptrdiff_t offset){return offset < 0;}))
+                        {
+                            // Let `get()` throw with a nice message.
+                            ((void)e.template get<C>(), ...);
+                        }
+                    }
+
+                    [&]<std::size_t ...I>(std::index_sequence<I...>)
+                    {
+                        ([&]{
+                            if constexpr (ChangeTrackedComponentType<C>)
+                                hidden.StampChange(*reinterpret_cast<C *>(reinterpret_cast<char *>(&e) + offsets[I]));
+                        }(), ...);
+                        func(e, *reinterpret_cast<C *>(reinterpret_cast<char *>(&e) + offsets[I])...);
+                    }(std::make_index_sequence<sizeof...(C)>{});
+                }
+            }
+
             // Forms a pointer to an entity.
             [[nodiscard]] Pointer<Tag> operator()(Entity<Tag> &e) const
             {
                 Pointer<Tag> ret;
                 ret.index = static_cast<impl::EntityHidden<Tag> &>(e).entity_index;
                 ret.generation = entities[ret.index].generation;
+                return ret;
             }
             // Forms a const pointer to an entity.
             [[nodiscard]] ConstPointer<Tag> operator()(const Entity<Tag> &e) const
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "entities/base.h"
+#include "entities/mixin_pooled_allocation.h"
+#include "program/errors.h"
+#include "utils/robust_math.h"
+
+namespace Ent::Mixins
+{
+    // Stores the entities of each type in contiguous chunks, instead of allocating them individually.
+    // The entities of the same type (i.e. with the same set of components) are kept together, so iterating over them is mostly linear in memory.
+    // Unlike `PooledAllocation`, each entity type gets its own pool.
+    // Combine with `Ent::SparseSetGroupedByType` lists to iterate over one type at a time.
+    // Not thread-safe, same as the rest of the controller.
+    template <typename FinalTag, typename BaseMixin>
+    struct ArchetypeStorage : BaseMixin
+    {
+        template <typename T, Meta::deduce..., typename ...P>
+        [[nodiscard]] static T *Allocate(Ent::impl::MemoryManagementTag, P &&... params)
+        {
+            return impl::PooledAllocation::AllocateFromPool<T, impl::PooledAllocation::Pool<sizeof(T), alignof(T), T>>(std::forward<P>(params)...);
+        }
+
+        template <Meta::deduce..., typename T>
+        static void Free(Ent::impl::MemoryManagementTag, T *memory) noexcept
+        {
+            impl::PooledAllocation::FreeToPool(memory);
+        }
+    };
+}
+
+namespace Ent
+{
+    // An unordered list that keeps the entities of the same type together, in the same order as their types were first inserted.
+    // Use `Groups()` to iterate over one type at a time, e.g. to process similar entities in a tight loop.
+    // Inserting and erasing costs O(number of types), since an element of each following group has to be moved.
+    // NOTE: Same as `SparseSetUnordered`, deleting an element makes the iterators that were pointing to it point to a different element.
+    template <TagType Tag>
+    class SparseSetGroupedByType : public List<Tag>
+    {
+        using index_t = typename Tag::entity_index_t;
+
+      public:
+        struct Group
+        {
+            const typename Entity<Tag>::Desc *desc = nullptr; // Identifies the entity type.
+            std::size_t begin = 0, end = 0; // A range in `dense`.
+        };
+
+      private:
+        std::vector<Entity<Tag> *> dense;
+        std::vector<index_t> sparse;
+        std::vector<Group> groups;
+
+        struct IterState
+        {
+            typename decltype(dense)::const_iterator vec_iter{};
+
+            bool operator==(const IterState &) const = default;
+
+            Entity<Tag> &operator()(std::false_type) const
+            {
+                return **vec_iter;
+            }
+
+            void operator()(std::true_type)
+            {
+                vec_iter++;
+            }
+        };
+
+        [[nodiscard]] static index_t EntityIndex(Entity<Tag> *entity)
+        {
+            return static_cast<Ent::impl::EntityHidden<Tag> *>(entity)->entity_index;
+        }
+
+        void Place(std::size_t dense_index, Entity<Tag> *entity)
+        {
+            dense[dense_index] = entity;
+            sparse[EntityIndex(entity)] = dense_index;
+        }
+
+      public:
+        void IncreaseCapacity(std::size_t new_capacity) override
+        {
+            sparse.resize(new_capacity, index_t(-1));
+        }
+
+        void Insert(Entity<Tag> &entity) override
+        {
+            auto entity_index = EntityIndex(&entity);
+            ASSERT(Robust::less(entity_index, sparse.size()), "Internal error: Entity sparse set is too small.");
+            ASSERT(sparse[entity_index] == index_t(-1), "Internal error: Entity already exists in the sparse set.");
+
+            const auto *desc = &entity.Description();
+            auto group_it = std::find_if(groups.begin(), groups.end(), [&](const Group &g){return g.desc == desc;});
+            if (group_it == groups.end())
+                group_it = groups.insert(groups.end(), Group{desc, dense.size(), dense.size()});
+
+            // Open a hole at the end of the target group, by moving the first element of each following group to its end.
+            dense.emplace_back();
+            std::size_t hole = dense.size() - 1;
+            for (auto it = groups.end(); --it != group_it;)
+            {
+                if (it->begin != it->end)
+                {
+                    Place(hole, dense[it->begin]);
+                    hole = it->begin;
+                }
+                it->begin++;
+                it->end++;
+            }
+            Place(hole, &entity);
+            group_it->end++;
+        }
+
+        void Erase(Entity<Tag> &entity) noexcept override
+        {
+            auto entity_index = EntityIndex(&entity);
+            ASSERT(Robust::less(entity_index, sparse.size()), "Internal error: Entity sparse set is too small.");
+            ASSERT(sparse[entity_index] != index_t(-1), "Internal error: Entity doesn't exist in the sparse set.");
+            std::size_t dense_index = sparse[entity_index];
+
+            auto group_it = std::find_if(groups.begin(), groups.end(), [&](const Group &g){return dense_index >= g.begin && dense_index < g.end;});
+            ASSERT(group_it != groups.end(), "Internal error: Entity is not in any group.");
+
+            // Fill the hole with the last element of the group, then move the hole to the end of `dense` by doing the same for each following group.
+            std::size_t hole = dense_index;
+            for (auto it = group_it; it != groups.end(); it++)
+            {
+                if (it != group_it)
+                {
+                    if (it->begin == it->end)
+                    {
+                        // An empty group, only shift its bounds.
+                        it->begin--;
+                        it->end--;
+                        continue;
+                    }
+                    it->begin--;
+                }
+
+                std::size_t last = it->end - 1;
+                if (hole != last)
+                    Place(hole, dense[last]);
+                hole = last;
+                it->end--;
+            }
+            dense.pop_back();
+            sparse[entity_index] = index_t(-1);
+        }
+
+        // Return the current list size.
+        [[nodiscard]] std::size_t size() const
+        {
+            return dense.size();
+        }
+
+        // Random access, in the same order as the iterators. Used by `ParallelForEach()`.
+        [[nodiscard]] Entity<Tag> &operator[](std::size_t i) const
+        {
+            ASSERT(i < dense.size(), "Entity list index is out of range.");
+            return *dense[i];
+        }
+
+        [[nodiscard]] auto begin() const {return SimpleIterator::Forward(IterState{dense.begin()});}
+        [[nodiscard]] auto end  () const {return SimpleIterator::Forward(IterState{dense.end  ()});}
+
+        // The entity types in this list, in the order of first insertion. Some groups can be empty.
+        [[nodiscard]] const std::vector<Group> &Groups() const
+        {
+            return groups;
+        }
+
+        // The entities of one group.
+        [[nodiscard]] std::span<Entity<Tag> *const> GroupEntities(const Group &group) const
+        {
+            return std::span<Entity<Tag> *const>(dense.data() + group.begin, group.end - group.begin);
+        }
+    };
+}
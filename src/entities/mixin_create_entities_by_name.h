@@ -1,14 +1,19 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <functional>
-#include <map>
+#include <optional>
+#include <string_view>
+#include <utility>
 
 #include "entities/base.h"
 #include "meta/common.h"
 #include "meta/type_info.h"
 #include "reflection/full.h"
 #include "strings/format.h"
+#include "utils/flat_hash.h"
+#include "utils/symbol.h"
 
 namespace Ent::Mixins
 {
@@ -18,9 +23,9 @@ namespace Ent::Mixins
         template <TagType Tag>
         using factory_func_t = Entity<Tag> &(*)(Ent::impl::ControllerBase<Tag> &con);
 
-        // A map of `factory_func_t` functions.
+        // A map of `factory_func_t` functions, keyed on the interned reflected names.
         template <TagType Tag>
-        using factory_func_map_t = std::map<std::string, factory_func_t<Tag>, std::less<>>;
+        using factory_func_map_t = FlatMap<Symbol, factory_func_t<Tag>>;
 
         // Returns a singleton for the factory function map.
         template <TagType Tag>
@@ -49,13 +54,13 @@ namespace Ent::Mixins
                 {
                     return con.template Create<E>();
                 };
-                bool ok = impl::CreateEntitiesByName::FactoryFuncs<FinalTag>().try_emplace(Refl::Class::name<E>, factory_func).second;
+                bool ok = impl::CreateEntitiesByName::FactoryFuncs<FinalTag>().try_emplace(Symbol(Refl::Class::name<E>), factory_func).second;
                 if (!ok)
                     Program::Error(FMT("Attempt to register a duplicate entity type `{}` for tag `{}`.", Refl::Class::name<E>, Meta::TypeName<FinalTag>()));
                 return nullptr;
             }();
 
-            [[maybe_unused]] static constexpr Meta::value_tag<&dummy> dummy_helper;
+            [[maybe_unused]] static constexpr Meta::value_tag<&dummy> dummy_helper{};
         };
 
       public:
@@ -94,13 +99,61 @@ namespace Ent::Mixins
         template <typename Base>
         struct ControllerAdditions : BaseMixin::template ControllerAdditions<Base>
         {
-            Entity<FinalTag> &CreateByName(std::string_view name)
+          private:
+            [[nodiscard]] static impl::CreateEntitiesByName::factory_func_t<FinalTag> FindFactoryFunc(Symbol name)
             {
                 const auto &map = impl::CreateEntitiesByName::FactoryFuncs<FinalTag>();
                 auto it = map.find(name);
                 if (it == map.end())
+                    Program::Error(FMT("Unknown entity type `{}` in tag `{}`.", name.View(), Meta::TypeName<FinalTag>()));
+                return it->second;
+            }
+
+            // Doesn't intern the unknown names.
+            [[nodiscard]] static Symbol FindName(std::string_view name)
+            {
+                std::optional<Symbol> ret = Symbol::Find(name);
+                if (!ret)
                     Program::Error(FMT("Unknown entity type `{}` in tag `{}`.", name, Meta::TypeName<FinalTag>()));
-                return it->second(*this);
+                return *ret;
+            }
+
+          public:
+            // The `Symbol` overloads skip hashing the string, prefer them if the same name is used repeatedly.
+            Entity<FinalTag> &CreateByName(Symbol name)
+            {
+                return FindFactoryFunc(name)(*this);
+            }
+            Entity<FinalTag> &CreateByName(std::string_view name)
+            {
+                return CreateByName(FindName(name));
+            }
+
+            // Creates `count` entities of the same type, and calls `func(Entity<FinalTag> &)` for each of them.
+            // Looks up the name once, and increases the capacity once.
+            template <typename F>
+            void CreateManyByName(Symbol name, std::size_t count, F &&func)
+            {
+                auto factory_func = FindFactoryFunc(name);
+
+                if (this->EntityCount() + count > this->Capacity())
+                    this->IncreaseCapacity(std::max(this->EntityCount() + count, this->Capacity() * FinalTag::capacity_growth_num / FinalTag::capacity_growth_den + 1));
+
+                for (std::size_t i = 0; i < count; i++)
+                    func(factory_func(*this));
+            }
+            template <typename F>
+            void CreateManyByName(std::string_view name, std::size_t count, F &&func)
+            {
+                CreateManyByName(FindName(name), count, std::forward<F>(func));
+            }
+            void CreateManyByName(Symbol name, std::size_t count)
+            {
+                CreateManyByName(name, count, [](Entity<FinalTag> &){});
+            }
+            void CreateManyByName(std::string_view name, std::size_t count)
+            {
+                CreateManyByName(FindName(name), count);
             }
 
             // Touching this registers entity `E`.
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "entities/base.h"
+#include "macros/finally.h"
+#include "meta/type_info.h"
+#include "program/errors.h"
+#include "strings/format.h"
+#include "utils/jobs.h"
+
+namespace Ent::Mixins
+{
+    namespace impl::ParallelIteration
+    {
+        // Remembers which components are accessed by the running `ParallelForEach()` calls, to catch the conflicting ones.
+        // Only used in debug builds.
+        template <TagType Tag>
+        class AccessTracker
+        {
+            std::mutex mutex;
+            std::vector<int> state; // Indexed by component indices. The number of readers, or -1 if being written.
+
+          public:
+            // Registers the accesses, or throws if they conflict with the existing ones.
+            // This throws instead of a hard error, since it can run in a job, where exiting the program would deadlock.
+            template <typename ...A>
+            void Acquire()
+            {
+                std::lock_guard lock(mutex);
+                state.resize(ComponentRegistry<Tag>::Count());
+
+                // Check everything first, so nothing is registered on failure.
+                ([&]{
+                    int cur = state[ComponentRegistry<Tag>::template Index<std::remove_const_t<A>>()];
+                    if (std::is_const_v<A> ? cur < 0 : cur != 0)
+                    {
+                        Program::Error(FMT("Attempt to {} component `{}`, which is being {} by another `ParallelForEach()`.",
+                            std::is_const_v<A> ? "read" : "write", Meta::TypeName<std::remove_const_t<A>>(), cur < 0 ? "written" : "read"));
+                    }
+                }(), ...);
+
+                ([&]{
+                    int &cur = state[ComponentRegistry<Tag>::template Index<std::remove_const_t<A>>()];
+                    if constexpr (std::is_const_v<A>)
+                        cur++;
+                    else
+                        cur = -1;
+                }(), ...);
+            }
+
+            template <typename ...A>
+            void Release() noexcept
+            {
+                std::lock_guard lock(mutex);
+                ([&]{
+                    int &cur = state[ComponentRegistry<Tag>::template Index<std::remove_const_t<A>>()];
+                    if constexpr (std::is_const_v<A>)
+                        cur--;
+                    else
+                        cur = 0;
+                }(), ...);
+            }
+        };
+    }
+
+    // Adds `ParallelForEach()` to the controller, which iterates over a category using the job pool.
+    template <typename FinalTag, typename BaseMixin>
+    struct ParallelIteration : BaseMixin
+    {
+        template <typename Base>
+        struct ControllerAdditions : BaseMixin::template ControllerAdditions<Base>
+        {
+          private:
+            #ifndef NDEBUG
+            std::unique_ptr<impl::ParallelIteration::AccessTracker<FinalTag>> access_tracker = std::make_unique<impl::ParallelIteration::AccessTracker<FinalTag>>();
+            #endif
+
+          public:
+            using BaseMixin::template ControllerAdditions<Base>::ControllerAdditions;
+
+            // Same as `ForEach()`, but splits the list into chunks of `chunk_size` entities (or picks the size automatically if 0), and processes them in parallel.
+            // The list must support random access, like `SparseSetOrdered` or `SparseSetUnordered`.
+            // `A...` are the components passed to `func`. Add `const` to the ones that are only read, e.g. `ParallelForEach<const Pos, Vel>(...)`.
+            // `func` is called concurrently, so it must only modify the components it writes, and its own per-thread data (see `Jobs::PerThread`).
+            // In debug builds, throws if the running `ParallelForEach()` calls (e.g. the nested ones) access the same components, unless all of them only read.
+            // Don't create or destroy entities in `func`. `QueueDestroy()` isn't thread-safe either, collect them into per-thread lists instead.
+            template <typename ...A, CategoryType<FinalTag> Cat, typename F>
+            void ParallelForEach(Cat &category, F &&func, std::size_t chunk_size = 0) const
+            {
+                static_assert((ComponentType<std::remove_const_t<A>> && ...), "The template parameters must be components, optionally const.");
+
+                #ifndef NDEBUG
+                access_tracker->template Acquire<A...>();
+                FINALLY( access_tracker->template Release<A...>(); )
+                #endif
+
+                const auto &list = this->operator()(category);
+                std::size_t count = list.size();
+                if (count == 0)
+                    return;
+
+                Jobs::Pool &pool = Jobs::DefaultPool();
+                if (chunk_size == 0)
+                    chunk_size = std::max(std::size_t(1), count / ((pool.ThreadCount() + 1) * 4));
+
+                const std::array<std::size_t, sizeof...(A)> indices = {ComponentRegistry<FinalTag>::template Index<std::remove_const_t<A>>()...};
+
+                pool.ParallelFor((count + chunk_size - 1) / chunk_size, [&](std::size_t chunk)
+                {
+                    std::array<std::ptrdiff_t, sizeof...(A)> offsets{};
+                    const std::vector<std::ptrdiff_t> *cur_table = nullptr;
+
+                    std::size_t end = std::min(count, (chunk + 1) * chunk_size);
+                    for (std::size_t i = chunk * chunk_size; i < end; i++)
+                    {
+                        Entity<FinalTag> &e = list[i];
+                        auto &hidden = static_cast<Ent::impl::EntityHidden<FinalTag> &>(e);
+                        if (hidden.component_offsets != cur_table) [[unlikely]]
+                        {
+                            cur_table = hidden.component_offsets;
+                            for (std::size_t j = 0; j < sizeof...(A); j++)
+                                offsets[j] = hidden.GetComponentOffset(indices[j]);
+                            if (std::any_of(offsets.begin(), offsets.end(), [](std::ptrdiff_t offset){return offset < 0;}))
+                            {
+                                // Let `get()` throw with a nice message.
+                                ((void)e.template get<std::remove_const_t<A>>(), ...);
+                            }
+                        }
+
+                        [&]<std::size_t ...I>(std::index_sequence<I...>)
+                        {
+                            ([&]{
+                                if constexpr (!std::is_const_v<A> && ChangeTrackedComponentType<A>)
+                                    hidden.StampChange(*reinterpret_cast<A *>(reinterpret_cast<char *>(&e) + offsets[I]));
+                            }(), ...);
+                            func(e, *reinterpret_cast<A *>(reinterpret_cast<char *>(&e) + offsets[I])...);
+                        }(std::make_index_sequence<sizeof...(A)>{});
+                    }
+                }, 1);
+            }
+        };
+    };
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include "entities/base.h"
+
+namespace Ent::Mixins
+{
+    namespace impl::PooledAllocation
+    {
+        // The chunks are aligned to their size, so the chunk of an entity can be found from its address.
+        inline constexpr std::size_t chunk_size = 1 << 16;
+
+        // The entity sizes are rounded up to a multiple of this.
+        inline constexpr std::size_t size_class_granularity = 32;
+
+        struct ChunkHeader
+        {
+            // Returns a slot to the pool that owns this chunk.
+            void (*free_slot)(void *slot) noexcept = nullptr;
+        };
+
+        // Allocates the slots of size `SlotSize` and alignment `SlotAlign` from the chunks.
+        // One instance per set of template parameters. `Key` lets different types use separate pools even if their sizes match.
+        // The chunks are never returned to the heap, the freed slots are reused by the next allocations (the most recently freed first, since it's likely to be in the cache).
+        template <std::size_t SlotSize, std::size_t SlotAlign, typename Key = void>
+        class Pool
+        {
+            static constexpr std::size_t slot_align = std::max(SlotAlign, alignof(void *));
+            static constexpr std::size_t slot_size = (std::max(SlotSize, sizeof(void *)) + slot_align - 1) / slot_align * slot_align;
+            static constexpr std::size_t first_slot_offset = (sizeof(ChunkHeader) + slot_align - 1) / slot_align * slot_align;
+            static constexpr std::size_t slots_per_chunk = (chunk_size - first_slot_offset) / slot_size;
+            static_assert(slots_per_chunk >= 16, "This entity type is too large for pooled allocation.");
+            static_assert(slot_align <= chunk_size);
+
+            struct FreeSlot
+            {
+                FreeSlot *next;
+            };
+
+            FreeSlot *free_slots = nullptr;
+            std::vector<void *> chunks;
+
+            Pool() {}
+
+            void AddChunk()
+            {
+                void *chunk = ::operator new(chunk_size, std::align_val_t(chunk_size));
+                ::new(chunk) ChunkHeader{[](void *slot) noexcept {Get().ReleaseSlot(slot);}};
+                chunks.push_back(chunk);
+
+                // Push the slots in reverse, so they're used in the order of addresses.
+                char *first = static_cast<char *>(chunk) + first_slot_offset;
+                for (std::size_t i = slots_per_chunk; i-- > 0;)
+                    free_slots = ::new(first + i * slot_size) FreeSlot{free_slots};
+            }
+
+          public:
+            Pool(const Pool &) = delete;
+            Pool &operator=(const Pool &) = delete;
+
+            [[nodiscard]] static Pool &Get()
+            {
+                static Pool ret;
+                return ret;
+            }
+
+            [[nodiscard]] void *AllocateSlot()
+            {
+                if (!free_slots)
+                    AddChunk();
+                return std::exchange(free_slots, free_slots->next);
+            }
+
+            void ReleaseSlot(void *slot) noexcept
+            {
+                free_slots = ::new(slot) FreeSlot{free_slots};
+            }
+
+            // The max number of objects in a chunk.
+            [[nodiscard]] static constexpr std::size_t SlotsPerChunk()
+            {
+                return slots_per_chunk;
+            }
+
+            // The number of allocated chunks.
+            [[nodiscard]] std::size_t ChunkCount() const
+            {
+                return chunks.size();
+            }
+        };
+
+        // Constructs a `T` in a slot from `PoolT`.
+        template <typename T, typename PoolT, typename ...P>
+        [[nodiscard]] T *AllocateFromPool(P &&... params)
+        {
+            auto &pool = PoolT::Get();
+            void *slot = pool.AllocateSlot();
+            try
+            {
+                return ::new(slot) T(std::forward<P>(params)...);
+            }
+            catch (...)
+            {
+                pool.ReleaseSlot(slot);
+                throw;
+            }
+        }
+
+        // Destroys an object allocated with `AllocateFromPool`, and returns its slot to the pool. `T` can be a polymorphic base.
+        template <typename T>
+        void FreeToPool(T *memory) noexcept
+        {
+            // We receive a base class pointer, so find the complete object first.
+            void *slot = dynamic_cast<void *>(memory);
+            memory->~T(); // The destructor is virtual.
+
+            auto *chunk = reinterpret_cast<ChunkHeader *>(reinterpret_cast<std::uintptr_t>(slot) & ~std::uintptr_t(chunk_size - 1));
+            chunk->free_slot(slot);
+        }
+    }
+
+    // Allocates the entities from the pools, one per size class, instead of allocating them individually.
+    // Spawning and destroying entities often (shots, effects) then reuses the same memory instead of hitting the general-purpose allocator.
+    // The entity types of similar sizes share the pools. Use `ArchetypeStorage` instead to give each type its own pool.
+    // Not thread-safe, same as the rest of the controller.
+    template <typename FinalTag, typename BaseMixin>
+    struct PooledAllocation : BaseMixin
+    {
+        template <typename T, Meta::deduce..., typename ...P>
+        [[nodiscard]] static T *Allocate(Ent::impl::MemoryManagementTag, P &&... params)
+        {
+            constexpr std::size_t g = impl::PooledAllocation::size_class_granularity;
+            return impl::PooledAllocation::AllocateFromPool<T, impl::PooledAllocation::Pool<(sizeof(T) + g - 1) / g * g, alignof(T), FinalTag>>(std::forward<P>(params)...);
+        }
+
+        template <Meta::deduce..., typename T>
+        static void Free(Ent::impl::MemoryManagementTag, T *memory) noexcept
+        {
+            impl::PooledAllocation::FreeToPool(memory);
+        }
+    };
+}
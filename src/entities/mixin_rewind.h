@@ -0,0 +1,316 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "entities/base.h"
+#include "meta/common.h"
+#include "program/errors.h"
+#include "utils/flat_hash.h"
+#include "utils/timeline.h"
+
+namespace Ent
+{
+    // A component that is recorded by `Mixins::Rewind`. Add `static constexpr bool rewindable = true;` to opt in.
+    // It must be trivially copyable, since it's stored as raw bytes.
+    template <typename T>
+    concept RewindableComponentType = ComponentType<T> && requires{requires T::rewindable;};
+}
+
+namespace Ent::Mixins
+{
+    namespace impl::Rewind
+    {
+        // A type-erased `Timeline` of a single component.
+        struct ComponentTimeline
+        {
+            virtual ~ComponentTimeline() = default;
+
+            virtual void Append(const void *component) = 0;
+            virtual void Load(int index, void *component) const = 0;
+            virtual void Truncate(int new_size) = 0;
+            [[nodiscard]] virtual std::size_t MemoryUsage() const = 0;
+        };
+
+        template <RewindableComponentType C>
+        struct ComponentTimelineFor final : ComponentTimeline
+        {
+            static_assert(std::is_trivially_copyable_v<C>, "Rewindable components must be trivially copyable.");
+
+            Timeline<C> timeline;
+
+            void Append(const void *component) override
+            {
+                timeline.Append(*static_cast<const C *>(component));
+            }
+
+            void Load(int index, void *component) const override
+            {
+                *static_cast<C *>(component) = timeline.Get(index);
+            }
+
+            void Truncate(int new_size) override
+            {
+                timeline.Truncate(new_size);
+            }
+
+            std::size_t MemoryUsage() const override
+            {
+                return timeline.MemoryUsage();
+            }
+        };
+
+        // Describes the rewindable parts of an entity type.
+        template <TagType Tag>
+        struct TypeInfo
+        {
+            // Re-creates a destroyed entity, or null if the entity isn't default-constructible.
+            Entity<Tag> &(*factory)(Ent::impl::ControllerBase<Tag> &con) = nullptr;
+
+            struct Component
+            {
+                std::size_t index = 0; // In the `ComponentRegistry`.
+                std::unique_ptr<ComponentTimeline> (*make_timeline)() = nullptr;
+            };
+            std::vector<Component> components;
+        };
+    }
+
+    // Records the rewindable components (see `RewindableComponentType`) of the entities in a category, once per tick, and restores them to any recorded tick.
+    // The states are delta-encoded by `Timeline`, so the memory grows with the number of changes, rather than with the number of entities.
+    // Restoring also destroys the entities created after that tick, and re-creates the destroyed ones (with new indices, so the old `Pointer`s stay expired).
+    // The re-created entities get the recorded rewindable components, and default-constructed other components.
+    // Entities should only leave the recorded category by being destroyed, otherwise a restore can create a duplicate.
+    template <typename FinalTag, typename BaseMixin>
+    struct Rewind : BaseMixin
+    {
+        struct EntityBase : BaseMixin::EntityBase
+        {
+            [[nodiscard]] virtual const impl::Rewind::TypeInfo<FinalTag> &GetRewindTypeInfo() const = 0;
+        };
+
+        template <typename Base>
+        struct EntityAdditions : BaseMixin::template EntityAdditions<Base>
+        {
+          private:
+            using typename Base::primary_component_t;
+            using typename Base::component_types_t;
+
+          public:
+            using BaseMixin::template EntityAdditions<Base>::EntityAdditions;
+
+            const impl::Rewind::TypeInfo<FinalTag> &GetRewindTypeInfo() const override
+            {
+                static const impl::Rewind::TypeInfo<FinalTag> ret = []{
+                    impl::Rewind::TypeInfo<FinalTag> ret;
+                    if constexpr (std::is_default_constructible_v<decltype(EntityAdditions::components)>)
+                    {
+                        ret.factory = [](Ent::impl::ControllerBase<FinalTag> &con) -> Entity<FinalTag> &
+                        {
+                            return con.template Create<primary_component_t>();
+                        };
+                    }
+                    Meta::cexpr_for<Meta::list_size<component_types_t>>([&](auto index)
+                    {
+                        using component_t = Meta::list_type_at<component_types_t, decltype(index)::value>;
+                        if constexpr (RewindableComponentType<component_t>)
+                        {
+                            ret.components.push_back({
+                                .index = ComponentRegistry<FinalTag>::template Index<component_t>(),
+                                .make_timeline = []() -> std::unique_ptr<impl::Rewind::ComponentTimeline>
+                                {
+                                    return std::make_unique<impl::Rewind::ComponentTimelineFor<component_t>>();
+                                },
+                            });
+                        }
+                    });
+                    return ret;
+                }();
+                return ret;
+            }
+        };
+
+        template <typename Base>
+        struct ControllerAdditions : BaseMixin::template ControllerAdditions<Base>
+        {
+          private:
+            using index_t = typename FinalTag::entity_index_t;
+
+            static constexpr int alive = std::numeric_limits<int>::max();
+
+            // The recorded states of a single entity.
+            struct History
+            {
+                const impl::Rewind::TypeInfo<FinalTag> *type = nullptr;
+                int first_tick = 0;
+                int end_tick = alive; // The first tick after the entity was destroyed.
+                Pointer<FinalTag> entity; // Null if destroyed.
+                std::vector<std::unique_ptr<impl::Rewind::ComponentTimeline>> timelines; // Parallel to `type->components`.
+            };
+            std::vector<History> histories;
+            // Maps the indices of the recorded entities to `histories`.
+            FlatMap<index_t, std::size_t> alive_histories;
+            // Which `histories` were seen by the current `RecordTick()`. Scratch data.
+            std::vector<bool> seen;
+
+            int num_ticks = 0;
+
+            [[nodiscard]] static char *ComponentPtr(Entity<FinalTag> &e, std::size_t component_index)
+            {
+                auto &hidden = static_cast<Ent::impl::EntityHidden<FinalTag> &>(e);
+                std::ptrdiff_t offset = hidden.GetComponentOffset(component_index);
+                ASSERT(offset >= 0, "Internal error: A rewindable component is missing or ambiguous.");
+                return reinterpret_cast<char *>(&e) + offset;
+            }
+
+            void RebuildAliveHistories()
+            {
+                alive_histories.clear();
+                for (std::size_t i = 0; i < histories.size(); i++)
+                {
+                    if (histories[i].end_tick == alive)
+                        alive_histories[histories[i].entity.GetIndex()] = i;
+                }
+            }
+
+          public:
+            using BaseMixin::template ControllerAdditions<Base>::ControllerAdditions;
+
+            // The number of recorded ticks. `RestoreTick()` accepts `[0, RecordedTicks())`.
+            [[nodiscard]] int RecordedTicks() const
+            {
+                return num_ticks;
+            }
+
+            // The approximate number of bytes used by the recorded states.
+            [[nodiscard]] std::size_t HistoryMemoryUsage() const
+            {
+                std::size_t ret = histories.capacity() * sizeof(History);
+                for (const History &history : histories)
+                {
+                    for (const auto &timeline : history.timelines)
+                        ret += timeline->MemoryUsage();
+                }
+                return ret;
+            }
+
+            // Records the current state of the entities in `category`, as the next tick.
+            // The entities that disappeared from the category since the last call are considered destroyed at this tick.
+            template <CategoryType<FinalTag> Cat>
+            void RecordTick(Cat &category)
+            {
+                seen.assign(histories.size(), false);
+
+                for (Entity<FinalTag> &e : this->operator()(category))
+                {
+                    Pointer<FinalTag> pointer = this->operator()(e);
+
+                    auto it = alive_histories.find(pointer.GetIndex());
+                    std::size_t history_index = 0;
+                    if (it != alive_histories.end() && histories[it->second].entity == pointer)
+                    {
+                        history_index = it->second;
+                    }
+                    else
+                    {
+                        // A new entity, or a reused index.
+                        if (it != alive_histories.end())
+                        {
+                            histories[it->second].end_tick = num_ticks;
+                            histories[it->second].entity = {};
+                        }
+
+                        History &history = histories.emplace_back();
+                        history.type = &e.GetRewindTypeInfo();
+                        history.first_tick = num_ticks;
+                        history.entity = pointer;
+                        for (const auto &component : history.type->components)
+                            history.timelines.push_back(component.make_timeline());
+
+                        history_index = histories.size() - 1;
+                        alive_histories[pointer.GetIndex()] = history_index;
+                        seen.push_back(false);
+                    }
+
+                    seen[history_index] = true;
+                    History &history = histories[history_index];
+                    for (std::size_t i = 0; i < history.timelines.size(); i++)
+                        history.timelines[i]->Append(ComponentPtr(e, history.type->components[i].index));
+                }
+
+                // Close the histories of the entities we didn't see.
+                for (std::size_t i = 0; i < histories.size(); i++)
+                {
+                    if (histories[i].end_tick == alive && !seen[i])
+                    {
+                        alive_histories.erase(histories[i].entity.GetIndex());
+                        histories[i].end_tick = num_ticks;
+                        histories[i].entity = {};
+                    }
+                }
+
+                num_ticks++;
+            }
+
+            // Restores the state recorded at `tick`, and forgets the later ticks, so `RecordTick()` continues from there.
+            // Destroys the recorded entities that didn't exist at that tick, and re-creates the destroyed ones that did.
+            void RestoreTick(int tick)
+            {
+                ASSERT(tick >= 0 && tick < num_ticks, "Rewind tick is out of range.");
+
+                std::size_t kept = 0;
+                for (std::size_t i = 0; i < histories.size(); i++)
+                {
+                    History &history = histories[i];
+
+                    if (tick < history.first_tick)
+                    {
+                        // Didn't exist yet.
+                        this->Destroy(history.entity);
+                        continue;
+                    }
+
+                    if (tick < history.end_tick)
+                    {
+                        Entity<FinalTag> *e = this->operator()(history.entity);
+                        if (!e)
+                        {
+                            if (!history.type->factory)
+                                Program::Error("Unable to rewind a destroyed entity, since its components are not default-constructible.");
+                            e = &history.type->factory(*this);
+                            history.entity = this->operator()(*e);
+                        }
+
+                        int local_tick = tick - history.first_tick;
+                        for (std::size_t j = 0; j < history.timelines.size(); j++)
+                        {
+                            history.timelines[j]->Load(local_tick, ComponentPtr(*e, history.type->components[j].index));
+                            history.timelines[j]->Truncate(local_tick + 1);
+                        }
+                        history.end_tick = alive;
+                    }
+
+                    if (kept != i)
+                        histories[kept] = std::move(history);
+                    kept++;
+                }
+                histories.erase(histories.begin() + kept, histories.end());
+
+                num_ticks = tick + 1;
+                RebuildAliveHistories();
+            }
+
+            // Forgets all recorded ticks. Doesn't affect the entities.
+            void ClearHistory()
+            {
+                histories.clear();
+                alive_histories.clear();
+                num_ticks = 0;
+            }
+        };
+    };
+}
@@ -12,103 +12,413 @@ constexpr auto fullscreen_flavor = Interface::borderless_fullscreen;
 
 const std::string_view window_name = "Flameline";
 
-Interface::Window window(std::string(window_name), screen_size * 2, Interface::windowed, adjust_(Interface::WindowSettings{}, min_size = screen_size));
-static Graphics::DummyVertexArray dummy_vao = nullptr;
+Interface::Window window = GameUtils::StartupTrace::Traced("window and context", []{return Interface::Window(std::string(window_name), screen_size * 2, Interface::windowed, adjust_(Interface::WindowSettings{}, min_size = screen_size, gl_debug = is_debug));});
+// The release builds only call `glGetError()` once per second, unless `KHR_debug` reports the errors earlier.
+Graphics::DebugOutput gl_debug_output(is_debug ? 1 : 60);
+// Show a black frame right away, instead of a blank or garbage window while the rest is initialized. In milliseconds since the SDL initialization.
+const std::uint32_t first_frame_time = []{
+    GameUtils::StartupTrace::Scope scope("first frame");
+    Graphics::SetClearColor(fvec3(0));
+    Graphics::Clear();
+    window.SwapBuffers();
+    return SDL_GetTicks();
+}();
 
-Audio::Context audio_context = nullptr;
+Audio::Context audio_context = GameUtils::StartupTrace::Traced("audio context", []{return Audio::Context(nullptr);});
 Audio::SourceManager audio_controller;
+Audio::Mixer audio_mixer(64);
 
 const Graphics::ShaderConfig shader_config = Graphics::ShaderConfig::Core();
+Graphics::ShaderCache shader_cache(Program::ExeDir() + "shaders.cache"); // Must be before all shaders.
 
-Graphics::FontFile Fonts::Files::main(Program::ExeDir() + "assets/Monocat_7x14.ttf", 14);
+Graphics::FontFile Fonts::Files::main(Stream::ReadOnlyData::from_pack(Program::ExeDir() + "assets/Monocat_7x14.ttf"), 14);
 Graphics::Font Fonts::main;
 
-Graphics::TextureAtlas texture_atlas = []{
-    std::string atlas_loc = is_debug ? "assets/assets/" : Program::ExeDir() + "assets/";
-    Graphics::TextureAtlas ret(ivec2(2048), is_debug ? "assets/_images" : "", atlas_loc + "atlas.png", atlas_loc + "atlas.refl", {{"/font_storage", ivec2(256)}});
-    auto font_region = ret.Get("/font_storage");
-
-    Unicode::CharSet glyph_ranges;
-    glyph_ranges.Add(Unicode::Ranges::Basic_Latin);
+// Those are loaded by `LoadAssets()`.
+Graphics::TextureAtlas texture_atlas;
+std::optional<Graphics::GlyphCache> Fonts::main_cache; // Only rasterizes Basic Latin in advance, the other glyphs are rasterized on first use.
+Graphics::Texture texture_main = Graphics::Texture(nullptr).Wrap(Graphics::clamp).Interpolation(Graphics::nearest);
+Graphics::TextureUploader glyph_uploader(256 * 256 * 4); // Enough for the whole font region.
 
-    Graphics::MakeFontAtlas(ret.GetImage(), font_region.pos, font_region.size, {
-        {Fonts::main, Fonts::Files::main, glyph_ranges, Graphics::FontFile::monochrome_with_hinting},
-    });
-    return ret;
-}();
-Graphics::Texture texture_main = Graphics::Texture(nullptr).Wrap(Graphics::clamp).Interpolation(Graphics::nearest).SetData(texture_atlas.GetImage());
+GameUtils::AssetLoader asset_loader;
 
-GameUtils::AdaptiveViewport adaptive_viewport(shader_config, screen_size);
-Render r = adjust_(Render(0x2000, shader_config), SetTexture(texture_main), SetMatrix(adaptive_viewport.GetDetails().MatrixCentered()));
+// Those compile the shaders, unless they're in `shader_cache`.
+GameUtils::AdaptiveViewport adaptive_viewport = GameUtils::StartupTrace::Traced("shaders: viewport", []{return GameUtils::AdaptiveViewport(shader_config, screen_size);});
+GameUtils::PostProcess post_process = GameUtils::StartupTrace::Traced("shaders: post process", []{return GameUtils::PostProcess(screen_size);});
+Render r = GameUtils::StartupTrace::Traced("shaders: render", []{return adjust_(Render(0x2000, shader_config, Graphics::StreamingMode::round_robin, Render::VertexFormat::packed), SetTexture(texture_main), SetMatrix(adaptive_viewport.GetDetails().MatrixCentered()),
+    SetBeforeFinishFunc([]{if (asset_loader.Done()) Fonts::main_cache->Flush(texture_main, glyph_uploader);}));});
+Render::TextCache text_cache;
 
 Input::Mouse mouse;
 
+Stream::AsyncFileWriter file_writer;
+
+Sig::EventBus event_bus;
+
+FrameArena frame_arena;
+
+GameUtils::Profiler profiler(600); // About 10 seconds at 60 FPS, for the hitch and crash traces.
+bool show_profiler_overlay = false;
+GpuTimers gpu_timers;
+
+LaunchOptions launch_options;
+float render_tick_fraction = 1;
+int atlas_version = 0, map_version = 0;
+
+BenchmarkRecorder benchmark_recorder;
+
+void BenchmarkRecorder::AddFrame(const GameUtils::Profiler &profiler, const FrameArena &arena)
+{
+    if (!running)
+        return;
+    const GameUtils::Profiler::Frame *frame = profiler.LastFrame();
+    if (!frame)
+        return;
+
+    FrameTimes &times = frames.emplace_back();
+    times.frame = Clock::TicksToSeconds(frame->end - frame->begin);
+    for (const GameUtils::Profiler::Zone &zone : frame->zones)
+    {
+        if (zone.depth != 0)
+            continue;
+        double secs = Clock::TicksToSeconds(zone.end - zone.begin);
+        std::string_view name = zone.name;
+        if (name == "Tick")
+            times.tick += secs;
+        else if (name == "Render")
+            times.render += secs;
+        else if (name == "SwapBuffers")
+            times.swap += secs;
+    }
+
+    clamp_var_min(peak_heap_bytes, frame->peak_live_bytes);
+    clamp_var_min(peak_arena_bytes, arena.UsedBytes());
+}
+
+std::string BenchmarkRecorder::ReportJson(std::string_view scenario) const
+{
+    std::vector<double> values(frames.size());
+    auto Section = [&](double FrameTimes::*member)
+    {
+        // The nearest-rank percentiles.
+        std::transform(frames.begin(), frames.end(), values.begin(), [&](const FrameTimes &times){return times.*member * 1000;});
+        std::sort(values.begin(), values.end());
+        auto Percentile = [&](double p){return values.empty() ? 0 : values[std::clamp(std::size_t(std::ceil(p * double(values.size()))), std::size_t(1), values.size()) - 1];};
+        double sum = 0;
+        for (double value : values)
+            sum += value;
+        return FMT("{{\"avg_ms\":{:.4f},\"p50_ms\":{:.4f},\"p99_ms\":{:.4f},\"max_ms\":{:.4f}}}",
+            values.empty() ? 0 : sum / double(values.size()), Percentile(0.5), Percentile(0.99), values.empty() ? 0 : values.back());
+    };
+
+    double total_secs = 0;
+    for (const FrameTimes &times : frames)
+        total_secs += times.frame;
+
+    return FMT("{{\"scenario\":\"{}\",\"frames\":{},\"total_secs\":{:.4f},\"avg_fps\":{:.2f},\"frame\":{},\"tick\":{},\"render\":{},\"swap\":{},\"peak_heap_bytes\":{},\"peak_frame_arena_bytes\":{}}}",
+        Strings::Escape(scenario, Strings::EscapeFlags::escape_double_quotes), frames.size(), total_secs, total_secs > 0 ? double(frames.size()) / total_secs : 0,
+        Section(&FrameTimes::frame), Section(&FrameTimes::tick), Section(&FrameTimes::render), Section(&FrameTimes::swap),
+        Program::AllocStats::enabled ? std::to_string(peak_heap_bytes) : "null", peak_arena_bytes);
+}
+
 Random::DefaultGenerator random_generator = Random::MakeGeneratorFromRandomDevice();
 Random::DefaultInterfaces<Random::DefaultGenerator> ra(random_generator);
 
 namespace Theme
 {
-    Audio::Buffer buf(Audio::Sound(Audio::ogg, Audio::stereo, Program::ExeDir() + "assets/gates_of_heck.ogg"));
-    Audio::Source src = adjust_(Audio::Source(buf), loop(), volume(0.9f), play());
+    Audio::StreamingSource src; // Opened by `LoadAssets()`, so the decoding doesn't delay the first frame.
 }
 
 struct Application : Program::DefaultBasicState
 {
     GameUtils::State::Manager<StateBase> state_manager;
     GameUtils::FpsCounter fps_counter;
+    std::string title_buffer; // The debug window title is formatted here, to reuse the memory.
+    bool startup_reported = false;
 
     void Resize()
     {
+        need_render = true;
+        UpdateExpectedFrameTime(); // The window could've moved to a different display.
         adaptive_viewport.Update();
         mouse.SetMatrix(adaptive_viewport.GetDetails().MouseMatrixCentered());
     }
 
-    Metronome metronome = Metronome(60);
+    Metronome metronome = []{
+        Metronome ret(60);
+        // When the ticks are slow (e.g. heavy rewinding), slow down the game instead of running more ticks per frame, which would make the frames even slower.
+        ret.SetTickTimeBudget(2 / 60.);
+        ret.SetSlowMotion(true);
+        return ret;
+    }();
+
+    // Only in debug builds. The atlas sources, and the directory with the map.
+    std::optional<Filesystem::ChangeWatcher> atlas_watcher, map_watcher;
+
+    void ReloadChangedAssets()
+    {
+        if (!asset_loader.Done())
+            return; // The changes wait in the queue until then.
+
+        if (atlas_watcher)
+        {
+            std::vector<std::string> changed_files = atlas_watcher->Poll();
+            if (!changed_files.empty())
+            {
+                try
+                {
+                    if (texture_atlas.Update(changed_files))
+                    {
+                        window.FinishSwapBuffers(); // The swap can be using the texture.
+                        texture_main.SetData(texture_atlas.GetImage()); // This includes the glyphs, they are in the same image.
+                        atlas_version++;
+                    }
+                    else
+                    {
+                        std::cout << "The changed images don't fit into the texture atlas, restart the game to regenerate it.\n";
+                    }
+                }
+                catch (std::exception &e)
+                {
+                    std::cout << FMT("Unable to update the texture atlas: {}\n", e.what()); // Most likely an image that is still being written. It's retried on the next change.
+                }
+            }
+        }
+
+        if (map_watcher)
+        {
+            std::vector<std::string> changed_files = map_watcher->Poll();
+            if (std::find(changed_files.begin(), changed_files.end(), "map.json") != changed_files.end())
+                map_version++;
+        }
+    }
+
+    // The frames that take 1.5 times longer than this are counted as stutter.
+    // This also sizes the fast-forward tick budget, which has to fit into a frame.
+    void UpdateExpectedFrameTime()
+    {
+        int fps = GetFpsCap();
+        if (fps <= 0)
+            fps = window.RefreshRate(); // Vsync is enabled.
+        fps_counter.SetExpectedFrameTime(fps > 0 ? 1. / fps : 0);
+        UpdateFastForward(fps);
+    }
+
+    bool fast_forward = false; // Toggled with F8.
+
+    // Leave a quarter of the frame for the rendering and the swap.
+    void UpdateFastForward(int fps)
+    {
+        metronome.SetFastForward(fast_forward ? 0.75 / (fps > 0 ? fps : 60) : 0);
+    }
 
     Metronome *GetTickMetronome() override
     {
-        return &metronome;
+        // The benchmark runs one tick per frame, as fast as possible.
+        return launch_options.benchmark_file.empty() ? &metronome : nullptr;
     }
 
     int GetFpsCap() override
     {
-        return 60 * NeedFpsCap();
+        if (!launch_options.benchmark_file.empty())
+            return 0;
+        // When interpolating, rendering faster than the ticks is not wasted.
+        return (launch_options.interpolate ? 240 : 60) * NeedFpsCap();
+    }
+
+    bool EmulateAdaptiveVSync() override
+    {
+        return true; // Does nothing unless the adaptive vsync is requested and not supported.
+    }
+
+    BackgroundPolicy GetBackgroundPolicy() override
+    {
+        // The benchmark shouldn't depend on the window focus.
+        if (!launch_options.benchmark_file.empty())
+            return {.skip_render_when_minimized = false};
+        // In the background the game keeps running, but renders rarely and sleeps in between.
+        return {.background_fps_cap = 20};
+    }
+
+    // Forces the next frame to be rendered, even if nothing was ticked.
+    bool need_render = true;
+
+    // Counts the ticks, to only sometimes check the audio errors in the release builds.
+    unsigned int audio_error_check_counter = 0;
+
+    bool ShouldRender(int num_ticks) override
+    {
+        // Without ticks nothing changes, since the input is only processed in the ticks. Unless we're interpolating.
+        return std::exchange(need_render, false) || num_ticks > 0 || launch_options.interpolate;
+    }
+
+    void BeginFrame() override
+    {
+        profiler.BeginFrame();
+        if (asset_loader.Done())
+            Fonts::main_cache->BeginFrame();
+        text_cache.BeginFrame();
+    }
+
+    // Frames since the last hitch trace. The next one is only saved once the profiler is refilled with the new frames, so the traces don't overlap.
+    std::size_t frames_since_hitch_trace = -1zu;
+    int num_hitch_traces = 0;
+    static constexpr int max_hitch_traces = 4; // Then the old ones are overwritten.
+
+    // Saves the frames kept by the profiler if the last one took longer than `launch_options.hitch_threshold_secs`. Call after `profiler.EndFrame()`.
+    // It's always on, since the hitches on the players' machines can't be reproduced later.
+    void SaveHitchTraceIfNeeded()
+    {
+        clamp_var_max(++frames_since_hitch_trace, profiler.FrameCapacity()); // Don't overflow.
+
+        // The loading screen isn't interesting, and the benchmarks shouldn't be slowed down.
+        if (launch_options.hitch_threshold_secs <= 0 || !asset_loader.Done() || benchmark_recorder.Running())
+            return;
+        const GameUtils::Profiler::Frame *frame = profiler.LastFrame();
+        if (!frame || frames_since_hitch_trace < profiler.FrameCapacity())
+            return;
+        double secs = Clock::TicksToSeconds(frame->end - frame->begin);
+        if (secs < launch_options.hitch_threshold_secs)
+            return;
+
+        frames_since_hitch_trace = 0;
+        std::string file_name = FMT("{}hitch_{}.json", Program::ExeDir(), num_hitch_traces++ % max_hitch_traces);
+        std::string json = profiler.ChromeTraceJson();
+        file_writer.SaveFile(file_name, std::vector<std::uint8_t>(json.begin(), json.end()), Stream::text);
+        std::cout << FMT("A frame took {:.1f} ms, saved the last frames to `{}`.\n", secs * 1000, file_name);
     }
 
     void EndFrame() override
     {
-        fps_counter.Update();
-        if (is_debug)
-            window.SetTitle(STR((window_name), " TPS:", (fps_counter.Tps()), " FPS:", (fps_counter.Fps()), " AUDIO:", (audio_controller.ActiveSources())));
+        profiler.EndFrame();
+        SaveHitchTraceIfNeeded();
+        benchmark_recorder.AddFrame(profiler, frame_arena);
+        frame_arena.Reset();
+
+        if (benchmark_recorder.Finished())
+        {
+            std::cout << benchmark_recorder.ReportJson(launch_options.benchmark_file) << '\n';
+            window.FinishSwapBuffers(); // The global destructors need the OpenGL context.
+            Program::Exit();
+        }
+
+        if (fps_counter.Update())
+        {
+            if (is_debug)
+                window.SetTitle(STR_TO(title_buffer, (window_name), " TPS:", (fps_counter.Tps()), " FPS:", (fps_counter.Fps()), " ", (fps_counter.StatsString()), " AUDIO:", (audio_controller.ActiveSources()), "+", (audio_mixer.ActiveVoices())));
+
+            if (!launch_options.frame_stats_file.empty())
+            {
+                std::string line = FMT("{} tps:{} fps:{} {}\n", SDL_GetTicks() / 1000, fps_counter.Tps(), fps_counter.Fps(), fps_counter.StatsString());
+                file_writer.SaveFile(launch_options.frame_stats_file, std::vector<std::uint8_t>(line.begin(), line.end()), Stream::append_text);
+            }
+        }
     }
 
     void Tick() override
     {
-        window.ProcessEvents();
+        window.ProcessEventsUntil(TickEventTimestamp());
+
+        if (is_debug)
+            ReloadChangedAssets();
 
         if (window.ExitRequested())
+        {
+            window.FinishSwapBuffers(); // The global destructors need the OpenGL context.
             Program::Exit();
+        }
         if (window.Resized())
         {
+            window.FinishSwapBuffers(); // This recreates the textures.
             Resize();
             Graphics::Viewport(window.Size());
         }
 
-        state_manager.Tick();
-        audio_controller.Tick();
+        {
+            // All the audio changes made during the tick are applied at once.
+            audio_context.DeferUpdates();
+            FINALLY( audio_context.ProcessUpdates(); )
+
+            {
+                profiler.CountTick();
+                GameUtils::Profiler::Scope scope(profiler, "Tick");
+                if (state_manager.StateChangePending())
+                    window.FinishSwapBuffers(); // Constructing and destroying the states touches the GPU resources.
+                state_manager.Tick();
+            }
+            event_bus.Dispatch();
+            audio_controller.Tick();
+            audio_mixer.Tick();
+            Theme::src.Tick();
+        }
+
+        ReportStartupTime();
 
-        Audio::CheckErrors();
+        // `alcGetError()` is cheaper than `glGetError()`, but the release builds sample it too.
+        if (is_debug || audio_error_check_counter++ % 60 == 0)
+            Audio::CheckErrors();
 
         if (!state_manager)
+        {
+            window.FinishSwapBuffers();
             Program::Exit();
+        }
 
         // Toggle fullscreen.
         if ((Input::Button(Input::l_alt).down() || Input::Button(Input::r_alt).down()) && Input::Button(Input::enter).pressed())
         {
             now_windowed = !now_windowed;
+            window.FinishSwapBuffers();
             window.SetMode(now_windowed ? Interface::windowed : fullscreen_flavor);
         }
 
+        // Profiler: F3 toggles the overlay, F4 dumps the last frames for `chrome://tracing`, F6 prints and dumps the memory report.
+        if (Input::Button(Input::f3).pressed())
+        {
+            show_profiler_overlay = !show_profiler_overlay;
+            gpu_timers.enabled = show_profiler_overlay;
+        }
+        if (Input::Button(Input::f4).pressed())
+            profiler.SaveChromeTrace(Program::ExeDir() + "profile.json");
+        if (Input::Button(Input::f6).pressed())
+        {
+            std::string report = state_manager.Call(&StateBase::MemoryReport);
+            if (!report.empty())
+            {
+                report += '\n';
+                std::cout << "Memory:\n" << report;
+                file_writer.SaveFile(Program::ExeDir() + "memory.txt", std::vector<std::uint8_t>(report.begin(), report.end()), Stream::text);
+            }
+        }
+
+        // Cycle the vsync modes.
+        if (Input::Button(Input::f7).pressed())
+        {
+            Interface::VSync next = Interface::VSync::adaptive;
+            switch (window.RequestedVSyncMode())
+            {
+              case Interface::VSync::adaptive:
+                next = Interface::VSync::enabled;
+                break;
+              case Interface::VSync::enabled:
+                next = Interface::VSync::disabled;
+                break;
+              default:
+                break;
+            }
+            window.SetVSyncMode(next);
+            UpdateExpectedFrameTime();
+            std::cout << FMT("Vsync: {}\n", VSyncDescription());
+        }
+
+        // Toggle the fast-forward mode.
+        if (Input::Button(Input::f8).pressed() && launch_options.benchmark_file.empty())
+        {
+            fast_forward = !fast_forward;
+            UpdateExpectedFrameTime();
+            std::cout << FMT("Fast-forward: {}\n", fast_forward ? "enabled" : "disabled");
+        }
+
         // Toggle music.
         if (Input::Button(Input::m).pressed())
         {
@@ -121,14 +431,156 @@ struct Application : Program::DefaultBasicState
 
     void Render() override
     {
+        window.FinishSwapBuffers(); // If the last frame was swapped on a thread, get the OpenGL context back.
+
+        render_tick_fraction = launch_options.interpolate && launch_options.benchmark_file.empty() ? metronome.TickFraction() : 1;
+        r.BeginFrame();
+
         adaptive_viewport.BeginFrame();
-        state_manager.Call(&StateBase::Render);
-        adaptive_viewport.FinishFrame();
-        Graphics::CheckErrors();
+        {
+            GameUtils::Profiler::Scope scope(profiler, "Render");
+            state_manager.Call(&StateBase::Render);
+        }
+        if (show_profiler_overlay && asset_loader.Done())
+            RenderProfilerOverlay();
+        gpu_timers.Measure(gpu_timers.upscale, [&]{adaptive_viewport.FinishFrame();});
+        gl_debug_output.Check();
+
+        GameUtils::Profiler::Scope scope(profiler, "SwapBuffers");
+        if (launch_options.threaded_swap)
+            window.BeginSwapBuffers();
+        else
+            window.SwapBuffers();
+    }
+
+    // Like `adaptive (disabled, late swap)`: the requested mode, then the actual one if different.
+    [[nodiscard]] std::string VSyncDescription() const
+    {
+        auto Name = [](Interface::VSync mode)
+        {
+            switch (mode)
+            {
+              case Interface::VSync::enabled:
+                return "enabled";
+              case Interface::VSync::disabled:
+                return "disabled";
+              case Interface::VSync::adaptive:
+                return "adaptive";
+              case Interface::VSync::unspecified:
+                return "unspecified";
+            }
+            return "?";
+        };
+        std::string ret = Name(window.RequestedVSyncMode());
+        if (window.VSyncMode() != window.RequestedVSyncMode() || LateSwapActive())
+            FMT_APPEND(ret, " ({}{})", Name(window.VSyncMode()), LateSwapActive() ? ", late swap" : "");
+        return ret;
+    }
+
+    void RenderProfilerOverlay()
+    {
+        auto [avg_frame, max_frame] = profiler.FrameTimes();
+        std::pmr::string text(&frame_arena);
+        FMT_TO(text, "frame {:.2f} ms (max {:.2f}), vsync {}", avg_frame * 1000, max_frame * 1000, VSyncDescription());
+        if (metronome.FastForward())
+            FMT_APPEND(text, ", fast-forward x{:.1f}", metronome.SpeedMultiplier());
+        if constexpr (Program::AllocStats::enabled)
+        {
+            GameUtils::Profiler::FrameAllocStats allocs = profiler.FrameAllocs();
+            FMT_APPEND(text, "\nallocs {:.1f}/frame (max {}), {:.1f} KiB/frame, peak {:.1f} MiB", allocs.average_allocs, allocs.max_allocs, allocs.average_bytes / 1024, allocs.peak_live_bytes / 1024. / 1024.);
+        }
+        for (const GameUtils::Profiler::ZoneStats &zone : profiler.Summary(&frame_arena))
+        {
+            FMT_APPEND(text, "\n{:{}}{} {:.2f} ms (max {:.2f})", "", zone.depth * 2, zone.name, zone.average_secs * 1000, zone.max_secs * 1000);
+            if constexpr (Program::AllocStats::enabled)
+                FMT_APPEND(text, ", {:.1f} allocs", zone.average_allocs);
+        }
+
+        if (!Graphics::GpuTimer::IsSupported())
+        {
+            text += "\nGPU timers are not supported";
+        }
+        else
+        {
+            for (auto [name, timer] : {std::pair("background", &gpu_timers.background), {"map", &gpu_timers.map}, {"particles", &gpu_timers.particles}, {"time machine", &gpu_timers.time_machine}, {"upscale", &gpu_timers.upscale}})
+            {
+                if (std::optional<double> secs = timer->LastResult())
+                    FMT_APPEND(text, "\nGPU {} {:.2f} ms", name, *secs * 1000);
+            }
+        }
+
+        if (is_debug)
+        {
+            const Render::Stats &stats = r.LastFrameStats();
+            FMT_APPEND(text, "\ndraw calls {} (geometry {}), state changes {}", stats.draw_calls, stats.geometry_draws, stats.state_changes);
+            FMT_APPEND(text, "\nflushes {} (finish {}, state {}, full {})", stats.Flushes(), stats.finish_flushes, stats.state_flushes, stats.full_flushes);
+            FMT_APPEND(text, "\nprimitives {}, vertices {}, uploaded {:.1f} KiB", stats.primitives, stats.vertices, stats.bytes_uploaded / 1024.);
+        }
+
+        if (std::string memory = state_manager.Call(&StateBase::MemoryReport); !memory.empty())
+        {
+            text += "\n\nmemory (estimated):\n";
+            text += memory;
+        }
+
+        r.itext(-screen_size / 2 + 2, Graphics::Text(Fonts::main, text, &frame_arena)).align(ivec2(-1)).color(fvec3(1, 1, 0.5f));
+        r.Finish();
+    }
+
 
-        window.SwapBuffers();
+    // Those run while `States::Loading` is shown.
+    void LoadAssets()
+    {
+        auto atlas = asset_loader.Add("texture atlas", []
+        {
+            std::string atlas_loc = is_debug ? "assets/assets/" : Program::ExeDir() + "assets/";
+            texture_atlas = Graphics::TextureAtlas(ivec2(2048), is_debug ? "assets/_images" : "", atlas_loc + "atlas.rgba.z", atlas_loc + "atlas.bin", {{"/font_storage", ivec2(256)}});
+        });
+
+        auto fonts = asset_loader.Add("fonts", []
+        {
+            const auto &font_region = texture_atlas.Get<"/font_storage">();
+
+            Unicode::CharSet pinned_glyphs;
+            pinned_glyphs.Add(Unicode::Ranges::Basic_Latin);
+
+            Fonts::main_cache.emplace(Fonts::main, Fonts::Files::main, texture_atlas.GetImage(), font_region.pos, font_region.size, Graphics::FontFile::monochrome_with_hinting, &pinned_glyphs);
+        }, {}, {atlas});
+
+        asset_loader.Add("texture upload", {}, []
+        {
+            texture_main.SetData(texture_atlas.GetImage());
+        }, {fonts});
+
+        // `LoadMentionedFiles()` decodes the files in parallel by itself. OpenAL allows calls from any thread.
+        asset_loader.Add("sounds", []
+        {
+            Audio::LoadMentionedFiles(Audio::LoadFromPrefixWithExt(Program::ExeDir() + "assets/"), Audio::mono, Audio::wav, Program::ExeDir() + "sounds.cache");
+        });
+
+        // Opened into a temporary, since the main thread keeps ticking `Theme::src` meanwhile.
+        auto music = std::make_shared<Audio::StreamingSource>();
+        asset_loader.Add("music", [music]
+        {
+            *music = Audio::StreamingSource(Stream::ReadOnlyData::from_pack(Program::ExeDir() + "assets/gates_of_heck.ogg"), true);
+        },
+        [music]
+        {
+            Theme::src = std::move(*music);
+            Theme::src.volume(0.9f).play();
+        });
     }
 
+    // Prints how long the startup took, once everything is loaded and the world is constructed. Only in debug builds, while the profile builds emit the `StartupTrace`.
+    void ReportStartupTime()
+    {
+        if (startup_reported || !asset_loader.Done() || state_manager.StateChangePending())
+            return;
+        startup_reported = true;
+        if (is_debug)
+            std::cout << FMT("Startup: first frame at {} ms, everything loaded at {} ms.\n{}", first_frame_time, SDL_GetTicks(), asset_loader.TimingReport());
+        GameUtils::StartupTrace::Finish(Program::ExeDir() + "startup_trace.json");
+    }
 
     void Init()
     {
@@ -137,22 +589,107 @@ struct Application : Program::DefaultBasicState
         if (!now_windowed)
             window.SetMode(fullscreen_flavor);
 
+        window.SetVSyncMode(launch_options.benchmark_file.empty() ? launch_options.vsync : Interface::VSync::disabled);
+        fast_forward = launch_options.fast_forward && launch_options.benchmark_file.empty();
+        UpdateExpectedFrameTime();
+
         Audio::Volume(1.2f);
 
-        Audio::LoadMentionedFiles(Audio::LoadFromPrefixWithExt(Program::ExeDir() + "assets/"), Audio::mono, Audio::wav);
+        LoadAssets();
 
         if (is_debug)
+        {
             SDL_MaximizeWindow(window.Handle());
 
+            if (Filesystem::ChangeWatcher::IsSupported())
+            {
+                atlas_watcher.emplace("assets/_images"); // Same as in `LoadAssets()`.
+                map_watcher.emplace(Program::ExeDir(), false);
+            }
+        }
+
         Graphics::Blending::Enable();
         Graphics::Blending::FuncNormalPre();
 
-        state_manager.SetState("World{}");
+        state_manager.SetState("Loading{}");
     }
 };
 
-IMP_MAIN(,)
+// See `Program::SetCrashCallback()`. Saves the frames kept by the profiler. The unfinished zones of the last frame show where it crashed.
+static void SaveCrashTrace()
 {
+    try
+    {
+        std::string file_name = Program::ExeDir() + "crash_trace.json";
+        profiler.SaveChromeTrace(file_name, true);
+        std::cout << "Saved the last frames to `" << file_name << "`.\n";
+    }
+    catch (...) {}
+}
+
+IMP_MAIN(argc, argv)
+{
+    Program::SetCrashCallback(SaveCrashTrace);
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string_view arg = argv[i];
+        if (arg == "--record" && i + 1 < argc)
+            launch_options.record_file = argv[++i];
+        else if (arg == "--replay" && i + 1 < argc)
+            launch_options.replay_file = argv[++i];
+        else if (arg == "--replay-fast" && i + 1 < argc)
+        {
+            launch_options.replay_file = argv[++i];
+            launch_options.replay_fast = true;
+        }
+        else if (arg == "--validate-replay" && i + 1 < argc)
+            launch_options.validate_replay_files.push_back(argv[++i]); // Can be repeated.
+        else if (arg == "--benchmark" && i + 1 < argc)
+        {
+            launch_options.replay_file = argv[++i];
+            launch_options.benchmark_file = launch_options.replay_file;
+        }
+        else if (arg == "--stress" && i + 1 < argc)
+            launch_options.stress_test = argv[++i];
+        else if (arg == "--snapshot" && i + 1 < argc)
+            launch_options.snapshot_file = argv[++i];
+        else if (arg == "--interpolate")
+            launch_options.interpolate = true;
+        else if (arg == "--gpu-tilemap")
+            launch_options.gpu_tilemap = true;
+        else if (arg == "--threaded-swap")
+            launch_options.threaded_swap = true;
+        else if (arg == "--frame-stats" && i + 1 < argc)
+            launch_options.frame_stats_file = argv[++i];
+        else if (arg == "--max-allocs-per-tick" && i + 1 < argc)
+            launch_options.max_allocs_per_tick = Strings::FromString<double>(argv[++i]);
+        else if (arg == "--history-budget" && i + 1 < argc)
+            launch_options.history_budget_bytes = std::size_t(Strings::FromString<double>(argv[++i]) * (1 << 20)); // In MiB.
+        else if (arg == "--vsync" && i + 1 < argc)
+        {
+            std::string_view mode = argv[++i];
+            if (mode == "adaptive")
+                launch_options.vsync = Interface::VSync::adaptive;
+            else if (mode == "on")
+                launch_options.vsync = Interface::VSync::enabled;
+            else if (mode == "off")
+                launch_options.vsync = Interface::VSync::disabled;
+            else
+                Program::Error("Expected `--vsync adaptive`, `on`, or `off`.");
+        }
+        else if (arg == "--hitch-ms" && i + 1 < argc)
+            launch_options.hitch_threshold_secs = Strings::FromString<double>(argv[++i]) / 1000;
+        else if (arg == "--fast-forward")
+            launch_options.fast_forward = true;
+        else
+            Program::Error("Unknown command line argument: `", arg, "`. Expected `--record <file>`, `--replay <file>`, `--replay-fast <file>`, `--validate-replay <file>`, `--benchmark <file>`, `--stress <fields>`, `--snapshot <file>`, `--interpolate`, `--gpu-tilemap`, `--threaded-swap`, `--frame-stats <file>`, `--max-allocs-per-tick <n>`, `--history-budget <MiB>`, `--vsync <adaptive|on|off>`, `--hitch-ms <n>`, or `--fast-forward`.");
+    }
+
+    // This doesn't need the window or the assets, so don't start the game.
+    if (!launch_options.validate_replay_files.empty())
+        Program::Exit(ValidateReplays(launch_options.validate_replay_files) == 0 ? 0 : 1);
+
     Application app;
     app.Init();
     app.Resize();
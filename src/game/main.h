@@ -7,6 +7,7 @@ extern Interface::Window window;
 
 extern Audio::Context audio_context;
 extern Audio::SourceManager audio_controller;
+extern Audio::Mixer audio_mixer; // For the sounds without a position, see `sounds.h`.
 
 extern const Graphics::ShaderConfig shader_config;
 
@@ -18,21 +19,126 @@ namespace Fonts
     }
 
     extern Graphics::Font main;
+    extern std::optional<Graphics::GlyphCache> main_cache; // Don't touch until `asset_loader.Done()`.
 }
 
 extern Graphics::TextureAtlas texture_atlas;
 
 extern Graphics::Texture texture_main;
 
+extern GameUtils::AssetLoader asset_loader; // See `States::Loading`.
+
 extern GameUtils::AdaptiveViewport adaptive_viewport;
+extern GameUtils::PostProcess post_process; // `World::Render()` draws into it, then outputs to `adaptive_viewport`.
 extern Render r;
+extern Render::TextCache text_cache; // For the text that is drawn every frame.
 
 extern Input::Mouse mouse;
 
+extern GameUtils::Profiler profiler;
+
+extern Stream::AsyncFileWriter file_writer; // Saves files without stalling the frame. Use this for the saves during gameplay.
+
+extern Sig::EventBus event_bus; // The events sent to it from any thread are delivered once per tick, after the state ticks.
+
+extern FrameArena frame_arena; // For the temporary strings and texts that only live until the end of the frame. Reset in `EndFrame()`.
+
+// GPU timers for the profiler overlay. They only run while it's visible.
+struct GpuTimers
+{
+    bool enabled = false;
+    Graphics::GpuTimer upscale = nullptr, background = nullptr, map = nullptr, particles = nullptr, time_machine = nullptr;
+
+    // Calls `func()`, measuring it with `timer` if enabled. Then the render queue is flushed around it, to attribute the draw calls correctly.
+    template <typename F>
+    void Measure(Graphics::GpuTimer &timer, F &&func)
+    {
+        if (!enabled)
+        {
+            func();
+            return;
+        }
+
+        r.Finish();
+        timer.Begin();
+        func();
+        r.Finish();
+        timer.End();
+    }
+};
+extern GpuTimers gpu_timers;
+
+// Set from the command line. See `main.cpp`.
+struct LaunchOptions
+{
+    std::string record_file; // If not empty, the input of the first level is recorded to this file.
+    std::string replay_file; // If not empty, the first level replays the input from this file.
+    bool replay_fast = false; // Replay as fast as possible without rendering, then print the timing and exit.
+    std::vector<std::string> validate_replay_files; // If not empty, replay those files in parallel without starting the game, check their state hashes, print the results and exit. See `ValidateReplays()`.
+    std::string benchmark_file; // If not empty, replay this file with the rendering, one tick per frame, without vsync and the FPS cap. Then print `BenchmarkRecorder::ReportJson()` and exit.
+    std::optional<std::string> stress_test; // If set, the loading screen starts `States::StressTest` instead of the world. This is its fields, e.g. `{}` or `{particles=1024,frame_budget_ms=8}`.
+    std::string snapshot_file; // If not empty, the first level starts from the snapshot in this file if it exists. F5 saves a snapshot to it, F9 loads it.
+    bool threaded_swap = false; // Swap the buffers on a background thread, so the next ticks overlap with waiting for vsync.
+    Interface::VSync vsync = Interface::VSync::adaptive; // If the adaptive vsync isn't supported, it's emulated, see `Program::DefaultBasicState::EmulateAdaptiveVSync()`. F7 cycles the modes.
+    std::string frame_stats_file; // If not empty, the frame time statistics are appended to this file every second.
+    bool interpolate = false; // Interpolate the rendering between the ticks, and raise the FPS cap. Costs up to one tick of latency.
+    bool gpu_tilemap = false; // Draw the map with a single full-screen pass over a texture of tile data, instead of the cached quads. See `Map::render()`.
+    std::optional<double> max_allocs_per_tick; // If set, `replay_fast` fails if the replay makes more heap allocations per tick. Needs the `count_allocs` build mode.
+    std::size_t history_budget_bytes = std::size_t(256) << 20; // When the rewind history uses more memory, the world compresses and drops the least needed parts of it.
+    double hitch_threshold_secs = 0.05; // If a frame takes longer, the last frames kept by the profiler are saved to `hitch_<n>.json`. Zero disables this.
+    bool fast_forward = false; // Start in the fast-forward mode: each frame runs as many ticks as fit into 3/4 of it, instead of following the clock. F8 toggles it.
+};
+extern LaunchOptions launch_options;
+
+// Replays the input recordings in headless worlds, in parallel on `Jobs::DefaultPool()`, and checks their state hashes. Defined in `state_world.cpp`.
+// Prints a line per recording, and returns how many of them failed.
+[[nodiscard]] int ValidateReplays(const std::vector<std::string> &files);
+
+// Collects the frame times for `launch_options.benchmark_file`.
+// The world calls `Start()` on the first replayed tick and `Stop()` after the last one, and `Application` feeds it the profiler frames in between.
+class BenchmarkRecorder
+{
+    struct FrameTimes
+    {
+        double frame = 0, tick = 0, render = 0, swap = 0; // In seconds.
+    };
+    std::vector<FrameTimes> frames;
+    std::size_t peak_heap_bytes = 0; // Only in the `count_allocs` mode.
+    std::size_t peak_arena_bytes = 0; // `frame_arena.UsedBytes()`.
+
+    bool running = false;
+    bool finished = false;
+
+  public:
+    void Start() {running = true;}
+    void Stop() {finished = running; running = false;}
+
+    [[nodiscard]] bool Running() const {return running;}
+    [[nodiscard]] bool Finished() const {return finished;}
+
+    // Call this after `profiler.EndFrame()`. Does nothing unless running.
+    void AddFrame(const GameUtils::Profiler &profiler, const FrameArena &arena);
+
+    // Per-section frame time percentiles in milliseconds and the peak memory usage, as a single-line JSON object.
+    [[nodiscard]] std::string ReportJson(std::string_view scenario) const;
+};
+extern BenchmarkRecorder benchmark_recorder;
+
+// How far the rendered frame is between the previous tick and the last one, in `0..1`.
+// Always 1 unless `launch_options.interpolate` is set. Only meaningful in `Render()`.
+extern float render_tick_fraction;
+
+// The debug builds reload the atlas and the map when their files change. Those are incremented after each reload,
+// so the states can rebuild whatever depends on them.
+extern int atlas_version, map_version;
+
 extern Random::DefaultGenerator random_generator;
 extern Random::DefaultInterfaces<Random::DefaultGenerator> ra;
 
 STRUCT( StateBase EXTENDS GameUtils::State::Base POLYMORPHIC )
 {
     virtual void Render() const = 0;
+
+    // Describes the memory held by the state, one part per line. For the profiler overlay and the F6 dump. Empty if the state has nothing to report.
+    [[nodiscard]] virtual std::string MemoryReport() const {return {};}
 };
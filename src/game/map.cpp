@@ -1,28 +1,298 @@
 #include "map.h"
 
 #include "main.h"
+#include "utils/archive.h"
 
-Map::Map(Stream::ReadOnlyData data)
+Map::Compiled Map::Compile(Stream::ReadOnlyData json_data)
 {
-    Json json(data.string(), 32);
-    auto tiles = Tiled::LoadTileLayer(Tiled::FindLayer(json.GetView(), "mid"));
+    // Read the map in one pass, without building the document.
+    Tiled::TileLayer tiles;
+    Tiled::PointLayer points;
+    Json::Reader reader(json_data.string(), 32);
+    Tiled::LoadLayers(reader, {{"mid", &tiles}}, {{"points", &points}});
+    reader.Finish();
 
-    cells = Array2D<Cell>(tiles.size());
-    random = Array2D<unsigned char>(tiles.size());
+    Compiled ret;
+    ret.tiles = Array2D<std::uint8_t>(tiles.size());
+    for (auto pos : vector_range(tiles.size()))
+    {
+        int tile = tiles.unsafe_at(pos);
+        if (tile < 0 || tile >= int(Tile::_count))
+            throw std::runtime_error(FMT("Invalid tile index {} at {}.", tile, pos));
+        ret.tiles.unsafe_at(pos) = std::uint8_t(tile);
+    }
+
+    ret.points = std::move(points.points);
+    return ret;
+}
+
+Map Map::Load(const std::string &json_file, const std::string &bin_file)
+{
+    auto TimeModified = [](const std::string &file_name) -> std::time_t
+    {
+        bool ok = false;
+        auto info = Filesystem::GetObjectInfo(file_name, &ok);
+        return ok ? info.time_modified : 0;
+    };
+    std::time_t json_time = TimeModified(json_file);
+    std::time_t bin_time = TimeModified(bin_file);
+
+    // If neither file exists on disk, they can still be in the asset pack.
+    if (bin_time >= json_time)
+    {
+        try
+        {
+            Compiled compiled;
+            Refl::FromBinary(compiled, Stream::Input(Stream::ReadOnlyData::from_pack(bin_file)));
+            return compiled;
+        }
+        catch (...)
+        {
+            // If there's no JSON to fall back to, propagate the exception.
+            if (json_time == 0 && bin_time != 0)
+                throw;
+        }
+    }
+
+    Compiled compiled = Compile(Stream::ReadOnlyData::from_pack(json_file));
+    try
+    {
+        Stream::SaveFile(bin_file, Refl::ToBinary<std::vector<std::uint8_t>>(compiled));
+    }
+    catch (...) {}
+    return compiled;
+}
+
+Map::Compiled Map::Generate(const GenerationParams &params)
+{
+    if ((params.size < 16).any())
+        Program::Error("The generated map must be at least 16x16 tiles.");
+
+    Compiled ret;
+    ret.tiles = Array2D<std::uint8_t>(params.size);
+
+    ivec2 center = params.size / 2;
+    constexpr int clear_radius = 4; // Around the player start, in tiles.
+
+    for (auto pos : vector_range(params.size))
+    {
+        Tile tile = Tile::air;
+        if ((pos <= 0).any() || (pos >= params.size - 1).any())
+        {
+            tile = Tile::wall;
+        }
+        else if (pos.y == center.y + 1 && abs(pos.x - center.x) <= clear_radius)
+        {
+            tile = Tile::wall; // The floor under the player.
+        }
+        else if ((abs(pos - center) > clear_radius).any())
+        {
+            float value = (Random::CounterGenerator::Value(params.seed, std::uint32_t(pos.y), std::uint32_t(pos.x)) >> 40) / float(1 << 24);
+            if ((value -= params.wall_density) < 0)
+                tile = Tile::wall;
+            else if ((value -= params.breakable_density) < 0)
+                tile = Tile::breakable;
+            else if ((value -= params.spike_density) < 0)
+                tile = Tile::spike_up;
+        }
+        ret.tiles.unsafe_at(pos) = std::uint8_t(tile);
+    }
+
+    // The player hitbox goes 8 pixels below the position.
+    fvec2 player_pos = fvec2(center.x * tile_size + tile_size / 2, (center.y + 1) * tile_size - 9);
+    ret.points.emplace("player", player_pos);
+    ret.points.emplace("debug_player", player_pos); // This lets the player out of the prison.
+    ret.points.emplace("lava", fvec2(0, params.size.y * tile_size + 1'000'000));
+    ret.points.emplace("exit", fvec2(0, -1'000'000));
+    return ret;
+}
+
+ChunkedPointIndex::ChunkedPointIndex(std::vector<ivec2> new_points) : points(std::move(new_points))
+{
+    if (points.empty())
+        return;
+
+    first_chunk = div_ex(points.front(), chunk_size);
+    ivec2 last_chunk = first_chunk;
+    for (ivec2 point : points)
+    {
+        clamp_var_max(first_chunk, div_ex(point, chunk_size));
+        clamp_var_min(last_chunk, div_ex(point, chunk_size));
+    }
+    num_chunks = last_chunk - first_chunk + 1;
+
+    auto ChunkIndex = [&](ivec2 point)
+    {
+        ivec2 chunk = div_ex(point, chunk_size) - first_chunk;
+        return chunk.y * num_chunks.x + chunk.x;
+    };
+
+    // A counting sort by chunks, which keeps the points of each chunk in the ascending order.
+    chunk_begin.assign(num_chunks.prod() + 1, 0);
+    for (ivec2 point : points)
+        chunk_begin[ChunkIndex(point) + 1]++;
+    for (std::size_t i = 1; i < chunk_begin.size(); i++)
+        chunk_begin[i] += chunk_begin[i - 1];
+
+    sorted_points.resize(points.size());
+    std::vector<int> next = chunk_begin;
+    for (std::size_t i = 0; i < points.size(); i++)
+        sorted_points[next[ChunkIndex(points[i])]++] = int(i);
+}
+
+TileChunkStore::TileChunkStore(const Array2D<std::uint8_t> &tiles)
+    : storage(std::make_shared<Storage>()), size_tiles(tiles.size()), num_chunks((tiles.size() + chunk_size - 1) / chunk_size)
+{
+    storage->compressed.resize(std::size_t(num_chunks.prod()));
+    storage->chunks.resize(std::size_t(num_chunks.prod()));
+
+    Jobs::DefaultPool().ParallelFor(storage->compressed.size(), [&](std::size_t i)
+    {
+        ivec2 first_tile = ivec2(int(i) % num_chunks.x, int(i) / num_chunks.x) * chunk_size;
+        Chunk chunk(chunk_size * chunk_size, std::uint8_t(Tile::air));
+        for (ivec2 pos : vector_range(min(size_tiles - first_tile, chunk_size)))
+            chunk[std::size_t(pos.y * chunk_size + pos.x)] = tiles.unsafe_at(first_tile + pos);
+
+        std::vector<std::uint8_t> &out = storage->compressed[i];
+        out.resize(Archive::MaxCompressedSize(chunk.data(), chunk.data() + chunk.size()));
+        out.resize(Archive::Compress(chunk.data(), chunk.data() + chunk.size(), out.data(), out.data() + out.size()) - out.data());
+        out.shrink_to_fit();
+    });
+}
+
+std::shared_ptr<const TileChunkStore::Chunk> TileChunkStore::DecompressChunk(const std::vector<std::uint8_t> &compressed)
+{
+    const std::uint8_t *begin = compressed.data(), *end = begin + compressed.size();
+    if (Archive::UncompressedSize(begin, end) != std::size_t(chunk_size * chunk_size))
+        Program::Error("Invalid compressed map chunk.");
+    auto ret = std::make_shared<Chunk>(chunk_size * chunk_size);
+    Archive::Uncompress(begin, end, ret->data());
+    return ret;
+}
+
+std::shared_ptr<const TileChunkStore::Chunk> TileChunkStore::GetChunk(ivec2 chunk) const
+{
+    if ((chunk < 0).any() || (chunk >= num_chunks).any())
+        Program::Error("Map chunk ", chunk, " is out of range. The chunk count is ", num_chunks, ".");
+    std::size_t index = std::size_t(chunk.y * num_chunks.x + chunk.x);
+
+    {
+        std::lock_guard lock(storage->mutex);
+        if (storage->chunks[index])
+            return storage->chunks[index];
+    }
+
+    // Decompress without the lock. If another thread does the same meanwhile, keep its copy.
+    std::shared_ptr<const Chunk> ret = DecompressChunk(storage->compressed[index]);
+    std::lock_guard lock(storage->mutex);
+    if (!storage->chunks[index])
+    {
+        storage->chunks[index] = std::move(ret);
+        storage->resident.push_back(int(index));
+    }
+    return storage->chunks[index];
+}
+
+Tile TileChunkStore::at(ivec2 pos) const
+{
+    if ((pos < 0).any() || (pos >= size_tiles).any())
+        Program::Error("Tile position ", pos, " is out of range. The map size is ", size_tiles, ".");
+    ivec2 local = pos % chunk_size;
+    return Tile((*GetChunk(pos / chunk_size))[std::size_t(local.y * chunk_size + local.x)]);
+}
+
+void TileChunkStore::Page(ivec2 tile_a, ivec2 tile_b) const
+{
+    if (!storage)
+        return;
+
+    ivec2 keep_a = clamp(div_ex(tile_a, chunk_size) - keep_margin, 0, num_chunks - 1);
+    ivec2 keep_b = clamp(div_ex(tile_b, chunk_size) + keep_margin, 0, num_chunks - 1);
+    auto InRange = [&](int index)
+    {
+        ivec2 chunk(index % num_chunks.x, index / num_chunks.x);
+        return (chunk >= keep_a).all() && (chunk <= keep_b).all();
+    };
+
+    std::lock_guard lock(storage->mutex);
+
+    // Page out. The chunks that are still in use are freed when released.
+    for (std::size_t i = 0; i < storage->resident.size();)
+    {
+        int index = storage->resident[i];
+        if (InRange(index))
+        {
+            i++;
+            continue;
+        }
+        storage->chunks[std::size_t(index)] = nullptr;
+        storage->resident[i] = storage->resident.back();
+        storage->resident.pop_back();
+    }
+
+    // Page in. Only one job at a time, the chunks it misses are picked up on the next call.
+    if (storage->job && !storage->job.IsDone())
+        return;
+    std::vector<int> missing;
+    for (ivec2 chunk : keep_a <= vector_range <= keep_b)
+    {
+        int index = chunk.y * num_chunks.x + chunk.x;
+        if (!storage->chunks[std::size_t(index)])
+            missing.push_back(index);
+    }
+    if (missing.empty())
+        return;
+
+    // The job only touches `storage`, which it keeps alive.
+    storage->job = Jobs::DefaultPool().Submit([shared = storage, missing = std::move(missing)]
+    {
+        for (int index : missing)
+        {
+            std::shared_ptr<const Chunk> chunk = DecompressChunk(shared->compressed[std::size_t(index)]);
+            std::lock_guard lock(shared->mutex);
+            if (!shared->chunks[std::size_t(index)])
+            {
+                shared->chunks[std::size_t(index)] = std::move(chunk);
+                shared->resident.push_back(index);
+            }
+        }
+    });
+}
+
+std::size_t TileChunkStore::EstimateOwnedMemory() const
+{
+    if (!storage)
+        return 0;
+    std::lock_guard lock(storage->mutex);
+    return sizeof(Storage) + Refl::EstimateOwnedMemory(storage->compressed) + Refl::EstimateOwnedMemory(storage->chunks) + Refl::EstimateOwnedMemory(storage->resident);
+}
+
+// An arbitrary stream id for `Random::CounterGenerator`.
+static constexpr std::uint64_t random_stream = 0x4d6170;
+
+Map::Map(const Compiled &compiled)
+{
+    cells = PaddedArray2D<Cell>(compiled.tiles.size(), 1);
+    random = Array2D<unsigned char>(compiled.tiles.size());
 
     for (auto pos : vector_range(cells.size()))
     {
-        auto tile = Tile(tiles.unsafe_at(pos));
-        if (tile < Tile{} || tile >= Tile::_count)
+        auto tile = Tile(compiled.tiles.unsafe_at(pos));
+        if (tile >= Tile::_count)
             throw std::runtime_error(FMT("Invalid tile index {} at {}.", int(tile), pos));
 
         Cell &cell = cells.unsafe_at(pos);
         cell.tile = tile;
 
-        random.unsafe_at(pos) = ra.i <= 255;
+        // Not using the global generator, to get the same decorations on every run and in the replays.
+        random.unsafe_at(pos) = Random::CounterGenerator::Value(random_stream, pos.y, pos.x) >> 56;
     }
 
-    points = Tiled::LoadPointLayer(Tiled::FindLayer(json.GetView(), "points"));
+    cells.refresh_border();
+    original_tiles = std::make_shared<const TileChunkStore>(compiled.tiles);
+    changed_chunk_bits.resize((std::size_t(original_tiles->NumChunks().prod()) + BitVec::bit_width<std::uint64_t> - 1) / BitVec::bit_width<std::uint64_t>);
+
+    points.points = compiled.points;
 
     player_start = points.GetSinglePoint("player");
     debug_player_start = points.GetSinglePointOpt("debug_player");
@@ -39,83 +309,539 @@ Map::Map(Stream::ReadOnlyData data)
     ability_gun = points.GetSinglePointOpt("ability_gun");
     debug_start_with_gun = points.GetSinglePointOpt("debug_give_gun").has_value();
 
+    std::vector<ivec2> secret_points;
     points.ForEachPointNamed("secret", [&](fvec2 pos)
     {
-        secrets.push_back(pos);
+        secret_points.push_back(pos);
     });
-    num_secrets = int(secrets.size());
+    secrets = std::make_shared<const ChunkedPointIndex>(std::move(secret_points));
+    num_secrets = int(secrets->Points().size());
+    secret_taken.resize(num_secrets);
+
+    autotiles = Array2D<Autotile>(cells.size());
+    UpdateAutotiles(ivec2(0), cells.size() - 1);
+
+    solid_bits.resize((cells.size().prod() + BitVec::bit_width<std::uint64_t> - 1) / BitVec::bit_width<std::uint64_t>);
+    for (auto pos : vector_range(cells.size()))
+    {
+        if (cells.unsafe_at(pos).info().solid)
+            BitVec::SetBitOrThrow(solid_bits, pos.y * cells.size().x + pos.x);
+    }
 }
 
-void Map::render(ivec2 camera_pos) const
+Map::Autotile Map::ComputeAutotile(ivec2 pos) const
 {
-    static const auto &region = texture_atlas.Get("tiles.png");
+    Autotile ret;
 
-    ivec2 corner_a = div_ex(camera_pos - screen_size / 2, tile_size);
-    ivec2 corner_b = div_ex(camera_pos + screen_size / 2, tile_size);
+    // Inside of the map, the neighbors are at most one tile away, so they are in the border of `cells` at worst.
+    bool in_map = cells.pos_in_range(pos);
+    auto CellAt = [&](ivec2 cell_pos) -> const Cell &
+    {
+        return in_map ? cells.unsafe_at(cell_pos) : at(cell_pos);
+    };
+
+    for (ivec2 tile_offset : vector_range(ivec2(2)))
+    {
+        ret.dual_grid_mask |= 16 * CellAt(pos + tile_offset).info().is_dual_grid_tile;
+        ret.dual_grid_mask >>= 1;
+    }
+
+    const Cell &cell = CellAt(pos);
+    const TileInfo &info = cell.info();
+    if (info.spike_like_dir != -1)
+    {
+        int sign = info.spike_like_dir == 1 ? -1 : 1;
+        ivec2 offset_a = ivec2(-1 * sign, 0).rot90(info.spike_like_dir);
+        ivec2 offset_b = ivec2( 1 * sign, 0).rot90(info.spike_like_dir);
+        const Cell &cell_a = CellAt(pos + offset_a);
+        const Cell &cell_b = CellAt(pos + offset_b);
+        ret.spike_same_a = cell_a.tile == cell.tile || (info.spike_like_merge_with_any_solid && cell_a.info().solid);
+        ret.spike_same_b = cell_b.tile == cell.tile || (info.spike_like_merge_with_any_solid && cell_b.info().solid);
+    }
+
+    return ret;
+}
+
+void Map::UpdateAutotiles(ivec2 a, ivec2 b)
+{
+    clamp_var(a, 0, autotiles.size() - 1);
+    clamp_var(b, 0, autotiles.size() - 1);
+    for (ivec2 pos : a <= vector_range <= b)
+        autotiles.unsafe_at(pos) = ComputeAutotile(pos);
+}
+
+Map::SweepResult Map::SweepBox(fvec2 box_a, fvec2 box_b, fvec2 delta) const
+{
+    SweepResult ret;
+
+    ivec2 tile_a = div_ex(ivec2(floor(min(box_a, box_a + delta))), tile_size);
+    ivec2 tile_b = div_ex(ivec2(ceil(max(box_b, box_b + delta))) - 1, tile_size);
+
+    for (ivec2 tile_pos : tile_a <= vector_range <= tile_b)
+    {
+        if (!SolidAt(tile_pos))
+            continue;
+
+        fvec2 solid_a = tile_pos * tile_size;
+        fvec2 solid_b = solid_a + tile_size;
 
-    { // Bottom layer.
-        for (ivec2 tile_pos : corner_a <= vector_range <= corner_b)
+        // The time interval during which the box overlaps the tile, separately for each axis.
+        fvec2 entry, exit;
+        bool overlaps = true;
+        for (int i = 0; i < 2; i++)
         {
-            const Cell &cell = at(tile_pos);
-            const TileInfo &info = cell.info();
+            if (delta[i] > 0)
+            {
+                entry[i] = (solid_a[i] - box_b[i]) / delta[i];
+                exit[i] = (solid_b[i] - box_a[i]) / delta[i];
+            }
+            else if (delta[i] < 0)
+            {
+                entry[i] = (solid_b[i] - box_a[i]) / delta[i];
+                exit[i] = (solid_a[i] - box_b[i]) / delta[i];
+            }
+            else if (box_a[i] < solid_b[i] && box_b[i] > solid_a[i])
+            {
+                entry[i] = -std::numeric_limits<float>::infinity();
+                exit[i] = std::numeric_limits<float>::infinity();
+            }
+            else
+            {
+                overlaps = false;
+            }
+        }
+        if (!overlaps)
+            continue;
+
+        float entry_time = max(entry.x, entry.y);
+        float exit_time = min(exit.x, exit.y);
+        if (entry_time < 0 || entry_time >= exit_time || entry_time >= ret.time)
+            continue;
+
+        int axis = entry.x >= entry.y ? 0 : 1;
+        ret.hit = true;
+        ret.time = entry_time;
+        ret.normal = ivec2{};
+        ret.normal[axis] = -sign(delta[axis]);
+    }
+
+    return ret;
+}
+
+Map::Snapshot Map::SaveSnapshot() const
+{
+    Snapshot ret;
+    ForEachChangedChunk([&](ivec2 chunk_pos, const TileChunkStore::Chunk &original)
+    {
+        ivec2 first_tile = chunk_pos * TileChunkStore::chunk_size;
+        for (ivec2 pos : vector_range(min(cells.size() - first_tile, TileChunkStore::chunk_size)))
+        {
+            Tile tile = cells.unsafe_at(first_tile + pos).tile;
+            if (tile != Tile(original[std::size_t(pos.y * TileChunkStore::chunk_size + pos.x)]))
+            {
+                ret.changed_tile_pos.push_back(first_tile + pos);
+                ret.changed_tiles.push_back(std::uint8_t(tile));
+            }
+        }
+    });
+    ret.ability_timeshift = ability_timeshift;
+    ret.ability_doublejump = ability_doublejump;
+    ret.ability_gun = ability_gun;
+    for (std::size_t i = 0; i < secret_taken.size(); i++)
+    {
+        if (!secret_taken[i])
+            ret.secrets.push_back(secrets->Points()[i]);
+    }
+    return ret;
+}
+
+std::vector<bool> Map::ValidateSnapshot(const Snapshot &snapshot) const
+{
+    if (snapshot.changed_tile_pos.size() != snapshot.changed_tiles.size())
+        Program::Error("The map snapshot has mismatching array sizes.");
+    for (std::size_t i = 0; i < snapshot.changed_tiles.size(); i++)
+    {
+        if (!cells.pos_in_range(snapshot.changed_tile_pos[i]))
+            Program::Error("The map snapshot changes a tile at ", snapshot.changed_tile_pos[i], ", which is outside of the map.");
+        if (snapshot.changed_tiles[i] >= std::uint8_t(Tile::_count))
+            Program::Error("Invalid tile index ", int(snapshot.changed_tiles[i]), " in the map snapshot.");
+    }
+    std::vector<bool> new_secret_taken(secret_taken.size(), true);
+    for (ivec2 pos : snapshot.secrets)
+    {
+        // There can be several secrets at the same position, take the first one that isn't restored yet.
+        std::optional<std::size_t> index;
+        secrets->ForEachInRect(pos, pos, [&](std::size_t i)
+        {
+            if (!index && new_secret_taken[i])
+                index = i;
+        });
+        if (!index)
+            Program::Error("The map snapshot has a secret at ", pos, ", which is not on the map.");
+        new_secret_taken[*index] = false;
+    }
+    return new_secret_taken;
+}
+
+void Map::LoadSnapshot(const Snapshot &snapshot)
+{
+    std::vector<bool> new_secret_taken = ValidateSnapshot(snapshot);
+
+    ForEachChangedChunk([&](ivec2 chunk_pos, const TileChunkStore::Chunk &original)
+    {
+        ivec2 first_tile = chunk_pos * TileChunkStore::chunk_size;
+        for (ivec2 pos : vector_range(min(cells.size() - first_tile, TileChunkStore::chunk_size)))
+            SetTile(first_tile + pos, Tile(original[std::size_t(pos.y * TileChunkStore::chunk_size + pos.x)])); // This does nothing for the unchanged tiles.
+    });
+    std::fill(changed_chunk_bits.begin(), changed_chunk_bits.end(), 0);
+    for (std::size_t i = 0; i < snapshot.changed_tiles.size(); i++)
+        SetTile(snapshot.changed_tile_pos[i], Tile(snapshot.changed_tiles[i]));
+
+    ability_timeshift = snapshot.ability_timeshift;
+    ability_doublejump = snapshot.ability_doublejump;
+    ability_gun = snapshot.ability_gun;
+    secret_taken = std::move(new_secret_taken);
+    num_secrets_taken = int(std::count(secret_taken.begin(), secret_taken.end(), true));
+}
+
+std::size_t Map::EstimateOwnedMemory() const
+{
+    return Refl::EstimateOwnedMemory(render_cache) + Refl::EstimateOwnedMemory(cells) + Refl::EstimateOwnedMemory(original_tiles) +
+        Refl::EstimateOwnedMemory(changed_chunk_bits) + Refl::EstimateOwnedMemory(random) + Refl::EstimateOwnedMemory(autotiles) + Refl::EstimateOwnedMemory(solid_bits) +
+        Refl::EstimateOwnedMemory(secrets) + Refl::EstimateOwnedMemory(secret_taken) + Refl::EstimateOwnedMemory(points.points);
+}
+
+void Map::SetTile(ivec2 pos, Tile tile)
+{
+    ivec2 clamped_pos = clamp(pos, 0, cells.size() - 1);
+    Cell cell = cells.unsafe_at(clamped_pos);
+    if (cell.tile == tile)
+        return;
+    overlay_hash ^= OverlayHashTerm(clamped_pos, cell.tile) ^ OverlayHashTerm(clamped_pos, tile);
+    cell.tile = tile;
+    cells.set(clamped_pos, cell);
+    BitVec::SetBitOrThrow(solid_bits, clamped_pos.y * cells.size().x + clamped_pos.x, cell.info().solid);
+    ivec2 original_chunk = clamped_pos / TileChunkStore::chunk_size;
+    BitVec::SetBitOrThrow(changed_chunk_bits, original_chunk.y * original_tiles->NumChunks().x + original_chunk.x);
+
+    // The spike-like neighbors on both sides, and the dual grid cells to the top-left.
+    UpdateAutotiles(clamped_pos - 1, clamped_pos + 1);
+
+    if (render_cache.tilemap.Object() && !render_cache.tilemap_dirty)
+        render_cache.tilemap_changed_tiles.push_back(clamped_pos);
+
+    if (render_cache.chunks.size().prod() == 0)
+        return;
+
+    if ((clamped_pos <= 0).any() || (clamped_pos >= cells.size() - 1).any())
+    {
+        // Edge tiles are repeated outside of the map, so everything around them has to be redrawn. This should be rare.
+        for (auto chunk_pos : vector_range(render_cache.chunks.size()))
+            render_cache.chunks.unsafe_at(chunk_pos).dirty = true;
+        return;
+    }
+
+    // The neighbors can depend on this tile, both for spike-like tiles and the dual grid.
+    ivec2 chunk_a = div_ex(clamped_pos - 1, render_chunk_size) - render_cache.first_chunk;
+    ivec2 chunk_b = div_ex(clamped_pos + 1, render_chunk_size) - render_cache.first_chunk;
+    for (ivec2 chunk_pos : chunk_a <= vector_range <= chunk_b)
+    {
+        if (render_cache.chunks.pos_in_range(chunk_pos))
+            render_cache.chunks.unsafe_at(chunk_pos).dirty = true;
+    }
+}
+
+void Map::render_layer(int layer, ivec2 tile_a, ivec2 tile_b, ivec2 offset) const
+{
+    const auto &region = texture_atlas.Get<"tiles.png">();
+
+    switch (layer)
+    {
+      case 0: // Bottom layer.
+        for (ivec2 tile_pos : tile_a <= vector_range <= tile_b)
+        {
+            const TileInfo &info = at(tile_pos).info();
             if (info.spike_like_dir != -1)
             {
                 int sign = info.spike_like_dir == 1 ? -1 : 1;
 
                 ivec2 dir = ivec2::dir4(info.spike_like_dir);
                 fmat2 mat(dir, dir.rot90());
-                ivec2 offset_a = ivec2(-1 * sign, 0).rot90(info.spike_like_dir);
-                ivec2 offset_b = ivec2( 1 * sign, 0).rot90(info.spike_like_dir);
-                const Cell &cell_a = at(tile_pos + offset_a);
-                const Cell &cell_b = at(tile_pos + offset_b);
-                bool same_a = cell_a.tile == cell.tile || (info.spike_like_merge_with_any_solid && cell_a.info().solid);
-                bool same_b = cell_b.tile == cell.tile || (info.spike_like_merge_with_any_solid && cell_b.info().solid);
-
-                ivec2 pixel_pos = tile_pos * tile_size + tile_size/2 - camera_pos;
+                Autotile autotile = GetAutotile(tile_pos);
+                bool same_a = autotile.spike_same_a;
+                bool same_b = autotile.spike_same_b;
+
+                ivec2 pixel_pos = tile_pos * tile_size + tile_size/2 - offset;
                 r.iquad(pixel_pos, region.region(ivec2(0, tile_size * (info.spike_like_tex + same_a)), ivec2(tile_size) with(x /= 2))).center(ivec2(tile_size/2)).matrix(mat).flip_x(sign < 0);
                 r.iquad(pixel_pos, region.region(ivec2(tile_size/2, tile_size * (info.spike_like_tex + same_b)), ivec2(tile_size) with(x /= 2))).center(ivec2(0, tile_size/2)).matrix(mat).flip_x(sign < 0);
             }
         }
-    }
-
-    { // Dual-grid layer.
-        ivec2 dual_corner_a = div_ex(camera_pos - screen_size / 2 - tile_size / 2, tile_size);
-        ivec2 dual_corner_b = div_ex(camera_pos + screen_size / 2 - tile_size / 2, tile_size);
+        break;
 
-
-        for (ivec2 tile_pos : dual_corner_a <= vector_range <= dual_corner_b)
+      case 1: // Dual-grid layer.
+        for (ivec2 tile_pos : tile_a <= vector_range <= tile_b)
         {
-            { // Dual grid.
-                int bits = 0;
-                for (ivec2 tile_offset : vector_range(ivec2(2)))
-                {
-                    bits |= 16 * at(tile_pos + tile_offset).info().is_dual_grid_tile;
-                    bits >>= 1;
-                }
-
-                ivec2 variant(bits % 4, bits / 4);
-                // if (bits == 15)
-                // {
-                //     int randvar = rand_at(tile_pos) / 8;
-                //     if (randvar < 4)
-                //         variant = ivec2(4, randvar);
-                // }
+            int bits = GetAutotile(tile_pos).dual_grid_mask;
+            ivec2 variant(bits % 4, bits / 4);
+            // if (bits == 15)
+            // {
+            //     int randvar = rand_at(tile_pos) / 8;
+            //     if (randvar < 4)
+            //         variant = ivec2(4, randvar);
+            // }
 
-                ivec2 dual_pixel_pos = tile_pos * tile_size + tile_size / 2 - camera_pos;
-                r.iquad(dual_pixel_pos, region.region((variant + ivec2(1, 0)) * tile_size, ivec2(tile_size)));
-            }
+            ivec2 dual_pixel_pos = tile_pos * tile_size + tile_size / 2 - offset;
+            r.isprite(dual_pixel_pos, region.region((variant + ivec2(1, 0)) * tile_size, ivec2(tile_size)));
         }
-    }
+        break;
 
-    { // Top layer.
-        for (ivec2 tile_pos : corner_a <= vector_range <= corner_b)
+      case 2: // Top layer.
+        for (ivec2 tile_pos : tile_a <= vector_range <= tile_b)
         {
             const Cell &cell = at(tile_pos);
             const TileInfo &info = cell.info();
             if (info.simple_tex != -1)
             {
-                r.iquad(tile_pos * tile_size - camera_pos, region.region(ivec2(0, tile_size * info.simple_tex), ivec2(tile_size)));
+                r.isprite(tile_pos * tile_size - offset, region.region(ivec2(0, tile_size * info.simple_tex), ivec2(tile_size)));
             }
         }
+        break;
+    }
+}
+
+u8vec4 Map::TilemapTexel(ivec2 pos) const
+{
+    const TileInfo &info = at(pos).info();
+    Autotile autotile = GetAutotile(pos);
+
+    u8vec4 ret;
+    ret.x = autotile.dual_grid_mask;
+    if (info.spike_like_dir != -1)
+    {
+        ret.y = std::uint8_t(info.spike_like_dir | 4 | autotile.spike_same_a << 3 | autotile.spike_same_b << 4);
+        ret.z = std::uint8_t(info.spike_like_tex);
+    }
+    ret.w = std::uint8_t(info.simple_tex + 1);
+    return ret;
+}
+
+namespace
+{
+    struct TilemapShader
+    {
+        // The matrices come from the uniform block of `Render`.
+        REFL_SIMPLE_STRUCT( Uniforms
+            REFL_DECL(Graphics::Uniform<fvec2> REFL_ATTR Graphics::Vert) camera_pos
+            REFL_DECL(Graphics::Uniform<fvec2> REFL_ATTR Graphics::Vert) half_screen_size
+            REFL_DECL(Graphics::Uniform<Graphics::TexUnit> REFL_ATTR Graphics::Frag) texture
+            REFL_DECL(Graphics::Uniform<ivec2> REFL_ATTR Graphics::Frag) atlas_pos // The position of `tiles.png` in the atlas.
+            REFL_DECL(Graphics::Uniform<ivec2> REFL_ATTR Graphics::Frag) tilemap_size // Including the border.
+        )
+
+        // One quad covering the screen. The corners come from the vertex ID, there are no vertex attributes.
+        static constexpr const char *vertex_source = R"(
+varying vec2 v_pos;
+void main()
+{
+    vec2 pos = (vec2(gl_VertexID % 2, gl_VertexID / 2) * 2.0 - 1.0) * u_half_screen_size;
+    gl_Position = u_matrix * vec4(pos, 0, 1);
+    v_pos = pos + u_camera_pos;
+})";
+
+        // Mirrors `Map::render_layer()`, for each pixel. See `Map::TilemapTexel()` for the data layout.
+        // The layers are blended in the shader, in the same order as the quads would be drawn.
+        static constexpr const char *fragment_source = R"(
+uniform usampler2D u_tilemap;
+varying vec2 v_pos;
+
+// The tiles outside of the border look the same as the border, since the map is clamped.
+uvec4 TileAt(ivec2 tile)
+{
+    return texelFetch(u_tilemap, clamp(tile + 1, ivec2(0), u_tilemap_size - 1), 0);
+}
+
+// Same as the textured path of the main shader in `Render`.
+void Blend(inout vec4 color, ivec2 texel)
+{
+    vec4 tex_color = texelFetch(u_texture, u_atlas_pos + texel, 0);
+    vec4 result = u_color_matrix * vec4(tex_color.rgb, 1);
+    tex_color.a *= result.a;
+    color = vec4(result.rgb * tex_color.a, tex_color.a) + color * (1.0 - tex_color.a);
+}
+
+void main()
+{
+    ivec2 pixel = ivec2(floor(v_pos));
+    ivec2 tile = ivec2(floor(v_pos / float(tile_size)));
+    ivec2 local = pixel - tile * tile_size;
+    uvec4 data = TileAt(tile);
+
+    vec4 color = vec4(0);
+
+    // Spike-like tiles. Each half of the tile is mirrored and rotated separately, so this works with the pixel centers relative to the tile center, doubled to keep them integral.
+    if ((data.y & 4u) != 0u)
+    {
+        int dir_index = int(data.y & 3u);
+        ivec2 dir = dir_index == 0 ? ivec2(1, 0) : dir_index == 1 ? ivec2(0, 1) : dir_index == 2 ? ivec2(-1, 0) : ivec2(0, -1);
+        ivec2 offset = local * 2 + 1 - tile_size;
+        ivec2 rotated = ivec2(offset.x * dir.x + offset.y * dir.y, offset.y * dir.x - offset.x * dir.y);
+        if (dir_index == 1)
+            rotated.x = -rotated.x;
+        bool same = (data.y & (rotated.x < 0 ? 8u : 16u)) != 0u;
+        ivec2 texel = (rotated + tile_size - 1) / 2;
+        Blend(color, texel + ivec2(0, tile_size * (int(data.z) + int(same))));
+    }
+
+    // Dual grid, shifted by a half tile.
+    ivec2 dual_pixel = pixel - tile_size / 2;
+    ivec2 dual_tile = ivec2(floor(vec2(dual_pixel) / float(tile_size)));
+    int mask = int(TileAt(dual_tile).x);
+    Blend(color, (ivec2(mask % 4, mask / 4) + ivec2(1, 0)) * tile_size + dual_pixel - dual_tile * tile_size);
+
+    // Simple tiles.
+    if (data.w != 0u)
+        Blend(color, local + ivec2(0, tile_size * (int(data.w) - 1)));
+
+    gl_FragColor = color;
+})";
+
+        Uniforms uni;
+        Graphics::Shader shader;
+        GLint tilemap_location = -1;
+
+        TilemapShader()
+            : shader("Tilemap", shader_config, Graphics::ShaderPreferences{}, Meta::tag<Graphics::none_t>{}, uni,
+                Render::SharedUniformsDeclaration() + vertex_source, Render::SharedUniformsDeclaration() + FMT("const int tile_size = {};\n", tile_size) + fragment_source)
+        {
+            r.AttachSharedUniforms(shader);
+
+            // The sampler is not in `Uniforms`, since `Uniform<TexUnit>` is always a `sampler2D`, and this one is integral.
+            // Each map has its own texture, so the unit is set before each draw.
+            tilemap_location = glGetUniformLocation(shader.Handle(), "u_tilemap");
+        }
+    };
+}
+
+void Map::render_tilemap(ivec2 camera_pos) const
+{
+    static TilemapShader shader;
+
+    ivec2 tilemap_size = size() + 2;
+    auto Upload = [&](ivec2 a, ivec2 b) // An inclusive range of tiles.
+    {
+        clamp_var(a, -1, size());
+        clamp_var(b, -1, size());
+        std::vector<u8vec4> texels;
+        texels.reserve((b - a + 1).prod());
+        for (ivec2 pos : a <= vector_range <= b) // Row-major, as the texture expects.
+            texels.push_back(TilemapTexel(pos));
+        render_cache.tilemap.SetDataPart(GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, a + 1, b - a + 1, reinterpret_cast<const std::uint8_t *>(texels.data()));
+    };
+
+    if (!render_cache.tilemap.Object())
+        render_cache.tilemap = Graphics::Texture(nullptr).Interpolation(Graphics::nearest).Wrap(Graphics::clamp);
+    // After loading a snapshot, a lot of tiles can change at once, then it's cheaper to upload everything.
+    if (render_cache.tilemap_dirty || render_cache.tilemap.Size() != tilemap_size || render_cache.tilemap_changed_tiles.size() * 9 >= std::size_t(tilemap_size.prod()))
+    {
+        render_cache.tilemap.SetData(GL_RGBA8UI, GL_RGBA_INTEGER, GL_UNSIGNED_BYTE, tilemap_size);
+        Upload(ivec2(-1), size());
+        render_cache.tilemap_dirty = false;
+    }
+    else
+    {
+        // A tile affects the spike-like neighbors on both sides, and the dual grid cells to the top-left (and the border, if it's at the edge).
+        for (ivec2 pos : render_cache.tilemap_changed_tiles)
+            Upload(pos - 1, pos + 1);
+    }
+    render_cache.tilemap_changed_tiles.clear();
+
+    r.Finish();
+
+    shader.shader.Bind();
+    r.BindSharedUniforms();
+    shader.uni.camera_pos = camera_pos;
+    shader.uni.half_screen_size = screen_size / 2;
+    shader.uni.texture = texture_main;
+    shader.uni.atlas_pos = texture_atlas.Get<"tiles.png">().pos;
+    shader.uni.tilemap_size = tilemap_size;
+    glUniform1i(shader.tilemap_location, render_cache.tilemap.Index());
+
+    Graphics::VertexBuffers::BindDraw(0, nullptr); // We don't use any attributes.
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+    r.BindShader();
+}
+
+void Map::render(ivec2 camera_pos) const
+{
+    // Keep the original tiles around the camera decompressed, for `RestoreTile()` and the snapshots.
+    original_tiles->Page(div_ex(camera_pos - screen_size / 2, tile_size) - 1, div_ex(camera_pos + screen_size / 2, tile_size));
+
+    if (launch_options.gpu_tilemap)
+    {
+        render_tilemap(camera_pos);
+        return;
+    }
+
+    if (render_cache.chunks.size().prod() == 0)
+    {
+        // Cover the map, plus enough space around it to fill the screen when the camera is at the edge.
+        ivec2 margin = screen_size / 2 / tile_size + 2;
+        render_cache.first_chunk = div_ex(-margin, render_chunk_size);
+        ivec2 last_chunk = div_ex(size() - 1 + margin, render_chunk_size);
+        render_cache.chunks = Array2D<RenderCache::Chunk>(last_chunk - render_cache.first_chunk + 1);
+    }
+
+    // The dual grid cells are shifted by a half tile, so one more column and row can be visible on the top-left.
+    ivec2 chunk_a = div_ex(div_ex(camera_pos - screen_size / 2, tile_size) - 1, render_chunk_size) - render_cache.first_chunk;
+    ivec2 chunk_b = div_ex(div_ex(camera_pos + screen_size / 2, tile_size), render_chunk_size) - render_cache.first_chunk;
+    clamp_var(chunk_a, 0, render_cache.chunks.size() - 1);
+    clamp_var(chunk_b, 0, render_cache.chunks.size() - 1);
+
+    for (ivec2 chunk_pos : chunk_a <= vector_range <= chunk_b)
+    {
+        RenderCache::Chunk &chunk = render_cache.chunks.unsafe_at(chunk_pos);
+        if (!chunk.dirty)
+            continue;
+
+        if (!chunk.layers[0])
+            render_cache.resident.push_back(chunk_pos);
+
+        ivec2 tile_a = (chunk_pos + render_cache.first_chunk) * render_chunk_size;
+        ivec2 tile_b = tile_a + render_chunk_size - 1;
+        for (int i = 0; i < num_render_layers; i++)
+        {
+            r.BeginCapture();
+            render_layer(i, tile_a, tile_b, ivec2(0));
+            r.EndCapture(chunk.layers[i]);
+        }
+        chunk.dirty = false;
+    }
+
+    for (int i = 0; i < num_render_layers; i++)
+    {
+        for (ivec2 chunk_pos : chunk_a <= vector_range <= chunk_b)
+            r.Draw(render_cache.chunks.unsafe_at(chunk_pos).layers[i], -camera_pos);
+    }
+
+    // Drop the geometry of the chunks that are far enough from the camera. They are rebuilt if they become visible again.
+    ivec2 keep_a = chunk_a - render_chunk_keep_margin;
+    ivec2 keep_b = chunk_b + render_chunk_keep_margin;
+    for (std::size_t i = 0; i < render_cache.resident.size();)
+    {
+        ivec2 chunk_pos = render_cache.resident[i];
+        if ((chunk_pos >= keep_a).all() && (chunk_pos <= keep_b).all())
+        {
+            i++;
+            continue;
+        }
+
+        RenderCache::Chunk &chunk = render_cache.chunks.unsafe_at(chunk_pos);
+        for (Render::Geometry &layer : chunk.layers)
+            layer = {};
+        chunk.dirty = true;
+
+        render_cache.resident[i] = render_cache.resident.back();
+        render_cache.resident.pop_back();
     }
 }
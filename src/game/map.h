@@ -1,5 +1,13 @@
 #pragma once
 
+#include <memory>
+#include <mutex>
+
+#include "utils/bit_vectors.h"
+#include "utils/jobs.h"
+#include "utils/padded_array.h"
+#include "utils/state_hash.h"
+
 inline constexpr int tile_size = 12;
 
 enum class Tile
@@ -65,16 +73,189 @@ struct Cell
     [[nodiscard]] const TileInfo &info() const
     {
         if (tile < Tile{} || tile >= Tile::_count)
-            throw std::runtime_error("Invalid tile enum.");
+            Program::Error("Invalid tile enum.");
         return tile_info[std::size_t(tile)];
     }
 };
 
+// Static points (e.g. the objects from the map point layer), bucketed by square chunks.
+// Finds the points in a rectangle visiting only the chunks that overlap it, so the cost doesn't depend on the total number of points.
+class ChunkedPointIndex
+{
+    std::vector<ivec2> points;
+    ivec2 first_chunk; // The chunk coordinates of the first chunk.
+    ivec2 num_chunks;
+    std::vector<int> chunk_begin; // For each chunk (row-major), the first element of `sorted_points`. Has an extra element at the end.
+    std::vector<int> sorted_points; // Indices in `points`, grouped by chunks. Ascending in each chunk.
+
+  public:
+    static constexpr int chunk_size = 16 * tile_size; // In pixels.
+
+    ChunkedPointIndex() {}
+    explicit ChunkedPointIndex(std::vector<ivec2> new_points);
+
+    [[nodiscard]] const std::vector<ivec2> &Points() const
+    {
+        return points;
+    }
+
+    // For `Refl::EstimateMemory()`.
+    [[nodiscard]] std::size_t EstimateOwnedMemory() const
+    {
+        return Refl::EstimateOwnedMemory(points) + Refl::EstimateOwnedMemory(chunk_begin) + Refl::EstimateOwnedMemory(sorted_points);
+    }
+
+    // Calls `func(i)` for the index of each point in an inclusive rectangle, in pixels.
+    template <typename F>
+    void ForEachInRect(ivec2 a, ivec2 b, F &&func) const
+    {
+        if (points.empty())
+            return;
+
+        ivec2 chunk_a = max(div_ex(a, chunk_size) - first_chunk, 0);
+        ivec2 chunk_b = min(div_ex(b, chunk_size) - first_chunk, num_chunks - 1);
+        if ((chunk_a > chunk_b).any())
+            return;
+
+        for (ivec2 chunk : chunk_a <= vector_range <= chunk_b)
+        {
+            int chunk_index = chunk.y * num_chunks.x + chunk.x;
+            for (int i = chunk_begin[chunk_index]; i < chunk_begin[chunk_index + 1]; i++)
+            {
+                int point_index = sorted_points[i];
+                ivec2 point = points[point_index];
+                if ((point >= a).all() && (point <= b).all())
+                    func(std::size_t(point_index));
+            }
+        }
+    }
+};
+
+// The original tiles of the map, split into square chunks. Immutable apart from the paging, so the copies of the map share it. Thread-safe.
+// Each chunk is kept compressed, and `Page()` keeps only the chunks around the camera decompressed, so most of the map costs only its compressed size.
+// The chunks that aren't decompressed yet are decompressed on access.
+class TileChunkStore
+{
+  public:
+    static constexpr int chunk_size = 64; // In tiles.
+    // `Page()` keeps the chunks this far from the visible ones, in chunks.
+    static constexpr int keep_margin = 1;
+
+    // The tiles of one chunk, row-major. Always `chunk_size` tiles per side, the ones outside of the map are `Tile::air`.
+    using Chunk = std::vector<std::uint8_t>;
+
+  private:
+    // Shared with the background job, so the store can be destroyed while the job runs.
+    struct Storage
+    {
+        std::vector<std::vector<std::uint8_t>> compressed; // For each chunk, row-major. From `Archive::Compress()`. Immutable.
+
+        std::mutex mutex; // Guards the members below.
+        std::vector<std::shared_ptr<const Chunk>> chunks; // For each chunk, null if it's not decompressed.
+        std::vector<int> resident; // The indices of the non-null `chunks`, in no particular order.
+        Jobs::Handle job; // Decompresses the chunks requested by `Page()`.
+    };
+    std::shared_ptr<Storage> storage;
+    ivec2 size_tiles;
+    ivec2 num_chunks;
+
+    [[nodiscard]] static std::shared_ptr<const Chunk> DecompressChunk(const std::vector<std::uint8_t> &compressed);
+
+  public:
+    TileChunkStore() {}
+    explicit TileChunkStore(const Array2D<std::uint8_t> &tiles);
+
+    [[nodiscard]] ivec2 size() const {return size_tiles;}
+    [[nodiscard]] ivec2 NumChunks() const {return num_chunks;}
+
+    // Returns a chunk, decompressing it if needed. The chunk stays valid while you hold it, even if it's paged out meanwhile.
+    [[nodiscard]] std::shared_ptr<const Chunk> GetChunk(ivec2 chunk) const;
+    // Throws if `pos` is outside of the map. Prefer `GetChunk()` for many nearby tiles.
+    [[nodiscard]] Tile at(ivec2 pos) const;
+
+    // Drops the decompressed chunks further than `keep_margin` from an inclusive range of tiles, and starts decompressing the missing ones on `Jobs::DefaultPool()`.
+    // Call this once per frame with the visible tiles.
+    void Page(ivec2 tile_a, ivec2 tile_b) const;
+
+    // For `Refl::EstimateMemory()`. Only the chunks that are currently decompressed.
+    [[nodiscard]] std::size_t EstimateOwnedMemory() const;
+};
+
 struct Map
 {
-    Array2D<Cell> cells;
+    // The tiles are rendered from cached geometry, in square chunks with this many tiles per side.
+    static constexpr int render_chunk_size = 16;
+    static constexpr int num_render_layers = 3; // Spike-like tiles, dual grid, simple tiles.
+    // The geometry is dropped for the chunks further than this from the visible ones, so its amount doesn't depend on the map size.
+    static constexpr int render_chunk_keep_margin = 2;
+
+    // Cached geometry for `render()`.
+    // It's not copied with the map, the copy rebuilds it on demand.
+    struct RenderCache
+    {
+        struct Chunk
+        {
+            Render::Geometry layers[num_render_layers];
+            bool dirty = true;
+
+            [[nodiscard]] std::size_t EstimateOwnedMemory() const
+            {
+                return Refl::EstimateOwnedMemory(layers);
+            }
+        };
+        Array2D<Chunk> chunks;
+        ivec2 first_chunk; // The chunk coordinates of `chunks[0,0]`.
+        std::vector<ivec2> resident; // Indices in `chunks` of the chunks that have geometry, in no particular order.
+
+        // For `launch_options.gpu_tilemap`. One texel per tile, see `TilemapTexel()`, with a one tile border around the map.
+        Graphics::Texture tilemap;
+        bool tilemap_dirty = true; // If true, the whole `tilemap` is uploaded again.
+        std::vector<ivec2> tilemap_changed_tiles; // The tiles changed since the last upload. Each one updates its 3x3 neighborhood.
+
+        RenderCache() {}
+        RenderCache(const RenderCache &) {}
+        RenderCache &operator=(const RenderCache &)
+        {
+            chunks = {};
+            resident = {};
+            tilemap_dirty = true;
+            tilemap_changed_tiles = {};
+            return *this;
+        }
+        RenderCache(RenderCache &&) = default;
+        RenderCache &operator=(RenderCache &&) = default;
+
+        // Including the video memory.
+        [[nodiscard]] std::size_t EstimateOwnedMemory() const
+        {
+            return Refl::EstimateOwnedMemory(chunks) + Refl::EstimateOwnedMemory(resident) + Refl::EstimateOwnedMemory(tilemap) + Refl::EstimateOwnedMemory(tilemap_changed_tiles);
+        }
+    };
+    mutable RenderCache render_cache;
+
+    // The border lets the neighbor lookups skip the clamping. Modify with `SetTile()` to keep it in sync.
+    PaddedArray2D<Cell> cells;
+    // The tiles as they were loaded. The copies of the map share them.
+    std::shared_ptr<const TileChunkStore> original_tiles;
+    // One bit per chunk of `original_tiles`, row-major. Set by `SetTile()` when a tile in the chunk changes, so the other chunks can be skipped when looking for the changed tiles.
+    // It stays set if the tiles are changed back, until `LoadSnapshot()`.
+    std::vector<std::uint64_t> changed_chunk_bits;
+    // The xor of `OverlayHashTerm()` of every tile, for the current and the original value. So it's zero when no tiles are changed.
+    // Kept in sync by `SetTile()`. Lets `World::StateHash()` hash the tiles without scanning the whole map.
+    std::uint64_t overlay_hash = 0;
     Array2D<unsigned char> random;
 
+    // Precomputed neighbor-dependent rendering data for each tile. See `ComputeAutotile()`.
+    struct Autotile
+    {
+        unsigned char dual_grid_mask = 0; // For the dual grid cell between this tile and the next one on both axes.
+        bool spike_same_a = false, spike_same_b = false; // For spike-like tiles, whether they connect to the neighbors on both sides.
+    };
+    Array2D<Autotile> autotiles;
+
+    // One bit per tile, set if the tile is solid. Row-major. Kept in sync by `SetTile()`.
+    std::vector<std::uint64_t> solid_bits;
+
     ivec2 player_start;
     std::optional<ivec2> debug_player_start;
     float initial_lava_level = 0;
@@ -89,8 +270,11 @@ struct Map
     std::optional<ivec2> ability_gun;
     bool debug_start_with_gun = false;
 
-    std::vector<ivec2> secrets;
+    // The secrets from the point layer. Immutable, so the copies of the map share them.
+    std::shared_ptr<const ChunkedPointIndex> secrets;
+    std::vector<bool> secret_taken; // Parallel to `secrets->Points()`.
     int num_secrets = 0;
+    int num_secrets_taken = 0;
 
     Tiled::PointLayer points;
 
@@ -106,6 +290,40 @@ struct Map
         }
     )
 
+    // Same as `at(pos).info().solid`, but faster.
+    [[nodiscard]] bool SolidAt(ivec2 pos) const
+    {
+        pos = clamp(pos, 0, cells.size() - 1);
+        return BitVec::GetBitOrZero(solid_bits, pos.y * cells.size().x + pos.x);
+    }
+    [[nodiscard]] bool SolidAtPixel(ivec2 pixel_pos) const
+    {
+        return SolidAt(div_ex(pixel_pos, tile_size));
+    }
+    // Returns true if any of the `points`, offset by `pixel_pos`, is in a solid tile.
+    // The point count is known at compile-time, so the loop can be unrolled.
+    template <std::size_t N>
+    [[nodiscard]] bool AnySolidAtPixels(ivec2 pixel_pos, const std::array<ivec2, N> &points) const
+    {
+        for (ivec2 point : points)
+        {
+            if (SolidAtPixel(pixel_pos + point))
+                return true;
+        }
+        return false;
+    }
+
+    struct SweepResult
+    {
+        bool hit = false;
+        float time = 1; // The fraction of `delta` that can be travelled before the contact, or 1 if there's no contact.
+        ivec2 normal; // The normal of the hit surface, pointing towards the box. Zero if there's no contact.
+    };
+    // Sweeps a box (in pixels, the max corner is exclusive) by `delta` pixels, and finds the first contact with a solid tile.
+    // The boxes that are merely touching a solid tile only collide if moving into it. Tiles that already overlap the box are ignored, so check for that separately.
+    // Only the tiles covered by the swept box are checked, so the cost doesn't depend on `delta` as long as it's small compared to the map.
+    [[nodiscard]] SweepResult SweepBox(fvec2 box_a, fvec2 box_b, fvec2 delta) const;
+
     [[nodiscard]] unsigned char rand_at(ivec2 pos) const
     {
         return random.unsafe_at(mod_ex(pos, random.size()));
@@ -116,7 +334,110 @@ struct Map
         return cells.size();
     }
 
-    Map(Stream::ReadOnlyData data);
+    // A compact binary form of the map, with only the data we need. Much faster to load than the Tiled JSON.
+    REFL_SIMPLE_STRUCT( Compiled
+        REFL_DECL(Array2D<std::uint8_t>) tiles
+        REFL_DECL(Tiled::PointLayer::map_t) points
+    )
+    // Extracts the data from a Tiled JSON map.
+    [[nodiscard]] static Compiled Compile(Stream::ReadOnlyData json_data);
+
+    Map(const Compiled &compiled);
+    // Loads a Tiled JSON map.
+    Map(Stream::ReadOnlyData json_data) : Map(Compile(std::move(json_data))) {}
+
+    // Loads the compiled map from `bin_file` if it's newer than `json_file`.
+    // Otherwise compiles `json_file`, and tries to save the result to `bin_file`. Either file can be missing, but not both.
+    [[nodiscard]] static Map Load(const std::string &json_file, const std::string &bin_file);
+
+    // The parameters of `Generate()`. The densities are the fractions of the random tiles, in `0..1`.
+    struct GenerationParams
+    {
+        ivec2 size = ivec2(64); // In tiles, including the solid border.
+        float wall_density = 0.15f;
+        float spike_density = 0.03f;
+        float breakable_density = 0.05f;
+        std::uint64_t seed = 0;
+    };
+    // Generates a random map, for the stress test. The player starts in the middle, in a clear area with a floor.
+    // The lava starts far below the map and the exit is far above it, so the level doesn't end on its own.
+    [[nodiscard]] static Compiled Generate(const GenerationParams &params);
+
+    // Computes the autotiling data from the neighbors. This is slow, use `GetAutotile()` instead.
+    [[nodiscard]] Autotile ComputeAutotile(ivec2 pos) const;
+    // Returns the precomputed autotiling data, or computes it if `pos` is outside of the map.
+    [[nodiscard]] Autotile GetAutotile(ivec2 pos) const
+    {
+        if (autotiles.pos_in_range(pos))
+            return autotiles.unsafe_at(pos);
+        return ComputeAutotile(pos);
+    }
+    // Recomputes the autotiling data for an inclusive range of tiles.
+    void UpdateAutotiles(ivec2 a, ivec2 b);
+
+    // Changes a tile, and marks the cached geometry around it for rebuilding.
+    // Use this instead of modifying `cells` directly.
+    void SetTile(ivec2 pos, Tile tile);
+    [[nodiscard]] static std::uint64_t OverlayHashTerm(ivec2 pos, Tile tile)
+    {
+        return StateHash{}(pos, tile).Value();
+    }
+    // Resets a tile to its state from `original_tiles`.
+    void RestoreTile(ivec2 pos)
+    {
+        SetTile(pos, original_tiles->at(pos));
+    }
+
+    // For `Refl::EstimateMemory()`. Including `render_cache`, and `original_tiles` and `secrets` even though the copies of the map share them.
+    [[nodiscard]] std::size_t EstimateOwnedMemory() const;
 
+    // The state that changes during the game: the tiles that differ from `original_tiles`, and the items that weren't picked up yet.
+    REFL_SIMPLE_STRUCT( Snapshot
+        REFL_DECL(std::vector<ivec2>) changed_tile_pos
+        REFL_DECL(std::vector<std::uint8_t>) changed_tiles
+        REFL_DECL(std::optional<ivec2>) ability_timeshift
+        REFL_DECL(std::optional<ivec2>) ability_doublejump
+        REFL_DECL(std::optional<ivec2>) ability_gun
+        REFL_DECL(std::vector<ivec2>) secrets // The positions of the secrets that weren't taken yet.
+    )
+    // Calls `func(chunk_pos, original)` for every chunk of `original_tiles` marked in `changed_chunk_bits`, with the original tiles of that chunk.
+    template <typename F>
+    void ForEachChangedChunk(F &&func) const
+    {
+        ivec2 num_chunks = original_tiles->NumChunks();
+        for (ivec2 chunk_pos : vector_range(num_chunks))
+        {
+            if (BitVec::GetBitOrThrow(changed_chunk_bits, chunk_pos.y * num_chunks.x + chunk_pos.x))
+                func(chunk_pos, *original_tiles->GetChunk(chunk_pos));
+        }
+    }
+
+    // Only looks at the chunks in `changed_chunk_bits`.
+    [[nodiscard]] Snapshot SaveSnapshot() const;
+    // Throws if the snapshot doesn't fit this map, without changing anything. Otherwise returns what `secret_taken` would be after loading it.
+    std::vector<bool> ValidateSnapshot(const Snapshot &snapshot) const;
+    // The snapshot must come from the same map. Throws if it doesn't fit, then the map is unchanged.
+    void LoadSnapshot(const Snapshot &snapshot);
+
+    // Renders a single layer for an inclusive range of tiles, with the tile `0,0` drawn at `-offset`.
+    // For the dual grid layer, the range is in the dual grid cells, which are shifted by a half tile.
+    void render_layer(int layer, ivec2 tile_a, ivec2 tile_b, ivec2 offset) const;
+
+    // The per-tile data for the GPU tilemap, see `launch_options.gpu_tilemap`:
+    // `x` is the dual grid mask, `y` has the spike-like direction in bits 0-1, bit 2 set if the tile is spike-like, and bits 3-4 set for `spike_same_{a,b}`,
+    // `z` is the spike-like texture index, and `w` is the simple texture index plus one, or zero if none.
+    [[nodiscard]] u8vec4 TilemapTexel(ivec2 pos) const;
+
+    // Draws the visible part of the map, either from the cached geometry, or with a single full-screen pass if `launch_options.gpu_tilemap` is set.
+    // Also pages `original_tiles` around the camera.
     void render(ivec2 camera_pos) const;
+    // Uploads the changed parts of `render_cache.tilemap`, and draws it with one full-screen quad. The cost doesn't depend on the number of visible tiles.
+    void render_tilemap(ivec2 camera_pos) const;
+
+    // Drops the cached geometry, e.g. after the texture atlas changes. It's rebuilt on demand.
+    void InvalidateRenderCache() const
+    {
+        render_cache.chunks = {};
+        render_cache.resident = {};
+    }
 };
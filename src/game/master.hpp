@@ -6,6 +6,7 @@
 #include <functional>
 #include <iostream>
 #include <map>
+#include <optional>
 #include <set>
 #include <type_traits>
 #include <utility>
@@ -13,8 +14,12 @@
 
 #include "audio/complete.h"
 #include "gameutils/adaptive_viewport.h"
+#include "gameutils/asset_loader.h"
 #include "gameutils/fps_counter.h"
+#include "gameutils/post_process.h"
+#include "gameutils/profiler.h"
 #include "gameutils/render.h"
+#include "gameutils/startup_trace.h"
 #include "gameutils/state.h"
 #include "gameutils/tiled_map.h"
 #include "graphics/complete.h"
@@ -31,14 +36,21 @@
 #include "program/errors.h"
 #include "program/exe_path.h"
 #include "program/exit.h"
+#include "program/alloc_stats.h"
 #include "program/main_loop.h"
 #include "program/platform.h"
 #include "reflection/full_with_poly.h"
+#include "reflection/memory_usage.h"
 #include "reflection/short_macros.h"
+#include "signals/event_queue.h"
+#include "stream/async_file_writer.h"
 #include "strings/common.h"
+#include "strings/escape.h"
 #include "strings/format.h"
 #include "strings/lexical_cast.h"
 #include "utils/clock.h"
+#include "utils/flat_hash.h"
+#include "utils/frame_arena.h"
 #include "utils/hash.h"
 #include "utils/mat.h"
 #include "utils/metronome.h"
@@ -46,3 +58,4 @@
 #include "utils/poly_storage.h"
 #include "utils/random.h"
 #include "utils/simple_iterator.h"
+#include "utils/small_vector.h"
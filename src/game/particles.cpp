@@ -1,67 +1,507 @@
 #include "particles.h"
 
-void ParticleController::Tick(ivec2 camera_pos)
+#include "utils/jobs.h"
+
+namespace
 {
-    for (Particle &par : particles)
+    // `ForEachRange()` gives each job at least this many particles, since the simple per-particle loops are cheaper than the jobs themselves.
+    constexpr std::size_t min_particles_per_job = 1024;
+
+    // Calls `func(begin, end)` for consecutive ranges covering `0..count`. Large counts are split across `Jobs::DefaultPool()`, the rest run on this thread.
+    // If `func` only touches the particles in its range, the result doesn't depend on the number of threads.
+    template <typename F>
+    void ForEachRange(std::size_t count, F &&func)
+    {
+        Jobs::Pool &pool = Jobs::DefaultPool();
+        std::size_t num_chunks = std::min(pool.ThreadCount() + 1, count / min_particles_per_job);
+        if (num_chunks <= 1)
+        {
+            func(std::size_t(0), count);
+            return;
+        }
+        pool.ParallelFor(num_chunks, [&](std::size_t chunk)
+        {
+            func(count * chunk / num_chunks, count * (chunk + 1) / num_chunks);
+        }, 1);
+    }
+
+    struct ParticleShader
     {
-        par.s.pos += par.s.vel;
-        par.s.vel += par.s.acc;
-        par.s.vel *= 1 - par.damp;
-        par.s.current_lifetime++;
+        // The matrices come from the uniform block of `Render`.
+        REFL_SIMPLE_STRUCT( Uniforms
+            REFL_DECL(Graphics::Uniform<fvec2> REFL_ATTR Graphics::Vert) camera_pos
+        )
 
-        if (saves_timelines)
-            states[par.state_id].push_back(par.s);
+        // The instance ID is the particle index. The quad corners come from the vertex ID, there are no vertex attributes.
+        // See `ParticleController::UploadToGpu()` for the data layout.
+        static constexpr const char *vertex_source = R"(
+uniform samplerBuffer u_static_data;
+uniform samplerBuffer u_dynamic_data;
+varying vec4 v_color;
+varying float v_beta;
+void main()
+{
+    vec4 dynamic_data = texelFetch(u_dynamic_data, gl_InstanceID);
+    vec4 color_a = texelFetch(u_static_data, gl_InstanceID * 4);
+    vec4 color_b = texelFetch(u_static_data, gl_InstanceID * 4 + 1);
+    vec4 beta_size = texelFetch(u_static_data, gl_InstanceID * 4 + 2);
+    float life = texelFetch(u_static_data, gl_InstanceID * 4 + 3).x;
+
+    float t = dynamic_data.z / life;
+    vec2 corner = vec2(gl_VertexID % 2, gl_VertexID / 2) - 0.5;
+    gl_Position = u_matrix * vec4(dynamic_data.xy - u_camera_pos + corner * mix(beta_size.z, beta_size.w, t), 0, 1);
+    v_color = mix(color_a, color_b, t);
+    v_beta = mix(beta_size.x, beta_size.y, t);
+})";
+
+        // Same as the untextured path of the main shader in `Render`.
+        static constexpr const char *fragment_source = R"(
+varying vec4 v_color;
+varying float v_beta;
+void main()
+{
+    gl_FragColor = v_color;
+    vec4 result = u_color_matrix * vec4(gl_FragColor.rgb, 1);
+    gl_FragColor.a *= result.a;
+    gl_FragColor.rgb = result.rgb * gl_FragColor.a;
+    gl_FragColor.a *= v_beta;
+})";
+
+        Uniforms uni;
+        Graphics::Shader shader;
+        Graphics::TexUnit static_unit = nullptr, dynamic_unit = nullptr;
+
+        ParticleShader()
+            : shader("Particles", shader_config, Graphics::ShaderPreferences{}, Meta::tag<Graphics::none_t>{}, uni,
+                Render::SharedUniformsDeclaration() + vertex_source, Render::SharedUniformsDeclaration() + fragment_source)
+        {
+            r.AttachSharedUniforms(shader);
+
+            // The samplers are not in `Uniforms`, since `Uniform<TexUnit>` is always a `sampler2D`.
+            shader.Bind();
+            glUniform1i(glGetUniformLocation(shader.Handle(), "u_static_data"), static_unit.Index());
+            glUniform1i(glGetUniformLocation(shader.Handle(), "u_dynamic_data"), dynamic_unit.Index());
+        }
+    };
+}
+
+void ParticleController::RemoveUnordered(std::size_t i)
+{
+    if (saves_timelines)
+        ids.EraseUnordered(id[i]);
+
+    auto SwapPop = [&](auto &vec)
+    {
+        if (i + 1 != vec.size())
+            vec[i] = std::move(vec.back());
+        vec.pop_back();
+    };
+
+    SwapPop(pos);
+    SwapPop(prev_pos);
+    SwapPop(vel);
+    SwapPop(acc);
+    SwapPop(damp);
+    SwapPop(current_lifetime);
+    SwapPop(life);
+    SwapPop(interpolated);
+    if (i < Count())
+        gpu.MarkDirty(i);
+    if (saves_timelines)
+    {
+        SwapPop(id);
+        SwapPop(first_frame);
+        if (i < id.size())
+            slot_of_id[id[i]] = int(i);
     }
+}
+
+void ParticleController::RemoveFarthest(std::size_t count, fvec2 camera_pos)
+{
+    clamp_var_max(count, Count());
+    if (count == 0)
+        return;
+
+    cull_order.resize(Count());
+    for (std::size_t i = 0; i < Count(); i++)
+        cull_order[i] = {(pos[i] - camera_pos).len_sqr(), i};
+    std::nth_element(cull_order.begin(), cull_order.begin() + count, cull_order.end(), [](const auto &a, const auto &b){return a.first > b.first;});
+    cull_order.resize(count);
+
+    // Remove in the descending order of indices, so the particles swapped into the removed slots are never the ones we still need to remove.
+    std::sort(cull_order.begin(), cull_order.end(), [](const auto &a, const auto &b){return a.second > b.second;});
+    for (const auto &[dist_sqr, i] : cull_order)
+        RemoveUnordered(i);
+}
+
+void ParticleController::UpdateQuality(double frame_secs, double budget_secs)
+{
+    constexpr float decrease_factor = 0.9f, increase_step = 0.005f; // The quality recovers from the minimum in 150 ticks.
+
+    if (frame_secs > budget_secs)
+        quality = std::max(quality * decrease_factor, min_quality);
+    else
+        quality = std::min(quality + increase_step, 1.f);
+}
+
+ParticleController::MemoryUsage ParticleController::GetMemoryUsage() const
+{
+    MemoryUsage ret;
+    ret.states = Refl::EstimateOwnedMemory(pos) + Refl::EstimateOwnedMemory(vel) + Refl::EstimateOwnedMemory(acc) + Refl::EstimateOwnedMemory(damp) +
+        Refl::EstimateOwnedMemory(current_lifetime) + Refl::EstimateOwnedMemory(life) + Refl::EstimateOwnedMemory(prev_pos) + Refl::EstimateOwnedMemory(interpolated) +
+        Refl::EstimateOwnedMemory(id) + Refl::EstimateOwnedMemory(first_frame) + Refl::EstimateOwnedMemory(ids) + Refl::EstimateOwnedMemory(slot_of_id);
+    ret.history = Refl::EstimateOwnedMemory(timeline);
+    ret.other = Refl::EstimateOwnedMemory(cull_mask) + Refl::EstimateOwnedMemory(cull_order) + Refl::EstimateOwnedMemory(gpu);
+    return ret;
+}
+
+bool ParticleController::TrimTimeline(std::size_t max_bytes)
+{
+    if (timeline.AllocatedBytes() <= max_bytes)
+        return true;
+
+    timeline.FreeSpareChunk();
+
+    // Dropping the frames one by one frees the chunks as soon as possible.
+    std::size_t first = timeline.FirstFrameIndex();
+    while (timeline.AllocatedBytes() > max_bytes && timeline.FrameCount() > 1)
+        timeline.DropFramesBefore(++first);
+
+    // Now the older particles behave as if they were spawned at the first remaining frame, so rewinding past it removes them.
+    for (std::size_t &frame : first_frame)
+        clamp_var_min(frame, first);
+
+    return timeline.AllocatedBytes() <= max_bytes;
+}
+
+void ParticleController::Add(const Particle &par)
+{
+    pos.push_back(par.s.pos);
+    prev_pos.push_back(par.s.pos);
+    vel.push_back(par.s.vel);
+    acc.push_back(par.s.acc);
+    damp.push_back(par.damp);
+    current_lifetime.push_back(par.s.current_lifetime);
+    life.push_back(par.life);
+
+    Interpolated &interp = interpolated.emplace_back();
+    interp.color_a = par.color;
+    interp.color_b = par.end_color.value_or(par.color);
+    interp.alpha_a = par.alpha;
+    interp.alpha_b = par.end_alpha.value_or(par.alpha);
+    interp.beta_a = par.beta;
+    interp.beta_b = par.end_beta.value_or(par.beta);
+    interp.size_a = par.size;
+    interp.size_b = par.end_size.value_or(par.size);
+    gpu.MarkDirty(Count() - 1);
+
+    if (saves_timelines)
+        AssignId(Count() - 1);
+}
+
+void ParticleController::Emit(Random::DefaultInterfaces<Random::DefaultGenerator> &ra, const ParticleEmitter &emitter, fvec2 center, int count, fvec2 base_vel)
+{
+    if (count <= 0)
+        return;
+    if (quality < 1)
+        count = std::max(iround(float(count) * quality), 1);
 
-    std::erase_if(particles, [&](const Particle &par)
+    std::size_t begin = Count(), end = begin + std::size_t(count);
+    pos.resize(end);
+    prev_pos.resize(end);
+    vel.resize(end);
+    acc.resize(end);
+    damp.resize(end);
+    current_lifetime.resize(end);
+    life.resize(end);
+    interpolated.resize(end);
+
+    bool has_offset = emitter.offset_min != emitter.offset_max;
+
+    for (std::size_t i = begin; i < end; i++)
     {
-        bool erase = false;
-        if (par.s.current_lifetime > par.life)
-            erase = true;
-        if ((abs(par.s.pos - camera_pos) > screen_size / 2 + 16).any())
-            erase = true;
+        fvec2 dir = fvec2::dir(emitter.angle_min <= ra.f <= emitter.angle_max);
+        float t = ra.f <= 1;
 
-        if (erase && saves_timelines)
-            state_ids.EraseUnordered(par.state_id);
-        return erase;
-    });
+        fvec2 p = center + dir * t * emitter.radius;
+        if (has_offset)
+            p += emitter.offset_min <= ra.fvec2 <= emitter.offset_max;
+        pos[i] = p;
+        prev_pos[i] = p;
+        vel[i] = base_vel + dir * mix(emitter.speed_power == 1 ? t : pow(t, emitter.speed_power), emitter.speed_min, emitter.speed_max);
+        acc[i] = emitter.acc;
+        damp[i] = emitter.damp;
+        current_lifetime[i] = 0;
+        life[i] = emitter.life_min <= ra.i <= emitter.life_max;
+
+        fvec3 color = mix(ra.f <= 1, emitter.color_a, emitter.color_b);
+        if (emitter.random_swap_red_blue && ra.boolean())
+            std::swap(color.x, color.z);
 
-    ASSERT(!saves_timelines || int(particles.size()) == state_ids.ElemCount());
+        Interpolated &interp = interpolated[i];
+        interp.color_a = interp.color_b = color;
+        interp.alpha_a = interp.alpha_b = 1;
+        interp.beta_a = interp.beta_b = emitter.beta;
+        interp.size_a = emitter.size_min <= ra.i <= emitter.size_max;
+        interp.size_b = emitter.end_size;
+    }
+
+    gpu.MarkDirty(begin);
+    gpu.MarkDirty(end - 1);
+
+    if (saves_timelines)
+    {
+        for (std::size_t i = begin; i < end; i++)
+            AssignId(i);
+    }
 }
 
-void ParticleController::ReverseTick()
+void ParticleController::AssignId(std::size_t slot)
 {
-    std::erase_if(particles, [&](const Particle &par)
+    if (ids.IsFull())
     {
-        bool erase = states[par.state_id].empty();
-        if (erase && saves_timelines)
-            state_ids.EraseUnordered(par.state_id);
-        return erase;
+        ids.Reserve((ids.Capacity() + 1) * 2);
+        slot_of_id.resize(ids.Capacity());
+    }
+
+    int new_id = ids.InsertAny();
+    id.push_back(new_id);
+    first_frame.push_back(timeline.EndFrameIndex());
+    slot_of_id[new_id] = int(slot);
+}
+
+void ParticleController::Clear()
+{
+    pos.clear();
+    vel.clear();
+    acc.clear();
+    damp.clear();
+    current_lifetime.clear();
+    life.clear();
+    prev_pos.clear();
+    interpolated.clear();
+
+    id.clear();
+    first_frame.clear();
+    ids.EraseAllElements();
+    timeline.Clear();
+    state_matches_last_frame = false;
+
+    gpu.dirty_begin = gpu.dirty_end = 0;
+}
+
+ParticleController::Snapshot ParticleController::SaveSnapshot() const
+{
+    return {.pos = pos, .vel = vel, .acc = acc, .damp = damp, .current_lifetime = current_lifetime, .life = life, .interpolated = interpolated};
+}
+
+void ParticleController::ValidateSnapshot(const Snapshot &snapshot)
+{
+    std::size_t count = snapshot.pos.size();
+    for (std::size_t size : {snapshot.vel.size(), snapshot.acc.size(), snapshot.damp.size(), snapshot.current_lifetime.size(), snapshot.life.size(), snapshot.interpolated.size()})
+    {
+        if (size != count)
+            Program::Error("The particle snapshot has mismatching array sizes.");
+    }
+}
+
+void ParticleController::LoadSnapshot(const Snapshot &snapshot)
+{
+    ValidateSnapshot(snapshot);
+    std::size_t count = snapshot.pos.size();
+
+    // This also drops the rewind history, which refers to the old particles.
+    *this = ParticleController(saves_timelines);
+
+    pos = snapshot.pos;
+    prev_pos = snapshot.pos;
+    vel = snapshot.vel;
+    acc = snapshot.acc;
+    damp = snapshot.damp;
+    current_lifetime = snapshot.current_lifetime;
+    life = snapshot.life;
+    interpolated = snapshot.interpolated;
+
+    for (std::size_t i = 0; i < count; i++)
+    {
+        gpu.MarkDirty(i);
+        if (saves_timelines)
+            AssignId(i);
+    }
+}
+
+void ParticleController::BeginTick()
+{
+    prev_pos = pos;
+}
+
+void ParticleController::Tick(ivec2 camera_pos)
+{
+    std::size_t count = Count();
+
+    // Those loops are kept separate and branchless to let them vectorize.
+    cull_mask.resize(count);
+    ForEachRange(count, [&](std::size_t begin, std::size_t end)
+    {
+        std::size_t n = end - begin;
+        integrate_damped(std::span(pos).subspan(begin, n), std::span(vel).subspan(begin, n), std::span(acc).subspan(begin, n), std::span(damp).subspan(begin, n));
+        for (std::size_t i = begin; i < end; i++)
+            current_lifetime[i]++;
+        mask_outside(std::span(pos).subspan(begin, n), fvec2(camera_pos), fvec2(screen_size / 2 + 16), std::span(cull_mask).subspan(begin, n));
+        for (std::size_t i = begin; i < end; i++)
+            cull_mask[i] |= current_lifetime[i] > life[i];
     });
 
-    for (Particle &par : particles)
+    // Iterate backwards, since removal swaps with the last element. The swapped element was already checked, so it doesn't matter that its mask stays behind.
+    for (std::size_t i = count; i-- > 0;)
     {
-        auto &state_vec = states[par.state_id];
-        if (state_vec.empty())
-            continue; // This shouldn't happen.
-        par.s = state_vec.back();
-        state_vec.pop_back();
+        if (cull_mask[i])
+            RemoveUnordered(i);
     }
 
-    ASSERT(!saves_timelines || int(particles.size()) == state_ids.ElemCount());
+    // Over the limit, drop the far ones first, they are the least noticeable.
+    if (Count() > CountLimit())
+        RemoveFarthest(Count() - CountLimit(), fvec2(camera_pos));
+
+    if (saves_timelines)
+    {
+        ASSERT(int(Count()) == ids.ElemCount());
+
+        // Only the surviving particles are recorded. The culled ones can't be rewound into existence anyway.
+        constexpr float vel_scale = 1 << Record::vel_frac_bits;
+        timeline.BeginFrame();
+        std::size_t first_record = timeline.AddRecords(Count());
+        ForEachRange(Count(), [&](std::size_t begin, std::size_t end)
+        {
+            for (std::size_t i = begin; i < end; i++)
+            {
+                timeline.RecordAt(first_record + i) = {
+                    .id = id[i],
+                    .pos = pos[i],
+                    .vel = iround<std::int16_t>(clamp(vel[i] * vel_scale, -0x7fff, 0x7fff)),
+                };
+            }
+        });
+        std::size_t min_first_frame = timeline.EndFrameIndex();
+        for (std::size_t frame : first_frame)
+            clamp_var_max(min_first_frame, frame);
+        state_matches_last_frame = true;
+
+        // Nobody can rewind past their spawn tick, so the older frames are useless.
+        timeline.DropFramesBefore(min_first_frame);
+    }
 }
 
-void ParticleController::Render(ivec2 camera_pos) const
+void ParticleController::ReverseTick(int steps)
 {
-    for (const Particle &par : particles)
+    if (!saves_timelines || steps <= 0)
+        return;
+
+    if (timeline.FrameCount() < std::size_t(steps))
     {
-        float t = par.s.current_lifetime / float(par.life);
+        // Rewinding past the first frame, nothing can survive.
+        while (Count() > 0)
+            RemoveUnordered(Count() - 1);
+        timeline.PopFrames(timeline.FrameCount());
+        state_matches_last_frame = false;
+        return;
+    }
 
-        float size = !par.end_size ? par.size : mix(t, par.size, *par.end_size);
-        fvec3 color = !par.end_color ? par.color : mix(t, par.color, *par.end_color);
-        float alpha = !par.end_alpha ? par.alpha : mix(t, par.alpha, *par.end_alpha);
-        float beta = !par.end_beta ? par.beta : mix(t, par.beta, *par.end_beta);
+    // The particles spawned after the target frame was recorded have no history there, so they are removed.
+    std::size_t target_frame = timeline.EndFrameIndex() - std::size_t(steps);
+    for (std::size_t i = Count(); i-- > 0;)
+    {
+        if (first_frame[i] > target_frame)
+            RemoveUnordered(i);
+    }
 
-        r.fquad(par.s.pos - camera_pos, fvec2(size)).color(color).alpha(alpha).beta(beta).center();
+    // Lifetimes aren't stored, but every frame is exactly one tick apart.
+    int lifetime_delta = steps - state_matches_last_frame;
+    if (lifetime_delta > 0)
+    {
+        for (int &lifetime : current_lifetime)
+            lifetime -= lifetime_delta;
     }
+
+    // Every remaining particle was alive in all frames since its spawn, so only the target frame needs to be applied.
+    constexpr float inv_vel_scale = 1.f / (1 << Record::vel_frac_bits);
+    timeline.ForEachInFrame(target_frame, [&](const Record &record)
+    {
+        // The IDs are reused, so skip records belonging to dead particles, and to their successors that were spawned later.
+        if (!ids.Contains(record.id))
+            return;
+        std::size_t i = std::size_t(slot_of_id[record.id]);
+        if (first_frame[i] > target_frame)
+            return;
+
+        pos[i] = record.pos;
+        vel[i] = fvec2(record.vel) * inv_vel_scale;
+    });
+
+    timeline.PopFrames(std::size_t(steps));
+    state_matches_last_frame = false;
+
+    ASSERT(int(Count()) == ids.ElemCount());
+}
+
+void ParticleController::UploadToGpu() const
+{
+    constexpr int n = GpuData::static_texels_per_particle;
+
+    if (!gpu.static_data || gpu.static_data.Size() < int(Count() * n))
+    {
+        // Reallocate with some extra space, and reupload everything.
+        gpu.static_data = Graphics::BufferTexture<fvec4>(std::max(int(Count() * n * 2), 1024 * n));
+        gpu.dirty_begin = 0;
+        gpu.dirty_end = Count();
+    }
+
+    clamp_var_max(gpu.dirty_end, Count());
+    if (gpu.dirty_begin < gpu.dirty_end)
+    {
+        std::vector<fvec4> texels;
+        texels.reserve((gpu.dirty_end - gpu.dirty_begin) * n);
+        for (std::size_t i = gpu.dirty_begin; i < gpu.dirty_end; i++)
+        {
+            const Interpolated &interp = interpolated[i];
+            texels.push_back(interp.color_a.to_vec4(interp.alpha_a));
+            texels.push_back(interp.color_b.to_vec4(interp.alpha_b));
+            texels.push_back(fvec4(interp.beta_a, interp.beta_b, interp.size_a, interp.size_b));
+            texels.push_back(fvec4(life[i], 0, 0, 0));
+        }
+        gpu.static_data.SetDataPart(gpu.dirty_begin * n, texels.size(), texels.data());
+    }
+    gpu.dirty_begin = gpu.dirty_end = 0;
+
+    gpu.render_pos.resize(Count());
+    mix_arrays(render_tick_fraction, prev_pos, pos, gpu.render_pos);
+    std::vector<fvec4> texels(Count());
+    for (std::size_t i = 0; i < Count(); i++)
+        texels[i] = gpu.render_pos[i].to_vec4(current_lifetime[i], 0);
+    if (!gpu.dynamic_data)
+        gpu.dynamic_data = nullptr;
+    gpu.dynamic_data.SetData(texels.size(), texels.data(), Graphics::stream_draw); // This orphans the old storage.
+}
+
+void ParticleController::Render(ivec2 camera_pos) const
+{
+    if (Count() == 0)
+        return;
+
+    static ParticleShader shader;
+
+    UploadToGpu();
+
+    r.Finish();
+
+    shader.shader.Bind();
+    r.BindSharedUniforms();
+    shader.uni.camera_pos = camera_pos;
+    gpu.static_data.Bind(shader.static_unit.Index());
+    gpu.dynamic_data.Bind(shader.dynamic_unit.Index());
+
+    Graphics::VertexBuffers::BindDraw(0, nullptr); // We don't use any attributes.
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, Count());
+
+    r.BindShader();
 }
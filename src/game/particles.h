@@ -2,6 +2,7 @@
 
 #include "game/main.h"
 
+// This is only used to describe new particles. The controller doesn't store those directly.
 struct Particle
 {
     struct State
@@ -23,44 +24,417 @@ struct Particle
     std::optional<float> end_size;
 
     int life = 60;
-
-    int state_id = 0;
 };
 
+// Describes a burst of random particles, for `ParticleController::Emit()`.
+// Each particle picks a direction `dir` in the angle range, and a distance `t` in `0..1`.
+// The position is the emitter position, plus a random point in the offset box, plus `dir * t * radius`.
+// The velocity is the base velocity, plus `dir * mix(pow(t, speed_power), speed_min, speed_max)`.
+REFL_SIMPLE_STRUCT( ParticleEmitter
+    REFL_DECL(fvec2 REFL_INIT{}) offset_min
+    REFL_DECL(fvec2 REFL_INIT{}) offset_max
+    REFL_DECL(fvec2 REFL_INIT{}) radius
+    REFL_DECL(float REFL_INIT = -f_pi) angle_min
+    REFL_DECL(float REFL_INIT = f_pi) angle_max
+    REFL_DECL(float REFL_INIT = 0) speed_min
+    REFL_DECL(float REFL_INIT = 0) speed_max
+    REFL_DECL(float REFL_INIT = 1) speed_power
+    REFL_DECL(fvec2 REFL_INIT{}) acc
+    REFL_DECL(float REFL_INIT = 0) damp
+    REFL_DECL(int REFL_INIT = 60) life_min
+    REFL_DECL(int REFL_INIT = 60) life_max
+    REFL_DECL(int REFL_INIT = 4) size_min // The sizes are whole numbers of pixels.
+    REFL_DECL(int REFL_INIT = 4) size_max
+    REFL_DECL(float REFL_INIT = 1) end_size
+    // The color is a random mix of those two.
+    REFL_DECL(fvec3 REFL_INIT = fvec3(1)) color_a
+    REFL_DECL(fvec3 REFL_INIT = fvec3(1)) color_b
+    REFL_DECL(bool REFL_INIT = false) random_swap_red_blue // If true, swaps the red and blue channels for half of the particles.
+    REFL_DECL(float REFL_INIT = 1) beta
+)
+
 class ParticleController
 {
-    std::deque<Particle> particles;
+    // The particles are stored as a structure of arrays. All those vectors have the same size.
+    // Removal is done by swapping with the last element, so the order is not preserved.
 
-    std::vector<std::vector<Particle::State>> states;
-    SparseSet<int> state_ids;
+    // Motion.
+    std::vector<fvec2> pos, vel, acc;
+    std::vector<float> damp;
+    std::vector<int> current_lifetime, life;
+    // The positions at the beginning of the last world tick, see `BeginTick()`. Only used to interpolate the rendering.
+    std::vector<fvec2> prev_pos;
 
-    bool saves_timelines = false;
+    // Scratch space for `Tick()`, not a part of the state.
+    std::vector<std::uint8_t> cull_mask;
+    std::vector<std::pair<float, std::size_t>> cull_order; // Distance squared and index, for `RemoveFarthest()`.
 
-public:
-    ParticleController(bool saves_timelines) : saves_timelines(saves_timelines) {}
+    // Scales the spawn counts in `Emit()` and the particle limit, in `min_quality..1`. See `UpdateQuality()`. Not a part of the state.
+    float quality = 1;
+    std::size_t max_count = default_max_count; // Not a part of the state either. See `CountLimit()`.
+
+    // Attributes interpolated over the lifetime. If no end value was specified, it's equal to the start value.
+    REFL_SIMPLE_STRUCT( Interpolated
+        REFL_DECL(fvec3 REFL_INIT{}) color_a
+        REFL_DECL(fvec3 REFL_INIT{}) color_b
+        REFL_DECL(float REFL_INIT = 1) alpha_a
+        REFL_DECL(float REFL_INIT = 1) alpha_b
+        REFL_DECL(float REFL_INIT = 1) beta_a
+        REFL_DECL(float REFL_INIT = 1) beta_b
+        REFL_DECL(float REFL_INIT = 4) size_a
+        REFL_DECL(float REFL_INIT = 4) size_b
+    )
+    std::vector<Interpolated> interpolated;
+
+    // The rest is only used if `saves_timelines` is true.
+
+    // Persistent particle IDs, used to match timeline records to particles.
+    std::vector<int> id;
+    // The absolute index of the first timeline frame that has this particle.
+    std::vector<std::size_t> first_frame;
+
+    SparseSet<int> ids;
+    std::vector<int> slot_of_id; // Maps IDs back to indices in the arrays above.
+
+    // One particle at one tick.
+    struct Record
+    {
+        // Velocity is stored in fixed point with this many fractional bits.
+        static constexpr int vel_frac_bits = 10;
+
+        int id = 0;
+        fvec2 pos;
+        i16vec2 vel;
+    };
+
+    // A single arena of past particle states, shared by all particles.
+    // Each frame (tick) is a contiguous run of records, one per particle that survived that tick.
+    // Records are allocated in fixed-size chunks. Frames can span several chunks.
+    // Frames are dropped from the front as soon as no existing particle can be rewound into them.
+    class Timeline
+    {
+        static constexpr std::size_t chunk_size = 4096; // In records.
+
+        // Each chunk has exactly `chunk_size` elements. Those are vectors rather than raw arrays to keep the controller copyable.
+        std::deque<std::vector<Record>> chunks;
+        std::vector<Record> spare_chunk; // The last freed chunk, kept to avoid allocations when going back and forth.
+
+        std::size_t first_record = 0; // The absolute index of `chunks[0][0]`.
+        std::size_t end_record = 0; // The absolute index past the last record.
+
+        std::deque<std::size_t> frame_starts; // The absolute index of the first record of each frame.
+        std::size_t first_frame_index = 0; // The absolute index of the frame `frame_starts[0]`.
+
+        void FreeChunk(std::vector<Record> &&chunk)
+        {
+            spare_chunk = std::move(chunk);
+        }
+
+      public:
+        // The absolute index of the next frame that will be added.
+        [[nodiscard]] std::size_t EndFrameIndex() const
+        {
+            return first_frame_index + frame_starts.size();
+        }
+
+        [[nodiscard]] bool HasFrames() const
+        {
+            return !frame_starts.empty();
+        }
+
+        [[nodiscard]] std::size_t FrameCount() const
+        {
+            return frame_starts.size();
+        }
+
+        // The absolute index of the oldest stored frame.
+        [[nodiscard]] std::size_t FirstFrameIndex() const
+        {
+            return first_frame_index;
+        }
+
+        // The number of allocated bytes, for debugging.
+        [[nodiscard]] std::size_t AllocatedBytes() const
+        {
+            return (chunks.size() + !spare_chunk.empty()) * chunk_size * sizeof(Record);
+        }
+
+        // Unlike `AllocatedBytes()`, this includes the frame starts and the chunk bookkeeping.
+        [[nodiscard]] std::size_t EstimateOwnedMemory() const
+        {
+            return Refl::EstimateOwnedMemory(chunks) + Refl::EstimateOwnedMemory(spare_chunk) + Refl::EstimateOwnedMemory(frame_starts);
+        }
+
+        void BeginFrame()
+        {
+            frame_starts.push_back(end_record);
+        }
+
+        // Adds `count` records to the last frame, and returns the absolute index of the first one. Fill them using `RecordAt()`.
+        // The chunks are allocated here, so the records can then be filled from several threads.
+        std::size_t AddRecords(std::size_t count)
+        {
+            std::size_t ret = end_record;
+            end_record += count;
+            std::size_t needed_chunks = (end_record - first_record + chunk_size - 1) / chunk_size;
+            while (chunks.size() < needed_chunks)
+            {
+                if (spare_chunk.empty())
+                    spare_chunk.resize(chunk_size);
+                chunks.push_back(std::move(spare_chunk));
+                spare_chunk = {};
+            }
+            return ret;
+        }
+
+        // Returns a record by its absolute index, which must exist.
+        [[nodiscard]] Record &RecordAt(std::size_t index)
+        {
+            std::size_t offset = index - first_record;
+            return chunks[offset / chunk_size][offset % chunk_size];
+        }
+
+        void AddRecord(const Record &record)
+        {
+            RecordAt(AddRecords(1)) = record;
+        }
+
+        // Calls `func(const Record &)` for each record in the frame with the absolute index `frame_index`, which must exist.
+        template <typename F>
+        void ForEachInFrame(std::size_t frame_index, F &&func) const
+        {
+            std::size_t rel_frame = frame_index - first_frame_index;
+            std::size_t frame_end = rel_frame + 1 < frame_starts.size() ? frame_starts[rel_frame + 1] : end_record;
+            for (std::size_t i = frame_starts[rel_frame]; i < frame_end; i++)
+            {
+                std::size_t offset = i - first_record;
+                func(std::as_const(chunks[offset / chunk_size][offset % chunk_size]));
+            }
+        }
+
+        // Removes the last `count` frames, at most `FrameCount()`.
+        void PopFrames(std::size_t count)
+        {
+            if (count == 0)
+                return;
+
+            end_record = frame_starts[frame_starts.size() - count];
+            frame_starts.erase(frame_starts.end() - count, frame_starts.end());
+
+            std::size_t needed_chunks = (end_record - first_record + chunk_size - 1) / chunk_size;
+            while (chunks.size() > needed_chunks)
+            {
+                FreeChunk(std::move(chunks.back()));
+                chunks.pop_back();
+            }
+        }
+
+        // Frees the spare chunk.
+        void FreeSpareChunk()
+        {
+            std::vector<Record>().swap(spare_chunk);
+        }
+
+        // Removes all frames, keeping one chunk as spare.
+        void Clear()
+        {
+            if (!chunks.empty())
+                FreeChunk(std::move(chunks.back()));
+            chunks.clear();
+            first_record = 0;
+            end_record = 0;
+            frame_starts.clear();
+            first_frame_index = 0;
+        }
+
+        // Removes all frames with absolute indices less than `frame_index`.
+        void DropFramesBefore(std::size_t frame_index)
+        {
+            while (!frame_starts.empty() && first_frame_index < frame_index)
+            {
+                frame_starts.pop_front();
+                first_frame_index++;
+            }
 
-    void Add(const Particle &par)
+            std::size_t new_first_record = frame_starts.empty() ? end_record : frame_starts.front();
+            while (new_first_record - first_record >= chunk_size)
+            {
+                FreeChunk(std::move(chunks.front()));
+                chunks.pop_front();
+                first_record += chunk_size;
+            }
+
+            if (frame_starts.empty())
+                first_frame_index = frame_index;
+        }
+    };
+    Timeline timeline;
+
+    // True if the particle states are exactly the ones stored in the last timeline frame (not counting the particles added after it).
+    // Lifetimes are not stored in the timeline, and this is used to restore them.
+    bool state_matches_last_frame = false;
+
+    bool saves_timelines = false;
+
+    // The particles are rendered with instancing. The vertex shader does the interpolation.
+    // The per-particle constants are uploaded only when a slot changes, the positions and lifetimes are uploaded every frame.
+    // This isn't copied with the controller, the copy uploads everything again.
+    struct GpuData
     {
-        if (saves_timelines && state_ids.IsFull())
+        static constexpr int static_texels_per_particle = 4;
+
+        Graphics::BufferTexture<fvec4> static_data; // Colors, alpha, beta, size, and life.
+        Graphics::BufferTexture<fvec4> dynamic_data; // Interpolated position and current lifetime.
+
+        // The range of slots that need to be reuploaded to `static_data`.
+        std::size_t dirty_begin = 0, dirty_end = 0;
+
+        std::vector<fvec2> render_pos; // Scratch space for the interpolated positions.
+
+        GpuData() {}
+        GpuData(const GpuData &) {}
+        GpuData &operator=(const GpuData &)
+        {
+            *this = GpuData{};
+            return *this;
+        }
+        GpuData(GpuData &&) = default;
+        GpuData &operator=(GpuData &&) = default;
+
+        [[nodiscard]] std::size_t EstimateOwnedMemory() const
         {
-            state_ids.Reserve((state_ids.Capacity() + 1) * 2);
-            while (int(states.size()) < state_ids.Capacity())
+            return Refl::EstimateOwnedMemory(static_data) + Refl::EstimateOwnedMemory(dynamic_data) + Refl::EstimateOwnedMemory(render_pos);
+        }
+
+        void MarkDirty(std::size_t slot)
+        {
+            if (dirty_begin == dirty_end)
             {
-                states.emplace_back();
-                states.back().reserve(1024);
+                dirty_begin = slot;
+                dirty_end = slot + 1;
+                return;
             }
+            clamp_var_max(dirty_begin, slot);
+            clamp_var_min(dirty_end, slot + 1);
         }
+    };
+    mutable GpuData gpu;
+
+    // Assigns a persistent ID to the particle in `slot`, which must be the last one to get an ID. Only if `saves_timelines` is true.
+    void AssignId(std::size_t slot);
+
+    // Removes a particle by swapping it with the last one.
+    void RemoveUnordered(std::size_t i);
+
+    // Removes `count` particles farthest from `camera_pos`, at most `Count()`.
+    void RemoveFarthest(std::size_t count, fvec2 camera_pos);
+
+    // Updates `gpu` to match the particles.
+    void UploadToGpu() const;
 
-        Particle &new_par = particles.emplace_back(par);
-        if (saves_timelines)
+  public:
+    // The default max number of particles at full quality, see `SetMaxCount()`. Above the current limit, `Tick()` removes the particles farthest from the camera.
+    static constexpr std::size_t default_max_count = 4096;
+    static constexpr float min_quality = 0.25f;
+
+    ParticleController(bool saves_timelines) : saves_timelines(saves_timelines) {}
+
+    // The current particles, in the same structure-of-arrays form.
+    REFL_SIMPLE_STRUCT( Snapshot
+        REFL_DECL(std::vector<fvec2>) pos
+        REFL_DECL(std::vector<fvec2>) vel
+        REFL_DECL(std::vector<fvec2>) acc
+        REFL_DECL(std::vector<float>) damp
+        REFL_DECL(std::vector<int>) current_lifetime
+        REFL_DECL(std::vector<int>) life
+        REFL_DECL(std::vector<Interpolated>) interpolated
+    )
+    // The rewind history is not saved, so the loaded particles can't be rewound past the moment of saving.
+    [[nodiscard]] Snapshot SaveSnapshot() const;
+    // Throws if `LoadSnapshot()` would throw.
+    static void ValidateSnapshot(const Snapshot &snapshot);
+    // Replaces all particles. Throws if the array sizes don't match, then the particles are unchanged.
+    void LoadSnapshot(const Snapshot &snapshot);
+
+    // The number of existing particles.
+    [[nodiscard]] std::size_t Count() const
+    {
+        return pos.size();
+    }
+
+    [[nodiscard]] float Quality() const
+    {
+        return quality;
+    }
+
+    // The current max number of particles, depends on the quality.
+    [[nodiscard]] std::size_t CountLimit() const
+    {
+        return std::size_t(float(max_count) * quality);
+    }
+
+    // Changes the max number of particles at full quality. Only the stress test raises it.
+    void SetMaxCount(std::size_t count)
+    {
+        max_count = count;
+    }
+
+    // Adjusts the quality from the time it took to tick and render the last frame. Call this once per tick.
+    // Lowers the quality quickly while it's above `budget_secs`, then slowly raises it back.
+    void UpdateQuality(double frame_secs, double budget_secs);
+
+    // Goes back to the full quality.
+    void ResetQuality()
+    {
+        quality = 1;
+    }
+
+    // The amount of memory used by the rewind history, in bytes.
+    [[nodiscard]] std::size_t TimelineBytes() const
+    {
+        return timeline.AllocatedBytes();
+    }
+
+    // The memory used by the parts of the controller, including the unused capacity. See `World::MemoryReport()`.
+    struct MemoryUsage
+    {
+        std::size_t states = 0; // The particles themselves, and their IDs.
+        std::size_t history = 0; // The rewind timeline.
+        std::size_t other = 0; // The scratch space for `Tick()`, and the GPU buffers.
+
+        [[nodiscard]] std::size_t Total() const
         {
-            new_par.state_id = state_ids.InsertAny();
-            states[new_par.state_id].clear(); // This shouldn't reset capacity, this is intentional.
+            return states + history + other;
         }
+    };
+    [[nodiscard]] MemoryUsage GetMemoryUsage() const;
+
+    // For `Refl::EstimateMemory()`.
+    [[nodiscard]] std::size_t EstimateOwnedMemory() const
+    {
+        return GetMemoryUsage().Total();
     }
 
+    // Drops the oldest history frames until it uses at most `max_bytes` (but keeps the last frame). Returns false if it still doesn't fit.
+    // The particles can't be rewound past the dropped frames anymore, they disappear instead.
+    bool TrimTimeline(std::size_t max_bytes);
+
+    void Add(const Particle &par);
+    // Adds `count` particles described by `emitter`. Unlike calling `Add()` in a loop, resizes the arrays once and fills them directly.
+    // Below the full quality, the count is reduced proportionally, but at least one particle is added.
+    void Emit(Random::DefaultInterfaces<Random::DefaultGenerator> &ra, const ParticleEmitter &emitter, fvec2 pos, int count, fvec2 base_vel = fvec2());
+
+    // Removes all particles and the rewind history. Unlike `LoadSnapshot()`, this keeps the allocated memory and the GPU buffers.
+    void Clear();
+
+    // Remembers the current positions to interpolate the rendering from them. Call this at the beginning of each world tick,
+    // even if `Tick()` or `ReverseTick()` aren't called on it, otherwise the particles that don't move would be interpolated from old positions.
+    void BeginTick();
+
     void Tick(ivec2 camera_pos);
-    void ReverseTick();
+    // Rewinds `steps` ticks at once. This costs about the same as rewinding a single tick.
+    void ReverseTick(int steps = 1);
 
+    // The positions are interpolated between `BeginTick()` and now, using `render_tick_fraction`.
     void Render(ivec2 camera_pos) const;
 };
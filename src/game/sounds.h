@@ -2,35 +2,51 @@
 
 #include "game/main.h"
 
+// Name, random pitch, priority. When too many sounds play at once, the ones with a lower priority are cut off first.
 #define SOUND_LIST(X) \
-    X( jump              , 0.1 ) \
-    X( landing           , 0.3 ) \
-    X( death             , 0.2 ) \
-    X( time_stop         , 0.2 ) \
-    X( time_start        , 0.2 ) \
-    X( breaking_prison   , 0.3 ) \
-    X( broke_prison      , 0.2 ) \
-    X( got_item          , 0   ) \
-    X( pew               , 0.3 ) \
-    X( shot_breaks_block , 0.2 ) \
-    X( shot_dies         , 0.2 ) \
-    X( push              , 0.2 ) \
+    X( jump              , 0.1 , 1 ) \
+    X( landing           , 0.3 , 0 ) \
+    X( death             , 0.2 , 3 ) \
+    X( time_stop         , 0.2 , 2 ) \
+    X( time_start        , 0.2 , 2 ) \
+    X( breaking_prison   , 0.3 , 1 ) \
+    X( broke_prison      , 0.2 , 2 ) \
+    X( got_item          , 0   , 2 ) \
+    X( pew               , 0.3 , 1 ) \
+    X( shot_breaks_block , 0.2 , 0 ) \
+    X( shot_dies         , 0.2 , 0 ) \
+    X( push              , 0.2 , 0 ) \
 
 
 namespace Sounds
 {
-    #define MAKE_SOUND(name, randpitch) \
-        inline std::shared_ptr<Audio::Source> name(std::optional<ivec2> pos, float volume = 1, float pitch = 0) \
+    using Sink = std::function<void(std::string_view name, std::optional<ivec2> pos, float volume, float pitch)>;
+
+    // If set, the sounds are passed here instead of being played, and the functions below return null. Used by the headless simulation.
+    // Thread-local, so that the headless worlds on different threads can each have their own (see `SimulationContext`).
+    // The functions also return null if the sound was dropped because too many more important ones are playing.
+    // The sounds without a position don't need 3D audio, so they're played by `audio_mixer` instead of using up OpenAL sources, and the functions return null for them too.
+    inline thread_local Sink sink;
+
+    #define MAKE_SOUND(name, randpitch, priority) \
+        inline Audio::Source *name(std::optional<ivec2> pos, float volume = 1, float pitch = 0) \
         { \
-            auto ret = audio_controller.Add(Audio::File<#name>()); \
-            if (pos) \
-                ret->pos(*pos); \
-            else \
-                ret->relative(); \
-            ret->volume(volume).pitch(pow(2, pitch - (ra.f.abs() <= randpitch))).play(); \
+            if (sink) \
+            { \
+                sink(#name, pos, volume, pitch); \
+                return nullptr; \
+            } \
+            if (!pos) \
+            { \
+                audio_mixer.Play(Audio::FileSound<#name>(), priority, volume, pow(2, pitch - (ra.f.abs() <= randpitch))); \
+                return nullptr; \
+            } \
+            Audio::Source *ret = audio_controller.Allocate(Audio::File<#name>(), priority, fvec2(*pos).to_vec3()); \
+            if (ret) \
+                ret->volume(volume).pitch(pow(2, pitch - (ra.f.abs() <= randpitch))).play(); \
             return ret; \
         } \
-        inline std::shared_ptr<Audio::Source> name(float volume = 1, float pitch = 0) \
+        inline Audio::Source *name(float volume = 1, float pitch = 0) \
         { \
             return name({}, volume, pitch); \
         }
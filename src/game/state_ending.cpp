@@ -65,6 +65,13 @@ namespace States
             timer++;
         }
 
+        std::string UpcomingState() const override
+        {
+            if (queued_state && *queued_state != "0")
+                return *queued_state;
+            return {};
+        }
+
         void Render() const override
         {
             Graphics::SetClearColor(fvec3(0));
@@ -79,17 +86,23 @@ namespace States
             r.iquad(ivec2(), screen_size).center().color(bg_color);
 
             std::string_view main_text = "Thanks for playing!";
-            r.itext(ivec2(-Graphics::Text(Fonts::main, main_text).ComputeStats().size.x / 2, -32), Graphics::Text(Fonts::main, main_text.substr(0, clamp_min((timer - 60) / 10)))).color(text_color).align_x(-1);
+            r.itext(ivec2(-Graphics::Text(Fonts::main, main_text, &frame_arena).ComputeStats().size.x / 2, -32), Graphics::Text(Fonts::main, main_text.substr(0, clamp_min((timer - 60) / 10)), &frame_arena)).color(text_color).align_x(-1);
 
-            std::string secrets_text =
-                cur_secrets == 0 ? FMT("You didn't find any secrets though...") :
-                cur_secrets < max_secrets ? FMT("You found {}/{} secrets, keep looking...", cur_secrets, max_secrets) : "You found all the secrets. Great job!";
+            std::pmr::string secrets_text(&frame_arena);
+            if (cur_secrets == 0)
+                secrets_text = "You didn't find any secrets though...";
+            else if (cur_secrets < max_secrets)
+                FMT_TO(secrets_text, "You found {}/{} secrets, keep looking...", cur_secrets, max_secrets);
+            else
+                secrets_text = "You found all the secrets. Great job!";
 
-            r.itext(ivec2(0, 8), Graphics::Text(Fonts::main, secrets_text)).color(alt_text_color).alpha(smoothstep(clamp((timer - 300) / 60.f)));
+            r.itext(ivec2(0, 8), Graphics::Text(Fonts::main, secrets_text, &frame_arena)).color(alt_text_color).alpha(smoothstep(clamp((timer - 300) / 60.f)));
 
-            r.itext(ivec2(0, -screen_size.y/2 + 8), Graphics::Text(Fonts::main, FMT("Real time: {}      Game world time: {}", TicksToTime(time), TicksToTime(time_sub)))).color(alt_text_color).alpha(smoothstep(clamp((timer - 360) / 60.f)));
+            std::pmr::string time_text(&frame_arena);
+            FMT_TO(time_text, "Real time: {}      Game world time: {}", TicksToTime(time), TicksToTime(time_sub));
+            r.itext(ivec2(0, -screen_size.y/2 + 8), Graphics::Text(Fonts::main, time_text, &frame_arena)).color(alt_text_color).alpha(smoothstep(clamp((timer - 360) / 60.f)));
 
-            r.itext(ivec2(0, screen_size.y/2 - 18), Graphics::Text(Fonts::main, FoundAllSecrets() ? "Press any key to quit!" : "Press any key to restart!")).color(alt_text_color).alpha(smoothstep(clamp((timer - 420) / 60.f)));
+            r.itext(ivec2(0, screen_size.y/2 - 18), Graphics::Text(Fonts::main, FoundAllSecrets() ? "Press any key to quit!" : "Press any key to restart!", &frame_arena)).color(alt_text_color).alpha(smoothstep(clamp((timer - 420) / 60.f)));
 
             { // Exit fade.
                 if (exit_fade > 0)
@@ -97,7 +110,7 @@ namespace States
             }
 
             { // Vignette.
-                static const auto &region = texture_atlas.Get("vignette.png");
+                const auto &region = texture_atlas.Get<"vignette.png">();
                     r.iquad(ivec2(), region).alpha(vignette_alpha).center();
             }
 
@@ -0,0 +1,33 @@
+#include "main.h"
+
+namespace States
+{
+    // Shown while `asset_loader` runs, then switches to the world (or the stress test).
+    // Only draws untextured quads, since the texture isn't uploaded yet.
+    STRUCT( Loading EXTENDS StateBase )
+    {
+        MEMBERS()
+
+        void Tick(std::string &next_state) override
+        {
+            window.FinishSwapBuffers(); // The asset loader uploads the texture from this thread.
+            asset_loader.Tick();
+            if (asset_loader.Done())
+                next_state = launch_options.stress_test ? "StressTest" + *launch_options.stress_test : "World{}";
+        }
+
+        void Render() const override
+        {
+            Graphics::SetClearColor(fvec3(0));
+            Graphics::Clear();
+
+            r.BindShader();
+
+            constexpr ivec2 bar_size(160, 4);
+            r.iquad(-bar_size / 2, bar_size).color(fvec3(0.15f));
+            r.iquad(-bar_size / 2, ivec2(iround(bar_size.x * asset_loader.Progress()), bar_size.y)).color(fvec3(1, 0.5f, 0.1f));
+
+            r.Finish();
+        }
+    };
+}
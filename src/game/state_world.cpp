@@ -1,20 +1,54 @@
 #include "main.h"
 
+#include <span>
+#include <sstream>
+
 #include "game/buildnumber.h"
 #include "game/map.h"
 #include "game/particles.h"
 #include "game/sounds.h"
+#include "stream/compression.h"
+#include "stream/readonly_data.h"
+#include "stream/save_to_file.h"
+#include "utils/jobs.h"
+#include "utils/spatial_hash.h"
+#include "utils/state_hash.h"
+#include "utils/timeline.h"
 
 constexpr int max_timeshifts = 255;
 
+// Returns the position to render something at, between its positions at the beginning and the end of the last tick. See `render_tick_fraction`.
+// Large jumps (respawning and such) are not interpolated.
+[[nodiscard]] fvec2 InterpolateRenderPos(fvec2 prev, fvec2 cur)
+{
+    constexpr float max_interpolated_dist = 32;
+    if ((abs(cur - prev) > max_interpolated_dist).any())
+        return cur;
+    return mix(render_tick_fraction, prev, cur);
+}
+
+// The base particle bursts, adjusted at the call sites.
+// Sparks from yellow to orange, half of them with red and blue swapped, drawn additively.
+const ParticleEmitter spark_emitter = adjust_(ParticleEmitter{}, damp = 0.015, life_min = 20, life_max = 60, size_min = 1, size_max = 5, end_size = 1,
+    color_a = fvec3(1, 1, 0), color_b = fvec3(0.5, 0.75, 0), random_swap_red_blue = true, beta = 0);
+// Dust from red to yellow.
+const ParticleEmitter dust_emitter = adjust_(ParticleEmitter{}, damp = 0.01, life_min = 20, life_max = 40, size_min = 1, size_max = 5, end_size = 1,
+    color_a = fvec3(1, 0, 0), color_b = fvec3(1, 1, 0));
+
 struct Controls
 {
     struct Button
     {
-        std::vector<Input::Button> buttons;
+        SmallVector<Input::Button, 5> buttons;
+
+        // If set, overrides the real buttons. Used by the headless simulation.
+        std::optional<bool> scripted_down = {};
+        bool scripted_prev_down = false;
 
         [[nodiscard]] bool down() const
         {
+            if (scripted_down)
+                return *scripted_down;
             for (const Input::Button &button : buttons)
                 if (button.down())
                     return true;
@@ -23,6 +57,8 @@ struct Controls
 
         [[nodiscard]] bool pressed() const
         {
+            if (scripted_down)
+                return *scripted_down && !scripted_prev_down;
             bool ok = false;
             for (const Input::Button &button : buttons)
             {
@@ -36,6 +72,8 @@ struct Controls
 
         [[nodiscard]] bool released() const
         {
+            if (scripted_down)
+                return !*scripted_down && scripted_prev_down;
             bool ok = false;
             for (const Input::Button &button : buttons)
             {
@@ -53,12 +91,190 @@ struct Controls
     Button jump = {{Input::space, Input::c, Input::j, Input::up, Input::w}};
     Button shoot = {{Input::x, Input::k}};
     Button timeshift = {{Input::z, Input::l}};
+
+    // The state of all buttons at one tick, for the scripted input.
+    struct Frame
+    {
+        bool left = false, right = false, jump = false, shoot = false, timeshift = false;
+
+        // One bit per button, for the input recordings.
+        [[nodiscard]] std::uint8_t ToBits() const
+        {
+            return left | right << 1 | jump << 2 | shoot << 3 | timeshift << 4;
+        }
+        [[nodiscard]] static Frame FromBits(std::uint8_t bits)
+        {
+            return {.left = bool(bits & 1), .right = bool(bits & 2), .jump = bool(bits & 4), .shoot = bool(bits & 8), .timeshift = bool(bits & 16)};
+        }
+    };
+
+    // The current state of all buttons, respecting the scripted input.
+    [[nodiscard]] Frame CurrentFrame() const
+    {
+        return {.left = left.down(), .right = right.down(), .jump = jump.down(), .shoot = shoot.down(), .timeshift = timeshift.down()};
+    }
+
+    // Replaces the real input with `frame`. Must be called once per tick.
+    void SetScripted(const Frame &frame)
+    {
+        auto Set = [](Button &button, bool value)
+        {
+            button.scripted_prev_down = button.scripted_down.value_or(false);
+            button.scripted_down = value;
+        };
+        Set(left, frame.left);
+        Set(right, frame.right);
+        Set(jump, frame.jump);
+        Set(shoot, frame.shoot);
+        Set(timeshift, frame.timeshift);
+    }
+
+    // Switches back to the real input.
+    void ResetScripted()
+    {
+        for (Button *button : {&left, &right, &jump, &shoot, &timeshift})
+        {
+            button->scripted_down.reset();
+            button->scripted_prev_down = false;
+        }
+    }
+};
+
+// What a `World` takes from outside of the simulation. The world the player sees uses the defaults.
+// The batch simulations give each world its own (see `ValidateReplays()`), so that several headless worlds can tick at once on different threads.
+// Each world also has its own input source, `World::con`, which the headless ticks script.
+struct SimulationContext
+{
+    // If set, the world starts with this map instead of loading it from the files. The copies of a map share the immutable parts, so they're cheap.
+    std::optional<Map> map;
+    // If set, seeds the simulation generator, instead of the global `random_generator` which isn't thread-safe.
+    std::optional<std::uint64_t> seed;
+    // The sounds of the headless ticks go here, see `SimulateHeadless()`. If null, they are dropped.
+    Sounds::Sink sound_sink = nullptr;
+    // If true, the world doesn't touch the globals: ignores the debug reloads, and doesn't print or exit on the replay desyncs.
+    bool batch = false;
+    // If false, the particles always use the full quality, rather than adapting to the frame time. The stress test disables it.
+    bool adaptive_particle_quality = true;
+};
+
+// The input of a single level, one byte per tick (see `Controls::Frame::ToBits()`), plus the simulation seed.
+// Also the state hash before each tick (see `World::ComputeStateHash()`), to detect when the replay diverges.
+// Saved compressed, as a 4-byte little-endian seed followed by the frames, then the hashes as 4-byte little-endian integers,
+// then the number of frames (4 bytes) and `hashes_magic`. The old recordings don't have the hashes, and are still accepted.
+struct InputRecording
+{
+    static constexpr std::uint32_t hashes_magic = 0x31485346; // `FSH1` in little endian.
+
+    std::uint32_t seed = 0;
+    std::vector<std::uint8_t> frames;
+    std::vector<std::uint32_t> hashes; // Either empty or parallel to `frames`.
+
+    // For `Refl::EstimateMemory()`.
+    [[nodiscard]] std::size_t EstimateOwnedMemory() const
+    {
+        return Refl::EstimateOwnedMemory(frames) + Refl::EstimateOwnedMemory(hashes);
+    }
+
+    void Save(const std::string &file_name) const
+    {
+        ASSERT(hashes.empty() || hashes.size() == frames.size());
+
+        auto WriteU32 = [](std::vector<std::uint8_t> &bytes, std::uint32_t value)
+        {
+            for (int i = 0; i < 4; i++)
+                bytes.push_back(std::uint8_t(value >> (i * 8)));
+        };
+
+        std::vector<std::uint8_t> bytes;
+        bytes.reserve(4 + frames.size() + (hashes.empty() ? 0 : hashes.size() * 4 + 8));
+        WriteU32(bytes, seed);
+        bytes.insert(bytes.end(), frames.begin(), frames.end());
+        if (!hashes.empty())
+        {
+            for (std::uint32_t hash : hashes)
+                WriteU32(bytes, hash);
+            WriteU32(bytes, std::uint32_t(frames.size()));
+            WriteU32(bytes, hashes_magic);
+        }
+        file_writer.SaveFileCompressed(file_name, std::move(bytes));
+    }
+
+    [[nodiscard]] static InputRecording Load(const std::string &file_name)
+    {
+        // Uncompress straight into `frames`, without an intermediate copy.
+        Stream::Input input = Stream::UncompressingInput(Stream::ReadOnlyData::map_file(file_name));
+        if (input.Size() < 4)
+            Program::Error("Input recording `", file_name, "` is too short.");
+
+        auto ReadU32 = [&]
+        {
+            std::uint8_t bytes[4];
+            input.Read(bytes, 4);
+            std::uint32_t ret = 0;
+            for (int i = 0; i < 4; i++)
+                ret |= std::uint32_t(bytes[i]) << (i * 8);
+            return ret;
+        };
+
+        InputRecording ret;
+        ret.seed = ReadU32();
+        ret.frames.resize(input.RemainingBytes());
+        input.Read(ret.frames.data(), ret.frames.size());
+
+        // Check for the hashes at the end. The old recordings can't match this by accident, since the frame count must match the size too.
+        std::size_t size = ret.frames.size();
+        if (size >= 8)
+        {
+            auto FromBytes = [&](std::size_t pos)
+            {
+                std::uint32_t value = 0;
+                for (int i = 0; i < 4; i++)
+                    value |= std::uint32_t(ret.frames[pos + i]) << (i * 8);
+                return value;
+            };
+            std::size_t num_frames = FromBytes(size - 8);
+            if (FromBytes(size - 4) == hashes_magic && num_frames * 5 + 8 == size)
+            {
+                ret.hashes.resize(num_frames);
+                for (std::size_t i = 0; i < num_frames; i++)
+                    ret.hashes[i] = FromBytes(num_frames + i * 4);
+                ret.frames.resize(num_frames);
+            }
+        }
+        return ret;
+    }
 };
-Controls con;
 
-struct Shot
+// The snapshots store some trivially copyable objects as raw bytes, since they're only loaded by the same build. See `World::Snapshot`.
+template <typename T>
+[[nodiscard]] std::vector<std::uint8_t> ToRawBytes(std::span<const T> objects)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    std::vector<std::uint8_t> ret(objects.size_bytes());
+    if (!ret.empty())
+        std::memcpy(ret.data(), objects.data(), ret.size());
+    return ret;
+}
+template <typename T>
+[[nodiscard]] std::vector<T> FromRawBytes(const std::vector<std::uint8_t> &bytes)
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (bytes.size() % sizeof(T) != 0)
+        Program::Error("Invalid snapshot: ", bytes.size(), " bytes is not a multiple of the object size ", sizeof(T), ".");
+    std::vector<T> ret(bytes.size() / sizeof(T));
+    if (!ret.empty())
+        std::memcpy(static_cast<void *>(ret.data()), bytes.data(), bytes.size());
+    return ret;
+}
+
+// The shots that currently exist, in the struct-of-arrays form.
+// The capacity is fixed, so this is trivially copyable and can be stored as raw bytes. The removal swaps with the last shot, so the order isn't preserved.
+// The past shots are recorded separately, see `GhostShot`.
+struct Projectiles
 {
-    inline static const std::vector<ivec2> hitbox = {
+    static constexpr int capacity = 8;
+
+    static constexpr std::array<ivec2, 4> hitbox = {
         ivec2(-3, -3), ivec2(-3,  2),
         ivec2( 2, -3), ivec2( 2,  2),
     };
@@ -68,31 +284,72 @@ struct Shot
         return time / 5 % 6;
     }
 
-    fvec2 pos;
-    fvec2 vel;
+    int count = 0;
+    std::array<fvec2, capacity> pos;
+    std::array<fvec2, capacity> vel;
+    std::array<fvec2, capacity> prev_pos; // At the beginning of the tick, to interpolate the rendering from it.
+    std::array<int, capacity> record; // An index in `Ghost::shots` of the newest ghost, see `TimeManager::SavePlayer()`.
+
+    [[nodiscard]] bool Full() const
+    {
+        return count == capacity;
+    }
+
+    void Add(fvec2 new_pos, fvec2 new_vel, int new_record = -1)
+    {
+        ASSERT(!Full(), "Too many projectiles.");
+        pos[count] = new_pos;
+        vel[count] = new_vel;
+        prev_pos[count] = new_pos;
+        record[count] = new_record;
+        count++;
+    }
+
+    void RemoveUnordered(int i)
+    {
+        count--;
+        pos[i] = pos[count];
+        vel[i] = vel[count];
+        prev_pos[i] = prev_pos[count];
+        record[i] = record[count];
+    }
+
+    void Clear()
+    {
+        count = 0;
+    }
+
+    void RememberPrevPos()
+    {
+        for (int i = 0; i < count; i++)
+            prev_pos[i] = pos[i];
+    }
 };
 
 // Note, this structure is copied into timelines...
-struct Player
+STRUCT( Player )
 {
-    inline static const std::vector<ivec2> hitbox = {
+    static constexpr std::array<ivec2, 6> hitbox = {
         ivec2(-4, -9), ivec2(3, -9),
         ivec2(-4,  0), ivec2(3,  0),
         ivec2(-4,  8), ivec2(3,  8),
     };
 
-    inline static const std::vector<ivec2> spike_hitbox = {
+    static constexpr std::array<ivec2, 2> spike_hitbox = {
         ivec2(-4,  0), ivec2(3,  0),
     };
 
     static constexpr ivec2 shot_hitbox_halfsize = ivec2(8,8);
+    // How many shots the player can have at once.
+    static constexpr int max_shots = 1;
+
+    // The bounding box of `hitbox`, the max corner is exclusive.
+    // The tiles are large enough for the points to cover every tile this box can touch, so both can be used interchangeably.
+    static constexpr ivec2 box_a = ivec2(-4, -9), box_b = ivec2(4, 9);
 
     [[nodiscard]] static bool SolidAtPos(const Map &map, ivec2 pos)
     {
-        for (ivec2 point : hitbox)
-            if (map.at_pixel(pos + point).info().solid)
-                return true;
-        return false;
+        return map.AnySolidAtPixels(pos, hitbox);
     }
 
     [[nodiscard]] bool SolidAtOffset(const Map &map, ivec2 offset) const
@@ -105,50 +362,321 @@ struct Player
         return !dead && !in_prison;
     }
 
-    ivec2 pos;
-    fvec2 vel;
-    fvec2 prev_vel;
-    fvec2 vel_lag;
+    // Reflected for `World::StateHash()`.
+    MEMBERS(
+        DECL(ivec2) pos
+        DECL(fvec2) vel
+        DECL(fvec2) prev_vel
+        DECL(fvec2) vel_lag
+
+        DECL(bool INIT = false) ground
+        DECL(bool INIT = false) prev_ground
 
-    bool ground = false;
-    bool prev_ground = false;
+        DECL(bool INIT = false) doublejump_recharged
 
-    bool doublejump_recharged = false;
+        DECL(bool INIT = false) facing_left
 
-    bool facing_left = false;
+        DECL(bool INIT = false) is_walking
+        DECL(int INIT = 0) walking_timer
 
-    bool is_walking = false;
-    int walking_timer = 0;
+        DECL(bool INIT = false) dead
+        DECL(int INIT = 0) death_timer
 
-    bool dead = false;
-    int death_timer = 0;
+        DECL(int INIT = 0) anim_state
+        DECL(int INIT = 0) anim_variant
 
-    int anim_state = 0;
-    int anim_variant = 0;
+        DECL(bool INIT = true) in_prison
+        DECL(int INIT = 3) prison_hp_left
 
-    bool in_prison = true;
-    int prison_hp_left = 3;
+        DECL(int INIT = 0) remaining_boost_frames
+        DECL(fvec2) boost_vel
 
-    std::optional<Shot> shot;
+        // This is here, because we need to save it to the timeline.
+        DECL(float INIT = 0) lava_y
+    )
+};
 
-    int remaining_boost_frames = 0;
-    fvec2 boost_vel;
+// Stores the player states of a single timeline, one per tick, see `Timeline` for the encoding.
+// We don't store the inputs and resimulate from the keyframes instead, because the player tick isn't self-contained:
+// it depends on the world state at that time (broken blocks, other ghosts, items), and spawns particles and sounds.
+using PlayerTimeline = Timeline<Player>;
 
-    // This is here, because we need to save it to the timeline.
-    float lava_y = 0;
+// A shot in a timeline. The shots move with a constant velocity, so one record describes all of their ticks.
+// The positions and velocities are integral, so `PosAt()` matches adding the velocity every tick exactly.
+struct GhostShot
+{
+    int begin = 0, end = 0; // Relative times, half-open.
+    fvec2 pos; // At `begin`.
+    fvec2 vel;
+
+    [[nodiscard]] bool Contains(int rel_time) const
+    {
+        return rel_time >= begin && rel_time < end;
+    }
+
+    [[nodiscard]] fvec2 PosAt(int rel_time) const
+    {
+        return pos + vel * float(rel_time - begin);
+    }
 };
 
 struct Ghost
 {
     int time_start = 0;
-    std::vector<Player> states;
+    PlayerTimeline states;
+
+    std::vector<GhostShot> shots; // Sorted by `begin`.
+    int max_shot_duration = 0; // The longest `end - begin` in `shots`, to find the shots at a given time without visiting all of them.
+
+    // Changes to the saved states, applied when reading them.
+    // Those are half-open ranges of relative times.
+    // Usually there's at most one, so those are stored inline.
+    SmallVector<ivec2, 2> killed_ranges;
+
+    // The relative times where `VisibleAsGhost()` of the saved states changes, ascending. The ghost is invisible before the first one.
+    // Those let `VisibleAt()` skip decoding the states. Not affected by `killed_ranges`.
+    std::vector<int> visibility_changes;
+
+    [[nodiscard]] bool IsKilledAt(int rel_time) const
+    {
+        for (ivec2 range : killed_ranges)
+        {
+            if (rel_time >= range.x && rel_time < range.y)
+                return true;
+        }
+        return false;
+    }
+
+    [[nodiscard]] Player State(int rel_time) const
+    {
+        Player ret = states.Get(rel_time);
+        if (IsKilledAt(rel_time))
+            ret.dead = true;
+        return ret;
+    }
+
+    // Same as `State(rel_time).VisibleAsGhost()`, but doesn't decode the state.
+    [[nodiscard]] bool VisibleAt(int rel_time) const
+    {
+        // An odd number of changes up to this time means visible.
+        auto it = std::upper_bound(visibility_changes.begin(), visibility_changes.end(), rel_time);
+        return (it - visibility_changes.begin()) % 2 == 1 && !IsKilledAt(rel_time);
+    }
+
+    void AppendState(const Player &p)
+    {
+        bool was_visible = visibility_changes.size() % 2 == 1;
+        if (p.VisibleAsGhost() != was_visible)
+            visibility_changes.push_back(states.Size());
+        states.Append(p);
+    }
+
+    // Calls `func(std::size_t i)` for the index of each shot in `shots` that exists at `rel_time`, in order.
+    template <typename F>
+    void ForEachShotAt(int rel_time, F &&func) const
+    {
+        // Only the shots starting in this range can contain `rel_time`.
+        auto first = std::partition_point(shots.begin(), shots.end(), [&](const GhostShot &shot){return shot.begin <= rel_time - max_shot_duration;});
+        auto last = std::partition_point(first, shots.end(), [&](const GhostShot &shot){return shot.begin <= rel_time;});
+        for (auto it = first; it != last; it++)
+        {
+            if (rel_time < it->end)
+                func(std::size_t(it - shots.begin()));
+        }
+    }
+
+    // For `Refl::EstimateMemory()`.
+    [[nodiscard]] std::size_t EstimateOwnedMemory() const
+    {
+        return states.MemoryUsage() + Refl::EstimateOwnedMemory(shots) + Refl::EstimateOwnedMemory(killed_ranges) + Refl::EstimateOwnedMemory(visibility_changes);
+    }
+
+    // Adds the shot to the timeline at `rel_time`, or extends the record `record` if it ends right before it. Updates `record` to the resulting index.
+    void SaveShot(int rel_time, fvec2 pos, fvec2 vel, int &record)
+    {
+        if (record >= 0 && std::size_t(record) < shots.size() && shots[record].end == rel_time)
+        {
+            shots[record].end++;
+        }
+        else
+        {
+            record = int(shots.size());
+            shots.push_back({.begin = rel_time, .end = rel_time + 1, .pos = pos, .vel = vel});
+        }
+        clamp_var_min(max_shot_duration, shots[record].end - shots[record].begin);
+    }
+
+    // Resets the ghost to the default state, keeping the allocated memory.
+    void Clear()
+    {
+        time_start = 0;
+        states.Clear();
+        shots.clear();
+        max_shot_duration = 0;
+        killed_ranges.clear();
+        visibility_changes.clear();
+    }
+
+    // Marks the ghost as dead from `rel_time` and until the end of the saved states.
+    void Kill(int rel_time)
+    {
+        killed_ranges.emplace_back(rel_time, states.Size());
+    }
+
+    // Erases the shot `shots[i]` from `rel_time`, until it disappears on its own.
+    void EraseShot(std::size_t i, int rel_time)
+    {
+        clamp_var_max(shots[i].end, rel_time);
+    }
 
-    bool prev_visible = false;
-    bool prev_shot_visible = false;
+    // `shots` are stored as raw bytes.
+    REFL_SIMPLE_STRUCT( Snapshot
+        REFL_DECL(int REFL_INIT = 0) time_start
+        REFL_DECL(PlayerTimeline::Snapshot) states
+        REFL_DECL(std::vector<std::uint8_t>) shots
+        REFL_DECL(SmallVector<ivec2, 2>) killed_ranges
+    )
+
+    [[nodiscard]] Snapshot SaveSnapshot() const
+    {
+        return {.time_start = time_start, .states = states.SaveSnapshot(), .shots = ToRawBytes(std::span(shots)), .killed_ranges = killed_ranges};
+    }
+
+    [[nodiscard]] static Ghost FromSnapshot(const Snapshot &snapshot)
+    {
+        Ghost ret;
+        ret.time_start = snapshot.time_start;
+        ret.states = PlayerTimeline::FromSnapshot(snapshot.states);
+        ret.shots = FromRawBytes<GhostShot>(snapshot.shots);
+        ret.killed_ranges = snapshot.killed_ranges;
+        // Not saved, since it can be recomputed.
+        for (int i = 0; i < ret.states.Size(); i++)
+        {
+            if (ret.states.Get(i).VisibleAsGhost() != (ret.visibility_changes.size() % 2 == 1))
+                ret.visibility_changes.push_back(i);
+        }
+        for (std::size_t i = 0; i < ret.shots.size(); i++)
+        {
+            const GhostShot &shot = ret.shots[i];
+            if (shot.end < shot.begin || (i > 0 && shot.begin < ret.shots[i - 1].begin))
+                Program::Error("The snapshot has invalid ghost shots.");
+            clamp_var_min(ret.max_shot_duration, shot.end - shot.begin);
+        }
+        return ret;
+    }
 };
+// Draws the ghost trail sprites with a single instanced draw call.
+// The sprites are collected with `Add()`, then `Draw()` uploads them to a buffer texture and draws them, in the same order.
+// Same as a textured quad in `Render` with `.center().color(...).mix(0).alpha(...).beta(0)`.
+class GhostTrailRenderer
+{
+    // The matrices come from the uniform block of `Render`.
+    REFL_SIMPLE_STRUCT( Uniforms
+        REFL_DECL(Graphics::Uniform<Graphics::TexUnit> REFL_ATTR Graphics::Frag) texture
+        REFL_DECL(Graphics::Uniform<fvec2> REFL_ATTR Graphics::Vert) tex_size
+    )
+
+    static constexpr int texels_per_sprite = 3;
+
+    // The instance ID is the sprite index. The quad corners come from the vertex ID, there are no vertex attributes.
+    // See `Add()` for the data layout.
+    static constexpr const char *vertex_source = R"(
+uniform samplerBuffer u_sprites;
+varying vec2 v_texcoord;
+varying vec4 v_color;
+void main()
+{
+    vec4 pos_size = texelFetch(u_sprites, gl_InstanceID * 3);
+    vec4 tex_flip_alpha = texelFetch(u_sprites, gl_InstanceID * 3 + 1);
+    vec2 corner = vec2(gl_VertexID % 2, gl_VertexID / 2);
+    gl_Position = u_matrix * vec4(pos_size.xy + (corner - 0.5) * pos_size.zw, 0, 1);
+    float tex_x = tex_flip_alpha.z > 0.5 ? 1.0 - corner.x : corner.x;
+    v_texcoord = (tex_flip_alpha.xy + vec2(tex_x, corner.y) * pos_size.zw) / u_tex_size;
+    v_color = vec4(texelFetch(u_sprites, gl_InstanceID * 3 + 2).rgb, tex_flip_alpha.w);
+})";
+
+    static constexpr const char *fragment_source = R"(
+varying vec2 v_texcoord;
+varying vec4 v_color;
+void main()
+{
+    gl_FragColor = vec4(v_color.rgb, texture2D(u_texture, v_texcoord).a * v_color.a);
+    vec4 result = u_color_matrix * vec4(gl_FragColor.rgb, 1);
+    gl_FragColor.a *= result.a;
+    gl_FragColor.rgb = result.rgb * gl_FragColor.a;
+    gl_FragColor.a = 0.0; // Additive blending.
+})";
+
+    Uniforms uni;
+    Graphics::Shader shader;
+    Graphics::TexUnit sprites_unit = nullptr;
+    Graphics::BufferTexture<fvec4> sprites = nullptr;
+    std::vector<fvec4> texels;
+
+  public:
+    GhostTrailRenderer()
+        : shader("Ghost trails", shader_config, Graphics::ShaderPreferences{}, Meta::tag<Graphics::none_t>{}, uni,
+            Render::SharedUniformsDeclaration() + vertex_source, Render::SharedUniformsDeclaration() + fragment_source)
+    {
+        r.AttachSharedUniforms(shader);
+
+        // The sampler is not in `Uniforms`, since `Uniform<TexUnit>` is always a `sampler2D`.
+        shader.Bind();
+        glUniform1i(glGetUniformLocation(shader.Handle(), "u_sprites"), sprites_unit.Index());
+    }
+
+    // `pos` is the center, `flip_x` mirrors the texture.
+    void Add(fvec2 pos, const Graphics::TextureAtlas::Region &region, bool flip_x, fvec3 color, float alpha)
+    {
+        texels.push_back(pos.to_vec4(region.size.x, region.size.y));
+        texels.push_back(fvec2(region.pos).to_vec4(flip_x, alpha));
+        texels.push_back(color.to_vec4(0));
+    }
+
+    // Draws and forgets the added sprites. Flushes the queue of `r` first.
+    void Draw()
+    {
+        if (texels.empty())
+            return;
+
+        sprites.SetData(texels.size(), texels.data(), Graphics::stream_draw); // This orphans the old storage.
+
+        r.Finish();
+
+        shader.Bind();
+        r.BindSharedUniforms();
+        uni.texture = texture_main;
+        uni.tex_size = texture_main.Size();
+        sprites.Bind(sprites_unit.Index());
+
+        Graphics::VertexBuffers::BindDraw(0, nullptr); // We don't use any attributes.
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, texels.size() / texels_per_sprite);
+
+        r.BindShader();
+        texels.clear();
+    }
+};
+
 struct TimeManager
 {
     std::vector<Ghost> ghosts;
+
+    // The time ranges of `ghosts`, in the same order. Those are kept separately to find the active ghosts without touching their states.
+    struct GhostSpan
+    {
+        int begin = 0, end = 0; // Absolute times, half-open.
+
+        // The visibility at the last `AddGhostParticles()` call.
+        bool prev_visible = false;
+        bool prev_shot_visible = false;
+
+        [[nodiscard]] bool Contains(int t) const
+        {
+            return t >= begin && t < end;
+        }
+    };
+    std::vector<GhostSpan> ghost_spans;
+
     int time = 0;
 
     bool shifting_now = false;
@@ -160,112 +688,231 @@ struct TimeManager
 
     float shifting_effects_alpha = 0;
 
-    std::map<ivec2, int> block_breaking_times;
+    // The broken blocks, sorted by the break time. The blocks broken after the current time are restored and removed from here.
+    struct BlockBreak
+    {
+        int time = 0;
+        ivec2 pos;
+    };
+    std::vector<BlockBreak> block_breaks;
+
+    // The ghosts removed by `Reset()`, reused by `NextTimeline()` to avoid allocations. Not a part of the state.
+    std::vector<Ghost> spare_ghosts;
+
+    // The ghosts and the ghost shots at the current time, by the index in `ghosts`. Rebuilt by `UpdateGhostGrids()`. Not a part of the state.
+    static constexpr int ghost_grid_cell_size = 48;
+    SpatialHash<std::uint32_t> ghost_grid = SpatialHash<std::uint32_t>(ghost_grid_cell_size);
+    SpatialHash<std::uint32_t> shot_grid = SpatialHash<std::uint32_t>(ghost_grid_cell_size);
+    // The temporary storage for `ForEachGhostInBox()`.
+    std::vector<std::uint32_t> ghost_grid_results;
+
+    void BreakBlock(ivec2 pos)
+    {
+        ASSERT(block_breaks.empty() || block_breaks.back().time <= time, "Block breaks must be added in order.");
+        block_breaks.push_back({.time = time, .pos = pos});
+    }
+
+    // Calls `func(ivec2 pos)` for each block broken after the current time, and forgets them.
+    template <typename F>
+    void UndoFutureBlockBreaks(F &&func)
+    {
+        while (!block_breaks.empty() && block_breaks.back().time > time)
+        {
+            func(block_breaks.back().pos);
+            block_breaks.pop_back();
+        }
+    }
 
     void NextTimeline()
     {
-        ghosts.emplace_back();
+        if (spare_ghosts.empty())
+        {
+            ghosts.emplace_back();
+        }
+        else
+        {
+            ghosts.push_back(std::move(spare_ghosts.back()));
+            spare_ghosts.pop_back();
+        }
         ghosts.back().time_start = time;
+        ghost_spans.push_back({.begin = time, .end = time});
     }
 
-    void SavePlayer(const Player &p)
+    // Records the player and the shots. The `Projectiles::record` indices are updated to point to the records of the shots.
+    // The stale indices (e.g. from the previous timeline) are harmless, they never point to a record ending at the current time.
+    void SavePlayer(const Player &p, Projectiles &shots)
     {
         if (ghosts.empty())
             NextTimeline();
-        ghosts.back().states.push_back(p);
+        Ghost &ghost = ghosts.back();
+        int rel_time = ghost.states.Size();
+        ghost.AppendState(p);
+        for (int i = 0; i < shots.count; i++)
+            ghost.SaveShot(rel_time, shots.pos[i], shots.vel[i], shots.record[i]);
+        ghost_spans.back().end++;
+    }
+
+    // The finished ghosts with no states within this many ticks from the current time are compressed in the background.
+    static constexpr int cold_ghost_distance = 60 * 30;
+    // The compressed ghosts are decompressed when the current time gets this close to them. The time can be rewound at 4.5 ticks per tick at most.
+    static constexpr int warm_ghost_distance = 60 * 10;
+
+    // The distance from the current time to the states of a ghost, in ticks.
+    [[nodiscard]] int GhostDistance(std::size_t i) const
+    {
+        const GhostSpan &span = ghost_spans[i];
+        return time < span.begin ? span.begin - time : time >= span.end ? time - span.end + 1 : 0;
+    }
+
+    // Compresses the ghosts far from the current time, and decompresses the ones that get close to it. Call this once per tick.
+    // If `over_budget` is true, also starts compressing the farthest ghost that isn't close to the current time.
+    // Returns false if there was nothing left to compress.
+    bool UpdateColdGhosts(bool over_budget)
+    {
+        std::size_t farthest = -1zu;
+
+        // The newest ghost can still grow, so it's never compressed.
+        for (std::size_t i = 0; i + 1 < ghosts.size(); i++)
+        {
+            PlayerTimeline &states = ghosts[i].states;
+            states.FinishCompression();
+
+            int distance = GhostDistance(i);
+            if (distance >= cold_ghost_distance)
+                states.CompressInBackground(Jobs::DefaultPool());
+            else if (distance < warm_ghost_distance)
+                states.Decompress();
+
+            if (distance >= warm_ghost_distance && !states.IsCompressed() && !states.IsCompressing() && (farthest == -1zu || distance > GhostDistance(farthest)))
+                farthest = i;
+        }
+
+        if (!over_budget)
+            return true;
+        if (farthest == -1zu)
+            return false;
+        ghosts[farthest].states.CompressInBackground(Jobs::DefaultPool());
+        return true;
+    }
+
+    struct MemoryStats
+    {
+        std::size_t ghost_bytes = 0; // Uncompressed.
+        std::size_t compressed_ghost_bytes = 0;
+        std::size_t spare_ghost_bytes = 0; // Kept by `Reset()` for reuse.
+        int num_ghosts = 0;
+        int num_compressed_ghosts = 0;
+    };
+
+    [[nodiscard]] MemoryStats GetMemoryStats() const
+    {
+        MemoryStats ret;
+        ret.num_ghosts = int(ghosts.size());
+        for (const Ghost &ghost : ghosts)
+        {
+            if (ghost.states.IsCompressed())
+            {
+                ret.compressed_ghost_bytes += ghost.states.MemoryUsage();
+                ret.num_compressed_ghosts++;
+            }
+            else
+            {
+                ret.ghost_bytes += ghost.states.MemoryUsage();
+            }
+            ret.ghost_bytes += ghost.shots.capacity() * sizeof(GhostShot);
+        }
+        for (const Ghost &ghost : spare_ghosts)
+            ret.spare_ghost_bytes += ghost.states.MemoryUsage();
+        return ret;
     }
 
-    void AddGhostParticles(ParticleController &par)
+    void AddGhostParticles(ParticleController &par, Random::DefaultInterfaces<Random::DefaultGenerator> &ra)
     {
         const Ghost *last_ghost = FindNewestGhost();
 
-        for (Ghost &ghost : ghosts)
+        for (std::size_t i = 0; i < ghosts.size(); i++)
         {
-            if (ghost.states.empty())
+            GhostSpan &span = ghost_spans[i];
+            // Only the active ghosts, and the ones that were visible last time, can change their visibility.
+            if (!span.Contains(time) && !span.prev_visible && !span.prev_shot_visible)
+                continue;
+
+            Ghost &ghost = ghosts[i];
+            if (ghost.states.Size() == 0)
                 continue;
             if (&ghost == last_ghost)
                 continue;
 
             int rel_time = time - ghost.time_start;
+            int index = clamp(rel_time, 0, ghost.states.Size() - 1);
 
-            bool visible = time >= ghost.time_start && rel_time < int(ghost.states.size()) && ghost.states[rel_time].VisibleAsGhost();
+            // The state is only decoded if the visibility changes.
+            bool visible = span.Contains(time) && ghost.VisibleAt(index);
 
-            if (visible != ghost.prev_visible)
+            if (visible != span.prev_visible)
             {
-                const Player &state = ghost.states[clamp(rel_time, 0, int(ghost.states.size()) - 1)];
-                ghost.prev_visible = visible;
-                for (int i = 0; i < 24; i++)
-                {
-                    fvec2 dir = fvec2::dir(ra.angle());
-                    float dist = ra.f <= 1;
-                    float c = ra.f <= 1;
-                    fvec3 color(1 - c * 0.5f, 1 - c * 0.25f, 0);
-                    if (ra.boolean())
-                        std::swap(color.x, color.z);
-                    par.Add(adjust(Particle{}, s.pos = state.pos + dir * dist * fvec2(4, 8), damp = 0.015, life = 20 <= ra.i <= 60, size = 1 <= ra.i <= 5, s.vel = dir * dist * 0.15 + state.prev_vel * 0.05, end_size = 1, color = color, beta = 0));
-                }
+                span.prev_visible = visible;
+                Player state = ghost.State(index);
+                par.Emit(ra, adjust(spark_emitter, radius = fvec2(4, 8), speed_max = 0.15), state.pos, 24, state.prev_vel * 0.05);
             }
 
-            bool shot_visible = visible && ghost.states[rel_time].shot;
-            if (shot_visible != ghost.prev_shot_visible)
+            // The position of the first shot at a relative time, if any.
+            auto ShotPosAt = [&](int shot_rel_time)
+            {
+                std::optional<fvec2> ret;
+                ghost.ForEachShotAt(shot_rel_time, [&](std::size_t shot_index)
+                {
+                    if (!ret)
+                        ret = ghost.shots[shot_index].PosAt(shot_rel_time);
+                });
+                return ret;
+            };
+
+            std::optional<fvec2> shot_pos = ShotPosAt(index);
+            bool shot_visible = visible && shot_pos;
+            if (shot_visible != span.prev_shot_visible)
             {
-                ghost.prev_shot_visible = shot_visible;
+                span.prev_shot_visible = shot_visible;
 
                 // Try to guess the shot pos.
-                int index = clamp(rel_time, 0, int(ghost.states.size()) - 1);
-                std::optional<fvec2> shot_pos;
-                if (const auto &opt = ghost.states[index].shot)
-                    shot_pos = opt->pos;
-                else if (index > 0 && ghost.states[index-1].shot)
-                    shot_pos = ghost.states[index-1].shot->pos;
-                else if (index + 1 < int(ghost.states.size()) && ghost.states[index+1].shot)
-                    shot_pos = ghost.states[index+1].shot->pos;
+                if (!shot_pos && index > 0)
+                    shot_pos = ShotPosAt(index - 1);
+                if (!shot_pos && index + 1 < ghost.states.Size())
+                    shot_pos = ShotPosAt(index + 1);
 
                 if (shot_pos)
                 {
-                    for (int i = 0; i < 12; i++)
-                    {
-                        fvec2 dir = fvec2::dir(ra.angle());
-                        float dist = ra.f <= 1;
-                        float c = ra.f <= 1;
-                        fvec3 color(1 - c * 0.5f, 1 - c * 0.25f, 0);
-                        if (ra.boolean())
-                            std::swap(color.x, color.z);
-                        par.Add(adjust(Particle{}, s.pos = *shot_pos + dir * dist * 2, damp = 0.015, life = 20 <= ra.i <= 60, size = 1 <= ra.i <= 3, s.vel = dir * dist * 0.15, end_size = 1, color = color, beta = 0));
-                    }
+                    par.Emit(ra, adjust(spark_emitter, radius = fvec2(2), speed_max = 0.15, size_max = 3), *shot_pos, 12);
                 }
             }
         }
     }
 
-    void RenderGhosts(ivec2 camera_pos) const
+    // `prev_time` is the `time` at the beginning of the last tick, the ghosts are interpolated from it.
+    void RenderGhosts(ivec2 camera_pos, int prev_time) const
     {
-        static const auto &pl_region = texture_atlas.Get("player.png");
-        static const auto &shot_region = texture_atlas.Get("shot.png");
+        const auto &pl_region = texture_atlas.Get<"player.png">();
+        const auto &shot_region = texture_atlas.Get<"shot.png">();
         constexpr ivec2 pl_size(36);
 
+        static GhostTrailRenderer trails;
+
         const Ghost *last_ghost = FindNewestGhost();
 
-        for (const Ghost &ghost : ghosts)
+        ForEachActiveGhost([&](const Ghost &ghost, int rel_time)
         {
             if (&ghost == last_ghost)
-                continue; // Skip the last ghost.
+                return; // Skip the last ghost.
 
-            if (time < ghost.time_start)
-                continue; // Too early.
-            int rel_time = time - ghost.time_start;
-            if (rel_time >= int(ghost.states.size()))
-                continue; // Too late.
-
-            if (!ghost.states[rel_time].VisibleAsGhost())
-                continue; // Invisible, possibly dead.
+            if (!ghost.VisibleAt(rel_time))
+                return; // Invisible, possibly dead.
 
             constexpr int max_time_offset = 3;
 
             for (int i = -max_time_offset; i <= max_time_offset; i++)
             {
                 int this_rel_time = rel_time + i;
-                if (this_rel_time < 0 || this_rel_time >= int(ghost.states.size()))
+                if (this_rel_time < 0 || this_rel_time >= ghost.states.Size())
                     continue; // The time for this sprite is out of range.
 
                 float alpha = 0.45 - abs(i) * 0.1;
@@ -274,57 +921,292 @@ struct TimeManager
                 if (i > 0)
                     std::swap(color.x, color.z);
 
-                const Player &p = ghost.states[this_rel_time];
+                Player p = ghost.State(this_rel_time);
+
+                // The state that was displayed at the same place at the beginning of the tick, if any.
+                int prev_rel_time = this_rel_time - (time - prev_time);
+                std::optional<Player> prev_p;
+                if (prev_rel_time >= 0 && prev_rel_time < ghost.states.Size())
+                    prev_p = ghost.State(prev_rel_time);
 
                 { // Player.
-                    ivec2 rel_pos = p.pos - camera_pos;
+                    ivec2 rel_pos = (prev_p ? iround(InterpolateRenderPos(prev_p->pos, p.pos)) : p.pos) - camera_pos;
                     if ((rel_pos < screen_size / 2 + 24).all())
-                        r.iquad(p.pos - camera_pos, pl_region.region(pl_size * ivec2(p.anim_variant, p.anim_state), pl_size)).center().color(color).mix(0).alpha(alpha).beta(0).flip_x(p.facing_left);
+                        trails.Add(rel_pos, pl_region.region(pl_size * ivec2(p.anim_variant, p.anim_state), pl_size), p.facing_left, color, alpha);
                 }
 
-                // Shot.
-                if (p.shot)
+                // Shots.
+                ghost.ForEachShotAt(this_rel_time, [&](std::size_t shot_index)
                 {
-                    fvec2 rel_pos = p.shot->pos - camera_pos;
-                    if ((rel_pos <= screen_size / 2 + 16).all())
-                        r.fquad(rel_pos, shot_region.region(ivec2(shot_region.size.y * Shot::GetAnimVariant(time), 0), ivec2(shot_region.size.y))).center().flip_x(p.shot->vel.x < 0).color(color).mix(0).alpha(alpha).beta(0);
-                }
+                    const GhostShot &shot = ghost.shots[shot_index];
+                    fvec2 shot_pos = shot.PosAt(this_rel_time);
+                    fvec2 rel_pos = (shot.Contains(prev_rel_time) ? InterpolateRenderPos(shot.PosAt(prev_rel_time), shot_pos) : shot_pos) - camera_pos;
+                    if ((abs(rel_pos) <= screen_size / 2 + 16).all())
+                        trails.Add(rel_pos, shot_region.region(ivec2(shot_region.size.y * Projectiles::GetAnimVariant(time), 0), ivec2(shot_region.size.y)), shot.vel.x < 0, color, alpha);
+                });
+            }
+        });
+
+        trails.Draw();
+    }
+
+    // Calls `func(Ghost &ghost, int rel_time)` for each ghost that has a state at the current time, in order.
+    MAYBE_CONST(
+        template <typename F>
+        void ForEachActiveGhost(F &&func) CV
+        {
+            for (std::size_t i = 0; i < ghost_spans.size(); i++)
+            {
+                if (ghost_spans[i].Contains(time))
+                    func(ghosts[i], time - ghost_spans[i].begin);
             }
         }
+    )
+
+    // Rebuilds `ghost_grid` and `shot_grid` from the ghost states at the current time. Call this once per tick, after `SavePlayer()`.
+    // The grids can go stale within the tick (e.g. after `Ghost::Kill()`), so re-check the states after querying them.
+    void UpdateGhostGrids()
+    {
+        ghost_grid.Clear();
+        shot_grid.Clear();
+        for (std::uint32_t i = 0; i < ghost_spans.size(); i++)
+        {
+            if (!ghost_spans[i].Contains(time))
+                continue;
+            int rel_time = time - ghost_spans[i].begin;
+            Player state = ghosts[i].State(rel_time);
+            if (state.VisibleAsGhost())
+                ghost_grid.Insert(state.pos, state.pos + 1, i);
+            ghosts[i].ForEachShotAt(rel_time, [&](std::size_t shot_index)
+            {
+                ivec2 shot_pos = ivec2(floor(ghosts[i].shots[shot_index].PosAt(rel_time)));
+                shot_grid.Insert(shot_pos, shot_pos + 1, i);
+            });
+        }
+        ghost_grid.Finalize();
+        shot_grid.Finalize();
+    }
+
+    // Calls `func(Ghost &ghost, int rel_time)` for each ghost in `grid` (`ghost_grid` or `shot_grid`) overlapping the box `a`..`b` (`b` is exclusive).
+    // Visits them in the same order as `ForEachActiveGhost()`, once per ghost, even if several of its shots are in the box.
+    template <typename F>
+    void ForEachGhostInBox(const SpatialHash<std::uint32_t> &grid, ivec2 a, ivec2 b, F &&func)
+    {
+        ghost_grid_results.clear();
+        grid.Query(a, b, [&](std::uint32_t i){ghost_grid_results.push_back(i);});
+        std::sort(ghost_grid_results.begin(), ghost_grid_results.end());
+        ghost_grid_results.erase(std::unique(ghost_grid_results.begin(), ghost_grid_results.end()), ghost_grid_results.end());
+        for (std::uint32_t i : ghost_grid_results)
+        {
+            if (ghost_spans[i].Contains(time))
+                func(ghosts[i], time - ghost_spans[i].begin);
+        }
     }
 
     // Find newest ghost for the current time.
     // Returns null on failure.
     const Ghost *FindNewestGhost() const
     {
-        for (std::size_t i = ghosts.size(); i-- > 0;)
+        for (std::size_t i = ghost_spans.size(); i-- > 0;)
         {
-            const Ghost &ghost = ghosts[i];
-            if (ghost.time_start <= time)
+            const GhostSpan &span = ghost_spans[i];
+            if (span.begin <= time)
             {
-                int rel_time = time - ghost.time_start;
-                if (rel_time >= int(ghost.states.size()))
+                if (time >= span.end)
                     return nullptr; // Note, not `continue`. This is more sane.
-                return &ghost;
+                return &ghosts[i];
             }
         }
         return nullptr;
     }
 
-    // Find newest player state for the current time.
-    // Returns null on failure.
-    const Player *FindNewestState() const
+    // Find newest player state for the current time, and replaces `shots` with the shots from it.
+    // Returns null on failure, then `shots` are unchanged.
+    std::optional<Player> FindNewestState(Projectiles &shots) const
     {
         const Ghost *ret = FindNewestGhost();
-        if (ret)
-            return &ret->states[time - ret->time_start];
-        return nullptr;
+        if (!ret)
+            return {};
+
+        int rel_time = time - ret->time_start;
+        shots.Clear();
+        ret->ForEachShotAt(rel_time, [&](std::size_t i)
+        {
+            if (!shots.Full())
+                shots.Add(ret->shots[i].PosAt(rel_time), ret->shots[i].vel, int(i));
+        });
+        return ret->State(rel_time);
+    }
+
+    // Returns to the initial state, keeping the allocated memory.
+    void Reset()
+    {
+        TimeManager old = std::move(*this);
+        *this = {};
+
+        spare_ghosts = std::move(old.spare_ghosts);
+        ghost_grid = std::move(old.ghost_grid);
+        ghost_grid.Clear();
+        shot_grid = std::move(old.shot_grid);
+        shot_grid.Clear();
+        for (Ghost &ghost : old.ghosts)
+        {
+            ghost.Clear();
+            spare_ghosts.push_back(std::move(ghost));
+        }
+        ghosts = std::move(old.ghosts);
+        ghosts.clear();
+        ghost_spans = std::move(old.ghost_spans);
+        ghost_spans.clear();
+        block_breaks = std::move(old.block_breaks);
+        block_breaks.clear();
     }
 
     int RemainingShifts() const
     {
         return clamp(max_timeshifts - int(ghosts.size()) + !shifting_now, 0, max_timeshifts);
     }
+
+    // `ghost_spans` and `block_breaks` are stored as raw bytes.
+    REFL_SIMPLE_STRUCT( Snapshot
+        REFL_DECL(std::vector<Ghost::Snapshot>) ghosts
+        REFL_DECL(std::vector<std::uint8_t>) ghost_spans
+        REFL_DECL(int REFL_INIT = 0) time
+        REFL_DECL(bool REFL_INIT = false) shifting_now
+        REFL_DECL(float REFL_INIT = 0) shifting_speed
+        REFL_DECL(float REFL_INIT = 0) shifting_lag
+        REFL_DECL(float REFL_INIT = 0) positive_speed
+        REFL_DECL(float REFL_INIT = 0) shifting_effects_alpha
+        REFL_DECL(std::vector<std::uint8_t>) block_breaks
+    )
+
+    [[nodiscard]] Snapshot SaveSnapshot() const
+    {
+        Snapshot ret;
+        ret.ghosts.reserve(ghosts.size());
+        for (const Ghost &ghost : ghosts)
+            ret.ghosts.push_back(ghost.SaveSnapshot());
+        ret.ghost_spans = ToRawBytes(std::span(ghost_spans));
+        ret.time = time;
+        ret.shifting_now = shifting_now;
+        ret.shifting_speed = shifting_speed;
+        ret.shifting_lag = shifting_lag;
+        ret.positive_speed = positive_speed;
+        ret.shifting_effects_alpha = shifting_effects_alpha;
+        ret.block_breaks = ToRawBytes(std::span(block_breaks));
+        return ret;
+    }
+
+    void LoadSnapshot(const Snapshot &snapshot)
+    {
+        std::vector<Ghost> new_ghosts;
+        new_ghosts.reserve(snapshot.ghosts.size());
+        for (const Ghost::Snapshot &ghost : snapshot.ghosts)
+            new_ghosts.push_back(Ghost::FromSnapshot(ghost));
+        std::vector<GhostSpan> new_ghost_spans = FromRawBytes<GhostSpan>(snapshot.ghost_spans);
+        if (new_ghost_spans.size() != new_ghosts.size())
+            Program::Error("The time snapshot has ", new_ghosts.size(), " ghosts, but ", new_ghost_spans.size(), " ghost spans.");
+        std::vector<BlockBreak> new_block_breaks = FromRawBytes<BlockBreak>(snapshot.block_breaks);
+
+        // Nothing below throws, so a bad snapshot leaves everything unchanged.
+        ghosts = std::move(new_ghosts);
+        ghost_spans = std::move(new_ghost_spans);
+        time = snapshot.time;
+        shifting_now = snapshot.shifting_now;
+        shifting_speed = snapshot.shifting_speed;
+        shifting_lag = snapshot.shifting_lag;
+        positive_speed = snapshot.positive_speed;
+        shifting_effects_alpha = snapshot.shifting_effects_alpha;
+        block_breaks = std::move(new_block_breaks);
+    }
+};
+
+// The full-screen passes of `World::Render()`, through `post_process`. They use the color matrix of `Render`, like the quads they replace.
+struct WorldEffects
+{
+    static constexpr int num_ray_groups = 5;
+
+    // The time machine rays. Each group is a fan of 1-pixel-wide rays, added to the scene.
+    REFL_SIMPLE_STRUCT( TimeMachineUniforms
+        REFL_DECL(Graphics::Uniform<Graphics::TexUnit> REFL_ATTR Graphics::Frag) texture
+        REFL_DECL(Graphics::Uniform<fvec2> REFL_ATTR Graphics::Frag) screen_size
+        REFL_DECL(Graphics::Uniform<float[num_ray_groups]> REFL_ATTR Graphics::Frag) ray_angles // The angle of any ray in each group.
+        REFL_DECL(Graphics::Uniform<fvec3[num_ray_groups]> REFL_ATTR Graphics::Frag) ray_colors
+        REFL_DECL(Graphics::Uniform<float> REFL_ATTR Graphics::Frag) ray_step // The angle between the rays of a group.
+        REFL_DECL(Graphics::Uniform<fvec2> REFL_ATTR Graphics::Frag) ray_dist // The min and max distance from the center.
+        REFL_DECL(Graphics::Uniform<fvec2> REFL_ATTR Graphics::Frag) ray_alpha // At the min and max distance.
+    )
+
+    static constexpr const char *time_machine_source = R"(
+varying vec2 v_texcoord;
+void main()
+{
+    gl_FragColor = texture2D(u_texture, v_texcoord);
+
+    // The pixel center relative to the screen center, with Y pointing down.
+    vec2 pos = vec2(v_texcoord.x - 0.5, 0.5 - v_texcoord.y) * u_screen_size;
+    if (dot(pos, pos) < u_ray_dist.x * u_ray_dist.x)
+        return;
+    float angle = atan(pos.y, pos.x);
+
+    for (int i = 0; i < 5; i++)
+    {
+        float ray_angle = u_ray_angles[i] + floor((angle - u_ray_angles[i]) / u_ray_step + 0.5) * u_ray_step;
+        vec2 dir = vec2(cos(ray_angle), sin(ray_angle));
+        float along = dot(pos, dir);
+        if (abs(dot(pos, vec2(-dir.y, dir.x))) >= 0.5 || along > u_ray_dist.y)
+            continue;
+        float alpha = mix(u_ray_alpha.x, u_ray_alpha.y, (along - u_ray_dist.x) / (u_ray_dist.y - u_ray_dist.x));
+        vec4 result = u_color_matrix * vec4(u_ray_colors[i], 1);
+        gl_FragColor.rgb += result.rgb * alpha * result.a; // Additive.
+    }
+})";
+
+    // Draws the vignette image from the atlas over the scene, centered, and outputs the result.
+    REFL_SIMPLE_STRUCT( VignetteUniforms
+        REFL_DECL(Graphics::Uniform<Graphics::TexUnit> REFL_ATTR Graphics::Frag) texture
+        REFL_DECL(Graphics::Uniform<Graphics::TexUnit> REFL_ATTR Graphics::Frag) atlas
+        REFL_DECL(Graphics::Uniform<fvec2> REFL_ATTR Graphics::Frag) atlas_size
+        REFL_DECL(Graphics::Uniform<fvec2> REFL_ATTR Graphics::Frag) screen_size
+        REFL_DECL(Graphics::Uniform<fvec2> REFL_ATTR Graphics::Frag) region_pos
+        REFL_DECL(Graphics::Uniform<fvec2> REFL_ATTR Graphics::Frag) region_size
+        REFL_DECL(Graphics::Uniform<float> REFL_ATTR Graphics::Frag) alpha
+    )
+
+    static constexpr const char *vignette_source = R"(
+varying vec2 v_texcoord;
+void main()
+{
+    gl_FragColor = texture2D(u_texture, v_texcoord);
+
+    // Relative to the top-left corner of the image.
+    vec2 pos = vec2(v_texcoord.x, 1.0 - v_texcoord.y) * u_screen_size - (u_screen_size - u_region_size) / 2.0;
+    if (any(lessThan(pos, vec2(0))) || any(greaterThanEqual(pos, u_region_size)))
+        return;
+
+    vec4 color = texture2D(u_atlas, (u_region_pos + pos) / u_atlas_size);
+    vec4 result = u_color_matrix * vec4(color.rgb, 1);
+    float alpha = color.a * u_alpha * result.a;
+    gl_FragColor = vec4(result.rgb * alpha, alpha) + gl_FragColor * (1.0 - alpha); // Premultiplied.
+})";
+
+    TimeMachineUniforms time_machine_uni;
+    Graphics::Shader time_machine;
+    VignetteUniforms vignette_uni;
+    Graphics::Shader vignette;
+
+    WorldEffects()
+        : time_machine(GameUtils::PostProcess::MakeShader("Time machine", shader_config, time_machine_uni, Render::SharedUniformsDeclaration() + time_machine_source)),
+        vignette(GameUtils::PostProcess::MakeShader("Vignette", shader_config, vignette_uni, Render::SharedUniformsDeclaration() + vignette_source))
+    {
+        r.AttachSharedUniforms(time_machine);
+        r.AttachSharedUniforms(vignette);
+
+        time_machine_uni.texture = post_process.SourceUnit();
+        time_machine_uni.screen_size = screen_size;
+        vignette_uni.texture = post_process.SourceUnit();
+        vignette_uni.screen_size = screen_size;
+    }
 };
 
 namespace States
@@ -333,20 +1215,63 @@ namespace States
     {
         MEMBERS()
 
+        SimulationContext context;
+
         int real_world_time = 0;
 
-        Map map = Stream::ReadOnlyData(Program::ExeDir() + "map.json");
-        Map map_orig = map;
+        // The simulation uses its own generator, to be reproducible when seeded. Rendering still uses the global one.
+        // Seeded in `Init()`, since the constructor can run on a worker thread.
+        Random::DefaultGenerator rng;
+
+        // The input. Separate for each world, so the headless ones can be scripted independently.
+        Controls con;
+
+        // If true, `Tick()` doesn't touch the audio context. See `SimulateHeadless()`.
+        bool headless = false;
+
+        // Input recording and replay, from `launch_options`.
+        std::string record_file;
+        InputRecording recording;
+        std::optional<InputRecording> replay;
+        std::size_t replay_pos = 0;
+        bool replay_fast = false;
+        bool benchmark = false; // Feed the frame times to `benchmark_recorder` during the replay.
+        std::optional<std::size_t> replay_desync_tick; // See `CheckReplayHash()`.
+
+        Map map;
+        // The map state at the start of the level, for `Reset()`.
+        Map::Snapshot initial_map;
 
         Player p;
+        Projectiles shots; // Fired by the player.
         ParticleController par = true;
         ParticleController par_timeless = false;
         TimeManager time;
 
+        // The step time of a 60 FPS frame that the particle quality tries to stay under, leaving some room for the rest.
+        static constexpr double particle_frame_budget_secs = 0.75 / 60;
+        // The start of the last profiler frame fed to `UpdateParticleQuality()`.
+        std::uint64_t particle_quality_frame = 0;
+
         ivec2 camera_pos;
 
+        // The state at the beginning of the last tick, to interpolate the rendering from it.
+        struct PrevTickState
+        {
+            ivec2 camera_pos;
+            ivec2 player_pos;
+            int time = 0;
+        };
+        PrevTickState prev_tick;
+
         bool buffered_jump = false;
 
+        // If true, the next `Tick()` restarts the level with `Reset()`, before ticking.
+        bool reset_pending = false;
+
+        // The values of `atlas_version` and `map_version` that we've seen, to react to the debug reloads.
+        int seen_atlas_version = 0, seen_map_version = 0;
+
         float fade = 1;
         float exit_fade = 0;
 
@@ -387,20 +1312,341 @@ namespace States
             ivec2 pos;
             std::string message;
             float alpha = 0;
+
+            [[nodiscard]] std::size_t EstimateOwnedMemory() const
+            {
+                return Refl::EstimateOwnedMemory(message);
+            }
         };
         std::vector<Hint> hints;
+        ChunkedPointIndex hint_index; // The positions of `hints`.
+        std::vector<std::size_t> visible_hints; // Indices in `hints` with a non-zero alpha, ascending. Only those and the ones near the player need updating.
+
+        // If not empty, F5 saves a snapshot to this file and F9 loads it. From `launch_options`.
+        std::string snapshot_file;
+
+        // The state of the level, except for the input recording and replay, and the audio.
+        // It's only meant to be loaded by the same build (which is checked), so the trivially copyable objects are stored as raw bytes.
+        REFL_SIMPLE_STRUCT( Snapshot
+            REFL_DECL(int REFL_INIT = 0) build
+            REFL_DECL(int REFL_INIT = 0) real_world_time
+            REFL_DECL(std::string) rng
+            REFL_DECL(Map::Snapshot) map
+            REFL_DECL(std::vector<std::uint8_t>) p
+            REFL_DECL(std::vector<std::uint8_t>) shots
+            REFL_DECL(ParticleController::Snapshot) par
+            REFL_DECL(ParticleController::Snapshot) par_timeless
+            REFL_DECL(TimeManager::Snapshot) time
+            REFL_DECL(ivec2 REFL_INIT{}) camera_pos
+            REFL_DECL(bool REFL_INIT = false) buffered_jump
+            REFL_DECL(float REFL_INIT = 1) fade
+            REFL_DECL(float REFL_INIT = 0) exit_fade
+            REFL_DECL(int REFL_INIT = 0) prison_timer
+            REFL_DECL(ivec2 REFL_INIT{}) prison_sprite_offset
+            REFL_DECL(int REFL_INIT = 0) prison_anim_timer
+            REFL_DECL(bool REFL_INIT = false) have_timeshift_ability
+            REFL_DECL(bool REFL_INIT = false) have_doublejump_ability
+            REFL_DECL(bool REFL_INIT = false) have_gun_ability
+            REFL_DECL(int REFL_INIT = 0) time_since_got_timeshift
+            REFL_DECL(std::string) ability_message
+            REFL_DECL(std::string) ability_message2
+            REFL_DECL(int REFL_INIT = 0) ability_timer
+            REFL_DECL(bool REFL_INIT = false) seen_hint_death_rollback
+            REFL_DECL(float REFL_INIT = 0) hint_death_hollback
+            REFL_DECL(bool REFL_INIT = false) seen_hint_jump
+            REFL_DECL(float REFL_INIT = 0) hint_jump
+            REFL_DECL(float REFL_INIT = 1) logo_alpha
+            REFL_DECL(std::vector<float>) hint_alphas // In the same order as `hints`.
+        )
+
+        // Copies the members that are stored in the snapshot as is, in either direction.
+        static void CopyPlainSnapshotMembers(auto &to, const auto &from)
+        {
+            to.real_world_time = from.real_world_time;
+            to.camera_pos = from.camera_pos;
+            to.buffered_jump = from.buffered_jump;
+            to.fade = from.fade;
+            to.exit_fade = from.exit_fade;
+            to.prison_timer = from.prison_timer;
+            to.prison_sprite_offset = from.prison_sprite_offset;
+            to.prison_anim_timer = from.prison_anim_timer;
+            to.have_timeshift_ability = from.have_timeshift_ability;
+            to.have_doublejump_ability = from.have_doublejump_ability;
+            to.have_gun_ability = from.have_gun_ability;
+            to.time_since_got_timeshift = from.time_since_got_timeshift;
+            to.ability_message = from.ability_message;
+            to.ability_message2 = from.ability_message2;
+            to.ability_timer = from.ability_timer;
+            to.seen_hint_death_rollback = from.seen_hint_death_rollback;
+            to.hint_death_hollback = from.hint_death_hollback;
+            to.seen_hint_jump = from.seen_hint_jump;
+            to.hint_jump = from.hint_jump;
+            to.logo_alpha = from.logo_alpha;
+        }
 
-        World()
+        [[nodiscard]] Snapshot SaveSnapshot() const
         {
-            p.lava_y = map.initial_lava_level;
+            Snapshot ret;
+            ret.build = build_number;
+            CopyPlainSnapshotMembers(ret, *this);
+
+            std::ostringstream rng_state;
+            rng_state << rng;
+            ret.rng = rng_state.str();
+
+            ret.map = map.SaveSnapshot();
+            ret.p = ToRawBytes(std::span(&p, 1));
+            ret.shots = ToRawBytes(std::span(&shots, 1));
+            ret.par = par.SaveSnapshot();
+            ret.par_timeless = par_timeless.SaveSnapshot();
+            ret.time = time.SaveSnapshot();
+
+            ret.hint_alphas.reserve(hints.size());
+            for (const Hint &hint : hints)
+                ret.hint_alphas.push_back(hint.alpha);
+            return ret;
+        }
+
+        // Throws if the snapshot was saved by a different build of the game, or doesn't match the map.
+        // The restored particles and ghosts can't be rewound past the moment of saving.
+        void LoadSnapshot(const Snapshot &snapshot)
+        {
+            if (snapshot.build != build_number)
+                Program::Error("The snapshot was saved by the build ", snapshot.build, ", but this is the build ", build_number, ".");
+            if (snapshot.hint_alphas.size() != hints.size())
+                Program::Error("The snapshot has ", snapshot.hint_alphas.size(), " hints, but the map has ", hints.size(), ".");
+            std::vector<Player> new_p = FromRawBytes<Player>(snapshot.p);
+            if (new_p.size() != 1)
+                Program::Error("The snapshot has an invalid player state.");
+            std::vector<Projectiles> new_shots = FromRawBytes<Projectiles>(snapshot.shots);
+            if (new_shots.size() != 1 || new_shots.front().count < 0 || new_shots.front().count > Projectiles::capacity)
+                Program::Error("The snapshot has an invalid shot state.");
+
+            std::istringstream rng_state(snapshot.rng);
+            Random::DefaultGenerator new_rng;
+            rng_state >> new_rng;
+            if (!rng_state)
+                Program::Error("The snapshot has an invalid random generator state.");
+
+            // Validate and decode everything before changing anything, so a bad snapshot leaves the world as it was.
+            map.ValidateSnapshot(snapshot.map);
+            ParticleController::ValidateSnapshot(snapshot.par);
+            ParticleController::ValidateSnapshot(snapshot.par_timeless);
+            TimeManager new_time;
+            new_time.LoadSnapshot(snapshot.time); // Decodes the ghosts, so it's loaded once into a temporary, instead of validating first.
+
+            // Nothing below throws on bad input.
+            window.FinishSwapBuffers(); // Replacing the particles frees their GPU buffers.
+
+            map.LoadSnapshot(snapshot.map);
+            new_time.spare_ghosts = std::move(time.spare_ghosts); // Not a part of the state, keep them for reuse.
+            time = std::move(new_time);
+            par.LoadSnapshot(snapshot.par);
+            par_timeless.LoadSnapshot(snapshot.par_timeless);
+
+            CopyPlainSnapshotMembers(*this, snapshot);
+            rng = new_rng;
+            p = new_p.front();
+            shots = new_shots.front();
+            visible_hints.clear();
+            for (std::size_t i = 0; i < hints.size(); i++)
+            {
+                hints[i].alpha = snapshot.hint_alphas[i];
+                if (hints[i].alpha > 0)
+                    visible_hints.push_back(i);
+            }
+
+            RememberPrevTickState(); // Don't interpolate from the state before loading.
+        }
+
+        void RememberPrevTickState()
+        {
+            prev_tick.camera_pos = camera_pos;
+            prev_tick.player_pos = p.pos;
+            shots.RememberPrevPos();
+            prev_tick.time = time.time;
+            par.BeginTick();
+            par_timeless.BeginTick();
+        }
+
+        // The memory used by the rewind history.
+        struct HistoryStats
+        {
+            TimeManager::MemoryStats time;
+            std::size_t particle_bytes = 0;
 
+            [[nodiscard]] std::size_t TotalBytes() const
+            {
+                return time.ghost_bytes + time.compressed_ghost_bytes + time.spare_ghost_bytes + particle_bytes;
+            }
+        };
+
+        [[nodiscard]] HistoryStats GetHistoryStats() const
+        {
+            return {.time = time.GetMemoryStats(), .particle_bytes = par.TimelineBytes()};
+        }
+
+        // Keeps the rewind history within `launch_options.history_budget_bytes`. Call this once per tick.
+        // When over the budget, first frees the spare ghosts, then compresses the ghosts one per tick starting from the farthest from the current time,
+        // and when there's nothing left to compress, drops the oldest particle history. The ghosts themselves are never dropped, since they're a part of the game.
+        void EnforceHistoryBudget()
+        {
+            std::size_t budget = launch_options.history_budget_bytes;
+            HistoryStats stats = GetHistoryStats();
+            bool over_budget = stats.TotalBytes() > budget;
+
+            if (over_budget && stats.time.spare_ghost_bytes > 0)
+            {
+                time.spare_ghosts = {};
+                stats.time.spare_ghost_bytes = 0;
+                over_budget = stats.TotalBytes() > budget;
+            }
+
+            if (!time.UpdateColdGhosts(over_budget))
+            {
+                std::size_t ghost_bytes = stats.TotalBytes() - stats.particle_bytes;
+                (void)par.TrimTimeline(ghost_bytes < budget ? budget - ghost_bytes : 0);
+            }
+        }
+
+        // See `StateBase::MemoryReport()`. The parts of the world, estimated with `Refl::EstimateMemory()` including the unused capacity,
+        // then the global assets. The ghosts, the particle history, and the input recording grow during the game, the rest mostly doesn't.
+        [[nodiscard]] std::string MemoryReport() const override
+        {
+            std::string ret;
+            std::size_t total = 0;
+            auto Line = [&](std::string_view name, std::size_t bytes, std::string_view details = {})
+            {
+                total += bytes;
+                FMT_APPEND(ret, "{:<17}{:8.2f} MiB{}{}\n", name, bytes / 1024. / 1024., details.empty() ? "" : "  ", details);
+            };
+
+            TimeManager::MemoryStats ghost_stats = time.GetMemoryStats();
+            Line("ghosts", Refl::EstimateOwnedMemory(time.ghosts), FMT("{} ghosts, {} compressed", ghost_stats.num_ghosts, ghost_stats.num_compressed_ghosts));
+            Line("spare ghosts", Refl::EstimateOwnedMemory(time.spare_ghosts));
+
+            ParticleController::MemoryUsage par_usage = par.GetMemoryUsage(), par_timeless_usage = par_timeless.GetMemoryUsage();
+            Line("particles", par_usage.states + par_timeless_usage.states, FMT("{} particles", par.Count() + par_timeless.Count()));
+            Line("particle history", par_usage.history + par_timeless_usage.history);
+            Line("particle other", par_usage.other + par_timeless_usage.other, "scratch, GPU buffers");
+
+            std::size_t map_render_cache = Refl::EstimateOwnedMemory(map.render_cache);
+            Line("map", Refl::EstimateOwnedMemory(map) - map_render_cache, FMT("{}x{} tiles", map.cells.size().x, map.cells.size().y));
+            Line("map render cache", map_render_cache, "including GPU");
+
+            Line("input recording", Refl::EstimateOwnedMemory(recording) + Refl::EstimateOwnedMemory(replay));
+            Line("other world", sizeof(World) + Refl::EstimateOwnedMemory(hints) + Refl::EstimateOwnedMemory(hint_index) + Refl::EstimateOwnedMemory(visible_hints) +
+                Refl::EstimateOwnedMemory(initial_map) + Refl::EstimateOwnedMemory(time.ghost_spans) + Refl::EstimateOwnedMemory(time.block_breaks) + Refl::EstimateOwnedMemory(time.ghost_grid_results));
+
+            Line("atlas image", Refl::EstimateOwnedMemory(texture_atlas.GetImage()));
+            Line("atlas texture", Refl::EstimateOwnedMemory(texture_main), "GPU");
+
+            std::size_t buffer_bytes = 0, sound_bytes = 0;
+            for (const auto &[name, data] : Audio::impl::GetAutoLoadedBuffers())
+            {
+                buffer_bytes += Refl::EstimateOwnedMemory(data.buffer);
+                sound_bytes += Refl::EstimateOwnedMemory(data.sound);
+            }
+            Line("audio buffers", buffer_bytes, FMT("{} sounds, in the audio library", Audio::impl::GetAutoLoadedBuffers().size()));
+            Line("sound data", sound_bytes, "for the mixer");
+
+            FMT_APPEND(ret, "{:<17}{:8.2f} MiB", "total", total / 1024. / 1024.);
+            return ret;
+        }
+
+        [[nodiscard]] bool SnapshotFileExists() const
+        {
+            if (snapshot_file.empty())
+                return false;
+            file_writer.Flush();
+            bool ok = false;
+            (void)Filesystem::GetObjectInfo(snapshot_file, &ok);
+            return ok;
+        }
+
+        void SaveSnapshotToFile(const std::string &file_name) const
+        {
+            file_writer.SaveFileCompressed(file_name, Refl::ToBinary<std::vector<std::uint8_t>>(SaveSnapshot()));
+        }
+
+        void LoadSnapshotFromFile(const std::string &file_name)
+        {
+            file_writer.Flush(); // In case the file is still being saved.
+
+            Snapshot snapshot;
+            // Not `Stream::UncompressingInput()`, since `uncompress()` decompresses the large snapshots in parallel.
+            Refl::FromBinary(snapshot, Stream::Input(Stream::ReadOnlyData::map_file(file_name).uncompress()));
+            LoadSnapshot(snapshot);
+        }
+
+        // This doesn't touch the globals, because the level can be constructed on a worker thread (see `Manager::Prepare()`).
+        // The rest is in `Init()`.
+        World() : World(SimulationContext{}) {}
+
+        // The batch worlds use this directly, and never call `Init()`.
+        explicit World(SimulationContext new_context)
+            : context(std::move(new_context)),
+            map(context.map ? std::move(*context.map) : GameUtils::StartupTrace::Traced("map", LoadMapFromFiles))
+        {
+            context.map.reset(); // Don't keep the moved-from map around.
+            LoadMapPoints();
+            StartLevel();
+        }
+
+        [[nodiscard]] static Map LoadMapFromFiles()
+        {
+            return Map::Load(Program::ExeDir() + "map.json", Program::ExeDir() + "map.bin");
+        }
+
+        // A seed for `rng`.
+        [[nodiscard]] std::uint64_t NewSeed() const
+        {
+            return context.seed ? *context.seed : random_generator();
+        }
+
+        // Extracts the hints from the map, and remembers its initial state.
+        void LoadMapPoints()
+        {
+            hints.clear();
+            visible_hints.clear();
+            std::vector<ivec2> hint_points;
             map.points.ForEachPointWithNamePrefix("hint:", [&](std::string_view suffix, fvec2 pos)
             {
                 Hint new_hint;
                 new_hint.message = suffix;
                 new_hint.pos = pos;
+                hint_points.push_back(new_hint.pos);
                 hints.push_back(std::move(new_hint));
             });
+            hint_index = ChunkedPointIndex(std::move(hint_points));
+
+            initial_map = map.SaveSnapshot();
+        }
+
+        // Loads the map again, and restarts the level. For the debug reloads, see `map_version`.
+        void ReloadMap()
+        {
+            try
+            {
+                window.FinishSwapBuffers(); // Replacing the map frees its GPU buffers and the tilemap texture.
+                map = LoadMapFromFiles();
+            }
+            catch (std::exception &e)
+            {
+                std::cout << FMT("Unable to reload the map: {}\n", e.what()); // Keep the old map, it's retried on the next change.
+                return;
+            }
+
+            LoadMapPoints();
+            Reset();
+        }
+
+        // Places the player at the start of the level, and applies the debug options from the map.
+        void StartLevel()
+        {
+            p = {};
+            p.lava_y = map.initial_lava_level;
+            shots.Clear();
 
             { // Debug features.
                 if (map.debug_player_start)
@@ -422,8 +1668,254 @@ namespace States
             }
         }
 
+        void Init() override
+        {
+            rng = Random::DefaultGenerator(NewSeed());
+
+            seen_atlas_version = atlas_version;
+            seen_map_version = map_version;
+
+            { // Recording and replay. They only apply to the first level, restarts use the live input.
+                if (!launch_options.replay_file.empty())
+                {
+                    replay = InputRecording::Load(launch_options.replay_file);
+                    replay_fast = launch_options.replay_fast;
+                    benchmark = !launch_options.benchmark_file.empty();
+                    rng.seed(replay->seed);
+                }
+                else if (!launch_options.record_file.empty())
+                {
+                    record_file = launch_options.record_file;
+                    recording.seed = std::uint32_t(random_generator());
+                    rng.seed(recording.seed);
+                }
+                snapshot_file = launch_options.snapshot_file;
+
+                // So the next levels don't use them. The rest of the options apply to the whole game.
+                launch_options.record_file.clear();
+                launch_options.replay_file.clear();
+                launch_options.replay_fast = false;
+                launch_options.snapshot_file.clear();
+            }
+
+            // Continue from the snapshot, if it was saved before.
+            if (SnapshotFileExists())
+                LoadSnapshotFromFile(snapshot_file);
+        }
+
+        // Restarts the level in place. This is equivalent to constructing a new `World` without the launch options,
+        // but doesn't reload the map, and reuses the allocated memory.
+        void Reset()
+        {
+            reset_pending = false;
+
+            map.LoadSnapshot(initial_map);
+            time.Reset();
+            par.Clear();
+            par_timeless.Clear();
+
+            CopyPlainSnapshotMembers(*this, Snapshot{});
+            for (Hint &hint : hints)
+                hint.alpha = 0;
+            visible_hints.clear();
+
+            rng = Random::DefaultGenerator(NewSeed());
+
+            // The recording and replay only apply to the first level.
+            record_file.clear();
+            recording.seed = 0;
+            recording.frames.clear();
+            recording.hashes.clear();
+            replay.reset();
+            replay_pos = 0;
+            replay_fast = false;
+            benchmark = false;
+            replay_desync_tick.reset();
+            snapshot_file.clear();
+
+            StartLevel();
+            RememberPrevTickState();
+        }
+
+        // Hashes the simulation state, for `InputRecording::hashes`. Call at the start of a tick.
+        // Covers the player, the time cursor, the changed tiles, and the shots.
+        // Not the particles, nor `rng` which only feeds them: the spawn counts depend on the adaptive quality during the live play, while the replays always use the full quality.
+        [[nodiscard]] std::uint32_t ComputeStateHash() const
+        {
+            StateHash h;
+            h(p, time.time, time.shifting_now, time.shifting_speed, time.shifting_lag, time.positive_speed);
+            h(map.overlay_hash, map.num_secrets_taken, real_world_time);
+            h(std::span(shots.pos.data(), std::size_t(shots.count)), std::span(shots.vel.data(), std::size_t(shots.count)));
+            return h.Value32();
+        }
+
+        // Compares the state before the tick `pos` of the replay with the recorded hash, and remembers the first mismatch in `replay_desync_tick`.
+        // Unless this is a batch world, also reports it. The fast replays and the benchmarks exit with an error then, since their results would be meaningless.
+        void CheckReplayHash(std::size_t pos)
+        {
+            if (replay_desync_tick || pos >= replay->hashes.size())
+                return;
+            if (ComputeStateHash() == replay->hashes[pos])
+                return;
+
+            replay_desync_tick = pos;
+            if (context.batch)
+                return;
+            std::cout << FMT("Replay desync: the state before tick {} doesn't match the recording.\n", pos);
+            if (replay_fast || benchmark)
+                Program::Exit(1);
+        }
+
+        // Runs `ticks` ticks without rendering or audio, with the input from `get_input(int tick) -> Controls::Frame`.
+        // The sounds go to `context.sound_sink` if it's set, and are dropped otherwise.
+        // The batch worlds can call this on different threads at the same time.
+        // Stops early and returns false if the level is finished.
+        template <typename F>
+        bool SimulateHeadless(int ticks, F &&get_input)
+        {
+            headless = true;
+            // The sink is thread-local, so this doesn't affect the other threads.
+            Sounds::Sink old_sink = std::move(Sounds::sink);
+            if (context.sound_sink)
+                Sounds::sink = context.sound_sink;
+            else
+                Sounds::sink = [](std::string_view, std::optional<ivec2>, float, float) {};
+
+            bool ok = true;
+            for (int i = 0; i < ticks; i++)
+            {
+                con.SetScripted(get_input(i));
+                std::string next_state;
+                Tick(next_state);
+                if (!next_state.empty() || reset_pending)
+                {
+                    ok = false;
+                    break;
+                }
+            }
+
+            con.ResetScripted();
+            Sounds::sink = std::move(old_sink);
+            headless = false;
+            return ok;
+        }
+
+        // Lowers the particle quality when the frames take too long. The replays and the headless runs keep the full quality,
+        // since the particles use `rng`, and the spawn counts would make them depend on the frame times.
+        void UpdateParticleQuality()
+        {
+            const GameUtils::Profiler::Frame *frame = headless ? nullptr : profiler.LastFrame();
+            if (headless || replay || !context.adaptive_particle_quality || !frame)
+            {
+                par.ResetQuality();
+                par_timeless.ResetQuality();
+                return;
+            }
+
+            // With several ticks per frame, only count the frame once.
+            if (frame->begin == particle_quality_frame)
+                return;
+            particle_quality_frame = frame->begin;
+
+            double secs = frame->TopLevelZoneSecs("Tick") + frame->TopLevelZoneSecs("Render");
+            par.UpdateQuality(secs, particle_frame_budget_secs);
+            par_timeless.UpdateQuality(secs, particle_frame_budget_secs);
+        }
+
         void Tick(std::string &next_state) override
         {
+            if (!context.batch && seen_atlas_version != atlas_version)
+            {
+                seen_atlas_version = atlas_version;
+                window.FinishSwapBuffers(); // This frees the GPU buffers of the map chunks.
+                map.InvalidateRenderCache(); // It has the texture coordinates.
+            }
+            if (!context.batch && seen_map_version != map_version)
+            {
+                seen_map_version = map_version;
+                ReloadMap(); // This calls `Reset()`.
+            }
+
+            if (reset_pending)
+                Reset();
+
+            if (!headless)
+            {
+                if (!snapshot_file.empty())
+                {
+                    if (Input::Button(Input::f5).pressed())
+                        SaveSnapshotToFile(snapshot_file);
+                    else if (Input::Button(Input::f9).pressed() && SnapshotFileExists())
+                        LoadSnapshotFromFile(snapshot_file);
+                }
+
+                if (replay && replay_fast)
+                {
+                    // Play back the rest of the recording in one go, and exit.
+                    std::size_t num_ticks = replay->frames.size() - replay_pos;
+                    std::uint64_t start = Clock::Time();
+                    Program::AllocStats::Counters start_allocs = Program::AllocStats::Total();
+                    SimulateHeadless(int(num_ticks), [&](int i)
+                    {
+                        CheckReplayHash(replay_pos + std::size_t(i));
+                        return Controls::Frame::FromBits(replay->frames[replay_pos + std::size_t(i)]);
+                    });
+                    Program::AllocStats::Counters allocs = Program::AllocStats::Total() - start_allocs;
+                    double secs = Clock::TicksToSeconds(Clock::Time() - start);
+                    std::cout << FMT("Replayed {} ticks in {:.3f} s ({:.0f} ticks/s).\n", num_ticks, secs, num_ticks / secs);
+
+                    if constexpr (Program::AllocStats::enabled)
+                    {
+                        double allocs_per_tick = num_ticks ? allocs.allocs / double(num_ticks) : 0;
+                        std::cout << FMT("Heap allocations: {} ({:.2f} per tick, {:.1f} KiB total), peak usage {:.1f} MiB.\n",
+                            allocs.allocs, allocs_per_tick, allocs.bytes / 1024., Program::AllocStats::PeakLiveBytes() / 1024. / 1024.);
+                        if (launch_options.max_allocs_per_tick && allocs_per_tick > *launch_options.max_allocs_per_tick)
+                        {
+                            std::cout << FMT("FAILED: more than {} heap allocations per tick.\n", *launch_options.max_allocs_per_tick);
+                            Program::Exit(1);
+                        }
+                    }
+                    else if (launch_options.max_allocs_per_tick)
+                    {
+                        std::cout << "Can't check the heap allocations, build in the `count_allocs` mode.\n";
+                        Program::Exit(1);
+                    }
+                    Program::Exit();
+                }
+
+                if (replay)
+                {
+                    if (benchmark && replay_pos == 0)
+                        benchmark_recorder.Start();
+
+                    if (replay_pos < replay->frames.size())
+                    {
+                        CheckReplayHash(replay_pos);
+                        con.SetScripted(Controls::Frame::FromBits(replay->frames[replay_pos++]));
+                    }
+                    else
+                    {
+                        con.ResetScripted(); // The recording is over, switch to the live input.
+                        replay.reset();
+                        if (benchmark)
+                            benchmark_recorder.Stop(); // `Application` prints the report and exits at the end of the frame.
+                    }
+                }
+
+                if (!record_file.empty())
+                {
+                    recording.frames.push_back(con.CurrentFrame().ToBits());
+                    recording.hashes.push_back(ComputeStateHash());
+                    if (recording.frames.size() % (60 * 10) == 0)
+                        recording.Save(record_file); // Save periodically, since we don't get notified when the game is closed.
+                }
+            }
+
+            RememberPrevTickState();
+            UpdateParticleQuality();
+
+            Random::DefaultInterfaces<Random::DefaultGenerator> ra(rng);
+
             real_world_time++;
 
             constexpr float gravity = 0.1, low_jump_gravity = 0.3;
@@ -431,7 +1923,10 @@ namespace States
             bool positive_time_step_this_tick = false;
 
             // Timeless particles.
-            par_timeless.Tick(camera_pos);
+            {
+                GameUtils::Profiler::Scope scope(profiler, "Particles");
+                par_timeless.Tick(camera_pos);
+            }
 
             { // Gui. (should be nearly first)
                 // Abilities.
@@ -450,10 +1945,21 @@ namespace States
                         return increase;
                     };
 
-                    for (Hint &hint : hints)
+                    // The other hints have a zero alpha, and stay that way.
+                    constexpr ivec2 hint_dist(11); // Inclusive.
+                    hint_index.ForEachInRect(p.pos - hint_dist, p.pos + hint_dist, [&](std::size_t i)
+                    {
+                        if (hints[i].alpha <= 0)
+                            visible_hints.push_back(i);
+                    });
+                    std::sort(visible_hints.begin(), visible_hints.end());
+
+                    std::erase_if(visible_hints, [&](std::size_t i)
                     {
+                        Hint &hint = hints[i];
                         ProcessHint(hint.alpha, !p.dead && ((p.pos - hint.pos).abs() < 12).all());
-                    }
+                        return hint.alpha <= 0;
+                    });
 
                     if (ProcessHint(hint_death_hollback, !seen_hint_death_rollback && p.dead && have_timeshift_ability && time.RemainingShifts() > 0 && p.death_timer > 90) && time.shifting_now)
                         seen_hint_death_rollback = true;
@@ -463,6 +1969,8 @@ namespace States
             }
 
             { // Time.
+                GameUtils::Profiler::Scope scope(profiler, "Time");
+
                 bool timeshift_button_down = con.timeshift.down();
                 bool should_timeshift = time.shifting_now;
                 if (timeshift_button_down && !p.in_prison && have_timeshift_ability && (time.RemainingShifts() > 0 || time.shifting_now))
@@ -520,9 +2028,10 @@ namespace States
                     {
                         time.time++;
 
-                        time.AddGhostParticles(par_timeless);
+                        time.AddGhostParticles(par_timeless, ra);
 
                         // Particles.
+                        GameUtils::Profiler::Scope scope(profiler, "Particles");
                         par.Tick(camera_pos);
                     }
                 }
@@ -537,21 +2046,25 @@ namespace States
                     int num_shifts = time.shifting_lag;
                     time.shifting_lag -= num_shifts;
 
+                    int num_reverse_ticks = 0;
                     while (num_shifts-- > 0 && time.time > 0)
                     {
                         time.time--;
-                        time.AddGhostParticles(par_timeless);
-                        par.ReverseTick();
+                        time.AddGhostParticles(par_timeless, ra);
+                        num_reverse_ticks++;
                     }
+                    GameUtils::Profiler::Scope scope(profiler, "Particles");
+                    par.ReverseTick(num_reverse_ticks);
                 }
             }
 
+            EnforceHistoryBudget();
+
             { // Restore block state from the timeline.
-                for (const auto &[pos, break_time] : time.block_breaking_times)
+                time.UndoFutureBlockBreaks([&](ivec2 pos)
                 {
-                    if (time.time < break_time)
-                        map.at(pos).tile = map_orig.at(pos).tile;
-                }
+                    map.RestoreTile(pos);
+                });
             }
 
             // Player.
@@ -559,6 +2072,8 @@ namespace States
                 buffered_jump = true;
             if (positive_time_step_this_tick)
             {
+                GameUtils::Profiler::Scope scope(profiler, "Player");
+
                 constexpr float
                     max_speed_x = 4,
                     max_speed_y_up = 3,
@@ -574,9 +2089,11 @@ namespace States
 
                 { // Save to the timeline. (should be first?)
                     if (!p.in_prison)
-                        time.SavePlayer(p);
+                        time.SavePlayer(p, shots);
                 }
 
+                time.UpdateGhostGrids();
+
                 bool controllable = !p.dead && !p.in_prison;
 
                 // Status.
@@ -657,25 +2174,25 @@ namespace States
                         if (!can_jump && have_doublejump_ability && p.doublejump_recharged)
                         {
                             const Ghost *newest_ghost = time.FindNewestGhost();
-                            auto it = std::find_if(time.ghosts.begin(), time.ghosts.end(), [&](const Ghost &ghost)
+                            Ghost *target_ghost = nullptr;
+                            int target_rel_time = 0;
+                            time.ForEachGhostInBox(time.ghost_grid, p.pos - ghost_hitbox_halfsize + 1, p.pos + ghost_hitbox_halfsize, [&](Ghost &ghost, int rel_time)
                             {
-                                if (&ghost == newest_ghost)
-                                    return false;
-                                if (time.time < ghost.time_start)
-                                    return false;
-                                int rel_time = time.time - ghost.time_start;
-                                if (rel_time >= int(ghost.states.size()))
-                                    return false;
-                                const Player &state = ghost.states[rel_time];
+                                if (target_ghost || &ghost == newest_ghost)
+                                    return;
+                                Player state = ghost.State(rel_time);
                                 if (!state.VisibleAsGhost())
-                                    return false;
-                                return (abs(state.pos - p.pos) < ghost_hitbox_halfsize).all();
+                                    return;
+                                if ((abs(state.pos - p.pos) < ghost_hitbox_halfsize).all())
+                                {
+                                    target_ghost = &ghost;
+                                    target_rel_time = rel_time;
+                                }
                             });
 
-                            if (it != time.ghosts.end())
+                            if (target_ghost)
                             {
-                                for (std::size_t i = time.time - it->time_start; i < it->states.size(); i++)
-                                    it->states[i].dead = true;
+                                target_ghost->Kill(target_rel_time);
 
                                 can_jump = true;
                                 using_doublejump = true;
@@ -701,18 +2218,9 @@ namespace States
                             }
                             else
                             {
-                                for (int i = 0; i < 24; i++)
-                                {
-                                    constexpr float half_max_angle = f_pi / 3.2f;
-
-                                    fvec2 dir = fvec2::dir(f_pi/2 - half_max_angle <= ra.f <= f_pi/2 + half_max_angle);
-                                    float dist = ra.f <= 1;
-                                    float c = ra.f <= 1;
-                                    fvec3 color(1 - c * 0.5f, 1 - c * 0.25f, 0);
-                                    if (ra.boolean())
-                                        std::swap(color.x, color.z);
-                                    par.Add(adjust(Particle{}, s.pos = p.pos + (fvec2(-3, 6) <= ra.fvec2 <= fvec2(3, 10)), damp = 0.015, life = 20 <= ra.i <= 60, size = 1 <= ra.i <= 5, s.vel = dir * pow(dist, 1.9f) * 2, end_size = 1, color = color, beta = 0));
-                                }
+                                constexpr float half_max_angle = f_pi / 3.2f;
+                                par.Emit(ra, adjust(spark_emitter, offset_min = fvec2(-3, 6), offset_max = fvec2(3, 10), angle_min = f_pi/2 - half_max_angle, angle_max = f_pi/2 + half_max_angle,
+                                    speed_max = 2, speed_power = 1.9f), p.pos, 24);
                             }
                         }
                     }
@@ -726,19 +2234,16 @@ namespace States
                     }
 
                     // Shooting.
-                    if (have_gun_ability && con.shoot.pressed() && !p.shot)
+                    if (have_gun_ability && con.shoot.pressed() && shots.count < Player::max_shots)
                     {
                         int dir_x = p.facing_left ? -1 : 1;
-                        p.shot.emplace();
-                        p.shot->pos = p.pos + ivec2(8 * dir_x, -5);
-                        p.shot->vel = fvec2(2 * dir_x, 0);
+                        fvec2 shot_pos = p.pos + ivec2(8 * dir_x, -5);
+                        shots.Add(shot_pos, fvec2(2 * dir_x, 0));
                         Sounds::pew(0.65f);
 
-                        for (int i = 0; i < 20; i++)
-                        {
-                            fvec3 color(1, ra.f <= 1, 0);
-                            par.Add(adjust(Particle{}, s.pos = p.shot->pos + (ra.fvec2.abs() <= 2), damp = 0.01, life = 20 <= ra.i <= 40, size = 1 <= ra.i <= 5, s.vel = p.prev_vel.x * 0.4 + fvec2::dir(ra.f.abs() <= f_pi / 10, ra.f <= 2) with(x *= dir_x), end_size = 1, color = color));
-                        }
+                        float center_angle = dir_x < 0 ? f_pi : 0;
+                        par.Emit(ra, adjust(dust_emitter, offset_min = fvec2(-2), offset_max = fvec2(2), angle_min = center_angle - f_pi / 10, angle_max = center_angle + f_pi / 10, speed_max = 2),
+                            shot_pos, 20, fvec2(p.prev_vel.x * 0.4f));
                     }
                 }
 
@@ -754,32 +2259,23 @@ namespace States
                 // Interaction with ghost shots.
                 if (controllable)
                 {
-                    for (Ghost &ghost : time.ghosts)
+                    time.ForEachGhostInBox(time.shot_grid, p.pos - Player::shot_hitbox_halfsize, p.pos + Player::shot_hitbox_halfsize, [&](Ghost &ghost, int rel_time)
                     {
-                        if (time.time < ghost.time_start)
-                            continue;
-                        int rel_time = time.time - ghost.time_start;
-                        if (rel_time >= int(ghost.states.size()))
-                            continue;
-                        Player &state = ghost.states[rel_time];
-                        if (!state.shot)
-                            continue;
-                        if ((abs(state.shot->pos - p.pos) < Player::shot_hitbox_halfsize).all())
+                        ghost.ForEachShotAt(rel_time, [&](std::size_t i)
                         {
-                            Sounds::push();
+                            const GhostShot &shot = ghost.shots[i];
+                            if ((abs(shot.PosAt(rel_time) - p.pos) < Player::shot_hitbox_halfsize).all())
+                            {
+                                Sounds::push();
 
-                            p.boost_vel = state.shot->vel.norm() * 4;
-                            p.remaining_boost_frames = 190;
+                                p.boost_vel = shot.vel.norm() * 4;
+                                p.remaining_boost_frames = 190;
 
-                            // Erase this shot from the future.
-                            for (std::size_t i = rel_time; i < ghost.states.size(); i++)
-                            {
-                                if (!ghost.states[i].shot)
-                                    break;
-                                ghost.states[i].shot.reset();
+                                // Erase this shot from the future.
+                                ghost.EraseShot(i, rel_time);
                             }
-                        }
-                    }
+                        });
+                    });
                 }
 
                 // Apply velocity.
@@ -793,14 +2289,7 @@ namespace States
 
                             p.facing_left = p.vel.x < 0;
 
-                            for (int i = 0; i < 4; i++)
-                            {
-                                float c = ra.f <= 1;
-                                fvec3 color(1 - c * 0.5f, 1 - c * 0.25f, 0);
-                                if (ra.boolean())
-                                    std::swap(color.x, color.z);
-                                par.Add(adjust(Particle{}, s.pos = p.pos + (ra.fvec2.abs() <= fvec2(4, 6)), damp = 0.015, life = 20 <= ra.i <= 60, size = 1 <= ra.i <= 3, s.vel = fvec2::dir(ra.angle(), 0.15f), end_size = 1, color = color, beta = 0));
-                            }
+                            par.Emit(ra, adjust(spark_emitter, offset_min = -fvec2(4, 6), offset_max = fvec2(4, 6), speed_min = 0.15, speed_max = 0.15, size_max = 3), p.pos, 4);
                         }
                     }
 
@@ -816,32 +2305,65 @@ namespace States
 
                     p.vel_lag *= 1 - vel_lag_damp;
 
-                    while (int_vel)
+                    // Stops the movement along axis `i` in direction `s`.
+                    auto BlockAxis = [&](int i, int s)
+                    {
+                        hit_something = true;
+                        int_vel[i] = 0;
+                        if (p.vel[i] * s > 0)
+                            p.vel[i] = 0;
+                        if (p.vel_lag[i] * s > 0)
+                            p.vel_lag[i] = 0;
+                    };
+
+                    if (p.SolidAtOffset(map, ivec2(0)))
                     {
-                        for (int i = 0; i < 2; i++)
+                        // We're inside a solid tile (e.g. one that came back when rewinding), and `SweepBox()` ignores those.
+                        // Step one pixel at a time instead, only into the free positions, so we can't walk through it.
+                        while (int_vel)
                         {
-                            if (int_vel[i] == 0)
-                                continue;
+                            for (int i = 0; i < 2; i++)
+                            {
+                                if (int_vel[i] == 0)
+                                    continue;
 
-                            int s = sign(int_vel[i]);
-                            int_vel[i] -= s;
+                                int s = sign(int_vel[i]);
+                                int_vel[i] -= s;
 
-                            ivec2 offset;
-                            offset[i] = s;
+                                ivec2 offset;
+                                offset[i] = s;
 
-                            if (!p.SolidAtOffset(map, offset))
-                            {
-                                p.pos[i] += s;
+                                if (!p.SolidAtOffset(map, offset))
+                                    p.pos[i] += s;
+                                else
+                                    BlockAxis(i, s);
                             }
-                            else
+                        }
+                    }
+                    else
+                    {
+                        // Sweep the hitbox, and slide along the surfaces we hit. Two iterations are enough, since each one blocks an axis.
+                        for (int iteration = 0; iteration < 2 && int_vel; iteration++)
+                        {
+                            Map::SweepResult sweep = map.SweepBox(p.pos + Player::box_a, p.pos + Player::box_b, int_vel);
+
+                            // Round towards zero, to stay at or before the contact point.
+                            ivec2 int_move = sweep.hit ? ivec2(int_vel * sweep.time) : int_vel;
+                            // Rounding can move us off the sweep line and into a tile corner. Then only move along the hit axis, or not at all.
+                            if (int_move && p.SolidAtOffset(map, int_move))
                             {
-                                hit_something = true;
-                                int_vel[i] = 0;
-                                if (p.vel[i] * s > 0)
-                                    p.vel[i] = 0;
-                                if (p.vel_lag[i] * s > 0)
-                                    p.vel_lag[i] = 0;
+                                int_move = int_move * abs(sweep.normal);
+                                if (int_move && p.SolidAtOffset(map, int_move))
+                                    int_move = ivec2(0);
                             }
+                            p.pos += int_move;
+                            int_vel -= int_move;
+
+                            if (!sweep.hit)
+                                break;
+
+                            int i = sweep.normal.x ? 0 : 1;
+                            BlockAxis(i, -sweep.normal[i]);
                         }
                     }
 
@@ -858,16 +2380,7 @@ namespace States
                             return false;
                         if (p.ground && (abs(*ability - p.pos) < ivec2(6,10)).all())
                         {
-                            for (int i = 0; i < 24; i++)
-                            {
-                                fvec2 dir = fvec2::dir(ra.angle());
-                                float dist = ra.f <= 1;
-                                float c = ra.f <= 1;
-                                fvec3 color(1 - c * 0.5f, 1 - c * 0.25f, 0);
-                                if (ra.boolean())
-                                    std::swap(color.x, color.z);
-                                par_timeless.Add(adjust(Particle{}, s.pos = *ability + dir * dist * 6, damp = 0.005, life = 20 <= ra.i <= 60, size = 1 <= ra.i <= 7, s.vel = dir * dist * 0.35, end_size = 1, color = color, beta = 0));
-                            }
+                            par_timeless.Emit(ra, adjust(spark_emitter, radius = fvec2(6), speed_max = 0.35, damp = 0.005, size_max = 7), *ability, 24);
                             ability.reset();
                             Sounds::got_item();
                             ability_timer = 1;
@@ -885,93 +2398,72 @@ namespace States
                     if (PickUpAbility(map.ability_gun, "Fireball", "Press [X]/[K] to shoot\nTouch your past shot to get a boost"))
                         have_gun_ability = true;
 
-                    for (auto it = map.secrets.begin(); it != map.secrets.end();)
+                    if (p.ground)
                     {
-                        if (p.ground && (abs(*it - p.pos) < ivec2(6,10)).all())
+                        constexpr ivec2 pick_up_dist(5,9); // Inclusive.
+                        map.secrets->ForEachInRect(p.pos - pick_up_dist, p.pos + pick_up_dist, [&](std::size_t i)
                         {
-                            for (int i = 0; i < 24; i++)
-                            {
-                                fvec2 dir = fvec2::dir(ra.angle());
-                                float dist = ra.f <= 1;
-                                float c = ra.f <= 1;
-                                fvec3 color(1 - c * 0.5f, 1 - c * 0.25f, 0);
-                                if (ra.boolean())
-                                    std::swap(color.x, color.z);
-                                par_timeless.Add(adjust(Particle{}, s.pos = *it + dir * dist * 2, damp = 0.005, life = 20 <= ra.i <= 60, size = 1 <= ra.i <= 3, s.vel = dir * dist * 0.35, end_size = 1, color = color, beta = 0));
-                            }
+                            if (map.secret_taken[i])
+                                return;
+
+                            ivec2 pos = map.secrets->Points()[i];
+                            par_timeless.Emit(ra, adjust(spark_emitter, radius = fvec2(2), speed_max = 0.35, damp = 0.005, size_max = 3), pos, 24);
                             Sounds::got_item();
 
-                            if (int(map.secrets.size()) == map.num_secrets)
+                            if (map.num_secrets_taken == 0)
                             {
                                 ability_timer = 1;
                                 ability_message = "Found a secret!";
                                 ability_message2 = "";
                             }
 
-                            it = map.secrets.erase(it);
-                            continue;
-                        }
-
-                        it++;
+                            map.secret_taken[i] = true;
+                            map.num_secrets_taken++;
+                        });
                     }
                 }
 
-                { // Tick the shot.
-                    if (p.shot)
-                    {
-                        p.shot->pos += p.shot->vel;
-                        ivec2 round_pos = iround(p.shot->pos);
+                { // Tick the shots.
+                    for (int i = 0; i < shots.count; i++)
+                        shots.pos[i] += shots.vel[i];
 
-                        std::set<ivec2> breaking_tiles;
-                        bool dies = false;
+                    // Most shots don't touch anything, so check the solidity bits first, and look at the tiles only on a hit.
+                    // In the descending order, so the swap-removal doesn't skip any shots.
+                    for (int i = shots.count; i-- > 0;)
+                    {
+                        ivec2 round_pos = iround(shots.pos[i]);
+                        if (!map.AnySolidAtPixels(round_pos, Projectiles::hitbox))
+                            continue; // The breakable tiles are solid too.
 
-                        for (ivec2 point : p.shot->hitbox)
+                        FlatSet<ivec2> breaking_tiles;
+                        for (ivec2 point : Projectiles::hitbox)
                         {
                             ivec2 tile_pos = div_ex(round_pos + point, tile_size);
-                            const TileInfo &info = map.at(tile_pos).info();
-                            if (info.breakable)
-                            {
+                            if (map.at(tile_pos).info().breakable)
                                 breaking_tiles.insert(tile_pos);
-                                dies = true;
-                            }
-                            else if (info.solid)
-                            {
-                                dies = true;
-                            }
                         }
 
-                        if (!breaking_tiles.empty())
+                        for (ivec2 tile : breaking_tiles)
                         {
-                            for (ivec2 tile : breaking_tiles)
+                            if (map.cells.pos_in_range(tile))
                             {
-                                if (map.cells.pos_in_range(tile))
-                                {
-                                    map.at(tile).tile = Tile::air;
-                                    time.block_breaking_times[tile] = time.time;
-
-                                    for (int i = 0; i < 15; i++)
-                                    {
-                                        fvec3 color(1, ra.f <= 1, 0);
-                                        par.Add(adjust(Particle{}, s.pos = tile * tile_size + (ra.fvec2 <= tile_size), s.acc = fvec2(0,0.01f), damp = 0.01, life = 20 <= ra.i <= 40, size = 1 <= ra.i <= 5, s.vel = fvec2::dir(ra.angle(), ra.f <= 0.23f), end_size = 1, color = color));
-                                    }
-                                }
+                                map.SetTile(tile, Tile::air);
+                                time.BreakBlock(tile);
+
+                                par.Emit(ra, adjust(dust_emitter, offset_max = fvec2(tile_size), acc = fvec2(0, 0.01f), speed_max = 0.23f), tile * tile_size, 15);
                             }
                         }
-                        if (dies)
-                        {
-                            if (breaking_tiles.empty())
-                                Sounds::shot_dies(p.shot->pos, 0.4f);
-                            else
-                                Sounds::shot_breaks_block(p.shot->pos);
 
-                            for (int i = 0; i < 10; i++)
-                            {
-                                fvec3 color(1, ra.f <= 1, 0);
-                                par.Add(adjust(Particle{}, s.pos = p.shot->pos + (ra.fvec2.abs() <= 2), damp = 0.01, life = 20 <= ra.i <= 40, size = 1 <= ra.i <= 5, s.vel = fvec2::dir(ra.f.abs() <= f_pi / 2, ra.f <= 1.3f) with(x *= -sign(p.shot->vel.x)), end_size = 1, color = color));
-                            }
+                        if (breaking_tiles.empty())
+                            Sounds::shot_dies(shots.pos[i], 0.4f);
+                        else
+                            Sounds::shot_breaks_block(shots.pos[i]);
 
-                            p.shot.reset();
-                        }
+                        // Bounce back from the wall.
+                        float center_angle = shots.vel[i].x > 0 ? f_pi : 0;
+                        par.Emit(ra, adjust(dust_emitter, offset_min = fvec2(-2), offset_max = fvec2(2), angle_min = center_angle - f_pi / 2, angle_max = center_angle + f_pi / 2, speed_max = 1.3f), shots.pos[i], 10);
+
+                        shots.RemoveUnordered(i);
                     }
                 }
 
@@ -998,13 +2490,8 @@ namespace States
 
                     if (t > 0)
                     {
-                        for (int i = 0; i < 4; i++)
-                        {
-                            fvec2 dir = fvec2::dir(ra.angle());
-                            float dist = ra.f <= 1;
-                            fvec3 color(1, ra.f <= 1, 0);
-                            par.Add(adjust(Particle{}, s.pos = p.pos + dir * dist * fvec2(8, 12), damp = 0, life = 60 <= ra.i <= 180, size = 1 <= ra.i <= 1+t*7, s.vel = dir * dist * pow(1 - t, 1.5) * 4 + p.prev_vel * 0.05, end_size = 1, color = color));
-                        }
+                        par.Emit(ra, adjust(dust_emitter, radius = fvec2(8, 12), speed_max = pow(1 - t, 1.5f) * 4, damp = 0, life_min = 60, life_max = 180, size_max = int(1 + t * 7)),
+                            p.pos, 4, p.prev_vel * 0.05f);
                     }
                 }
 
@@ -1061,7 +2548,7 @@ namespace States
             else if (time.shifting_now)
             {
                 // Try restoring the state from timeline.
-                if (const Player *state = time.FindNewestState())
+                if (std::optional<Player> state = time.FindNewestState(shots))
                     p = *state;
 
                 buffered_jump = false;
@@ -1074,7 +2561,7 @@ namespace States
                 {
                     clamp_var_max(fade += 0.01f);
                     if (fade >= 1)
-                        next_state = "World{}";
+                        reset_pending = true;
                 }
                 else
                 {
@@ -1085,7 +2572,10 @@ namespace States
                 exit_fade = clamp((map.exit_level - p.pos.y) / 300.f);
                 if (exit_fade > 0.999f)
                     next_state = FMT("Ending{{bg_color={},vignette_alpha={},cur_secrets={},max_secrets={},time={},time_sub={}}}",
-                        Refl::ToString(sky_color2), vignette_alpha, map.num_secrets - int(map.secrets.size()), map.num_secrets, real_world_time, time.time);
+                        Refl::ToString(sky_color2), vignette_alpha, map.num_secrets_taken, map.num_secrets, real_world_time, time.time);
+
+                if ((!next_state.empty() || reset_pending) && !record_file.empty())
+                    recording.Save(record_file);
 
                 // Logo.
                 if (p.prison_hp_left <= 1)
@@ -1095,36 +2585,46 @@ namespace States
             { // Camera.
                 camera_pos = p.pos;
 
-                float audio_dist = 3;
+                if (!headless)
+                {
+                    float audio_dist = 3;
 
-                Audio::Source::DefaultRefDistance(screen_size.x * audio_dist);
-                Audio::ListenerPosition(fvec3(0, 0, -screen_size.x * audio_dist));
-                Audio::ListenerOrientation(fvec3(0, 0, 1), fvec3(0, -1, 0));
+                    Audio::Source::DefaultRefDistance(screen_size.x * audio_dist);
+                    Audio::ListenerPosition(fvec3(0, 0, -screen_size.x * audio_dist));
+                    Audio::ListenerOrientation(fvec3(0, 0, 1), fvec3(0, -1, 0));
+                }
             }
         }
 
         void Render() const override
         {
+            // Those are interpolated between the ticks.
+            ivec2 render_camera_pos = iround(InterpolateRenderPos(prev_tick.camera_pos, camera_pos));
+            ivec2 player_pos = iround(InterpolateRenderPos(prev_tick.player_pos, p.pos));
+
+            static WorldEffects effects;
+
+            post_process.Begin();
             Graphics::SetClearColor(fvec3(0));
             Graphics::Clear();
 
             r.BindShader();
 
-            { // Background.
-                static const auto &bg_region = texture_atlas.Get("bg.png");
+            gpu_timers.Measure(gpu_timers.background, [&]{ // Background.
+                const auto &bg_region = texture_atlas.Get<"bg.png">();
 
                 constexpr float bg_speed_factor = 0.5f;
-                ivec2 bg_camera_pos = iround(camera_pos * bg_speed_factor);
+                ivec2 bg_camera_pos = iround(render_camera_pos * bg_speed_factor);
 
-                ivec2 corner_a = div_ex(bg_camera_pos - screen_size / 2, bg_region.size);
-                ivec2 corner_b = div_ex(bg_camera_pos + screen_size / 2, bg_region.size);
-                for (ivec2 tile_pos : corner_a <= vector_range <= corner_b)
-                {
-                    r.iquad(tile_pos * bg_region.size - bg_camera_pos, bg_region);
-                }
-            }
+                r.tiled_quad(-screen_size / 2, screen_size, bg_region, bg_camera_pos - screen_size / 2);
+            });
+
+            // The sprites between the background and the map. Their draw order is decided by the layers, not by the order in the code.
+            enum Layer {layer_fade, layer_prison, layer_powerups, layer_shots, layer_ghosts, layer_player, layer_lava};
+            r.BeginLayers();
 
             { // Fade (exit, bottom).
+                r.SetLayer(layer_fade);
                 if (exit_fade > 0.001f)
                 {
                     float alpha1 = clamp(Math::linear_mapping<float>(0   , 0.75, 0.f, 1.f)(exit_fade * 0.3f));
@@ -1139,10 +2639,11 @@ namespace States
             }
 
             { // Prison.
-                static const auto &region = texture_atlas.Get("prison.png");
+                r.SetLayer(layer_prison);
+                const auto &region = texture_atlas.Get<"prison.png">();
                 static const ivec2 size = region.size with(y /= 2);
 
-                ivec2 prison_pos = map.player_start - camera_pos;
+                ivec2 prison_pos = map.player_start - render_camera_pos;
                 if ((abs(prison_pos) <= (screen_size + size) / 2).all())
                 {
                     r.iquad(prison_pos + prison_sprite_offset * (prison_anim_timer > 0), region.region(ivec2(0, size.y * !p.in_prison), size)).center();
@@ -1150,8 +2651,9 @@ namespace States
             }
 
             { // Abilities and secrets.
-                static const auto &reg_ability = texture_atlas.Get("ability.png");
-                static const auto &reg_secret = texture_atlas.Get("secret.png");
+                r.SetLayer(layer_powerups);
+                const auto &reg_ability = texture_atlas.Get<"ability.png">();
+                const auto &reg_secret = texture_atlas.Get<"secret.png">();
 
                 constexpr int offset_array[] = {0, -1, -1, -1, 0, 1, 1, 1};
                 constexpr int offset_len = 20;
@@ -1161,7 +2663,7 @@ namespace States
                 {
                     if (!pos)
                         return;
-                    ivec2 screen_pos = *pos - camera_pos;
+                    ivec2 screen_pos = *pos - render_camera_pos;
                     if ((abs(screen_pos) > screen_size / 2 + 16).any())
                         return;
 
@@ -1171,62 +2673,77 @@ namespace States
                 DrawPowerup(reg_ability, map.ability_doublejump);
                 DrawPowerup(reg_ability, map.ability_gun);
 
-                for (ivec2 pos : map.secrets)
-                    DrawPowerup(reg_secret, std::optional(pos));
+                // The culling margin of `DrawPowerup()`.
+                ivec2 visible_dist = screen_size / 2 + 16;
+                map.secrets->ForEachInRect(render_camera_pos - visible_dist, render_camera_pos + visible_dist, [&](std::size_t i)
+                {
+                    if (!map.secret_taken[i])
+                        DrawPowerup(reg_secret, map.secrets->Points()[i]);
+                });
             }
 
             { // Shots.
-                static const auto &region = texture_atlas.Get("shot.png");
+                r.SetLayer(layer_shots);
+                const auto &region = texture_atlas.Get<"shot.png">();
                 static const int size = region.size.y;
 
-                if (p.shot)
+                for (int i = 0; i < shots.count; i++)
                 {
-                    fvec2 rel_pos = p.shot->pos - camera_pos;
-                    if ((rel_pos <= screen_size / 2 + 16).all())
-                        r.fquad(rel_pos, region.region(ivec2(size * Shot::GetAnimVariant(time.time), 0), ivec2(size))).center().flip_x(p.shot->vel.x < 0);
+                    fvec2 rel_pos = InterpolateRenderPos(shots.prev_pos[i], shots.pos[i]) - render_camera_pos;
+                    if ((abs(rel_pos) <= screen_size / 2 + 16).all())
+                        r.fquad(rel_pos, region.region(ivec2(size * Projectiles::GetAnimVariant(time.time), 0), ivec2(size))).center().flip_x(shots.vel[i].x < 0);
                 }
             }
 
             { // Player ghosts.
-                time.RenderGhosts(camera_pos);
+                // They use a custom shader, so everything below them is drawn first.
+                r.SubmitLayersBelow(layer_ghosts);
+                time.RenderGhosts(render_camera_pos, prev_tick.time);
             }
 
             { // Player.
-                static const auto &pl_region = texture_atlas.Get("player.png");
+                r.SetLayer(layer_player);
+                const auto &pl_region = texture_atlas.Get<"player.png">();
                 constexpr ivec2 pl_size(36);
 
                 float alpha = p.in_prison ? 0 : clamp_min(1 - p.death_timer / 10.f);
 
                 if (alpha > 0.001f)
-                    r.iquad(p.pos - camera_pos, pl_region.region(pl_size * ivec2(p.anim_variant, p.anim_state), pl_size)).center().flip_x(p.facing_left).alpha(alpha);
+                    r.iquad(player_pos - render_camera_pos, pl_region.region(pl_size * ivec2(p.anim_variant, p.anim_state), pl_size)).center().flip_x(p.facing_left).alpha(alpha);
             }
 
             { // Lava.
-                static const auto &lava_region = texture_atlas.Get("lava.png");
+                r.SetLayer(layer_lava);
+                const auto &lava_region = texture_atlas.Get<"lava.png">();
 
                 int anim_x = time.time / 4 % lava_region.size.x;
 
                 // Repeating top part.
-                int x = div_ex(camera_pos.x - screen_size.x / 2 + anim_x, lava_region.size.x) * lava_region.size.x;
-                for (; x < camera_pos.x + anim_x + screen_size.x / 2; x += lava_region.size.x)
-                    r.iquad(ivec2(x, p.lava_y) - camera_pos with(x += anim_x), lava_region);
+                r.tiled_quad(ivec2(-screen_size.x / 2, p.lava_y - render_camera_pos.y), ivec2(screen_size.x, lava_region.size.y), lava_region, ivec2(render_camera_pos.x + anim_x - screen_size.x / 2, 0));
 
                 // Bottom part as one large rect.
-                int bottom_y = p.lava_y + lava_region.size.y - camera_pos.y;
+                int bottom_y = p.lava_y + lava_region.size.y - render_camera_pos.y;
                 if (bottom_y < screen_size.y / 2)
                     r.iquad(ivec2(-screen_size.x/2, bottom_y), screen_size/2).absolute().tex(lava_region.pos + fvec2(0.5, lava_region.size.y - 0.5), fvec2());
             }
 
+            r.EndLayers();
+
             // Map.
-            map.render(camera_pos);
+            gpu_timers.Measure(gpu_timers.map, [&]{
+                GameUtils::Profiler::Scope scope(profiler, "Map::render");
+                map.render(render_camera_pos);
+            });
 
-            // Timeless particles.
-            par_timeless.Render(camera_pos);
+            gpu_timers.Measure(gpu_timers.particles, [&]{
+                // Timeless particles.
+                par_timeless.Render(render_camera_pos);
 
-            // Particles.
-            par.Render(camera_pos);
+                // Particles.
+                par.Render(render_camera_pos);
+            });
 
-            { // Time machine.
+            gpu_timers.Measure(gpu_timers.time_machine, [&]{ // Time machine.
                 constexpr int num_rays = 64;
                 static const float
                     dist_min = 192,
@@ -1240,26 +2757,34 @@ namespace States
                     float alpha2 = t * 0.7f;
 
                     constexpr int maxdelta = 2;
+                    static_assert(maxdelta * 2 + 1 == WorldEffects::num_ray_groups);
 
                     float rot_speed = clamp_max((time.shifting_now ? time.shifting_speed : time.positive_speed), 0.7f);
 
-                    float height = 1;
-
+                    float ray_angles[WorldEffects::num_ray_groups];
+                    fvec3 ray_colors[WorldEffects::num_ray_groups];
                     for (int delta = -maxdelta; delta <= maxdelta; delta++)
                     {
                         fvec3 color(1 - delta / 4.f, 1 - delta / 12.f, 0);
                         if (delta > 0)
                             std::swap(color.x, color.z);
 
-                        for (int i = 0; i < num_rays; i++)
-                        {
-                            float angle = time.time * 0.001f - delta * rot_speed * 0.003f + i * 2 * f_pi / num_rays;
-
-                            r.fquad(fvec2(), fvec2(dist_max - dist_min, height)).center(fvec2(-dist_min, height/2)).rotate(angle).color(color).alpha(alpha1, alpha2, alpha2, alpha1).beta(0);
-                        }
+                        // Reduce the angle, since the float precision is worse in the shader.
+                        ray_angles[delta + maxdelta] = std::fmod(time.time * 0.001f - delta * rot_speed * 0.003f, 2 * f_pi / num_rays);
+                        ray_colors[delta + maxdelta] = color;
                     }
+
+                    effects.time_machine_uni.ray_angles.set(ray_angles, WorldEffects::num_ray_groups);
+                    effects.time_machine_uni.ray_colors.set(ray_colors, WorldEffects::num_ray_groups);
+                    effects.time_machine_uni.ray_step = 2 * f_pi / num_rays;
+                    effects.time_machine_uni.ray_dist = fvec2(dist_min, dist_max);
+                    effects.time_machine_uni.ray_alpha = fvec2(alpha1, alpha2);
+
+                    r.Finish();
+                    r.BindSharedUniforms();
+                    post_process.Apply(effects.time_machine);
                 }
-            }
+            });
 
             { // Gui
                 { // HUD.
@@ -1269,19 +2794,21 @@ namespace States
                         int remaining = time.RemainingShifts();
                         float alpha = smoothstep(clamp_max(time_since_got_timeshift / 60.f));
 
-                        Graphics::Text text(Fonts::main, FMT("{}", remaining));
+                        Strings::InlineString<16> text;
+                        FMT_TO(text, "{}", remaining);
                         for (int i = 0; i < 4; i++)
-                            r.itext(ivec2(0, -screen_size.y/2) + ivec2::dir4(i), text).align(ivec2(0,-1)).alpha(alpha).color(fvec3(0));
-                        r.itext(ivec2(0, -screen_size.y/2), text).align(ivec2(0,-1)).alpha(alpha).color(remaining == 0 ? fvec3(1, window.Ticks() / 60 % 2, 0) : fvec3(255, 179, 26) / 255);
+                            r.ictext(text_cache, ivec2(0, -screen_size.y/2) + ivec2::dir4(i), Fonts::main, text).align(ivec2(0,-1)).alpha(alpha).color(fvec3(0));
+                        r.ictext(text_cache, ivec2(0, -screen_size.y/2), Fonts::main, text).align(ivec2(0,-1)).alpha(alpha).color(remaining == 0 ? fvec3(1, window.Ticks() / 60 % 2, 0) : fvec3(255, 179, 26) / 255);
                     }
 
                     // Remaining secrets.
-                    if (int(map.secrets.size()) < map.num_secrets)
+                    if (map.num_secrets_taken > 0)
                     {
-                        Graphics::Text text(Fonts::main, FMT("{}/{}", map.num_secrets - int(map.secrets.size()), map.num_secrets));
+                        Strings::InlineString<32> text;
+                        FMT_TO(text, "{}/{}", map.num_secrets_taken, map.num_secrets);
                         for (int i = 0; i < 4; i++)
-                            r.itext(ivec2(screen_size.x/2 - 1, -screen_size.y/2) + ivec2::dir4(i), text).align(ivec2(1,-1)).alpha(1).color(fvec3(0));
-                        r.itext(ivec2(screen_size.x/2 - 1, -screen_size.y/2), text).align(ivec2(1,-1)).alpha(1).color(fvec3(102, 252, 255) / 255);
+                            r.ictext(text_cache, ivec2(screen_size.x/2 - 1, -screen_size.y/2) + ivec2::dir4(i), Fonts::main, text).align(ivec2(1,-1)).alpha(1).color(fvec3(0));
+                        r.ictext(text_cache, ivec2(screen_size.x/2 - 1, -screen_size.y/2), Fonts::main, text).align(ivec2(1,-1)).alpha(1).color(fvec3(102, 252, 255) / 255);
                     }
                 }
 
@@ -1291,19 +2818,18 @@ namespace States
                         if (t < 0.001f)
                             return;
 
-                        Graphics::Text text(Fonts::main, message);
                         float alpha = smoothstep(clamp(t));
 
                         for (int i = 0; i < 4; i++)
-                            r.itext(ivec2(0, screen_size.y/2 - 1) + ivec2::dir4(i), text).align_y(1).alpha(alpha).color(fvec3(0));
-                        r.itext(ivec2(0, screen_size.y/2 - 1), text).align_y(1).alpha(alpha).color(fvec3(255, 179, 26) / 255);
+                            r.ictext(text_cache, ivec2(0, screen_size.y/2 - 1) + ivec2::dir4(i), Fonts::main, message).align_y(1).alpha(alpha).color(fvec3(0));
+                        r.ictext(text_cache, ivec2(0, screen_size.y/2 - 1), Fonts::main, message).align_y(1).alpha(alpha).color(fvec3(255, 179, 26) / 255);
                     };
 
                     ShowHint("Hold [Z]/[L] to travel back in time", hint_death_hollback);
                     ShowHint("Press [C]/[J]/[Space] to jump", hint_jump);
 
-                    for (const Hint &hint : hints)
-                        ShowHint(hint.message, hint.alpha);
+                    for (std::size_t i : visible_hints)
+                        ShowHint(hints[i].message, hints[i].alpha);
                 }
             }
 
@@ -1334,26 +2860,26 @@ namespace States
                 float fin_text_alpha = 1 - clamp((ability_timer - (ability_anim_len - 60)) / 30.f);
                 float fin_bg_alpha = 1 - clamp((ability_timer - (ability_anim_len - 30)) / 30.f);
 
-                ivec2 text_size = Graphics::Text(Fonts::main, ability_message).ComputeStats().size;
-                Graphics::Text text(Fonts::main, ability_message.substr(0, clamp_min((ability_timer - first_line_time) / ticks_per_letter)));
-                Graphics::Text text2(Fonts::main, ability_message2);
+                ivec2 text_size = Graphics::Text(Fonts::main, ability_message, &frame_arena).ComputeStats().size;
+                Graphics::Text text(Fonts::main, std::string_view(ability_message).substr(0, clamp_min((ability_timer - first_line_time) / ticks_per_letter)), &frame_arena);
+                Graphics::Text text2(Fonts::main, ability_message2, &frame_arena);
 
                 r.iquad(ivec2(0, 0), ivec2(max(text_size.x, text2.ComputeStats().size.x) + 12, ability_message2.empty() ? 32 : 64)).color(fvec3(0)).center().alpha(smoothstep(clamp((ability_timer - bg_time) / 30.f) * fin_bg_alpha));
-                r.itext(-text_size/2 + ivec2(0, ability_message2.empty() ? 8 : -8), text).align_x(-1).color(ability_message2.empty() ? fvec3(102, 252, 255) / 255 : fvec3(255, 179, 26) / 255).alpha(fin_text_alpha);
+                r.itext(-text_size/2 + ivec2(0, ability_message2.empty() ? 8 : -8), std::move(text)).align_x(-1).color(ability_message2.empty() ? fvec3(102, 252, 255) / 255 : fvec3(255, 179, 26) / 255).alpha(fin_text_alpha);
 
                 int second_line_time = first_line_time + int(ability_message.size()) * ticks_per_letter + 30;
 
                 if (ability_timer > second_line_time)
-                    r.itext(ivec2(0, 12), text2).alpha(clamp_max((ability_timer - second_line_time) / 60.f) * fin_text_alpha).color(fvec3(255, 76, 5) / 255);
+                    r.itext(ivec2(0, 12), std::move(text2)).alpha(clamp_max((ability_timer - second_line_time) / 60.f) * fin_text_alpha).color(fvec3(255, 76, 5) / 255);
             }
 
             { // Menu logo and author info.
                 if (logo_alpha > 0.001f)
                 {
-                    static const auto &region = texture_atlas.Get("logo.png");
+                    const auto &region = texture_atlas.Get<"logo.png">();
                     r.iquad(ivec2(0, -52), region).center().alpha(smoothstep(logo_alpha));
 
-                    r.itext(ivec2(0, screen_size.y/2 - 28), Graphics::Text(Fonts::main, FMT("by HolyBlackCat for LD50, v1.{}", build_number)))
+                    r.ictext(text_cache, ivec2(0, screen_size.y/2 - 28), Fonts::main, FMT("by HolyBlackCat for LD50, v1.{}", build_number))
                         .color(fvec3(143,0,0)/255).beta(0).alpha(0.361f * smoothstep(logo_alpha));
                 }
             }
@@ -1363,12 +2889,321 @@ namespace States
                     r.iquad(ivec2(), screen_size).center().color(fvec3(0)).alpha(smoothstep(fade));
             }
 
-            { // Vignette.
-                static const auto &region = texture_atlas.Get("vignette.png");
-                r.iquad(ivec2(), region).alpha(vignette_alpha).center();
+            GameUtils::Profiler::Scope scope(profiler, "Render::Finish");
+            r.Finish();
+
+            { // Vignette, and the output to the viewport.
+                const auto &region = texture_atlas.Get<"vignette.png">();
+                effects.vignette_uni.atlas = texture_main;
+                effects.vignette_uni.atlas_size = texture_main.Size();
+                effects.vignette_uni.region_pos = region.pos;
+                effects.vignette_uni.region_size = region.size;
+                effects.vignette_uni.alpha = vignette_alpha;
+
+                r.BindSharedUniforms();
+                post_process.Apply(effects.vignette, &adaptive_viewport.GetFrameBuffer());
             }
+        }
+    };
 
-            r.Finish();
+    // Finds the scaling limits. For each subsystem, keeps doubling its load in a fresh world on a generated map, until the frame time exceeds the budget.
+    // Prints the time per tick and per frame for each step, then exits. Started by `launch_options.stress_test`.
+    // The player can only have `Projectiles::capacity` shots, so the ghost shots are scaled instead.
+    STRUCT( StressTest EXTENDS StateBase )
+    {
+        MEMBERS(
+            DECL(int INIT = 64) map_size // In tiles per side.
+            DECL(float INIT = 0.15f) wall_density
+            DECL(float INIT = 0.03f) spike_density
+            DECL(float INIT = 0.05f) breakable_density
+            DECL(int INIT = 256) particles
+            DECL(int INIT = 8) ghosts
+            DECL(int INIT = 16) ghost_shots
+            DECL(float INIT = 16.6f) frame_budget_ms // For one tick and one frame together.
+            DECL(int INIT = 30) warmup_ticks // Per step, not measured.
+            DECL(int INIT = 120) measured_ticks // Per step.
+            DECL(int INIT = 10) max_steps // Per subsystem.
+            DECL(std::uint64_t INIT = 1) seed
+        )
+
+        enum Dimension {dim_map_size, dim_particles, dim_ghosts, dim_ghost_shots, dim_count};
+        static constexpr const char *dimension_names[dim_count] = {"map size", "particles", "ghosts", "ghost shots"};
+
+        static constexpr int max_map_size = 2048; // The larger maps need too much memory.
+
+        struct Point
+        {
+            int load = 0;
+            double tick_ms = 0, render_ms = 0;
+            bool over_budget = false;
+            bool ended_early = false; // The level ended or restarted during the step, so the time is only for the ticks before that.
+        };
+        std::array<std::vector<Point>, dim_count> curves;
+
+        int dimension = 0; // Which one is scaled now.
+        int step = 0; // Each step doubles the load of `dimension`.
+
+        std::shared_ptr<World> world; // On the heap, since it's large. Not `unique_ptr`, since the states must be copyable.
+        int world_ticks = 0;
+        double tick_secs = 0;
+        // Accumulated by `Render()`.
+        mutable double render_secs = 0;
+        mutable int rendered_frames = 0;
+
+        // The load of `dim` at the current step.
+        [[nodiscard]] int Load(int dim) const
+        {
+            int base = std::array{map_size, particles, ghosts, ghost_shots}[std::size_t(dim)];
+            return dim == dimension ? base << step : base;
+        }
+
+        void StartStep()
+        {
+            Map::GenerationParams params{
+                .size = ivec2(Load(dim_map_size)),
+                .wall_density = wall_density,
+                .spike_density = spike_density,
+                .breakable_density = breakable_density,
+                .seed = seed,
+            };
+            world = std::make_shared<World>(SimulationContext{.map = Map(Map::Generate(params)), .seed = seed, .adaptive_particle_quality = false});
+            world->Init();
+            world->par.SetMaxCount(std::max(ParticleController::default_max_count, std::size_t(Load(dim_particles))));
+            SpawnGhosts();
+
+            world_ticks = 0;
+            tick_secs = 0;
+            render_secs = 0;
+            rendered_frames = 0;
+        }
+
+        // Adds the ghosts and their shots, on the screen around the player. They exist for the whole step.
+        void SpawnGhosts()
+        {
+            int num_shots = Load(dim_ghost_shots);
+            int num_ghosts = std::max(Load(dim_ghosts), int(num_shots > 0));
+            int length = warmup_ticks + measured_ticks + 60;
+
+            Random::DefaultGenerator generator(seed);
+            Random::DefaultInterfaces<Random::DefaultGenerator> ra(generator);
+            ivec2 center = world->p.pos;
+
+            // Not too close to the player, so the ghosts and the shots don't kill it.
+            auto RandomOffset = [&]
+            {
+                fvec2 ret = fvec2(ra.f.abs() <= 1, ra.f.abs() <= 1) * (screen_size / 2 - 16);
+                if (ret.len() < 48)
+                    ret = (ret + fvec2(0.001f, 0)).norm() * 48;
+                return ret;
+            };
+
+            TimeManager &time = world->time;
+            Projectiles no_shots;
+            for (int i = 0; i < num_ghosts; i++)
+            {
+                fvec2 orbit_center = center + RandomOffset();
+                float phase = ra.f <= 2 * f_pi;
+
+                Player state;
+                state.in_prison = false;
+                state.is_walking = true;
+                time.NextTimeline();
+                for (int t = 0; t < length; t++)
+                {
+                    state.pos = iround(orbit_center + fvec2::dir(phase + t * 0.05f) * 8);
+                    time.SavePlayer(state, no_shots);
+                }
+            }
+
+            for (int i = 0; i < num_shots; i++)
+            {
+                Ghost &ghost = time.ghosts[std::size_t(i % num_ghosts)];
+                fvec2 offset = RandomOffset();
+                fvec2 vel = iround(offset.norm() * 2); // Away from the player. Must be integral, see `GhostShot`.
+                ghost.shots.push_back({.begin = 0, .end = length, .pos = center + offset, .vel = vel});
+                clamp_var_min(ghost.max_shot_duration, length);
+            }
+
+            time.NextTimeline(); // For the player.
+        }
+
+        // Keeps the particle count. They're long-lived, but some get removed by the collisions.
+        void TopUpParticles()
+        {
+            std::size_t target = std::size_t(Load(dim_particles));
+            if (world->par.Count() >= target)
+                return;
+
+            Random::DefaultGenerator generator(seed + std::uint64_t(world_ticks));
+            Random::DefaultInterfaces<Random::DefaultGenerator> ra(generator);
+            fvec2 center = world->p.pos;
+            while (world->par.Count() < target)
+            {
+                fvec2 pos = center + fvec2(ra.f.abs() <= 1, ra.f.abs() <= 1) * (screen_size / 2);
+                world->par.Add(adjust(Particle{}, s.pos = pos, s.vel = fvec2(ra.f.abs() <= 0.3f, ra.f.abs() <= 0.3f), life = 1 << 20, size = 2, color = fvec3(1, 0.5f, 0.1f)));
+            }
+        }
+
+        void FinishStep(bool ended_early)
+        {
+            Point &point = curves[std::size_t(dimension)].emplace_back();
+            point.load = Load(dimension);
+            point.tick_ms = tick_secs / std::max(1, world_ticks - warmup_ticks) * 1000;
+            point.render_ms = rendered_frames ? render_secs / rendered_frames * 1000 : 0;
+            point.over_budget = point.tick_ms + point.render_ms > frame_budget_ms;
+            point.ended_early = ended_early;
+            std::cout << FMT("Stress test: {} = {}: tick {:.2f} ms, render {:.2f} ms.\n", dimension_names[dimension], point.load, point.tick_ms, point.render_ms);
+
+            window.FinishSwapBuffers(); // Destroying the world frees its GPU buffers.
+            world.reset();
+
+            bool at_limit = step + 1 >= max_steps || (dimension == dim_map_size && Load(dimension) * 2 > max_map_size);
+            if (point.over_budget || point.ended_early || at_limit)
+            {
+                dimension++;
+                step = 0;
+            }
+            else
+            {
+                step++;
+            }
+        }
+
+        void PrintReport() const
+        {
+            std::string report = FMT("Stress test results, the budget is {:.1f} ms per frame:\n", frame_budget_ms);
+            for (int dim = 0; dim < dim_count; dim++)
+            {
+                FMT_APPEND(report, "{}:\n", dimension_names[dim]);
+                std::optional<int> max_load;
+                for (const Point &point : curves[std::size_t(dim)])
+                {
+                    double total_ms = point.tick_ms + point.render_ms;
+                    FMT_APPEND(report, "    {:>8}  tick {:7.2f} ms  render {:7.2f} ms  total {:7.2f} ms  {:8.0f} per ms{}\n", point.load, point.tick_ms, point.render_ms, total_ms,
+                        point.load / std::max(total_ms, 0.001), point.over_budget ? "  (over the budget)" : point.ended_early ? "  (the level ended early)" : "");
+                    if (!point.over_budget)
+                        max_load = point.load;
+                }
+                if (max_load)
+                    FMT_APPEND(report, "    The largest load within the budget: {}.\n", *max_load);
+                else
+                    FMT_APPEND(report, "    Even the smallest load is over the budget.\n");
+            }
+            std::cout << report;
+        }
+
+        void Tick(std::string &next_state) override
+        {
+            (void)next_state;
+
+            if (!world)
+                StartStep();
+
+            TopUpParticles();
+            world->con.SetScripted({}); // Stand still.
+
+            std::string world_next_state;
+            std::uint64_t start = Clock::Time();
+            world->Tick(world_next_state);
+            if (world_ticks >= warmup_ticks)
+                tick_secs += Clock::TicksToSeconds(Clock::Time() - start);
+            world_ticks++;
+
+            bool ended_early = !world_next_state.empty() || world->reset_pending;
+            if (ended_early || world_ticks >= warmup_ticks + measured_ticks)
+                FinishStep(ended_early);
+
+            if (dimension == dim_count)
+            {
+                PrintReport();
+                Program::Exit();
+            }
+        }
+
+        void Render() const override
+        {
+            if (!world)
+            {
+                Graphics::SetClearColor(fvec3(0));
+                Graphics::Clear();
+                return;
+            }
+
+            std::uint64_t start = Clock::Time();
+            world->Render();
+            glFinish(); // Wait for the GPU, so the time includes it.
+            if (world_ticks > warmup_ticks)
+            {
+                render_secs += Clock::TicksToSeconds(Clock::Time() - start);
+                rendered_frames++;
+            }
         }
     };
 }
+
+int ValidateReplays(const std::vector<std::string> &files)
+{
+    struct Result
+    {
+        std::string error; // If not empty, the recording couldn't be replayed.
+        bool has_hashes = false; // The old recordings don't have them, and can't be checked.
+        std::size_t ticks = 0; // How many ticks were simulated. Less than the length if the level ended or restarted.
+        std::optional<std::size_t> desync_tick;
+    };
+
+    // The worlds get copies of this.
+    Map map = States::World::LoadMapFromFiles();
+
+    std::vector<Result> results(files.size());
+    std::uint64_t start = Clock::Time();
+
+    // One world per job. They only touch their own state, and the pool, which is thread-safe.
+    Jobs::DefaultPool().ParallelFor(files.size(), [&](std::size_t i)
+    {
+        Result &result = results[i];
+        try
+        {
+            InputRecording recording = InputRecording::Load(files[i]);
+            result.has_hashes = !recording.hashes.empty();
+
+            // On the heap, since it's large.
+            auto world = std::make_unique<States::World>(SimulationContext{.map = map, .seed = recording.seed, .batch = true});
+            world->rng.seed(recording.seed); // Same as `World::Init()` does for the replays.
+            world->replay = std::move(recording);
+
+            const std::vector<std::uint8_t> &frames = world->replay->frames;
+            world->SimulateHeadless(int(frames.size()), [&](int tick)
+            {
+                world->CheckReplayHash(std::size_t(tick));
+                result.ticks = std::size_t(tick) + 1;
+                return Controls::Frame::FromBits(frames[std::size_t(tick)]);
+            });
+            result.desync_tick = world->replay_desync_tick;
+        }
+        catch (std::exception &e)
+        {
+            result.error = e.what();
+        }
+    }, 1);
+
+    double secs = Clock::TicksToSeconds(Clock::Time() - start);
+
+    int num_failed = 0;
+    for (std::size_t i = 0; i < files.size(); i++)
+    {
+        const Result &result = results[i];
+        if (!result.error.empty())
+            std::cout << FMT("{}: FAILED: {}\n", files[i], result.error);
+        else if (result.desync_tick)
+            std::cout << FMT("{}: FAILED: desync before tick {}.\n", files[i], *result.desync_tick);
+        else if (!result.has_hashes)
+            std::cout << FMT("{}: replayed {} ticks, but there are no state hashes to check.\n", files[i], result.ticks);
+        else
+            std::cout << FMT("{}: ok, {} ticks.\n", files[i], result.ticks);
+
+        if (!result.error.empty() || result.desync_tick)
+            num_failed++;
+    }
+    std::cout << FMT("Validated {} replays in {:.3f} s, {} failed.\n", files.size(), secs, num_failed);
+    return num_failed;
+}
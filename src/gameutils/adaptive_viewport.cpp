@@ -37,13 +37,42 @@ namespace GameUtils
         gl_FragColor = texture2D(u_texture, v_texcoord);
     })";
 
+        REFL_SIMPLE_STRUCT( SinglePassShaderUniforms
+            REFL_DECL(Graphics::Uniform<Graphics::TexUnit> REFL_ATTR Graphics::Frag) texture
+            REFL_DECL(Graphics::Uniform<fvec2> REFL_ATTR Graphics::Frag) tex_size
+            REFL_DECL(Graphics::Uniform<fvec2> REFL_ATTR Graphics::Frag) scale
+        )
+
+        // Sharp bilinear. Each texel is drawn as a solid block, except for a one target pixel wide border, which is blended with the neighbors.
+        // This matches a nearest upscale by `scale_floor` followed by a linear one, in a single pass. The texture must have linear interpolation.
+        static constexpr const char *single_pass_frag_src = R"(
+    varying vec2 v_texcoord;
+    void main()
+    {
+        vec2 texel = v_texcoord * u_tex_size;
+        vec2 texel_floor = floor(texel);
+        vec2 offset = texel - texel_floor - 0.5;
+        vec2 border = 0.5 - 0.5 / u_scale;
+        vec2 f = (offset - clamp(offset, -border, border)) * u_scale + 0.5;
+        gl_FragColor = texture2D(u_texture, (texel_floor + f) / u_tex_size);
+    })";
+
         Details details;
         Graphics::Shader shader;
         ShaderUniforms shader_uni;
+        Graphics::Shader single_pass_shader;
+        SinglePassShaderUniforms single_pass_shader_uni;
         Graphics::TexObject fbuf_tex, fbuf_tex_intermediate;
         Graphics::TexUnit tex_unit;
         Graphics::FrameBuffer fbuf, fbuf_intermediate;
         Graphics::VertexBuffer<ShaderAttribs> vertex_buf;
+
+        // How many frames the unused intermediate texture is kept, in case the window is resized back. Not freeing it right away avoids reallocating it
+        // repeatedly while dragging the window edge across the threshold.
+        static constexpr int intermediate_free_delay = 60;
+
+        ivec2 intermediate_allocated_size = ivec2(0); // The current size of `fbuf_tex_intermediate`.
+        int intermediate_unused_frames = 0; // How many frames in a row it wasn't needed.
     };
 
     AdaptiveViewport::AdaptiveViewport() {}
@@ -51,10 +80,12 @@ namespace GameUtils
     AdaptiveViewport::AdaptiveViewport(const Graphics::ShaderConfig &shader_config) : data(std::make_unique<Data>())
     {
         data->shader = Graphics::Shader("Adaptive viewport identity shader", shader_config, Graphics::ShaderPreferences{}, Meta::tag<Data::ShaderAttribs>{}, data->shader_uni, Data::shader_vert_src, Data::shader_frag_src);
+        data->single_pass_shader = Graphics::Shader("Adaptive viewport single pass shader", shader_config, Graphics::ShaderPreferences{}, Meta::tag<Data::ShaderAttribs>{}, data->single_pass_shader_uni, Data::shader_vert_src, Data::single_pass_frag_src);
         data->fbuf_tex = nullptr;
         data->fbuf_tex_intermediate = nullptr;
         data->tex_unit = nullptr;
         data->shader_uni.texture = data->tex_unit;
+        data->single_pass_shader_uni.texture = data->tex_unit;
         data->tex_unit.Attach(data->fbuf_tex).Wrap(Graphics::clamp).Interpolation(Graphics::nearest);
         data->tex_unit.Attach(data->fbuf_tex_intermediate).Wrap(Graphics::clamp).Interpolation(Graphics::linear);
         data->fbuf = Graphics::FrameBuffer(nullptr).Attach(data->fbuf_tex);
@@ -88,7 +119,24 @@ namespace GameUtils
     void AdaptiveViewport::Update(ivec2 new_target_size)
     {
         data->details.Update(new_target_size);
-        data->tex_unit.Attach(data->fbuf_tex_intermediate).SetData(data->details.IntermediateSize());
+
+        // The single pass filter needs linear interpolation, and the nearest upscale to the intermediate texture needs nearest.
+        bool single_pass = data->details.SinglePass();
+        data->tex_unit.Attach(data->fbuf_tex).Interpolation(single_pass ? Graphics::linear : Graphics::nearest);
+        // Reallocate the intermediate texture only when its size changes. Since it's only used when downscaling, its size is the source size,
+        // so the window resizes normally don't touch it. If it's no longer used, it's freed by `FinishFrame()` a bit later.
+        if (!single_pass && data->intermediate_allocated_size != data->details.IntermediateSize())
+        {
+            data->intermediate_allocated_size = data->details.IntermediateSize();
+            data->tex_unit.Attach(data->fbuf_tex_intermediate).SetData(data->intermediate_allocated_size);
+        }
+        data->intermediate_unused_frames = 0;
+
+        if (single_pass)
+        {
+            data->single_pass_shader_uni.tex_size = data->details.Size();
+            data->single_pass_shader_uni.scale = fvec2(data->details.ViewportSize()) / data->details.Size();
+        }
     }
 
     void AdaptiveViewport::Update()
@@ -104,6 +152,32 @@ namespace GameUtils
 
     void AdaptiveViewport::FinishFrame(const Graphics::FrameBuffer *fbuf)
     {
+        auto BindTarget = [&]
+        {
+            if (fbuf)
+                fbuf->Bind();
+            else
+                Graphics::FrameBuffer::BindDefault();
+            Graphics::Viewport(data->details.ViewportPos(), data->details.ViewportSize());
+            Graphics::Clear();
+        };
+
+        if (data->details.SinglePass())
+        {
+            // Don't keep the large intermediate texture around if it's not used.
+            if (data->intermediate_allocated_size != ivec2(0) && ++data->intermediate_unused_frames >= Data::intermediate_free_delay)
+            {
+                data->intermediate_allocated_size = ivec2(0);
+                data->tex_unit.Attach(data->fbuf_tex_intermediate).SetData(ivec2(1));
+            }
+
+            data->single_pass_shader.Bind();
+            BindTarget();
+            data->tex_unit.Attach(data->fbuf_tex);
+            data->vertex_buf.Draw(Graphics::triangles);
+            return;
+        }
+
         data->shader.Bind();
 
         data->fbuf_intermediate.Bind();
@@ -111,12 +185,7 @@ namespace GameUtils
         data->tex_unit.Attach(data->fbuf_tex);
         data->vertex_buf.Draw(Graphics::triangles);
 
-        if (fbuf)
-            fbuf->Bind();
-        else
-            Graphics::FrameBuffer::BindDefault();
-        Graphics::Viewport(data->details.ViewportPos(), data->details.ViewportSize());
-        Graphics::Clear();
+        BindTarget();
         data->tex_unit.Attach(data->fbuf_tex_intermediate);
         data->vertex_buf.Draw(Graphics::triangles);
     }
@@ -28,6 +28,7 @@ namespace GameUtils
             ivec2 target_size = ivec2(0); // Target size.
             ivec2 viewport_pos = ivec2(0); // Output viewport position.
             ivec2 viewport_size = ivec2(0); // Output viewport size. Same as `target_size`, but shrinked to proportion.
+            bool single_pass = true; // Whether the intermediate texture is skipped. See `SinglePass()`.
 
           public:
             Details() {}
@@ -53,6 +54,7 @@ namespace GameUtils
                 intermediate_size = size * scale_floor;
                 viewport_size = min(iround(size * scale), new_target_size);
                 viewport_pos = (new_target_size - viewport_size)/2;
+                single_pass = scale >= 1;
             }
 
             // Source size.
@@ -75,6 +77,12 @@ namespace GameUtils
             {
                 return intermediate_size;
             }
+            // If true, the frame is upscaled directly to the target with an area-weighted filter, without the intermediate texture.
+            // The intermediate texture is only needed when downscaling, since the area-weighted filter assumes the pixels get larger.
+            [[nodiscard]] bool SinglePass() const
+            {
+                return single_pass;
+            }
             // The resulting viewport position.
             [[nodiscard]] ivec2 ViewportPos() const
             {
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "program/errors.h"
+#include "gameutils/startup_trace.h"
+#include "strings/format.h"
+#include "utils/clock.h"
+#include "utils/jobs.h"
+
+namespace GameUtils
+{
+    // Runs the loading jobs in the background, to keep the main loop responsive while the assets are loaded.
+    // Each job has an optional `work` part, which runs on `Jobs::DefaultPool()`, and an optional `finish` part, which runs on the main thread in `Tick()` after `work`.
+    // Put the graphics API calls into `finish`. A job starts when all its dependencies are finished.
+    // Usage:
+    //     auto atlas = loader.Add("atlas", []{/* decode */}, []{/* upload */});
+    //     loader.Add("fonts", []{/* rasterize */}, {}, {atlas});
+    //     while (!loader.Done())
+    //         loader.Tick(); // And draw `loader.Progress()`.
+    // Each job is timed, see `TimingReport()`, and also recorded by `StartupTrace`.
+    class AssetLoader
+    {
+      public:
+        using JobId = std::size_t;
+
+      private:
+        enum class Status
+        {
+            waiting, // For the dependencies.
+            working, // Running `work` in the pool.
+            finished,
+        };
+
+        struct Job
+        {
+            std::string name;
+            std::function<void()> work, finish;
+            std::vector<JobId> dependencies;
+
+            Status status = Status::waiting;
+            Jobs::Handle handle; // Null if there's no `work`.
+
+            // In `Clock::Time()` ticks. `start_time` is when the dependencies finished, so the waiting for a pool thread is included.
+            std::uint64_t start_time = 0, end_time = 0;
+            std::uint64_t work_ticks = 0, finish_ticks = 0;
+        };
+
+        std::deque<Job> jobs; // Never invalidates the references.
+        std::size_t num_finished = 0;
+        std::uint64_t first_tick_time = 0; // Zero if `Tick()` wasn't called yet.
+
+        [[nodiscard]] bool DependenciesFinished(const Job &job) const
+        {
+            return std::all_of(job.dependencies.begin(), job.dependencies.end(), [&](JobId id){return jobs[id].status == Status::finished;});
+        }
+
+      public:
+        AssetLoader() {}
+
+        AssetLoader(const AssetLoader &) = delete;
+        AssetLoader &operator=(const AssetLoader &) = delete;
+
+        ~AssetLoader()
+        {
+            // The jobs can refer to the loader's owner, so wait for them.
+            for (Job &job : jobs)
+            {
+                try
+                {
+                    job.handle.Wait();
+                }
+                catch (...) {}
+            }
+        }
+
+        // Adds a job. The dependencies must be added before it.
+        // The jobs start at the next `Tick()`.
+        JobId Add(std::string name, std::function<void()> work, std::function<void()> finish = {}, std::initializer_list<JobId> dependencies = {})
+        {
+            for ([[maybe_unused]] JobId id : dependencies)
+                ASSERT(id < jobs.size(), "Invalid asset loader job dependency.");
+
+            Job &job = jobs.emplace_back();
+            job.name = std::move(name);
+            job.work = std::move(work);
+            job.finish = std::move(finish);
+            job.dependencies = dependencies;
+            return jobs.size() - 1;
+        }
+
+        // Call this on the main thread every tick.
+        // Runs `finish` for the jobs that are done working, and starts the jobs whose dependencies are finished.
+        // Rethrows the exceptions thrown by the jobs, prefixed with the job name.
+        void Tick()
+        {
+            if (first_tick_time == 0)
+                first_tick_time = Clock::Time();
+
+            bool any_finished;
+            do
+            {
+                any_finished = false;
+
+                for (Job &job : jobs)
+                {
+                    if (job.status == Status::waiting && DependenciesFinished(job))
+                    {
+                        job.status = Status::working;
+                        job.start_time = Clock::Time();
+                        if (job.work)
+                        {
+                            job.handle = Jobs::DefaultPool().Submit([&job, work = std::move(job.work)]
+                            {
+                                StartupTrace::Scope scope(job.name.c_str());
+                                std::uint64_t work_start = Clock::Time();
+                                work();
+                                job.work_ticks = Clock::Time() - work_start; // Read after `Wait()`, which synchronizes.
+                            });
+                        }
+                    }
+
+                    if (job.status != Status::working || (job.handle && !job.handle.IsDone()))
+                        continue;
+
+                    job.status = Status::finished;
+                    try
+                    {
+                        job.handle.Wait(); // Rethrows.
+                        if (job.finish)
+                        {
+                            StartupTrace::Scope scope(job.name.c_str());
+                            std::uint64_t finish_start = Clock::Time();
+                            job.finish();
+                            job.finish_ticks = Clock::Time() - finish_start;
+                        }
+                    }
+                    catch (std::exception &e)
+                    {
+                        Program::Error("While loading `", job.name, "`:\n", e.what());
+                    }
+                    job.end_time = Clock::Time();
+                    num_finished++;
+                    any_finished = true;
+                }
+            }
+            while (any_finished);
+        }
+
+        // Returns true if all jobs are finished.
+        [[nodiscard]] bool Done() const
+        {
+            return num_finished == jobs.size();
+        }
+
+        // From 0 to 1, the fraction of finished jobs.
+        [[nodiscard]] float Progress() const
+        {
+            return jobs.empty() ? 1 : num_finished / float(jobs.size());
+        }
+
+        // Describes how long each finished job took, one per line, in the order they were added.
+        // The first number is the time from the first `Tick()` to the job's end, which is when the things it loads become usable.
+        [[nodiscard]] std::string TimingReport() const
+        {
+            std::string ret;
+            auto Ms = [](std::uint64_t ticks){return Clock::TicksToSeconds(ticks) * 1000;};
+            for (const Job &job : jobs)
+            {
+                if (job.status != Status::finished)
+                    continue;
+                FMT_APPEND(ret, "{}: done at {:.1f} ms, took {:.1f} ms (work {:.1f} ms, finish {:.1f} ms)\n",
+                    job.name, Ms(job.end_time - first_tick_time), Ms(job.end_time - job.start_time), Ms(job.work_ticks), Ms(job.finish_ticks));
+            }
+            return ret;
+        }
+    };
+}
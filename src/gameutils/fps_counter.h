@@ -1,34 +1,138 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "interface/window.h"
+#include "strings/format.h"
+#include "utils/clock.h"
 
 namespace GameUtils
 {
+    // Counts ticks and frames per second, and collects the frame time statistics, which show the stutter that the averages hide.
     class FpsCounter
     {
+      public:
+        // The number of the last frames the statistics are computed for.
+        static constexpr std::size_t window_size = 600;
+        // The last bucket of the ticks-per-frame distribution counts this many ticks or more.
+        static constexpr std::size_t max_ticks_per_frame_bucket = 4;
+
+        struct Stats
+        {
+            // Frame times in seconds, between the buffer swaps.
+            double p50 = 0, p95 = 0, p99 = 0, max = 0;
+            // How many frames took at least 1.5 of the expected frame time, see `SetExpectedFrameTime()`.
+            int missed_intervals = 0;
+            // How many frames had 0, 1, ... ticks before them. The last element counts `max_ticks_per_frame_bucket` ticks or more.
+            std::array<int, max_ticks_per_frame_bucket + 1> ticks_per_frame{};
+            // The number of the frames these stats were computed for.
+            int num_frames = 0;
+        };
+
+      private:
         int last_second = -1;
         decltype(Interface::Window::Get().Ticks()) last_ticks = 0;
         decltype(Interface::Window::Get().Frames()) last_frames = 0;
         int tps = 0;
         int fps = 0;
 
+        struct Sample
+        {
+            std::uint64_t duration = 0; // In clock ticks.
+            std::uint64_t ticks = 0;
+        };
+        std::vector<Sample> samples; // A ring buffer, the oldest sample is at `next_sample` once it's full.
+        std::size_t next_sample = 0;
+
+        std::uint64_t last_frame_time = 0;
+        decltype(Interface::Window::Get().Frames()) last_sample_frames = 0;
+        decltype(Interface::Window::Get().Ticks()) last_sample_ticks = 0;
+
+        double expected_frame_time = 0;
+        Stats stats;
+
+        void ComputeStats()
+        {
+            stats = {};
+            stats.num_frames = int(samples.size());
+            if (samples.empty())
+                return;
+
+            std::vector<std::uint64_t> durations;
+            durations.reserve(samples.size());
+            std::uint64_t missed_threshold = expected_frame_time > 0 ? Clock::SecondsToTicks(expected_frame_time * 1.5) : std::uint64_t(-1);
+            for (const Sample &sample : samples)
+            {
+                durations.push_back(sample.duration);
+                stats.missed_intervals += sample.duration >= missed_threshold;
+                stats.ticks_per_frame[std::min(sample.ticks, std::uint64_t(max_ticks_per_frame_bucket))]++;
+            }
+
+            std::sort(durations.begin(), durations.end());
+            auto Percentile = [&](double fraction)
+            {
+                return Clock::TicksToSeconds(durations[std::min(std::size_t(fraction * durations.size()), durations.size() - 1)]);
+            };
+            stats.p50 = Percentile(0.5);
+            stats.p95 = Percentile(0.95);
+            stats.p99 = Percentile(0.99);
+            stats.max = Clock::TicksToSeconds(durations.back());
+        }
+
       public:
-        constexpr FpsCounter() {}
+        FpsCounter() {}
 
         // Prefer to call this once per frame.
-        // Returns true if the values were updated, false otherwise.
+        // Returns true if the values were updated, false otherwise. The per-second values and `GetStats()` are updated together.
         bool Update()
         {
+            Interface::Window window = Interface::Window::Get();
+
+            // Only the frames that were actually shown are sampled.
+            if (window.Frames() != last_sample_frames)
+            {
+                std::uint64_t now = Clock::Time();
+                if (last_sample_frames != 0)
+                {
+                    Sample sample{.duration = now - last_frame_time, .ticks = window.Ticks() - last_sample_ticks};
+                    if (samples.size() < window_size)
+                    {
+                        samples.push_back(sample);
+                    }
+                    else
+                    {
+                        samples[next_sample] = sample;
+                        next_sample = (next_sample + 1) % window_size;
+                    }
+                }
+                last_frame_time = now;
+                last_sample_frames = window.Frames();
+                last_sample_ticks = window.Ticks();
+            }
+
             int this_second = SDL_GetTicks() / 1000;
             if (this_second == last_second)
                 return false;
             last_second = this_second;
-            Interface::Window window = Interface::Window::Get();
             tps = window.Ticks() - std::exchange(last_ticks, window.Ticks());
             fps = window.Frames() - std::exchange(last_frames, window.Frames());
+            ComputeStats();
             return true;
         }
 
+        // The frame time for which the frames that take 1.5 times longer are counted as missed intervals, in seconds.
+        // Normally the vsync interval or the FPS cap. If zero (the default), nothing is counted.
+        void SetExpectedFrameTime(double secs)
+        {
+            expected_frame_time = secs;
+        }
+
         [[nodiscard]] int Tps() const
         {
             return tps;
@@ -37,5 +141,20 @@ namespace GameUtils
         {
             return fps;
         }
+
+        // The statistics over the last `window_size` frames.
+        [[nodiscard]] const Stats &GetStats() const
+        {
+            return stats;
+        }
+
+        // A short single-line summary of `GetStats()`, with the times in milliseconds.
+        [[nodiscard]] std::string StatsString() const
+        {
+            std::string ret = FMT("p50:{:.1f} p95:{:.1f} p99:{:.1f} max:{:.1f} missed:{} ticks/frame:", stats.p50 * 1000, stats.p95 * 1000, stats.p99 * 1000, stats.max * 1000, stats.missed_intervals);
+            for (std::size_t i = 0; i < stats.ticks_per_frame.size(); i++)
+                ret += FMT("{}{}", i == 0 ? "" : "/", stats.ticks_per_frame[i]);
+            return ret;
+        }
     };
 }
@@ -0,0 +1,94 @@
+#include "post_process.h"
+
+#include "graphics/clear.h"
+#include "graphics/framebuffer.h"
+#include "graphics/texture.h"
+#include "graphics/vertex_buffer.h"
+#include "graphics/viewport.h"
+
+#ifdef IMP_HAVE_FRAMEBUFFERS
+
+namespace GameUtils
+{
+    struct PostProcess::Data
+    {
+        ivec2 size = ivec2(0);
+        Graphics::TexObject textures[2];
+        Graphics::FrameBuffer fbufs[2];
+        int current = 0;
+        Graphics::TexUnit tex_unit;
+        Graphics::VertexBuffer<Attribs> vertex_buf;
+    };
+
+    PostProcess::PostProcess() {}
+
+    PostProcess::PostProcess(ivec2 size) : data(std::make_unique<Data>())
+    {
+        data->size = size;
+        data->tex_unit = nullptr;
+        for (int i = 0; i < 2; i++)
+        {
+            data->textures[i] = nullptr;
+            data->tex_unit.Attach(data->textures[i]).Wrap(Graphics::clamp).Interpolation(Graphics::nearest).SetData(size);
+            data->fbufs[i] = Graphics::FrameBuffer(nullptr).Attach(data->textures[i]);
+        }
+
+        // Same as in `AdaptiveViewport`, one triangle covering the whole target.
+        constexpr float margin = 0.01;
+        constexpr int vertex_count = 3;
+        Attribs vertex_data[vertex_count]
+        {
+            {fvec2(-1-margin, -1-margin)},
+            {fvec2(-1-margin,  3+margin)},
+            {fvec2( 3+margin, -1-margin)},
+        };
+        data->vertex_buf = Graphics::VertexBuffer<Attribs>(vertex_count, vertex_data);
+    }
+
+    PostProcess::PostProcess(PostProcess &&) noexcept = default;
+    PostProcess &PostProcess::operator=(PostProcess &&) noexcept = default;
+    PostProcess::~PostProcess() = default;
+
+    PostProcess::operator bool() const
+    {
+        return bool(data);
+    }
+
+    ivec2 PostProcess::Size() const
+    {
+        return data->size;
+    }
+
+    const Graphics::TexUnit &PostProcess::SourceUnit() const
+    {
+        return data->tex_unit;
+    }
+
+    void PostProcess::Begin()
+    {
+        data->fbufs[data->current].Bind();
+        Graphics::Viewport(data->size);
+    }
+
+    void PostProcess::Apply(const Graphics::Shader &shader, const Graphics::FrameBuffer *output)
+    {
+        shader.Bind();
+        data->tex_unit.Attach(data->textures[data->current]);
+
+        if (output)
+        {
+            output->Bind();
+        }
+        else
+        {
+            data->current = 1 - data->current;
+            data->fbufs[data->current].Bind();
+        }
+        Graphics::Viewport(data->size);
+        Graphics::Clear();
+
+        data->vertex_buf.Draw(Graphics::triangles);
+    }
+}
+
+#endif
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "graphics/shader.h"
+#include "reflection/structs.h"
+#include "utils/mat.h"
+
+namespace Graphics
+{
+    class FrameBuffer;
+    class TexUnit;
+}
+
+namespace GameUtils
+{
+    // Two ping-pong render targets for the full-screen effects.
+    // Each pass draws one full-screen triangle, reading the current target and writing the other one, which then becomes current.
+    // Usage:
+    //     post.Begin(); // Binds the current target, then draw the scene.
+    //     post.Apply(shader); // Flush the render queue before this.
+    //     post.Apply(shader, &output); // The last pass writes to an external framebuffer of the same size.
+    // Make the pass shaders with `MakeShader()`. The fragment shader gets `v_texcoord`, and should read `u_texture`, set to `SourceUnit()`.
+    class PostProcess
+    {
+        struct Data;
+        std::unique_ptr<Data> data;
+
+      public:
+        REFL_SIMPLE_STRUCT( Attribs
+            REFL_DECL(fvec2) pos
+        )
+
+        static constexpr const char *vertex_source = R"(
+varying vec2 v_texcoord;
+void main()
+{
+    v_texcoord = a_pos * 0.5 + 0.5;
+    gl_Position = vec4(a_pos, 0, 1);
+})";
+
+        template <typename UniformsT>
+        [[nodiscard]] static Graphics::Shader MakeShader(std::string name, const Graphics::ShaderConfig &config, UniformsT &uniforms, const std::string &fragment_source)
+        {
+            return Graphics::Shader(std::move(name), config, Graphics::ShaderPreferences{}, Meta::tag<Attribs>{}, uniforms, vertex_source, fragment_source);
+        }
+
+        PostProcess();
+        PostProcess(ivec2 size);
+
+        PostProcess(PostProcess &&) noexcept;
+        PostProcess &operator=(PostProcess &&) noexcept;
+        ~PostProcess();
+
+        [[nodiscard]] explicit operator bool() const;
+
+        [[nodiscard]] ivec2 Size() const;
+
+        // The passes read the current target from this unit.
+        [[nodiscard]] const Graphics::TexUnit &SourceUnit() const;
+
+        // Binds the current target and sets the viewport for it.
+        void Begin();
+
+        // Runs a pass with `shader`, into the other target or into `output`. Clears the destination first.
+        // If the output is the other target, leaves it bound as the new current one. Otherwise leaves `output` bound.
+        void Apply(const Graphics::Shader &shader, const Graphics::FrameBuffer *output = nullptr);
+    };
+}
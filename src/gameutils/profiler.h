@@ -0,0 +1,358 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "program/alloc_stats.h"
+#include "stream/save_to_file.h"
+#include "strings/format.h"
+#include "utils/clock.h"
+#include "utils/mat.h"
+
+namespace GameUtils
+{
+    // A lightweight scoped profiler.
+    // Keeps the zones of the last several frames in a ring buffer, and can dump them in the Chrome trace format (open in `chrome://tracing` or Perfetto).
+    // Usage:
+    //     profiler.BeginFrame();
+    //     {
+    //         GameUtils::Profiler::Scope scope(profiler, "stuff");
+    //         ...
+    //     }
+    //     profiler.EndFrame();
+    class Profiler
+    {
+      public:
+        struct Zone
+        {
+            const char *name = nullptr; // Must be a string literal, or otherwise outlive the profiler.
+            std::uint64_t begin = 0, end = 0; // In `Clock::Time()` units.
+            int depth = 0; // The number of enclosing zones.
+            std::uint64_t allocs = 0; // The heap allocations on this thread during the zone. Only in the `count_allocs` mode.
+        };
+
+        struct Frame
+        {
+            std::uint64_t begin = 0, end = 0;
+            std::vector<Zone> zones; // In the order of entry.
+            int ticks = 0; // See `CountTick()`.
+
+            // Only in the `count_allocs` mode.
+            Program::AllocStats::Counters allocs; // The heap allocations during the frame, on all threads.
+            std::size_t peak_live_bytes = 0; // The max amount of heap memory in use during the frame.
+
+            // The total duration of the top-level zones with this name, in seconds.
+            [[nodiscard]] double TopLevelZoneSecs(std::string_view name) const
+            {
+                double ret = 0;
+                for (const Zone &zone : zones)
+                {
+                    if (zone.depth == 0 && zone.name == name)
+                        ret += Clock::TicksToSeconds(zone.end - zone.begin);
+                }
+                return ret;
+            }
+        };
+
+        // The accumulated stats for one zone name, see `Summary()`.
+        struct ZoneStats
+        {
+            const char *name = nullptr;
+            int depth = 0;
+            double average_secs = 0; // Per frame, over the frames that have this zone.
+            double max_secs = 0;
+            double average_allocs = 0; // Same as `average_secs`, but for the heap allocations.
+        };
+
+      private:
+        std::vector<Frame> frames; // A ring buffer.
+        std::size_t next_frame = 0; // The index in `frames` of the next frame to be written.
+        std::size_t num_frames = 0; // The number of valid frames in `frames`.
+        bool in_frame = false;
+        int depth = 0;
+        Program::AllocStats::Counters frame_begin_allocs;
+
+        [[nodiscard]] Frame &CurrentFrame()
+        {
+            return frames[next_frame];
+        }
+
+        // The number of frames that `ForEachFrame()` visits.
+        // During a frame, if the buffer is full, the current frame is overwriting the oldest one, so it's not counted.
+        [[nodiscard]] std::size_t NumFinishedFrames() const
+        {
+            return in_frame && num_frames == frames.size() ? num_frames - 1 : num_frames;
+        }
+
+        // Calls `func(const Frame &)` for each finished frame, from oldest to newest.
+        template <typename F>
+        void ForEachFrame(F &&func) const
+        {
+            std::size_t count = NumFinishedFrames();
+            for (std::size_t i = 0; i < count; i++)
+                func(std::as_const(frames[(next_frame + frames.size() - count + i) % frames.size()]));
+        }
+
+      public:
+        Profiler() {}
+        Profiler(std::size_t frame_capacity) : frames(frame_capacity) {}
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return !frames.empty();
+        }
+
+        void BeginFrame()
+        {
+            if (frames.empty())
+                return;
+            in_frame = true;
+            depth = 0;
+            Frame &frame = CurrentFrame();
+            frame.zones.clear(); // This keeps the capacity.
+            frame.ticks = 0;
+            frame.begin = Clock::Time();
+            if constexpr (Program::AllocStats::enabled)
+            {
+                Program::AllocStats::ResetPeakLiveBytes();
+                frame_begin_allocs = Program::AllocStats::Total();
+            }
+        }
+
+        void EndFrame()
+        {
+            if (!in_frame)
+                return;
+            in_frame = false;
+            Frame &frame = CurrentFrame();
+            frame.end = Clock::Time();
+            if constexpr (Program::AllocStats::enabled)
+            {
+                frame.allocs = Program::AllocStats::Total() - frame_begin_allocs;
+                frame.peak_live_bytes = Program::AllocStats::PeakLiveBytes();
+            }
+            next_frame = (next_frame + 1) % frames.size();
+            clamp_var_max(num_frames += 1, frames.size());
+        }
+
+        // Call this once per tick, to record the number of ticks in each frame.
+        void CountTick()
+        {
+            if (in_frame)
+                CurrentFrame().ticks++;
+        }
+
+        // How many frames are kept.
+        [[nodiscard]] std::size_t FrameCapacity() const
+        {
+            return frames.size();
+        }
+
+        class Scope
+        {
+            Profiler *profiler = nullptr;
+            std::size_t index = 0;
+            std::uint64_t begin_allocs = 0;
+
+          public:
+            Scope(Profiler &new_profiler, const char *name)
+            {
+                if (!new_profiler.in_frame)
+                    return;
+                profiler = &new_profiler;
+                std::vector<Zone> &zones = profiler->CurrentFrame().zones;
+                index = zones.size();
+                zones.push_back({.name = name, .begin = Clock::Time(), .depth = profiler->depth++});
+                if constexpr (Program::AllocStats::enabled)
+                    begin_allocs = Program::AllocStats::ThisThread().allocs; // After `push_back()`, which can allocate.
+            }
+
+            Scope(const Scope &) = delete;
+            Scope &operator=(const Scope &) = delete;
+
+            ~Scope()
+            {
+                if (!profiler || !profiler->in_frame)
+                    return;
+                Zone &zone = profiler->CurrentFrame().zones[index];
+                zone.end = Clock::Time();
+                if constexpr (Program::AllocStats::enabled)
+                    zone.allocs = Program::AllocStats::ThisThread().allocs - begin_allocs;
+                profiler->depth--;
+            }
+        };
+
+        // Returns the stats for each zone name over the stored frames, in the order of first appearance.
+        // Pass a `FrameArena` if you call this every frame.
+        [[nodiscard]] std::pmr::vector<ZoneStats> Summary(std::pmr::memory_resource *memory = std::pmr::get_default_resource()) const
+        {
+            struct Accum
+            {
+                ZoneStats stats;
+                int num_frames = 0;
+                std::uint64_t last_frame_begin = -1;
+                double this_frame_secs = 0;
+                std::uint64_t this_frame_allocs = 0;
+            };
+            std::pmr::vector<Accum> ret(memory);
+
+            auto Flush = [](Accum &accum)
+            {
+                if (accum.num_frames == 0)
+                    return;
+                accum.stats.average_secs += accum.this_frame_secs;
+                accum.stats.average_allocs += double(accum.this_frame_allocs);
+                clamp_var_min(accum.stats.max_secs, accum.this_frame_secs);
+            };
+
+            ForEachFrame([&](const Frame &frame)
+            {
+                for (const Zone &zone : frame.zones)
+                {
+                    auto it = std::find_if(ret.begin(), ret.end(), [&](const Accum &accum){return accum.stats.name == zone.name && accum.stats.depth == zone.depth;});
+                    if (it == ret.end())
+                    {
+                        it = ret.insert(ret.end(), Accum{});
+                        it->stats.name = zone.name;
+                        it->stats.depth = zone.depth;
+                    }
+
+                    if (it->last_frame_begin != frame.begin)
+                    {
+                        Flush(*it);
+                        it->last_frame_begin = frame.begin;
+                        it->this_frame_secs = 0;
+                        it->this_frame_allocs = 0;
+                        it->num_frames++;
+                    }
+                    it->this_frame_secs += Clock::TicksToSeconds(zone.end - zone.begin);
+                    it->this_frame_allocs += zone.allocs;
+                }
+            });
+
+            std::pmr::vector<ZoneStats> stats(memory);
+            stats.reserve(ret.size());
+            for (Accum &accum : ret)
+            {
+                Flush(accum);
+                accum.stats.average_secs /= accum.num_frames;
+                accum.stats.average_allocs /= accum.num_frames;
+                stats.push_back(accum.stats);
+            }
+            return stats;
+        }
+
+        // Returns the last finished frame, or null if none.
+        [[nodiscard]] const Frame *LastFrame() const
+        {
+            if (num_frames == 0)
+                return nullptr;
+            return &frames[(next_frame + frames.size() - 1) % frames.size()];
+        }
+
+        // The average and the max frame duration over the stored frames, in seconds.
+        [[nodiscard]] std::pair<double, double> FrameTimes() const
+        {
+            double sum = 0, max_secs = 0;
+            ForEachFrame([&](const Frame &frame)
+            {
+                double secs = Clock::TicksToSeconds(frame.end - frame.begin);
+                sum += secs;
+                clamp_var_min(max_secs, secs);
+            });
+            std::size_t count = NumFinishedFrames();
+            return {count ? sum / count : 0, max_secs};
+        }
+
+        struct FrameAllocStats
+        {
+            double average_allocs = 0;
+            std::uint64_t max_allocs = 0;
+            double average_bytes = 0;
+            std::size_t peak_live_bytes = 0;
+        };
+        // The heap allocations per frame over the stored frames. Only in the `count_allocs` mode, otherwise all zeros.
+        [[nodiscard]] FrameAllocStats FrameAllocs() const
+        {
+            FrameAllocStats ret;
+            ForEachFrame([&](const Frame &frame)
+            {
+                ret.average_allocs += double(frame.allocs.allocs);
+                ret.average_bytes += double(frame.allocs.bytes);
+                clamp_var_min(ret.max_allocs, frame.allocs.allocs);
+                clamp_var_min(ret.peak_live_bytes, frame.peak_live_bytes);
+            });
+            if (std::size_t count = NumFinishedFrames())
+            {
+                ret.average_allocs /= count;
+                ret.average_bytes /= count;
+            }
+            return ret;
+        }
+
+        // Returns the stored frames in the Chrome trace event format.
+        // The frame events have the tick count and, in the `count_allocs` mode, the heap allocations as arguments.
+        // If `include_unfinished` is true, also adds the current frame if any, with the unfinished zones ending now. This is for the crash traces.
+        [[nodiscard]] std::string ChromeTraceJson(bool include_unfinished = false) const
+        {
+            std::string ret = "{\"traceEvents\":[";
+            bool first = true;
+            std::uint64_t origin = 0;
+            auto AddFrame = [&](const Frame &frame, std::uint64_t unfinished_end)
+            {
+                if (first)
+                    origin = frame.begin;
+
+                auto AddEvent = [&](const char *name, std::uint64_t begin, std::uint64_t end)
+                {
+                    if (!first)
+                        ret += ',';
+                    first = false;
+                    if (end == 0)
+                        end = unfinished_end;
+                    FMT_APPEND(ret, "\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":0,\"ts\":{:.3f},\"dur\":{:.3f}",
+                        name, Clock::TicksToSeconds(begin - origin) * 1e6, Clock::TicksToSeconds(end - begin) * 1e6);
+                };
+
+                AddEvent(unfinished_end ? "Frame (unfinished)" : "Frame", frame.begin, unfinished_end ? unfinished_end : frame.end);
+                FMT_APPEND(ret, ",\"args\":{{\"ticks\":{}", frame.ticks);
+                if constexpr (Program::AllocStats::enabled)
+                {
+                    if (!unfinished_end)
+                        FMT_APPEND(ret, ",\"allocs\":{},\"alloc_bytes\":{},\"peak_live_bytes\":{}", frame.allocs.allocs, frame.allocs.bytes, frame.peak_live_bytes);
+                }
+                ret += "}}";
+
+                for (const Zone &zone : frame.zones)
+                {
+                    AddEvent(zone.name, zone.begin, zone.end);
+                    if constexpr (Program::AllocStats::enabled)
+                    {
+                        if (zone.end != 0)
+                            FMT_APPEND(ret, ",\"args\":{{\"allocs\":{}}}", zone.allocs);
+                    }
+                    ret += '}';
+                }
+            };
+
+            ForEachFrame([&](const Frame &frame){AddFrame(frame, 0);});
+            if (include_unfinished && in_frame)
+                AddFrame(frames[next_frame], Clock::Time());
+
+            ret += "\n]}\n";
+            return ret;
+        }
+
+        // Saves `ChromeTraceJson()` to a file. Throws on failure.
+        void SaveChromeTrace(std::string file_name, bool include_unfinished = false) const
+        {
+            Stream::SaveFile(std::move(file_name), ChromeTraceJson(include_unfinished), Stream::text);
+        }
+    };
+}
@@ -1,10 +1,50 @@
 #include "render.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <optional>
 
 #include "graphics/complete.h"
 #include "reflection/structs.h"
 
+namespace
+{
+    // Calls `func(fvec2 offset, const Graphics::Text::Symbol &symbol)` for each symbol, where `offset` is relative to the text position.
+    template <typename F>
+    void LayOutText(const Graphics::Text &text, ivec2 align, int align_box_x, F &&func)
+    {
+        Graphics::Text::Stats stats = text.ComputeStats();
+
+        ivec2 align_box(align_box_x, align.y);
+
+        fvec2 offset = -stats.size * (1 + align_box) / 2;
+        offset.x += stats.size.x * (1 + align.x) / 2; // Note that we don't change vertical position here.
+
+        float line_start_offset_x = offset.x;
+
+        for (size_t line_index = 0; line_index < text.lines.size(); line_index++)
+        {
+            const Graphics::Text::Line &line = text.lines[line_index];
+            const Graphics::Text::Stats::Line &line_stats = stats.lines[line_index];
+
+            offset.x = line_start_offset_x - line_stats.width * (1 + align.x) / 2;
+            offset.y += line_stats.ascent;
+
+            for (const Graphics::Text::Symbol &symbol : line.symbols)
+            {
+                func(offset + symbol.offset, symbol);
+                offset.x += symbol.advance + symbol.kerning;
+            }
+
+            offset.y += line_stats.descent + line_stats.line_gap;
+        }
+    }
+}
+
 struct Render::Data
 {
     REFL_SIMPLE_STRUCT( Attribs
@@ -12,34 +52,90 @@ struct Render::Data
         REFL_DECL(fvec4) color
         REFL_DECL(fvec2) texcoord
         REFL_DECL(fvec3) factors
+        REFL_DECL(float) page // Plus `max_texture_pages` times the distance field sharpness, see `SdfSharpness()`.
+        REFL_DECL(fvec4) tile // The texture region to repeat, as the position and size in texels. Zero size disables the repetition.
+    )
+
+    // Same as `Attribs`, but smaller. See `VertexFormat::packed`.
+    // The shader sees the same types, since the attributes are converted to floats.
+    REFL_SIMPLE_STRUCT( PackedAttribs
+        REFL_DECL(fvec2) pos
+        REFL_DECL(u8vec4 REFL_ATTR Graphics::Normalized) color
+        REFL_DECL(u16vec2) texcoord
+        REFL_DECL(u8vec3 REFL_ATTR Graphics::Normalized) factors
+        REFL_DECL(std::uint8_t) page // Not normalized.
+        REFL_DECL(u16vec4) tile
     )
 
     REFL_SIMPLE_STRUCT( Uniforms
-        REFL_DECL(Graphics::Uniform<fmat4> REFL_ATTR Graphics::Vert) matrix
-        REFL_DECL(Graphics::Uniform<fvec2> REFL_ATTR Graphics::Vert) tex_size
-        REFL_DECL(Graphics::Uniform<Graphics::TexUnit> REFL_ATTR Graphics::Frag) texture
-        REFL_DECL(Graphics::Uniform<fmat4> REFL_ATTR Graphics::Frag) color_matrix
+        REFL_DECL(Graphics::Uniform<fvec2[max_texture_pages]> REFL_ATTR Graphics::Vert) tex_size
+        REFL_DECL(Graphics::Uniform<Graphics::TexUnit[max_texture_pages]> REFL_ATTR Graphics::Frag) texture
+        REFL_DECL(Graphics::Uniform<fvec2> REFL_ATTR Graphics::Vert) offset // For drawing the geometry.
     )
 
+    // Shared with the custom shaders, see `SharedUniformsDeclaration()`.
+    REFL_SIMPLE_STRUCT( SharedUniforms
+        REFL_DECL(fmat4) matrix
+        REFL_DECL(fmat4) color_matrix
+    )
+    static constexpr const char *shared_block_name = "RenderShared";
+
+    // Converts `Quad_t::sdf()` scale to the factor applied to the distance field alpha in the shader.
+    // It goes to the upper bits of the page, to not make the vertices larger. The limit makes it fit into the byte in `PackedAttribs`.
+    static constexpr int max_sdf_sharpness = (255 - (max_texture_pages - 1)) / max_texture_pages;
+    [[nodiscard]] static int SdfSharpness(float scale)
+    {
+        if (scale <= 0)
+            return 0;
+        return clamp(iround(255.f * Graphics::FontFile::sdf_spread * scale / 128), 1, max_sdf_sharpness);
+    }
+
     static constexpr const char *vertex_source = R"(
 varying vec4 v_color;
 varying vec2 v_texcoord;
 varying vec3 v_factors;
+varying float v_page;
+varying float v_sdf;
+varying vec4 v_tile;
 void main()
 {
-    gl_Position = u_matrix * vec4(a_pos, 0, 1);
+    float page = mod(a_page, 4.0);
+    vec2 tex_size = page < 0.5 ? u_tex_size[0] : page < 1.5 ? u_tex_size[1] : page < 2.5 ? u_tex_size[2] : u_tex_size[3];
+    gl_Position = u_matrix * vec4(a_pos + u_offset, 0, 1);
     v_color     = a_color;
-    v_texcoord  = a_texcoord / u_tex_size;
+    v_texcoord  = a_texcoord / tex_size;
     v_factors   = a_factors;
+    v_page      = page;
+    v_sdf       = floor(a_page / 4.0);
+    v_tile      = a_tile / tex_size.xyxy;
 })";
 
     static constexpr const char *fragment_source = R"(
 varying vec4 v_color;
 varying vec2 v_texcoord;
 varying vec3 v_factors;
+varying float v_page;
+varying float v_sdf;
+varying vec4 v_tile;
 void main()
 {
-    vec4 tex_color = texture2D(u_texture, v_texcoord);
+    // The textures use the nearest filtering and have no mipmaps, so the coordinates can jump at the tile edges.
+    vec2 texcoord = v_tile.z > 0.0 ? v_tile.xy + mod(v_texcoord - v_tile.xy, v_tile.zw) : v_texcoord;
+
+    // The sampler arrays can only be indexed by constants. All vertices of a primitive have the same page, so the branches are coherent.
+    // The textures have no mipmaps, so sampling in a branch is fine.
+    vec4 tex_color;
+    if (v_page < 0.5)
+        tex_color = texture2D(u_texture[0], texcoord);
+    else if (v_page < 1.5)
+        tex_color = texture2D(u_texture[1], texcoord);
+    else if (v_page < 2.5)
+        tex_color = texture2D(u_texture[2], texcoord);
+    else
+        tex_color = texture2D(u_texture[3], texcoord);
+    // A distance field has 128 on the edge.
+    if (v_sdf > 0.5)
+        tex_color.a = clamp((tex_color.a - 128.0 / 255.0) * v_sdf + 0.5, 0.0, 1.0);
     gl_FragColor = vec4(mix(v_color.rgb, tex_color.rgb, v_factors.x),
                         mix(v_color.a  , tex_color.a  , v_factors.y));
     vec4 result = u_color_matrix * vec4(gl_FragColor.rgb, 1);
@@ -48,11 +144,194 @@ void main()
     gl_FragColor.a *= v_factors.z;
 })";
 
-    Graphics::SimpleRenderQueue<Attribs, 3> queue; // Note that the queue has to be the first field.
+    Graphics::QuadRenderQueue<Attribs> queue; // Note that the queue has to be the first field. This is null if `packed` is true.
+    Graphics::QuadRenderQueue<PackedAttribs> packed_queue; // This is null if `packed` is false.
+    bool packed = false;
     Uniforms uni;
     Graphics::Shader shader;
+    Graphics::UniformBlock<SharedUniforms> shared_block;
+
+    // The contents of `shared_block`.
+    fmat4 matrix;
+    fmat4 color_matrix;
+
+    // Copies of `uni.texture` and `uni.tex_size`, to skip the flushes when nothing changes. The units are `-1` until set.
+    int page_units[max_texture_pages] = {-1, -1, -1, -1};
+    fvec2 page_sizes[max_texture_pages] = {};
+
+    std::vector<Attribs> captured; // The primitives recorded between `BeginCapture()` and `EndCapture()`.
+    bool capturing = false;
+
+    // The primitives collected between `BeginLayers()` and `EndLayers()`. They're sorted as the indices, to not move the vertices around.
+    struct LayeredPrimitive
+    {
+        int layer = 0;
+        std::uint32_t first_vertex = 0; // In `layered_vertices`.
+        bool is_quad = false; // Otherwise a triangle.
+    };
+    std::vector<Attribs> layered_vertices;
+    std::vector<LayeredPrimitive> layered;
+    bool layering = false;
+    int current_layer = 0;
+    int min_layer = 0; // Set by `SubmitLayersBelow()`, for the assertions.
+
+    std::function<void()> before_finish;
+
+    // `stats` is the current frame. The queue stats are added to it in `BeginFrame()`.
+    Stats stats, last_frame_stats;
+
+    [[nodiscard]] static std::string SharedUniformsDeclaration()
+    {
+        return Graphics::UniformBlock<SharedUniforms>::Declaration(shared_block_name);
+    }
+
+    void UploadSharedUniforms()
+    {
+        shared_block.Set({.matrix = matrix, .color_matrix = color_matrix});
+    }
+
+    [[nodiscard]] const Graphics::RenderQueueStats &QueueStats() const
+    {
+        return packed ? packed_queue.Stats() : queue.Stats();
+    }
+
+    // Flushes the queue, and if it drew something, increments `counter`.
+    void Flush(int Stats::*counter)
+    {
+        if (before_finish)
+            before_finish();
+
+        // Those do nothing if already bound. The custom shaders could've changed them.
+        shader.Bind();
+        shared_block.Bind();
+
+        std::size_t old_flushes = QueueStats().flushes;
+        if (packed)
+            packed_queue.Flush();
+        else
+            queue.Flush();
+        if (QueueStats().flushes != old_flushes)
+            stats.*counter += 1;
+    }
+
+    Data(std::size_t queue_size, const Graphics::ShaderConfig &config, Graphics::StreamingMode streaming_mode, VertexFormat vertex_format)
+        : packed(vertex_format == VertexFormat::packed),
+        shader(packed
+            ? Graphics::Shader("Main (packed)", config, Graphics::ShaderPreferences{}, Meta::tag<PackedAttribs>{}, uni, SharedUniformsDeclaration() + vertex_source, SharedUniformsDeclaration() + fragment_source)
+            : Graphics::Shader("Main", config, Graphics::ShaderPreferences{}, Meta::tag<Attribs>{}, uni, SharedUniformsDeclaration() + vertex_source, SharedUniformsDeclaration() + fragment_source)),
+        shared_block(shared_block_binding_point)
+    {
+        shared_block.Attach(shader, shared_block_name);
+        UploadSharedUniforms();
+
+        if (packed)
+            packed_queue = decltype(packed_queue)(queue_size, streaming_mode);
+        else
+            queue = decltype(queue)(queue_size, streaming_mode);
+    }
+
+    [[nodiscard]] static PackedAttribs Pack(const Attribs &v)
+    {
+        PackedAttribs ret;
+        ret.pos = v.pos;
+        ret.color = iround(clamp(v.color) * 255);
+        ret.texcoord = iround(clamp(v.texcoord, 0, 0xffff));
+        ret.factors = iround(clamp(v.factors) * 255);
+        ret.page = std::uint8_t(v.page);
+        ret.tile = iround(clamp(v.tile, 0, 0xffff));
+        return ret;
+    }
+
+    void QueueTriangle(const Attribs &a, const Attribs &b, const Attribs &c)
+    {
+        if (packed)
+            packed_queue.Add(Pack(a), Pack(b), Pack(c));
+        else
+            queue.Add(a, b, c);
+    }
 
-    Data(std::size_t queue_size, const Graphics::ShaderConfig &config) : queue(queue_size), shader("Main", config, Graphics::ShaderPreferences{}, Meta::tag<Attribs>{}, uni, vertex_source, fragment_source) {}
+    void QueueQuad(const Attribs &a, const Attribs &b, const Attribs &c, const Attribs &d)
+    {
+        if (packed)
+            packed_queue.Add(Pack(a), Pack(b), Pack(c), Pack(d));
+        else
+            queue.Add(a, b, c, d);
+    }
+
+    void AddLayered(std::initializer_list<Attribs> vertices)
+    {
+        ASSERT(current_layer >= min_layer, "2D poly renderer: Drawing to a layer that was already submitted.");
+        layered.push_back({.layer = current_layer, .first_vertex = std::uint32_t(layered_vertices.size()), .is_quad = vertices.size() == 4});
+        layered_vertices.insert(layered_vertices.end(), vertices);
+    }
+
+    // Queues the collected primitives with layers less than `layer`, or all of them if `layer` is empty.
+    void SubmitLayers(std::optional<int> layer)
+    {
+        // The vertex index breaks the ties, which keeps the drawing order within a layer.
+        std::sort(layered.begin(), layered.end(), [](const LayeredPrimitive &a, const LayeredPrimitive &b)
+        {
+            return a.layer != b.layer ? a.layer < b.layer : a.first_vertex < b.first_vertex;
+        });
+
+        auto end = !layer ? layered.end() : std::find_if(layered.begin(), layered.end(), [&](const LayeredPrimitive &prim){return prim.layer >= *layer;});
+        for (auto it = layered.begin(); it != end; ++it)
+        {
+            const Attribs *v = layered_vertices.data() + it->first_vertex;
+            if (it->is_quad)
+                QueueQuad(v[0], v[1], v[2], v[3]);
+            else
+                QueueTriangle(v[0], v[1], v[2]);
+        }
+        layered.erase(layered.begin(), end);
+        if (layered.empty())
+            layered_vertices.clear();
+    }
+
+    // `queue_ptr` is what `GetRenderQueuePtr()` returns. This relies on the queue being the first field.
+    static void AddTriangle(void *queue_ptr, const Attribs &a, const Attribs &b, const Attribs &c)
+    {
+        Data &self = *reinterpret_cast<Data *>(queue_ptr);
+        if (self.capturing)
+        {
+            self.captured.push_back(a);
+            self.captured.push_back(b);
+            self.captured.push_back(c);
+        }
+        else if (self.layering)
+        {
+            self.AddLayered({a, b, c});
+        }
+        else
+        {
+            self.QueueTriangle(a, b, c);
+        }
+    }
+
+    static void AddQuad(void *queue_ptr, const Attribs &a, const Attribs &b, const Attribs &c, const Attribs &d)
+    {
+        Data &self = *reinterpret_cast<Data *>(queue_ptr);
+        if (self.capturing)
+        {
+            // Same vertex order as in the queue.
+            AddTriangle(queue_ptr, a, b, d);
+            AddTriangle(queue_ptr, d, b, c);
+        }
+        else if (self.layering)
+        {
+            self.AddLayered({a, b, c, d});
+        }
+        else
+        {
+            self.QueueQuad(a, b, c, d);
+        }
+    }
+};
+
+struct Render::Geometry::Data
+{
+    Graphics::VertexBuffer<Render::Data::Attribs> buffer;
+    int vertex_count = 0;
 };
 
 void *Render::GetRenderQueuePtr()
@@ -63,10 +342,13 @@ void *Render::GetRenderQueuePtr()
 Render::Render() {}
 
 Render::Render(std::size_t queue_size, const Graphics::ShaderConfig &config)
+    : Render(queue_size, config, Graphics::StreamingMode::single_buffer)
+{}
+
+Render::Render(std::size_t queue_size, const Graphics::ShaderConfig &config, Graphics::StreamingMode streaming_mode, VertexFormat vertex_format)
 {
-    data = std::make_unique<Data>(queue_size, config);
-    SetMatrix(fmat4());
-    SetColorMatrix(fmat4());
+    data = std::make_unique<Data>(queue_size, config, streaming_mode, vertex_format);
+    data->uni.offset = fvec2(0);
 }
 
 Render::Render(Render &&) noexcept = default;
@@ -85,37 +367,227 @@ void Render::BindShader() const
 
 void Render::Finish()
 {
-    data->queue.Flush();
+    data->Flush(&Stats::finish_flushes);
+}
+
+void Render::BeginFrame()
+{
+    const Graphics::RenderQueueStats &queue_stats = data->QueueStats();
+    Stats &stats = data->stats;
+    stats.full_flushes = int(queue_stats.full_flushes);
+    stats.draw_calls += int(queue_stats.flushes);
+    stats.primitives = queue_stats.primitives;
+    stats.vertices += queue_stats.vertices;
+    stats.bytes_uploaded = queue_stats.bytes;
+
+    data->last_frame_stats = stats;
+    stats = {};
+    if (data->packed)
+        data->packed_queue.ResetStats();
+    else
+        data->queue.ResetStats();
+}
+
+const Render::Stats &Render::LastFrameStats() const
+{
+    return data->last_frame_stats;
+}
+
+void Render::SetBeforeFinishFunc(std::function<void()> func)
+{
+    data->before_finish = std::move(func);
 }
 
 void Render::SetTextureUnit(const Graphics::TexUnit &unit)
 {
-    Finish();
-    data->uni.texture = unit;
+    SetTexturePageUnit(0, unit);
 }
 
 void Render::SetTextureSize(ivec2 size)
 {
-    Finish();
-    data->uni.tex_size = size;
+    SetTexturePageSize(0, size);
 }
 
 void Render::SetTexture(const Graphics::Texture &tex)
 {
-    SetTextureUnit(tex);
-    SetTextureSize(tex.Size());
+    SetTexturePage(0, tex);
+}
+
+void Render::SetTexturePageUnit(int page, const Graphics::TexUnit &unit)
+{
+    ASSERT(page >= 0 && page < max_texture_pages, "2D poly renderer: Texture page is out of range.");
+    if (data->page_units[page] == unit.Index())
+        return;
+    ASSERT(!data->layering, "2D poly renderer: Can't change the texture while collecting the layers.");
+    data->stats.state_changes++;
+    data->Flush(&Stats::state_flushes);
+    data->page_units[page] = unit.Index();
+    data->uni.texture.set(data->page_units + page, 1, page);
+}
+
+void Render::SetTexturePageSize(int page, ivec2 size)
+{
+    ASSERT(page >= 0 && page < max_texture_pages, "2D poly renderer: Texture page is out of range.");
+    if (data->page_sizes[page] == fvec2(size))
+        return;
+    ASSERT(!data->layering, "2D poly renderer: Can't change the texture while collecting the layers.");
+    data->stats.state_changes++;
+    data->Flush(&Stats::state_flushes);
+    data->page_sizes[page] = size;
+    data->uni.tex_size.set(data->page_sizes + page, 1, page);
+}
+
+void Render::SetTexturePage(int page, const Graphics::Texture &tex)
+{
+    SetTexturePageUnit(page, tex);
+    SetTexturePageSize(page, tex.Size());
+}
+
+// The matrices don't have `==`, so we compare the bytes.
+[[nodiscard]] static bool SameMatrix(const fmat4 &a, const fmat4 &b)
+{
+    return std::memcmp(&a, &b, sizeof(fmat4)) == 0;
 }
 
 void Render::SetMatrix(const fmat4 &m)
 {
-    Finish();
-    data->uni.matrix = m;
+    if (SameMatrix(data->matrix, m))
+        return;
+    ASSERT(!data->layering, "2D poly renderer: Can't change the matrix while collecting the layers.");
+    data->stats.state_changes++;
+    data->Flush(&Stats::state_flushes);
+    data->matrix = m;
+    data->UploadSharedUniforms();
 }
 
 void Render::SetColorMatrix(const fmat4 &m)
 {
-    Finish();
-    data->uni.color_matrix = m;
+    if (SameMatrix(data->color_matrix, m))
+        return;
+    ASSERT(!data->layering, "2D poly renderer: Can't change the color matrix while collecting the layers.");
+    data->stats.state_changes++;
+    data->Flush(&Stats::state_flushes);
+    data->color_matrix = m;
+    data->UploadSharedUniforms();
+}
+
+std::string Render::SharedUniformsDeclaration()
+{
+    return Data::SharedUniformsDeclaration();
+}
+
+void Render::AttachSharedUniforms(const Graphics::Shader &shader) const
+{
+    data->shared_block.Attach(shader, Data::shared_block_name);
+}
+
+void Render::BindSharedUniforms() const
+{
+    data->shared_block.Bind();
+}
+
+const fmat4 &Render::GetMatrix() const
+{
+    return data->matrix;
+}
+
+const fmat4 &Render::GetColorMatrix() const
+{
+    return data->color_matrix;
+}
+
+Render::Geometry::Geometry() {}
+Render::Geometry::Geometry(Geometry &&) noexcept = default;
+Render::Geometry &Render::Geometry::operator=(Geometry &&) noexcept = default;
+Render::Geometry::~Geometry() = default;
+
+Render::Geometry::operator bool() const
+{
+    return bool(data);
+}
+
+std::size_t Render::Geometry::EstimateOwnedMemory() const
+{
+    return data ? sizeof(Data) + std::size_t(data->buffer.Size()) * sizeof(Render::Data::Attribs) : 0;
+}
+
+void Render::BeginCapture()
+{
+    ASSERT(!data->capturing, "2D poly renderer: Nested geometry capture.");
+    ASSERT(!data->layering, "2D poly renderer: Can't capture geometry while collecting the layers.");
+    data->Flush(&Stats::state_flushes);
+    data->capturing = true;
+    data->captured.clear();
+}
+
+void Render::EndCapture(Geometry &target)
+{
+    ASSERT(data->capturing, "2D poly renderer: Geometry capture wasn't started.");
+    data->capturing = false;
+
+    if (!target.data)
+        target.data = std::make_unique<Geometry::Data>();
+    Geometry::Data &geom = *target.data;
+
+    int count = int(data->captured.size());
+    if (count == 0)
+    {
+        geom.vertex_count = 0;
+        return;
+    }
+
+    if (!geom.buffer)
+        geom.buffer = Graphics::VertexBuffer<Data::Attribs>(count, data->captured.data());
+    else if (geom.buffer.Size() >= count)
+        geom.buffer.SetDataPart(0, count, data->captured.data());
+    else
+        geom.buffer.SetData(count, data->captured.data());
+    geom.vertex_count = count;
+}
+
+void Render::Draw(const Geometry &geometry, fvec2 offset)
+{
+    ASSERT(!data->capturing, "2D poly renderer: Can't draw geometry while capturing.");
+    ASSERT(!data->layering, "2D poly renderer: Can't draw geometry while collecting the layers.");
+    if (!geometry.data || geometry.data->vertex_count == 0)
+        return;
+
+    data->Flush(&Stats::state_flushes);
+    data->uni.offset = offset;
+    geometry.data->buffer.Draw(Graphics::triangles, geometry.data->vertex_count);
+    data->stats.draw_calls++;
+    data->stats.geometry_draws++;
+    data->stats.vertices += std::size_t(geometry.data->vertex_count);
+    data->uni.offset = fvec2(0);
+}
+
+void Render::BeginLayers()
+{
+    ASSERT(!data->layering, "2D poly renderer: Nested `BeginLayers()`.");
+    ASSERT(!data->capturing, "2D poly renderer: Can't collect the layers while capturing.");
+    data->layering = true;
+    data->current_layer = 0;
+    data->min_layer = std::numeric_limits<int>::min();
+}
+
+void Render::SetLayer(int layer)
+{
+    ASSERT(data->layering, "2D poly renderer: `SetLayer()` without `BeginLayers()`.");
+    data->current_layer = layer;
+}
+
+void Render::SubmitLayersBelow(int layer)
+{
+    ASSERT(data->layering, "2D poly renderer: `SubmitLayersBelow()` without `BeginLayers()`.");
+    data->SubmitLayers(layer);
+    clamp_var_min(data->min_layer, layer);
+}
+
+void Render::EndLayers()
+{
+    ASSERT(data->layering, "2D poly renderer: `EndLayers()` without `BeginLayers()`.");
+    data->SubmitLayers({});
+    data->layering = false;
 }
 
 Render::Quad_t::~Quad_t()
@@ -163,7 +635,12 @@ Render::Quad_t::~Quad_t()
     }
 
     for (int i = 0; i < 4; i++)
+    {
         out[i].factors.z = data.beta[i];
+        out[i].page = data.page + max_texture_pages * Render::Data::SdfSharpness(data.sdf_scale);
+        if (data.has_tile)
+            out[i].tile = data.tile_pos.to_vec4(data.tile_size.x, data.tile_size.y);
+    }
 
     if (data.flip_x)
     {
@@ -180,28 +657,24 @@ Render::Quad_t::~Quad_t()
             data.center.y = data.size.y - data.center.y;
     }
 
-    out[0].pos = -data.center;
-    out[2].pos = data.size - data.center;
-    out[1].pos = fvec2(out[2].pos.x, out[0].pos.y);
-    out[3].pos = fvec2(out[0].pos.x, out[2].pos.y);
+    fvec2 corners[4];
+    corners[0] = -data.center;
+    corners[2] = data.size - data.center;
+    corners[1] = fvec2(corners[2].x, corners[0].y);
+    corners[3] = fvec2(corners[0].x, corners[2].y);
 
     if (data.has_matrix)
-    {
-        for (auto &it : out)
-            it.pos = data.pos + (data.matrix * it.pos.to_vec3(1)).to_vec2();
-    }
-    else
-    {
-        for (auto &it : out)
-            it.pos += data.pos;
-    }
+        transform_points(data.matrix, corners, corners);
+
+    for (int i = 0; i < 4; i++)
+        out[i].pos = data.pos + corners[i];
 
     out[0].texcoord = data.tex_pos;
     out[2].texcoord = data.tex_pos + data.tex_size;
     out[1].texcoord = {out[2].texcoord.x, out[0].texcoord.y};
     out[3].texcoord = {out[0].texcoord.x, out[2].texcoord.y};
 
-    ((decltype(Render::Data::queue) *)queue)->Add(out[0], out[1], out[2], out[3]);
+    Render::Data::AddQuad(queue, out[0], out[1], out[2], out[3]);
 }
 
 Render::Triangle_t::~Triangle_t()
@@ -233,7 +706,10 @@ Render::Triangle_t::~Triangle_t()
     }
 
     for (int i = 0; i < 3; i++)
+    {
         out[i].factors.z = data.beta[i];
+        out[i].page = data.page;
+    }
 
     for (int i = 0; i < 3; i++)
     {
@@ -247,49 +723,139 @@ Render::Triangle_t::~Triangle_t()
             it.pos = (data.matrix * it.pos.to_vec3(1)).to_vec2();
     }
 
-    ((decltype(Render::Data::queue) *)queue)->Add(out[0], out[1], out[2]);
+    Render::Data::AddTriangle(queue, out[0], out[1], out[2]);
 }
 
-Render::Text_t::~Text_t()
+Render::Sprite_t::~Sprite_t()
 {
-    if (!renderer)
+    if (!queue)
         return;
 
-    Graphics::Text::Stats stats = data.text.ComputeStats();
+    Render::Data::Attribs out[4];
+
+    fvec4 color;
+    fvec3 factors;
+    if (data.has_texture)
+    {
+        color = fvec4(0);
+        factors = fvec3(1, data.alpha, data.beta);
+    }
+    else
+    {
+        color = data.color.to_vec4(data.alpha);
+        factors = fvec3(0, 0, data.beta);
+    }
 
-    ivec2 align_box(data.has_box_alignment ? data.align_box_x : data.align.x, data.align.y);
+    fvec2 tex_a = data.tex_pos, tex_b = data.tex_pos + data.size;
+    if (data.flip_x)
+    {
+        std::swap(tex_a.x, tex_b.x);
+        data.center.x = data.size.x - data.center.x;
+    }
+    if (data.flip_y)
+    {
+        std::swap(tex_a.y, tex_b.y);
+        data.center.y = data.size.y - data.center.y;
+    }
+    if (!data.has_texture)
+        tex_a = tex_b = fvec2(0);
 
-    fvec2 pos = data.pos;
+    fvec2 a = data.pos - data.center, b = a + data.size;
 
-    fvec2 offset = -stats.size * (1 + align_box) / 2;
-    offset.x += stats.size.x * (1 + data.align.x) / 2; // Note that we don't change vertical position here.
+    out[0].pos = a;
+    out[1].pos = fvec2(b.x, a.y);
+    out[2].pos = b;
+    out[3].pos = fvec2(a.x, b.y);
 
-    float line_start_offset_x = offset.x;
+    out[0].texcoord = tex_a;
+    out[1].texcoord = fvec2(tex_b.x, tex_a.y);
+    out[2].texcoord = tex_b;
+    out[3].texcoord = fvec2(tex_a.x, tex_b.y);
 
-    for (size_t line_index = 0; line_index < data.text.lines.size(); line_index++)
+    for (auto &it : out)
     {
-        const Graphics::Text::Line &line = data.text.lines[line_index];
-        const Graphics::Text::Stats::Line &line_stats = stats.lines[line_index];
+        it.color = color;
+        it.factors = factors;
+        it.page = data.page;
+    }
 
-        offset.x = line_start_offset_x - line_stats.width * (1 + data.align.x) / 2;
-        offset.y += line_stats.ascent;
+    Render::Data::AddQuad(queue, out[0], out[1], out[2], out[3]);
+}
 
-        for (const Graphics::Text::Symbol &symbol : line.symbols)
-        {
-            fvec2 symbol_pos;
+Render::Text_t::~Text_t()
+{
+    if (!renderer)
+        return;
 
-            if (!data.has_matrix)
-                symbol_pos = pos + offset + symbol.offset;
-            else
-                symbol_pos = pos + (data.matrix * (offset + symbol.offset).to_vec3(1)).to_vec2();
+    // The average scale of the matrix, to adjust the distance field sharpness.
+    float sdf_matrix_scale = 1;
+    if (data.has_matrix)
+        sdf_matrix_scale = std::sqrt(abs(data.matrix.x.x * data.matrix.y.y - data.matrix.y.x * data.matrix.x.y));
 
-            auto quad = renderer->fquad(symbol_pos, symbol.size).tex(symbol.texture_pos).color(data.color).mix(0).alpha(data.alpha).beta(data.beta);
-            if (data.has_matrix)
-                quad.matrix(data.matrix.to_mat2()).pixel_center(fvec2(0));
+    LayOutText(data.text, data.align, data.has_box_alignment ? data.align_box_x : data.align.x, [&](fvec2 offset, const Graphics::Text::Symbol &symbol)
+    {
+        fvec2 symbol_pos;
+
+        if (!data.has_matrix)
+            symbol_pos = data.pos + offset;
+        else
+            symbol_pos = data.pos + (data.matrix * offset.to_vec3(1)).to_vec2();
+
+        auto quad = renderer->fquad(symbol_pos, symbol.size).tex(symbol.texture_pos).color(data.color).mix(0).alpha(data.alpha).beta(data.beta);
+        if (data.has_matrix)
+            quad.matrix(data.matrix.to_mat2()).pixel_center(fvec2(0));
+        if (data.sdf_scale > 0)
+            quad.sdf(data.sdf_scale * sdf_matrix_scale);
+    });
+}
 
-            offset.x += symbol.advance + symbol.kerning;
+const Render::TextCache::Layout &Render::TextCache::Get(const Graphics::Font &font, std::string_view str, ivec2 align, int align_box_x)
+{
+    auto it = layouts.find(std::tuple(&font, align.x, align.y, align_box_x, str));
+    if (it == layouts.end())
+    {
+        it = layouts.try_emplace(key_t(&font, align.x, align.y, align_box_x, std::string(str))).first;
+    }
+    else if (it->second.glyph_generation == font.GlyphGeneration())
+    {
+        // A glyph cache evicts glyphs that weren't looked up recently, so mark them as used.
+        if (font.HasGlyphFunc())
+        {
+            for (const Glyph &glyph : it->second.glyphs)
+                (void)font.Get(glyph.ch);
         }
 
-        offset.y += line_stats.descent + line_stats.line_gap;
+        it->second.last_used_frame = frame;
+        return it->second;
+    }
+
+    Layout &layout = it->second;
+    layout.glyphs.clear();
+    LayOutText(Graphics::Text(font, str), align, align_box_x, [&](fvec2 offset, const Graphics::Text::Symbol &symbol)
+    {
+        layout.glyphs.push_back({.offset = offset, .size = symbol.size, .tex_pos = symbol.texture_pos, .ch = symbol.ch});
+    });
+    layout.glyph_generation = font.GlyphGeneration(); // After the layout, since it can evict glyphs.
+    layout.last_used_frame = frame;
+    return layout;
+}
+
+void Render::TextCache::BeginFrame()
+{
+    frame++;
+    erase_if(layouts, [&](const auto &elem){return frame - elem.second.last_used_frame > max_unused_frames;});
+}
+
+Render::CachedText_t::~CachedText_t()
+{
+    if (!renderer)
+        return;
+
+    const TextCache::Layout &layout = data.cache->Get(*data.font, data.str, data.align, data.has_box_alignment ? data.align_box_x : data.align.x);
+    for (const TextCache::Glyph &glyph : layout.glyphs)
+    {
+        auto quad = renderer->fquad(data.pos + glyph.offset, glyph.size).tex(glyph.tex_pos).color(data.color).mix(0).alpha(data.alpha).beta(data.beta);
+        if (data.sdf_scale > 0)
+            quad.sdf(data.sdf_scale);
     }
 }
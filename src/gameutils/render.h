@@ -1,15 +1,23 @@
 #pragma once
 
+#include <functional>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 #include "graphics/text.h"
 #include "graphics/texture_atlas.h"
 #include "program/errors.h"
+#include "utils/flat_hash.h"
 #include "utils/mat.h"
 
 namespace Graphics
 {
+    enum class StreamingMode;
+    class Shader;
     struct ShaderConfig;
     class TexUnit;
     class Texture;
@@ -24,7 +32,15 @@ class Render
 
   public:
     Render();
+    enum class VertexFormat
+    {
+        full, // Floating-point attributes.
+        packed, // Normalized 8-bit colors and mixing factors, 16-bit integer texture coordinates. The positions stay floating-point.
+    };
+
+    // The queue size is measured in quads. Triangles take as much space as quads.
     Render(std::size_t queue_size, const Graphics::ShaderConfig &config);
+    Render(std::size_t queue_size, const Graphics::ShaderConfig &config, Graphics::StreamingMode streaming_mode, VertexFormat vertex_format = VertexFormat::full);
 
     Render(Render &&) noexcept;
     Render &operator=(Render &&) noexcept;
@@ -36,6 +52,38 @@ class Render
 
     void Finish();
 
+    // What the renderer did during a frame. For verifying the batching.
+    struct Stats
+    {
+        // The flushes that drew something, by cause.
+        int finish_flushes = 0; // `Finish()` was called.
+        int state_flushes = 0; // Changing a texture or a matrix, capturing or drawing geometry.
+        int full_flushes = 0; // The queue was full.
+
+        int state_changes = 0; // Texture and matrix changes, including the ones that didn't need to flush.
+
+        int draw_calls = 0; // All flushes, plus the geometry draws.
+        int geometry_draws = 0;
+
+        std::size_t primitives = 0; // Quads and triangles, excluding the geometry.
+        std::size_t vertices = 0;
+        std::size_t bytes_uploaded = 0; // Excluding the geometry capture.
+
+        [[nodiscard]] int Flushes() const {return finish_flushes + state_flushes + full_flushes;}
+    };
+
+    // Starts counting the stats for a new frame. Call this once per frame, then `LastFrameStats()` returns the previous frame.
+    void BeginFrame();
+    [[nodiscard]] const Stats &LastFrameStats() const;
+
+    // Called at the beginning of every `Finish()`, before drawing. E.g. to upload the changed parts of the texture.
+    void SetBeforeFinishFunc(std::function<void()> func);
+
+    // The number of textures that can be used in the same batch. Each primitive selects one with `.page(i)`, the default is 0.
+    // Changing the texture of a page flushes the queue, but drawing from different pages doesn't.
+    static constexpr int max_texture_pages = 4;
+
+    // Those set page 0.
     void SetTextureUnit(const Graphics::TexUnit &unit);
     void SetTextureUnit(Graphics::TexUnit &&) = delete;
 
@@ -44,17 +92,80 @@ class Render
     void SetTexture(const Graphics::Texture &tex);
     void SetTexture(Graphics::Texture &&) = delete;
 
+    void SetTexturePageUnit(int page, const Graphics::TexUnit &unit);
+    void SetTexturePageUnit(int page, Graphics::TexUnit &&) = delete;
+
+    void SetTexturePageSize(int page, ivec2 size);
+
+    void SetTexturePage(int page, const Graphics::Texture &tex);
+    void SetTexturePage(int page, Graphics::Texture &&) = delete;
+
     void SetMatrix(const fmat4 &m);
 
     void SetColorMatrix(const fmat4 &m);
 
+    // Those are needed to draw with custom shaders that should match this renderer.
+    [[nodiscard]] const fmat4 &GetMatrix() const;
+    [[nodiscard]] const fmat4 &GetColorMatrix() const;
+
+    // The matrices are stored in a uniform block, which the custom shaders can use instead of their own uniforms.
+    // Prepend `SharedUniformsDeclaration()` to both shader sources to get `u_matrix` and `u_color_matrix`, call `AttachSharedUniforms()` once after creating the shader,
+    // and `BindSharedUniforms()` before drawing with it, in case a different renderer was used in between.
+    static constexpr int shared_block_binding_point = 0;
+    [[nodiscard]] static std::string SharedUniformsDeclaration();
+    void AttachSharedUniforms(const Graphics::Shader &shader) const;
+    void BindSharedUniforms() const;
+
+    // Static geometry that can be drawn repeatedly without rebuilding it every frame.
+    // Fill it using `BeginCapture()` and `EndCapture()`.
+    class Geometry
+    {
+        friend class Render;
+
+        struct Data;
+        std::unique_ptr<Data> data;
+
+      public:
+        Geometry();
+        Geometry(Geometry &&) noexcept;
+        Geometry &operator=(Geometry &&) noexcept;
+        ~Geometry();
+
+        // True if the geometry was captured at least once, even if it ended up empty.
+        explicit operator bool() const;
+
+        // The vertex buffer size, for `Refl::EstimateMemory()`.
+        [[nodiscard]] std::size_t EstimateOwnedMemory() const;
+    };
+
+    // Until `EndCapture()` is called, the quads and triangles are recorded instead of being drawn.
+    void BeginCapture();
+    // Stores the primitives recorded since `BeginCapture()` into `target`, replacing its old contents. Reuses the GPU buffer if possible.
+    void EndCapture(Geometry &target);
+
+    // Draws captured geometry, moved by `offset`.
+    void Draw(const Geometry &geometry, fvec2 offset = fvec2(0));
+
+    // Deferred layers, to make the draw order declarative.
+    // Between `BeginLayers()` and `EndLayers()`, the quads and triangles are collected instead of being queued, each tagged with the current `SetLayer()`.
+    // `EndLayers()` queues them sorted by layer. Within a layer, they keep the order in which they were drawn.
+    // The textures and the matrices must not change in between, and `Draw()` and the captures are not allowed.
+    // Drawing with custom shaders is fine after `SubmitLayersBelow()` and `Finish()`.
+    void BeginLayers();
+    // Affects the primitives drawn after this. The default is 0.
+    void SetLayer(int layer);
+    // Queues the collected primitives with layers less than `layer`, sorted, and keeps collecting the rest. Anything collected later must have a layer at least `layer`.
+    void SubmitLayersBelow(int layer);
+    // Queues the rest of the collected primitives, and stops collecting.
+    void EndLayers();
+
     class Quad_t
     {
         friend class Render;
 
         using ref = Quad_t &&;
 
-        void *queue = 0; // Actually the type should be `Graphics::SimpleRenderQueue<Attribs, 3> *`, but we don't include "graphics/simple_render_queue.h" for better compilation times.
+        void *queue = 0; // Actually the type should be `Graphics::QuadRenderQueue<Attribs> *`, but we don't include "graphics/quad_render_queue.h" for better compilation times.
 
         struct Data
         {
@@ -83,6 +194,13 @@ class Render
             bool abs_tex_pos = 0;
 
             bool flip_x = 0, flip_y = 0;
+
+            int page = 0;
+
+            bool has_tile = 0;
+            fvec2 tile_pos = fvec2(0), tile_size = fvec2(0);
+
+            float sdf_scale = 0; // Zero if the texture is not a distance field.
         };
         Data data;
 
@@ -265,6 +383,28 @@ class Render
             data.flip_y = f;
             return (ref)*this;
         }
+        ref page(int p) // Selects the texture, see `max_texture_pages`.
+        {
+            ASSERT(p >= 0 && p < max_texture_pages, "2D poly renderer: Texture page is out of range.");
+            data.page = p;
+            return (ref)*this;
+        }
+        ref tile(fvec2 pos, fvec2 size) // Repeats this texture region. The texture coordinates outside of it wrap around, so one quad can cover many tiles.
+        {
+            ASSERT(!data.has_tile, "2D poly renderer: Quad_t tile specified twice.");
+            ASSERT((size > 0).all(), "2D poly renderer: Quad_t tile size must be positive.");
+            data.has_tile = 1;
+
+            data.tile_pos = pos;
+            data.tile_size = size;
+            return (ref)*this;
+        }
+        ref sdf(float scale = 1) // The texture alpha is a signed distance field, see `FontFile::sdf`. `scale` is the number of screen pixels per texel, the matrix isn't accounted for.
+        {
+            ASSERT(scale > 0, "2D poly renderer: Quad_t distance field scale must be positive.");
+            data.sdf_scale = scale;
+            return (ref)*this;
+        }
     };
 
     class Triangle_t
@@ -273,7 +413,7 @@ class Render
 
         using ref = Triangle_t &&;
 
-        void *queue = 0; // Actually the type should be `Graphics::SimpleRenderQueue<Attribs, 3> *`, but we don't include "graphics/simple_render_queue.h" for better compilation times.
+        void *queue = 0; // Actually the type should be `Graphics::QuadRenderQueue<Attribs> *`, but we don't include "graphics/quad_render_queue.h" for better compilation times.
 
         struct Data
         {
@@ -293,6 +433,8 @@ class Render
 
             float alpha[3] = {1,1,1};
             float beta[3] = {1,1,1};
+
+            int page = 0;
         };
         Data data;
 
@@ -411,6 +553,101 @@ class Render
             data.beta[2] = c;
             return (ref)*this;
         }
+        ref page(int p) // Selects the texture, see `max_texture_pages`.
+        {
+            ASSERT(p >= 0 && p < max_texture_pages, "2D poly renderer: Texture page is out of range.");
+            data.page = p;
+            return (ref)*this;
+        }
+    };
+
+    // A simplified quad for the most common case: no matrix, and either a texture or a color, but not both.
+    // This skips most of the logic in `Quad_t`.
+    class Sprite_t
+    {
+        friend class Render;
+
+        using ref = Sprite_t &&;
+
+        void *queue = 0; // Same as in `Quad_t`.
+
+        struct Data
+        {
+            fvec2 pos, size; // The constructor sets these.
+
+            bool has_texture = 0;
+            fvec2 tex_pos = fvec2(0); // The texture size is always equal to `size`.
+
+            fvec3 color = fvec3(0);
+            fvec2 center = fvec2(0); // In pixels.
+
+            float alpha = 1;
+            float beta = 1;
+
+            bool flip_x = 0, flip_y = 0;
+
+            int page = 0;
+        };
+        Data data;
+
+        Sprite_t(void *queue, fvec2 pos, fvec2 size) : queue(queue)
+        {
+            data.pos = pos;
+            data.size = size;
+        }
+      public:
+        Sprite_t(Sprite_t &&other) noexcept : queue(std::exchange(other.queue, {})), data(std::move(other.data)) {}
+        Sprite_t &operator=(Sprite_t other) noexcept
+        {
+            std::swap(queue, other.queue);
+            std::swap(data, other.data);
+            return *this;
+        }
+
+        ~Sprite_t();
+
+        ref center(fvec2 c)
+        {
+            data.center = c;
+            return (ref)*this;
+        }
+        ref center()
+        {
+            center(data.size / 2);
+            return (ref)*this;
+        }
+        ref color(fvec3 c) // Only for untextured sprites.
+        {
+            ASSERT(!data.has_texture, "2D poly renderer: Sprite_t can't have both a texture and a color.");
+            data.color = c;
+            return (ref)*this;
+        }
+        ref alpha(float a)
+        {
+            data.alpha = a;
+            return (ref)*this;
+        }
+        ref beta(float b) // 1 - normal blending, 0 - additive blending
+        {
+            data.beta = b;
+            return (ref)*this;
+        }
+        ref flip_x(bool f = 1) // Flips texture horizontally if it was specified. Updates the center accordingly.
+        {
+            data.flip_x = f;
+            return (ref)*this;
+        }
+        ref flip_y(bool f = 1) // Flips texture vertically if it was specified. Updates the center accordingly.
+        {
+            data.flip_y = f;
+            return (ref)*this;
+        }
+        ref page(int p) // Selects the texture, see `max_texture_pages`.
+        {
+            ASSERT(p >= 0 && p < max_texture_pages, "2D poly renderer: Texture page is out of range.");
+            data.page = p;
+            return (ref)*this;
+        }
     };
 
     class Text_t
@@ -438,14 +675,13 @@ class Render
 
             bool has_matrix = 0;
             fmat3 matrix = {};
+
+            float sdf_scale = 0;
         };
         Data data;
 
-        Text_t(Render *renderer, fvec2 pos, Graphics::Text text) : renderer(renderer)
-        {
-            data.pos = pos;
-            data.text = std::move(text);
-        }
+        // Move-constructing the text rather than assigning it, to keep its memory resource.
+        Text_t(Render *renderer, fvec2 pos, Graphics::Text text) : renderer(renderer), data{.pos = pos, .text = std::move(text)} {}
       public:
         Text_t(Text_t &&other) noexcept : renderer(std::exchange(other.renderer, {})), data(std::move(other.data)) {}
         Text_t &operator=(Text_t other)
@@ -536,10 +772,167 @@ class Render
             scale(fvec2(s));
             return (ref)*this;
         }
+        // For the fonts rendered with `FontFile::sdf`. The texture should use the linear filtering.
+        // `s` is the number of screen pixels per texel, not counting the matrix, which is accounted for automatically.
+        ref sdf(float s = 1)
+        {
+            ASSERT(s > 0, "2D poly renderer: Text_t distance field scale must be positive.");
+            data.sdf_scale = s;
+            return (ref)*this;
+        }
 
         ~Text_t();
     };
 
+    // Remembers the layouts of the recently drawn strings, so they aren't recomputed every frame. Use with `ctext()`.
+    // A layout depends on the string, the font, and the alignment. The position, color, alpha, and beta can change freely.
+    // Call `BeginFrame()` once per frame. The layouts that weren't used for a while are discarded.
+    class TextCache
+    {
+        friend class Render;
+
+        static constexpr int max_unused_frames = 60;
+
+        struct Glyph
+        {
+            fvec2 offset; // Relative to the text position.
+            fvec2 size;
+            fvec2 tex_pos;
+            uint32_t ch = 0;
+        };
+
+        struct Layout
+        {
+            std::vector<Glyph> glyphs;
+            int glyph_generation = 0; // `Font::GlyphGeneration()` at the moment of layout.
+            int last_used_frame = 0;
+        };
+
+        // Font, alignment (x, y, box x), string.
+        using key_t = std::tuple<const Graphics::Font *, int, int, int, std::string>;
+        // Transparent, to look up the keys with `std::string_view` instead of `std::string`. Those hash the same.
+        struct KeyHasher
+        {
+            using is_transparent = void;
+            template <typename T>
+            [[nodiscard]] std::size_t operator()(const T &key) const {return Hash::Compute(key);}
+        };
+        FlatMap<key_t, Layout, KeyHasher> layouts;
+        int frame = 0;
+
+        [[nodiscard]] const Layout &Get(const Graphics::Font &font, std::string_view str, ivec2 align, int align_box_x);
+
+      public:
+        TextCache() {}
+
+        void BeginFrame();
+
+        // The number of cached layouts, for debugging.
+        [[nodiscard]] std::size_t Count() const
+        {
+            return layouts.size();
+        }
+    };
+
+    // Text drawn through `TextCache`. Supports the same modifiers as `Text_t`, except for the matrices.
+    class CachedText_t
+    {
+        friend class Render;
+
+        using ref = CachedText_t &&;
+
+        Render *renderer = 0;
+
+        struct Data
+        {
+            // The constructor sets those:
+            TextCache *cache = nullptr;
+            fvec2 pos;
+            const Graphics::Font *font = nullptr;
+            std::string_view str; // The string must outlive this object. This holds for temporaries in the same full-expression.
+
+            ivec2 align = ivec2(0);
+
+            bool has_box_alignment = 0;
+            int align_box_x = 0;
+
+            fvec3 color = fvec3(1);
+            float alpha = 1;
+            float beta = 1;
+
+            float sdf_scale = 0;
+        };
+        Data data;
+
+        CachedText_t(Render *renderer, TextCache &cache, fvec2 pos, const Graphics::Font &font, std::string_view str) : renderer(renderer)
+        {
+            data.cache = &cache;
+            data.pos = pos;
+            data.font = &font;
+            data.str = str;
+        }
+      public:
+        CachedText_t(CachedText_t &&other) noexcept : renderer(std::exchange(other.renderer, {})), data(std::move(other.data)) {}
+        CachedText_t &operator=(CachedText_t other)
+        {
+            std::swap(renderer, other.renderer);
+            std::swap(data, other.data);
+            return *this;
+        }
+
+        ref color(fvec3 c)
+        {
+            data.color = c;
+            return (ref)*this;
+        }
+        ref alpha(float x)
+        {
+            data.alpha = x;
+            return (ref)*this;
+        }
+        ref beta(float x)
+        {
+            data.beta = x;
+            return (ref)*this;
+        }
+        ref align(ivec2 a)
+        {
+            data.align = sign(a);
+            return (ref)*this;
+        }
+        ref align_x(int x)
+        {
+            data.align.x = sign(x);
+            return (ref)*this;
+        }
+        ref align_y(int y)
+        {
+            data.align.y = sign(y);
+            return (ref)*this;
+        }
+        ref align_box_x(int x)
+        {
+            data.has_box_alignment = 1;
+            data.align_box_x = sign(x);
+            return (ref)*this;
+        }
+        ref align(ivec2 align_text, int align_box)
+        {
+            data.align = sign(align_text);
+            data.has_box_alignment = 1;
+            data.align_box_x = align_box;
+            return (ref)*this;
+        }
+        ref sdf(float s = 1) // See `Text_t::sdf()`.
+        {
+            ASSERT(s > 0, "2D poly renderer: CachedText_t distance field scale must be positive.");
+            data.sdf_scale = s;
+            return (ref)*this;
+        }
+
+        ~CachedText_t();
+    };
+
     Quad_t fquad(fvec2 pos, fvec2 size)
     {
         return Quad_t(GetRenderQueuePtr(), pos, size);
@@ -562,6 +955,39 @@ class Render
         return fquad(pos, image);
     }
 
+    // A single quad filled with `image` repeated in both directions, instead of a quad per tile.
+    // `offset` is the pixel of the image that ends up at `pos`, it can be outside of the image.
+    Quad_t tiled_quad(ivec2 pos, ivec2 size, const Graphics::TextureAtlas::Region &image, ivec2 offset = ivec2(0))
+    {
+        return iquad(pos, size).tex(image.pos + mod_ex(offset, image.size), size).tile(image.pos, image.size);
+    }
+
+    // A solid color rectangle. Call `.color()` on the result.
+    Sprite_t frect(fvec2 pos, fvec2 size)
+    {
+        return Sprite_t(GetRenderQueuePtr(), pos, size);
+    }
+
+    Sprite_t irect(fvec2 pos, fvec2 size) = delete;
+    Sprite_t irect(ivec2 pos, ivec2 size)
+    {
+        return frect(pos, size);
+    }
+
+    Sprite_t fsprite(fvec2 pos, const Graphics::TextureAtlas::Region &image)
+    {
+        Sprite_t ret(GetRenderQueuePtr(), pos, image.size);
+        ret.data.has_texture = 1;
+        ret.data.tex_pos = image.pos;
+        return ret;
+    }
+
+    Sprite_t isprite(fvec2 pos, const Graphics::TextureAtlas::Region &image) = delete;
+    Sprite_t isprite(ivec2 pos, const Graphics::TextureAtlas::Region &image)
+    {
+        return fsprite(pos, image);
+    }
+
     Triangle_t ftriangle(fvec2 a, fvec2 b, fvec2 c)
     {
         return Triangle_t(GetRenderQueuePtr(), a, b, c);
@@ -582,4 +1008,14 @@ class Render
     {
         return Text_t(this, pos, std::move(text));
     }
+
+    CachedText_t ctext(TextCache &cache, fvec2 pos, const Graphics::Font &font, std::string_view str)
+    {
+        return CachedText_t(this, cache, pos, font, str);
+    }
+    CachedText_t ictext(TextCache &cache, fvec2 pos, const Graphics::Font &font, std::string_view str) = delete;
+    CachedText_t ictext(TextCache &cache, ivec2 pos, const Graphics::Font &font, std::string_view str)
+    {
+        return CachedText_t(this, cache, pos, font, str);
+    }
 };
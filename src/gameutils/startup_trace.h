@@ -0,0 +1,154 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "stream/save_to_file.h"
+#include "strings/format.h"
+#include "utils/clock.h"
+
+// Times the startup stages, including the construction of the globals, which happens before `IMP_MAIN`.
+// Only records in the `profile` build mode, which defines `IMP_STARTUP_TRACE`. In other modes everything here does nothing.
+// Usage:
+//     Foo foo = GameUtils::StartupTrace::Traced("foo", []{return Foo(...);});
+//     { GameUtils::StartupTrace::Scope scope("bar"); ... }
+//     GameUtils::StartupTrace::Finish(file_name); // Once the startup is over. Prints `Report()` and saves `ChromeTraceJson()`.
+
+namespace GameUtils::StartupTrace
+{
+    #ifdef IMP_STARTUP_TRACE
+    inline constexpr bool enabled = true;
+    #else
+    inline constexpr bool enabled = false;
+    #endif
+
+    struct Event
+    {
+        std::string name;
+        std::size_t thread = 0; // 0 is the thread that recorded the first event, normally the main one.
+        std::uint64_t begin = 0, end = 0; // In `Clock::Time()` ticks.
+    };
+
+    namespace impl
+    {
+        struct Data
+        {
+            std::mutex mutex;
+            std::uint64_t origin = Clock::Time(); // The first use, which is roughly the start of the static initialization.
+            std::vector<Event> events;
+            std::vector<std::thread::id> threads;
+            bool finished = false;
+        };
+
+        // A function-local static, so it works from the constructors of the globals in any translation unit.
+        [[nodiscard]] inline Data &GetData()
+        {
+            static Data ret;
+            return ret;
+        }
+    }
+
+    // Records an event spanning the lifetime of this object.
+    class Scope
+    {
+        const char *name = nullptr;
+        std::uint64_t begin = 0;
+
+      public:
+        explicit Scope(const char *name) : name(name)
+        {
+            if constexpr (enabled)
+            {
+                (void)impl::GetData(); // Make sure the origin is before `begin`.
+                begin = Clock::Time();
+            }
+        }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+        ~Scope()
+        {
+            if constexpr (enabled)
+            {
+                std::uint64_t end = Clock::Time();
+                impl::Data &data = impl::GetData();
+                std::lock_guard lock(data.mutex);
+                if (data.finished)
+                    return;
+
+                std::thread::id id = std::this_thread::get_id();
+                std::size_t thread = 0;
+                while (thread < data.threads.size() && data.threads[thread] != id)
+                    thread++;
+                if (thread == data.threads.size())
+                    data.threads.push_back(id);
+
+                data.events.push_back({.name = name, .thread = thread, .begin = begin, .end = end});
+            }
+        }
+    };
+
+    // Calls `func` in a `Scope` and returns the result. A returned prvalue isn't moved, so this can initialize the non-movable globals.
+    template <typename F>
+    [[nodiscard]] decltype(auto) Traced(const char *name, F &&func)
+    {
+        Scope scope(name);
+        return std::forward<F>(func)();
+    }
+
+    // Describes the recorded events, one per line, in the order they ended.
+    [[nodiscard]] inline std::string Report()
+    {
+        impl::Data &data = impl::GetData();
+        std::lock_guard lock(data.mutex);
+        std::string ret;
+        auto Ms = [](std::uint64_t ticks){return Clock::TicksToSeconds(ticks) * 1000;};
+        for (const Event &event : data.events)
+            FMT_APPEND(ret, "{:8.1f} ms {:8.1f} ms  thread {}  {}\n", Ms(event.begin - data.origin), Ms(event.end - event.begin), event.thread, event.name);
+        return ret;
+    }
+
+    // The events in the Chrome tracing format, for `chrome://tracing`. Same as `Profiler::ChromeTraceJson()`, but with the threads.
+    [[nodiscard]] inline std::string ChromeTraceJson()
+    {
+        impl::Data &data = impl::GetData();
+        std::lock_guard lock(data.mutex);
+        std::string ret = "{\"traceEvents\":[";
+        bool first = true;
+        for (const Event &event : data.events)
+        {
+            if (!first)
+                ret += ',';
+            first = false;
+            FMT_APPEND(ret, "\n{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":{},\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                event.name, event.thread, Clock::TicksToSeconds(event.begin - data.origin) * 1e6, Clock::TicksToSeconds(event.end - event.begin) * 1e6);
+        }
+        ret += "\n]}\n";
+        return ret;
+    }
+
+    // Stops recording. If enabled, prints `Report()` to stdout and saves `ChromeTraceJson()` to `trace_file_name`.
+    // Does nothing if called again.
+    inline void Finish(std::string trace_file_name)
+    {
+        if constexpr (enabled)
+        {
+            {
+                impl::Data &data = impl::GetData();
+                std::lock_guard lock(data.mutex);
+                if (std::exchange(data.finished, true))
+                    return;
+            }
+
+            std::cout << "Startup trace:\n" << Report();
+            Stream::SaveFile(std::move(trace_file_name), ChromeTraceJson(), Stream::text);
+        }
+    }
+}
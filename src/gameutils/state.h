@@ -1,5 +1,6 @@
 #pragma once
 
+#include <future>
 #include <string_view>
 #include <string>
 #include <type_traits>
@@ -21,6 +22,7 @@ namespace GameUtils::State
         virtual ~Base() {}
 
         // This will be called once, right after the state is constructed and after its fields are deserialized.
+        // Always called on the main thread, even if the state was constructed on a different one (see `Manager::Prepare()`).
         virtual void Init() {}
 
         // `next_state` is empty by default, assign to it to change state.
@@ -28,6 +30,11 @@ namespace GameUtils::State
         // Remember that classes with unnamed fields use `()` instead of `{}`.
         // Use `"0"` to set a null state.
         virtual void Tick(std::string &next_state) = 0;
+
+        // If this returns a non-empty string, the manager constructs that state in the background (see `Manager::Prepare()`),
+        // expecting `Tick()` to switch to it later. Called after each `Tick()` that didn't change the state.
+        // The string should be exactly the same as the `next_state` you're going to assign, otherwise the prepared state is discarded.
+        [[nodiscard]] virtual std::string UpcomingState() const {return {};}
     };
 
     // Manages a state.
@@ -38,6 +45,10 @@ namespace GameUtils::State
         Refl::PolyStorage<T> state;
         std::string next_state;
 
+        // The state being constructed in the background, if any.
+        std::string prepared_state_str;
+        std::future<Refl::PolyStorage<T>> prepared_state;
+
       public:
         Manager() {}
 
@@ -58,13 +69,68 @@ namespace GameUtils::State
             }
         )
 
+        // Returns true if the next `Tick()` will change the state, before ticking it.
+        [[nodiscard]] bool StateChangePending() const
+        {
+            return !next_state.empty();
+        }
+
         void SetState(std::string_view state_str)
         {
-            Refl::FromString(state, state_str);
+            if (prepared_state.valid() && state_str == prepared_state_str)
+            {
+                // This waits if the state isn't ready yet, and rethrows the exceptions from the constructor.
+                state = prepared_state.get();
+                prepared_state_str.clear();
+            }
+            else
+            {
+                CancelPrepared();
+                Refl::FromString(state, state_str);
+            }
+
             if (state)
                 state->Init();
         }
 
+        // Starts constructing a state from `state_str` on a worker thread. The next `SetState()` with the same string uses it, instead of constructing a new one.
+        // Only the construction and the deserialization happen on the worker, `Init()` is still called on the main thread.
+        // So the constructors of the states prepared this way must not touch the GPU, the audio, or the other non-thread-safe globals, leave that to `Init()`.
+        // Does nothing if this state is already being prepared.
+        void Prepare(std::string_view state_str)
+        {
+            if (prepared_state.valid() && state_str == prepared_state_str)
+                return;
+
+            CancelPrepared();
+            prepared_state_str = state_str;
+            prepared_state = std::async(std::launch::async, [str = prepared_state_str]
+            {
+                Refl::PolyStorage<T> ret;
+                Refl::FromString(ret, str);
+                return ret;
+            });
+        }
+
+        // Returns true if a state is being prepared, or is already prepared and waits for `SetState()`.
+        [[nodiscard]] bool HasPreparedState() const
+        {
+            return prepared_state.valid();
+        }
+
+        // Discards the prepared state, if any. Waits for the worker to finish, since it can't be interrupted.
+        void CancelPrepared()
+        {
+            if (!prepared_state.valid())
+                return;
+            prepared_state_str.clear();
+            try
+            {
+                prepared_state.get();
+            }
+            catch (...) {} // If it failed, we don't care anymore.
+        }
+
         void Tick()
         {
             // Note that we change state right before `state->Tick()`.
@@ -76,7 +142,16 @@ namespace GameUtils::State
             }
 
             if (state)
+            {
                 state->Tick(next_state);
+
+                if (next_state.empty())
+                {
+                    std::string upcoming = state->UpcomingState();
+                    if (!upcoming.empty())
+                        Prepare(upcoming);
+                }
+            }
         }
     };
 }
@@ -1,10 +1,68 @@
 #include "tiled_map.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
 #include "program/errors.h"
+#include "strings/base64.h"
+#include "utils/archive.h"
+#include "utils/byte_order.h"
 #include "utils/mat.h"
 
 namespace Tiled
 {
+    // Decodes the tile data. `csv_tiles` is used for the `csv` encoding, and `base64_tiles` for `base64`.
+    static TileLayer DecodeTileLayer(const std::string &name, ivec2 size, const std::string &encoding, const std::string &compression, std::span<const int> csv_tiles, const std::string &base64_tiles)
+    {
+        TileLayer ret(size);
+
+        if (encoding == "csv")
+        {
+            if (csv_tiles.size() != std::size_t(size.prod()))
+                Program::Error("Expected the layer of size ", size, " to have exactly " , size.prod(), " tiles.");
+
+            // Both Tiled and `MultiArray` store the tiles row by row.
+            std::copy(csv_tiles.begin(), csv_tiles.end(), ret.elements());
+        }
+        else if (encoding == "base64")
+        {
+            // Each tile is a little-endian 32-bit integer.
+            std::size_t num_bytes = std::size_t(size.prod()) * 4;
+
+            std::vector<std::uint8_t> bytes = Strings::DecodeBase64(base64_tiles);
+            if (compression == "zlib")
+            {
+                std::vector<std::uint8_t> uncompressed(num_bytes);
+                Archive::Raw::Uncompress(bytes.data(), bytes.data() + bytes.size(), uncompressed.data(), uncompressed.data() + uncompressed.size());
+                bytes = std::move(uncompressed);
+            }
+            else if (!compression.empty())
+            {
+                Program::Error("Layer `", name, "` uses unsupported compression `", compression, "`. Use `zlib` or no compression.");
+            }
+
+            if (bytes.size() != num_bytes)
+                Program::Error("Expected the layer of size ", size, " to have exactly " , size.prod(), " tiles.");
+
+            for (std::size_t i = 0; i < std::size_t(size.prod()); i++)
+            {
+                std::uint32_t tile;
+                std::memcpy(&tile, bytes.data() + i * 4, 4);
+                ByteOrder::Convert(tile, ByteOrder::little);
+                ret.elements()[i] = int(tile);
+            }
+        }
+        else
+        {
+            Program::Error("Layer `", name, "` uses unknown encoding `", encoding, "`.");
+        }
+
+        return ret;
+    }
+
     Json::View FindLayer(Json::View map, std::string name)
     {
         Json::View ret = FindLayerOpt(map, name);
@@ -40,19 +98,14 @@ namespace Tiled
             Program::Error("Expected `", source["name"].GetString(), "` to be a tile layer.");
 
         ivec2 size(source["width"].GetInt(), source["height"].GetInt());
+        std::string name = source["name"].GetString();
+        std::string encoding = source.HasElement("encoding") ? source["encoding"].GetString() : "csv";
+        std::string compression = source.HasElement("compression") ? source["compression"].GetString() : "";
 
-        Json::View array_view = source["data"];
-        if (array_view.GetArraySize() != size.prod())
-            Program::Error("Expected the layer of size ", size, " to have exactly " , size.prod(), " tiles.");
-
-        TileLayer ret(size);
-        int index = 0;
-
-        for (int y = 0; y < ret.size().y; y++)
-        for (int x = 0; x < ret.size().x; x++)
-            ret.unsafe_at(ivec2(x,y)) = array_view[index++].GetInt();
-
-        return ret;
+        if (encoding == "csv")
+            return DecodeTileLayer(name, size, encoding, compression, source["data"].GetIntArray(), "");
+        else
+            return DecodeTileLayer(name, size, encoding, compression, {}, encoding == "base64" ? source["data"].GetString() : "");
     }
 
     PointLayer LoadPointLayer(Json::View source)
@@ -87,4 +140,130 @@ namespace Tiled
         });
         return ret;
     }
+
+    void LoadLayers(Json::Reader &reader, const std::map<std::string, TileLayer *> &tile_layers, const std::map<std::string, PointLayer *> &point_layers)
+    {
+        std::map<std::string, bool> loaded; // Both tile and point layer names.
+
+        reader.ForEachObjectElement([&](std::string_view key)
+        {
+            if (key != "layers")
+            {
+                reader.Skip();
+                return;
+            }
+
+            reader.ForEachArrayElement([&]
+            {
+                // The keys can be in any order, so we keep everything until the end of the layer.
+                std::string name, type;
+                std::optional<int> width, height;
+                std::string encoding = "csv", compression;
+                std::vector<int> csv_tiles;
+                std::string base64_tiles;
+                PointLayer points;
+                bool only_points = true;
+
+                reader.ForEachObjectElement([&](std::string_view key)
+                {
+                    if (key == "name")
+                    {
+                        name = reader.ReadString();
+                    }
+                    else if (key == "type")
+                    {
+                        type = reader.ReadString();
+                    }
+                    else if (key == "width")
+                    {
+                        width = reader.ReadInt();
+                    }
+                    else if (key == "height")
+                    {
+                        height = reader.ReadInt();
+                    }
+                    else if (key == "encoding")
+                    {
+                        encoding = reader.ReadString();
+                    }
+                    else if (key == "compression")
+                    {
+                        compression = reader.ReadString();
+                    }
+                    else if (key == "data")
+                    {
+                        if (reader.PeekType() == Json::string)
+                            base64_tiles = reader.ReadString();
+                        else
+                            reader.ReadIntArray(csv_tiles);
+                    }
+                    else if (key == "objects")
+                    {
+                        reader.ForEachArrayElement([&]
+                        {
+                            std::string point_name;
+                            fvec2 pos;
+                            bool is_point = false;
+                            reader.ForEachObjectElement([&](std::string_view key)
+                            {
+                                if (key == "name")
+                                    point_name = reader.ReadString();
+                                else if (key == "x")
+                                    pos.x = reader.ReadReal();
+                                else if (key == "y")
+                                    pos.y = reader.ReadReal();
+                                else if (key == "point")
+                                    is_point = reader.ReadBool();
+                                else
+                                    reader.Skip();
+                            });
+                            if (!is_point)
+                                only_points = false;
+                            points.points.insert({std::move(point_name), pos});
+                        });
+                    }
+                    else
+                    {
+                        reader.Skip();
+                    }
+                });
+
+                if (auto it = tile_layers.find(name); it != tile_layers.end())
+                {
+                    if (loaded[name])
+                        Program::Error("More than one layer is named `", name, "`.");
+                    loaded[name] = true;
+
+                    if (type != "tilelayer")
+                        Program::Error("Expected `", name, "` to be a tile layer.");
+                    if (!width || !height)
+                        Program::Error("Layer `", name, "` lacks the size.");
+                    *it->second = DecodeTileLayer(name, ivec2(*width, *height), encoding, compression, csv_tiles, base64_tiles);
+                }
+                else if (auto it = point_layers.find(name); it != point_layers.end())
+                {
+                    if (loaded[name])
+                        Program::Error("More than one layer is named `", name, "`.");
+                    loaded[name] = true;
+
+                    if (type != "objectgroup")
+                        Program::Error("Expected `", name, "` to be an object layer.");
+                    if (!only_points)
+                        Program::Error("Expected every object on layer `", name, "` to be a point.");
+                    *it->second = std::move(points);
+                }
+            });
+        });
+
+        for (const auto &[name, target] : tile_layers)
+        {
+            if (!loaded[name])
+                Program::Error(FMT("Map layer `{}` is missing.", name));
+        }
+        for (const auto &[name, target] : point_layers)
+        {
+            if (!loaded[name])
+                Program::Error(FMT("Map layer `{}` is missing.", name));
+        }
+    }
 }
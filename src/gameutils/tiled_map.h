@@ -1,10 +1,13 @@
 #pragma once
 
 #include <algorithm>
+#include <functional>
 #include <iterator>
 #include <map>
 #include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "program/errors.h"
 #include "strings/common.h"
@@ -22,10 +25,12 @@ namespace Tiled
 
     struct PointLayer
     {
-        std::multimap<std::string, fvec2> points;
+        // Sorted by name, so the names with a common prefix are adjacent. The comparator is transparent, so the lookups don't copy the names.
+        using map_t = std::multimap<std::string, fvec2, std::less<>>;
+        map_t points;
 
         template <typename F>
-        void ForEachPointNamed(std::string name, F &&func) const // `func` is `void func(fvec2 pos)`.
+        void ForEachPointNamed(std::string_view name, F &&func) const // `func` is `void func(fvec2 pos)`.
         {
             auto [begin, end] = points.equal_range(name);
             while (begin != end)
@@ -36,17 +41,18 @@ namespace Tiled
         }
 
         template <typename F>
-        void ForEachPointWithNamePrefix(std::string prefix, F &&func) const // `func` is `void func(std::string_view suffix, fvec2 pos)`.
+        void ForEachPointWithNamePrefix(std::string_view prefix, F &&func) const // `func` is `void func(std::string_view suffix, fvec2 pos)`.
         {
+            // The matching names form one range, starting at the first name not less than the prefix.
             auto begin = points.lower_bound(prefix);
             while (begin != points.end() && begin->first.starts_with(prefix))
             {
-                func(std::string_view(begin->first.begin() + prefix.size(), begin->first.end()), begin->second);
+                func(std::string_view(begin->first).substr(prefix.size()), begin->second);
                 begin++;
             }
         }
 
-        std::optional<fvec2> GetSinglePointOpt(std::string name) const
+        std::optional<fvec2> GetSinglePointOpt(std::string_view name) const
         {
             auto [begin, end] = points.equal_range(name);
             if (begin == end)
@@ -56,15 +62,15 @@ namespace Tiled
             return begin->second;
         }
 
-        fvec2 GetSinglePoint(std::string name) const
+        fvec2 GetSinglePoint(std::string_view name) const
         {
             auto [begin, end] = points.equal_range(name);
-            if (begin == points.end() || std::next(begin) != end)
+            if (begin == end || std::next(begin) != end)
                 Program::Error("Expected the map to contain exactly one point named `", name, "`.");
             return begin->second;
         }
 
-        std::vector<fvec2> GetPointList(std::string name) const
+        std::vector<fvec2> GetPointList(std::string_view name) const
         {
             auto [begin, end] = points.equal_range(name);
             std::vector<fvec2> ret;
@@ -94,4 +100,8 @@ namespace Tiled
     };
 
     Properties LoadProperties(Json::View map);
+
+    // Reads the map from a streaming reader positioned at the root object, in one pass without building the document.
+    // Loads the requested layers by name into the targets. The missing layers are errors, and the unknown keys and layers are skipped.
+    void LoadLayers(Json::Reader &reader, const std::map<std::string, TileLayer *> &tile_layers, const std::map<std::string, PointLayer *> &point_layers);
 }
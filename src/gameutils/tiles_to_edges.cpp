@@ -1,7 +1,12 @@
 #include "tiles_to_edges.h"
 
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
 #include "strings/format.h"
 #include "utils/bit_vectors.h"
+#include "utils/hash.h"
 #include "utils/multiarray.h"
 
 namespace GameUtils::TilesToEdges
@@ -10,7 +15,8 @@ namespace GameUtils::TilesToEdges
         : tile_size(params.tile_size), vertices(std::move(params.vertices)), tile_vertices(std::move(params.tiles))
     {
         // Generate vertex to id mapping.
-        std::map<ivec2, std::size_t> vertex_ids;
+        std::unordered_map<ivec2, std::size_t, Hash::Hasher<>> vertex_ids;
+        vertex_ids.reserve(vertices.size());
 
         for (std::size_t i = 0; i < vertices.size(); i++)
         {
@@ -31,7 +37,7 @@ namespace GameUtils::TilesToEdges
         }
 
         // Generate edge ids.
-        std::map<std::pair<std::size_t, std::size_t>, std::size_t> edge_ids;
+        std::unordered_map<std::pair<std::size_t, std::size_t>, std::size_t, Hash::Hasher<>> edge_ids;
 
         for (const auto &tile_loops : tile_vertices)
         for (const auto &tile_loop : tile_loops)
@@ -158,27 +164,137 @@ namespace GameUtils::TilesToEdges
         }
     }
 
-    void Convert(const Params &params)
+    // A type for bit masks.
+    using bits_t = std::uint64_t;
+
+    // An edge bit array, see `ConvertLow()`.
+    using EdgeBits = std::vector<Array2D<bits_t>>;
+
+    [[nodiscard]] static EdgeBits MakeEdgeBits(const TileSet &tileset, index_vec2 size)
+    {
+        EdgeBits ret((tileset.edge_points.size() + BitVec::bit_width<bits_t> - 1) / BitVec::bit_width<bits_t>);
+        for (Array2D<bits_t> &arr : ret)
+            arr = Array2D<bits_t>(size);
+        return ret;
+    }
+
+    [[nodiscard]] static bool GetEdgeBit(const EdgeBits &bits, index_vec2 tile_pos, std::size_t edge)
+    {
+        auto loc = BitVec::BitLocation<bits_t>(edge);
+        return bits[loc.index].safe_nonthrowing_at(tile_pos) & loc.mask;
+    }
+
+    static void SetEdgeBit(EdgeBits &bits, index_vec2 tile_pos, std::size_t edge, bool value)
+    {
+        auto loc = BitVec::BitLocation<bits_t>(edge);
+        bits_t &word = bits[loc.index].safe_nonthrowing_at(tile_pos);
+        if (value)
+            word |= loc.mask;
+        else
+            word &= ~loc.mask;
+    }
+
+    [[nodiscard]] static std::size_t GetTileChecked(const TileSet &tileset, const Array2D<std::size_t> &tiles, index_vec2 tile_pos)
     {
-        const TileSet &tileset = *params.tileset;
+        std::size_t tile = tiles.unsafe_at(tile_pos);
+        if (tile >= tileset.tile_vertices.size())
+            throw std::runtime_error(FMT("Tile index {} at {} is out of range.", tile, tile_pos));
+        return tile;
+    }
+
+    // Traces a single loop, starting from the edge of `starting_tile_pos` that begins at `pre_starting_vertex`, which must be in `valid_edges`.
+    // Removes the visited edges from `valid_edges`. Calls `output_vertex(pos, last)` for every vertex, and `visit_edge(tile_pos, edge)` for every removed edge.
+    template <typename F, typename G>
+    static void TraceLoop(const TileSet &tileset, const Array2D<std::size_t> &tiles, EdgeBits &valid_edges, index_vec2 starting_tile_pos, std::size_t pre_starting_vertex, F &&output_vertex, G &&visit_edge)
+    {
+        const std::size_t starting_edge = tileset.edge_starting_at.safe_nonthrowing_at(index_vec2(tiles.unsafe_at(starting_tile_pos), pre_starting_vertex));
+        const std::size_t starting_vertex = tileset.edge_points[starting_edge].second;
+
+        ivec2 tile_pos = starting_tile_pos;
+        std::size_t vertex = starting_vertex;
+        std::size_t edge = starting_edge;
+        ivec2 dir = tileset.vertices[starting_vertex] - tileset.vertices[pre_starting_vertex];
+
+        bool first = true;
+
+        while (true)
+        {
+            bool finished = !first && tile_pos == starting_tile_pos && vertex == starting_vertex;
+
+            output_vertex(tile_pos * tileset.tile_size + tileset.vertices[vertex], finished);
+
+            // Remove the visited edge.
+            if (!first)
+            {
+                SetEdgeBit(valid_edges, tile_pos, edge, false);
+                visit_edge(tile_pos, edge);
+            }
+
+            first = false;
 
-        // A type for bit masks.
-        using bits_t = std::uint64_t;
+            if ( finished )
+                break;
 
+            bool found_any = false;
+            ivec2 best_tile_pos(0);
+            std::size_t best_vertex = -1zu;
+            std::size_t best_edge = -1zu;
+            ivec2 best_dir(0);
 
+            for (int i = -1; i < 8; i++)
+            {
+                std::size_t next_vertex_a = i == -1 ? vertex : tileset.matching_vertices[vertex][i];
+                if (i != -1 && next_vertex_a == -1zu)
+                    continue; // No matching vertex.
+                ivec2 next_tile_pos = tile_pos + (i == -1 ? ivec2() : ivec2::dir8(i));
+                if (i != -1 && ((next_tile_pos < 0).any() || (next_tile_pos >= tiles.size()).any()))
+                    continue; // Out of bounds.
+
+                std::size_t next_tile = tiles.safe_nonthrowing_at(next_tile_pos);
+                std::size_t next_edge = tileset.edge_starting_at.safe_nonthrowing_at(index_vec2(next_tile, next_vertex_a));
+                if (next_edge == -1zu)
+                    continue; // No edge.
+
+                if (!GetEdgeBit(valid_edges, next_tile_pos, next_edge))
+                    continue; // Already visited that edge.
+
+                std::size_t next_vertex_b = tileset.edge_points[next_edge].second;
+
+                ivec2 next_dir = tileset.vertices[next_vertex_b] - tileset.vertices[next_vertex_a];
+
+                if (!found_any || Math::less_positively_rotated(-dir, next_dir, best_dir))
+                {
+                    found_any = true;
+                    best_tile_pos = next_tile_pos;
+                    best_vertex = next_vertex_b;
+                    best_edge = next_edge;
+                    best_dir = next_dir;
+                }
+            }
+
+            if (!found_any)
+                throw std::runtime_error(FMT("Edge loop unexpectedly ended at tile {} vertex {}.", tile_pos, vertex));
+
+            tile_pos = best_tile_pos;
+            vertex = best_vertex;
+            edge = best_edge;
+            dir = best_dir;
+        }
+    }
+
+    // Calls `output_vertex(pos, last)` for every vertex, same as `Params::output_vertex`.
+    template <typename F>
+    static void ConvertLow(const TileSet &tileset, const Array2D<std::size_t> &tiles, F &&output_vertex)
+    {
         // Which edges in each tile were already processed.
         // All sub-arrays have the same size, matching the map size.
         // The outer vector is used in case the mask doesn't fit into a single `bits_t`.
-        std::vector<Array2D<bits_t>> valid_edges((tileset.edge_points.size() + BitVec::bit_width<bits_t> - 1) / BitVec::bit_width<bits_t>);
-        for (Array2D<bits_t> &arr : valid_edges)
-            arr = Array2D<bits_t>(params.tiles.size());
+        EdgeBits valid_edges = MakeEdgeBits(tileset, tiles.size());
 
         // Fill the edge bit array, and remove the conflicting edges.
-        for (index_vec2 tile_pos : vector_range(params.tiles.size()))
+        for (index_vec2 tile_pos : vector_range(tiles.size()))
         {
-            std::size_t tile = params.tiles.unsafe_at(tile_pos);
-            if (tile >= tileset.tile_vertices.size())
-                throw std::runtime_error(FMT("Tile index {} at {} is out of range.", tile, tile_pos));
+            std::size_t tile = GetTileChecked(tileset, tiles, tile_pos);
 
             for (const auto &vertex_loop : tileset.tile_vertices[tile])
             for (std::size_t vertex : vertex_loop)
@@ -191,7 +307,7 @@ namespace GameUtils::TilesToEdges
                     ivec2 other_tile_pos = tile_pos + ivec2::dir8(dir + 4);
 
                     // Note that we don't check the upper limit of Y here, because the offset can never have a positive Y.
-                    if ((other_tile_pos < 0).any() || other_tile_pos.x >= params.tiles.size().x)
+                    if ((other_tile_pos < 0).any() || other_tile_pos.x >= tiles.size().x)
                         continue; // No tile in that direction.
 
                     std::size_t other_edge = tileset.symmetric_edges[edge][dir];
@@ -219,91 +335,202 @@ namespace GameUtils::TilesToEdges
         }
 
         // Generate loops from the edges.
-        for (const index_vec2 starting_tile_pos : vector_range(params.tiles.size()))
+        for (const index_vec2 starting_tile_pos : vector_range(tiles.size()))
         {
-            const std::size_t starting_tile = params.tiles.unsafe_at(starting_tile_pos);
+            const std::size_t starting_tile = tiles.unsafe_at(starting_tile_pos);
 
             for (const auto &vertex_loop : tileset.tile_vertices[starting_tile])
             for (const std::size_t pre_starting_vertex : vertex_loop)
             {
                 const std::size_t starting_edge = tileset.edge_starting_at.safe_nonthrowing_at(index_vec2(starting_tile, pre_starting_vertex));
-                if (auto loc = BitVec::BitLocation<bits_t>(starting_edge); !(valid_edges[loc.index].safe_nonthrowing_at(starting_tile_pos) & loc.mask))
+                if (!GetEdgeBit(valid_edges, starting_tile_pos, starting_edge))
                     continue; // This edge doesn't exist.
 
-                const std::size_t starting_vertex = tileset.edge_points[starting_edge].second;
+                TraceLoop(tileset, tiles, valid_edges, starting_tile_pos, pre_starting_vertex, output_vertex, [](index_vec2, std::size_t){});
+            }
+        }
+    }
 
-                ivec2 tile_pos = starting_tile_pos;
-                std::size_t vertex = starting_vertex;
-                std::size_t edge = starting_edge;
-                ivec2 dir = tileset.vertices[starting_vertex] - tileset.vertices[pre_starting_vertex];
+    void Convert(const Params &params)
+    {
+        ConvertLow(*params.tileset, params.tiles, params.output_vertex);
+    }
 
-                bool first = true;
+    EdgeLoops ConvertToLoops(const TileSet &tileset, const Array2D<std::size_t> &tiles)
+    {
+        EdgeLoops ret;
+        ConvertLow(tileset, tiles, [&](ivec2 pos, bool last)
+        {
+            // The last vertex repeats the first one, so we skip it.
+            if (last)
+                ret.loop_begin.push_back(ret.vertices.size());
+            else
+                ret.vertices.push_back(pos);
+        });
+        return ret;
+    }
 
-                while (true)
+    // Returns true if the edge of the tile at `tile_pos` isn't cancelled out by an edge of an adjacent tile.
+    // Unlike the conflict removal in `ConvertLow()`, this doesn't depend on the order in which the tiles are processed.
+    [[nodiscard]] static bool EdgeIsUncancelled(const TileSet &tileset, const Array2D<std::size_t> &tiles, index_vec2 tile_pos, std::size_t edge)
+    {
+        for (int dir = 0; dir < 4; dir++)
+        {
+            // The tiles before this one, same as in `ConvertLow()`.
+            index_vec2 other_tile_pos = tile_pos + ivec2::dir8(dir + 4);
+            std::size_t other_edge = tileset.symmetric_edges[edge][dir];
+            if (other_edge != -1zu && tiles.pos_in_range(other_tile_pos))
+            {
+                std::size_t other_tile = tiles.unsafe_at(other_tile_pos);
+                if (tileset.edge_starting_at.safe_nonthrowing_at(index_vec2(other_tile, tileset.edge_points[other_edge].first)) == other_edge)
+                    return false;
+            }
+
+            // The tiles after this one. Only their edges know the symmetric edges in this direction, so we check all of them.
+            other_tile_pos = tile_pos + ivec2::dir8(dir);
+            if (tiles.pos_in_range(other_tile_pos))
+            {
+                std::size_t other_tile = tiles.unsafe_at(other_tile_pos);
+                for (const auto &vertex_loop : tileset.tile_vertices[other_tile])
+                for (std::size_t vertex : vertex_loop)
                 {
-                    bool finished = !first && tile_pos == starting_tile_pos && vertex == starting_vertex;
+                    if (tileset.symmetric_edges[tileset.edge_starting_at.safe_nonthrowing_at(index_vec2(other_tile, vertex))][dir] == edge)
+                        return false;
+                }
+            }
+        }
+        return true;
+    }
 
-                    params.output_vertex(tile_pos * params.tileset->tile_size + tileset.vertices[vertex], finished);
+    IncrementalConverter::IncrementalConverter(const TileSet &new_tileset, Array2D<std::size_t> new_tiles)
+        : tileset(&new_tileset), tiles(std::move(new_tiles)), valid_edges(MakeEdgeBits(new_tileset, tiles.size()))
+    {
+        for (index_vec2 tile_pos : vector_range(tiles.size()))
+            (void)GetTileChecked(*tileset, tiles, tile_pos);
 
-                    // Remove the visited edge.
-                    if (!first)
-                    {
-                        auto loc = BitVec::BitLocation<bits_t>(edge);
-                        valid_edges[loc.index].safe_nonthrowing_at(tile_pos) &= ~loc.mask;
-                    }
+        if (tiles.size().min() > 0)
+            MarkChanged(index_vec2(0), tiles.size() - 1);
+    }
+
+    void IncrementalConverter::MarkChanged(index_vec2 a, index_vec2 b)
+    {
+        if (!has_changes)
+        {
+            has_changes = true;
+            changes_min = a;
+            changes_max = b;
+        }
+        else
+        {
+            changes_min = min(changes_min, a);
+            changes_max = max(changes_max, b);
+        }
+    }
 
-                    first = false;
+    void IncrementalConverter::SetTile(index_vec2 pos, std::size_t tile)
+    {
+        if (tile >= tileset->tile_vertices.size())
+            throw std::runtime_error(FMT("Tile index {} at {} is out of range.", tile, pos));
+
+        std::size_t &cell = tiles.safe_throwing_at(pos);
+        if (cell == tile)
+            return;
+        cell = tile;
+        MarkChanged(pos, pos);
+    }
 
-                    if ( finished )
-                        break;
+    IncrementalConverter::Changes IncrementalConverter::Update()
+    {
+        Changes ret;
+        if (!has_changes)
+            return ret;
+        has_changes = false;
+
+        // The edges can change in the changed tiles and their neighbors.
+        index_vec2 region_min = max(changes_min - 1, 0);
+        index_vec2 region_max = min(changes_max + 1, tiles.size() - 1);
+        auto InRegion = [&](index_vec2 pos){return (pos >= region_min).all() && (pos <= region_max).all();};
+
+        // Recompute the edges in the region.
+        for (index_vec2 tile_pos : region_min <= vector_range <= region_max)
+        {
+            for (Array2D<bits_t> &arr : valid_edges)
+                arr.unsafe_at(tile_pos) = 0;
+
+            std::size_t tile = tiles.unsafe_at(tile_pos);
+            for (const auto &vertex_loop : tileset->tile_vertices[tile])
+            for (std::size_t vertex : vertex_loop)
+            {
+                std::size_t edge = tileset->edge_starting_at.safe_nonthrowing_at(index_vec2(tile, vertex));
+                if (EdgeIsUncancelled(*tileset, tiles, tile_pos, edge))
+                    SetEdgeBit(valid_edges, tile_pos, edge, true);
+            }
+        }
+
+        // Remove the loops passing through the region. The rest can't change, since all their edges are the same.
+        for (auto it = loops.begin(); it != loops.end();)
+        {
+            const Loop &loop = it->second;
+            if ((loop.edge_tiles_max >= region_min).all() && (loop.edge_tiles_min <= region_max).all() && std::any_of(loop.edge_tiles.begin(), loop.edge_tiles.end(), InRegion))
+            {
+                ret.removed.push_back(it->first);
+                it = loops.erase(it);
+            }
+            else
+            {
+                it++;
+            }
+        }
 
-                    bool found_any = false;
-                    ivec2 best_tile_pos(0);
-                    std::size_t best_vertex = -1zu;
-                    std::size_t best_edge = -1zu;
-                    ivec2 best_dir(0);
+        // Trace the new loops passing through the region. The tracing removes the visited edges, so we restore them afterwards.
+        std::vector<std::pair<index_vec2, std::size_t>> visited_edges;
+        for (index_vec2 tile_pos : region_min <= vector_range <= region_max)
+        {
+            std::size_t tile = tiles.unsafe_at(tile_pos);
+            for (const auto &vertex_loop : tileset->tile_vertices[tile])
+            for (std::size_t pre_starting_vertex : vertex_loop)
+            {
+                if (!GetEdgeBit(valid_edges, tile_pos, tileset->edge_starting_at.safe_nonthrowing_at(index_vec2(tile, pre_starting_vertex))))
+                    continue; // No edge, or it's a part of a loop we've already traced.
 
-                    for (int i = -1; i < 8; i++)
+                Loop loop;
+                TraceLoop(*tileset, tiles, valid_edges, tile_pos, pre_starting_vertex,
+                    [&](ivec2 pos, bool last)
+                    {
+                        if (!last)
+                            loop.vertices.push_back(pos);
+                    },
+                    [&](index_vec2 edge_tile_pos, std::size_t edge)
                     {
-                        std::size_t next_vertex_a = i == -1 ? vertex : tileset.matching_vertices[vertex][i];
-                        if (i != -1 && next_vertex_a == -1zu)
-                            continue; // No matching vertex.
-                        ivec2 next_tile_pos = tile_pos + (i == -1 ? ivec2() : ivec2::dir8(i));
-                        if (i != -1 && ((next_tile_pos < 0).any() || (next_tile_pos >= params.tiles.size()).any()))
-                            continue; // Out of bounds.
-
-                        std::size_t next_tile = params.tiles.safe_nonthrowing_at(next_tile_pos);
-                        std::size_t next_edge = tileset.edge_starting_at.safe_nonthrowing_at(index_vec2(next_tile, next_vertex_a));
-                        if (next_edge == -1zu)
-                            continue; // No edge.
-
-                        if (auto loc = BitVec::BitLocation<bits_t>(next_edge); !(valid_edges[loc.index].safe_nonthrowing_at(next_tile_pos) & loc.mask))
-                            continue; // Already visited that edge.
-
-                        std::size_t next_vertex_b = params.tileset->edge_points[next_edge].second;
-
-                        ivec2 next_dir = tileset.vertices[next_vertex_b] - tileset.vertices[next_vertex_a];
-
-                        if (!found_any || Math::less_positively_rotated(-dir, next_dir, best_dir))
-                        {
-                            found_any = true;
-                            best_tile_pos = next_tile_pos;
-                            best_vertex = next_vertex_b;
-                            best_edge = next_edge;
-                            best_dir = next_dir;
-                        }
+                        loop.edge_tiles.push_back(edge_tile_pos);
+                        visited_edges.emplace_back(edge_tile_pos, edge);
                     }
+                );
 
-                    if (!found_any)
-                        throw std::runtime_error(FMT("Edge loop unexpectedly ended at tile {} vertex {}.", tile_pos, vertex));
-
-                    tile_pos = best_tile_pos;
-                    vertex = best_vertex;
-                    edge = best_edge;
-                    dir = best_dir;
+                loop.edge_tiles_min = loop.edge_tiles_max = loop.edge_tiles.front();
+                for (index_vec2 edge_tile_pos : loop.edge_tiles)
+                {
+                    loop.edge_tiles_min = min(loop.edge_tiles_min, edge_tile_pos);
+                    loop.edge_tiles_max = max(loop.edge_tiles_max, edge_tile_pos);
                 }
+
+                std::size_t id = next_loop_id++;
+                ret.added.push_back(id);
+                loops.emplace(id, std::move(loop));
             }
         }
+        for (const auto &[edge_tile_pos, edge] : visited_edges)
+            SetEdgeBit(valid_edges, edge_tile_pos, edge, true);
+
+        return ret;
+    }
+
+    const IncrementalConverter::Loop &IncrementalConverter::GetLoop(std::size_t id) const
+    {
+        auto it = loops.find(id);
+        if (it == loops.end())
+            throw std::runtime_error(FMT("No edge loop with id {}.", id));
+        return it->second;
     }
 }
 
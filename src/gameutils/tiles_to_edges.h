@@ -2,8 +2,10 @@
 
 #include <array>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
-#include <map>
+#include <span>
+#include <unordered_map>
 #include <vector>
 
 #include "reflection/full.h"
@@ -78,4 +80,83 @@ namespace GameUtils::TilesToEdges
 
     // Performs the tiles->edges conversion.
     void Convert(const Params &params);
+
+    // The resulting edge loops, without a callback per vertex.
+    struct EdgeLoops
+    {
+        // The vertices of all loops, one loop after another.
+        // Unlike with `OutputCallback`, the first vertex of a loop isn't repeated at the end. This is what Box2D loop chains expect.
+        std::vector<ivec2> vertices;
+        // `loop_begin[i]` is the index of the first vertex of the i-th loop. The last element is always `vertices.size()`.
+        std::vector<std::size_t> loop_begin = {0};
+
+        [[nodiscard]] std::size_t NumLoops() const
+        {
+            return loop_begin.size() - 1;
+        }
+
+        [[nodiscard]] std::span<const ivec2> Loop(std::size_t i) const
+        {
+            return std::span(vertices).subspan(loop_begin[i], loop_begin[i + 1] - loop_begin[i]);
+        }
+    };
+
+    // Same as `Convert()`, but collects the loops into flat arrays.
+    [[nodiscard]] EdgeLoops ConvertToLoops(const TileSet &tileset, const Array2D<std::size_t> &tiles);
+
+    // Keeps the edge loops of a map up to date as the tiles change, only retracing the loops around the changed tiles.
+    // Then the physics bodies can be patched instead of rebuilt.
+    // The conflicting edges of adjacent tiles are removed in a way that doesn't depend on the tile order,
+    // so in unusual tile sets (where an edge conflicts with more than one other edge) the result can differ from `Convert()`.
+    class IncrementalConverter
+    {
+      public:
+        struct Loop
+        {
+            // Same as in `EdgeLoops`, the first vertex isn't repeated at the end.
+            std::vector<ivec2> vertices;
+            // The tiles the edges belong to, possibly repeated, and their inclusive bounds.
+            std::vector<index_vec2> edge_tiles;
+            index_vec2 edge_tiles_min{}, edge_tiles_max{};
+        };
+
+        struct Changes
+        {
+            // The loop ids, see `GetLoop()`. The ids of the removed loops are never reused.
+            std::vector<std::size_t> removed;
+            std::vector<std::size_t> added;
+        };
+
+      private:
+        const TileSet *tileset = nullptr;
+        Array2D<std::size_t> tiles;
+        // Same as the edge bits in `Convert()`, but those are preserved between updates.
+        std::vector<Array2D<std::uint64_t>> valid_edges;
+        std::unordered_map<std::size_t, Loop> loops;
+        std::size_t next_loop_id = 0;
+
+        // The changed tiles since the last update, inclusive.
+        bool has_changes = false;
+        index_vec2 changes_min{}, changes_max{};
+
+        void MarkChanged(index_vec2 a, index_vec2 b);
+
+      public:
+        IncrementalConverter() {}
+        // The `tileset` must remain alive. The whole map counts as changed, so the first `Update()` reports all loops as added.
+        IncrementalConverter(const TileSet &new_tileset, Array2D<std::size_t> new_tiles);
+
+        [[nodiscard]] const Array2D<std::size_t> &Tiles() const {return tiles;}
+
+        // Throws if `pos` is out of range. The loops are updated on the next `Update()`.
+        void SetTile(index_vec2 pos, std::size_t tile);
+
+        // Retraces the loops passing near the changed tiles.
+        [[nodiscard]] Changes Update();
+
+        // Throws if there's no such loop.
+        [[nodiscard]] const Loop &GetLoop(std::size_t id) const;
+
+        [[nodiscard]] const std::unordered_map<std::size_t, Loop> &Loops() const {return loops;}
+    };
 }
@@ -2,6 +2,8 @@
 
 #include <cglfl/cglfl.hpp>
 
+#include "graphics/state_cache.h"
+
 namespace Graphics::Blending
 {
     enum Factors
@@ -41,12 +43,13 @@ namespace Graphics::Blending
 
     // Func(a,b) and Equation(a) set same parameters for both color and alpha.
     // Func(a,b,c,d) and Equation(a,b) set separete parameters for color and alpha.
-    inline void Enable()  {glEnable(GL_BLEND);}
-    inline void Disable() {glDisable(GL_BLEND);}
-    inline void Func(Factors src, Factors dst)                             {glBlendFunc(src, dst);}
-    inline void Func(Factors src, Factors dst, Factors srca, Factors dsta) {glBlendFuncSeparate(src, dst, srca, dsta);}
-    inline void Equation(Equations eq)                {glBlendEquation(eq);}
-    inline void Equation(Equations eq, Equations eqa) {glBlendEquationSeparate(eq, eqa);}
+    // Those go through `StateCache`, so repeating the same state is free.
+    inline void Enable()  {StateCache::SetBlending(true);}
+    inline void Disable() {StateCache::SetBlending(false);}
+    inline void Func(Factors src, Factors dst)                             {StateCache::SetBlendFunc(src, dst, src, dst);}
+    inline void Func(Factors src, Factors dst, Factors srca, Factors dsta) {StateCache::SetBlendFunc(src, dst, srca, dsta);}
+    inline void Equation(Equations eq)                {StateCache::SetBlendEquation(eq, eq);}
+    inline void Equation(Equations eq, Equations eqa) {StateCache::SetBlendEquation(eq, eqa);}
 
     inline void FuncOverwrite        () {Func(one, zero);}
     inline void FuncAdd              () {Func(one, one);}
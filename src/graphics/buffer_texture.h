@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+#include <cglfl/cglfl.hpp>
+
+#include "graphics/texture.h"
+#include "graphics/vertex_buffer.h"
+#include "macros/finally.h"
+#include "program/errors.h"
+#include "utils/mat.h"
+
+namespace Graphics
+{
+    // A buffer texture: a 1D array of texels stored in a buffer object, which shaders read with `texelFetch()` from a `samplerBuffer`.
+    // `T` is the texel type, only `fvec4` (`GL_RGBA32F`) is supported for now.
+    template <typename T>
+    class BufferTexture
+    {
+        static_assert(std::is_same_v<T, fvec4>, "Unsupported texel type.");
+
+        struct Data
+        {
+            GLuint buffer = 0;
+            GLuint texture = 0;
+            int size = 0;
+        };
+        Data data;
+
+      public:
+        BufferTexture() {}
+
+        BufferTexture(decltype(nullptr))
+        {
+            glGenBuffers(1, &data.buffer);
+            if (!data.buffer)
+                Program::Error("Unable to create a buffer for a buffer texture.");
+            FINALLY_ON_THROW( glDeleteBuffers(1, &data.buffer); )
+
+            glGenTextures(1, &data.texture);
+            if (!data.texture)
+                Program::Error("Unable to create a buffer texture.");
+
+            // The texture stays attached to the buffer object even if its storage is reallocated.
+            glBindBuffer(GL_TEXTURE_BUFFER, data.buffer);
+            glBindTexture(GL_TEXTURE_BUFFER, data.texture);
+            glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, data.buffer);
+        }
+        BufferTexture(int count, const T *source = 0, Usage usage = dynamic_draw) : BufferTexture(nullptr)
+        {
+            SetData(count, source, usage);
+        }
+
+        BufferTexture(BufferTexture &&other) noexcept : data(std::exchange(other.data, {})) {}
+        BufferTexture &operator=(BufferTexture other) noexcept
+        {
+            std::swap(data, other.data);
+            return *this;
+        }
+
+        ~BufferTexture()
+        {
+            // Deleting 0 is a no-op, but GL could be unloaded at this point.
+            if (data.texture)
+                glDeleteTextures(1, &data.texture);
+            if (data.buffer)
+                glDeleteBuffers(1, &data.buffer);
+        }
+
+        explicit operator bool() const
+        {
+            return bool(data.buffer);
+        }
+
+        int Size() const // This size is measured in texels, not bytes.
+        {
+            return data.size;
+        }
+
+        // The video memory, for `Refl::EstimateMemory()`.
+        [[nodiscard]] std::size_t EstimateOwnedMemory() const
+        {
+            return std::size_t(data.size) * sizeof(T);
+        }
+
+        void SetData(int count, const T *source = 0, Usage usage = dynamic_draw)
+        {
+            ASSERT(*this, "Attempt to use a null buffer texture.");
+            if (!*this)
+                return;
+            glBindBuffer(GL_TEXTURE_BUFFER, data.buffer);
+            glBufferData(GL_TEXTURE_BUFFER, count * sizeof(T), source, usage);
+            data.size = count;
+        }
+        void SetDataPart(int elem_offset, int elem_count, const T *source)
+        {
+            ASSERT(*this, "Attempt to use a null buffer texture.");
+            if (!*this)
+                return;
+            glBindBuffer(GL_TEXTURE_BUFFER, data.buffer);
+            glBufferSubData(GL_TEXTURE_BUFFER, elem_offset * sizeof(T), elem_count * sizeof(T), source);
+        }
+
+        // Binds the texture to a texture unit. This doesn't interfere with the 2D textures attached to the unit.
+        void Bind(int unit_index) const
+        {
+            ASSERT(*this, "Attempt to use a null buffer texture.");
+            if (!*this)
+                return;
+            TexUnit::ActivateIndex(unit_index);
+            glBindTexture(GL_TEXTURE_BUFFER, data.texture);
+        }
+    };
+}
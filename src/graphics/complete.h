@@ -1,20 +1,29 @@
 #pragma once
 
 #include "graphics/blending.h"
+#include "graphics/buffer_texture.h"
 #include "graphics/clear.h"
+#include "graphics/debug_output.h"
 #include "graphics/dummy_vertex_array.h"
 #include "graphics/errors.h"
 #include "graphics/font_file.h"
 #include "graphics/font.h"
 #include "graphics/framebuffer.h"
+#include "graphics/glyph_cache.h"
+#include "graphics/gpu_timer.h"
 #include "graphics/image.h"
 #include "graphics/index_buffer.h"
+#include "graphics/quad_render_queue.h"
 #include "graphics/scissor.h"
+#include "graphics/shader_cache.h"
 #include "graphics/shader.h"
 #include "graphics/simple_render_queue.h"
+#include "graphics/state_cache.h"
 #include "graphics/text.h"
 #include "graphics/texture_atlas.h"
 #include "graphics/texture.h"
+#include "graphics/texture_uploader.h"
 #include "graphics/types.h"
+#include "graphics/uniform_block.h"
 #include "graphics/vertex_buffer.h"
 #include "graphics/viewport.h"
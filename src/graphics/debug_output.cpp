@@ -0,0 +1,149 @@
+#include "debug_output.h"
+
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include <SDL.h>
+#include <cglfl/cglfl.hpp>
+
+#include "graphics/errors.h"
+#include "program/errors.h"
+
+namespace Graphics
+{
+    // Not in the GL 3.2 headers.
+    static constexpr GLenum debug_output = 0x92E0; // GL_DEBUG_OUTPUT
+    static constexpr GLenum debug_type_error = 0x824C; // GL_DEBUG_TYPE_ERROR
+
+    // The loader doesn't know about those functions, so we load them ourselves.
+    struct DebugOutputFuncs
+    {
+        void (CGLFL_API *DebugMessageCallback)(GLDEBUGPROC callback, const void *user_param) = nullptr;
+        void (CGLFL_API *DebugMessageControl)(GLenum source, GLenum type, GLenum severity, GLsizei count, const GLuint *ids, GLboolean enabled) = nullptr;
+    };
+
+    // Returns null pointers if `KHR_debug` is not supported.
+    static const DebugOutputFuncs &GetDebugOutputFuncs()
+    {
+        static const DebugOutputFuncs ret = []{
+            GLint major = 0, minor = 0;
+            glGetIntegerv(GL_MAJOR_VERSION, &major);
+            glGetIntegerv(GL_MINOR_VERSION, &minor);
+            bool supported = major > 4 || (major == 4 && minor >= 3);
+            if (!supported)
+            {
+                GLint num_extensions = 0;
+                glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+                for (GLint i = 0; i < num_extensions && !supported; i++)
+                {
+                    const char *name = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+                    supported = name && std::strcmp(name, "GL_KHR_debug") == 0;
+                }
+            }
+            if (!supported)
+                return DebugOutputFuncs{};
+
+            DebugOutputFuncs funcs;
+            funcs.DebugMessageCallback = reinterpret_cast<decltype(funcs.DebugMessageCallback)>(SDL_GL_GetProcAddress("glDebugMessageCallback"));
+            funcs.DebugMessageControl = reinterpret_cast<decltype(funcs.DebugMessageControl)>(SDL_GL_GetProcAddress("glDebugMessageControl"));
+            if (!funcs.DebugMessageCallback || !funcs.DebugMessageControl)
+                return DebugOutputFuncs{};
+            return funcs;
+        }();
+        return ret;
+    }
+
+    static DebugOutput *current_output = nullptr;
+
+    // The callback can run on any thread (e.g. during a threaded swap), so this is guarded by a mutex.
+    // This outlives the `DebugOutput`, since the driver can still call the callback after it's destroyed.
+    struct DebugMessages
+    {
+        std::mutex mutex;
+        std::string first_message; // The first error since the last `Check()`.
+        int count = 0;
+    };
+    static DebugMessages debug_messages;
+
+    static void CGLFL_API DebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar *message, const void *user_param)
+    {
+        (void)source;
+        (void)id;
+        (void)severity;
+        (void)user_param;
+
+        if (type != debug_type_error)
+            return;
+
+        std::lock_guard lock(debug_messages.mutex);
+        if (debug_messages.count++ == 0)
+            debug_messages.first_message = length < 0 ? std::string(message) : std::string(message, std::size_t(length));
+    }
+
+    // Enables or disables the error messages. The other messages are always disabled, since we don't report them anyway.
+    static void EnableDebugErrors(bool enable)
+    {
+        GetDebugOutputFuncs().DebugMessageControl(GL_DONT_CARE, debug_type_error, GL_DONT_CARE, 0, nullptr, enable);
+    }
+
+    DebugOutput::DebugOutput(int check_interval) : check_interval(check_interval)
+    {
+        ASSERT(!current_output, "Only one debug output can exist at a time.");
+        ASSERT(check_interval >= 1, "Invalid error check interval.");
+        current_output = this;
+
+        const DebugOutputFuncs &funcs = GetDebugOutputFuncs();
+        if (!funcs.DebugMessageCallback)
+            return;
+
+        glEnable(debug_output);
+        funcs.DebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, false);
+        EnableDebugErrors(true);
+        funcs.DebugMessageCallback(DebugCallback, nullptr);
+        active = true;
+    }
+
+    DebugOutput::~DebugOutput()
+    {
+        // Don't touch OpenGL here, the context could be already gone. The callback doesn't depend on this object.
+        if (current_output == this)
+            current_output = nullptr;
+    }
+
+    void DebugOutput::Check()
+    {
+        if (active)
+        {
+            std::string message;
+            int count = 0;
+            {
+                std::lock_guard lock(debug_messages.mutex);
+                message = std::move(debug_messages.first_message);
+                debug_messages.first_message.clear();
+                count = std::exchange(debug_messages.count, 0);
+            }
+            if (count > 0)
+                Program::Error("OpenGL error: ", message, count > 1 ? " (and " + std::to_string(count - 1) + " more)" : "");
+        }
+
+        if (++counter >= check_interval)
+        {
+            counter = 0;
+            CheckErrors();
+        }
+    }
+
+    DebugOutput::Mute::Mute()
+    {
+        if (current_output && current_output->active)
+            EnableDebugErrors(false);
+    }
+
+    DebugOutput::Mute::~Mute()
+    {
+        if (current_output && current_output->active)
+            EnableDebugErrors(true);
+    }
+}
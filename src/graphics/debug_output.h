@@ -0,0 +1,41 @@
+#pragma once
+
+namespace Graphics
+{
+    // Reports the OpenGL errors without calling `glGetError()` every frame, since that can force a pipeline sync on some drivers.
+    // If `KHR_debug` is available (core in GL 4.3), the driver reports the errors to a callback, and `Check()` only looks at what was collected.
+    // Not all drivers report anything outside of debug contexts, so `Check()` also calls `CheckErrors()` every `check_interval` calls.
+    // Needs an OpenGL context. Only one can exist at a time.
+    class DebugOutput
+    {
+        int check_interval = 1;
+        int counter = 0;
+        bool active = false;
+
+      public:
+        explicit DebugOutput(int check_interval);
+
+        DebugOutput(const DebugOutput &) = delete;
+        DebugOutput &operator=(const DebugOutput &) = delete;
+        ~DebugOutput();
+
+        // True if the errors are reported through `KHR_debug`.
+        [[nodiscard]] bool IsActive() const
+        {
+            return active;
+        }
+
+        // Throws if any errors were reported since the last call. Call this once per frame.
+        void Check();
+
+        // While this exists, the errors are not reported to the callback. Use this around the calls that can fail on purpose, and consume their errors with `glGetError()`.
+        class Mute
+        {
+          public:
+            Mute();
+            Mute(const Mute &) = delete;
+            Mute &operator=(const Mute &) = delete;
+            ~Mute();
+        };
+    };
+}
@@ -27,6 +27,11 @@ namespace Graphics
         using kerning_func_t = std::function<int(uint32_t, uint32_t)>;
         kerning_func_t kerning_func = 0;
 
+        // If set, `Get()` uses this instead of `glyphs`. Null result means the default glyph. This is used by `GlyphCache`.
+        using glyph_func_t = std::function<const Glyph *(uint32_t)>;
+        glyph_func_t glyph_func = 0;
+        int glyph_generation = 0; // Incremented when the existing glyphs move in the texture.
+
         // Some code might rely on references not being invalidated on insertion. Keep that in mind if you decide to change the container.
         std::unordered_map<uint32_t, Glyph> glyphs;
         Glyph default_glyph;
@@ -48,6 +53,15 @@ namespace Graphics
         {
             kerning_func = std::move(new_kerning_func);
         }
+        void SetGlyphFunc(glyph_func_t new_glyph_func) // Use null function to go back to the glyphs stored in the font.
+        {
+            glyph_func = std::move(new_glyph_func);
+            InvalidateGlyphs();
+        }
+        void InvalidateGlyphs() // Call this when the existing glyphs change their texture positions, to invalidate the cached text layouts.
+        {
+            glyph_generation++;
+        }
 
         int Ascent() const
         {
@@ -70,6 +84,15 @@ namespace Graphics
             return line_skip - Height();
         }
 
+        bool HasGlyphFunc() const
+        {
+            return bool(glyph_func);
+        }
+        int GlyphGeneration() const
+        {
+            return glyph_generation;
+        }
+
         const kerning_func_t KerningFunc() const
         {
             return kerning_func;
@@ -95,9 +118,15 @@ namespace Graphics
             return default_glyph;
         }
 
-        // Note that returned references remain valid even after insertions.
+        // Note that returned references remain valid even after insertions. With a glyph function, their lifetime is determined by it.
         const Glyph &Get(uint32_t ch) const
         {
+            if (glyph_func)
+            {
+                const Glyph *glyph = glyph_func(ch);
+                return glyph ? *glyph : default_glyph;
+            }
+
             if (auto it = glyphs.find(ch); it != glyphs.end())
                 return it->second;
             else
@@ -3,7 +3,10 @@
 #include <algorithm>
 #include <functional>
 #include <exception>
+#include <mutex>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include <ft2build.h>
 #include FT_FREETYPE_H // Ugh.
@@ -14,6 +17,7 @@
 #include "program/errors.h"
 #include "stream/readonly_data.h"
 #include "strings/format.h"
+#include "utils/jobs.h"
 #include "utils/mat.h"
 #include "utils/packing.h"
 #include "utils/unicode_ranges.h"
@@ -29,11 +33,14 @@ namespace Graphics
         inline static bool ft_initialized = 0;
         inline static FT_Library ft_context = 0;
         inline static int open_font_count = 0;
+        inline static std::mutex ft_mutex; // Guards the above, and the creation and destruction of the faces. Different faces can be used in parallel.
 
         struct Data
         {
             FT_Face ft_font = 0;
             Stream::ReadOnlyData file;
+            ivec2 size = ivec2(0); // Those are needed for `Reopen()`.
+            int index = 0;
         };
 
         Data data;
@@ -49,6 +56,8 @@ namespace Graphics
 
         FontFile(Stream::ReadOnlyData file, ivec2 size, int index = 0)
         {
+            std::lock_guard lock(ft_mutex);
+
             if (!ft_initialized)
             {
                 ft_initialized = !FT_Init_FreeType(&ft_context);
@@ -58,6 +67,8 @@ namespace Graphics
             }
 
             data.file = std::move(file); // Memory files are ref-counted, but moving won't hurt.
+            data.size = size;
+            data.index = index;
 
             FT_Open_Args args{};
             args.flags = FT_OPEN_MEMORY;
@@ -116,6 +127,7 @@ namespace Graphics
         {
             if (data.ft_font)
             {
+                std::lock_guard lock(ft_mutex);
                 FT_Done_Face(data.ft_font);
                 open_font_count--;
             }
@@ -123,6 +135,7 @@ namespace Graphics
 
         static void UnloadLibrary() // Use this to unload freetype. This function throws if you have opened fonts.
         {
+            std::lock_guard lock(ft_mutex);
             if (open_font_count > 0)
                 Program::Error("Unable to unload FreeType: ", open_font_count, " fonts are still in use.");
             if (ft_initialized)
@@ -136,6 +149,12 @@ namespace Graphics
             return bool(data.ft_font);
         }
 
+        // Opens the same font again, sharing the file contents. A face can only be used by one thread at a time, so each thread needs its own copy.
+        [[nodiscard]] FontFile Reopen() const
+        {
+            return FontFile(data.file, data.size, data.index);
+        }
+
         int Ascent() const
         {
             return data.ft_font->size->metrics.ascender >> 6; // Ascent is stored as 26.6 fixed point and it's supposed to be already rounded, so we truncate it.
@@ -201,12 +220,18 @@ namespace Graphics
             hinting_disable_autohinter = 1 << 4, // Disable auto-hinter. (It's already avoided by default.)
             hinting_mode_light         = 1 << 5, // Alternative hinting mode.
             hinting_mode_monochrome    = 1 << 6, // Hinting mode for monochrome rendering.
+            sdf                        = 1 << 7, // Render a signed distance field into the alpha channel, see `sdf_spread`. Can't be combined with `monochrome`.
 
             monochrome_with_hinting = monochrome | hinting_mode_monochrome,
         };
         friend constexpr RenderFlags operator|(RenderFlags a, RenderFlags b) {return RenderFlags(int(a) | int(b));}
         friend constexpr RenderFlags operator&(RenderFlags a, RenderFlags b) {return RenderFlags(int(a) & int(b));}
 
+        // With the `sdf` flag, the alpha is 128 on the glyph edge, and changes by `128 / sdf_spread` per pixel, increasing inwards.
+        // The glyph images get `sdf_spread` pixels of padding on each side. This is the FreeType default.
+        // Such glyphs can be scaled without rasterizing them again, if drawn from a linearly filtered texture. See `Render::Text_t::sdf()`.
+        static constexpr int sdf_spread = 8;
+
         struct GlyphData
         {
             Image image;
@@ -231,6 +256,15 @@ namespace Graphics
                 if (flags & hinting_mode_monochrome   ) loading_flags |= FT_LOAD_TARGET_MONO;
 
                 FT_Render_Mode render_mode = (flags & monochrome) ? FT_RENDER_MODE_MONO : FT_RENDER_MODE_NORMAL;
+                if (flags & sdf)
+                {
+                    ASSERT(!(flags & monochrome), "Monochrome signed distance fields are not supported.");
+                    #if FREETYPE_MAJOR > 2 || (FREETYPE_MAJOR == 2 && FREETYPE_MINOR >= 11)
+                    render_mode = FT_RENDER_MODE_SDF;
+                    #else
+                    Program::Error("Signed distance fields need FreeType 2.11 or newer.");
+                    #endif
+                }
 
                 if (FT_Load_Char(data.ft_font, ch, loading_flags) != 0 || FT_Render_Glyph(data.ft_font->glyph, render_mode) != 0)
                 {
@@ -272,26 +306,9 @@ namespace Graphics
                 ret.image = Image(size);
 
                 if (is_antialiased)
-                {
-                    for (int y = 0; y < size.y; y++)
-                    for (int x = 0; x < size.x; x++)
-                        ret.image.UnsafeAt(ivec2(x,y)) = u8vec3(255).to_vec4(bitmap.buffer[bitmap.pitch * y + x]);
-                }
+                    ret.image.UnsafeDrawAlpha8(ivec2(0), size, bitmap.buffer, bitmap.pitch);
                 else
-                {
-                    for (int y = 0; y < size.y; y++)
-                    {
-                        uint8_t *byte_ptr = bitmap.buffer + bitmap.pitch * y;
-                        uint8_t byte;
-                        for (int x = 0; x < size.x; x++)
-                        {
-                            if (x % 8 == 0)
-                                byte = *byte_ptr++;
-                            ret.image.UnsafeAt(ivec2(x,y)) = u8vec3(255).to_vec4(byte & 128 ? 255 : 0);
-                            byte <<= 1;
-                        }
-                    }
-                }
+                    ret.image.UnsafeDrawAlpha1(ivec2(0), size, bitmap.buffer, bitmap.pitch);
 
                 return ret;
             }
@@ -335,8 +352,13 @@ namespace Graphics
             Image image;
         };
 
-        std::vector<Glyph> glyphs;
-        std::vector<Packing::Rect> rects;
+        // What to rasterize, in the order of insertion.
+        struct Job
+        {
+            const FontAtlasEntry *entry = 0;
+            uint32_t ch = 0;
+        };
+        std::vector<Job> jobs;
 
         for (const FontAtlasEntry &entry : entries)
         {
@@ -348,21 +370,8 @@ namespace Graphics
 
             auto AddGlyph = [&](uint32_t ch)
             {
-                if (!entry.source->HasGlyph(ch))
-                    return;
-
-                // Copy glyph to the font.
-                FontFile::GlyphData glyph_data = entry.source->GetGlyph(ch, entry.render_flags);
-                Font::Glyph &font_glyph = (ch != Unicode::default_char ? entry.target->Insert(ch) : entry.target->DefaultGlyph());
-                font_glyph.size = glyph_data.image.Size();
-                font_glyph.offset = glyph_data.offset;
-                font_glyph.advance = glyph_data.advance;
-
-                // Save it into the glyph vector.
-                glyphs.push_back({&font_glyph, std::move(glyph_data.image)}); // We rely on the fact that Graphics::Font doesn't invalidate references on insertions.
-
-                // Save it into the rect vector.
-                rects.emplace_back(font_glyph.size);
+                if (entry.source->HasGlyph(ch))
+                    jobs.push_back({&entry, ch});
             };
 
             // Save the default glyph.
@@ -374,6 +383,53 @@ namespace Graphics
                 AddGlyph(ch);
         }
 
+        // Rasterize the glyphs in parallel. Each chunk reopens the fonts it needs, since a face can't be shared between threads.
+        // Small atlases are rasterized on this thread, where reopening the fonts isn't worth it.
+        std::vector<FontFile::GlyphData> glyph_data(jobs.size());
+        constexpr std::size_t min_glyphs_per_chunk = 64;
+        std::size_t num_chunks = std::min(Jobs::DefaultPool().ThreadCount() + 1, (jobs.size() + min_glyphs_per_chunk - 1) / min_glyphs_per_chunk);
+        if (num_chunks <= 1)
+        {
+            for (std::size_t i = 0; i < jobs.size(); i++)
+                glyph_data[i] = jobs[i].entry->source->GetGlyph(jobs[i].ch, jobs[i].entry->render_flags);
+        }
+        else
+        {
+            Jobs::DefaultPool().ParallelFor(num_chunks, [&](std::size_t chunk)
+            {
+                std::unordered_map<const FontFile *, FontFile> faces;
+                for (std::size_t i = jobs.size() * chunk / num_chunks; i < jobs.size() * (chunk + 1) / num_chunks; i++)
+                {
+                    const FontFile *source = jobs[i].entry->source;
+                    auto it = faces.find(source);
+                    if (it == faces.end())
+                        it = faces.try_emplace(source, source->Reopen()).first;
+                    glyph_data[i] = it->second.GetGlyph(jobs[i].ch, jobs[i].entry->render_flags);
+                }
+            }, 1);
+        }
+
+        std::vector<Glyph> glyphs;
+        std::vector<Packing::Rect> rects;
+        glyphs.reserve(jobs.size());
+        rects.reserve(jobs.size());
+
+        for (std::size_t i = 0; i < jobs.size(); i++)
+        {
+            // Copy glyph to the font.
+            Font *target = jobs[i].entry->target;
+            Font::Glyph &font_glyph = (jobs[i].ch != Unicode::default_char ? target->Insert(jobs[i].ch) : target->DefaultGlyph());
+            font_glyph.size = glyph_data[i].image.Size();
+            font_glyph.offset = glyph_data[i].offset;
+            font_glyph.advance = glyph_data[i].advance;
+
+            // Save it into the glyph vector.
+            glyphs.push_back({&font_glyph, std::move(glyph_data[i].image)}); // We rely on the fact that Graphics::Font doesn't invalidate references on insertions.
+
+            // Save it into the rect vector.
+            rects.emplace_back(font_glyph.size);
+        }
+
         // Pack rectangles.
         if (Packing::PackRects(size, rects.data(), rects.size(), add_gaps))
             Program::Error("Unable to fit the font atlas for into ", size.x, 'x', size.y, " rectangle.");
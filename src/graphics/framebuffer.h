@@ -126,6 +126,17 @@ namespace Graphics
         {
             BindHandle(0);
         }
+        // Re-reads the current binding from GL. Call this if something else could've changed it.
+        static void ForgetBinding()
+        {
+            GLint value = 0;
+            #ifdef GL_DRAW_FRAMEBUFFER_BINDING
+            glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &value);
+            #else
+            glGetIntegerv(GL_FRAMEBUFFER_BINDING, &value);
+            #endif
+            binding = GLuint(value);
+        }
         [[nodiscard]] bool Bound() const
         {
             return data.handle && binding == data.handle;
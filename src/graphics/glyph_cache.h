@@ -0,0 +1,227 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "graphics/font_file.h"
+#include "graphics/font.h"
+#include "graphics/image.h"
+#include "graphics/texture.h"
+#include "graphics/texture_uploader.h"
+#include "program/errors.h"
+#include "utils/mat.h"
+#include "utils/packing.h"
+#include "utils/unicode_ranges.h"
+#include "utils/unicode.h"
+
+namespace Graphics
+{
+    // Rasterizes the glyphs of a font on first use, into a region of an atlas image. An alternative to `MakeFontAtlas()` for large character sets.
+    // When the region is full, the least recently used glyphs are evicted. The glyphs used during the current frame are never evicted, since they can still be in a render queue.
+    // Don't capture the text into static geometry, since its glyphs can be evicted later.
+    // Call `BeginFrame()` once per frame, and `Flush()` before drawing, to upload the changed part of the image.
+    // The font forwards all its glyph lookups to the cache, so the cache can't be copied or moved.
+    class GlyphCache
+    {
+        struct CachedGlyph
+        {
+            Font::Glyph glyph;
+            std::uint64_t last_used_frame = 0;
+            bool missing = false; // The font file has no such glyph. Those don't take space.
+            bool pinned = false; // Never evicted.
+        };
+
+        Font *target = nullptr;
+        const FontFile *source = nullptr;
+        FontFile::RenderFlags render_flags = FontFile::none;
+
+        Image *image = nullptr;
+        ivec2 region_pos = ivec2(0);
+        Packing::MaxRectsPacker packer;
+
+        std::unordered_map<std::uint32_t, CachedGlyph> glyphs;
+        std::vector<std::pair<std::uint32_t, ivec2>> pinned_glyphs; // In the insertion order, with sizes. Repacking them in the same order gives the same positions.
+        std::uint64_t frame = 1;
+
+        ivec2 dirty_a = ivec2(0), dirty_b = ivec2(0); // The changed part of `image`, not uploaded yet. Empty if equal.
+
+        // Tries to make space for a rectangle of this size, and places it. Returns the position relative to `region_pos`.
+        [[nodiscard]] std::optional<ivec2> Allocate(ivec2 size)
+        {
+            if (auto pos = packer.Insert(size))
+                return pos;
+
+            // Evict the glyphs that weren't used this frame, oldest first.
+            std::vector<std::unordered_map<std::uint32_t, CachedGlyph>::iterator> candidates;
+            for (auto it = glyphs.begin(); it != glyphs.end(); it++)
+            {
+                if (!it->second.missing && !it->second.pinned && it->second.last_used_frame < frame)
+                    candidates.push_back(it);
+            }
+            std::sort(candidates.begin(), candidates.end(), [](const auto &a, const auto &b){return a->second.last_used_frame < b->second.last_used_frame;});
+
+            if (!candidates.empty())
+                target->InvalidateGlyphs();
+            for (auto it : candidates)
+            {
+                packer.Remove(it->second.glyph.texture_pos - region_pos, it->second.glyph.size);
+                glyphs.erase(it);
+                if (auto pos = packer.Insert(size))
+                    return pos;
+            }
+
+            // The packer doesn't merge the freed space, so it can still be fragmented.
+            // If only the pinned glyphs remain, repack them from scratch. They end up in the same places.
+            bool only_pinned = std::all_of(glyphs.begin(), glyphs.end(), [](const auto &elem){return elem.second.missing || elem.second.pinned;});
+            if (!only_pinned)
+                return {};
+
+            packer = Packing::MaxRectsPacker(packer.TargetSize(), 1);
+            for (const auto &[ch, glyph_size] : pinned_glyphs)
+            {
+                [[maybe_unused]] auto pos = packer.Insert(glyph_size);
+                ASSERT(pos, "Unable to repack the pinned glyphs.");
+            }
+            return packer.Insert(size);
+        }
+
+        // Rasterizes a glyph and adds it to the cache. Returns null if the font has no such glyph, or if it doesn't fit.
+        const Font::Glyph *Load(std::uint32_t ch, bool pinned)
+        {
+            if (!source->HasGlyph(ch))
+            {
+                glyphs.try_emplace(ch).first->second.missing = true;
+                return nullptr;
+            }
+
+            FontFile::GlyphData data = source->GetGlyph(ch, render_flags);
+            ivec2 size = data.image.Size();
+
+            std::optional<ivec2> rel_pos = Allocate(size);
+            if (!rel_pos)
+                return nullptr; // Not cached, so we'll try again on the next frame.
+
+            CachedGlyph &cached = glyphs.try_emplace(ch).first->second;
+            cached.glyph.texture_pos = region_pos + *rel_pos;
+            cached.glyph.size = size;
+            cached.glyph.offset = data.offset;
+            cached.glyph.advance = data.advance;
+            cached.last_used_frame = frame;
+            cached.pinned = pinned;
+            if (pinned)
+                pinned_glyphs.emplace_back(ch, size);
+
+            if (data.image)
+            {
+                image->UnsafeDrawImage(data.image, cached.glyph.texture_pos);
+
+                if (dirty_a == dirty_b)
+                {
+                    dirty_a = cached.glyph.texture_pos;
+                    dirty_b = cached.glyph.texture_pos + size;
+                }
+                else
+                {
+                    dirty_a = min(dirty_a, cached.glyph.texture_pos);
+                    dirty_b = max(dirty_b, cached.glyph.texture_pos + size);
+                }
+            }
+            return &cached.glyph;
+        }
+
+        // `Font::Get()` calls this.
+        const Font::Glyph *Get(std::uint32_t ch)
+        {
+            if (auto it = glyphs.find(ch); it != glyphs.end())
+            {
+                if (it->second.missing)
+                    return nullptr;
+                it->second.last_used_frame = frame;
+                return &it->second.glyph;
+            }
+            return Load(ch, false);
+        }
+
+      public:
+        // Uses the rectangle of size `size` at `pos` in `image`. The image must outlive the cache.
+        // The glyphs from `pinned` (if any) are rasterized immediately and never evicted. The default glyph is always pinned, unless disabled with `flags`.
+        GlyphCache(Font &target, const FontFile &source, Image &image, ivec2 pos, ivec2 size, FontFile::RenderFlags render_flags = FontFile::none,
+            const Unicode::CharSet *pinned = nullptr, FontAtlasEntry::Flags flags = FontAtlasEntry::none)
+            : target(&target), source(&source), render_flags(render_flags), image(&image), region_pos(pos), packer(size, 1)
+        {
+            // Throws on failure.
+            if (!image.RectInBounds(pos, size))
+                Program::Error("Invalid target rectangle for a glyph cache.");
+
+            image.UnsafeFill(pos, size, u8vec4(0));
+            dirty_a = pos;
+            dirty_b = pos + size;
+
+            target.SetAscent(source.Ascent());
+            target.SetDescent(source.Descent());
+            target.SetLineSkip(flags & FontAtlasEntry::no_line_gap ? source.Height() : source.LineSkip());
+            target.SetKerningFunc(source.KerningFunc());
+
+            if (!(flags & FontAtlasEntry::no_default_glyph))
+            {
+                if (const Font::Glyph *glyph = Load(Unicode::default_char, true))
+                    target.DefaultGlyph() = *glyph;
+                else
+                    Program::Error("Unable to fit the default glyph into the glyph cache.");
+            }
+
+            if (pinned)
+            {
+                for (std::uint32_t ch : *pinned)
+                {
+                    if (!Load(ch, true) && !glyphs.at(ch).missing)
+                        Program::Error("Unable to fit the pinned glyphs into a ", size.x, 'x', size.y, " glyph cache.");
+                }
+            }
+
+            target.SetGlyphFunc([this](std::uint32_t ch){return Get(ch);});
+        }
+
+        GlyphCache(const GlyphCache &) = delete;
+        GlyphCache &operator=(const GlyphCache &) = delete;
+
+        ~GlyphCache()
+        {
+            target->SetGlyphFunc(nullptr);
+        }
+
+        // Starts a new frame. The glyphs used before this point become available for eviction.
+        void BeginFrame()
+        {
+            frame++;
+        }
+
+        // Uploads the changed part of the image to `texture`, which must hold the whole image.
+        void Flush(Texture &texture)
+        {
+            if (dirty_a == dirty_b)
+                return;
+            Image part = image->UnsafeSubImage(dirty_a, dirty_b - dirty_a);
+            texture.SetDataPart(dirty_a, part.Size(), part.Data());
+            dirty_a = dirty_b = ivec2(0);
+        }
+        // Same, but uploads through the pixel buffers, without a temporary copy of the changed part.
+        void Flush(Texture &texture, TextureUploader &uploader)
+        {
+            if (dirty_a == dirty_b)
+                return;
+            uploader.SetDataPart(texture, *image, dirty_a, dirty_b - dirty_a);
+            dirty_a = dirty_b = ivec2(0);
+        }
+
+        // The number of cached glyphs, for debugging.
+        [[nodiscard]] std::size_t GlyphCount() const
+        {
+            return glyphs.size();
+        }
+    };
+}
@@ -0,0 +1,154 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <utility>
+
+#include <cglfl/cglfl.hpp>
+
+#include "program/errors.h"
+
+namespace Graphics
+{
+    // Measures the GPU time spent between `Begin()` and `End()`, using `GL_TIME_ELAPSED` queries.
+    // The queries are cycled, and the results are read only when available, a frame or two late, so this never stalls.
+    // Requires `ARB_timer_query` (core in GL 3.3). If it's absent, all functions are no-ops and there are no results.
+    // Only one timer can be running at a time, since the queries of this kind can't be nested.
+    class GpuTimer
+    {
+        // Not in the GL 3.2 headers.
+        static constexpr GLenum time_elapsed = 0x88BF; // GL_TIME_ELAPSED
+
+        static constexpr int num_queries = 3;
+
+        struct Data
+        {
+            std::array<GLuint, num_queries> queries{};
+            std::array<bool, num_queries> pending{}; // True if the query was issued and its result wasn't read yet.
+            int next_query = 0;
+            bool running = false;
+            std::optional<double> last_result; // In seconds.
+        };
+        Data data;
+
+        [[nodiscard]] static bool &AnyRunning()
+        {
+            static bool ret = false;
+            return ret;
+        }
+
+        // Reads the results that are already available, without waiting.
+        void PollResults()
+        {
+            // Check from oldest to newest, so the last available result wins.
+            for (int i = 0; i < num_queries; i++)
+            {
+                int index = (data.next_query + i) % num_queries;
+                if (!data.pending[index])
+                    continue;
+
+                GLuint available = 0;
+                glGetQueryObjectuiv(data.queries[index], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (!available)
+                    continue;
+
+                GLuint nanoseconds = 0;
+                glGetQueryObjectuiv(data.queries[index], GL_QUERY_RESULT, &nanoseconds);
+                data.last_result = nanoseconds * 1e-9;
+                data.pending[index] = false;
+            }
+        }
+
+      public:
+        GpuTimer() {}
+
+        GpuTimer(decltype(nullptr))
+        {
+            if (!IsSupported())
+                return;
+            glGenQueries(num_queries, data.queries.data());
+            for (GLuint query : data.queries)
+            {
+                if (!query)
+                    Program::Error("Unable to create a GPU timer query.");
+            }
+        }
+
+        GpuTimer(GpuTimer &&other) noexcept : data(std::exchange(other.data, {})) {}
+        GpuTimer &operator=(GpuTimer other) noexcept
+        {
+            std::swap(data, other.data);
+            return *this;
+        }
+
+        ~GpuTimer()
+        {
+            if (data.queries[0])
+                glDeleteQueries(num_queries, data.queries.data());
+        }
+
+        // Returns true if the timer queries are supported by the current context.
+        [[nodiscard]] static bool IsSupported()
+        {
+            static bool ret = []{
+                GLint major = 0, minor = 0;
+                glGetIntegerv(GL_MAJOR_VERSION, &major);
+                glGetIntegerv(GL_MINOR_VERSION, &minor);
+                if (major > 3 || (major == 3 && minor >= 3))
+                    return true;
+
+                GLint num_extensions = 0;
+                glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+                for (GLint i = 0; i < num_extensions; i++)
+                {
+                    const char *name = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+                    if (name && std::strcmp(name, "GL_ARB_timer_query") == 0)
+                        return true;
+                }
+                return false;
+            }();
+            return ret;
+        }
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return data.queries[0] != 0;
+        }
+
+        void Begin()
+        {
+            if (!*this)
+                return;
+            ASSERT(!AnyRunning(), "Only one GPU timer can be running at a time.");
+
+            PollResults();
+            if (data.pending[data.next_query])
+                return; // All queries are still in flight, skip this measurement.
+
+            glBeginQuery(time_elapsed, data.queries[data.next_query]);
+            data.running = true;
+            AnyRunning() = true;
+        }
+
+        void End()
+        {
+            if (!data.running)
+                return;
+            glEndQuery(time_elapsed);
+            data.pending[data.next_query] = true;
+            data.next_query = (data.next_query + 1) % num_queries;
+            data.running = false;
+            AnyRunning() = false;
+        }
+
+        // The last known result, in seconds. Lags behind by a few frames.
+        [[nodiscard]] std::optional<double> LastResult()
+        {
+            if (*this)
+                PollResults();
+            return data.last_result;
+        }
+    };
+}
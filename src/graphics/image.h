@@ -1,41 +1,157 @@
 #pragma once
 
 #include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <vector>
 #include <utility>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "program/errors.h"
 #include "macros/finally.h"
+#include "utils/alignment.h"
 #include "utils/mat.h"
 #include "stream/readonly_data.h"
+#include "stream/save_to_file.h"
 
 #include <stb_image.h>
 #include <stb_image_write.h>
 
 namespace Graphics
 {
+    // The row kernels used by `Image`. Those work on tightly packed RGBA8 pixels, and don't care about the alignment.
+    // With SSE2 they process 4 or 16 pixels at a time, otherwise the plain loops are left to the autovectorizer.
+    namespace ImageKernels
+    {
+        [[nodiscard]] inline std::uint32_t PackColor(u8vec4 color)
+        {
+            std::uint32_t ret;
+            std::memcpy(&ret, &color, 4);
+            return ret;
+        }
+
+        inline void Fill(u8vec4 *dst, int count, u8vec4 color)
+        {
+            int i = 0;
+            #if defined(__SSE2__)
+            __m128i value = _mm_set1_epi32(int(PackColor(color)));
+            for (; i + 4 <= count; i += 4)
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), value);
+            #endif
+            for (; i < count; i++)
+                dst[i] = color;
+        }
+
+        #if defined(__SSE2__)
+        // Writes 16 pixels, `color | alpha << 24`. `color` must have zero alpha.
+        inline void StoreAlpha16(u8vec4 *dst, __m128i color, __m128i alpha)
+        {
+            __m128i zero = _mm_setzero_si128();
+            __m128i lo = _mm_unpacklo_epi8(zero, alpha); // 16-bit lanes, alpha in the high byte.
+            __m128i hi = _mm_unpackhi_epi8(zero, alpha);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 0), _mm_or_si128(color, _mm_unpacklo_epi16(zero, lo)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 4), _mm_or_si128(color, _mm_unpackhi_epi16(zero, lo)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 8), _mm_or_si128(color, _mm_unpacklo_epi16(zero, hi)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 12), _mm_or_si128(color, _mm_unpackhi_epi16(zero, hi)));
+        }
+        #endif
+
+        // Writes `color.to_vec4(alpha[i])` to each pixel.
+        inline void ExpandAlpha8(u8vec4 *dst, const std::uint8_t *alpha, int count, u8vec3 color)
+        {
+            int i = 0;
+            #if defined(__SSE2__)
+            __m128i packed_color = _mm_set1_epi32(int(PackColor(color.to_vec4(0))));
+            for (; i + 16 <= count; i += 16)
+                StoreAlpha16(dst + i, packed_color, _mm_loadu_si128(reinterpret_cast<const __m128i *>(alpha + i)));
+            #endif
+            for (; i < count; i++)
+                dst[i] = color.to_vec4(alpha[i]);
+        }
+
+        // Same, but the alpha is 1 bit per pixel, most significant bit first, as in the monochrome FreeType bitmaps. Set bits give 255, the rest give 0.
+        inline void ExpandAlpha1(u8vec4 *dst, const std::uint8_t *bits, int count, u8vec3 color)
+        {
+            int i = 0;
+            #if defined(__SSE2__)
+            __m128i packed_color = _mm_set1_epi32(int(PackColor(color.to_vec4(0))));
+            __m128i bit_masks = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, char(128), 1, 2, 4, 8, 16, 32, 64, char(128));
+            for (; i + 16 <= count; i += 16)
+            {
+                // Spread the two bytes over 8 lanes each, then isolate one bit per lane.
+                __m128i bytes = _mm_unpacklo_epi64(_mm_set1_epi8(char(bits[i / 8])), _mm_set1_epi8(char(bits[i / 8 + 1])));
+                __m128i alpha = _mm_cmpeq_epi8(_mm_and_si128(bytes, bit_masks), bit_masks);
+                StoreAlpha16(dst + i, packed_color, alpha);
+            }
+            #endif
+            for (; i < count; i++)
+                dst[i] = color.to_vec4(bits[i / 8] & (128 >> (i % 8)) ? 255 : 0);
+        }
+
+        // Multiplies the color by the alpha, rounding to the nearest value.
+        inline void Premultiply(u8vec4 *pixels, int count)
+        {
+            // `(x + 128 + ((x + 128) >> 8)) >> 8` is `x / 255` rounded to the nearest, for `x <= 255 * 255`.
+            int i = 0;
+            #if defined(__SSE2__)
+            __m128i zero = _mm_setzero_si128();
+            __m128i half = _mm_set1_epi16(128);
+            __m128i alpha_mask = _mm_set_epi16(-1, 0, 0, 0, -1, 0, 0, 0);
+            auto Half = [&](__m128i p)
+            {
+                // Two pixels in 16-bit lanes.
+                __m128i a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(p, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(3,3,3,3));
+                __m128i x = _mm_add_epi16(_mm_mullo_epi16(p, a), half);
+                x = _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+                return _mm_or_si128(_mm_andnot_si128(alpha_mask, x), _mm_and_si128(alpha_mask, p));
+            };
+            for (; i + 4 <= count; i += 4)
+            {
+                __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pixels + i));
+                __m128i result = _mm_packus_epi16(Half(_mm_unpacklo_epi8(p, zero)), Half(_mm_unpackhi_epi8(p, zero)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(pixels + i), result);
+            }
+            #endif
+            for (; i < count; i++)
+            {
+                for (int j = 0; j < 3; j++)
+                {
+                    unsigned x = unsigned(pixels[i][j]) * pixels[i].a + 128;
+                    pixels[i][j] = std::uint8_t((x + (x >> 8)) >> 8);
+                }
+            }
+        }
+    }
+
     class Image
     {
         // Note that moved-from instance is left in an invalid (yet destructable) state.
 
+        // The atlas-sized images are many megabytes, so they get the huge pages.
+        using storage_t = std::vector<u8vec4, Storage::LargeBufferAllocator<u8vec4>>;
+
         ivec2 size = ivec2(0);
-        std::vector<u8vec4> data;
+        storage_t data;
 
       public:
-        enum Format {png, tga};
+        enum Format {png, tga, raw_compressed}; // `raw_compressed` is our own format, see `FromRawCompressed()`.
         enum FlipMode {no_flip, flip_y};
 
         Image() {}
         Image(ivec2 size, const uint8_t *bytes = 0) : size(size) // If `bytes == 0`, then the image will be filled with transparent black.
         {
             if (bytes)
-                data = std::vector<u8vec4>((u8vec4 *)bytes, (u8vec4 *)bytes + size.prod());
+                data = storage_t((u8vec4 *)bytes, (u8vec4 *)bytes + size.prod());
             else
-                data = std::vector<u8vec4>(size.prod());
+                data = storage_t(size.prod());
         }
         Image(ivec2 size, u8vec4 color) : size(size)
         {
-            data = std::vector<u8vec4>(size.prod(), color);
+            data = storage_t(size.prod(), color);
         }
         Image(Stream::ReadOnlyData file, FlipMode flip_mode = no_flip) // Throws on failure.
         {
@@ -48,12 +164,38 @@ namespace Graphics
             *this = Image(img_size, bytes);
         }
 
+        // Loads an image saved with the `raw_compressed` format: the width and height as 32-bit little-endian integers, followed by the RGBA pixels, compressed with `Archive::Compress()`.
+        // This is faster than decoding a PNG. Throws on failure.
+        [[nodiscard]] static Image FromRawCompressed(Stream::ReadOnlyData file)
+        {
+            Stream::ReadOnlyData raw = file.uncompress();
+            if (raw.size() < 8)
+                Program::Error("Unable to parse image: ", file.name());
+
+            ivec2 img_size;
+            for (int i = 0; i < 2; i++)
+            {
+                std::uint32_t value = 0;
+                for (int j = 0; j < 4; j++)
+                    value |= std::uint32_t(raw.data()[i * 4 + j]) << (j * 8);
+                img_size[i] = int(value);
+            }
+
+            if ((img_size < 0).any() || raw.size() != 8 + std::size_t(img_size.prod()) * 4)
+                Program::Error("Unable to parse image: ", file.name());
+
+            return Image(img_size, raw.data() + 8);
+        }
+
         explicit operator bool() const {return data.size() > 0;}
 
         const u8vec4 *Pixels() const {return data.data();}
         const uint8_t *Data() const {return (const uint8_t *)Pixels();}
         ivec2 Size() const {return size;}
 
+        // For `Refl::EstimateMemory()`.
+        [[nodiscard]] std::size_t EstimateOwnedMemory() const {return data.capacity() * sizeof(u8vec4);}
+
         bool PointInBounds(ivec2 point) const
         {
             return (point >= 0).all() && (point < size).all();
@@ -77,6 +219,18 @@ namespace Graphics
               case tga:
                 ok = stbi_write_tga(file_name.c_str(), size.x, size.y, 4, data.data());
                 break;
+              case raw_compressed:
+                {
+                    std::vector<std::uint8_t> bytes;
+                    bytes.reserve(8 + data.size() * 4);
+                    for (int i = 0; i < 2; i++)
+                    for (int j = 0; j < 4; j++)
+                        bytes.push_back(std::uint8_t(std::uint32_t(size[i]) >> (j * 8)));
+                    bytes.insert(bytes.end(), Data(), Data() + data.size() * 4);
+                    Stream::SaveFileCompressed(file_name, bytes);
+                    ok = 1;
+                }
+                break;
             }
 
             if (!ok)
@@ -107,18 +261,55 @@ namespace Graphics
 
         void UnsafeFill(ivec2 rect_pos, ivec2 rect_size, u8vec4 color)
         {
+            if (rect_size.x <= 0)
+                return;
+            if (rect_pos.x == 0 && rect_size.x == size.x) // Full rows are contiguous.
+            {
+                ImageKernels::Fill(&UnsafeAt(rect_pos), rect_size.prod(), color);
+                return;
+            }
             for (int y = rect_pos.y; y < rect_pos.y + rect_size.y; y++)
-            for (int x = rect_pos.x; x < rect_pos.x + rect_size.x; x++)
-                UnsafeAt(ivec2(x,y)) = color;
+                ImageKernels::Fill(&UnsafeAt(ivec2(rect_pos.x, y)), rect_size.x, color);
+        }
+
+        Image UnsafeSubImage(ivec2 rect_pos, ivec2 rect_size) const // Returns a copy of a part of this image.
+        {
+            Image ret(rect_size);
+            for (int y = 0; y < rect_size.y; y++)
+                std::memcpy(&ret.UnsafeAt(ivec2(0,y)), &UnsafeAt(rect_pos + ivec2(0,y)), rect_size.x * sizeof(u8vec4));
+            return ret;
         }
 
         void UnsafeDrawImage(const Image &other, ivec2 pos) // Copies other image into this image, at specified location.
         {
-            for (int y = 0; y < other.Size().y; y++)
+            if (!other)
+                return;
+            if (pos.x == 0 && other.Size().x == size.x) // Full rows are contiguous.
             {
-                auto source_address = &other.UnsafeAt(ivec2(0,y));
-                std::copy(source_address, source_address + other.Size().x, &UnsafeAt(ivec2(pos.x, y + pos.y)));
+                std::memcpy(&UnsafeAt(pos), other.Pixels(), other.data.size() * sizeof(u8vec4));
+                return;
             }
+            for (int y = 0; y < other.Size().y; y++)
+                std::memcpy(&UnsafeAt(ivec2(pos.x, y + pos.y)), &other.UnsafeAt(ivec2(0,y)), other.Size().x * sizeof(u8vec4));
+        }
+
+        // Draws a `rect_size` alpha mask with 8 bits per pixel, as `color.to_vec4(alpha)`. `pitch` is the distance between the rows in bytes.
+        void UnsafeDrawAlpha8(ivec2 pos, ivec2 rect_size, const std::uint8_t *alpha, int pitch, u8vec3 color = u8vec3(255))
+        {
+            for (int y = 0; y < rect_size.y; y++)
+                ImageKernels::ExpandAlpha8(&UnsafeAt(pos + ivec2(0,y)), alpha + std::ptrdiff_t(pitch) * y, rect_size.x, color);
+        }
+        // Same, but with 1 bit per pixel, most significant bit first. The set bits give full opacity.
+        void UnsafeDrawAlpha1(ivec2 pos, ivec2 rect_size, const std::uint8_t *bits, int pitch, u8vec3 color = u8vec3(255))
+        {
+            for (int y = 0; y < rect_size.y; y++)
+                ImageKernels::ExpandAlpha1(&UnsafeAt(pos + ivec2(0,y)), bits + std::ptrdiff_t(pitch) * y, rect_size.x, color);
+        }
+
+        // Multiplies the color of each pixel by its alpha.
+        void Premultiply()
+        {
+            ImageKernels::Premultiply(data.data(), int(data.size()));
         }
     };
 }
@@ -18,15 +18,18 @@ namespace Graphics
         IndexBuffers() = delete;
         ~IndexBuffers() = delete;
 
+        // The index buffer binding is a part of the VAO state, so we remember which VAO it was bound in.
         inline static GLuint binding = 0;
+        inline static GLuint binding_vertex_array = 0;
 
       public:
         static void Bind(GLuint handle)
         {
-            if (binding == handle)
+            if (binding == handle && binding_vertex_array == VertexBuffers::VertexArrayBinding())
                 return;
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, handle);
             binding = handle;
+            binding_vertex_array = VertexBuffers::VertexArrayBinding();
         }
 
         static void ForgetBoundBuffer()
@@ -34,9 +37,16 @@ namespace Graphics
             binding = 0;
         }
 
+        // Call this before deleting a buffer. If it was bound in a different VAO, it stays attached to it, so we must forget it anyway.
+        static void ForgetBuffer(GLuint handle)
+        {
+            if (binding == handle)
+                binding = 0;
+        }
+
         static GLuint Binding()
         {
-            return binding;
+            return binding_vertex_array == VertexBuffers::VertexArrayBinding() ? binding : 0;
         }
     };
 
@@ -81,8 +91,7 @@ namespace Graphics
 
         ~IndexBuffer()
         {
-            if (Bound())
-                IndexBuffers::ForgetBoundBuffer(); // GL unbinds the buffer automatically.
+            IndexBuffers::ForgetBuffer(data.handle); // GL unbinds the buffer automatically, at least from the current VAO.
             if (data.handle)
                 glDeleteBuffers(1, &data.handle); // Deleting 0 is a no-op, but GL could be unloaded at this point.
         }
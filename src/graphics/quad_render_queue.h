@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "graphics/index_buffer.h"
+#include "graphics/simple_render_queue.h"
+#include "graphics/vertex_buffer.h"
+
+namespace Graphics
+{
+    // Like `SimpleRenderQueue<T, 3>`, but uploads only 4 vertices per quad, and uses a static index buffer to split them into triangles.
+    // Triangles are stored as quads with the last vertex duplicated.
+    template <typename T>
+    class QuadRenderQueue
+    {
+        static_assert(Graphics::VertexBuffer<T>::is_reflected, "The type must be reflected.");
+
+        using index_t = std::uint32_t;
+
+        std::size_t pos = 0, size = 0; // These are measured in quads.
+        std::unique_ptr<T[]> storage;
+        StreamingVertexBuffer<T> buffer;
+        IndexBuffer<index_t> indices;
+        RenderQueueStats stats; // Triangles are counted as quads.
+
+      public:
+        QuadRenderQueue() {}
+
+        // The size is measured in quads.
+        // See `StreamingVertexBuffer` for the meaning of `num_buffers`.
+        QuadRenderQueue(std::size_t size, StreamingMode mode = StreamingMode::single_buffer, int num_buffers = 3)
+            : size(size), storage(std::make_unique<T[]>(size * 4)), buffer(size * 4, mode, num_buffers)
+        {
+            // Cover the whole buffer, since the uploads can land at any offset in it. The offsets are always multiples of 4.
+            std::size_t num_quads = buffer.TotalCapacity() / 4;
+            std::vector<index_t> index_data(num_quads * 6);
+            for (std::size_t i = 0; i < num_quads; i++)
+            {
+                // Same vertex order as in `SimpleRenderQueue`.
+                index_t base = i * 4;
+                index_t *ptr = index_data.data() + i * 6;
+                ptr[0] = base + 0; ptr[1] = base + 1; ptr[2] = base + 3;
+                ptr[3] = base + 3; ptr[4] = base + 1; ptr[5] = base + 2;
+            }
+            indices = IndexBuffer<index_t>(index_data.size(), index_data.data());
+        }
+
+        [[nodiscard]] explicit operator bool()
+        {
+            return bool(storage);
+        }
+
+        // Returns true if the next operation would flush.
+        [[nodiscard]] bool Full()
+        {
+            return pos == size;
+        }
+
+        // How many quads are currently in the queue.
+        [[nodiscard]] std::size_t Pos() const
+        {
+            return pos;
+        }
+
+        // The max number of quads the queue can hold.
+        [[nodiscard]] std::size_t Size() const
+        {
+            return size;
+        }
+
+        [[nodiscard]] StreamingMode Mode() const
+        {
+            return buffer.Mode();
+        }
+
+        [[nodiscard]] const RenderQueueStats &Stats() const
+        {
+            return stats;
+        }
+        void ResetStats()
+        {
+            stats = {};
+        }
+
+        void Flush()
+        {
+            if (pos <= 0)
+                return;
+            std::size_t offset = 0;
+            const VertexBuffer<T> &vertices = buffer.Upload(pos * 4, storage.get(), offset);
+            indices.Draw(vertices, triangles, offset / 4 * 6, pos * 6);
+            stats.flushes++;
+            stats.primitives += pos;
+            stats.vertices += pos * 4;
+            stats.bytes += pos * 4 * sizeof(T);
+            pos = 0;
+        }
+
+        void Add(const T &a, const T &b, const T &c)
+        {
+            Add(a, b, c, c);
+        }
+        void Add(const T &a, const T &b, const T &c, const T &d)
+        {
+            if (pos >= size)
+            {
+                stats.full_flushes++;
+                Flush();
+            }
+            T *ptr = storage.get() + pos * 4;
+            ptr[0] = a;
+            ptr[1] = b;
+            ptr[2] = c;
+            ptr[3] = d;
+            pos++;
+        }
+    };
+}
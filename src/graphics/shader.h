@@ -1,11 +1,14 @@
 #pragma once
 
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <type_traits>
 #include <utility>
 
 #include <cglfl/cglfl.hpp>
 
+#include "graphics/shader_cache.h"
 #include "graphics/texture.h"
 #include "graphics/types.h"
 #include "macros/finally.h"
@@ -14,6 +17,7 @@
 #include "reflection/structs.h"
 #include "strings/common.h"
 #include "strings/format.h"
+#include "utils/hash.h"
 
 namespace Graphics
 {
@@ -232,6 +236,7 @@ namespace Graphics
         // `name` is not saved, and is used only in exception messages if this constructor throws.
         // `attributes` is a list of attributes for which you want to force specific locations (index of the name becomes the location), can be empty.
         // Strings from `cfg` are appended to the shader sources.
+        // If a `ShaderCache` exists, the program is loaded from it if possible, and is otherwise added to it. `name` is the key in the cache.
         Shader(std::string name, const ShaderConfig &cfg, std::string vert_source, std::string frag_source, const std::vector<std::string> &attributes = {})
         {
             data.handle = glCreateProgram();
@@ -239,13 +244,27 @@ namespace Graphics
                 Program::Error("Unable to create shader program: `", name, "`.");
             FINALLY_ON_THROW( glDeleteProgram(data.handle); )
 
+            vert_source = cfg.common_header + "\n" + cfg.vertex_header + "\n" + vert_source;
+            frag_source = cfg.common_header + "\n" + cfg.fragment_header + "\n" + frag_source;
+
+            ShaderCache *cache = ShaderCache::Current();
+            std::uint64_t source_hash = 0;
+            if (cache)
+            {
+                // The attribute locations are baked into the binary, so they're a part of the key.
+                std::string key = vert_source + '\0' + frag_source;
+                for (const std::string &attrib : attributes)
+                    key += '\0' + attrib;
+                source_hash = Hash::Bytes(key.data(), key.size());
+
+                if (cache->Load(data.handle, name, source_hash))
+                    return;
+            }
+
             for (std::string *source_ptr : {&vert_source, &frag_source})
             {
                 bool is_vertex = source_ptr == &vert_source;
-                std::string &source = *source_ptr;
-
-                std::string header = cfg.common_header + "\n" + (is_vertex ? cfg.vertex_header : cfg.fragment_header) + "\n";
-                source = header + source;
+                const std::string &source = *source_ptr;
 
                 // Uncomment to dump source:
                 // std::cout << "\n==================\n" << source << "\n==================\n";
@@ -289,6 +308,9 @@ namespace Graphics
             for (const std::string &attrib : attributes)
                 glBindAttribLocation(data.handle, attrib_index++, attrib.c_str());
 
+            if (cache)
+                ShaderCache::PrepareToAdd(data.handle);
+
             glLinkProgram(data.handle);
 
             GLint status;
@@ -312,6 +334,9 @@ namespace Graphics
 
                 Program::Error("Unable to link shader program: `", name, "`.\nLog:\n", Strings::Trim(log));
             }
+
+            if (cache)
+                cache->Add(data.handle, name, source_hash);
         }
 
         // Advanced constructor.
@@ -403,6 +428,7 @@ namespace Graphics
         {
             handle = new_handle;
             location = new_location;
+            has_shadow = false;
         }
 
       public:
@@ -422,10 +448,16 @@ namespace Graphics
 
         using base_type = typename std::conditional_t<Math::scalar<effective_type>, std::enable_if<1, effective_type>, effective_type>::type; // Vectors and matrices become scalars here.
 
+      private:
+        // The last value assigned with `operator=`, to skip assigning the same value again. Not used for arrays.
+        // The copies of a uniform have separate shadows, so don't assign the same uniform through several copies.
+        mutable effective_type shadow{};
+        mutable bool has_shadow = false;
 
+      public:
         Uniform() {}
 
-        const type &operator=(const type &object) const // Binds the shader.
+        const type &operator=(const type &object) const // Binds the shader, unless the value didn't change.
         {
             static_assert(!is_array, "Use .set() to set arrays.");
 
@@ -434,6 +466,17 @@ namespace Graphics
             if (!handle)
                 return object;
 
+            effective_type value;
+            if constexpr (is_texture)
+                value = object.Index();
+            else
+                value = effective_type(object);
+            // Comparing the bytes, since the matrices don't have `==`. This treats `-0` and `0` as different, which is harmless.
+            if (has_shadow && std::memcmp(&shadow, &value, sizeof value) == 0)
+                return object;
+            shadow = value;
+            has_shadow = true;
+
             Shader::BindHandle(handle);
 
             if      constexpr (is_texture) glUniform1i(location, object.Index());
@@ -464,6 +507,7 @@ namespace Graphics
             Shader::BindHandle(handle);
 
             set_no_bind(ptr, count, offset);
+            has_shadow = false;
         }
 
       private:
@@ -0,0 +1,176 @@
+#include "shader_cache.h"
+
+#include <cstring>
+#include <utility>
+
+#include <SDL.h>
+
+#include "graphics/debug_output.h"
+#include "reflection/full.h"
+#include "stream/input.h"
+#include "stream/save_to_file.h"
+#include "utils/filesystem.h"
+
+namespace Graphics
+{
+    // Not in the GL 3.2 headers.
+    static constexpr GLenum program_binary_retrievable_hint = 0x8257; // GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    static constexpr GLenum program_binary_length = 0x8741; // GL_PROGRAM_BINARY_LENGTH
+    static constexpr GLenum num_program_binary_formats = 0x87FE; // GL_NUM_PROGRAM_BINARY_FORMATS
+
+    // The loader doesn't know about those functions, so we load them ourselves.
+    struct ProgramBinaryFuncs
+    {
+        void (CGLFL_API *GetProgramBinary)(GLuint program, GLsizei buf_size, GLsizei *length, GLenum *format, void *binary) = nullptr;
+        void (CGLFL_API *ProgramBinary)(GLuint program, GLenum format, const void *binary, GLsizei length) = nullptr;
+        void (CGLFL_API *ProgramParameteri)(GLuint program, GLenum name, GLint value) = nullptr;
+    };
+
+    // Returns null pointers if the binaries are not supported.
+    static const ProgramBinaryFuncs &GetProgramBinaryFuncs()
+    {
+        static const ProgramBinaryFuncs ret = []{
+            GLint major = 0, minor = 0;
+            glGetIntegerv(GL_MAJOR_VERSION, &major);
+            glGetIntegerv(GL_MINOR_VERSION, &minor);
+            bool supported = major > 4 || (major == 4 && minor >= 1);
+            if (!supported)
+            {
+                GLint num_extensions = 0;
+                glGetIntegerv(GL_NUM_EXTENSIONS, &num_extensions);
+                for (GLint i = 0; i < num_extensions && !supported; i++)
+                {
+                    const char *name = reinterpret_cast<const char *>(glGetStringi(GL_EXTENSIONS, i));
+                    supported = name && std::strcmp(name, "GL_ARB_get_program_binary") == 0;
+                }
+            }
+            if (!supported)
+                return ProgramBinaryFuncs{};
+
+            // Some drivers have the extension, but no formats to save to.
+            GLint num_formats = 0;
+            glGetIntegerv(num_program_binary_formats, &num_formats);
+            if (num_formats <= 0)
+                return ProgramBinaryFuncs{};
+
+            ProgramBinaryFuncs funcs;
+            funcs.GetProgramBinary = reinterpret_cast<decltype(funcs.GetProgramBinary)>(SDL_GL_GetProcAddress("glGetProgramBinary"));
+            funcs.ProgramBinary = reinterpret_cast<decltype(funcs.ProgramBinary)>(SDL_GL_GetProcAddress("glProgramBinary"));
+            funcs.ProgramParameteri = reinterpret_cast<decltype(funcs.ProgramParameteri)>(SDL_GL_GetProcAddress("glProgramParameteri"));
+            if (!funcs.GetProgramBinary || !funcs.ProgramBinary || !funcs.ProgramParameteri)
+                return ProgramBinaryFuncs{};
+            return funcs;
+        }();
+        return ret;
+    }
+
+    static std::string DriverString()
+    {
+        std::string ret;
+        for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+        {
+            if (const char *str = reinterpret_cast<const char *>(glGetString(name)))
+                ret += str;
+            ret += '\n';
+        }
+        return ret;
+    }
+
+    static ShaderCache *current_cache = nullptr;
+
+    ShaderCache::ShaderCache(std::string file_name) : file_name(std::move(file_name))
+    {
+        ASSERT(!current_cache, "Only one shader cache can exist at a time.");
+        if (!IsSupported())
+            return;
+        current_cache = this;
+
+        contents.driver = DriverString();
+
+        bool ok = false;
+        auto info = Filesystem::GetObjectInfo(this->file_name, &ok);
+        if (!ok || info.category != Filesystem::file)
+            return;
+
+        try
+        {
+            Contents loaded;
+            Refl::FromBinary(loaded, Stream::Input(this->file_name));
+            if (loaded.driver == contents.driver)
+                contents = std::move(loaded);
+        }
+        catch (...) {}
+    }
+
+    ShaderCache::~ShaderCache()
+    {
+        if (current_cache == this)
+            current_cache = nullptr;
+    }
+
+    bool ShaderCache::IsSupported()
+    {
+        return GetProgramBinaryFuncs().ProgramBinary != nullptr;
+    }
+
+    ShaderCache *ShaderCache::Current()
+    {
+        return current_cache;
+    }
+
+    bool ShaderCache::Load(GLuint program, const std::string &name, std::uint64_t source_hash)
+    {
+        auto it = contents.programs.find(name);
+        if (it == contents.programs.end())
+            return false;
+
+        const Entry &entry = it->second;
+        if (entry.source_hash != source_hash || entry.data.empty())
+            return false;
+
+        {
+            DebugOutput::Mute mute; // A rejected binary is a GL error, handled below.
+            GetProgramBinaryFuncs().ProgramBinary(program, entry.format, entry.data.data(), GLsizei(entry.data.size()));
+        }
+
+        // The driver can reject the binary at any time, e.g. after an update that didn't change the version string.
+        GLint status = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if (status)
+            return true;
+        while (glGetError() != GL_NO_ERROR) {} // An unknown format is reported as a GL error, and we don't want anyone else to see it.
+        contents.programs.erase(it);
+        return false;
+    }
+
+    void ShaderCache::PrepareToAdd(GLuint program)
+    {
+        if (IsSupported())
+            GetProgramBinaryFuncs().ProgramParameteri(program, program_binary_retrievable_hint, GL_TRUE);
+    }
+
+    void ShaderCache::Add(GLuint program, const std::string &name, std::uint64_t source_hash)
+    {
+        GLint length = 0;
+        glGetProgramiv(program, program_binary_length, &length);
+        if (length <= 0)
+            return;
+
+        Entry entry;
+        entry.source_hash = source_hash;
+        entry.data.resize(std::size_t(length));
+        GLenum format = 0;
+        GetProgramBinaryFuncs().GetProgramBinary(program, length, &length, &format, entry.data.data());
+        if (length <= 0)
+            return;
+        entry.data.resize(std::size_t(length));
+        entry.format = format;
+        contents.programs[name] = std::move(entry);
+
+        try
+        {
+            Stream::SaveFile(file_name, Refl::ToBinary<std::vector<std::uint8_t>>(contents));
+        }
+        catch (...) {}
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <cglfl/cglfl.hpp>
+
+#include "reflection/structs.h"
+
+namespace Graphics
+{
+    // A file with the linked shader programs, to skip compiling them on the next launch. Uses `GL_ARB_get_program_binary` (core in GL 4.1).
+    // A cached program is only used if it was built from the same source by the same driver, otherwise `Shader` compiles it and updates the cache.
+    // While a cache exists, all `Shader`s use it. At most one cache can exist at a time.
+    class ShaderCache
+    {
+        REFL_SIMPLE_STRUCT( Entry
+            REFL_DECL(std::uint64_t REFL_INIT = 0) source_hash // See `Shader`.
+            REFL_DECL(std::uint32_t REFL_INIT = 0) format // For `glProgramBinary()`.
+            REFL_DECL(std::vector<std::uint8_t>) data
+        )
+
+        REFL_SIMPLE_STRUCT( Contents
+            REFL_DECL(std::string) driver // The vendor, renderer and version strings. If they change, the whole cache is discarded.
+            REFL_DECL(std::map<std::string, Entry>) programs // The keys are the shader names.
+        )
+
+        std::string file_name;
+        Contents contents;
+
+      public:
+        // Loads the cache from a file. If it's missing, invalid, or was made by a different driver, the cache is empty.
+        // Needs an OpenGL context. If the binaries aren't supported, does nothing, and `Shader`s are always compiled.
+        explicit ShaderCache(std::string file_name);
+
+        ShaderCache(const ShaderCache &) = delete;
+        ShaderCache &operator=(const ShaderCache &) = delete;
+        ~ShaderCache();
+
+        // Returns true if the current context can save and load program binaries.
+        [[nodiscard]] static bool IsSupported();
+
+        // Returns the cache that `Shader`s should use, or null if none.
+        [[nodiscard]] static ShaderCache *Current();
+
+        // If this program is cached with this source hash, loads it into `program` and returns true.
+        // Returns false if it's not cached, or if the driver rejects the binary.
+        [[nodiscard]] bool Load(GLuint program, const std::string &name, std::uint64_t source_hash);
+
+        // Call this before linking a program that you're going to `Add()`. Some drivers don't give out the binaries otherwise.
+        static void PrepareToAdd(GLuint program);
+
+        // Adds a freshly linked program to the cache, and saves the cache to the file. Ignores the errors.
+        void Add(GLuint program, const std::string &name, std::uint64_t source_hash);
+    };
+}
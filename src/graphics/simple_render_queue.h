@@ -10,6 +10,109 @@
 
 namespace Graphics
 {
+    // How `SimpleRenderQueue` uploads the vertices.
+    enum class StreamingMode
+    {
+        single_buffer, // Overwrite the same buffer on every flush. This can stall on some drivers if the queue is flushed several times per frame.
+        orphaning, // Reallocate the buffer storage before each upload, so the driver can give us new memory instead of waiting.
+        round_robin, // Cycle through several buffers.
+        unsynchronized_map, // Append to a ring buffer several times larger than the queue, mapping it without synchronization. Orphan it when it wraps around.
+    };
+
+    // What a render queue did since the last `ResetStats()`.
+    struct RenderQueueStats
+    {
+        std::size_t flushes = 0; // Only the ones that drew something.
+        std::size_t full_flushes = 0; // The part of `flushes` caused by the queue being full.
+        std::size_t primitives = 0;
+        std::size_t vertices = 0; // The uploaded vertices, which can be less than the drawn ones if there's an index buffer.
+        std::size_t bytes = 0; // The uploaded bytes.
+    };
+
+    // A vertex buffer for the data that is uploaded and drawn once. Used by the render queues.
+    template <typename T>
+    class StreamingVertexBuffer
+    {
+        StreamingMode mode = StreamingMode::single_buffer;
+        std::size_t capacity = 0; // The max number of elements uploaded at once.
+        std::vector<VertexBuffer<T>> buffers; // Only `round_robin` uses more than one.
+        std::size_t buffer_index = 0; // For `round_robin`.
+        std::size_t ring_pos = 0, ring_size = 0; // For `unsynchronized_map`.
+
+      public:
+        StreamingVertexBuffer() {}
+
+        // `num_buffers` is only used by `round_robin` (the number of buffers) and `unsynchronized_map` (the ring buffer size, in multiples of `capacity`).
+        StreamingVertexBuffer(std::size_t capacity, StreamingMode mode = StreamingMode::single_buffer, int num_buffers = 3)
+            : mode(mode), capacity(capacity)
+        {
+            ASSERT(num_buffers >= 1, "Invalid number of buffers.");
+
+            switch (mode)
+            {
+              case StreamingMode::single_buffer:
+              case StreamingMode::orphaning:
+                buffers.emplace_back(capacity, nullptr, stream_draw);
+                break;
+              case StreamingMode::round_robin:
+                for (int i = 0; i < num_buffers; i++)
+                    buffers.emplace_back(capacity, nullptr, stream_draw);
+                break;
+              case StreamingMode::unsynchronized_map:
+                ring_size = capacity * num_buffers;
+                buffers.emplace_back(ring_size, nullptr, stream_draw);
+                break;
+            }
+        }
+
+        [[nodiscard]] StreamingMode Mode() const
+        {
+            return mode;
+        }
+
+        // The max number of elements that can be in the buffer after the first upload, for all buffers combined.
+        // Upload offsets are always less than this.
+        [[nodiscard]] std::size_t TotalCapacity() const
+        {
+            return mode == StreamingMode::unsynchronized_map ? ring_size : capacity;
+        }
+
+        // Uploads `count` elements, at most `capacity`. Returns the buffer they were uploaded to.
+        // Writes the index of the first uploaded element in that buffer to `offset`.
+        // If `count` is always a multiple of some number, `offset` is a multiple of it too.
+        [[nodiscard]] const VertexBuffer<T> &Upload(std::size_t count, const T *source, std::size_t &offset)
+        {
+            ASSERT(count <= capacity, "Too many elements for a streaming vertex buffer.");
+
+            offset = 0;
+            switch (mode)
+            {
+              case StreamingMode::single_buffer:
+                break;
+              case StreamingMode::orphaning:
+                buffers[0].SetData(capacity, nullptr, stream_draw);
+                break;
+              case StreamingMode::round_robin:
+                buffer_index = (buffer_index + 1) % buffers.size();
+                break;
+              case StreamingMode::unsynchronized_map:
+                if (ring_pos + count > ring_size)
+                {
+                    buffers[0].SetData(ring_size, nullptr, stream_draw);
+                    ring_pos = 0;
+                }
+                offset = ring_pos;
+                ring_pos += count;
+                buffers[0].SetDataPartUnsynchronized(offset, count, source);
+                return buffers[0];
+            }
+
+            VertexBuffer<T> &buffer = buffers[buffer_index];
+            buffer.SetDataPart(0, count, source);
+            return buffer;
+        }
+    };
+
     template <typename T, int N>
     class SimpleRenderQueue
     {
@@ -18,7 +121,8 @@ namespace Graphics
 
         std::size_t pos = 0, size = 0; // These are measured in primitives, not vertices.
         std::unique_ptr<T[]> storage;
-        Graphics::VertexBuffer<T> buffer;
+        StreamingVertexBuffer<T> buffer;
+        RenderQueueStats stats;
 
         template <typename ...P>
         void AddLow(const P &... p)
@@ -26,7 +130,10 @@ namespace Graphics
             static_assert(sizeof...(P) == N);
             static_assert((std::is_same_v<P, T> && ...));
             if (pos >= size)
+            {
+                stats.full_flushes++;
                 Flush();
+            }
             int offset = 0;
             (std::copy_n(&p, 1, storage.get() + N * pos + offset++) , ...);
             pos++;
@@ -36,7 +143,10 @@ namespace Graphics
         SimpleRenderQueue() {}
 
         // The size is measured in primitives, not vertices.
-        SimpleRenderQueue(std::size_t size) : size(size), storage(std::make_unique<T[]>(size * N)), buffer(size * N, 0, Graphics::stream_draw) {}
+        // See `StreamingVertexBuffer` for the meaning of `num_buffers`.
+        SimpleRenderQueue(std::size_t size, StreamingMode mode = StreamingMode::single_buffer, int num_buffers = 3)
+            : size(size), storage(std::make_unique<T[]>(size * N)), buffer(size * N, mode, num_buffers)
+        {}
 
         [[nodiscard]] explicit operator bool()
         {
@@ -61,12 +171,30 @@ namespace Graphics
             return size;
         }
 
+        [[nodiscard]] StreamingMode Mode() const
+        {
+            return buffer.Mode();
+        }
+
+        [[nodiscard]] const RenderQueueStats &Stats() const
+        {
+            return stats;
+        }
+        void ResetStats()
+        {
+            stats = {};
+        }
+
         void Flush()
         {
             if (pos <= 0)
                 return;
-            buffer.SetDataPart(0, pos * N, storage.get());
-            buffer.Draw(std::array{points, lines, triangles}[N-1], pos * N);
+            std::size_t offset = 0;
+            buffer.Upload(pos * N, storage.get(), offset).Draw(std::array{points, lines, triangles}[N-1], offset, pos * N);
+            stats.flushes++;
+            stats.primitives += pos;
+            stats.vertices += pos * N;
+            stats.bytes += pos * N * sizeof(T);
             pos = 0;
         }
 
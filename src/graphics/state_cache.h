@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cglfl/cglfl.hpp>
+
+#include "graphics/framebuffer.h"
+#include "utils/mat.h"
+
+namespace Graphics
+{
+    // Remembers the GL state set through `Blending`, `Scissor` and `Viewport()`, and skips the calls that wouldn't change it.
+    // The framebuffer binding is cached by `FrameBuffer` itself.
+    // If something else changes this state without restoring it, call `Invalidate()` afterwards.
+    class StateCache
+    {
+        StateCache() = delete;
+        ~StateCache() = delete;
+
+        // -1 means unknown.
+        inline static int blending = -1;
+        inline static int scissor_test = -1;
+
+        inline static bool has_blend_func = false;
+        inline static GLenum blend_func[4] = {};
+
+        inline static bool has_blend_equation = false;
+        inline static GLenum blend_equation[2] = {};
+
+        inline static bool has_scissor_box = false;
+        inline static ivec2 scissor_pos, scissor_size;
+
+        inline static bool has_viewport = false;
+        inline static ivec2 viewport_pos, viewport_size;
+
+        static void SetCapability(int &cached, GLenum cap, bool enable)
+        {
+            if (cached == int(enable))
+                return;
+            if (enable)
+                glEnable(cap);
+            else
+                glDisable(cap);
+            cached = enable;
+        }
+
+      public:
+        static void SetBlending(bool enable)
+        {
+            SetCapability(blending, GL_BLEND, enable);
+        }
+
+        static void SetBlendFunc(GLenum src, GLenum dst, GLenum src_a, GLenum dst_a)
+        {
+            if (has_blend_func && blend_func[0] == src && blend_func[1] == dst && blend_func[2] == src_a && blend_func[3] == dst_a)
+                return;
+            if (src == src_a && dst == dst_a)
+                glBlendFunc(src, dst);
+            else
+                glBlendFuncSeparate(src, dst, src_a, dst_a);
+            blend_func[0] = src;
+            blend_func[1] = dst;
+            blend_func[2] = src_a;
+            blend_func[3] = dst_a;
+            has_blend_func = true;
+        }
+
+        static void SetBlendEquation(GLenum eq, GLenum eq_a)
+        {
+            if (has_blend_equation && blend_equation[0] == eq && blend_equation[1] == eq_a)
+                return;
+            if (eq == eq_a)
+                glBlendEquation(eq);
+            else
+                glBlendEquationSeparate(eq, eq_a);
+            blend_equation[0] = eq;
+            blend_equation[1] = eq_a;
+            has_blend_equation = true;
+        }
+
+        static void SetScissorTest(bool enable)
+        {
+            SetCapability(scissor_test, GL_SCISSOR_TEST, enable);
+        }
+
+        // Uses the same convention as `glScissor`, so the Y axis points up.
+        static void SetScissorBox(ivec2 pos, ivec2 size)
+        {
+            if (has_scissor_box && pos == scissor_pos && size == scissor_size)
+                return;
+            glScissor(pos.x, pos.y, size.x, size.y);
+            scissor_pos = pos;
+            scissor_size = size;
+            has_scissor_box = true;
+        }
+
+        static void SetViewport(ivec2 pos, ivec2 size)
+        {
+            if (has_viewport && pos == viewport_pos && size == viewport_size)
+                return;
+            glViewport(pos.x, pos.y, size.x, size.y);
+            viewport_pos = pos;
+            viewport_size = size;
+            has_viewport = true;
+        }
+
+        // Forgets everything, so the next calls are not skipped. Also forgets the framebuffer binding.
+        static void Invalidate()
+        {
+            blending = -1;
+            scissor_test = -1;
+            has_blend_func = false;
+            has_blend_equation = false;
+            has_scissor_box = false;
+            has_viewport = false;
+            #ifdef IMP_HAVE_FRAMEBUFFERS
+            FrameBuffer::ForgetBinding();
+            #endif
+        }
+    };
+}
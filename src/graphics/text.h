@@ -1,7 +1,9 @@
 #pragma once
 
 #include <limits>
+#include <memory_resource>
 #include <string>
+#include <utility>
 #include <string_view>
 #include <vector>
 
@@ -11,8 +13,12 @@
 
 namespace Graphics
 {
+    // Uses `std::pmr` containers, to be able to allocate from a `FrameArena` or a similar resource. The default is the normal heap.
+    // Note that copying the text allocates the copy from the default resource, while moving keeps the resource.
     struct Text
     {
+        using allocator_type = std::pmr::polymorphic_allocator<>;
+
         struct Symbol
         {
             uint32_t ch = 0;
@@ -29,13 +35,29 @@ namespace Graphics
 
         struct Line
         {
-            std::vector<Symbol> symbols;
+            using allocator_type = std::pmr::polymorphic_allocator<>;
+
+            std::pmr::vector<Symbol> symbols;
             int default_ascent = 0;
             int default_descent = 0;
             int default_line_gap = 0;
+
+            // Those let the outer vector pass its memory resource to `symbols`.
+            Line() {}
+            explicit Line(const allocator_type &alloc) : symbols(alloc) {}
+            Line(const Line &other, const allocator_type &alloc)
+                : symbols(other.symbols, alloc), default_ascent(other.default_ascent), default_descent(other.default_descent), default_line_gap(other.default_line_gap)
+            {}
+            Line(Line &&other, const allocator_type &alloc)
+                : symbols(std::move(other.symbols), alloc), default_ascent(other.default_ascent), default_descent(other.default_descent), default_line_gap(other.default_line_gap)
+            {}
+            Line(const Line &) = default;
+            Line(Line &&) = default;
+            Line &operator=(const Line &) = default;
+            Line &operator=(Line &&) = default;
         };
 
-        std::vector<Line> lines = {{}}; // We start with one line by default.
+        std::pmr::vector<Line> lines = std::pmr::vector<Line>(1); // We start with one line by default.
 
 
         struct Stats
@@ -47,13 +69,15 @@ namespace Graphics
                 int descent = 0;
                 int line_gap = 0;
             };
-            std::vector<Line> lines;
+            std::pmr::vector<Line> lines;
 
             ivec2 size = ivec2(0);
         };
-        Stats ComputeStats() const
+        // By default, allocates from the same memory resource as the text itself.
+        Stats ComputeStats(std::pmr::memory_resource *memory = nullptr) const
         {
-            Stats ret;
+            Stats ret{.lines = std::pmr::vector<Stats::Line>(memory ? memory : lines.get_allocator().resource())};
+            ret.lines.reserve(lines.size());
 
             for (const Line &line : lines)
             {
@@ -94,11 +118,12 @@ namespace Graphics
 
 
         Text() {}
+        explicit Text(std::pmr::memory_resource *memory) : lines(1, memory) {}
         Text(const Font &font, const char *begin, const char *end = 0)
         {
             AddString(font, begin, end);
         }
-        Text(const Font &font, std::string_view str)
+        Text(const Font &font, std::string_view str, std::pmr::memory_resource *memory = std::pmr::get_default_resource()) : lines(1, memory)
         {
             AddString(font, str);
         }
@@ -155,7 +180,7 @@ namespace Graphics
         Text &AddString(const Font &font, const char *begin, const char *end = 0)
         {
             bool first = 1;
-            for (uint32_t ch : Unicode::Iterator(begin, end))
+            auto Add = [&](uint32_t ch)
             {
                 AddSymbol(font, ch);
 
@@ -163,6 +188,22 @@ namespace Graphics
                     first = 0;
                 else
                     KernLastTwoSymbols(font);
+            };
+
+            if (!end)
+            {
+                for (uint32_t ch : Unicode::Iterator(begin, end))
+                    Add(ch);
+                return *this;
+            }
+
+            // Decode in chunks, which is faster than one character at a time.
+            Unicode::Char buffer[256];
+            while (begin != end)
+            {
+                std::size_t count = Unicode::DecodeToUtf32(begin, end, buffer);
+                for (std::size_t i = 0; i < count; i++)
+                    Add(buffer[i]);
             }
 
             return *this;
@@ -355,6 +355,12 @@ namespace Graphics
         {
             return object.Handle();
         }
+
+        // The video memory, for `Refl::EstimateMemory()`. Assumes 4 bytes per texel, and no mipmaps.
+        [[nodiscard]] std::size_t EstimateOwnedMemory() const
+        {
+            return std::size_t(size.prod()) * 4;
+        }
         int Index() const
         {
             return unit.Index();
@@ -1,31 +1,142 @@
 #include "texture_atlas.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
 #include <memory>
+#include <set>
+#include <unordered_map>
 
 #include "reflection/full.h"
 #include "stream/readonly_data.h"
 #include "stream/save_to_file.h"
 #include "utils/packing.h"
+#include "utils/jobs.h"
 
 namespace Graphics
 {
+    namespace
+    {
+        // FNV-1a. We need a hash that is stable across runs, which `std::hash` doesn't guarantee.
+        [[nodiscard]] std::uint64_t HashBytes(const std::uint8_t *data, std::size_t size)
+        {
+            std::uint64_t ret = 0xcbf29ce484222325;
+            for (std::size_t i = 0; i < size; i++)
+            {
+                ret ^= data[i];
+                ret *= 0x100000001b3;
+            }
+            return ret;
+        }
+
+        [[nodiscard]] std::uint64_t HashImage(const Image &image)
+        {
+            return HashBytes(image.Data(), std::size_t(image.Size().prod()) * 4);
+        }
+
+        [[nodiscard]] bool SameImages(const Image &a, const Image &b)
+        {
+            return a.Size() == b.Size() && std::memcmp(a.Data(), b.Data(), std::size_t(a.Size().prod()) * 4) == 0;
+        }
+    }
+
+    void TextureAtlas::LoadDesc(Desc &target, const std::string &file_name)
+    {
+        if (file_name.ends_with(".refl"))
+            Refl::FromString(target, Stream::Input(Stream::ReadOnlyData::from_pack(file_name)));
+        else if (file_name.ends_with(".z"))
+            Refl::FromBinary(target, Stream::Input(Stream::ReadOnlyData::from_pack(file_name).uncompress()));
+        else
+            Refl::FromBinary(target, Stream::Input(Stream::ReadOnlyData::from_pack(file_name)));
+    }
+
+    void TextureAtlas::SaveDesc(const Desc &source, const std::string &file_name)
+    {
+        if (file_name.ends_with(".refl"))
+            Stream::SaveFile(file_name, Refl::ToString(source, Refl::ToStringOptions::Pretty()), Stream::text);
+        else if (file_name.ends_with(".z"))
+            Stream::SaveFileCompressed(file_name, Refl::ToBinary<std::vector<std::uint8_t>>(source));
+        else
+            Stream::SaveFile(file_name, Refl::ToBinary<std::vector<std::uint8_t>>(source));
+    }
+
+    Image TextureAtlas::LoadImage(const std::string &file_name)
+    {
+        if (file_name.ends_with(".z"))
+            return Image::FromRawCompressed(Stream::ReadOnlyData::from_pack(file_name));
+        else
+            return Image(Stream::ReadOnlyData::from_pack(file_name));
+    }
+
+    void TextureAtlas::SaveImage(Image &source, const std::string &file_name)
+    {
+        source.Save(file_name, file_name.ends_with(".z") ? Image::raw_compressed : Image::png);
+    }
+
+    int TextureAtlas::ShareCount(const ImageDesc &image_desc) const
+    {
+        return int(std::count_if(desc.images.begin(), desc.images.end(), [&](const auto &elem){return elem.second.pos == image_desc.pos && elem.second.size == image_desc.size;}));
+    }
+
+    void TextureAtlas::ResolveHandles()
+    {
+        regions_by_symbol.clear();
+        regions_by_symbol.reserve(desc.images.size());
+        for (const auto &[name, image_desc] : desc.images)
+        {
+            Region &region = regions_by_symbol[Symbol(name)];
+            region.pos = image_desc.pos;
+            region.size = image_desc.size;
+        }
+
+        const auto &names = impl::TextureAtlas::GetHandleNames();
+        resolved_handles.clear();
+        resolved_handles.resize(names.size());
+        for (std::size_t i = 0; i < names.size(); i++)
+            resolved_handles[i].found = GetOpt(names[i], resolved_handles[i].region);
+    }
+
+    void TextureAtlas::SaveFiles(const SourceCache &cache)
+    {
+        // Save source hashes.
+        try
+        {
+            Stream::SaveFile(out_desc_file + ".hashes", Refl::ToString(cache, Refl::ToStringOptions::Pretty()), Stream::text);
+        }
+        catch (...) {}
+
+        // Save final image.
+        try
+        {
+            SaveImage(image, out_image_file);
+        }
+        catch (...) {}
+
+        // Save description.
+        try
+        {
+            SaveDesc(desc, out_desc_file);
+        }
+        catch (...) {}
+    }
+
     TextureAtlas::TextureAtlas(ivec2 target_size, const std::string &source_dir, const std::string &out_image_file, const std::string &out_desc_file, const std::map<std::string, ivec2> &artifical_regions, bool add_gaps)
-        : source_dir(source_dir)
+        : source_dir(source_dir), out_image_file(out_image_file), out_desc_file(out_desc_file), gaps(add_gaps)
     {
         constexpr int max_nesting_level = 32;
 
         // Decide if regenrating the atlas should be allowed.
         bool allow_regeneration = !source_dir.empty();
 
-        Filesystem::TreeNode source_tree;
+        std::time_t source_time_modified = 0;
 
-        // If regeneration is allowed, try getting the source directory tree and its modification time.
+        // If regeneration is allowed, get the modification time of the source directory. The tree itself is only needed if we regenerate.
         if (allow_regeneration)
         {
-            // `GetObjectTree` will throw if the source directory doesn't exist.
-            source_tree = Filesystem::GetObjectTree(source_dir, max_nesting_level);
-            if (source_tree.info.category != Filesystem::directory)
+            // `GetObjectInfo` will throw if the source directory doesn't exist.
+            if (Filesystem::GetObjectInfo(source_dir).category != Filesystem::directory)
                 Program::Error("Texture atlas source location `", source_dir, "` is not a directory.");
+            source_time_modified = Filesystem::GetTimeModifiedRecursive(source_dir, max_nesting_level);
         }
 
         std::time_t image_time_modified = 0;
@@ -56,13 +167,13 @@ namespace Graphics
 
 
         // Decide if we should load the atlas or regenerate it.
-        if (!allow_regeneration || source_tree.time_modified_recursive < min(image_time_modified, desc_time_modified))
+        if (!allow_regeneration || source_time_modified < min(image_time_modified, desc_time_modified))
         {
             // Try loading the existing atlas because either regeneration is disabled, or atlas image and description are new enough.
             try
             {
                 // Load and parse description.
-                Refl::FromString(desc, Stream::Input(out_desc_file));
+                LoadDesc(desc, out_desc_file);
 
                 // Make sure that all requested artifical regions are present in the atlas. If not, attempt to regenerate it.
                 for (const auto &[name, size] : artifical_regions)
@@ -73,8 +184,9 @@ namespace Graphics
                 }
 
                 // Load image.
-                image = Image(out_image_file);
+                image = LoadImage(out_image_file);
 
+                ResolveHandles();
                 return; // The atlas was loaded successfully.
             }
             catch (...)
@@ -89,23 +201,37 @@ namespace Graphics
 
         // Begin regenerating atlas.
 
-        // Count images.
-        int image_count = artifical_regions.size();
-        Filesystem::ForEachObject(source_tree, [&](const Filesystem::TreeNode &node)
+        // Try loading the previous atlas and the source hashes, to reuse the images that didn't change.
+        // Any failure here simply disables the reuse.
+        Desc old_desc;
+        Image old_image;
+        SourceCache old_cache;
+        std::string cache_file = out_desc_file + ".hashes";
+        try
         {
-            if (node.info.category != Filesystem::file)
-                return;
-            image_count++;
-        });
+            LoadDesc(old_desc, out_desc_file);
+            Refl::FromString(old_cache, Stream::Input(cache_file));
+            old_image = LoadImage(out_image_file);
+            if (old_image.Size() != target_size)
+                old_image = {};
+        }
+        catch (...)
+        {
+            old_image = {};
+        }
 
         // Load images.
         struct Elem
         {
             std::string name;
+            std::string path; // Empty for artifical regions.
+            std::uint64_t hash = 0;
+            std::uint64_t pixel_hash = 0; // Of the decoded pixels, to find the duplicates.
+            bool changed = true; // False if this image can be copied from the old atlas.
             Image image;
         };
         std::vector<Elem> elem_list;
-        elem_list.reserve(image_count);
+        elem_list.reserve(artifical_regions.size());
 
         for (const auto &[name, size] : artifical_regions)
         {
@@ -114,6 +240,7 @@ namespace Graphics
             new_elem.image = Image(size);
         }
 
+        Filesystem::TreeNode source_tree = Filesystem::GetObjectTree(source_dir, max_nesting_level);
         Filesystem::ForEachObject(source_tree, [&](const Filesystem::TreeNode &node)
         {
             if (node.info.category != Filesystem::file)
@@ -123,53 +250,281 @@ namespace Graphics
 
             // Save image name, but first strip source directory name from it.
             new_elem.name = node.path.substr(source_dir.size() + 1); // `+ 1` is for `/`.
-
-            // Load image.
-            new_elem.image = Image(node.path);
+            new_elem.path = node.path;
         });
 
+        // Hash the files, and decode the ones that changed. This is done in parallel, since decoding dominates the regeneration time.
+        Jobs::DefaultPool().ParallelFor(elem_list.size(), [&](std::size_t i)
+        {
+            Elem &elem = elem_list[i];
+            if (elem.path.empty())
+                return;
+
+            Stream::ReadOnlyData file = Stream::ReadOnlyData::map_file(elem.path);
+            elem.hash = HashBytes(file.data(), file.size());
+
+            if (old_image)
+            {
+                auto cache_it = old_cache.hashes.find(elem.name);
+                auto desc_it = old_desc.images.find(elem.name);
+                if (cache_it != old_cache.hashes.end() && cache_it->second == elem.hash && desc_it != old_desc.images.end() && old_image.RectInBounds(desc_it->second.pos, desc_it->second.size))
+                {
+                    elem.image = old_image.UnsafeSubImage(desc_it->second.pos, desc_it->second.size);
+                    elem.changed = false;
+                }
+            }
+
+            if (elem.changed)
+                elem.image = Image(file);
+            elem.pixel_hash = HashImage(elem.image);
+        }, 1);
+
         // Sort images by name. Otherwise the order sometimes turns out different on different platforms.
         std::sort(elem_list.begin(), elem_list.end(), [](const Elem &a, const Elem &b){return a.name < b.name;});
 
+        // The images with identical pixels share a rectangle, which is owned by the first one of them.
+        // Artifical regions are never shared, since they're filled at runtime.
+        std::vector<std::size_t> rect_index(elem_list.size()); // Indices in `rect_list`.
+        std::vector<std::size_t> rect_owners; // Indices in `elem_list`, one per rectangle.
+        {
+            std::unordered_map<std::uint64_t, std::vector<std::size_t>> owners_by_hash;
+            for (std::size_t i = 0; i < elem_list.size(); i++)
+            {
+                const Elem &elem = elem_list[i];
+                if (!elem.path.empty())
+                {
+                    std::vector<std::size_t> &candidates = owners_by_hash[elem.pixel_hash];
+                    auto it = std::find_if(candidates.begin(), candidates.end(), [&](std::size_t j){return SameImages(elem_list[rect_owners[j]].image, elem.image);});
+                    if (it != candidates.end())
+                    {
+                        rect_index[i] = *it;
+                        continue;
+                    }
+                    candidates.push_back(rect_owners.size());
+                }
+                rect_index[i] = rect_owners.size();
+                rect_owners.push_back(i);
+            }
+        }
+
         // Construct rectangle list for packing.
         std::vector<Packing::Rect> rect_list;
-        rect_list.reserve(image_count);
-        for (const Elem &elem : elem_list)
-            rect_list.push_back(elem.image.Size());
+        rect_list.reserve(rect_owners.size());
+        for (std::size_t i : rect_owners)
+            rect_list.push_back(elem_list[i].image.Size());
+
+        // If the set of images, their sizes, and the sharing of rectangles didn't change, reuse the old layout. Otherwise pack the rectangles again.
+        bool reuse_layout = bool(old_image) && old_desc.images.size() == elem_list.size();
+        if (reuse_layout)
+        {
+            std::vector<bool> rect_pos_known(rect_list.size());
+            std::set<std::pair<int, int>> used_positions;
+            for (std::size_t i = 0; i < elem_list.size(); i++)
+            {
+                auto it = old_desc.images.find(elem_list[i].name);
+                if (it == old_desc.images.end() || it->second.size != elem_list[i].image.Size())
+                {
+                    reuse_layout = false;
+                    break;
+                }
 
-        // Try packing rectangles.
-        if (Packing::PackRects(target_size, rect_list.data(), rect_list.size(), add_gaps))
+                std::size_t r = rect_index[i];
+                if (rect_pos_known[r])
+                {
+                    // A duplicate must have shared the rectangle of its owner.
+                    if (rect_list[r].pos != it->second.pos)
+                    {
+                        reuse_layout = false;
+                        break;
+                    }
+                }
+                else
+                {
+                    // A unique image must not have shared a rectangle with anything else.
+                    if (!used_positions.insert({it->second.pos.x, it->second.pos.y}).second)
+                    {
+                        reuse_layout = false;
+                        break;
+                    }
+                    rect_list[r].pos = it->second.pos;
+                    rect_pos_known[r] = true;
+                }
+            }
+        }
+        if (!reuse_layout && Packing::PackRects(target_size, rect_list.data(), rect_list.size(), add_gaps))
             Program::Error("Unable to fit texture atlas for `", source_dir, "` into a ", target_size.x, 'x', target_size.y, " texture.");
 
         // Construct description and final image.
-        image = Image(target_size, u8vec4(0));
+        // When reusing the layout, the unchanged images are already in place.
+        image = reuse_layout ? std::move(old_image) : Image(target_size, u8vec4(0));
         desc = {}; // In case we started populating it and failed.
+        SourceCache cache;
         for (size_t i = 0; i < elem_list.size(); i++)
         {
             // Add image to description.
             ImageDesc image_desc;
-            image_desc.pos = rect_list[i].pos;
+            image_desc.pos = rect_list[rect_index[i]].pos;
             image_desc.size = elem_list[i].image.Size(); // Note that we don't extract sizes from rectangles, since those sizes might include gap size.
+            if (!elem_list[i].path.empty())
+                cache.hashes.try_emplace(elem_list[i].name, elem_list[i].hash);
             if (!desc.images.insert({std::move(elem_list[i].name), image_desc}).second)
                 Program::Error("Internal error while generating description for texture atlas for `", source_dir, "`: Duplicate image paths.");
 
-            // Copy this image to target image.
-            image.UnsafeDrawImage(elem_list[i].image, image_desc.pos);
+            // Copy this image to target image, once per rectangle.
+            if (rect_owners[rect_index[i]] == i && (!reuse_layout || elem_list[i].changed))
+                image.UnsafeDrawImage(elem_list[i].image, image_desc.pos);
         }
 
-        // Save final image.
-        try
+        SaveFiles(cache);
+        ResolveHandles();
+    }
+
+    bool TextureAtlas::Update(const std::vector<std::string> &changed_files)
+    {
+        if (source_dir.empty())
+            Program::Error("Can't update a texture atlas without a source directory.");
+
+        struct Elem
+        {
+            std::string name;
+            bool deleted = false;
+            std::uint64_t hash = 0;
+            Image image;
+            ivec2 pos; // The new position.
+        };
+        std::vector<Elem> elem_list;
+
+        for (const std::string &name : changed_files)
         {
-            image.Save(out_image_file);
+            bool info_ok;
+            auto info = Filesystem::GetObjectInfo(source_dir + '/' + name, &info_ok);
+            if (info_ok && info.category != Filesystem::file)
+                continue;
+            if (!info_ok && !desc.images.contains(name))
+                continue; // A temporary file that was already deleted, or something like that.
+
+            auto &new_elem = elem_list.emplace_back();
+            new_elem.name = name;
+            new_elem.deleted = !info_ok;
         }
-        catch (...) {}
+        if (elem_list.empty())
+            return true;
 
-        // Save description.
+        // Load the images, same as in the constructor.
+        Jobs::DefaultPool().ParallelFor(elem_list.size(), [&](std::size_t i)
+        {
+            Elem &elem = elem_list[i];
+            if (elem.deleted)
+                return;
+
+            Stream::ReadOnlyData file = Stream::ReadOnlyData::map_file(source_dir + '/' + elem.name);
+            elem.hash = HashBytes(file.data(), file.size());
+            elem.image = Image(file);
+        }, 1);
+
+        // Restore the packer state from the current layout.
+        if (!packer)
+        {
+            Packing::MaxRectsPacker new_packer(image.Size(), gaps);
+            std::set<std::pair<int, int>> shared_positions;
+            for (const auto &[name, image_desc] : desc.images)
+            {
+                if (ShareCount(image_desc) > 1 && !shared_positions.insert({image_desc.pos.x, image_desc.pos.y}).second)
+                    continue; // A duplicate image, its rectangle is already added.
+                if (!new_packer.InsertAt(image_desc.pos, image_desc.size))
+                    Program::Error("Internal error while updating texture atlas for `", source_dir, "`: Image `", name, "` overlaps other images.");
+            }
+            packer = std::move(new_packer);
+        }
+
+        // A rectangle shared by several duplicate images is only freed when all of them change, see `FreesOldRect()`.
+        // The changed images are never deduplicated here, that waits until the next regeneration.
+        auto FreesOldRect = [&](const ImageDesc &old_desc)
+        {
+            int changed_users = 0;
+            for (const Elem &elem : elem_list)
+            {
+                auto it = desc.images.find(elem.name);
+                if (it != desc.images.end() && it->second.pos == old_desc.pos)
+                    changed_users++;
+            }
+            return changed_users == ShareCount(old_desc);
+        };
+        std::set<std::pair<int, int>> freed_positions;
+
+        // Lay out the changes on a copy of the packer, so it's unchanged on failure.
+        Packing::MaxRectsPacker new_packer = *packer;
+        std::vector<Elem *> moved_elems;
+        for (Elem &elem : elem_list)
+        {
+            auto it = desc.images.find(elem.name);
+            if (it != desc.images.end())
+            {
+                if (!elem.deleted && it->second.size == elem.image.Size() && ShareCount(it->second) == 1)
+                {
+                    elem.pos = it->second.pos;
+                    continue;
+                }
+                if (FreesOldRect(it->second) && freed_positions.insert({it->second.pos.x, it->second.pos.y}).second)
+                    new_packer.Remove(it->second.pos, it->second.size);
+            }
+            if (!elem.deleted)
+                moved_elems.push_back(&elem);
+        }
+
+        // The larger images are harder to fit, so they go first.
+        std::sort(moved_elems.begin(), moved_elems.end(), [](const Elem *a, const Elem *b){return a->image.Size().prod() > b->image.Size().prod();});
+        for (Elem *elem : moved_elems)
+        {
+            std::optional<ivec2> pos = new_packer.Insert(elem->image.Size());
+            if (!pos)
+                return false;
+            elem->pos = *pos;
+        }
+
+        packer = std::move(new_packer);
+
+        // Clear all old regions first, since the new images can go to the space freed by the other ones.
+        // The rectangles that are still used by some unchanged duplicates are kept.
+        for (const Elem &elem : elem_list)
+        {
+            auto it = desc.images.find(elem.name);
+            if (it == desc.images.end())
+                continue;
+            if (freed_positions.contains({it->second.pos.x, it->second.pos.y}) || ShareCount(it->second) == 1)
+                image.UnsafeFill(it->second.pos, it->second.size, u8vec4(0));
+            desc.images.erase(it);
+        }
+
+        // Try loading the source hashes, to keep them in sync with the image. If they're missing, the next regeneration decodes everything.
+        SourceCache cache;
         try
         {
-            std::string desc_string = Refl::ToString(desc, Refl::ToStringOptions::Pretty());
-            Stream::SaveFile(out_desc_file, desc_string, Stream::text);
+            Refl::FromString(cache, Stream::Input(out_desc_file + ".hashes"));
         }
-        catch (...) {}
+        catch (...)
+        {
+            cache = {};
+        }
+
+        for (Elem &elem : elem_list)
+        {
+            if (elem.deleted)
+            {
+                cache.hashes.erase(elem.name);
+                continue;
+            }
+
+            ImageDesc image_desc;
+            image_desc.pos = elem.pos;
+            image_desc.size = elem.image.Size();
+            image.UnsafeDrawImage(elem.image, elem.pos);
+            cache.hashes[elem.name] = elem.hash;
+            desc.images.insert_or_assign(std::move(elem.name), image_desc);
+        }
+
+        SaveFiles(cache);
+        ResolveHandles();
+        return true;
     }
 }
@@ -2,20 +2,42 @@
 
 #include <ctime>
 #include <map>
+#include <optional>
 #include <string>
 #include <type_traits>
 #include <utility>
 #include <vector>
 
 #include "graphics/image.h"
+#include "meta/string_template_params.h"
 #include "program/errors.h"
 #include "reflection/structs.h"
 #include "strings/format.h"
 #include "utils/filesystem.h"
+#include "utils/flat_hash.h"
 #include "utils/mat.h"
+#include "utils/packing.h"
+#include "utils/symbol.h"
 
 namespace Graphics
 {
+    namespace impl::TextureAtlas
+    {
+        // The names of all known `TextureAtlas::Handle`s, indexed by `Handle::index`.
+        inline std::vector<Symbol> &GetHandleNames()
+        {
+            static std::vector<Symbol> ret;
+            return ret;
+        }
+
+        [[nodiscard]] inline std::size_t RegisterHandleName(Symbol name)
+        {
+            auto &names = GetHandleNames();
+            names.push_back(name);
+            return names.size() - 1;
+        }
+    }
+
     class TextureAtlas
     {
         REFL_SIMPLE_STRUCT_WITHOUT_NAMES( ImageDesc
@@ -26,9 +48,35 @@ namespace Graphics
             REFL_DECL(std::map<std::string, ImageDesc>) images
         )
 
+        // Saved next to the description when regenerating. Lets us skip decoding the images that didn't change since the last time.
+        REFL_SIMPLE_STRUCT( SourceCache
+            REFL_DECL(std::map<std::string, std::uint64_t>) hashes // Content hashes of the source files.
+        )
+
         Image image;
         Desc desc;
         std::string source_dir;
+        std::string out_image_file, out_desc_file;
+        int gaps = 0;
+
+        // The packer state matching `desc`, for `Update()`. Built when it's first needed.
+        std::optional<Packing::MaxRectsPacker> packer;
+
+        // The format of the description file is selected by its extension. See the constructor.
+        static void LoadDesc(Desc &target, const std::string &file_name);
+        static void SaveDesc(const Desc &source, const std::string &file_name);
+        // Same for the image.
+        [[nodiscard]] static Image LoadImage(const std::string &file_name);
+        static void SaveImage(Image &source, const std::string &file_name);
+
+        // How many images in `desc` use this rectangle. More than one if they were deduplicated.
+        [[nodiscard]] int ShareCount(const ImageDesc &image_desc) const;
+
+        // Interns the names in `desc`, and looks up the names of all known handles in it.
+        void ResolveHandles();
+
+        // Saves the image, the description, and the source hashes, ignoring any errors.
+        void SaveFiles(const SourceCache &cache);
 
       public:
         struct Region
@@ -75,10 +123,35 @@ namespace Graphics
             }
         };
 
+      private:
+        struct ResolvedHandle
+        {
+            Region region;
+            bool found = false;
+        };
+        // Indexed by `Handle::index`. Filled when the atlas is constructed, see `ResolveHandles()`.
+        std::vector<ResolvedHandle> resolved_handles;
+        // Same as `desc.images`, but keyed on the interned names. Also rebuilt by `ResolveHandles()`.
+        FlatMap<Symbol, Region> regions_by_symbol;
+
+      public:
+        // Refers to an image by a name known at compile-time. Doing `Get<"foo.png">()` skips the map lookup.
+        // Each distinct name gets an index during the static initialization. When an atlas is constructed, it looks up all those names once, and stores the results in a flat array.
+        template <Meta::ConstString Name>
+        struct Handle
+        {
+            inline static const std::size_t index = impl::TextureAtlas::RegisterHandleName(Symbol::Of<Name>());
+        };
+
         TextureAtlas() {}
 
         // Pass empty string as `source_dir` to disallow regeneration.
         // `artifical_regions` are empty "images" that are added to the atlas.
+        // The images with identical pixels are stored once, and their names point to the same region.
+        // The description is stored as reflected text if `out_desc_file` ends with `.refl`, as compressed binary if it ends with `.z`, and as plain binary otherwise.
+        // The binary formats are faster to load, the text format is easier to diff.
+        // Similarly, the image is stored as raw compressed RGBA (see `Image::FromRawCompressed()`) if `out_image_file` ends with `.z`, which avoids decoding a PNG.
+        // It's stored as a PNG otherwise.
         TextureAtlas(ivec2 target_size, const std::string &source_dir, const std::string &out_image_file, const std::string &out_desc_file, const std::map<std::string, ivec2> &artifical_regions = {}, bool add_gaps = true);
 
         [[nodiscard]] const std::string &SourceDirectory() const
@@ -86,6 +159,13 @@ namespace Graphics
             return source_dir;
         }
 
+        // Applies the changes of the source files, e.g. from `Filesystem::ChangeWatcher`. The names are relative to the source directory.
+        // The images that keep their size are redrawn in place. The rest are repacked into the free space, without moving the other images.
+        // Returns false if they don't fit, then the atlas is unchanged, and has to be regenerated by constructing it again.
+        // Throws if regeneration is disallowed, or if some image can't be loaded, also leaving the atlas unchanged.
+        // The image object stays the same, so the artifical regions keep their contents. Then saves the atlas like the constructor does.
+        bool Update(const std::vector<std::string> &changed_files);
+
         [[nodiscard]] Image &GetImage()
         {
             return image;
@@ -113,6 +193,35 @@ namespace Graphics
                 Program::Error("No image `", name, "` in texture atlas for `", source_dir, "`.");
             return ret;
         }
+
+        // Same, but doesn't hash or compare the string. Use this for the names that are known in advance, but not at compile-time.
+        [[nodiscard]] bool GetOpt(Symbol name, Region &target) const
+        {
+            auto it = regions_by_symbol.find(name);
+            if (it == regions_by_symbol.end())
+                return false;
+            target = it->second;
+            return true;
+        }
+        [[nodiscard]] Region Get(Symbol name) const
+        {
+            Region ret;
+            if (!GetOpt(name, ret))
+                Program::Error("No image `", name.View(), "` in texture atlas for `", source_dir, "`.");
+            return ret;
+        }
+        // Throws if no such image.
+        template <Meta::ConstString Name>
+        [[nodiscard]] const Region &Get(Handle<Name> = {}) const
+        {
+            std::size_t index = Handle<Name>::index;
+            ASSERT(index < resolved_handles.size(), "Texture atlas handle was registered after the atlas was loaded. This shouldn't be possible.");
+            const ResolvedHandle &handle = resolved_handles[index];
+            if (!handle.found)
+                Program::Error("No image `", Name.view(), "` in texture atlas for `", source_dir, "`.");
+            return handle.region;
+        }
+
         [[nodiscard]] RegionList GetList(const std::string &prefix, int first_index, const std::string &suffix, int count = -1) const
         {
             RegionList ret;
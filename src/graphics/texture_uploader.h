@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <cglfl/cglfl.hpp>
+
+#include "graphics/image.h"
+#include "graphics/texture.h"
+#include "macros/finally.h"
+#include "program/errors.h"
+#include "utils/mat.h"
+
+namespace Graphics
+{
+    // Uploads parts of textures through a ring of pixel buffer objects, so `glTexSubImage2D()` copies from GPU-side memory
+    // and doesn't have to block until the driver is done with the client pointer.
+    // Each upload goes to the next buffer in the ring, and the buffer is invalidated before writing, so we never wait for the previous uploads from it.
+    // The uploads larger than the buffer (or the ones that fail to map) fall back to the plain `SetDataPart()`.
+    // Only RGBA8 textures for now, same as the `Image`.
+    class TextureUploader
+    {
+        struct Data
+        {
+            std::vector<GLuint> buffers;
+            std::size_t capacity = 0; // In bytes, for each buffer.
+            std::size_t buffer_index = 0;
+        };
+        Data data;
+
+        // Binds the next buffer and maps it for writing. Returns null on failure, then the buffer remains bound.
+        [[nodiscard]] unsigned char *MapNextBuffer(std::size_t bytes)
+        {
+            data.buffer_index = (data.buffer_index + 1) % data.buffers.size();
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, data.buffers[data.buffer_index]);
+            return static_cast<unsigned char *>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        }
+
+        // Calls `write(unsigned char *dst)` to fill `size.x * size.y` pixels, then uploads them to the texture. Returns false if the buffers can't be used.
+        template <typename F>
+        bool UploadFromBuffer(Texture &texture, ivec2 pos, ivec2 size, F &&write)
+        {
+            std::size_t bytes = std::size_t(size.prod()) * sizeof(u8vec4);
+            if (bytes > data.capacity)
+                return false;
+
+            FINALLY( glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); ) // Otherwise the other uploads would read from the buffer.
+
+            unsigned char *ptr = MapNextBuffer(bytes);
+            if (!ptr)
+                return false;
+            write(ptr);
+            if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+                return false; // The contents got corrupted, this can happen e.g. on a display mode change.
+
+            // With a bound unpack buffer, the pointer is an offset into it.
+            texture.SetDataPart(pos, size, nullptr);
+            return true;
+        }
+
+      public:
+        TextureUploader() {}
+
+        // `capacity` is the max size of one upload in bytes. `num_buffers` should be at least the number of uploads per frame, times the frames in flight.
+        TextureUploader(std::size_t capacity, int num_buffers = 3)
+        {
+            ASSERT(num_buffers >= 1, "Invalid number of buffers.");
+            data.capacity = capacity;
+            data.buffers.resize(num_buffers);
+
+            glGenBuffers(num_buffers, data.buffers.data());
+            FINALLY_ON_THROW( glDeleteBuffers(num_buffers, data.buffers.data()); )
+            for (GLuint handle : data.buffers)
+            {
+                if (!handle)
+                    Program::Error("Unable to create a pixel buffer.");
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, handle);
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+        TextureUploader(TextureUploader &&other) noexcept : data(std::exchange(other.data, {})) {}
+        TextureUploader &operator=(TextureUploader other) noexcept
+        {
+            std::swap(data, other.data);
+            return *this;
+        }
+
+        ~TextureUploader()
+        {
+            if (!data.buffers.empty())
+                glDeleteBuffers(data.buffers.size(), data.buffers.data()); // Deleting 0 is a no-op, but GL could be unloaded at this point.
+        }
+
+        explicit operator bool() const
+        {
+            return !data.buffers.empty();
+        }
+
+        // The max size of one upload in bytes.
+        [[nodiscard]] std::size_t Capacity() const
+        {
+            return data.capacity;
+        }
+
+        // Uploads `size.x * size.y` RGBA8 pixels to the texture at `pos`. Same as `texture.SetDataPart(pos, size, pixels)`, but asynchronous.
+        void SetDataPart(Texture &texture, ivec2 pos, ivec2 size, const uint8_t *pixels)
+        {
+            ASSERT(*this, "Attempt to use a null texture uploader.");
+            if (*this && UploadFromBuffer(texture, pos, size, [&](unsigned char *dst){std::memcpy(dst, pixels, std::size_t(size.prod()) * sizeof(u8vec4));}))
+                return;
+            texture.SetDataPart(pos, size, pixels);
+        }
+
+        // Uploads a rectangle of the image to the same place in the texture. Unlike the plain `SetDataPart()`, doesn't need a temporary copy of the rectangle.
+        void SetDataPart(Texture &texture, const Image &image, ivec2 rect_pos, ivec2 rect_size)
+        {
+            ASSERT(image, "Attempt to use a null image.");
+            ASSERT(*this, "Attempt to use a null texture uploader.");
+            if (*this && UploadFromBuffer(texture, rect_pos, rect_size, [&](unsigned char *dst)
+            {
+                for (int y = 0; y < rect_size.y; y++)
+                    std::memcpy(dst + std::size_t(y) * rect_size.x * sizeof(u8vec4), &image.UnsafeAt(rect_pos + ivec2(0,y)), rect_size.x * sizeof(u8vec4));
+            }))
+            {
+                return;
+            }
+
+            Image part = image.UnsafeSubImage(rect_pos, rect_size);
+            texture.SetDataPart(rect_pos, rect_size, part.Data());
+        }
+    };
+}
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include <cglfl/cglfl.hpp>
+
+#include "graphics/shader.h"
+#include "graphics/types.h"
+#include "macros/finally.h"
+#include "meta/common.h"
+#include "program/errors.h"
+#include "reflection/structs.h"
+#include "utils/mat.h"
+
+namespace Graphics
+{
+    // The std140 layout of the uniform block members.
+    namespace Std140
+    {
+        template <typename T>
+        concept Scalar = std::is_same_v<T, float> || std::is_same_v<T, int> || std::is_same_v<T, unsigned int> || std::is_same_v<T, bool>;
+
+        // Has `align`, `size`, and `Write(unsigned char *dst, const T &value)`.
+        template <typename T>
+        struct Member
+        {
+            static_assert(Meta::value<false, T>, "Uniform block members of this type are not supported.");
+        };
+
+        template <Scalar T>
+        struct Member<T>
+        {
+            static constexpr std::size_t align = 4, size = 4;
+
+            static void Write(unsigned char *dst, const T &value)
+            {
+                // The bools are 4-byte integers.
+                std::conditional_t<std::is_same_v<T, bool>, std::uint32_t, T> converted = value;
+                std::memcpy(dst, &converted, 4);
+            }
+        };
+
+        template <Math::vector T> requires Scalar<typename T::type>
+        struct Member<T>
+        {
+            static constexpr std::size_t align = T::size == 2 ? 8 : 16, size = T::size * 4;
+
+            static void Write(unsigned char *dst, const T &value)
+            {
+                for (int i = 0; i < T::size; i++)
+                    Member<typename T::type>::Write(dst + i * 4, value[i]);
+            }
+        };
+
+        // Stored as an array of columns.
+        template <Math::matrix T> requires std::is_same_v<typename T::type, float>
+        struct Member<T>
+        {
+            static constexpr std::size_t align = 16, size = T::width * 16;
+
+            static void Write(unsigned char *dst, const T &value)
+            {
+                for (int i = 0; i < T::width; i++)
+                    Member<std::remove_cvref_t<decltype(value[i])>>::Write(dst + i * 16, value[i]);
+            }
+        };
+
+        // Each element is aligned to 16 bytes.
+        template <typename T, std::size_t N>
+        struct Member<T[N]>
+        {
+            static constexpr std::size_t stride = (Member<T>::size + 15) / 16 * 16;
+            static constexpr std::size_t align = 16, size = stride * N;
+
+            static void Write(unsigned char *dst, const T (&value)[N])
+            {
+                for (std::size_t i = 0; i < N; i++)
+                    Member<T>::Write(dst + i * stride, value[i]);
+            }
+        };
+
+        // The member offsets and the total size of a reflected struct.
+        template <typename T>
+        struct StructLayout
+        {
+            std::array<std::size_t, Refl::Class::member_count<T>> offsets{};
+            std::size_t size = 0;
+        };
+
+        template <typename T>
+        [[nodiscard]] constexpr StructLayout<T> ComputeLayout()
+        {
+            StructLayout<T> ret;
+            Meta::cexpr_for<Refl::Class::member_count<T>>([&](auto index)
+            {
+                constexpr auto i = index.value;
+                using member = Member<Refl::Class::member_type<T, i>>;
+                ret.size = (ret.size + member::align - 1) / member::align * member::align;
+                ret.offsets[i] = ret.size;
+                ret.size += member::size;
+            });
+            ret.size = (ret.size + 15) / 16 * 16;
+            return ret;
+        }
+    }
+
+    // Tracks which buffers are bound to the uniform block binding points.
+    class UniformBlocks
+    {
+        UniformBlocks() = delete;
+        ~UniformBlocks() = delete;
+
+      public:
+        // GL guarantees at least 36 points in 3.2, we don't need more than this.
+        static constexpr int max_binding_points = 16;
+
+      private:
+        inline static GLuint bindings[max_binding_points] = {};
+
+      public:
+        static void Bind(int binding_point, GLuint handle)
+        {
+            ASSERT(binding_point >= 0 && binding_point < max_binding_points, "Uniform block binding point is out of range.");
+            if (bindings[binding_point] == handle)
+                return;
+            glBindBufferBase(GL_UNIFORM_BUFFER, binding_point, handle);
+            bindings[binding_point] = handle;
+        }
+
+        // Call this before deleting a buffer. GL unbinds it automatically.
+        static void ForgetBuffer(GLuint handle)
+        {
+            for (GLuint &binding : bindings)
+            {
+                if (binding == handle)
+                    binding = 0;
+            }
+        }
+    };
+
+    // A uniform buffer for a reflected struct `T`, in the std140 layout. One block can be shared by any number of shaders,
+    // then the data is uploaded once for all of them.
+    // The supported members are `float`, `int`, `unsigned int` and `bool` scalars and vectors, float matrices, and arrays of those.
+    // Usage:
+    //     REFL_SIMPLE_STRUCT( Globals
+    //         REFL_DECL(fmat4) matrix
+    //         REFL_DECL(float) time
+    //     )
+    //     Graphics::UniformBlock<Globals> block(0); // The binding point.
+    //     // Prepend `block.Declaration("Globals")` to the shader sources, then they see `u_matrix` and `u_time`.
+    //     block.Attach(shader, "Globals");
+    //     block.Set(globals); // Then `Bind()` before drawing, if the same binding point is used for other blocks.
+    // Needs GLSL 1.40 or newer.
+    template <typename T>
+    class UniformBlock
+    {
+        static_assert(Refl::Class::member_names_known<T>, "The type must be reflected.");
+
+        static constexpr Std140::StructLayout<T> layout = Std140::ComputeLayout<T>();
+
+        struct Data
+        {
+            GLuint handle = 0;
+            int binding_point = 0;
+            bool has_value = false;
+            std::array<unsigned char, layout.size> bytes{}; // The last uploaded value.
+        };
+        Data data;
+
+      public:
+        UniformBlock() {}
+
+        explicit UniformBlock(int binding_point)
+        {
+            data.binding_point = binding_point;
+
+            glGenBuffers(1, &data.handle);
+            if (!data.handle)
+                Program::Error("Unable to create a uniform buffer.");
+            FINALLY_ON_THROW( glDeleteBuffers(1, &data.handle); )
+
+            glBindBuffer(GL_UNIFORM_BUFFER, data.handle);
+            glBufferData(GL_UNIFORM_BUFFER, layout.size, nullptr, GL_DYNAMIC_DRAW);
+            Bind();
+        }
+
+        UniformBlock(UniformBlock &&other) noexcept : data(std::exchange(other.data, {})) {}
+        UniformBlock &operator=(UniformBlock other) noexcept
+        {
+            std::swap(data, other.data);
+            return *this;
+        }
+
+        ~UniformBlock()
+        {
+            if (data.handle)
+            {
+                UniformBlocks::ForgetBuffer(data.handle);
+                glDeleteBuffers(1, &data.handle); // Deleting 0 is a no-op, but GL could be unloaded at this point.
+            }
+        }
+
+        explicit operator bool() const
+        {
+            return bool(data.handle);
+        }
+
+        [[nodiscard]] int BindingPoint() const
+        {
+            return data.binding_point;
+        }
+
+        // The size of the buffer in bytes.
+        [[nodiscard]] static constexpr std::size_t Size()
+        {
+            return layout.size;
+        }
+
+        // Returns the GLSL declaration of the block. The members get `pref.uniform_prefix`, and are accessed without the block name.
+        [[nodiscard]] static std::string Declaration(std::string_view block_name, const ShaderPreferences &pref = {})
+        {
+            std::string ret = "layout(std140) uniform ";
+            ret += block_name;
+            ret += "\n{\n";
+            Meta::cexpr_for<Refl::Class::member_count<T>>([&](auto index)
+            {
+                constexpr auto i = index.value;
+                using field_type = Refl::Class::member_type<T, i>;
+                ret += "    ";
+                ret += GlslTypeName<std::remove_extent_t<field_type>>();
+                ret += ' ';
+                ret += pref.uniform_prefix;
+                ret += Refl::Class::MemberName<T>(i);
+                if constexpr (std::is_array_v<field_type>)
+                {
+                    ret += '[';
+                    ret += std::to_string(std::extent_v<field_type>);
+                    ret += ']';
+                }
+                ret += ";\n";
+            });
+            ret += "};\n";
+            return ret;
+        }
+
+        // Makes the shader read the block `block_name` from our binding point. Does nothing if the shader doesn't use the block.
+        void Attach(const Shader &shader, std::string_view block_name) const
+        {
+            ASSERT(*this, "Attempt to use a null uniform block.");
+            ASSERT(shader, "Attempt to use a null shader.");
+            if (!*this || !shader)
+                return;
+            GLuint index = glGetUniformBlockIndex(shader.Handle(), std::string(block_name).c_str());
+            if (index == GL_INVALID_INDEX)
+                return; // The block is unused and was optimized out.
+            glUniformBlockBinding(shader.Handle(), index, data.binding_point);
+        }
+
+        // Binds the buffer to our binding point, if it's not already bound.
+        void Bind() const
+        {
+            ASSERT(*this, "Attempt to use a null uniform block.");
+            if (!*this)
+                return;
+            UniformBlocks::Bind(data.binding_point, data.handle);
+        }
+
+        // Uploads the value, unless it didn't change. Doesn't bind the block.
+        void Set(const T &value)
+        {
+            ASSERT(*this, "Attempt to use a null uniform block.");
+            if (!*this)
+                return;
+
+            std::array<unsigned char, layout.size> bytes{};
+            Meta::cexpr_for<Refl::Class::member_count<T>>([&](auto index)
+            {
+                constexpr auto i = index.value;
+                Std140::Member<Refl::Class::member_type<T, i>>::Write(bytes.data() + layout.offsets[i], Refl::Class::Member<i>(value));
+            });
+
+            if (data.has_value && bytes == data.bytes)
+                return;
+            data.bytes = bytes;
+            data.has_value = true;
+
+            glBindBuffer(GL_UNIFORM_BUFFER, data.handle);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, layout.size, data.bytes.data());
+        }
+    };
+}
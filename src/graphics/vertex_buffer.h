@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstring>
 #include <type_traits>
 #include <utility>
 
@@ -35,6 +36,8 @@ namespace Graphics
     // Indicates that the attribute is normalized.
     struct Normalized : Refl::BasicAttribute {};
 
+    // Where available, each reflected `VertexBuffer` gets its own vertex array object, with the attributes specified once.
+    // Then binding it for drawing is a single `glBindVertexArray()`. The raw `BindDraw()` uses a shared VAO, and re-specifies the attributes when the buffer changes.
     class VertexBuffers
     {
         VertexBuffers() = delete;
@@ -44,7 +47,34 @@ namespace Graphics
         inline static GLuint binding = 0;
         inline static GLuint binding_draw = 0;
 
-        inline static int active_attrib_count = 0;
+        inline static int active_attrib_count = 0; // In the shared VAO.
+
+        #ifdef GL_VERTEX_ARRAY_BINDING
+        inline static GLuint vertex_array_binding = 0;
+        inline static GLuint shared_vertex_array = 0; // For the raw `BindDraw()`. Created on first use, never destroyed.
+
+        static void BindVertexArray(GLuint vertex_array)
+        {
+            if (vertex_array_binding == vertex_array)
+                return;
+            glBindVertexArray(vertex_array);
+            vertex_array_binding = vertex_array;
+        }
+
+        static void BindSharedVertexArray()
+        {
+            if (!shared_vertex_array)
+            {
+                glGenVertexArrays(1, &shared_vertex_array);
+                if (!shared_vertex_array)
+                    Program::Error("Unable to create a vertex array object.");
+            }
+            if (vertex_array_binding == shared_vertex_array)
+                return;
+            BindVertexArray(shared_vertex_array);
+            binding_draw = 0; // We don't remember which buffer the shared VAO was last set up for.
+        }
+        #endif
 
         static void SetActiveAttribCount(int count)
         {
@@ -56,7 +86,58 @@ namespace Graphics
                 do glDisableVertexAttribArray(--active_attrib_count); while (active_attrib_count > count);
         }
 
+        // Sets the attribute pointers for the currently bound storage. Doesn't enable them.
+        // `attributes` is effectively unused. We need it to compute attribute offsets.
+        template <typename T>
+        static void SetAttribPointers(const T &attributes)
+        {
+            int attrib_index = 0;
+
+            Meta::cexpr_for<Refl::Class::member_count<T>>([&](auto index)
+            {
+                constexpr auto i = index.value;
+                using field_type = Refl::Class::member_type<T, i>;
+                using base_type = Math::vec_base_t<field_type>;
+
+                GLint type_enum;
+
+                if constexpr (std::is_same_v<base_type, char>)
+                    type_enum = (std::is_signed_v<char> ? GL_BYTE : GL_UNSIGNED_BYTE);
+                else if constexpr (std::is_same_v<base_type, signed char>)
+                    type_enum = GL_BYTE;
+                else if constexpr (std::is_same_v<base_type, unsigned char>)
+                    type_enum = GL_UNSIGNED_BYTE;
+                else if constexpr (std::is_same_v<base_type, short>)
+                    type_enum = GL_SHORT;
+                else if constexpr (std::is_same_v<base_type, unsigned short>)
+                    type_enum = GL_UNSIGNED_SHORT;
+                #ifdef GL_INT
+                else if constexpr (std::is_same_v<base_type, int>)
+                    type_enum = GL_INT;
+                else if constexpr (std::is_same_v<base_type, unsigned int>)
+                    type_enum = GL_UNSIGNED_INT;
+                #endif
+                else if constexpr (std::is_same_v<base_type, float>)
+                    type_enum = GL_FLOAT;
+                else
+                    static_assert(Meta::value<false, T, decltype(index)>, "Attributes of this type are not supported.");
+
+                uintptr_t offset = reinterpret_cast<const char *>(&Refl::Class::Member<i>(attributes)) - reinterpret_cast<const char *>(&attributes);
+                glVertexAttribPointer(attrib_index++, Math::vec_size_v<field_type>, type_enum, Refl::Class::member_has_attrib<T, i, Normalized>, sizeof(T), (void *)offset);
+            });
+        }
+
       public:
+        // Returns true if the buffers can have own VAOs, see `CreateVertexArray()`.
+        [[nodiscard]] static constexpr bool HaveVertexArrays()
+        {
+            #ifdef GL_VERTEX_ARRAY_BINDING
+            return true;
+            #else
+            return false;
+            #endif
+        }
+
         // Simply binds the VBO if it's not already bound.
         static void BindStorage(GLuint handle)
         {
@@ -67,12 +148,16 @@ namespace Graphics
             binding_draw = 0;
         }
 
-        // First, binds storage for the same handle if necessary. Then sets attribute pointers if T is reflected, otherwise disables all attributes.
+        // Binds the shared VAO, if any. Then binds storage for the same handle if necessary, and sets attribute pointers if T is reflected, otherwise disables all attributes.
         // BindDraw(0) is a special case. It disables all attributes, and thus strips draw binding from currently bound buffer (if any).
         // `attributes` is effectively unused. We need it to compute attribute offsets.
         template <typename T>
         static void BindDraw(GLuint handle, const T &attributes)
         {
+            #ifdef GL_VERTEX_ARRAY_BINDING
+            BindSharedVertexArray();
+            #endif
+
             if (handle == 0) // Null handle is a special case.
             {
                 // Note that we disable attributes unconditionally. We don't want to insert `if (binding_draw != 0)` here.
@@ -91,46 +176,53 @@ namespace Graphics
             SetActiveAttribCount(field_count);
 
             if constexpr (is_reflected)
-            {
-                int attrib_index = 0;
-
-                Meta::cexpr_for<Refl::Class::member_count<T>>([&](auto index)
-                {
-                    constexpr auto i = index.value;
-                    using field_type = Refl::Class::member_type<T, i>;
-                    using base_type = Math::vec_base_t<field_type>;
-
-                    GLint type_enum;
-
-                    if constexpr (std::is_same_v<base_type, char>)
-                        type_enum = (std::is_signed_v<char> ? GL_BYTE : GL_UNSIGNED_BYTE);
-                    else if constexpr (std::is_same_v<base_type, signed char>)
-                        type_enum = GL_BYTE;
-                    else if constexpr (std::is_same_v<base_type, unsigned char>)
-                        type_enum = GL_UNSIGNED_BYTE;
-                    else if constexpr (std::is_same_v<base_type, short>)
-                        type_enum = GL_SHORT;
-                    else if constexpr (std::is_same_v<base_type, unsigned short>)
-                        type_enum = GL_UNSIGNED_SHORT;
-                    #ifdef GL_INT
-                    else if constexpr (std::is_same_v<base_type, int>)
-                        type_enum = GL_INT;
-                    else if constexpr (std::is_same_v<base_type, unsigned int>)
-                        type_enum = GL_UNSIGNED_INT;
-                    #endif
-                    else if constexpr (std::is_same_v<base_type, float>)
-                        type_enum = GL_FLOAT;
-                    else
-                        static_assert(Meta::value<false, T, decltype(index)>, "Attributes of this type are not supported.");
-
-                    uintptr_t offset = reinterpret_cast<const char *>(&Refl::Class::Member<i>(attributes)) - reinterpret_cast<const char *>(&attributes);
-                    glVertexAttribPointer(attrib_index++, Math::vec_size_v<field_type>, type_enum, Refl::Class::member_has_attrib<T, i, Normalized>, sizeof(T), (void *)offset);
-                });
-            }
+                SetAttribPointers(attributes);
 
             binding_draw = handle;
         }
 
+        #ifdef GL_VERTEX_ARRAY_BINDING
+        // Creates a VAO with the attributes of `T` pointing to the buffer `handle`, and binds it for drawing.
+        // `attributes` is effectively unused. We need it to compute attribute offsets.
+        template <typename T>
+        [[nodiscard]] static GLuint CreateVertexArray(GLuint handle, const T &attributes)
+        {
+            static_assert(Refl::Class::members_known<T>, "The type must be reflected.");
+
+            GLuint vertex_array = 0;
+            glGenVertexArrays(1, &vertex_array);
+            if (!vertex_array)
+                Program::Error("Unable to create a vertex array object.");
+            BindVertexArray(vertex_array);
+            BindStorage(handle);
+            for (int i = 0; i < int(Refl::Class::member_count<T>); i++)
+                glEnableVertexAttribArray(i);
+            SetAttribPointers(attributes);
+            binding_draw = handle;
+            return vertex_array;
+        }
+
+        // Binds a VAO returned by `CreateVertexArray()` for the same `handle`. Doesn't touch the storage binding.
+        static void BindDrawVertexArray(GLuint handle, GLuint vertex_array)
+        {
+            if (binding_draw == handle && vertex_array_binding == vertex_array)
+                return;
+            BindVertexArray(vertex_array);
+            binding_draw = handle;
+        }
+
+        static void DeleteVertexArray(GLuint vertex_array)
+        {
+            if (vertex_array_binding == vertex_array)
+            {
+                // GL unbinds it automatically.
+                vertex_array_binding = 0;
+                binding_draw = 0;
+            }
+            glDeleteVertexArrays(1, &vertex_array);
+        }
+        #endif
+
         static void ForgetBoundBuffer() // Assume no buffer is bound, but don't actually unbind anything. Useful if currently bound buffer is going to be deleted immediately.
         {
             binding = 0;
@@ -145,6 +237,15 @@ namespace Graphics
         {
             return binding_draw;
         }
+        // The currently bound VAO, as far as we know. The index buffer binding is a part of it. Always 0 if `!HaveVertexArrays()`.
+        static GLuint VertexArrayBinding()
+        {
+            #ifdef GL_VERTEX_ARRAY_BINDING
+            return vertex_array_binding;
+            #else
+            return 0;
+            #endif
+        }
     };
 
     template <typename T>
@@ -156,6 +257,7 @@ namespace Graphics
         {
             GLuint handle = 0;
             int size = 0;
+            mutable GLuint vertex_array = 0; // Created by the first `BindDraw()`, if `is_reflected` and `VertexBuffers::HaveVertexArrays()`.
         };
         Data data;
 
@@ -186,6 +288,10 @@ namespace Graphics
 
         ~VertexBuffer()
         {
+            #ifdef GL_VERTEX_ARRAY_BINDING
+            if (data.vertex_array)
+                VertexBuffers::DeleteVertexArray(data.vertex_array);
+            #endif
             if (StorageBound())
                 VertexBuffers::ForgetBoundBuffer(); // GL unbinds the buffer automatically.
             if (data.handle)
@@ -223,6 +329,16 @@ namespace Graphics
             ASSERT(*this, "Attempt to use a null vertex buffer.");
             if (!*this)
                 return;
+            #ifdef GL_VERTEX_ARRAY_BINDING
+            if constexpr (is_reflected)
+            {
+                if (!data.vertex_array)
+                    data.vertex_array = VertexBuffers::CreateVertexArray(data.handle, attributes);
+                else
+                    VertexBuffers::BindDrawVertexArray(data.handle, data.vertex_array);
+                return;
+            }
+            #endif
             VertexBuffers::BindDraw(data.handle, attributes);
         }
         static void UnbindDraw() // Disables all attributes. If any buffer is currently bound, this results in stripping draw binding from it.
@@ -262,6 +378,25 @@ namespace Graphics
             glBufferSubData(GL_ARRAY_BUFFER, offset, bytes, source);
         }
 
+        // Same as `SetDataPart()`, but maps the range with `GL_MAP_UNSYNCHRONIZED_BIT`, so the driver doesn't wait for the pending draws that use this buffer.
+        // You must make sure that no pending draws use this range. Falls back to `SetDataPart()` if the mapping fails.
+        void SetDataPartUnsynchronized(int elem_offset, int elem_count, const T *source) // Binds storage.
+        {
+            ASSERT(*this, "Attempt to use a null vertex buffer.");
+            if (!*this)
+                return;
+            BindStorage();
+            void *ptr = glMapBufferRange(GL_ARRAY_BUFFER, elem_offset * sizeof(T), elem_count * sizeof(T), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            if (!ptr)
+            {
+                SetDataPart(elem_offset, elem_count, source);
+                return;
+            }
+            std::memcpy(ptr, source, elem_count * sizeof(T));
+            if (!glUnmapBuffer(GL_ARRAY_BUFFER))
+                SetDataPart(elem_offset, elem_count, source); // The contents got corrupted, this can happen e.g. on a display mode change.
+        }
+
         void Draw(DrawMode m, int offset, int count) const // Binds for drawing.
         {
             static_assert(is_reflected, "Element type of this buffer is not reflected, unable to draw.");
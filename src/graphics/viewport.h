@@ -2,13 +2,15 @@
 
 #include <cglfl/cglfl.hpp>
 
+#include "graphics/state_cache.h"
 #include "utils/mat.h"
 
 namespace Graphics
 {
+    // Skips the call if the viewport didn't change, see `StateCache`.
     inline void Viewport(ivec2 pos, ivec2 size)
     {
-        glViewport(pos.x, pos.y, size.x, size.y);
+        StateCache::SetViewport(pos, size);
     }
     inline void Viewport(ivec2 size)
     {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 
 #include "input/enum.h"
@@ -35,9 +36,14 @@ namespace Input
         [[nodiscard]] bool pressed () const {auto window = Interface::Window::Get(); return window.GetInputTimes(index).press   == window.Ticks();}
         [[nodiscard]] bool released() const {auto window = Interface::Window::Get(); return window.GetInputTimes(index).release == window.Ticks();}
         [[nodiscard]] bool repeated() const {auto window = Interface::Window::Get(); return window.GetInputTimes(index).repeat  == window.Ticks();}
-        [[nodiscard]] bool down    () const {auto times = Interface::Window::Get().GetInputTimes(index); return times.press > times.release;}
+        // This compares the event order rather than the ticks, so it's correct even if the button was released and pressed again during the same tick.
+        [[nodiscard]] bool down    () const {auto times = Interface::Window::Get().GetInputTimes(index); return times.press_order > times.release_order;}
         [[nodiscard]] bool up      () const {return !down();}
 
+        // When the button was last pressed or released, as in `SDL_GetTicks()`. Use this for the sub-tick precision.
+        [[nodiscard]] std::uint32_t PressTimestamp  () const {return Interface::Window::Get().GetInputTimes(index).press_timestamp;}
+        [[nodiscard]] std::uint32_t ReleaseTimestamp() const {return Interface::Window::Get().GetInputTimes(index).release_timestamp;}
+
         // Returns true if the key is not null.
         // We use a function instead of `operator bool` because then it's too easy to forget `.pressed()` (and other similar functions) when referring to a button.
         [[nodiscard]] bool IsAssigned() const
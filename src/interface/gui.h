@@ -40,6 +40,8 @@ namespace Interface
             virtual bool Reload() = 0; // Returns `false` on failure.
         };
 
+        // Only one of the backends is compiled, depending on the OpenGL flavor, same as in the ImGui sources.
+        #if CGLFL_GL_MAJOR == 2 && !defined(CGLFL_GL_API_gles)
         class GraphicsBackend_FixedFunction : public GraphicsBackend
         {
           public:
@@ -65,7 +67,8 @@ namespace Interface
                 return ImGui_ImplOpenGL2_CreateDeviceObjects();
             }
         };
-
+        using GraphicsBackend_Default = GraphicsBackend_FixedFunction;
+        #else
         class GraphicsBackend_Modern : public GraphicsBackend
         {
           public:
@@ -91,6 +94,8 @@ namespace Interface
                 return ImGui_ImplOpenGL3_CreateDeviceObjects();
             }
         };
+        using GraphicsBackend_Default = GraphicsBackend_Modern;
+        #endif
 
 
       private:
@@ -101,6 +106,9 @@ namespace Interface
             bool frame_started = false;
             bool frame_rendered = false;
 
+            // If false, the frames aren't built or rendered at all, see `SetEnabled()`.
+            bool enabled = true;
+
             std::vector<std::function<void()>> execute_before_next_frame;
 
             Poly::Storage<GraphicsBackend> graphics_backend;
@@ -185,6 +193,39 @@ namespace Interface
             return data.context && data.context == ImGui::GetCurrentContext();
         }
 
+        // When disabled, `PreTick()` doesn't start the frames, and nothing is rendered, so ImGui costs nothing.
+        // Don't call the ImGui functions that need a frame while disabled, check `IsFrameStarted()` first.
+        // The events are still passed to ImGui, so its input state doesn't get stuck.
+        void SetEnabled(bool enable)
+        {
+            if (enable == data.enabled)
+                return;
+            data.enabled = enable;
+            if (!enable)
+            {
+                ImGuiContext *old_context = ImGui::GetCurrentContext();
+                FINALLY( ImGui::SetCurrentContext(old_context); )
+                Activate();
+
+                if (data.frame_started)
+                {
+                    ImGui::EndFrame();
+                    data.frame_started = false;
+                }
+                data.frame_rendered = false;
+            }
+        }
+        [[nodiscard]] bool IsEnabled() const
+        {
+            return data.enabled;
+        }
+
+        // True between `PreTick()` and `PreRender()`, when the ImGui windows can be drawn.
+        [[nodiscard]] bool IsFrameStarted() const
+        {
+            return data.frame_started;
+        }
+
         enum HookMode {block_events, pass_events};
 
         auto EventHook(HookMode mode = block_events) // Use this with `Window::ProcessEvents()`.
@@ -229,6 +270,9 @@ namespace Interface
                 data.frame_started = false;
             }
 
+            if (!data.enabled)
+                return;
+
             data.graphics_backend->NewFrame();
             ImGui_ImplSDL2_NewFrame(Window::Get().Handle());
             ImGui::NewFrame();
@@ -259,7 +303,10 @@ namespace Interface
             if (data.frame_rendered)
             {
                 // Here we don't reset `frame_rendered` back to 0. Its sole purpose is to avoid segfault on the first frame.
-                data.graphics_backend->RenderFrame(ImGui::GetDrawData());
+                // If no windows are visible, we skip the backend entirely, since it saves and restores the whole GL state even if there's nothing to draw.
+                ImDrawData *draw_data = ImGui::GetDrawData();
+                if (draw_data && draw_data->TotalVtxCount > 0)
+                    data.graphics_backend->RenderFrame(draw_data);
             }
         }
 
@@ -1,5 +1,9 @@
 #include "window.h"
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include <cglfl/cglfl.hpp>
 
 #include "macros/finally.h"
@@ -76,6 +80,7 @@ namespace Interface
 
         ivec2 size = ivec2(0);
         VSync vsync = VSync::unspecified;
+        VSync requested_vsync = VSync::unspecified;
         bool resizable = false;
         FullscreenMode mode = FullscreenMode::windowed;
 
@@ -93,9 +98,65 @@ namespace Interface
         bool keyboard_focus = false, mouse_focus = false;
 
         std::vector<InputTimes> input_times;
+        uint64_t event_counter = 0; // See `InputTimes::press_order`.
 
         std::vector<std::string> dropped_files, dropped_strings;
 
+        // For `BeginSwapBuffers()`. The thread is started on the first swap.
+        struct SwapThread
+        {
+            std::thread thread;
+            std::mutex mutex;
+            std::condition_variable cond;
+            bool requested = false; // Set by `BeginSwapBuffers()`, reset by the thread when the swap is done.
+            bool stopping = false;
+            std::string error; // If not empty, the last swap failed.
+        };
+        std::unique_ptr<SwapThread> swap_thread;
+        bool swapping = false; // True between `BeginSwapBuffers()` and `FinishSwapBuffers()`.
+
+        void SwapThreadFunc()
+        {
+            SwapThread &st = *swap_thread;
+            std::unique_lock lock(st.mutex);
+            while (true)
+            {
+                st.cond.wait(lock, [&]{return st.requested || st.stopping;});
+                if (st.stopping)
+                    return;
+
+                lock.unlock();
+                std::string error;
+                if (SDL_GL_MakeCurrent(handle, context) == 0)
+                {
+                    SDL_GL_SwapWindow(handle);
+                    SDL_GL_MakeCurrent(handle, nullptr);
+                }
+                else
+                {
+                    error = SDL_GetError();
+                }
+                lock.lock();
+
+                st.error = std::move(error);
+                st.requested = false;
+                st.cond.notify_all();
+            }
+        }
+
+        void StopSwapThread()
+        {
+            if (!swap_thread)
+                return;
+            {
+                std::lock_guard lock(swap_thread->mutex);
+                swap_thread->stopping = true;
+            }
+            swap_thread->cond.notify_all();
+            swap_thread->thread.join();
+            swap_thread = nullptr;
+        }
+
 
         Data() {}
         Data(const Data &) = delete;
@@ -108,6 +169,14 @@ namespace Interface
         {
             if (is_complete)
             {
+                if (swapping)
+                {
+                    // Can't throw from here, so don't check for errors.
+                    std::unique_lock lock(swap_thread->mutex);
+                    swap_thread->cond.wait(lock, [&]{return !swap_thread->requested;});
+                }
+                StopSwapThread();
+
                 SDL_GL_DeleteContext(context);
                 SDL_DestroyWindow(handle);
                 SDL_Quit();
@@ -217,10 +286,12 @@ namespace Interface
             context_flags |= SDL_GL_CONTEXT_FORWARD_COMPATIBLE_FLAG;
         SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, context_flags);
 
-        // Window flags (resizability)
+        // Window flags (resizability, visibility)
         uint32_t window_flags = SDL_WINDOW_OPENGL;
         if (!settings.fixed_size)
             window_flags |= SDL_WINDOW_RESIZABLE;
+        if (settings.hidden)
+            window_flags |= SDL_WINDOW_HIDDEN;
 
         // Create the window
         data->handle = SDL_CreateWindow(title.c_str(), pos.x, pos.y, size.x, size.y, window_flags);
@@ -319,12 +390,12 @@ namespace Interface
         return data->context;
     }
 
-    void Window::SetTitle(std::string new_title)
+    void Window::SetTitle(std::string_view new_title)
     {
         if (new_title == data->title)
             return;
-        SDL_SetWindowTitle(data->handle, new_title.c_str());
-        data->title = std::move(new_title);
+        data->title = new_title; // This reuses the capacity.
+        SDL_SetWindowTitle(data->handle, data->title.c_str());
     }
 
     const std::string &Window::Title() const
@@ -344,6 +415,14 @@ namespace Interface
 
     void Window::SetVSyncMode(VSync new_vsync)
     {
+        data->requested_vsync = new_vsync;
+        OverrideVSyncMode(new_vsync);
+    }
+
+    void Window::OverrideVSyncMode(VSync new_vsync)
+    {
+        FinishSwapBuffers(); // Setting the swap interval needs the context.
+
         // Attempts to set a vsync mode. Returns true on success.
         auto TryMode = [&](VSync new_vsync) -> bool
         {
@@ -403,6 +482,19 @@ namespace Interface
         return data->vsync;
     }
 
+    VSync Window::RequestedVSyncMode() const
+    {
+        return data->requested_vsync;
+    }
+
+    int Window::RefreshRate() const
+    {
+        SDL_DisplayMode mode;
+        if (SDL_GetWindowDisplayMode(data->handle, &mode) != 0)
+            return 0;
+        return mode.refresh_rate;
+    }
+
     void Window::SetMode(FullscreenMode new_mode)
     {
         if (new_mode == borderless_fullscreen && !data->resizable)
@@ -434,7 +526,7 @@ namespace Interface
         return data->mode;
     }
 
-    void Window::ProcessEvents(const std::vector<std::function<bool(SDL_Event &)>> &hooks)
+    void Window::ProcessEventsLow(std::optional<std::uint32_t> max_timestamp, void *hook_context, bool (*hook)(void *hook_context, SDL_Event &event))
     {
         data->tick_counter++;
 
@@ -444,21 +536,43 @@ namespace Interface
         data->dropped_files.clear();
         data->dropped_strings.clear();
 
+        // Looks at the next event without removing it from the queue. Returns false if there's none, or if it's after `max_timestamp`.
+        // Unlike `SDL_PollEvent()`, this doesn't pump the events.
+        auto PeekEvent = [&](SDL_Event &event) -> bool
+        {
+            if (SDL_PeepEvents(&event, 1, SDL_PEEKEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT) != 1)
+                return false;
+            // This is how `SDL_TICKS_PASSED()` handles the wraparound.
+            return !max_timestamp || std::int32_t(*max_timestamp - event.common.timestamp) >= 0;
+        };
+        auto RemoveEvent = [&](SDL_Event &event)
+        {
+            SDL_PeepEvents(&event, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT);
+        };
+
+        SDL_PumpEvents();
+
         SDL_Event event;
-        while (SDL_PollEvent(&event))
+        while (PeekEvent(event))
         {
-            bool drop_event = false;
+            RemoveEvent(event);
+            data->event_counter++;
 
-            for (auto &hook : hooks)
+            if (event.type == SDL_MOUSEMOTION)
             {
-                if (!hook(event))
+                // Merge the following motion events into this one. High polling rate mice can produce a lot of those.
+                // Only the consecutive events are merged, to preserve the order relative to the button presses.
+                SDL_Event next;
+                while (PeekEvent(next) && next.type == SDL_MOUSEMOTION && next.motion.windowID == event.motion.windowID && next.motion.which == event.motion.which)
                 {
-                    drop_event = true;
-                    break;
+                    RemoveEvent(next);
+                    next.motion.xrel += event.motion.xrel;
+                    next.motion.yrel += event.motion.yrel;
+                    event = next;
                 }
             }
 
-            if (drop_event)
+            if (hook && !hook(hook_context, event))
                 continue;
 
             switch (event.type)
@@ -476,6 +590,8 @@ namespace Interface
                     if (event.key.repeat)
                         break;
                     data->input_times[Input::BeginKeys + index].press = data->tick_counter;
+                    data->input_times[Input::BeginKeys + index].press_order = data->event_counter;
+                    data->input_times[Input::BeginKeys + index].press_timestamp = event.common.timestamp;
                 }
                 break;
               case SDL_KEYUP:
@@ -486,6 +602,8 @@ namespace Interface
                     if (event.key.repeat) // We don't care about repeated releases.
                         break;
                     data->input_times[Input::BeginKeys + index].release = data->tick_counter;
+                    data->input_times[Input::BeginKeys + index].release_order = data->event_counter;
+                    data->input_times[Input::BeginKeys + index].release_timestamp = event.common.timestamp;
                 }
                 break;
 
@@ -499,6 +617,8 @@ namespace Interface
                         break;
                     data->input_times[Input::BeginMouseButtons + index].press = data->tick_counter;
                     data->input_times[Input::BeginMouseButtons + index].repeat = data->tick_counter;
+                    data->input_times[Input::BeginMouseButtons + index].press_order = data->event_counter;
+                    data->input_times[Input::BeginMouseButtons + index].press_timestamp = event.common.timestamp;
                 }
                 break;
               case SDL_MOUSEBUTTONUP:
@@ -510,6 +630,8 @@ namespace Interface
                     if (index >= Input::EndMouseButtons - Input::BeginMouseButtons)
                         break;
                     data->input_times[Input::BeginMouseButtons + index].release = data->tick_counter;
+                    data->input_times[Input::BeginMouseButtons + index].release_order = data->event_counter;
+                    data->input_times[Input::BeginMouseButtons + index].release_timestamp = event.common.timestamp;
                 }
                 break;
 
@@ -525,6 +647,8 @@ namespace Interface
                     data->input_times[wheel_enum].press = data->tick_counter;
                     data->input_times[wheel_enum].release = data->tick_counter;
                     data->input_times[wheel_enum].repeat = data->tick_counter;
+                    data->input_times[wheel_enum].press_order = data->input_times[wheel_enum].release_order = data->event_counter;
+                    data->input_times[wheel_enum].press_timestamp = data->input_times[wheel_enum].release_timestamp = event.common.timestamp;
                 }
                 break;
 
@@ -572,10 +696,54 @@ namespace Interface
 
     void Window::SwapBuffers()
     {
+        FinishSwapBuffers();
         data->frame_counter++;
         SDL_GL_SwapWindow(data->handle);
     }
 
+    void Window::BeginSwapBuffers()
+    {
+        FinishSwapBuffers();
+        data->frame_counter++;
+
+        if (!data->swap_thread)
+        {
+            data->swap_thread = std::make_unique<Data::SwapThread>();
+            data->swap_thread->thread = std::thread([d = data.get()]{d->SwapThreadFunc();});
+        }
+
+        // Make sure the commands are submitted before the context is released, some drivers don't flush on that.
+        glFlush();
+        if (SDL_GL_MakeCurrent(data->handle, nullptr))
+            Program::Error("Unable to release the OpenGL context for swapping buffers on a background thread: ", SDL_GetError());
+
+        {
+            std::lock_guard lock(data->swap_thread->mutex);
+            data->swap_thread->requested = true;
+        }
+        data->swap_thread->cond.notify_all();
+        data->swapping = true;
+    }
+
+    void Window::FinishSwapBuffers()
+    {
+        if (!data->swapping)
+            return;
+
+        std::string error;
+        {
+            std::unique_lock lock(data->swap_thread->mutex);
+            data->swap_thread->cond.wait(lock, [&]{return !data->swap_thread->requested;});
+            error = std::move(data->swap_thread->error);
+        }
+        data->swapping = false;
+
+        if (SDL_GL_MakeCurrent(data->handle, data->context))
+            Program::Error("Unable to reacquire the OpenGL context after swapping buffers: ", SDL_GetError());
+        if (!error.empty())
+            Program::Error("Unable to swap buffers on a background thread: ", error);
+    }
+
     uint64_t Window::Ticks() const
     {
         return data->tick_counter;
@@ -606,6 +774,16 @@ namespace Interface
         return data->mouse_focus;
     }
 
+    bool Window::IsMinimized() const
+    {
+        return SDL_GetWindowFlags(data->handle) & (SDL_WINDOW_MINIMIZED | SDL_WINDOW_HIDDEN);
+    }
+
+    void Window::WaitForEvents(int timeout_ms)
+    {
+        SDL_WaitEventTimeout(nullptr, timeout_ms);
+    }
+
     const std::string &Window::TextInput() const
     {
         return data->text_input;
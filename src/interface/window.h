@@ -1,8 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <functional>
+#include <cstdint>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -34,6 +39,7 @@ namespace Interface
         ivec2 min_size = ivec2(0);
         bool fixed_size = false;
         int display = 0;
+        bool hidden = false; // Never show the window, e.g. if only the OpenGL context is needed.
 
         int gl_major = CGLFL_GL_MAJOR, gl_minor = CGLFL_GL_MINOR; // 0,0 = don't care.
 
@@ -68,6 +74,9 @@ namespace Interface
 
         std::shared_ptr<Data> data;
 
+        // `hook` can be null, then `hook_context` is unused.
+        void ProcessEventsLow(std::optional<std::uint32_t> max_timestamp, void *hook_context, bool (*hook)(void *hook_context, SDL_Event &event));
+
       public:
         Window() {}
         Window(const Window &) = default;
@@ -91,7 +100,7 @@ namespace Interface
         [[nodiscard]] SDL_Window *Handle() const;
         [[nodiscard]] SDL_GLContext Context() const;
 
-        void SetTitle(std::string new_title);
+        void SetTitle(std::string_view new_title);
         [[nodiscard]] const std::string &Title() const;
 
         [[nodiscard]] ivec2 Size() const;
@@ -103,6 +112,14 @@ namespace Interface
         // report `unspecified`, but is otherwise a no-op.
         void SetVSyncMode(VSync new_vsync);
         [[nodiscard]] VSync VSyncMode() const;
+        // The mode last passed to `SetVSyncMode()`, before the fallbacks.
+        // E.g. if it's `adaptive` but `VSyncMode()` is `enabled`, the driver doesn't support the adaptive vsync.
+        [[nodiscard]] VSync RequestedVSyncMode() const;
+        // Like `SetVSyncMode()`, but doesn't change `RequestedVSyncMode()`. For temporary changes, see `Program::DefaultBasicState::EmulateAdaptiveVSync()`.
+        void OverrideVSyncMode(VSync new_vsync);
+
+        // The refresh rate of the display the window is on, in Hz. Zero if unknown.
+        [[nodiscard]] int RefreshRate() const;
 
         // If the window is not resizable, then `borderless_fullscreen` (which would require a window resize) acts as `fullscreen`.
         void SetMode(FullscreenMode new_mode);
@@ -110,11 +127,48 @@ namespace Interface
 
         // Processes events, increments the tick counter.
         // If hooks are specified, applies them in order to each event. If a hook returns false, the current event is discarded.
-        void ProcessEvents(const std::vector<std::function<bool(SDL_Event &)>> &hooks = {});
+        // The hooks are combined at compile-time, so this costs a single indirect call per event, regardless of their number.
+        // Consecutive mouse motion events are merged into one before reaching the hooks, with the relative motion summed.
+        template <typename ...P> requires (std::is_invocable_r_v<bool, P &, SDL_Event &> && ...)
+        void ProcessEvents(P &&... hooks)
+        {
+            ProcessEventsUntil(std::nullopt, std::forward<P>(hooks)...);
+        }
+        // Same, but only processes the events with timestamps (as in `SDL_GetTicks()`) up to and including `max_timestamp`,
+        // leaving the rest for the next call. If `max_timestamp` is null, processes all events.
+        // Use this when running several ticks per frame (see `DefaultBasicState::TickEventTimestamp()`), so each tick only sees the input that happened before it.
+        template <typename ...P> requires (std::is_invocable_r_v<bool, P &, SDL_Event &> && ...)
+        void ProcessEventsUntil(std::optional<std::uint32_t> max_timestamp, P &&... hooks)
+        {
+            if constexpr (sizeof...(P) == 0)
+            {
+                ProcessEventsLow(max_timestamp, nullptr, nullptr);
+            }
+            else
+            {
+                auto hook = [&](SDL_Event &event) -> bool {return (bool(hooks(event)) && ...);};
+                ProcessEventsLow(max_timestamp, &hook, [](void *hook_context, SDL_Event &event) -> bool {return (*static_cast<decltype(hook) *>(hook_context))(event);});
+            }
+        }
+        // Same, but the list of hooks is determined at runtime.
+        void ProcessEvents(const std::vector<std::function<bool(SDL_Event &)>> &hooks)
+        {
+            if (hooks.empty())
+                ProcessEvents();
+            else
+                ProcessEvents([&](SDL_Event &event){return std::all_of(hooks.begin(), hooks.end(), [&](const auto &hook){return hook(event);});});
+        }
 
         // Updates the picture on the screen, increments the frame counter.
         void SwapBuffers();
 
+        // Same as `SwapBuffers()`, but the swap runs on a background thread, so the caller can tick while it blocks on vsync.
+        // The OpenGL context is moved to that thread, so no OpenGL functions can be called until `FinishSwapBuffers()`.
+        void BeginSwapBuffers();
+        // Waits for the swap started by `BeginSwapBuffers()`, and makes the OpenGL context current on this thread again.
+        // Does nothing if there's no swap in progress, so call this before anything that can touch OpenGL, if unsure.
+        void FinishSwapBuffers();
+
         // Those counters initially return 1.
         // This lets us use 0 for events that never happened.
         [[nodiscard]] uint64_t Ticks() const;
@@ -129,6 +183,11 @@ namespace Interface
         [[nodiscard]] bool HasKeyboardFocus() const;
         // Returns true if the window is hovered.
         [[nodiscard]] bool HasMouseFocus() const; // Returns 1 if the window is hovered.
+        // Returns true if the window is minimized or hidden, so there's no point in rendering.
+        [[nodiscard]] bool IsMinimized() const;
+
+        // Blocks until there's an event in the queue, or until the timeout runs out. Doesn't remove the event from the queue.
+        static void WaitForEvents(int timeout_ms);
 
         // Returns text that was entered during the last tick, in UTF-8.
         [[nodiscard]] const std::string &TextInput() const;
@@ -136,10 +195,15 @@ namespace Interface
         struct InputTimes
         {
             uint64_t press = 0, release = 0, repeat = 0;
+
+            // The indices of the events that pressed and released the button, counting all processed events. They order the events within a tick.
+            uint64_t press_order = 0, release_order = 0;
+            // The timestamps of the same events, as in `SDL_GetTicks()`.
+            std::uint32_t press_timestamp = 0, release_timestamp = 0;
         };
         // Returns the information about a specific button.
         // The values represent the last time points when a specific action happened to the button.
-        // They are taken from the `Ticks()` counter.
+        // `press`, `release` and `repeat` are taken from the `Ticks()` counter.
         [[nodiscard]] InputTimes GetInputTimes(Input::Enum index) const;
 
         // Returns mouse position.
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
 #include <cstdint>
 #include <string_view>
 
@@ -65,6 +69,126 @@ namespace Meta
         return cexpr_hash(view.data(), view.size(), seed);
     }
 
+    // A perfect hash for a fixed list of distinct strings. Maps each of them to its own slot, so a lookup is two hashes and one string comparison.
+    // Uses the "hash and displace" scheme: the strings are split into buckets by one hash,
+    // then each bucket gets a seed for the second hash, such that all its strings land in free slots.
+    // Meant to be constructed at compile-time.
+    template <std::size_t N>
+    class PerfectHash
+    {
+      public:
+        static constexpr std::size_t num_buckets = std::bit_ceil(N > 0 ? N : 1);
+        static constexpr std::size_t num_slots = num_buckets * 2;
+
+      private:
+        // Give up on a bucket after this many seeds. Should never happen for distinct strings.
+        static constexpr hash_t max_seed = 1 << 16;
+
+        std::array<hash_t, num_buckets> seeds{};
+        std::array<std::size_t, num_slots> slots{}; // String indices plus one, or 0 for free slots.
+        bool valid = true;
+
+        [[nodiscard]] static constexpr std::size_t BucketOf(std::string_view string)
+        {
+            return cexpr_hash(string) & (num_buckets - 1);
+        }
+
+        [[nodiscard]] static constexpr std::size_t SlotOf(std::string_view string, hash_t seed)
+        {
+            return cexpr_hash(string, seed) & (num_slots - 1);
+        }
+
+      public:
+        constexpr PerfectHash() {}
+
+        // `S` must be convertible to `std::string_view`.
+        // If the strings are not distinct, `IsValid()` returns false.
+        template <typename S>
+        constexpr PerfectHash(const std::array<S, N> &strings)
+        {
+            std::array<std::size_t, N> string_buckets{};
+            std::array<std::size_t, num_buckets> bucket_sizes{};
+            for (std::size_t i = 0; i < N; i++)
+                bucket_sizes[string_buckets[i] = BucketOf(strings[i])]++;
+
+            // Place the largest buckets first, while there's more free space.
+            std::array<std::size_t, num_buckets> bucket_order{};
+            for (std::size_t i = 0; i < num_buckets; i++)
+                bucket_order[i] = i;
+            std::sort(bucket_order.begin(), bucket_order.end(), [&](std::size_t a, std::size_t b){return bucket_sizes[a] > bucket_sizes[b];});
+
+            std::array<std::size_t, N> bucket_strings{};
+            for (std::size_t bucket : bucket_order)
+            {
+                std::size_t bucket_size = 0;
+                for (std::size_t i = 0; i < N; i++)
+                {
+                    if (string_buckets[i] != bucket)
+                        continue;
+                    for (std::size_t j = 0; j < bucket_size; j++)
+                    {
+                        if (std::string_view(strings[i]) == std::string_view(strings[bucket_strings[j]]))
+                        {
+                            valid = false;
+                            return;
+                        }
+                    }
+                    bucket_strings[bucket_size++] = i;
+                }
+                if (bucket_size == 0)
+                    break; // The remaining buckets are empty too.
+
+                for (hash_t seed = 1;; seed++)
+                {
+                    if (seed == max_seed)
+                    {
+                        valid = false;
+                        return;
+                    }
+
+                    bool ok = true;
+                    for (std::size_t j = 0; j < bucket_size && ok; j++)
+                    {
+                        std::size_t &slot = slots[SlotOf(strings[bucket_strings[j]], seed)];
+                        if (slot == 0)
+                            slot = bucket_strings[j] + 1;
+                        else
+                            ok = false;
+                    }
+                    if (ok)
+                    {
+                        seeds[bucket] = seed;
+                        break;
+                    }
+
+                    // Undo the partial placement.
+                    for (std::size_t j = 0; j < bucket_size; j++)
+                    {
+                        std::size_t &slot = slots[SlotOf(strings[bucket_strings[j]], seed)];
+                        if (slot == bucket_strings[j] + 1)
+                            slot = 0;
+                    }
+                }
+            }
+        }
+
+        // False if the strings passed to the constructor were not distinct.
+        [[nodiscard]] constexpr bool IsValid() const
+        {
+            return valid;
+        }
+
+        // Returns the index of the only string that can be equal to `string`, or -1 if there's none.
+        // You still need to compare the strings to confirm a match.
+        [[nodiscard]] constexpr std::size_t Find(std::string_view string) const
+        {
+            hash_t seed = seeds[BucketOf(string)];
+            if (seed == 0)
+                return -1; // An empty bucket.
+            return slots[SlotOf(string, seed)] - 1;
+        }
+    };
+
     // Some tests:
     // static_assert(Meta::cexpr_hash("abcd", 42) == 3898664396);
     // static_assert(Meta::cexpr_hash("abcde", 42) == 2933533680);
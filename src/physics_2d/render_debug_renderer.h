@@ -0,0 +1,176 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#include <box2d/b2_draw.h>
+
+#include "gameutils/render.h"
+#include "physics_2d/math_adapters.h"
+#include "utils/mat.h"
+
+
+// A debug renderer for box2d that batches everything into our `Render` queue as triangles, instead of going through ImGui.
+// Unlike `DebugRenderer`, this doesn't allocate per shape, and skips the shapes outside of the screen.
+// Use it on big worlds, where the ImGui one is too slow.
+
+namespace Physics2d
+{
+    class RenderDebugRenderer : public b2Draw
+    {
+      public:
+        // Must be non-null when drawing.
+        Render *render = nullptr;
+
+        // Camera location. The camera position ends up at (0,0), so this matches the usual centered `Render` matrix.
+        fvec2 camera_pos{};
+        float camera_scale = 1;
+        // The primitives outside of this rectangle (centered at the camera, in pixels) are skipped. Normally half the screen size.
+        fvec2 visible_half_size = fvec2(1e9f);
+
+        // Visual options.
+        float line_width = 1;
+        float alpha_contour = 1;
+        float alpha_fill = 0.6f;
+        float xf_pixel_size = 16; // Pixel size for rendering transforms.
+
+        // How many segments per pixel of the circle radius, and the limits.
+        float circle_segments_per_pixel = 0.5f;
+        int min_circle_segments = 8, max_circle_segments = 64;
+
+        [[nodiscard]] fvec2 TransformPos(b2Vec2 vec) const
+        {
+            return (fvec2(vec) - camera_pos) * camera_scale;
+        }
+
+        // Returns true if the bounding box of the points (after `TransformPos()`) is at least partially visible.
+        [[nodiscard]] bool IsVisible(fvec2 a, fvec2 b) const
+        {
+            fvec2 margin = fvec2(line_width);
+            return (max(a, b) >= -visible_half_size - margin).all() && (min(a, b) <= visible_half_size + margin).all();
+        }
+
+        void AddTriangle(fvec2 a, fvec2 b, fvec2 c, const b2Color &color, bool is_fill)
+        {
+            render->ftriangle(a, b, c).color(fvec3(color.r, color.g, color.b)).alpha(color.a * (is_fill ? alpha_fill : alpha_contour));
+        }
+
+        // Both points are already transformed.
+        void AddLine(fvec2 a, fvec2 b, const b2Color &color)
+        {
+            fvec2 delta = b - a;
+            if (delta == fvec2())
+                return;
+            fvec2 offset = delta.norm().rot90() * (line_width / 2);
+            AddTriangle(a - offset, a + offset, b + offset, color, false);
+            AddTriangle(a - offset, b + offset, b - offset, color, false);
+        }
+
+        [[nodiscard]] int CircleSegmentCount(float radius) const
+        {
+            return std::clamp(int(radius * camera_scale * circle_segments_per_pixel), min_circle_segments, max_circle_segments);
+        }
+
+        void DrawPolygonLow(const b2Vec2 *vertices, int32 vertex_count, const b2Color &color, bool fill)
+        {
+            if (vertex_count <= 0)
+                return;
+
+            fvec2 first = TransformPos(vertices[0]);
+            fvec2 bb_min = first, bb_max = first;
+            for (int32 i = 1; i < vertex_count; i++)
+            {
+                fvec2 pos = TransformPos(vertices[i]);
+                bb_min = min(bb_min, pos);
+                bb_max = max(bb_max, pos);
+            }
+            if (!IsVisible(bb_min, bb_max))
+                return;
+
+            // The points are always in a CCW order, and the polygons are convex, so a triangle fan works.
+            if (fill)
+            {
+                for (int32 i = 2; i < vertex_count; i++)
+                    AddTriangle(first, TransformPos(vertices[i - 1]), TransformPos(vertices[i]), color, true);
+            }
+
+            fvec2 prev = TransformPos(vertices[vertex_count - 1]);
+            for (int32 i = 0; i < vertex_count; i++)
+            {
+                fvec2 pos = TransformPos(vertices[i]);
+                AddLine(prev, pos, color);
+                prev = pos;
+            }
+        }
+
+        void DrawCircleLow(const b2Vec2 &center, float radius, const b2Color &color, bool fill)
+        {
+            fvec2 screen_center = TransformPos(center);
+            float screen_radius = radius * camera_scale;
+            if (!IsVisible(screen_center - screen_radius, screen_center + screen_radius))
+                return;
+
+            int segments = CircleSegmentCount(radius);
+            fvec2 prev = screen_center + fvec2(screen_radius, 0);
+            for (int i = 1; i <= segments; i++)
+            {
+                float angle = i * 2 * std::numbers::pi_v<float> / segments;
+                fvec2 pos = screen_center + fvec2(std::cos(angle), std::sin(angle)) * screen_radius;
+                if (fill)
+                    AddTriangle(screen_center, prev, pos, color, true);
+                AddLine(prev, pos, color);
+                prev = pos;
+            }
+        }
+
+        void DrawPolygon(const b2Vec2 *vertices, int32 vertex_count, const b2Color &color) override
+        {
+            DrawPolygonLow(vertices, vertex_count, color, false);
+        }
+
+        void DrawSolidPolygon(const b2Vec2 *vertices, int32 vertex_count, const b2Color &color) override
+        {
+            DrawPolygonLow(vertices, vertex_count, color, true);
+        }
+
+        void DrawCircle(const b2Vec2 &center, float radius, const b2Color &color) override
+        {
+            DrawCircleLow(center, radius, color, false);
+        }
+
+        void DrawSolidCircle(const b2Vec2 &center, float radius, const b2Vec2 &axis, const b2Color &color) override
+        {
+            DrawCircleLow(center, radius, color, true);
+            DrawSegment(center, b2Vec2(fvec2(center) + fvec2(axis) * radius), color);
+        }
+
+        void DrawSegment(const b2Vec2 &p1, const b2Vec2 &p2, const b2Color &color) override
+        {
+            fvec2 a = TransformPos(p1), b = TransformPos(p2);
+            if (IsVisible(a, b))
+                AddLine(a, b, color);
+        }
+
+        void DrawTransform(const b2Transform &xf) override
+        {
+            b2Vec2 x = xf.q.GetXAxis();
+            b2Vec2 y = xf.q.GetYAxis();
+            x *= xf_pixel_size / camera_scale;
+            y *= xf_pixel_size / camera_scale;
+            DrawSegment(xf.p, xf.p + x, b2Color(1, 0, 0));
+            DrawSegment(xf.p, xf.p + y, b2Color(0, 1, 0));
+        }
+
+        void DrawPoint(const b2Vec2 &p, float size, const b2Color &color) override
+        {
+            // `size` is a diameter in pixels, same as in `DebugRenderer`.
+            fvec2 pos = TransformPos(p);
+            fvec2 half = fvec2(size / 2);
+            if (!IsVisible(pos - half, pos + half))
+                return;
+            AddTriangle(pos - half, pos + fvec2(half.x, -half.y), pos + half, color, false);
+            AddTriangle(pos - half, pos + half, pos + fvec2(-half.x, half.y), color, false);
+        }
+    };
+}
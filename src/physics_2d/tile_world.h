@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <box2d/b2_body.h>
+#include <box2d/b2_chain_shape.h>
+#include <box2d/b2_fixture.h>
+#include <box2d/b2_world.h>
+
+#include "gameutils/tiles_to_edges.h"
+#include "physics_2d/math_adapters.h"
+#include "strings/format.h"
+#include "utils/mat.h"
+#include "utils/metronome.h"
+#include "utils/multiarray.h"
+
+
+// A Box2D world with the static geometry generated from a tile map.
+// The map is split into square chunks, each chunk gets its own static body made of chain loops, and only the chunks near the camera have bodies.
+// This keeps the broadphase small on large maps.
+
+namespace Physics2d
+{
+    class TileWorld
+    {
+      public:
+        struct Params
+        {
+            // Must be non-null, and must remain alive.
+            const GameUtils::TilesToEdges::TileSet *tileset = nullptr;
+
+            // The chunk size, in tiles.
+            int chunk_size = 32;
+            // The tileset vertices are in pixels, this converts them to Box2D units.
+            float pixels_per_meter = 32;
+
+            // The chunks within this many chunks from the visible area are created. They are destroyed when they're twice as far.
+            int chunk_margin = 1;
+
+            fvec2 gravity{};
+            int velocity_iterations = 8;
+            int position_iterations = 3;
+        };
+
+      private:
+        struct Chunk
+        {
+            b2Body *body = nullptr;
+            bool loaded = false; // If true, this chunk is in `loaded_chunks`. It might still have no body if it has no edges.
+            bool dirty = false; // If true, the body needs to be rebuilt.
+        };
+
+        Params params;
+        b2World world;
+        Array2D<std::size_t> tiles;
+        Array2D<Chunk> chunks;
+        std::vector<index_vec2> loaded_chunks; // In no particular order.
+
+        [[nodiscard]] index_vec2 ChunkTileSize(index_vec2 chunk_pos) const
+        {
+            return min(tiles.size() - chunk_pos * params.chunk_size, index_vec2(params.chunk_size));
+        }
+
+        void DestroyChunkBody(index_vec2 chunk_pos)
+        {
+            Chunk &chunk = chunks.safe_nonthrowing_at(chunk_pos);
+            if (chunk.body)
+            {
+                world.DestroyBody(chunk.body);
+                chunk.body = nullptr;
+            }
+        }
+
+        void BuildChunkBody(index_vec2 chunk_pos)
+        {
+            DestroyChunkBody(chunk_pos);
+            Chunk &chunk = chunks.safe_nonthrowing_at(chunk_pos);
+            chunk.dirty = false;
+
+            // The chunks are converted separately, so the loops are closed at the chunk boundaries.
+            index_vec2 base = chunk_pos * params.chunk_size;
+            Array2D<std::size_t> chunk_tiles(ChunkTileSize(chunk_pos));
+            for (index_vec2 pos : vector_range(chunk_tiles.size()))
+                chunk_tiles.unsafe_at(pos) = tiles.unsafe_at(base + pos);
+
+            GameUtils::TilesToEdges::EdgeLoops loops = GameUtils::TilesToEdges::ConvertToLoops(*params.tileset, chunk_tiles);
+            if (loops.NumLoops() == 0)
+                return;
+
+            b2BodyDef body_def;
+            body_def.type = b2_staticBody;
+            body_def.position = b2Vec2(fvec2(base * params.tileset->tile_size) / params.pixels_per_meter);
+            chunk.body = world.CreateBody(&body_def);
+
+            std::vector<b2Vec2> vertices;
+            for (std::size_t i = 0; i < loops.NumLoops(); i++)
+            {
+                auto loop = loops.Loop(i);
+                if (loop.size() < 3)
+                    continue; // Box2D doesn't accept those.
+
+                vertices.clear();
+                for (ivec2 vertex : loop)
+                    vertices.push_back(b2Vec2(fvec2(vertex) / params.pixels_per_meter));
+
+                b2ChainShape shape;
+                shape.CreateLoop(vertices.data(), int32(vertices.size()));
+                chunk.body->CreateFixture(&shape, 0);
+            }
+        }
+
+      public:
+        TileWorld(Params new_params, Array2D<std::size_t> new_tiles)
+            : params(std::move(new_params)), world(b2Vec2(params.gravity)), tiles(std::move(new_tiles))
+        {
+            if (!params.tileset)
+                throw std::runtime_error("The tileset must be non-null.");
+            if (params.chunk_size <= 0)
+                throw std::runtime_error("The chunk size must be positive.");
+
+            chunks = Array2D<Chunk>((tiles.size() + params.chunk_size - 1) / params.chunk_size);
+        }
+
+        // Box2D bodies store pointers to the world.
+        TileWorld(const TileWorld &) = delete;
+        TileWorld &operator=(const TileWorld &) = delete;
+
+        [[nodiscard]] b2World &World() {return world;}
+        [[nodiscard]] const b2World &World() const {return world;}
+
+        [[nodiscard]] const Array2D<std::size_t> &Tiles() const {return tiles;}
+
+        // Throws if `pos` is out of range. If the chunk has a body, it's rebuilt on the next `Tick()`.
+        void SetTile(index_vec2 pos, std::size_t tile)
+        {
+            std::size_t &cell = tiles.safe_throwing_at(pos);
+            if (cell == tile)
+                return;
+            cell = tile;
+            chunks.safe_nonthrowing_at(pos / params.chunk_size).dirty = true;
+        }
+
+        // Creates the chunk bodies around the visible area, and destroys the ones far from it.
+        // `center` and `half_extent` are in pixels, like the tileset vertices.
+        void StreamAround(fvec2 center, fvec2 half_extent)
+        {
+            if (chunks.size().min() == 0)
+                return;
+
+            fvec2 chunk_pixel_size = fvec2(params.tileset->tile_size * params.chunk_size);
+            index_vec2 visible_a = index_vec2(floor((center - half_extent) / chunk_pixel_size));
+            index_vec2 visible_b = index_vec2(floor((center + half_extent) / chunk_pixel_size));
+
+            // Destroy the far chunks first.
+            index_vec2 keep_a = visible_a - params.chunk_margin * 2, keep_b = visible_b + params.chunk_margin * 2;
+            std::erase_if(loaded_chunks, [&](index_vec2 chunk_pos)
+            {
+                if ((chunk_pos >= keep_a).all() && (chunk_pos <= keep_b).all())
+                    return false;
+                DestroyChunkBody(chunk_pos);
+                chunks.safe_nonthrowing_at(chunk_pos).loaded = false;
+                return true;
+            });
+
+            index_vec2 load_a = max(visible_a - params.chunk_margin, 0);
+            index_vec2 load_b = min(visible_b + params.chunk_margin, chunks.size() - 1);
+            if ((load_a > load_b).any())
+                return; // Too far from the map.
+            for (index_vec2 chunk_pos : load_a <= vector_range <= load_b)
+            {
+                Chunk &chunk = chunks.safe_nonthrowing_at(chunk_pos);
+                if (chunk.loaded)
+                    continue;
+                BuildChunkBody(chunk_pos);
+                chunk.loaded = true;
+                loaded_chunks.push_back(chunk_pos);
+            }
+        }
+
+        // Steps the world once, by the tick length of the `metronome`. Call this once per tick, then the physics has a fixed timestep.
+        void Tick(const Metronome &metronome)
+        {
+            for (index_vec2 chunk_pos : loaded_chunks)
+            {
+                if (chunks.safe_nonthrowing_at(chunk_pos).dirty)
+                    BuildChunkBody(chunk_pos);
+            }
+
+            world.Step(float(1 / metronome.Frequency()), params.velocity_iterations, params.position_iterations);
+        }
+    };
+}
@@ -0,0 +1,140 @@
+#include "alloc_stats.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace Program::AllocStats
+{
+    #ifdef IMP_COUNT_ALLOCATIONS
+    namespace
+    {
+        // Those are constant-initialized, so they work before the static constructors run.
+        std::atomic<std::uint64_t> total_allocs = 0, total_frees = 0, total_bytes = 0;
+        std::atomic<std::size_t> live_bytes = 0, peak_live_bytes = 0;
+        constinit thread_local Counters this_thread;
+
+        void CountAlloc(std::size_t size) noexcept
+        {
+            total_allocs.fetch_add(1, std::memory_order_relaxed);
+            total_bytes.fetch_add(size, std::memory_order_relaxed);
+            this_thread.allocs++;
+            this_thread.bytes += size;
+
+            std::size_t live = live_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+            std::size_t peak = peak_live_bytes.load(std::memory_order_relaxed);
+            while (peak < live && !peak_live_bytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {}
+        }
+
+        void CountFree(std::size_t size) noexcept
+        {
+            total_frees.fetch_add(1, std::memory_order_relaxed);
+            this_thread.frees++;
+            live_bytes.fetch_sub(size, std::memory_order_relaxed);
+        }
+
+        // The allocation size is stored before the returned pointer, along with the offset from the `malloc()`ed pointer.
+        struct Header
+        {
+            std::size_t size = 0;
+            std::size_t offset = 0;
+        };
+
+        [[nodiscard]] void *Allocate(std::size_t size, std::size_t alignment) noexcept
+        {
+            alignment = std::max(alignment, alignof(Header));
+            // The header goes right before the returned pointer, and the pointer must be aligned.
+            std::size_t extra = sizeof(Header) + alignment - 1;
+            unsigned char *raw = static_cast<unsigned char *>(std::malloc(size + extra));
+            if (!raw)
+                return nullptr;
+            unsigned char *ret = raw + sizeof(Header);
+            ret += (alignment - std::uintptr_t(ret) % alignment) % alignment;
+            new(ret - sizeof(Header)) Header{.size = size, .offset = std::size_t(ret - raw)};
+            CountAlloc(size);
+            return ret;
+        }
+
+        [[nodiscard]] void *AllocateOrThrow(std::size_t size, std::size_t alignment)
+        {
+            while (true)
+            {
+                if (void *ret = Allocate(size, alignment))
+                    return ret;
+                std::new_handler handler = std::get_new_handler();
+                if (!handler)
+                    throw std::bad_alloc{};
+                handler();
+            }
+        }
+
+        void Free(void *ptr) noexcept
+        {
+            if (!ptr)
+                return;
+            unsigned char *bytes = static_cast<unsigned char *>(ptr);
+            Header header = *reinterpret_cast<Header *>(bytes - sizeof(Header));
+            CountFree(header.size);
+            std::free(bytes - header.offset);
+        }
+    }
+
+    Counters Total()
+    {
+        return {
+            .allocs = total_allocs.load(std::memory_order_relaxed),
+            .frees = total_frees.load(std::memory_order_relaxed),
+            .bytes = total_bytes.load(std::memory_order_relaxed),
+        };
+    }
+
+    Counters ThisThread()
+    {
+        return this_thread;
+    }
+
+    std::size_t LiveBytes()
+    {
+        return live_bytes.load(std::memory_order_relaxed);
+    }
+
+    std::size_t PeakLiveBytes()
+    {
+        return peak_live_bytes.load(std::memory_order_relaxed);
+    }
+
+    std::size_t ResetPeakLiveBytes()
+    {
+        return peak_live_bytes.exchange(live_bytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    void AddExternalAlloc(std::size_t size) noexcept
+    {
+        CountAlloc(size);
+    }
+
+    void AddExternalFree(std::size_t size) noexcept
+    {
+        CountFree(size);
+    }
+    #else
+    Counters Total() {return {};}
+    Counters ThisThread() {return {};}
+    std::size_t LiveBytes() {return 0;}
+    std::size_t PeakLiveBytes() {return 0;}
+    std::size_t ResetPeakLiveBytes() {return 0;}
+    void AddExternalAlloc(std::size_t) noexcept {}
+    void AddExternalFree(std::size_t) noexcept {}
+    #endif
+}
+
+#ifdef IMP_COUNT_ALLOCATIONS
+// The array and `nothrow` forms call those by default.
+void *operator new(std::size_t size) {return Program::AllocStats::AllocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);}
+void *operator new(std::size_t size, std::align_val_t alignment) {return Program::AllocStats::AllocateOrThrow(size, std::size_t(alignment));}
+void operator delete(void *ptr) noexcept {Program::AllocStats::Free(ptr);}
+void operator delete(void *ptr, std::size_t) noexcept {Program::AllocStats::Free(ptr);}
+void operator delete(void *ptr, std::align_val_t) noexcept {Program::AllocStats::Free(ptr);}
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept {Program::AllocStats::Free(ptr);}
+#endif
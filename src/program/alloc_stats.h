@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Heap allocation counters.
+// They only count in the `count_allocs` build mode, which defines `IMP_COUNT_ALLOCATIONS` and replaces the global `operator new` and `operator delete`.
+// In other modes, all counters stay at zero.
+
+namespace Program::AllocStats
+{
+    #ifdef IMP_COUNT_ALLOCATIONS
+    inline constexpr bool enabled = true;
+    #else
+    inline constexpr bool enabled = false;
+    #endif
+
+    struct Counters
+    {
+        std::uint64_t allocs = 0;
+        std::uint64_t frees = 0;
+        std::uint64_t bytes = 0; // The total size of the allocations, ignoring the frees.
+
+        [[nodiscard]] friend Counters operator-(const Counters &a, const Counters &b)
+        {
+            return {.allocs = a.allocs - b.allocs, .frees = a.frees - b.frees, .bytes = a.bytes - b.bytes};
+        }
+    };
+
+    // The counters for all threads since the program start.
+    [[nodiscard]] Counters Total();
+    // The counters for the calling thread only. Use those to attribute the allocations to a piece of code.
+    [[nodiscard]] Counters ThisThread();
+
+    // The number of bytes currently allocated, for all threads.
+    [[nodiscard]] std::size_t LiveBytes();
+    // The max of `LiveBytes()` since the program start or since the last `ResetPeakLiveBytes()`.
+    [[nodiscard]] std::size_t PeakLiveBytes();
+    // Sets `PeakLiveBytes()` to the current `LiveBytes()`. Returns the old peak.
+    std::size_t ResetPeakLiveBytes();
+
+    // Count the memory that doesn't go through `operator new`, such as the pages mapped by `Storage::LargeBufferAllocator`.
+    // The free must have the same size as the allocation.
+    void AddExternalAlloc(std::size_t size) noexcept;
+    void AddExternalFree(std::size_t size) noexcept;
+}
@@ -17,10 +17,14 @@
 #  define IMP_DIAGNOSTICS_IGNORE_impl(value) _Pragma(#value)
 // Causes a function to always be inlined.
 #  define IMP_ALWAYS_INLINE __attribute__((__always_inline__))
+// For the functions that are rarely called, such as the error handlers. They are never inlined, are optimized for size,
+// and the branches leading to them are considered unlikely, so they stay out of the way of the hot code.
+#  define IMP_COLD __attribute__((__cold__, __noinline__))
 #else // MSVC.
 #  define IMP_DIAGNOSTICS_PUSH _Pragma("warning(push)")
 #  define IMP_DIAGNOSTICS_POP  _Pragma("warning(pop")
 #  define IMP_DIAGNOSTICS_IGNORE(id) IMP_DIAGNOSTICS_IGNORE_impl(warning(disable: id))
 #  define IMP_DIAGNOSTICS_IGNORE_impl(value) _Pragma(#value)
 #  define IMP_ALWAYS_INLINE __forceinline
+#  define IMP_COLD __declspec(noinline)
 #endif
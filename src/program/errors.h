@@ -3,37 +3,57 @@
 #include <stdexcept>
 #include <string_view>
 #include <string>
+#include <utility>
 
 #include "interface/messagebox.h"
+#include "program/compiler.h"
 #include "program/exit.h"
 #include "strings/format.h"
 
+// All error functions are `IMP_COLD`, so the message formatting is not inlined into the callers.
+
 namespace Program
 {
-    [[noreturn]] inline void HardError(const std::string &message)
+    namespace impl
+    {
+        inline void (*crash_callback)() = nullptr;
+    }
+
+    // Sets a function that the first `HardError()` calls before showing the message, to save diagnostics.
+    // So it runs on the crash signals and the uncaught exceptions (see `SetErrorHandlers()`), and on the failed assertions.
+    // It must not throw. Since it can run in a signal handler or while another thread is in the middle of something, it's best-effort.
+    inline void SetCrashCallback(void (*func)())
+    {
+        impl::crash_callback = func;
+    }
+
+    [[noreturn]] IMP_COLD inline void HardError(const std::string &message)
     {
         static bool first = true;
         if (!first)
             Exit(1);
         first = 0;
 
+        if (auto callback = std::exchange(impl::crash_callback, nullptr))
+            callback();
+
         Interface::MessageBox(Interface::MessageBoxType::error, "Error", "Error: " + message);
         Exit(1);
     }
 
-    [[noreturn]] inline void Error(const std::string &message) // Throws std::runtime_error.
+    [[noreturn]] IMP_COLD inline void Error(const std::string &message) // Throws std::runtime_error.
     {
         throw std::runtime_error(message);
     }
 
     template <typename ...P>
-    [[noreturn]] void HardError(const P &... params)
+    [[noreturn]] IMP_COLD void HardError(const P &... params)
     {
         HardError(Strings::Concat(params...));
     }
 
     template <typename ...P>
-    [[noreturn]] void Error(const P &... params)
+    [[noreturn]] IMP_COLD void Error(const P &... params)
     {
         Error(Strings::Concat(params...));
     }
@@ -43,13 +63,9 @@ namespace Program
 
     namespace impl
     {
-        // An assertion function.
-        // Making it constexpr allows us using it in compile-time contexts (as long as the condition is true, which is exactly the point).
-        inline constexpr void Assert(const char *context, const char *function, bool condition, std::string_view message_or_expr, const char *expr_or_nothing = nullptr)
+        // Reports a failed assertion. Kept separate from `Assert()`, so only the check itself is inlined.
+        [[noreturn]] IMP_COLD inline void AssertionFailed(const char *context, const char *function, std::string_view message_or_expr, const char *expr_or_nothing)
         {
-            if (condition)
-                return;
-
             if (expr_or_nothing)
             {
                 // User specified a custom message.
@@ -62,6 +78,14 @@ namespace Program
             }
         }
 
+        // An assertion function.
+        // Making it constexpr allows us using it in compile-time contexts (as long as the condition is true, which is exactly the point).
+        inline constexpr void Assert(const char *context, const char *function, bool condition, std::string_view message_or_expr, const char *expr_or_nothing = nullptr)
+        {
+            if (!condition)
+                AssertionFailed(context, function, message_or_expr, expr_or_nothing);
+        }
+
         // A template overload that allows using explicitly-but-not-implicitly-convertible-to-bool expressions as conditions.
         template <typename T>
         constexpr void Assert(const char *context, const char *function, const T &condition, std::string_view message_or_expr, const char *expr_or_nothing = nullptr)
@@ -0,0 +1,102 @@
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <cerrno>
+
+#include "program/platform.h"
+#include "utils/clock.h"
+
+#if IMP_PLATFORM_IS(windows)
+#include <windows.h>
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002 // Missing from the older headers.
+#endif
+#else
+#include <time.h>
+#endif
+
+namespace Program
+{
+    // The slack grows immediately to the largest overshoot, since waking up late causes a visible hitch, while spinning a bit longer is cheap.
+    // Then it slowly decays, by this fraction of the difference per sleep.
+    static constexpr double slack_decay = 1 / 32.;
+
+    // The initial slack, and the limits.
+    static constexpr double initial_slack_secs = 0.001, max_slack_secs = 0.016;
+
+    FramePacer::FramePacer()
+    {
+        slack = Clock::SecondsToTicks(initial_slack_secs);
+
+        #if IMP_PLATFORM_IS(windows)
+        timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (!timer)
+            timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS); // Before Windows 10 1803.
+        #endif
+    }
+
+    FramePacer::~FramePacer()
+    {
+        #if IMP_PLATFORM_IS(windows)
+        if (timer)
+            CloseHandle(timer);
+        #endif
+    }
+
+    void FramePacer::Sleep(std::uint64_t ticks)
+    {
+        double secs = Clock::TicksToSeconds(ticks);
+
+        #if IMP_PLATFORM_IS(windows)
+        if (timer)
+        {
+            LARGE_INTEGER due;
+            due.QuadPart = -std::max(std::int64_t(secs * 10'000'000), std::int64_t(1)); // Negative means relative, in 100 ns units.
+            if (SetWaitableTimer(timer, &due, 0, nullptr, nullptr, false))
+            {
+                WaitForSingleObject(timer, INFINITE);
+                return;
+            }
+        }
+        Clock::WaitSeconds(secs);
+        #else
+        timespec duration;
+        duration.tv_sec = time_t(secs);
+        duration.tv_nsec = long((secs - duration.tv_sec) * 1'000'000'000);
+        // If interrupted by a signal, we just return early. The caller checks the time and sleeps again.
+        (void)clock_nanosleep(CLOCK_MONOTONIC, 0, &duration, nullptr);
+        #endif
+    }
+
+    void FramePacer::AddMeasurement(std::int64_t overshoot)
+    {
+        double value = std::clamp(double(overshoot), 0., double(Clock::SecondsToTicks(max_slack_secs)));
+        if (value > slack)
+            slack = value;
+        else
+            slack += (value - slack) * slack_decay;
+    }
+
+    void FramePacer::WaitUntil(std::uint64_t target, std::int64_t extra_spin)
+    {
+        bool spin = extra_spin >= 0;
+        std::uint64_t early = std::uint64_t(slack) + (spin ? std::uint64_t(extra_spin) : 0);
+
+        while (true)
+        {
+            std::uint64_t now = Clock::Time();
+            if (now >= target || target - now <= early)
+                break;
+
+            std::uint64_t request = target - now - early;
+            Sleep(request);
+            AddMeasurement(std::int64_t(Clock::Time() - now) - std::int64_t(request));
+            early = std::uint64_t(slack) + (spin ? std::uint64_t(extra_spin) : 0);
+        }
+
+        if (spin)
+        {
+            while (Clock::Time() < target) {}
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+
+namespace Program
+{
+    // Waits until a specific moment, mostly sleeping instead of spinning, but without the imprecision of plain sleeping.
+    // It measures how much the OS sleeps overshoot, wakes up that much earlier, and spins for the rest.
+    // Uses a high-resolution waitable timer on Windows (falling back to a normal one on the old versions), and `clock_nanosleep()` elsewhere.
+    class FramePacer
+    {
+        void *timer = nullptr; // A Windows timer handle, if any.
+
+        // The estimated sleep overshoot, in clock ticks.
+        double slack = 0;
+
+        // Sleeps for approximately this amount of clock ticks.
+        void Sleep(std::uint64_t ticks);
+
+        // Updates `slack` after a sleep that took `overshoot` clock ticks longer than requested.
+        void AddMeasurement(std::int64_t overshoot);
+
+      public:
+        FramePacer();
+        FramePacer(const FramePacer &) = delete;
+        FramePacer &operator=(const FramePacer &) = delete;
+        ~FramePacer();
+
+        // Waits until `Clock::Time()` reaches `target`.
+        // `extra_spin` is added to the measured slack, in clock ticks. If it's negative, we don't spin at all, and can return slightly too early.
+        void WaitUntil(std::uint64_t target, std::int64_t extra_spin = 0);
+
+        // The current estimate of the sleep overshoot, in clock ticks.
+        [[nodiscard]] std::uint64_t Slack() const
+        {
+            return std::uint64_t(slack);
+        }
+    };
+}
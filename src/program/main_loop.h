@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <functional>
 #include <optional>
@@ -10,6 +11,7 @@
 
 #include "interface/window.h"
 #include "macros/finally.h"
+#include "program/frame_pacer.h"
 #include "utils/clock.h"
 #include "utils/metronome.h"
 
@@ -47,6 +49,58 @@ namespace Program
     {
         bool executing_frame = false;
         std::uint64_t frame_start = -1;
+        FramePacer frame_pacer;
+        int cached_fps_cap = 0;
+        std::uint64_t desired_frame_len = 0; // For `cached_fps_cap`, in clock ticks.
+        std::optional<std::uint32_t> tick_event_timestamp;
+
+        // For `EmulateAdaptiveVSync()`.
+        bool late_swap_active = false; // Vsync is temporarily disabled.
+        int late_swap_streak = 0; // The frames in a row that missed the vblank, or (while `late_swap_active`) that fit into the refresh interval with a margin.
+
+        // Updates `late_swap_active`, see `EmulateAdaptiveVSync()`.
+        // `frame_len` is the previous frame including the swap, `work_len` is this frame without the FPS cap delay. `refresh_interval` is zero if unknown.
+        void UpdateLateSwap(std::uint64_t frame_len, std::uint64_t work_len, std::uint64_t refresh_interval)
+        {
+            static constexpr int streak_to_disable_vsync = 3, streak_to_enable_vsync = 60;
+
+            Interface::Window window = Interface::Window::Get();
+            if (late_swap_active && window.VSyncMode() != Interface::VSync::disabled)
+                late_swap_active = false; // `SetVSyncMode()` was called in the meantime.
+
+            bool need_emulation = window.RequestedVSyncMode() == Interface::VSync::adaptive && (late_swap_active || window.VSyncMode() == Interface::VSync::enabled);
+            if (!need_emulation || refresh_interval == 0)
+            {
+                if (late_swap_active)
+                    window.OverrideVSyncMode(window.RequestedVSyncMode());
+                late_swap_active = false;
+                late_swap_streak = 0;
+                return;
+            }
+
+            if (!late_swap_active)
+            {
+                // With vsync, a frame that missed the vblank waits for the next one, so it takes about two intervals.
+                late_swap_streak = frame_len * 2 > refresh_interval * 3 ? late_swap_streak + 1 : 0;
+                if (late_swap_streak >= streak_to_disable_vsync)
+                {
+                    late_swap_active = true;
+                    late_swap_streak = 0;
+                    window.OverrideVSyncMode(Interface::VSync::disabled);
+                }
+            }
+            else
+            {
+                // The margin stops it from switching back and forth.
+                late_swap_streak = work_len * 4 < refresh_interval * 3 ? late_swap_streak + 1 : 0;
+                if (late_swap_streak >= streak_to_enable_vsync)
+                {
+                    late_swap_active = false;
+                    late_swap_streak = 0;
+                    window.OverrideVSyncMode(Interface::VSync::enabled);
+                }
+            }
+        }
 
       protected:
         bool stop = false;
@@ -68,14 +122,49 @@ namespace Program
         // which enables the cap only when vsync is disabled.
         virtual int GetFpsCap() {return 0;}
 
+        // What the loop does when the window is in the background, see `GetBackgroundPolicy()`.
+        struct BackgroundPolicy
+        {
+            // Don't render (and don't swap the buffers) while the window is minimized. The ticks continue.
+            bool skip_render_when_minimized = true;
+            // If positive, the FPS cap while the window is minimized or unfocused. It overrides `GetFpsCap()` if it's lower.
+            // Then the loop blocks waiting for events (up to the frame length) instead of sleeping or spinning, so the input wakes it up immediately.
+            int background_fps_cap = 0;
+        };
+        virtual BackgroundPolicy GetBackgroundPolicy() {return {};}
+
+        // If true and the driver doesn't support the adaptive vsync (the window fell back from the requested `adaptive` to `enabled`), the loop emulates it.
+        // When several frames in a row miss the vblank, it disables vsync and caps the FPS at the refresh rate instead, so the slow frames tear a bit
+        // instead of waiting for the next vblank (which would halve the FPS). When the frames fit into the refresh interval again, it enables vsync back.
+        virtual bool EmulateAdaptiveVSync() {return false;}
+
+        // True while `EmulateAdaptiveVSync()` has vsync disabled.
+        [[nodiscard]] bool LateSwapActive() const
+        {
+            return late_swap_active;
+        }
+
         // Ignored if FPS cap is disabled.
-        // FPS is capped by adding a delay after frames that are too short.
-        // The delay will be partially created using a `sleep` function, and partially using a busy loop.
-        // This function returns the preferred duration of the busy loop.
-        // If it returns -1, the busy loop will not be used. It lowers CPU load, but might make the timing less precise.
+        // FPS is capped by adding a delay after frames that are too short, see `FramePacer`.
+        // The delay is mostly created by sleeping, and the rest is a busy loop, as long as the measured imprecision of sleeping.
+        // This function returns the extra duration of the busy loop, on top of that.
+        // If it returns -1, the busy loop will not be used. It lowers CPU load, but makes the timing less precise.
         // If it returns 0, the busy loop will be used as little as possible.
-        // If it returns a large value, `sleep` will not be used at all, which increases CPU loads but improves precision.
-        virtual int GetFpsCapPreferredBusyLoopDurationMs() {return 1;}
+        // If it returns a large value, `sleep` will not be used at all, which increases CPU loads.
+        virtual int GetFpsCapPreferredBusyLoopDurationMs() {return 0;}
+
+        // Returns true if `Render()` should be called this frame. `num_ticks` is the number of ticks that were just performed.
+        // Override this to skip redrawing (and swapping the buffers) when nothing has changed, which saves GPU time and power.
+        // A typical override returns `num_ticks > 0`, plus a custom dirty flag if something can change outside of the ticks.
+        virtual bool ShouldRender(int num_ticks) {(void)num_ticks; return true;}
+
+        // During `Tick()`, returns the moment this tick corresponds to, as in `SDL_GetTicks()`. Pass this to `Window::ProcessEventsUntil()`.
+        // When several ticks run in one frame to catch up, the earlier ones correspond to the moments in the past, one tick length apart.
+        // Returns null for the last tick of the frame, meaning that it should see all remaining events.
+        [[nodiscard]] std::optional<std::uint32_t> TickEventTimestamp() const
+        {
+            return tick_event_timestamp;
+        }
 
         bool RunSingleFrame() override
         {
@@ -87,11 +176,31 @@ namespace Program
             // Load some basic config from state.
             auto *metronome = GetTickMetronome();
             auto fps_cap = GetFpsCap();
+            BackgroundPolicy background_policy = GetBackgroundPolicy();
+
+            bool emulate_vsync = EmulateAdaptiveVSync() && Interface::Window::IsOpen();
+            int refresh_rate = emulate_vsync ? Interface::Window::Get().RefreshRate() : 0;
+            if (late_swap_active && refresh_rate > 0)
+                fps_cap = refresh_rate; // Vsync is off, pace the frames ourselves.
+
+            // Check if the window is in the background.
+            bool minimized = false;
+            bool background = false;
+            if (Interface::Window::IsOpen())
+            {
+                Interface::Window window = Interface::Window::Get();
+                minimized = window.IsMinimized();
+                background = minimized || !window.HasKeyboardFocus();
+            }
+            bool background_cap = background && background_policy.background_fps_cap > 0 && (fps_cap <= 0 || background_policy.background_fps_cap < fps_cap);
+            if (background_cap)
+                fps_cap = background_policy.background_fps_cap;
+
             bool have_fps_cap = fps_cap > 0;
 
             // Compute timings if needed.
             std::uint64_t delta = 0;
-            if (metronome || have_fps_cap)
+            if (metronome || have_fps_cap || emulate_vsync)
             {
                 std::uint64_t new_frame_start = Clock::Time();
 
@@ -105,50 +214,65 @@ namespace Program
             BeginFrame();
 
             // Tick.
+            int num_ticks = 0;
             if (metronome)
             {
+                std::uint32_t frame_start_timestamp = SDL_GetTicks();
+                FINALLY( tick_event_timestamp = {}; )
+
                 while (metronome->Tick(delta))
+                {
+                    // `Time()` is now the number of ticks to run after this one, possibly fractional.
+                    double ticks_left = metronome->Time();
+                    if (ticks_left < 1)
+                        tick_event_timestamp = {};
+                    else
+                        tick_event_timestamp = frame_start_timestamp - std::uint32_t(ticks_left * metronome->ClockTicksPerTick() * 1000 / Clock::TicksPerSecond());
+
+                    std::uint64_t tick_start = Clock::Time();
                     Tick();
+                    metronome->AddTickCost(Clock::Time() - tick_start);
+                    num_ticks++;
+                }
             }
             else
             {
                 Tick();
+                num_ticks++;
             }
 
             // Render.
-            Render();
+            if (!(minimized && background_policy.skip_render_when_minimized) && ShouldRender(num_ticks))
+                Render();
+            else if (!have_fps_cap)
+                SDL_Delay(1); // Without the FPS cap, the loop is normally paced by vsync in `Render()`, so don't spin.
 
             // End frame.
             EndFrame();
 
+            if (emulate_vsync)
+                UpdateLateSwap(delta, Clock::Time() - frame_start, refresh_rate > 0 ? Clock::TicksPerSecond() / refresh_rate : 0);
+
             // Cap FPS.
             if (have_fps_cap)
             {
-                std::uint64_t clock_ticks_per_sec = Clock::TicksPerSecond();
-                std::uint64_t desired_frame_len = 1.0 / fps_cap * clock_ticks_per_sec;
-                std::uint64_t frame_end = Clock::Time(), frame_len = frame_end - frame_start;
-
-                // If necessary, add a delay.
-                if (frame_len < desired_frame_len)
+                if (fps_cap != cached_fps_cap)
                 {
-                    int sleep_ms = (desired_frame_len - frame_len) * 1000 / clock_ticks_per_sec;
-
-                    auto busy_loop_len_ms = GetFpsCapPreferredBusyLoopDurationMs();
-                    bool busy_loop_allowed = busy_loop_len_ms >= 0;
-
-                    if (busy_loop_allowed)
-                        sleep_ms -= busy_loop_len_ms;
-
-                    // Sleep.
-                    if (sleep_ms > 0)
-                        SDL_Delay(sleep_ms);
+                    cached_fps_cap = fps_cap;
+                    desired_frame_len = Clock::TicksPerSecond() / fps_cap;
+                }
 
-                    // Busy loop.
-                    if (busy_loop_allowed)
-                    {
-                        std::uint64_t busy_loop_end = frame_start + desired_frame_len;
-                        while (Clock::Time() < busy_loop_end) {}
-                    }
+                if (background_cap)
+                {
+                    std::uint64_t frame_end = frame_start + desired_frame_len;
+                    std::uint64_t now = Clock::Time();
+                    if (now < frame_end)
+                        Interface::Window::WaitForEvents(std::max(1, int(Clock::TicksToSeconds(frame_end - now) * 1000)));
+                }
+                else
+                {
+                    int busy_loop_len_ms = GetFpsCapPreferredBusyLoopDurationMs();
+                    frame_pacer.WaitUntil(frame_start + desired_frame_len, busy_loop_len_ms < 0 ? -1 : Clock::SecondsToTicks(busy_loop_len_ms / 1000.));
                 }
             }
 
@@ -202,6 +202,12 @@ namespace Refl
         // that all nested objects have this flag set too), otherwise conversion to string can yield weird results.
         template <typename T, typename = void>
         struct HasShortStringRepresentation : std::false_type {};
+
+        // Set this to `true` for the types whose binary representation is exactly their object representation.
+        // Then the structs and the contiguous containers of them are read and written with a single copy, instead of per member.
+        // Don't set this for the types with invalid object representations (such as `bool`), since those would be read without validation.
+        template <typename T, typename = void>
+        struct BinaryMatchesMemory : std::false_type {};
     }
 
 
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <functional>
+#include <iterator>
 #include <tuple>
 #include <type_traits>
 #include <utility>
@@ -10,6 +13,7 @@
 #include "meta/common.h"
 #include "program/errors.h"
 #include "reflection/interface_basic.h"
+#include "reflection/interface_scalar.h"
 #include "utils/robust_math.h"
 
 namespace Refl
@@ -138,12 +142,27 @@ namespace Refl
             }
         }
 
-        void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state) const override
+      protected:
+        static void WriteBinaryLength(std::size_t size, Stream::Output &output)
         {
             impl::container_length_binary_t len;
-            if (Robust::conversion_fails(object.size(), len))
+            if (Robust::conversion_fails(size, len))
                 Program::Error(output.GetExceptionPrefix() + "The container is too long.");
             output.WriteWithByteOrder<impl::container_length_binary_t>(impl::container_length_byte_order, len);
+        }
+
+        [[nodiscard]] static std::size_t ReadBinaryLength(Stream::Input &input)
+        {
+            std::size_t len;
+            if (Robust::conversion_fails(input.ReadWithByteOrder<impl::container_length_binary_t>(impl::container_length_byte_order), len))
+                Program::Error(input.GetExceptionPrefix() + "The container is too long.");
+            return len;
+        }
+
+      public:
+        void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state) const override
+        {
+            WriteBinaryLength(Size(object), output);
 
             auto next_state = state.MemberOrElem(options);
 
@@ -155,9 +174,7 @@ namespace Refl
 
         void FromBinary(T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state) const override
         {
-            std::size_t len;
-            if (Robust::conversion_fails(input.ReadWithByteOrder<impl::container_length_binary_t>(impl::container_length_byte_order), len))
-                Program::Error(input.GetExceptionPrefix() + "The string is too long.");
+            std::size_t len = ReadBinaryLength(input);
 
             std::size_t max_reserved_elems = options.max_reserved_size / sizeof(elem_t);
 
@@ -206,6 +223,11 @@ namespace Refl
             std::enable_if_t<std::is_reference_v<decltype(*std::declval<T &>().begin())>>()
         );
 
+        template <typename T> using has_data_and_resize = decltype(
+            void(std::declval<T &>().resize(std::size_t{})),
+            std::enable_if_t<std::is_same_v<decltype(std::declval<T &>().data()), typename ContainerElem<T>::type *>>()
+        );
+
         // Check if a type looks like a container.
         // It has to have sane `begin()` and `end()`, and either `push_back` or single-arg `insert` (so only variable-length arrays are allowed).
         template <typename T> inline constexpr bool is_container =
@@ -215,10 +237,68 @@ namespace Refl
     template <typename T>
     class Interface_StdContainer final : public Interface_BasicContainer<T>
     {
+        using Base = Interface_BasicContainer<T>;
+
         static constexpr bool has_push_back = Meta::is_detected<impl::StdContainer::has_push_back, T>;
 
       public:
-        using typename Interface_BasicContainer<T>::elem_t;
+        using typename Base::elem_t;
+
+      private:
+        // If true, the elements are scalars that need a byte order conversion (on a big-endian machine). They're converted in bulk too.
+        static constexpr bool binary_as_scalars = std::is_arithmetic_v<elem_t> && !std::is_same_v<elem_t, bool> && !impl::BinaryMatchesMemory<elem_t>::value;
+
+        // If true, the elements are read and written with a single copy (plus the byte order conversion, if `binary_as_scalars`).
+        static constexpr bool binary_as_bytes = []{
+            if constexpr (Meta::is_detected<impl::StdContainer::has_data_and_resize, T>)
+                return std::contiguous_iterator<impl::StdContainer::iter_t<T>> && (impl::BinaryMatchesMemory<elem_t>::value || binary_as_scalars);
+            else
+                return false;
+        }();
+
+      public:
+        void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state) const override
+        {
+            if constexpr (binary_as_bytes)
+            {
+                Base::WriteBinaryLength(object.size(), output);
+                if constexpr (binary_as_scalars)
+                    output.WriteWithByteOrder<elem_t>(impl::scalar_byte_order, object.data(), object.size());
+                else
+                    output.WriteBytes(reinterpret_cast<const std::uint8_t *>(object.data()), object.size() * sizeof(elem_t));
+            }
+            else
+            {
+                Base::ToBinary(object, output, options, state);
+            }
+        }
+
+        void FromBinary(T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state) const override
+        {
+            if constexpr (binary_as_bytes)
+            {
+                std::size_t len = Base::ReadBinaryLength(input);
+                Clear(object);
+
+                // Grow in steps of `max_reserved_size`, so that a malformed length can't allocate too much memory before the input runs out.
+                std::size_t max_step = std::max(std::size_t(1), options.max_reserved_size / sizeof(elem_t));
+                std::size_t done = 0;
+                while (done < len)
+                {
+                    std::size_t step = std::min(len - done, max_step);
+                    object.resize(done + step);
+                    if constexpr (binary_as_scalars)
+                        input.ReadWithByteOrder(impl::scalar_byte_order, object.data() + done, step);
+                    else
+                        input.Read(reinterpret_cast<std::uint8_t *>(object.data() + done), step * sizeof(elem_t));
+                    done += step;
+                }
+            }
+            else
+            {
+                Base::FromBinary(object, input, options, state);
+            }
+        }
 
         [[nodiscard]] virtual std::size_t Size(const T &object) const override
         {
@@ -1,14 +1,15 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <cstddef>
 #include <cstring>
-#include <initializer_list>
 #include <type_traits>
-#include <vector>
 
 #include "macros/generated.h"
 #include "macros/named_macro_parameters.h"
 #include "meta/common.h"
+#include "meta/constexpr_hash.h"
 #include "program/errors.h"
 #include "reflection/interface_basic.h"
 #include "reflection/interface_scalar.h"
@@ -23,47 +24,38 @@ namespace Refl
         {
             T value = {};
             const char *name = nullptr;
-
-            bool operator<(const ValueNamePair &other) const
-            {
-                using underlying = std::underlying_type_t<T>;
-                return underlying(value) < underlying(other.value);
-            }
-        };
-
-        template <typename T>
-        struct NameValuePair
-        {
-            const char *name = {};
-            T value = nullptr;
-
-            bool operator<(const NameValuePair &other) const
-            {
-                return std::strcmp(name, other.name) < 0;
-            }
         };
 
         // Contains metadata related to a single enum.
-        template <typename T>
+        // `N` is the number of enumerators. This is constructed at compile-time by `REFL_ENUM_METADATA`.
+        template <typename T, std::size_t N>
         class Helper
         {
             using underlying = std::underlying_type_t<T>;
 
-            std::vector<ValueNamePair<T>> values_to_names;
-            std::vector<NameValuePair<T>> names_to_values;
+            std::array<ValueNamePair<T>, N> values_to_names{}; // Sorted by value.
+            std::array<ValueNamePair<T>, N> names_to_values{}; // In the declaration order, indexed by `name_hash`.
+            Meta::PerfectHash<N> name_hash;
             bool is_relaxed = false;
 
-          public:
-            Helper(std::initializer_list<ValueNamePair<T>> list, bool is_relaxed)
-                : is_relaxed(is_relaxed)
+            [[nodiscard]] static constexpr std::array<const char *, N> GetNames(const ValueNamePair<T> (&list)[N])
             {
-                values_to_names = std::vector<ValueNamePair<T>>(list.begin(), list.end());
-                std::sort(values_to_names.begin(), values_to_names.end());
+                std::array<const char *, N> ret{};
+                for (std::size_t i = 0; i < N; i++)
+                    ret[i] = list[i].name;
+                return ret;
+            }
 
-                names_to_values.reserve(list.size());
-                for (const auto &elem : list)
-                    names_to_values.push_back({elem.name, elem.value});
-                std::sort(names_to_values.begin(), names_to_values.end());
+          public:
+            constexpr Helper(const ValueNamePair<T> (&list)[N], bool is_relaxed)
+                : name_hash(GetNames(list)), is_relaxed(is_relaxed)
+            {
+                for (std::size_t i = 0; i < N; i++)
+                    values_to_names[i] = names_to_values[i] = list[i];
+                std::sort(values_to_names.begin(), values_to_names.end(), [](const ValueNamePair<T> &a, const ValueNamePair<T> &b)
+                {
+                    return underlying(a.value) < underlying(b.value);
+                });
             }
 
             Helper(const Helper &) = delete;
@@ -80,8 +72,10 @@ namespace Refl
             // Returns nullptr on failure.
             const char *ValueToName(T value) const
             {
-                ValueNamePair<T> dummy{value, nullptr};
-                auto it = std::lower_bound(values_to_names.begin(), values_to_names.end(), dummy);
+                auto it = std::lower_bound(values_to_names.begin(), values_to_names.end(), value, [](const ValueNamePair<T> &a, T b)
+                {
+                    return underlying(a.value) < underlying(b);
+                });
                 if (it == values_to_names.end() || it->value != value)
                     return nullptr;
                 return it->name;
@@ -90,9 +84,8 @@ namespace Refl
             // Returns T{} on failure. If `ok` is not null, it's set to true on success or to false on failure.
             T NameToValue(const char *name, bool *ok = nullptr) const
             {
-                NameValuePair<T> dummy{name, {}};
-                auto it = std::lower_bound(names_to_values.begin(), names_to_values.end(), dummy);
-                if (it == names_to_values.end() || std::strcmp(it->name, name) != 0)
+                std::size_t index = name_hash.Find(name);
+                if (index == std::size_t(-1) || std::strcmp(names_to_values[index].name, name) != 0)
                 {
                     if (ok)
                         *ok = false;
@@ -100,10 +93,16 @@ namespace Refl
                 }
                 if (ok)
                     *ok = true;
-                return it->value;
+                return names_to_values[index].value;
             }
         };
 
+        template <typename T, std::size_t N>
+        [[nodiscard]] constexpr Helper<T, N> MakeHelper(const ValueNamePair<T> (&list)[N], bool is_relaxed)
+        {
+            return Helper<T, N>(list, is_relaxed);
+        }
+
         void zrefl_EnumHelper() = delete; // Dummy ADL target.
 
         template <typename T>
@@ -283,7 +282,7 @@ namespace Refl
     const auto &zrefl_EnumHelper(name_) \
     { \
         using t [[maybe_unused]] = name_; \
-        static ::Refl::impl::Enum::Helper<name_> ret({ REFL_ENUM_impl_pair_loop(seq_) }, MA_IF_NOT_EMPTY_ELSE(true, false, is_relaxed_if_not_empty_)); \
+        static constexpr auto ret = ::Refl::impl::Enum::MakeHelper<name_>({ REFL_ENUM_impl_pair_loop(seq_) }, MA_IF_NOT_EMPTY_ELSE(true, false, is_relaxed_if_not_empty_)); \
         return ret; \
     }
 
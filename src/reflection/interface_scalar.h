@@ -79,4 +79,8 @@ namespace Refl
 
     template <typename T>
     struct impl::HasShortStringRepresentation<T, std::enable_if_t<std::is_arithmetic_v<T>>> : std::true_type {};
+
+    template <typename T>
+    struct impl::BinaryMatchesMemory<T, std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>>>
+        : std::bool_constant<ByteOrder::native == impl::scalar_byte_order> {};
 }
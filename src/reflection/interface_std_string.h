@@ -26,7 +26,7 @@ namespace Refl
                 flags = flags | Strings::EscapeFlags::multiline;
 
             output.WriteByte('"');
-            Strings::Escape(object, output.GetOutputIterator(), flags);
+            Strings::Escape(object, [&](std::string_view part){output.WriteString(part.data(), part.size());}, flags);
             output.WriteByte('"');
         }
 
@@ -79,10 +79,17 @@ namespace Refl
             if (Robust::conversion_fails(input.ReadWithByteOrder<impl::container_length_binary_t>(impl::container_length_byte_order), len))
                 Program::Error(input.GetExceptionPrefix() + "The string is too long.");
 
+            // Grow in steps of `max_reserved_size`, so that a malformed length can't allocate too much memory before the input runs out.
             object = {};
-            object.reserve(len < options.max_reserved_size ? len : options.max_reserved_size);
-            while (len-- > 0)
-                object += input.ReadChar();
+            std::size_t max_step = options.max_reserved_size > 0 ? options.max_reserved_size : 1;
+            std::size_t done = 0;
+            while (done < len)
+            {
+                std::size_t step = len - done < max_step ? len - done : max_step;
+                object.resize(done + step);
+                input.Read(object.data() + done, step);
+                done += step;
+            }
         }
     };
 
@@ -4,6 +4,7 @@
 #include <array>
 #include <cctype>
 #include <cstddef>
+#include <cstdint>
 #include <exception>
 #include <string_view>
 #include <type_traits>
@@ -74,6 +75,42 @@ namespace Refl
     template <typename T>
     struct StructCallbacks : DefaultStructCallbacks<T> {};
 
+    namespace impl::Class
+    {
+        // Returns true if `StructCallbacks<T>` don't do anything.
+        template <typename T>
+        constexpr bool HasDefaultCallbacks()
+        {
+            using A = StructCallbacks<T>;
+            using B = DefaultStructCallbacks<T>;
+            return &A::PreSerialize == &B::PreSerialize && &A::PostSerialize == &B::PostSerialize && &A::PreDeserialize == &B::PreDeserialize && &A::PostDeserialize == &B::PostDeserialize;
+        }
+
+        // Returns true if the binary representation of the struct matches its object representation.
+        // That's when the members are in memory order with no padding, are not skipped, and match their own object representations.
+        template <typename T>
+        constexpr bool StructBinaryMatchesMemory()
+        {
+            if constexpr (!std::is_trivially_copyable_v<T> || !Refl::Class::members_in_memory_order<T> || Meta::list_size<Refl::Class::combined_bases<T>> > 0 || !HasDefaultCallbacks<T>())
+            {
+                return false;
+            }
+            else
+            {
+                bool ok = true;
+                std::size_t size = 0;
+                Meta::cexpr_for<Refl::Class::member_count<T>>([&](auto index)
+                {
+                    using type = Refl::Class::member_type<T, index.value>;
+                    if (skip_member<type> || !BinaryMatchesMemory<std::remove_const_t<type>>::value)
+                        ok = false;
+                    size += sizeof(type);
+                });
+                return ok && size == sizeof(T);
+            }
+        }
+    }
+
     template <typename T>
     class Interface_Struct : public InterfaceBasic<T>
     {
@@ -453,6 +490,14 @@ namespace Refl
 
         void ToBinary(const T &object, Stream::Output &output, const ToBinaryOptions &options, impl::ToBinaryState state) const override
         {
+            if constexpr (impl::BinaryMatchesMemory<T>::value)
+            {
+                (void)options;
+                (void)state;
+                output.WriteBytes(reinterpret_cast<const std::uint8_t *>(&object), sizeof(T));
+                return;
+            }
+
             // Initial callback.
             try
             {
@@ -516,6 +561,14 @@ namespace Refl
 
         void FromBinary(T &object, Stream::Input &input, const FromBinaryOptions &options, impl::FromBinaryState state) const override
         {
+            if constexpr (impl::BinaryMatchesMemory<T>::value)
+            {
+                (void)options;
+                (void)state;
+                input.Read(reinterpret_cast<std::uint8_t *>(&object), sizeof(T));
+                return;
+            }
+
             // Initial callback.
             try
             {
@@ -584,6 +637,9 @@ namespace Refl
         using type = Interface_Struct<T>;
     };
 
+    template <typename T>
+    struct impl::BinaryMatchesMemory<T, std::enable_if_t<Class::members_known<T>>> : std::bool_constant<impl::Class::StructBinaryMatchesMemory<T>()> {};
+
     template <typename T>
     struct impl::HasShortStringRepresentation<T, std::enable_if_t<Class::members_known<T>>>
     {
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <array>
+#include <concepts>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <ranges>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "meta/common.h"
+#include "meta/lists.h"
+#include "reflection/structs.h"
+#include "utils/multiarray.h"
+#include "utils/padded_array.h"
+
+// Estimates how much memory the objects hold, for the memory reports and the capacity planning.
+// `EstimateMemory(x)` is `sizeof x` plus `EstimateOwnedMemory(x)`, which is everything allocated by the object: the capacity of the containers, recursively.
+// Understands the standard containers, `std::optional`, the smart pointers, `MultiArray`, `PaddedArray2D`, the vector-like classes with `capacity()`,
+// and the reflected structs (member by member, including the bases). The other trivially copyable types own nothing.
+// The rest need a hook: either a member `[[nodiscard]] std::size_t EstimateOwnedMemory() const`, or a specialization of `Refl::Custom::OwnedMemory`.
+// The GPU and audio objects use the hooks to report the driver memory, so it's counted too.
+// The allocator overhead isn't counted, and the node sizes of `std::deque` and the associative containers are guesses (based on libstdc++).
+// A `std::shared_ptr` counts the whole pointee, even if it's shared with other objects.
+
+namespace Refl
+{
+    namespace Custom
+    {
+        // Specialize to add the types that can't have a member `EstimateOwnedMemory()`.
+        // Must have `[[nodiscard]] static std::size_t Estimate(const T &object)`, which doesn't include `sizeof(T)`.
+        template <typename T>
+        struct OwnedMemory {};
+    }
+
+    template <typename T>
+    [[nodiscard]] std::size_t EstimateOwnedMemory(const T &object);
+
+    // The size of the object itself, plus `EstimateOwnedMemory()`.
+    template <typename T>
+    [[nodiscard]] std::size_t EstimateMemory(const T &object)
+    {
+        return sizeof(T) + EstimateOwnedMemory(object);
+    }
+
+    namespace impl::MemoryUsage
+    {
+        template <typename T>
+        concept has_member_hook = requires(const T &object)
+        {
+            {object.EstimateOwnedMemory()} -> std::convertible_to<std::size_t>;
+        };
+
+        template <typename T>
+        concept has_custom_hook = requires(const T &object)
+        {
+            {Custom::OwnedMemory<T>::Estimate(object)} -> std::convertible_to<std::size_t>;
+        };
+
+        template <typename T>
+        concept bool_vector = Meta::specialization_of<T, std::vector> && std::is_same_v<typename T::value_type, bool>;
+
+        // `std::vector` and the similar classes, such as `SmallVector`.
+        template <typename T>
+        concept vector_like = std::ranges::contiguous_range<T> && requires(const T &object)
+        {
+            typename T::value_type;
+            {object.capacity()} -> std::convertible_to<std::size_t>;
+        };
+
+        template <typename T>
+        concept associative = std::ranges::range<T> && requires{typename T::key_type;};
+        template <typename T>
+        concept unordered = associative<T> && requires(const T &object){object.bucket_count();};
+
+        // What libstdc++ uses.
+        inline constexpr std::size_t deque_block_bytes = 512;
+        // The pointers and the color of a tree node, or the next pointer and the cached hash of a hash node.
+        inline constexpr std::size_t node_overhead_bytes = sizeof(void *) * 4;
+    }
+
+    namespace Custom
+    {
+        template <int D, typename T, typename A>
+        struct OwnedMemory<MultiArray<D, T, A>>
+        {
+            [[nodiscard]] static std::size_t Estimate(const MultiArray<D, T, A> &object)
+            {
+                // The storage is allocated with the exact size.
+                std::size_t ret = std::size_t(object.element_count()) * sizeof(T);
+                if constexpr (!std::is_trivially_copyable_v<T> || impl::MemoryUsage::has_member_hook<T> || impl::MemoryUsage::has_custom_hook<T>)
+                {
+                    const T *elems = object.elements();
+                    for (std::ptrdiff_t i = 0; i < object.element_count(); i++)
+                        ret += EstimateOwnedMemory(elems[i]);
+                }
+                return ret;
+            }
+        };
+
+        template <typename T>
+        struct OwnedMemory<PaddedArray2D<T>>
+        {
+            // The elements are in a private `Array2D`, which isn't visited, so they can't own anything.
+            static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable elements are supported.");
+
+            [[nodiscard]] static std::size_t Estimate(const PaddedArray2D<T> &object)
+            {
+                return std::size_t((object.size() + object.border() * 2).prod()) * sizeof(T);
+            }
+        };
+    }
+
+    namespace impl::MemoryUsage
+    {
+        // Sums `EstimateOwnedMemory()` of the elements.
+        template <typename T>
+        [[nodiscard]] std::size_t ElementsOwnedMemory(const T &range)
+        {
+            using elem_t = std::remove_cvref_t<std::ranges::range_value_t<T>>;
+            if constexpr (std::is_trivially_copyable_v<elem_t> && !has_member_hook<elem_t> && !has_custom_hook<elem_t>)
+            {
+                return 0;
+            }
+            else
+            {
+                std::size_t ret = 0;
+                for (const auto &elem : range)
+                    ret += EstimateOwnedMemory(elem);
+                return ret;
+            }
+        }
+
+        // The members of a reflected struct, not including the bases.
+        template <typename T>
+        [[nodiscard]] std::size_t MembersOwnedMemory(const T &object)
+        {
+            std::size_t ret = 0;
+            Meta::cexpr_for<Refl::Class::member_count<T>>([&](auto index)
+            {
+                ret += EstimateOwnedMemory(Refl::Class::Member<index.value>(object));
+            });
+            return ret;
+        }
+    }
+
+    template <typename T>
+    [[nodiscard]] std::size_t EstimateOwnedMemory(const T &object)
+    {
+        using namespace impl::MemoryUsage;
+
+        if constexpr (has_member_hook<T>)
+        {
+            return object.EstimateOwnedMemory();
+        }
+        else if constexpr (has_custom_hook<T>)
+        {
+            return Custom::OwnedMemory<T>::Estimate(object);
+        }
+        else if constexpr (Meta::specialization_of<T, std::basic_string>)
+        {
+            // The short strings are stored inline.
+            return object.capacity() > T().capacity() ? (object.capacity() + 1) * sizeof(typename T::value_type) : 0;
+        }
+        else if constexpr (bool_vector<T>)
+        {
+            return (object.capacity() + 7) / 8; // Packed.
+        }
+        else if constexpr (vector_like<T>)
+        {
+            std::size_t ret = ElementsOwnedMemory(object);
+            if constexpr (requires{T::inline_capacity();})
+            {
+                if (object.capacity() <= T::inline_capacity())
+                    return ret;
+            }
+            return ret + object.capacity() * sizeof(typename T::value_type);
+        }
+        else if constexpr (Meta::specialization_of<T, std::deque>)
+        {
+            constexpr std::size_t elems_per_block = sizeof(typename T::value_type) < deque_block_bytes ? deque_block_bytes / sizeof(typename T::value_type) : 1;
+            std::size_t num_blocks = object.size() / elems_per_block + 1;
+            // The blocks, and the array of pointers to them, which has some spare space on both sides.
+            return ElementsOwnedMemory(object) + num_blocks * elems_per_block * sizeof(typename T::value_type) + (num_blocks + 2) * sizeof(void *);
+        }
+        else if constexpr (associative<T>)
+        {
+            std::size_t ret = ElementsOwnedMemory(object) + object.size() * (sizeof(typename T::value_type) + node_overhead_bytes);
+            if constexpr (unordered<T>)
+                ret += object.bucket_count() * sizeof(void *);
+            return ret;
+        }
+        else if constexpr (Meta::specialization_of<T, std::optional>)
+        {
+            return object ? EstimateOwnedMemory(*object) : 0;
+        }
+        else if constexpr (Meta::specialization_of<T, std::unique_ptr> || Meta::specialization_of<T, std::shared_ptr>)
+        {
+            return object ? EstimateMemory(*object) : 0;
+        }
+        else if constexpr (Meta::specialization_of<T, std::pair> || Meta::specialization_of<T, std::tuple>)
+        {
+            return std::apply([](const auto &... elems){return (std::size_t(0) + ... + EstimateOwnedMemory(elems));}, object);
+        }
+        else if constexpr (Class::members_known<T>)
+        {
+            // All the bases, each one once, and then the own members.
+            using bases = Meta::list_cat_types<Class::recursive_regular_bases<T>, Class::virtual_bases<T>>;
+            std::size_t ret = 0;
+            Meta::cexpr_for<Meta::list_size<bases>>([&](auto index)
+            {
+                ret += MembersOwnedMemory(static_cast<const Meta::list_type_at<bases, index.value> &>(object));
+            });
+            return ret + MembersOwnedMemory(object);
+        }
+        else if constexpr (std::is_trivially_copyable_v<T>)
+        {
+            return 0; // This also covers the arrays of those.
+        }
+        else if constexpr (std::is_array_v<T> || requires{std::tuple_size<T>::value;}) // Or `std::array`.
+        {
+            return ElementsOwnedMemory(object);
+        }
+        else
+        {
+            static_assert(Meta::value<false, T>, "Don't know how much memory this type owns. Add `EstimateOwnedMemory()` to it, or specialize `Refl::Custom::OwnedMemory`.");
+            return 0;
+        }
+    }
+}
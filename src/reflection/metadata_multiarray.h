@@ -6,19 +6,19 @@
 #include "reflection/interface_struct.h"
 #include "utils/multiarray.h"
 
-template <int D, typename T> struct MultiArray<D, T>::ReflHelper
+template <int D, typename T, typename A> struct MultiArray<D, T, A>::ReflHelper
 {
-    static auto &GetSizeVec(MultiArray<D, T> &array)
+    static auto &GetSizeVec(MultiArray<D, T, A> &array)
     {
         return array.size_vec;
     }
 
-    static auto &GetStorage(MultiArray<D, T> &array)
+    static auto &GetStorage(MultiArray<D, T, A> &array)
     {
         return array.storage;
     }
 
-    static void CheckInvariant(const MultiArray<D, T> &object)
+    static void CheckInvariant(const MultiArray<D, T, A> &object)
     {
         if ((object.size_vec < 0).any())
             Program::Error("Multiarray can't have a negative size.");
@@ -30,32 +30,32 @@ template <int D, typename T> struct MultiArray<D, T>::ReflHelper
 
 namespace Refl::Class::Custom
 {
-    template <int D, typename T> struct name<MultiArray<D, T>>
+    template <int D, typename T, typename A> struct name<MultiArray<D, T, A>>
     {
         static constexpr const char *value = "MultiArray";
     };
-    template <int D, typename T> struct members<MultiArray<D, T>>
+    template <int D, typename T, typename A> struct members<MultiArray<D, T, A>>
     {
         static constexpr std::size_t count = 2;
-        template <std::size_t I> static constexpr auto &at(MultiArray<D, T> &object)
+        template <std::size_t I> static constexpr auto &at(MultiArray<D, T, A> &object)
         {
             if constexpr (I == 0)
-                return MultiArray<D, T>::ReflHelper::GetSizeVec(object);
+                return MultiArray<D, T, A>::ReflHelper::GetSizeVec(object);
             else
-                return MultiArray<D, T>::ReflHelper::GetStorage(object);
+                return MultiArray<D, T, A>::ReflHelper::GetStorage(object);
         }
     };
 }
 
-template <int D, typename T>
-struct Refl::StructCallbacks<MultiArray<D, T>> : Refl::DefaultStructCallbacks<MultiArray<D, T>>
+template <int D, typename T, typename A>
+struct Refl::StructCallbacks<MultiArray<D, T, A>> : Refl::DefaultStructCallbacks<MultiArray<D, T, A>>
 {
-    static void PreSerialize(const MultiArray<D, T> &object)
+    static void PreSerialize(const MultiArray<D, T, A> &object)
     {
-        MultiArray<D, T>::ReflHelper::CheckInvariant(object);
+        MultiArray<D, T, A>::ReflHelper::CheckInvariant(object);
     }
-    static void PostDeserialize(MultiArray<D, T> &object)
+    static void PostDeserialize(MultiArray<D, T, A> &object)
     {
-        MultiArray<D, T>::ReflHelper::CheckInvariant(object);
+        MultiArray<D, T, A>::ReflHelper::CheckInvariant(object);
     }
 };
@@ -279,6 +279,22 @@ namespace Refl
                 }
             };
 
+            // Provides information on whether the members (as listed by `members`) are laid out in memory in this order, one after the other.
+            // If they also have no padding between them, the struct can be serialized in bulk. See `Refl::impl::BinaryMatchesMemory`.
+            template <typename T, typename Void = void> struct members_in_memory_order
+            {
+                static_assert(std::is_void_v<Void>);
+                static constexpr bool value = false;
+            };
+            template <typename T> struct members_in_memory_order<T, Meta::void_type<Macro::member_ptrs<T>>>
+            {
+                static constexpr bool value = true; // The macros declare the members in the order they're listed.
+            };
+            template <typename M, std::size_t N> struct members_in_memory_order<M[N]>
+            {
+                static constexpr bool value = true;
+            };
+
             // Provides information on whether or not a class is explicitly declared as polymorphic (normally using `REFL_POLYMORPHIC`).
             template <typename T, typename Void = void> struct explicitly_polymorphic
             {
@@ -333,6 +349,9 @@ namespace Refl
             return Custom::member_names<std::remove_const_t<T>>::at(i);
         }
 
+        // Whether `Member<I>()` are laid out in memory in the order of `I`. Note that there can still be padding between them.
+        template <typename T> inline constexpr bool members_in_memory_order = Custom::members_in_memory_order<std::remove_const_t<T>>::value;
+
         // Check for presence of `REFL_POLYMORPHIC` on a class.
         template <typename T> inline constexpr bool explicitly_polymorphic = Custom::explicitly_polymorphic<std::remove_const_t<T>>::value;
 
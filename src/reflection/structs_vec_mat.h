@@ -23,6 +23,12 @@ namespace Refl::Class::Custom
         }
     };
 
+    template <int D, typename M> struct members_in_memory_order<Math::vec<D, M>>
+    {
+        static constexpr bool value = true;
+    };
+
+    // Not `members_in_memory_order`, since the matrices are stored by columns, but their members are listed by rows.
     template <int W, int H, typename M> struct name<Math::mat<W, H, M>>
     {
         static constexpr const char *value = "mat";
@@ -1,10 +1,10 @@
 #pragma once
 
-#include <algorithm>
 #include <array>
 #include <cstddef>
 #include <string>
 
+#include "meta/constexpr_hash.h"
 #include "program/errors.h"
 #include "stream/input.h"
 
@@ -103,49 +103,19 @@ namespace Refl::Utils
         return (unsigned char)*a - (unsigned char)*b;
     }
 
-    struct NameIndexPair
-    {
-        const char *name = nullptr;
-        std::size_t index = 0;
-
-        constexpr bool operator==(const NameIndexPair &other) const
-        {
-            return *this <=> other == 0;
-        }
-
-        constexpr std::weak_ordering operator<=>(const NameIndexPair &other) const
-        {
-            return *this <=> other.name;
-        }
-
-        constexpr std::weak_ordering operator<=>(const char *other_name) const
-        {
-            return cexpr_strcmp(name, other_name) <=> 0;
-        }
-    };
-
     // An universal function to look up strings in immutable lists.
     // `F` is a pointer to a constexpr function that returns an array of names: `std::array<const char *, N> (*)(auto index)`.
     // `name` is a name that we're looking for. If it's not found, -1 is returned.
     // Avoid using lambdas as `F`. If you do that in a header, you will most likely get an ODR violation.
+    // Uses a perfect hash built at compile-time, so the lookup is a single string comparison.
     template <auto F> std::size_t GetStringIndex(const char *name)
     {
-        static constexpr auto array = []
-        {
-            auto name_array = F();
-            std::array<NameIndexPair, name_array.size()> array{};
-            for (std::size_t i = 0; i < array.size(); i++)
-            {
-                array[i].name = name_array[i];
-                array[i].index = i;
-            }
-            std::sort(array.begin(), array.end());
-            return array;
-        }();
-        static_assert(std::adjacent_find(array.begin(), array.end()) == array.end(), "Duplicate string in a static list.");
-        auto it = std::lower_bound(array.begin(), array.end(), name);
-        if (it == array.end() || *it != NameIndexPair{name, 0})
+        static constexpr auto name_array = F();
+        static constexpr Meta::PerfectHash<name_array.size()> hash(name_array);
+        static_assert(hash.IsValid(), "Duplicate string in a static list.");
+        std::size_t index = hash.Find(name);
+        if (index == std::size_t(-1) || cexpr_strcmp(name_array[index], name) != 0)
             return -1;
-        return it->index;
+        return index;
     }
 }
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "macros/finally.h"
+#include "meta/common.h"
+#include "program/errors.h"
+#include "signals/target.h"
+
+namespace Sig
+{
+    // A queue that any number of threads can push to without locking, and one thread at a time drains.
+    // Internally it's a lock-free stack, which the consumer takes as a whole and reverses.
+    template <typename T>
+    class EventQueue
+    {
+        static_assert(std::is_same_v<T, std::remove_cvref_t<T>>, "The template parameter must be a cvref-unqualified type.");
+
+        struct Node
+        {
+            T value;
+            Node *next = nullptr;
+        };
+
+        std::atomic<Node *> head = nullptr; // The newest event.
+
+        static void DeleteList(Node *node) noexcept
+        {
+            while (node)
+                delete std::exchange(node, node->next);
+        }
+
+      public:
+        EventQueue() {}
+
+        // The producers can hold pointers to the queue.
+        EventQueue(const EventQueue &) = delete;
+        EventQueue &operator=(const EventQueue &) = delete;
+
+        ~EventQueue()
+        {
+            DeleteList(head.load(std::memory_order_acquire));
+        }
+
+        // Thread-safe.
+        void Push(T value)
+        {
+            Node *node = new Node{std::move(value), head.load(std::memory_order_relaxed)};
+            while (!head.compare_exchange_weak(node->next, node, std::memory_order_release, std::memory_order_relaxed)) {}
+        }
+
+        // Calls `func(T &&)` for every event pushed so far, in the order they were pushed. Returns the number of events.
+        // The events pushed during this call are left for the next one.
+        // Only one thread can drain at a time.
+        template <typename F>
+        std::size_t Drain(F &&func)
+        {
+            Node *list = head.exchange(nullptr, std::memory_order_acquire);
+
+            // Reverse the list, to get the oldest events first.
+            Node *reversed = nullptr;
+            while (list)
+            {
+                Node *next = list->next;
+                list->next = reversed;
+                reversed = list;
+                list = next;
+            }
+
+            // If `func` throws, the remaining events are dropped.
+            FINALLY( DeleteList(reversed); )
+
+            std::size_t ret = 0;
+            while (reversed)
+            {
+                std::unique_ptr<Node> node(std::exchange(reversed, reversed->next));
+                func(std::move(node->value));
+                ret++;
+            }
+            return ret;
+        }
+
+        // Thread-safe, but the answer can be outdated immediately.
+        [[nodiscard]] bool IsEmpty() const
+        {
+            return head.load(std::memory_order_relaxed) == nullptr;
+        }
+    };
+
+    // Typed channels of events. The events can be sent from any thread without locking, and are delivered to the handlers when `Dispatch()` is called.
+    // The channels should be created in advance (by connecting the handlers, or by `GetChannel()`) on the thread that dispatches,
+    // then the other threads can send to them.
+    class EventBus
+    {
+      public:
+        template <typename T>
+        class Channel;
+
+      private:
+        struct ChannelBase : Meta::with_virtual_destructor<ChannelBase>
+        {
+            virtual std::size_t Dispatch() = 0;
+        };
+
+        // Assigns a different index to each event type, shared by all buses.
+        [[nodiscard]] static std::size_t NextChannelIndex()
+        {
+            static std::atomic<std::size_t> counter = 0;
+            return counter.fetch_add(1, std::memory_order_relaxed);
+        }
+        template <typename T>
+        [[nodiscard]] static std::size_t ChannelIndex()
+        {
+            static const std::size_t ret = NextChannelIndex();
+            return ret;
+        }
+
+        // Indexed by `ChannelIndex()`, can have nulls. Only modified by `GetChannel()`.
+        std::vector<std::unique_ptr<ChannelBase>> channels;
+
+      public:
+        template <typename T>
+        class Channel : public ChannelBase
+        {
+            friend EventBus;
+
+            EventQueue<T> queue;
+            std::vector<std::function<bool(const T &)>> handlers; // Those return false to be disconnected.
+
+            std::size_t Dispatch() override
+            {
+                return queue.Drain([&](T &&event)
+                {
+                    std::erase_if(handlers, [&](const auto &handler){return !handler(event);});
+                });
+            }
+
+          public:
+            // Thread-safe.
+            void Send(T event)
+            {
+                queue.Push(std::move(event));
+            }
+
+            // Those must be called on the dispatching thread.
+
+            void Connect(std::function<void(const T &)> func)
+            {
+                handlers.push_back([func = std::move(func)](const T &event){func(event); return true;});
+            }
+
+            // Calls the method of the target, until the target is destroyed.
+            template <typename D>
+            void Connect(Target<D> &target, void (D::*method)(const T &))
+            {
+                Pointer<D> pointer;
+                pointer.Bind(target);
+                handlers.push_back([pointer = std::move(pointer), method](const T &event) mutable
+                {
+                    D *object = pointer.GetTarget();
+                    if (!object)
+                        return false;
+                    (object->*method)(event);
+                    return true;
+                });
+            }
+        };
+
+        EventBus() {}
+
+        // The channels are referenced by the senders.
+        EventBus(const EventBus &) = delete;
+        EventBus &operator=(const EventBus &) = delete;
+
+        // Creates the channel if it doesn't exist yet. Not thread-safe, other threads should hold onto the returned reference.
+        template <typename T>
+        [[nodiscard]] Channel<T> &GetChannel()
+        {
+            std::size_t index = ChannelIndex<T>();
+            if (index >= channels.size())
+                channels.resize(index + 1);
+            if (!channels[index])
+                channels[index] = std::make_unique<Channel<T>>();
+            return static_cast<Channel<T> &>(*channels[index]);
+        }
+
+        // Thread-safe if the channel already exists. Otherwise the event is dropped, since there are no handlers anyway.
+        template <typename T>
+        void Send(T event)
+        {
+            std::size_t index = ChannelIndex<T>();
+            ASSERT(index < channels.size() && channels[index], "Sending an event to a channel that wasn't created yet.");
+            if (index < channels.size() && channels[index])
+                static_cast<Channel<T> &>(*channels[index]).Send(std::move(event));
+        }
+
+        // Delivers all the events sent so far. Returns the number of events.
+        std::size_t Dispatch()
+        {
+            std::size_t ret = 0;
+            for (const auto &channel : channels)
+            {
+                if (channel)
+                    ret += channel->Dispatch();
+            }
+            return ret;
+        }
+    };
+}
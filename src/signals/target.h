@@ -91,7 +91,7 @@ namespace Sig
     class Pointer
     {
         // No assertions for `D` here, because `impl::Target<D>` already checks it.
-        using State = typename InterfaceType<Target<D>>::State;
+        using State = typename impl::Target<D>::State;
 
         // Unlike in `class Target`, this CAN point to a state storing a null pointer.
         // This is `mutable` because some const functions can reset it to null if they detect this state.
@@ -0,0 +1,170 @@
+#include "asset_pack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+#include "program/errors.h"
+#include "program/exe_path.h"
+#include "reflection/full.h"
+#include "stream/save_to_file.h"
+#include "utils/archive.h"
+#include "utils/filesystem.h"
+
+namespace Stream
+{
+    namespace
+    {
+        REFL_SIMPLE_STRUCT_WITHOUT_NAMES( IndexEntry
+            REFL_DECL(std::uint64_t) offset, stored_size, size
+            REFL_DECL(bool) compressed
+        )
+
+        REFL_SIMPLE_STRUCT( Index
+            REFL_DECL(std::map<std::string, IndexEntry>) entries
+        )
+
+        constexpr std::size_t header_size = sizeof AssetPack::magic + 8; // The magic and the index size.
+    }
+
+    AssetPack::AssetPack(const std::string &file_name)
+    {
+        auto new_state = std::make_shared<State>();
+        new_state->file_name = file_name;
+        new_state->mapping = FileMapping(file_name);
+
+        const std::uint8_t *data = new_state->mapping.data();
+        std::size_t file_size = new_state->mapping.size();
+
+        if (file_size < header_size || std::memcmp(data, magic, sizeof magic) != 0)
+            Program::Error("File `", file_name, "` is not an asset pack.");
+
+        std::uint64_t index_size = 0;
+        for (int i = 0; i < 8; i++)
+            index_size |= std::uint64_t(data[sizeof magic + i]) << (i * 8);
+        if (index_size > file_size - header_size)
+            Program::Error("The index of asset pack `", file_name, "` is truncated.");
+
+        Index index;
+        Refl::FromBinary(index, Stream::Input(ReadOnlyData::mem_reference(data + header_size, data + header_size + index_size)));
+
+        for (auto &[name, entry] : index.entries)
+        {
+            if (entry.offset > file_size || entry.stored_size > file_size - entry.offset || (!entry.compressed && entry.stored_size != entry.size))
+                Program::Error("Entry `", name, "` in asset pack `", file_name, "` is out of bounds.");
+            new_state->entries.try_emplace(name, Entry{.offset = entry.offset, .stored_size = entry.stored_size, .size = entry.size, .compressed = entry.compressed});
+        }
+
+        state = std::move(new_state);
+    }
+
+    ReadOnlyData AssetPack::Get(std::string_view name) const
+    {
+        if (!state)
+            Program::Error("Attempt to load `", name, "` from a null asset pack.");
+
+        auto it = state->entries.find(name);
+        if (it == state->entries.end())
+            Program::Error("No file `", name, "` in asset pack `", state->file_name, "`.");
+
+        const Entry &entry = it->second;
+        const std::uint8_t *begin = state->mapping.data() + entry.offset;
+        const std::uint8_t *end = begin + entry.stored_size;
+        std::string entry_name = state->file_name + '/' + it->first;
+
+        if (!entry.compressed)
+            return ReadOnlyData::mem_reference(begin, end, state, std::move(entry_name));
+
+        try
+        {
+            return ReadOnlyData::copy_from_function(std::move(entry_name), entry.size, [&](std::uint8_t *target)
+            {
+                Archive::Raw::Uncompress(begin, end, target, target + entry.size);
+            });
+        }
+        catch (...)
+        {
+            Program::Error("Unable to uncompress `", name, "` from asset pack `", state->file_name, "`.");
+        }
+    }
+
+    void AssetPack::Write(const std::string &file_name, const std::string &dir, const std::vector<std::string> &names)
+    {
+        Index index;
+        std::vector<std::vector<std::uint8_t>> contents;
+        contents.reserve(names.size());
+
+        for (const std::string &name : names)
+        {
+            ReadOnlyData file = ReadOnlyData::file(dir + '/' + name);
+
+            IndexEntry entry;
+            entry.size = file.size();
+
+            std::vector<std::uint8_t> compressed(Archive::Raw::MaxCompressedSize(file.begin(), file.end()));
+            compressed.resize(Archive::Raw::Compress(file.begin(), file.end(), compressed.data(), compressed.data() + compressed.size()) - compressed.data());
+
+            // Only keep the compressed version if it saves at least 1/8 of the size, otherwise it's not worth decompressing.
+            entry.compressed = compressed.size() + file.size() / 8 < file.size();
+            std::vector<std::uint8_t> &stored = contents.emplace_back(entry.compressed ? std::move(compressed) : std::vector<std::uint8_t>(file.begin(), file.end()));
+            entry.stored_size = stored.size();
+
+            if (!index.entries.try_emplace(name, entry).second)
+                Program::Error("Duplicate file `", name, "` in asset pack `", file_name, "`.");
+        }
+
+        // The offsets are a part of the index, which affects its size, so the index is serialized twice. The integers in the binary format have fixed sizes, so the second pass doesn't change the size.
+        auto AlignUp = [](std::uint64_t value) {return (value + alignment - 1) / alignment * alignment;};
+        std::vector<std::uint8_t> index_bytes;
+        for (int pass = 0; pass < 2; pass++)
+        {
+            std::uint64_t offset = AlignUp(header_size + index_bytes.size());
+            for (std::size_t i = 0; i < names.size(); i++)
+            {
+                IndexEntry &entry = index.entries.at(names[i]);
+                entry.offset = offset;
+                offset = AlignUp(offset + entry.stored_size);
+            }
+            index_bytes = Refl::ToBinary<std::vector<std::uint8_t>>(index);
+        }
+
+        std::vector<std::uint8_t> bytes(magic, magic + sizeof magic);
+        for (int i = 0; i < 8; i++)
+            bytes.push_back(std::uint8_t(std::uint64_t(index_bytes.size()) >> (i * 8)));
+        bytes.insert(bytes.end(), index_bytes.begin(), index_bytes.end());
+
+        for (std::size_t i = 0; i < names.size(); i++)
+        {
+            const IndexEntry &entry = index.entries.at(names[i]);
+            ASSERT(bytes.size() <= entry.offset, "Internal error: Asset pack layout mismatch.");
+            bytes.resize(entry.offset);
+            bytes.insert(bytes.end(), contents[i].begin(), contents[i].end());
+        }
+
+        Stream::SaveFile(file_name, bytes);
+    }
+
+    const AssetPack &AssetPack::Default()
+    {
+        static const AssetPack ret = []{
+            std::string file_name = Program::ExeDir() + "assets.pack";
+            bool exists = false;
+            (void)Filesystem::GetObjectInfo(file_name, &exists);
+            return exists ? AssetPack(file_name) : AssetPack();
+        }();
+        return ret;
+    }
+
+    ReadOnlyData ReadOnlyData::from_pack(std::string file_name)
+    {
+        const AssetPack &pack = AssetPack::Default();
+        const std::string &dir = Program::ExeDir();
+        if (pack && file_name.starts_with(dir))
+        {
+            std::string_view name = std::string_view(file_name).substr(dir.size());
+            if (pack.Contains(name))
+                return pack.Get(name);
+        }
+        return map_file(std::move(file_name));
+    }
+}
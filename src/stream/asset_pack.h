@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "stream/file_mapping.h"
+#include "stream/readonly_data.h"
+
+namespace Stream
+{
+    // Many files stored in a single one, so the startup opens one file instead of many. The pack is mapped into memory, the entries are read from the mapping.
+    // The layout is: 8 bytes of `magic`, a little-endian 64-bit index size, the index (see `Index` in the `.cpp`, serialized with `Refl::ToBinary()`), then the data of the entries.
+    // The data of each entry begins at a multiple of `alignment` from the beginning of the file.
+    // An entry can be compressed with `Archive::Raw::Compress()`, then it's decompressed to the heap when loaded.
+    // Make one with `AssetPack::Write()`, or with `make asset-pack`, which uses `asset_packer/main.cpp`.
+    class AssetPack
+    {
+      public:
+        static constexpr char magic[8] = {'F', 'L', 'P', 'A', 'C', 'K', '0', '1'};
+        static constexpr std::size_t alignment = 16;
+
+        struct Entry
+        {
+            std::uint64_t offset = 0; // From the beginning of the file.
+            std::uint64_t stored_size = 0;
+            std::uint64_t size = 0; // Uncompressed.
+            bool compressed = false;
+        };
+
+      private:
+        struct State
+        {
+            std::string file_name;
+            FileMapping mapping;
+            std::map<std::string, Entry, std::less<>> entries;
+        };
+        std::shared_ptr<const State> state; // Shared with the `ReadOnlyData`s pointing into the mapping.
+
+      public:
+        AssetPack() {}
+
+        // Maps the file and reads the index. Throws on failure.
+        explicit AssetPack(const std::string &file_name);
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(state);
+        }
+
+        [[nodiscard]] bool Contains(std::string_view name) const
+        {
+            return state && state->entries.find(name) != state->entries.end();
+        }
+
+        // Returns an entry, without copying it unless it's compressed. The result keeps the pack mapped. Throws if there's no such entry.
+        [[nodiscard]] ReadOnlyData Get(std::string_view name) const;
+
+        // Packs the files, which are given relative to `dir`, and are stored by those names. Throws on failure.
+        // Each file is compressed if that makes it noticeably smaller, so the already compressed formats (`.ogg`, `.png`, `.z`) are stored as is.
+        static void Write(const std::string &file_name, const std::string &dir, const std::vector<std::string> &names);
+
+        // The pack used by `ReadOnlyData::from_pack()`. It's `assets.pack` in `Program::ExeDir()`, opened on the first call.
+        // Null if there's no such file. Throws (on every call) if it exists, but can't be opened.
+        [[nodiscard]] static const AssetPack &Default();
+    };
+}
@@ -0,0 +1,100 @@
+#include "async_file_writer.h"
+
+#include <algorithm>
+#include <exception>
+#include <utility>
+
+#include "program/errors.h"
+
+namespace Stream
+{
+    void AsyncFileWriter::ThreadFunc()
+    {
+        std::vector<Request> batch;
+        while (true)
+        {
+            {
+                std::unique_lock lock(mutex);
+                if (busy)
+                {
+                    busy = false;
+                    idle_cond.notify_all();
+                }
+                wake_cond.wait(lock, [&]{return !pending.empty() || stopping;});
+                if (pending.empty())
+                    return; // Stopping, and everything is written.
+                std::swap(batch, pending);
+                busy = true;
+            }
+
+            for (Request &request : batch)
+            {
+                try
+                {
+                    if (request.compress)
+                        Stream::SaveFileCompressed(request.file_name, request.data);
+                    else
+                        Stream::SaveFile(request.file_name, request.data, request.mode);
+                }
+                catch (std::exception &e)
+                {
+                    std::lock_guard lock(mutex);
+                    if (error.empty())
+                        error = e.what();
+                }
+            }
+            batch.clear();
+        }
+    }
+
+    void AsyncFileWriter::AddRequest(Request request)
+    {
+        std::lock_guard lock(mutex);
+        ThrowIfFailed();
+
+        // Overwriting a file makes the older pending writes to it pointless.
+        if (request.mode != append_binary && request.mode != append_text)
+            std::erase_if(pending, [&](const Request &other){return other.file_name == request.file_name;});
+
+        pending.push_back(std::move(request));
+        if (!thread.joinable())
+            thread = std::thread([this]{ThreadFunc();});
+        wake_cond.notify_one();
+    }
+
+    void AsyncFileWriter::ThrowIfFailed()
+    {
+        if (!error.empty())
+            Program::Error(std::exchange(error, {}));
+    }
+
+    AsyncFileWriter::~AsyncFileWriter()
+    {
+        if (!thread.joinable())
+            return;
+
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake_cond.notify_one();
+        thread.join();
+    }
+
+    void AsyncFileWriter::SaveFile(std::string file_name, std::vector<std::uint8_t> data, SaveMode mode)
+    {
+        AddRequest({.file_name = std::move(file_name), .data = std::move(data), .mode = mode});
+    }
+
+    void AsyncFileWriter::SaveFileCompressed(std::string file_name, std::vector<std::uint8_t> data)
+    {
+        AddRequest({.file_name = std::move(file_name), .data = std::move(data), .compress = true});
+    }
+
+    void AsyncFileWriter::Flush()
+    {
+        std::unique_lock lock(mutex);
+        idle_cond.wait(lock, [&]{return pending.empty() && !busy;});
+        ThrowIfFailed();
+    }
+}
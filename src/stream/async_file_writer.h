@@ -0,0 +1,58 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "stream/save_to_file.h"
+
+namespace Stream
+{
+    // Saves files on a background thread, so the caller doesn't wait for the disk or for the compression.
+    // The requests are double-buffered: the thread takes all pending requests at once, and the caller keeps adding new ones while it writes them.
+    // If a file is overwritten again before the previous version was written, only the newest version is written.
+    // The errors can't be reported immediately, so the first one is rethrown from the next `Save...()` or `Flush()` call.
+    class AsyncFileWriter
+    {
+        struct Request
+        {
+            std::string file_name;
+            std::vector<std::uint8_t> data;
+            SaveMode mode = binary;
+            bool compress = false;
+        };
+
+        std::mutex mutex;
+        std::condition_variable wake_cond; // Notified when a request is added, or when stopping.
+        std::condition_variable idle_cond; // Notified when the thread finishes a batch.
+        std::vector<Request> pending;
+        bool busy = false; // True while the thread is writing a batch.
+        bool stopping = false;
+        std::string error; // The first error that wasn't reported yet.
+
+        std::thread thread; // Started on the first request.
+
+        void ThreadFunc();
+        void AddRequest(Request request);
+        // Throws if `error` is set, and clears it. `mutex` must be locked.
+        void ThrowIfFailed();
+
+      public:
+        AsyncFileWriter() {}
+        AsyncFileWriter(const AsyncFileWriter &) = delete;
+        AsyncFileWriter &operator=(const AsyncFileWriter &) = delete;
+        // Waits until the pending files are written. Ignores the errors.
+        ~AsyncFileWriter();
+
+        // Same as `Stream::SaveFile()`, but in the background.
+        void SaveFile(std::string file_name, std::vector<std::uint8_t> data, SaveMode mode = binary);
+        // Same as `Stream::SaveFileCompressed()`, but in the background. The compression runs on the background thread too.
+        void SaveFileCompressed(std::string file_name, std::vector<std::uint8_t> data);
+
+        // Blocks until everything is written. Throws if any of the writes failed.
+        void Flush();
+    };
+}
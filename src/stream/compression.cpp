@@ -0,0 +1,311 @@
+#include "compression.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <zlib.h>
+
+#include "meta/common.h"
+#include "program/errors.h"
+#include "stream/save_to_file.h"
+#include "utils/archive.h"
+#include "utils/robust_math.h"
+
+namespace Stream
+{
+    namespace
+    {
+        constexpr std::size_t chunk_size = 1 << 14; // The size of the compressed data buffers.
+        constexpr std::size_t max_zlib_step = 1 << 30; // zlib counts the bytes in `uInt`, so the larger blocks are split.
+        constexpr std::size_t size_prefix_len = 8; // See `Archive::Compress()`.
+
+        struct Inflater
+        {
+            Input source;
+            std::size_t source_begin = 0; // Where the zlib stream begins in `source`.
+            z_stream z{};
+            std::unique_ptr<std::uint8_t[]> input_buffer = std::make_unique<std::uint8_t[]>(chunk_size);
+            std::unique_ptr<std::uint8_t[]> skip_buffer; // For the forward seeks. Allocated when needed.
+            std::size_t position = 0; // How many uncompressed bytes were produced.
+
+            Inflater(Input new_source) : source(std::move(new_source)), source_begin(source.Position())
+            {
+                if (inflateInit(&z) != Z_OK)
+                    Program::Error("Unable to initialize the decompression.");
+            }
+
+            Inflater(const Inflater &) = delete;
+            Inflater &operator=(const Inflater &) = delete;
+
+            ~Inflater()
+            {
+                inflateEnd(&z);
+            }
+
+            void Restart()
+            {
+                if (inflateReset(&z) != Z_OK)
+                    Program::Error("Unable to restart the decompression.");
+                source.Seek(source_begin, absolute);
+                z.avail_in = 0;
+                position = 0;
+            }
+
+            void Produce(Input &stream, std::uint8_t *dst, std::size_t size)
+            {
+                while (size > 0)
+                {
+                    if (z.avail_in == 0)
+                    {
+                        std::size_t len = std::min(chunk_size, source.RemainingBytes());
+                        if (len == 0)
+                            Program::Error(stream.GetExceptionPrefix(), "The compressed data is truncated.");
+                        source.Read(input_buffer.get(), len);
+                        z.next_in = input_buffer.get();
+                        z.avail_in = uInt(len);
+                    }
+
+                    std::size_t step = std::min(size, max_zlib_step);
+                    z.next_out = dst;
+                    z.avail_out = uInt(step);
+                    int status = inflate(&z, Z_NO_FLUSH);
+                    if (status != Z_OK && status != Z_STREAM_END)
+                        Program::Error(stream.GetExceptionPrefix(), "Unable to uncompress.");
+
+                    std::size_t produced = step - z.avail_out;
+                    dst += produced;
+                    size -= produced;
+                    position += produced;
+
+                    if (status == Z_STREAM_END && size > 0)
+                        Program::Error(stream.GetExceptionPrefix(), "The uncompressed data is shorter than expected.");
+                }
+            }
+
+            void Read(Input &stream, std::size_t offset, std::size_t size, std::uint8_t *dst)
+            {
+                if (offset < position)
+                    Restart();
+
+                if (position < offset && !skip_buffer)
+                    skip_buffer = std::make_unique<std::uint8_t[]>(chunk_size);
+                while (position < offset)
+                    Produce(stream, skip_buffer.get(), std::min(chunk_size, offset - position));
+
+                Produce(stream, dst, size);
+            }
+        };
+
+        // Reads `Archive::Blocks`, decompressing one block at a time.
+        struct BlockReader
+        {
+            Input source;
+            std::size_t data_begin = 0; // Where the compressed blocks begin in `source`.
+            Archive::Blocks::Header header;
+            std::vector<std::uint8_t> compressed_block;
+            std::vector<std::uint8_t> block; // The uncompressed `block_index`.
+            std::size_t block_index = -1;
+
+            void LoadBlock(Input &stream, std::size_t i)
+            {
+                if (block_index == i)
+                    return;
+
+                std::size_t begin = header.BlockBegin(i);
+                std::size_t compressed_size = header.block_ends[i] - begin;
+                source.Seek(data_begin + begin, absolute);
+                if (source.RemainingBytes() < compressed_size)
+                    Program::Error(stream.GetExceptionPrefix(), "The compressed data is truncated.");
+                compressed_block.resize(compressed_size);
+                source.Read(compressed_block.data(), compressed_size);
+
+                block_index = -1; // In case this throws.
+                block.resize(header.BlockUncompressedSize(i));
+                try
+                {
+                    Archive::Raw::Uncompress(compressed_block.data(), compressed_block.data() + compressed_size, block.data(), block.data() + block.size());
+                }
+                catch (...)
+                {
+                    Program::Error(stream.GetExceptionPrefix(), "Unable to uncompress.");
+                }
+                block_index = i;
+            }
+
+            void Read(Input &stream, std::size_t offset, std::size_t size, std::uint8_t *dst)
+            {
+                while (size > 0)
+                {
+                    std::size_t i = offset / header.block_size;
+                    LoadBlock(stream, i);
+                    std::size_t block_offset = offset - i * header.block_size;
+                    std::size_t len = std::min(size, block.size() - block_offset);
+                    std::copy_n(block.data() + block_offset, len, dst);
+                    offset += len;
+                    dst += len;
+                    size -= len;
+                }
+            }
+        };
+
+        struct Deflater
+        {
+            Output target;
+            std::size_t remaining = 0; // How many uncompressed bytes are still expected.
+            z_stream z{};
+            std::unique_ptr<std::uint8_t[]> output_buffer = std::make_unique<std::uint8_t[]>(chunk_size);
+
+            Deflater(Output new_target, std::size_t size) : target(std::move(new_target)), remaining(size)
+            {
+                if (deflateInit(&z, Z_DEFAULT_COMPRESSION) != Z_OK)
+                    Program::Error("Unable to initialize the compression.");
+            }
+
+            Deflater(const Deflater &) = delete;
+            Deflater &operator=(const Deflater &) = delete;
+
+            ~Deflater()
+            {
+                deflateEnd(&z);
+            }
+
+            // Compresses the bytes, and finishes the compressed stream if they're the last ones.
+            void Write(Output &stream, const std::uint8_t *src, std::size_t size)
+            {
+                if (size > remaining)
+                    Program::Error(stream.GetExceptionPrefix(), "More bytes were written than declared.");
+                remaining -= size;
+
+                do
+                {
+                    std::size_t step = std::min(size, max_zlib_step);
+                    z.next_in = const_cast<std::uint8_t *>(src);
+                    z.avail_in = uInt(step);
+                    src += step;
+                    size -= step;
+
+                    bool finish = remaining == 0 && size == 0;
+                    int status = Z_OK;
+                    do
+                    {
+                        z.next_out = output_buffer.get();
+                        z.avail_out = uInt(chunk_size);
+                        status = deflate(&z, finish ? Z_FINISH : Z_NO_FLUSH);
+                        if (status == Z_STREAM_ERROR)
+                            Program::Error(stream.GetExceptionPrefix(), "Unable to compress.");
+                        target.WriteBytes(output_buffer.get(), chunk_size - z.avail_out);
+                    }
+                    while (finish ? status != Z_STREAM_END : z.avail_out == 0);
+                }
+                while (size > 0);
+
+                if (remaining == 0)
+                    target.Flush();
+            }
+        };
+    }
+
+    Input UncompressingInput(Input source, capacity_t capacity)
+    {
+        std::uint8_t prefix[size_prefix_len];
+        if (source.RemainingBytes() < size_prefix_len)
+            Program::Error(source.GetExceptionPrefix(), "The compressed data is truncated.");
+        source.Read(prefix, size_prefix_len);
+
+        std::string name = source.GetTarget() + " (uncompressed)";
+
+        if (Archive::Blocks::IsBlockFormat(prefix, prefix + size_prefix_len))
+        {
+            // Read the fixed part of the header to learn the block count, then the whole header.
+            std::vector<std::uint8_t> header_bytes(Archive::Blocks::min_header_size);
+            std::copy_n(prefix, size_prefix_len, header_bytes.data());
+            if (source.RemainingBytes() < header_bytes.size() - size_prefix_len)
+                Program::Error(source.GetExceptionPrefix(), "The compressed data is truncated.");
+            source.Read(header_bytes.data() + size_prefix_len, header_bytes.size() - size_prefix_len);
+
+            std::uint64_t num_blocks = 0;
+            for (std::size_t i = 0; i < 8; i++)
+                num_blocks |= std::uint64_t(header_bytes[Archive::Blocks::min_header_size - 8 + i]) << (i * 8);
+            if (num_blocks > source.RemainingBytes() / 8)
+                Program::Error(source.GetExceptionPrefix(), "The compressed data is truncated.");
+            header_bytes.resize(Archive::Blocks::HeaderSize(std::size_t(num_blocks)));
+            source.Read(header_bytes.data() + Archive::Blocks::min_header_size, header_bytes.size() - Archive::Blocks::min_header_size);
+
+            auto reader = std::make_unique<BlockReader>();
+            try
+            {
+                reader->header = Archive::Blocks::ReadHeader(header_bytes.data(), header_bytes.data() + header_bytes.size());
+            }
+            catch (...)
+            {
+                Program::Error(source.GetExceptionPrefix(), "Invalid compressed data.");
+            }
+            reader->data_begin = source.Position();
+            reader->source = std::move(source);
+
+            std::size_t size = reader->header.size;
+            return Input(std::move(name), size,
+                Meta::fake_copyable([reader = std::move(reader)](Input &stream, std::size_t offset, std::size_t size, std::uint8_t *dst)
+                {
+                    reader->Read(stream, offset, size, dst);
+                }),
+                capacity);
+        }
+
+        std::uint64_t size_raw = 0;
+        for (std::size_t i = 0; i < size_prefix_len; i++)
+            size_raw |= std::uint64_t(prefix[i]) << (i * 8);
+        std::size_t size = 0;
+        if (Robust::conversion_fails(size_raw, size))
+            Program::Error(source.GetExceptionPrefix(), "Unable to uncompress: The object is too large.");
+
+        auto inflater = std::make_unique<Inflater>(std::move(source));
+        return Input(std::move(name), size,
+            Meta::fake_copyable([inflater = std::move(inflater)](Input &stream, std::size_t offset, std::size_t size, std::uint8_t *dst)
+            {
+                inflater->Read(stream, offset, size, dst);
+            }),
+            capacity);
+    }
+
+    Output CompressingOutput(Output target, std::size_t size, capacity_t capacity)
+    {
+        std::uint8_t prefix[size_prefix_len];
+        for (std::size_t i = 0; i < size_prefix_len; i++)
+            prefix[i] = std::uint8_t(std::uint64_t(size) >> (i * 8));
+        target.WriteBytes(prefix, size_prefix_len);
+
+        std::string name = target.GetTarget() + " (compressed)";
+        auto deflater = std::make_unique<Deflater>(std::move(target), size);
+        if (size == 0)
+        {
+            // Nothing is going to be flushed, so finish right away.
+            Output null_stream;
+            deflater->Write(null_stream, nullptr, 0);
+        }
+
+        return Output(std::move(name),
+            Meta::fake_copyable([deflater = std::move(deflater)](Output &stream, const std::uint8_t *src, std::size_t size)
+            {
+                deflater->Write(stream, src, size);
+            }),
+            capacity);
+    }
+
+    void SaveFileCompressed(std::string file_name, const std::uint8_t *begin, const std::uint8_t *end)
+    {
+        // The large objects are compressed in parallel.
+        if (std::size_t(end - begin) >= Archive::Blocks::default_block_size * 2)
+        {
+            SaveFile(std::move(file_name), Archive::Blocks::Compress(begin, end));
+            return;
+        }
+
+        Output output = CompressingOutput(Output(std::move(file_name)), std::size_t(end - begin));
+        output.WriteBytes(begin, std::size_t(end - begin));
+        output.Flush();
+    }
+}
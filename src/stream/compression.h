@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+#include "stream/input.h"
+#include "stream/output.h"
+
+namespace Stream
+{
+    // Streaming versions of `Archive::Compress()` and `Archive::Uncompress()`, using the same format: the uncompressed size as a 64-bit little-endian integer, then the zlib stream.
+    // They only keep small fixed-size buffers, rather than the whole compressed or uncompressed data.
+
+    // Returns a stream of the uncompressed contents of `source`, which start at its current position.
+    // The reads should be sequential, like `Refl::FromBinary()` does them. Seeking backwards restarts the decompression from the beginning.
+    // The block format (`Archive::Blocks`) is accepted too. Then one block is decompressed at a time, and seeking only costs decompressing the target block.
+    [[nodiscard]] Input UncompressingInput(Input source, capacity_t capacity = Input::adaptive_capacity);
+
+    // Returns a stream that compresses everything written to it into `target`.
+    // `size` must be the exact number of bytes that will be written, since it's stored first. Writing more throws.
+    // Once all `size` bytes are flushed, this finishes the compressed data and flushes `target`.
+    [[nodiscard]] Output CompressingOutput(Output target, std::size_t size, capacity_t capacity = Output::large_capacity);
+}
@@ -0,0 +1,91 @@
+#include "file_mapping.h"
+
+#include "macros/finally.h"
+#include "program/errors.h"
+#include "program/platform.h"
+
+#if IMP_PLATFORM_IS(windows)
+#include <filesystem>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Stream
+{
+    FileMapping::FileMapping(const std::string &file_name)
+    {
+        #if IMP_PLATFORM_IS(windows)
+        HANDLE file = CreateFileW(std::filesystem::u8path(file_name).c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            Program::Error("Unable to open file `", file_name, "`.");
+        FINALLY( CloseHandle(file); ) // The view stays valid after closing the handles.
+
+        LARGE_INTEGER size;
+        if (!GetFileSizeEx(file, &size))
+            Program::Error("Unable to get size of file `", file_name, "`.");
+        if (size.QuadPart == 0)
+            return; // Empty files can't be mapped.
+
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+            Program::Error("Unable to map file `", file_name, "`.");
+        FINALLY( CloseHandle(mapping); )
+
+        void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view)
+            Program::Error("Unable to map file `", file_name, "`.");
+
+        memory = static_cast<const std::uint8_t *>(view);
+        mapped_size = std::size_t(size.QuadPart);
+        #else
+        int file = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file == -1)
+            Program::Error("Unable to open file `", file_name, "`.");
+        FINALLY( close(file); ) // The mapping stays valid after closing the file.
+
+        struct stat info;
+        if (fstat(file, &info))
+            Program::Error("Unable to get size of file `", file_name, "`.");
+        if (info.st_size == 0)
+            return; // Empty files can't be mapped.
+
+        void *view = mmap(nullptr, std::size_t(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (view == MAP_FAILED)
+            Program::Error("Unable to map file `", file_name, "`.");
+
+        memory = static_cast<const std::uint8_t *>(view);
+        mapped_size = std::size_t(info.st_size);
+        #endif
+    }
+
+    FileMapping::~FileMapping()
+    {
+        #if IMP_PLATFORM_IS(windows)
+        if (memory)
+            UnmapViewOfFile(memory);
+        #else
+        if (memory)
+            munmap(const_cast<std::uint8_t *>(memory), mapped_size);
+        #endif
+    }
+
+    bool FileMapping::HasNullTerminatorPastEnd() const
+    {
+        if (!memory)
+            return false;
+
+        #if IMP_PLATFORM_IS(windows)
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        std::size_t page_size = info.dwPageSize;
+        #else
+        std::size_t page_size = std::size_t(sysconf(_SC_PAGESIZE));
+        #endif
+
+        return mapped_size % page_size != 0;
+    }
+}
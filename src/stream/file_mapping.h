@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+namespace Stream
+{
+    // Maps a file into memory for reading, using `mmap()` or `MapViewOfFile()`.
+    // The OS loads the pages lazily, and nothing is copied to the heap.
+    // Don't modify or truncate the file while it's mapped. Truncating it can crash the program on access.
+    class FileMapping
+    {
+        const std::uint8_t *memory = nullptr;
+        std::size_t mapped_size = 0;
+
+      public:
+        FileMapping() {}
+
+        // Throws on failure. Empty files produce an empty mapping.
+        FileMapping(const std::string &file_name);
+
+        FileMapping(FileMapping &&other) noexcept
+        {
+            Swap(other);
+        }
+        FileMapping &operator=(FileMapping other) noexcept
+        {
+            Swap(other);
+            return *this;
+        }
+
+        ~FileMapping();
+
+        void Swap(FileMapping &other) noexcept
+        {
+            std::swap(memory, other.memory);
+            std::swap(mapped_size, other.mapped_size);
+        }
+
+        [[nodiscard]] const std::uint8_t *data() const {return memory;}
+        [[nodiscard]] std::size_t size() const {return mapped_size;}
+
+        // Returns true if there's a readable zero byte right after the data.
+        // The OS zero-fills the rest of the last page, so this is true unless the size is a multiple of the page size.
+        [[nodiscard]] bool HasNullTerminatorPastEnd() const;
+    };
+}
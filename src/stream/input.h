@@ -1,6 +1,7 @@
 #pragma once
 
 #include <algorithm>
+#include <bit>
 #include <concepts>
 #include <cstddef>
 #include <cstdint>
@@ -36,6 +37,15 @@ namespace Stream
         {
             [[nodiscard]] virtual bool operator()(char ch) const = 0;
             [[nodiscard]] virtual std::string name() const = 0;
+
+            // Returns the first character in the range that doesn't match, or `end` if all of them match.
+            // Must be equivalent to calling `operator()` on each character in order. Override this to avoid a virtual call per character.
+            [[nodiscard]] virtual const char *Scan(const char *begin, const char *end) const
+            {
+                while (begin != end && (*this)(*begin))
+                    begin++;
+                return begin;
+            }
         };
 
         // A category matching a single character.
@@ -50,6 +60,10 @@ namespace Stream
             {
                 return ch == saved_char;
             }
+            [[nodiscard]] const char *Scan(const char *begin, const char *end) const override
+            {
+                return std::find_if(begin, end, [ch = saved_char](char other){return other != ch;});
+            }
             [[nodiscard]] std::string name() const override
             {
                 return "`" + Strings::Escape(saved_char) + "`";
@@ -72,6 +86,12 @@ namespace Stream
             {
                 return func(ch);
             }
+            [[nodiscard]] const char *Scan(const char *begin, const char *end) const override
+            {
+                while (begin != end && func(*begin))
+                    begin++;
+                return begin;
+            }
             [[nodiscard]] std::string name() const override
             {
                 return name_str;
@@ -94,6 +114,12 @@ namespace Stream
                 {
                     return !base::operator()(ch);
                 }
+                [[nodiscard]] const char *Scan(const char *begin, const char *end) const override
+                {
+                    while (begin != end && !base::operator()(*begin))
+                        begin++;
+                    return begin;
+                }
                 [[nodiscard]] std::string name() const override
                 {
                     return "not " + T::name();
@@ -121,6 +147,12 @@ namespace Stream
             { \
                 [[nodiscard]] bool operator()(char ch) const override {return expr_;} \
                 [[nodiscard]] std::string name() const override {return string_;} \
+                [[nodiscard]] const char *Scan(const char *begin, const char *end) const override \
+                { \
+                    while (begin != end && class_name_::operator()(*begin)) \
+                        begin++; \
+                    return begin; \
+                } \
             };
 
         // Character categories corresponding to the functions from `<cctype>`:
@@ -169,6 +201,12 @@ namespace Stream
                 first_char = false;
                 return ok;
             }
+            [[nodiscard]] const char *Scan(const char *begin, const char *end) const override
+            {
+                while (begin != end && SeqIdentifier::operator()(*begin))
+                    begin++;
+                return begin;
+            }
 
             [[nodiscard]] std::string name() const override {return "an identifier";}
         };
@@ -217,6 +255,11 @@ namespace Stream
       public:
         static constexpr capacity_t default_capacity = capacity_t(512); // This is what `FILE *` appears to use by default.
 
+        // Passing this as the capacity picks it based on the stream size, from `default_capacity` to `max_adaptive_capacity`.
+        // Small streams then fit into a single buffer, and large ones need fewer reads.
+        static constexpr capacity_t adaptive_capacity = capacity_t(0);
+        static constexpr capacity_t max_adaptive_capacity = capacity_t(1 << 16);
+
         // Retrieves bytes from the underlying object.
         // Can throw on failure.
         // Will never be copied. If your functor is non-copyable, consider using `Meta::fake_copyable`.
@@ -256,6 +299,7 @@ namespace Stream
             std::string name;
 
             ReadOnlyData readonly_data_storage; // Optional. Set if the stream is based on a ReadOnlyData.
+            const std::uint8_t *memory = nullptr; // If the stream is based on a ReadOnlyData, points to its contents. Then the reads bypass the buffers.
         };
         Data data;
 
@@ -373,11 +417,14 @@ namespace Stream
 
         // Constructs a custom stream.
         // `buffer_capacity` is rounded down to the nearest positive power of two.
-        Input(std::string name, std::size_t size, read_func_t read_func, capacity_t buffer_capacity = default_capacity)
+        Input(std::string name, std::size_t size, read_func_t read_func, capacity_t buffer_capacity = adaptive_capacity)
         {
             if (Robust::not_representable_as<std::ptrdiff_t>(size))
                 Program::Error("Unable to create an input stream `", name, "`: the specified size is too large.");
 
+            if (buffer_capacity == adaptive_capacity)
+                buffer_capacity = capacity_t(std::clamp(std::bit_ceil(size), std::size_t(default_capacity), std::size_t(max_adaptive_capacity)));
+
             data.name = std::move(name);
             data.size = size;
             data.read = std::move(read_func);
@@ -400,6 +447,7 @@ namespace Stream
             data.buffer_capacity = std::numeric_limits<std::size_t>::max() / 2 + 1;
             data.buffer_a.position = 0;
             data.buffer_a.storage = const_cast<std::uint8_t *>(source.data()); // Since our functor is a null, this is safe.
+            data.memory = source.data();
 
             data.readonly_data_storage = std::move(source);
         }
@@ -407,7 +455,7 @@ namespace Stream
         // Attaches the stream to a file handle (without taking ownership).
         // The current position of the new stream is set to match the current position in the file,
         // but after that the stream expects the position in the file to not change between reads.
-        Input(std::string name, FILE *handle, capacity_t buffer_capacity = default_capacity)
+        Input(std::string name, FILE *handle, capacity_t buffer_capacity = adaptive_capacity)
         {
             FileHandleInfo info;
 
@@ -431,7 +479,7 @@ namespace Stream
         }
 
         // Attaches the stream to a file.
-        Input(std::string file_name, capacity_t buffer_capacity = default_capacity)
+        Input(std::string file_name, capacity_t buffer_capacity = adaptive_capacity)
         {
             auto deleter = [](FILE *file)
             {
@@ -469,11 +517,11 @@ namespace Stream
 
         // Attaches the stream to a file.
         // Without this helper, `Input(ReadOnlyData source)` would cause an ambiguity.
-        Input(const char *file_name, capacity_t buffer_capacity = default_capacity) : Input(std::string(file_name), buffer_capacity) {}
+        Input(const char *file_name, capacity_t buffer_capacity = adaptive_capacity) : Input(std::string(file_name), buffer_capacity) {}
 
         // Attaches the stream to a file.
         // Without this helper, `Input(ReadOnlyData source)` would cause an ambiguity.
-        Input(std::string_view file_name, capacity_t buffer_capacity = default_capacity) : Input(std::string(file_name), buffer_capacity) {}
+        Input(std::string_view file_name, capacity_t buffer_capacity = adaptive_capacity) : Input(std::string(file_name), buffer_capacity) {}
 
         Input(Input &&other) noexcept : data(std::exchange(other.data, {})) {}
         Input &operator=(Input other) noexcept
@@ -695,6 +743,8 @@ namespace Stream
         [[nodiscard]] std::uint8_t PeekByte()
         {
             ThrowIfNoData(1);
+            if (data.memory)
+                return data.memory[data.position];
             return NeedSegment(PositionToSegmentOffset(data.position)).ReadByte(data.position);
         }
         [[nodiscard]] char PeekChar()
@@ -765,6 +815,13 @@ namespace Stream
                 return;
             ThrowIfNoData(size);
 
+            if (data.memory)
+            {
+                std::copy_n(data.memory + data.position, size, buffer);
+                data.position += size;
+                return;
+            }
+
             std::size_t first_segment = PositionToSegmentOffset(data.position);
             std::size_t last_segment = PositionToSegmentOffset(data.position + size - 1);
 
@@ -835,8 +892,7 @@ namespace Stream
         void ReadWithByteOrder(ByteOrder::Order order, T *buffer, std::size_t count)
         {
             Read(reinterpret_cast<std::uint8_t *>(buffer), count * sizeof *buffer);
-            for (std::size_t i = 0; i < count; i++)
-                ByteOrder::Convert(buffer[i], order);
+            ByteOrder::ConvertSpan(buffer, count, order);
         }
         template <typename T>
         void ReadLittle(T *buffer, std::size_t count)
@@ -867,6 +923,33 @@ namespace Stream
 
             std::size_t count = 0;
 
+            if constexpr (several)
+            {
+                if (data.memory)
+                {
+                    // Scan the memory directly, with a single virtual call.
+                    const char *begin = reinterpret_cast<const char *>(data.memory) + data.position;
+                    const char *end = category.Scan(begin, reinterpret_cast<const char *>(data.memory) + data.size);
+                    count = end - begin;
+                    data.position += count;
+
+                    if constexpr (!std::is_null_pointer_v<T>)
+                    {
+                        if (append_to)
+                        {
+                            if constexpr (requires{append_to->insert(append_to->end(), begin, end);})
+                                append_to->insert(append_to->end(), begin, end);
+                            else
+                                std::for_each(begin, end, [&](char ch){append_to->push_back(std::uint8_t(ch));});
+                        }
+                    }
+
+                    if (throw_if_none && count == 0)
+                        Program::Error(GetExceptionPrefix() + "Expected " + category.name() + ".");
+                    return count;
+                }
+            }
+
             do
             {
                 if (!MoreData())
@@ -30,6 +30,9 @@ namespace Stream
     {
       public:
         static constexpr capacity_t default_capacity = capacity_t(512); // This is what `FILE *` appears to use by default.
+        // For the streams that write a lot of small values, to coalesce them into fewer and larger flushes.
+        // The files use this by default, since they're unbuffered and each flush is a separate system call.
+        static constexpr capacity_t large_capacity = capacity_t(1 << 16);
 
         // Flushes bytes to the underlying object.
         // Can throw on failure.
@@ -91,7 +94,7 @@ namespace Stream
         }
 
         // Constructs a stream bound to a file.
-        Output(std::string file_name, SaveMode mode = binary, capacity_t capacity = default_capacity)
+        Output(std::string file_name, SaveMode mode = binary, capacity_t capacity = large_capacity)
         {
             auto deleter = [](FILE *file)
             {
@@ -320,8 +323,21 @@ namespace Stream
         template <typename T>
         Output &WriteWithByteOrder(ByteOrder::Order order, const std::type_identity_t<T> *ptr, std::size_t count)
         {
-            for (std::size_t i = 0; i < count; i++)
-                WriteWithByteOrder<T>(order, ptr[i]);
+            if (order == ByteOrder::native || sizeof(T) == 1)
+                return WriteBytes(reinterpret_cast<const std::uint8_t *>(ptr), count * sizeof(T));
+
+            // Convert in chunks on the stack, to not modify the source.
+            constexpr std::size_t chunk_len = std::max(std::size_t(1), 512 / sizeof(T));
+            T chunk[chunk_len];
+            while (count > 0)
+            {
+                std::size_t len = std::min(count, chunk_len);
+                std::copy_n(ptr, len, chunk);
+                ByteOrder::ConvertSpan(chunk, len, order);
+                WriteBytes(reinterpret_cast<const std::uint8_t *>(chunk), len * sizeof(T));
+                ptr += len;
+                count -= len;
+            }
             return *this;
         }
         template <typename T>
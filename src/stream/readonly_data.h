@@ -14,6 +14,7 @@
 #include "macros/finally.h"
 #include "program/errors.h"
 #include "stream/better_fopen.h"
+#include "stream/file_mapping.h"
 #include "stream/utils.h"
 #include "strings/format.h"
 #include "utils/archive.h"
@@ -27,6 +28,8 @@ namespace Stream
         struct Data
         {
             std::unique_ptr<std::uint8_t[]> storage;
+            FileMapping mapping; // Used instead of `storage` for mapped files.
+            std::shared_ptr<const void> owner; // Keeps the referenced memory alive, if someone else owns it. E.g. an `AssetPack` mapping.
 
             const std::uint8_t *begin = 0, *end = 0;
             bool extra_null_terminator = false; // If this is `true`, there is an extra null terminator past the `end`.
@@ -61,6 +64,14 @@ namespace Stream
 
             return ret;
         }
+        // Stores a reference to a memory block owned by `owner`, and keeps the owner alive.
+        [[nodiscard]] static ReadOnlyData mem_reference(const std::uint8_t *begin, const std::uint8_t *end, std::shared_ptr<const void> owner, std::string name)
+        {
+            ReadOnlyData ret = mem_reference(begin, end);
+            ret.ref->owner = std::move(owner);
+            ret.ref->name = std::move(name);
+            return ret;
+        }
         // Stores a reference to an existing memory block.
         [[nodiscard]] static ReadOnlyData mem_reference(const char *begin, const char *end)
         {
@@ -158,6 +169,29 @@ namespace Stream
             return ret;
         }
 
+        // Maps an entire file into memory, instead of reading it. The OS loads the pages lazily, when they're accessed.
+        // Prefer this for large files that are only read once, or only partially.
+        // Unlike `file()`, this doesn't guarantee the null-terminator. `string()` adds it (by copying) if necessary.
+        // Don't use this for the files that can be modified while they're loaded, see `FileMapping` for details.
+        [[nodiscard]] static ReadOnlyData map_file(std::string file_name)
+        {
+            ReadOnlyData ret;
+            ret.ref = std::make_shared<Data>();
+
+            ret.ref->mapping = FileMapping(file_name);
+
+            ret.ref->begin = ret.ref->mapping.data();
+            ret.ref->end = ret.ref->begin + ret.ref->mapping.size();
+            ret.ref->extra_null_terminator = ret.ref->mapping.HasNullTerminatorPastEnd();
+            ret.ref->name = std::move(file_name);
+
+            return ret;
+        }
+
+        // Like `map_file()`, but if the file is in `Program::ExeDir()`, and `AssetPack::Default()` has it (by the name relative to that directory), it's loaded from the pack.
+        // Defined in `asset_pack.cpp`.
+        [[nodiscard]] static ReadOnlyData from_pack(std::string file_name);
+
         [[nodiscard]] explicit operator bool() const
         {
             return bool(ref);
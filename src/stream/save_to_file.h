@@ -64,13 +64,10 @@ namespace Stream
 
 
     // Saves a block of memory to a file, in a compressed form (see `archive.h` for details). Throws on failure.
-    inline void SaveFileCompressed(std::string file_name, const std::uint8_t *begin, const std::uint8_t *end)
-    {
-        auto buffer_size = Archive::MaxCompressedSize(begin, end);
-        auto buffer = std::make_unique<std::uint8_t[]>(buffer_size);
-        auto compressed_end = Archive::Compress(begin, end, buffer.get(), buffer.get() + buffer_size);
-        SaveFile(file_name, buffer.get(), compressed_end);
-    }
+    // The large data uses the block format (see `Archive::Blocks`), which is compressed in parallel.
+    // The rest is compressed in chunks while writing it (see `CompressingOutput()`), so the whole compressed copy is never in memory.
+    // Defined in `compression.cpp`.
+    void SaveFileCompressed(std::string file_name, const std::uint8_t *begin, const std::uint8_t *end);
 
     // Saves a block of memory to a file, in a compressed form (see `archive.h` for details). Throws on failure.
     inline void SaveFileCompressed(std::string file_name, const char *begin, const char *end)
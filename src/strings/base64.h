@@ -0,0 +1,52 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "program/errors.h"
+
+namespace Strings
+{
+    // Decodes a base64 string, using the standard alphabet (`+` and `/`). Throws on failure.
+    // The padding (`=`) is optional, whitespace is not allowed.
+    [[nodiscard]] inline std::vector<std::uint8_t> DecodeBase64(std::string_view str)
+    {
+        static constexpr std::array<signed char, 256> table = []{
+            std::array<signed char, 256> ret{};
+            ret.fill(-1);
+            constexpr std::string_view alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+            for (std::size_t i = 0; i < alphabet.size(); i++)
+                ret[(unsigned char)alphabet[i]] = (signed char)i;
+            return ret;
+        }();
+
+        while (str.ends_with('='))
+            str.remove_suffix(1);
+        if (str.size() % 4 == 1)
+            Program::Error("Invalid base64 string length.");
+
+        std::vector<std::uint8_t> ret;
+        ret.reserve(str.size() * 3 / 4);
+
+        std::uint32_t accum = 0;
+        int accum_bits = 0;
+        for (char ch : str)
+        {
+            int value = table[(unsigned char)ch];
+            if (value < 0)
+                Program::Error("Invalid character in a base64 string.");
+
+            accum = (accum << 6) | std::uint32_t(value);
+            accum_bits += 6;
+            if (accum_bits >= 8)
+            {
+                accum_bits -= 8;
+                ret.push_back(std::uint8_t(accum >> accum_bits));
+            }
+        }
+
+        return ret;
+    }
+}
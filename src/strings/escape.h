@@ -2,18 +2,136 @@
 
 #include <array>
 #include <cassert>
+#include <algorithm>
 #include <cctype>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <iterator>
 #include <string>
+#include <string_view>
 #include <type_traits>
 #include <utility>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include "program/errors.h"
 #include "utils/unicode.h"
 
 namespace Strings
 {
+    namespace impl::EscapeScan
+    {
+        // Those check 8 bytes at a time, see "Bit Twiddling Hacks".
+        [[nodiscard]] constexpr std::uint64_t RepeatByte(unsigned char byte) {return 0x0101010101010101ull * byte;}
+        [[nodiscard]] constexpr bool HasZeroByte(std::uint64_t word) {return (word - RepeatByte(1)) & ~word & RepeatByte(0x80);}
+        [[nodiscard]] constexpr bool HasByte(std::uint64_t word, unsigned char byte) {return HasZeroByte(word ^ RepeatByte(byte));}
+        // `limit` must be at most 128.
+        [[nodiscard]] constexpr bool HasByteLessThan(std::uint64_t word, unsigned char limit) {return (word - RepeatByte(limit)) & ~word & RepeatByte(0x80);}
+
+        // The bytes that end a clean run. This can include more bytes than necessary, then `is_clean` in `CleanPrefixLen()` makes the final decision.
+        struct SpecialBytes
+        {
+            unsigned char less_than = 0; // The bytes less than this, at most 128. 0 if none.
+            bool extended = false; // Bytes 128..255.
+            std::array<unsigned char, 3> bytes{}; // Individual bytes, the first `num_bytes` of them.
+            int num_bytes = 0;
+
+            void Add(unsigned char byte)
+            {
+                bytes[num_bytes++] = byte;
+            }
+
+            [[nodiscard]] bool WordIsClean(std::uint64_t word) const
+            {
+                if (less_than && HasByteLessThan(word, less_than))
+                    return false;
+                if (extended && (word & RepeatByte(0x80)))
+                    return false;
+                for (int i = 0; i < num_bytes; i++)
+                {
+                    if (HasByte(word, bytes[i]))
+                        return false;
+                }
+                return true;
+            }
+        };
+
+        // Returns the length of the prefix of `str` consisting of characters for which `is_clean(ch)` returns true.
+        // Skips 16 bytes at a time with SSE2 or NEON, and 8 bytes at a time otherwise, then checks the block containing a special byte one byte at a time.
+        template <typename F>
+        [[nodiscard]] std::size_t CleanPrefixLen(std::string_view str, const SpecialBytes &special, F &&is_clean)
+        {
+            #if defined(__SSE2__)
+            __m128i less_than = _mm_set1_epi8(char(special.less_than - 1));
+            __m128i bytes[3];
+            for (int i = 0; i < special.num_bytes; i++)
+                bytes[i] = _mm_set1_epi8(char(special.bytes[i]));
+            auto BlockIsClean = [&](const char *ptr)
+            {
+                __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ptr));
+                __m128i ret = _mm_setzero_si128();
+                if (special.less_than)
+                    ret = _mm_cmpeq_epi8(_mm_min_epu8(block, less_than), block); // Unsigned `block <= less_than - 1`.
+                if (special.extended)
+                    ret = _mm_or_si128(ret, block); // Only the high bits matter.
+                for (int i = 0; i < special.num_bytes; i++)
+                    ret = _mm_or_si128(ret, _mm_cmpeq_epi8(block, bytes[i]));
+                return _mm_movemask_epi8(ret) == 0;
+            };
+            #elif defined(__aarch64__) && defined(__ARM_NEON)
+            uint8x16_t less_than = vdupq_n_u8(special.less_than);
+            uint8x16_t bytes[3];
+            for (int i = 0; i < special.num_bytes; i++)
+                bytes[i] = vdupq_n_u8(special.bytes[i]);
+            auto BlockIsClean = [&](const char *ptr)
+            {
+                uint8x16_t block = vld1q_u8(reinterpret_cast<const std::uint8_t *>(ptr));
+                uint8x16_t ret = vcltq_u8(block, less_than); // All zeroes if `less_than == 0`.
+                if (special.extended)
+                    ret = vorrq_u8(ret, block); // Any high bit makes the max at least 128.
+                for (int i = 0; i < special.num_bytes; i++)
+                    ret = vorrq_u8(ret, vceqq_u8(block, bytes[i]));
+                return vmaxvq_u8(ret) < 0x80;
+            };
+            #endif
+
+            std::size_t i = 0;
+            while (true)
+            {
+                #if defined(__SSE2__) || (defined(__aarch64__) && defined(__ARM_NEON))
+                while (str.size() - i >= 16 && BlockIsClean(str.data() + i))
+                    i += 16;
+                #endif
+
+                while (str.size() - i >= 8)
+                {
+                    std::uint64_t word;
+                    std::memcpy(&word, str.data() + i, 8);
+                    if (!special.WordIsClean(word))
+                        break;
+                    i += 8;
+                }
+
+                // Check the next 8 bytes one by one.
+                std::size_t word_end = std::min(str.size(), i + 8);
+                for (; i < word_end; i++)
+                {
+                    if (!is_clean((unsigned char)str[i]))
+                        return i;
+                }
+                if (i == str.size())
+                    return i;
+            }
+        }
+    }
+
     enum class EscapeFlags
     {
         no_flags = 0,
@@ -30,39 +148,61 @@ namespace Strings
     // Escapes a string.
     // By default, all control characters are escaped, including `\n` and `\r`, and extended (>= 128) characters are not escaped.
     // If a character can't be escaped with a single symbol (\?), then \xNN is always used.
-    template <typename Iter> requires requires(Iter i){*i++ = char();}
-    void Escape(std::string_view str, Iter output_iter, EscapeFlags flags = EscapeFlags::no_flags)
+    // `append(std::string_view)` is called with the parts of the result. The runs of characters that don't need escaping are found 16 bytes at a time (or 8 without SIMD), and are passed as a whole.
+    template <typename F> requires std::invocable<F &, std::string_view>
+    void Escape(std::string_view str, F &&append, EscapeFlags flags = EscapeFlags::no_flags)
     {
         auto OutputString = [&](const char *ptr)
         {
-            while (*ptr)
-                *output_iter++ = *ptr++;
+            append(std::string_view(ptr));
         };
 
-        for (unsigned char ch : str)
-        {
-            // Skip `\r` if we have the `strip_cr` flag.
-            if (bool(flags & EscapeFlags::strip_cr) && ch == '\r')
-                continue;
+        bool escape_extended = bool(flags & EscapeFlags::escape_extended_chars);
+        bool escape_single_quotes = bool(flags & EscapeFlags::escape_single_quotes);
+        bool escape_double_quotes = bool(flags & EscapeFlags::escape_double_quotes);
 
-            bool should_escape =
+        // Whether the character is copied as is.
+        auto IsClean = [&](unsigned char ch)
+        {
+            return !(
                 // Escape 0..31, except for `\n` if we have the `multiline` flag.
                 (ch < ' ' && (!bool(flags & EscapeFlags::multiline) || ch != '\n')) ||
                 // Escape `DEL`.
                 ch == 0x7f ||
                 // Escape 128..255 if we have the `escape_extended_chars` flag.
-                (bool(flags & EscapeFlags::escape_extended_chars) && ch >= 128) ||
+                (escape_extended && ch >= 128) ||
                 // Escape single quotes if the corresponding flag is set.
-                (bool(flags & EscapeFlags::escape_single_quotes) && ch == '\'') ||
+                (escape_single_quotes && ch == '\'') ||
                 // Escape double quotes if the corresponding flag is set.
-                (bool(flags & EscapeFlags::escape_double_quotes) && ch == '\"');
+                (escape_double_quotes && ch == '\"')
+            );
+        };
+        // Conservative, includes `\n` even with the `multiline` flag.
+        impl::EscapeScan::SpecialBytes special{.less_than = ' ', .extended = escape_extended};
+        special.Add(0x7f);
+        if (escape_single_quotes)
+            special.Add('\'');
+        if (escape_double_quotes)
+            special.Add('\"');
 
-            if (!should_escape)
+        while (!str.empty())
+        {
+            std::size_t clean_len = impl::EscapeScan::CleanPrefixLen(str, special, IsClean);
+            if (clean_len > 0)
             {
-                *output_iter++ = ch;
-                continue;
+                append(str.substr(0, clean_len));
+                str.remove_prefix(clean_len);
+                if (str.empty())
+                    break;
             }
 
+            unsigned char ch = str.front();
+            str.remove_prefix(1);
+
+            // Skip `\r` if we have the `strip_cr` flag.
+            if (bool(flags & EscapeFlags::strip_cr) && ch == '\r')
+                continue;
+
             switch (ch)
             {
                 case '\0': OutputString(R"(\0)"); break;
@@ -87,10 +227,16 @@ namespace Strings
             }
         }
     }
+    template <typename Iter> requires requires(Iter i){*i++ = char();}
+    void Escape(std::string_view str, Iter output_iter, EscapeFlags flags = EscapeFlags::no_flags)
+    {
+        Escape(str, [&](std::string_view part){output_iter = std::copy(part.begin(), part.end(), output_iter);}, flags);
+    }
     [[nodiscard]] inline std::string Escape(std::string_view str, EscapeFlags flags = EscapeFlags::no_flags)
     {
         std::string ret;
-        Escape(str, std::back_inserter(ret), flags);
+        ret.reserve(str.size());
+        Escape(str, [&](std::string_view part){ret += part;}, flags);
         return ret;
     }
 
@@ -112,12 +258,30 @@ namespace Strings
     // Supports following escape sequences: \', \", \\, \a, \b, \f, \n, \r, \t, \v.
     // Doesn't support \?, because it's stupid.
     // Additionally supports octal \[0-7]{1,3}, hex \x[a-zA-Z0-9]{1,2}, and unicode \u[a-zA-Z0-9]{4}, \U[a-zA-Z0-9]{8} escapes.
-    template <typename Iter> requires requires(Iter i){*i++ = char();}
-    void Unescape(std::string_view str, Iter output_iter, UnescapeFlags flags = UnescapeFlags::no_flags)
+    // `append(std::string_view)` is called with the parts of the result. Like in `Escape()`, the runs without escapes are found a block at a time.
+    template <typename F> requires std::invocable<F &, std::string_view>
+    void Unescape(std::string_view str, F &&append, UnescapeFlags flags = UnescapeFlags::no_flags)
     {
         auto cur = str.begin();
         const auto end = str.end();
 
+        bool strip_cr = bool(flags & UnescapeFlags::strip_cr_bytes);
+        auto IsClean = [&](unsigned char ch) {return ch != '\\' && (!strip_cr || ch != '\r');};
+        impl::EscapeScan::SpecialBytes special;
+        special.Add('\\');
+        if (strip_cr)
+            special.Add('\r');
+
+        // Mimic an output iterator for the individual characters.
+        struct CharOutput
+        {
+            F &append;
+            CharOutput &operator*() {return *this;}
+            CharOutput &operator++(int) {return *this;}
+            void operator=(char ch) {append(std::string_view(&ch, 1));}
+        };
+        CharOutput output_iter{append};
+
         std::array<char, 9> buffer; // The max amount of digits we might need to read is 8 (for \U escape), and we need room for a null-terminator.
 
         // `pred` is `bool pred(char)`.
@@ -139,11 +303,14 @@ namespace Strings
 
         while (cur < end)
         {
-            if (*cur != '\\')
+            if (std::size_t clean_len = impl::EscapeScan::CleanPrefixLen(std::string_view(cur, end), special, IsClean))
+            {
+                append(std::string_view(cur, cur + clean_len));
+                cur += clean_len;
+            }
+            else if (*cur != '\\')
             {
-                if (!bool(flags & UnescapeFlags::strip_cr_bytes) || *cur != '\r')
-                    *output_iter++ = *cur;
-                cur++;
+                cur++; // A `\r` that we strip.
             }
             else
             {
@@ -229,10 +396,16 @@ namespace Strings
             }
         }
     }
+    template <typename Iter> requires requires(Iter i){*i++ = char();}
+    void Unescape(std::string_view str, Iter output_iter, UnescapeFlags flags = UnescapeFlags::no_flags)
+    {
+        Unescape(str, [&](std::string_view part){output_iter = std::copy(part.begin(), part.end(), output_iter);}, flags);
+    }
     [[nodiscard]] inline std::string Unescape(std::string_view str, UnescapeFlags flags = UnescapeFlags::no_flags)
     {
         std::string ret;
-        Unescape(str, std::back_inserter(ret), flags);
+        ret.reserve(str.size());
+        Unescape(str, [&](std::string_view part){ret += part;}, flags);
         return ret;
     }
 }
@@ -31,6 +31,10 @@
  *   that can be passed into various libfmt functions.
  *   `FORMAT_ARGS_SIMPLE` is mostly useless, because you might as well use `FMT_STRING` directly.
  *
+ * Formatting into existing storage: `FMT_TO(buffer, "format", ...)` and `STR_TO(buffer, ...)`.
+ *   The buffer is either an `std::string` (which reuses its capacity) or a fixed-capacity `Strings::InlineString<N>` (which never allocates).
+ *   The buffer is overwritten, and a reference to it is returned.
+ *
  * Alternative prefixed names:
  *   If `FMT` and `STR` interfer with something, you can undefine them and use `FORMAT_FMT` and `FORMAT_STR` instead.
  *
@@ -40,6 +44,7 @@
  *   for the string literal prefix (e.g. `L`), which can be empty.
  */
 
+#include <algorithm>
 #include <array>
 #include <cstddef>
 #include <initializer_list>
@@ -88,6 +93,70 @@ namespace Strings
     }
 
 
+    // A string with a fixed capacity of `N` characters, stored inline. Longer strings are silently truncated.
+    // Good as a target for `FMT_TO(...)` and `STR_TO(...)`, if the maximum length is known.
+    template <std::size_t N, typename C = char>
+    class InlineString
+    {
+        std::size_t len = 0;
+        C storage[N + 1]{}; // Null-terminated.
+
+      public:
+        using value_type = C;
+
+        InlineString() {}
+
+        [[nodiscard]] static constexpr std::size_t capacity() {return N;}
+
+        [[nodiscard]] std::size_t size() const {return len;}
+        [[nodiscard]] bool empty() const {return len == 0;}
+
+        [[nodiscard]] const C *data() const {return storage;}
+        [[nodiscard]] const C *c_str() const {return storage;}
+
+        [[nodiscard]] std::basic_string_view<C> view() const {return {storage, len};}
+        [[nodiscard]] operator std::basic_string_view<C>() const {return view();}
+
+        void clear()
+        {
+            len = 0;
+            storage[0] = C{};
+        }
+
+        // Formats into this string, replacing the old contents. Prefer `FMT_TO()` and `STR_TO()`.
+        template <typename ...P>
+        InlineString &Format(::fmt::basic_format_string<std::type_identity_t<C>, std::type_identity_t<P>...> format, P &&... params)
+        {
+            len = std::min(std::size_t(::fmt::format_to_n(storage, N, format, std::forward<P>(params)...).size), N);
+            storage[len] = C{};
+            return *this;
+        }
+    };
+
+    // Formats into `buffer`, replacing the old contents. Prefer `FMT_TO()` and `STR_TO()`.
+    // Reuses the existing capacity of the string, so this doesn't allocate once the buffer is large enough.
+    // Works with any allocator, e.g. with `std::pmr::string` allocated from a `FrameArena`.
+    template <typename C, typename Tr, typename A, typename ...P>
+    std::basic_string<C, Tr, A> &FormatTo(std::basic_string<C, Tr, A> &buffer, ::fmt::basic_format_string<std::type_identity_t<C>, std::type_identity_t<P>...> format, P &&... params)
+    {
+        buffer.clear();
+        ::fmt::format_to(std::back_inserter(buffer), format, std::forward<P>(params)...);
+        return buffer;
+    }
+    // Same, but appends to the old contents. Prefer `FMT_APPEND()` and `STR_APPEND()`.
+    template <typename C, typename Tr, typename A, typename ...P>
+    std::basic_string<C, Tr, A> &FormatAppend(std::basic_string<C, Tr, A> &buffer, ::fmt::basic_format_string<std::type_identity_t<C>, std::type_identity_t<P>...> format, P &&... params)
+    {
+        ::fmt::format_to(std::back_inserter(buffer), format, std::forward<P>(params)...);
+        return buffer;
+    }
+    template <std::size_t N, typename C, typename ...P>
+    InlineString<N, C> &FormatTo(InlineString<N, C> &buffer, ::fmt::basic_format_string<std::type_identity_t<C>, std::type_identity_t<P>...> format, P &&... params)
+    {
+        return buffer.Format(format, std::forward<P>(params)...);
+    }
+
+
     // Internal, used by the macros below.
     namespace impl::Format
     {
@@ -138,6 +207,13 @@ namespace Strings
 #define FMT(...) FORMAT_FMT(__VA_ARGS__)
 #define FORMAT_FMT(...) ::fmt::format(FORMAT_ARGS_SIMPLE(__VA_ARGS__))
 
+// Same as `FMT(...)`, but formats into an existing `std::string` or `Strings::InlineString<N>`, replacing its contents. Returns a reference to it.
+#define FMT_TO(buffer, ...) FORMAT_FMT_TO(buffer, __VA_ARGS__)
+#define FORMAT_FMT_TO(buffer, ...) ::Strings::FormatTo(buffer, FORMAT_ARGS_SIMPLE(__VA_ARGS__))
+// Same as `FMT_TO(...)`, but appends to the existing contents of a `std::basic_string`.
+#define FMT_APPEND(buffer, ...) FORMAT_FMT_APPEND(buffer, __VA_ARGS__)
+#define FORMAT_FMT_APPEND(buffer, ...) ::Strings::FormatAppend(buffer, FORMAT_ARGS_SIMPLE(__VA_ARGS__))
+
 // A convenience macro. On MSVC `FORMAT_ARGS_SIMPLE(string, ...)` expands to `FMT_STRING(string), ...`,
 // where `FMT_STRING` is a libfmt macro that enables the compile-time format string validation.
 // On other compilers it's an identity macro, since the validation works without `FMT_STRING` (which sometimes causes weird warnings on Clang).
@@ -170,6 +246,14 @@ namespace Strings
 #define FORMAT_STR(...) ::fmt::format(FORMAT_ARGS(__VA_ARGS__))
 // Another name for `STR_(...)`.
 #define FORMAT_STR_(prefix, ...) ::fmt::format(FORMAT_ARGS_(prefix, __VA_ARGS__))
+// Same as `STR(...)`, but formats into an existing `std::string` or `Strings::InlineString<N>`, replacing its contents. Returns a reference to it.
+#define STR_TO(buffer, ...) FORMAT_STR_TO(buffer, __VA_ARGS__)
+// Another name for `STR_TO(...)`.
+#define FORMAT_STR_TO(buffer, ...) ::Strings::FormatTo(buffer, FORMAT_ARGS(__VA_ARGS__))
+// Same as `STR_TO(...)`, but appends to the existing contents of a `std::basic_string`.
+#define STR_APPEND(buffer, ...) FORMAT_STR_APPEND(buffer, __VA_ARGS__)
+// Another name for `STR_APPEND(...)`.
+#define FORMAT_STR_APPEND(buffer, ...) ::Strings::FormatAppend(buffer, FORMAT_ARGS(__VA_ARGS__))
 
 // A convenience macro. Expands to a compile-time format string (similar to `FMT_STRING`), followed by a comma-separate argument list.
 // See the comments on `STR(...)` for the syntax.
@@ -3,13 +3,16 @@
 #include <algorithm>
 #include <cctype>
 #include <cerrno>
+#include <charconv>
 #include <cmath>
 #include <cstddef>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <limits>
+#include <span>
 #include <string>
+#include <system_error>
 
 #include <double-conversion/double-conversion.h>
 
@@ -58,6 +61,49 @@ namespace Strings
             }
         }
 
+        // Parses an integer in the same format as `strto*` with base 0: an optional sign, then `0x` for hex, or a leading `0` for octal.
+        // Unlike those, uses `std::from_chars()`, so it doesn't depend on the locale, doesn't skip whitespace, and only accepts an exact match.
+        // Returns false on failure, including the out-of-range values.
+        template <std::integral T>
+        [[nodiscard]] bool ParseInt(const char *begin, const char *end, T &result)
+        {
+            bool negative = false;
+            if (begin != end && (*begin == '+' || *begin == '-'))
+                negative = *begin++ == '-';
+
+            int base = 10;
+            if (end - begin >= 2 && begin[0] == '0' && (begin[1] == 'x' || begin[1] == 'X'))
+            {
+                base = 16;
+                begin += 2;
+            }
+            else if (end - begin >= 2 && begin[0] == '0')
+            {
+                base = 8;
+                begin++;
+            }
+
+            unsigned long long magnitude = 0;
+            auto [ptr, ec] = std::from_chars(begin, end, magnitude, base);
+            if (ec != std::errc{} || ptr != end || ptr == begin)
+                return false;
+
+            if constexpr (std::is_signed_v<T>)
+            {
+                using U = std::make_unsigned_t<T>;
+                if (magnitude > (unsigned long long)(std::numeric_limits<T>::max()) + negative)
+                    return false;
+                result = T(negative ? U(0) - U(magnitude) : U(magnitude));
+            }
+            else
+            {
+                if ((negative && magnitude != 0) || magnitude > (unsigned long long)(std::numeric_limits<T>::max()))
+                    return false;
+                result = T(magnitude);
+            }
+            return true;
+        }
+
         template <typename T>
         [[noreturn]] void ConversionFailure(std::string_view str, std::string_view message = "")
         {
@@ -144,15 +190,17 @@ namespace Strings
                 return false;
             std::strcpy(buffer, number ? "true" : "false");
         }
-        else if constexpr (std::is_integral_v<T> && std::is_signed_v<T>)
+        else if constexpr (std::is_integral_v<T>)
         {
-            if (std::snprintf(buffer, buffer_size, "%lld", (long long)number) <= 0)
+            if (buffer_size == 0)
                 return false;
-        }
-        else if constexpr (std::is_integral_v<T> && std::is_unsigned_v<T>)
-        {
-            if (std::snprintf(buffer, buffer_size, "%llu", (unsigned long long)number) <= 0)
+            // `-1` because we need space for a null-terminator.
+            auto [end, ec] = std::is_signed_v<T>
+                ? std::to_chars(buffer, buffer + buffer_size - 1, (long long)number)
+                : std::to_chars(buffer, buffer + buffer_size - 1, (unsigned long long)number);
+            if (ec != std::errc{})
                 return false;
+            *end = '\0';
         }
         else if constexpr (sizeof(T) <= sizeof(double))
         {
@@ -293,11 +341,8 @@ namespace Strings
             if (prev_is_separator)
                 impl::ConversionFailure<T>(str, "incorrect separator usage");
 
-            buf[buf_pos] = '\0';
-
-            const char *end = buf;
-            T result = strto<T>(buf, &end);
-            if (end != buf + buf_pos)
+            T result{};
+            if (!impl::ParseInt(buf, buf + buf_pos, result))
                 impl::ConversionFailure<T>(str);
 
             return result;
@@ -337,6 +382,35 @@ namespace Strings
         }
     }
 
+    // Parses integers separated by whitespace and/or commas from `str` into `out`, in the same format as `FromString()`.
+    // Returns the number of parsed integers. Throws on a malformed number, or if there are more numbers than `out` can fit.
+    // Faster than calling `FromString()` for each number, since the common case (no digit separators) is parsed in place.
+    template <std::integral T>
+    std::size_t ParseInts(std::string_view str, std::span<T> out)
+    {
+        auto IsDelim = [](char ch) {return ch == ',' || std::isspace((unsigned char)ch);};
+
+        std::size_t count = 0;
+        const char *cur = str.data(), *str_end = str.data() + str.size();
+        while (true)
+        {
+            cur = std::find_if_not(cur, str_end, IsDelim);
+            if (cur == str_end)
+                break;
+            const char *end = std::find_if(cur, str_end, IsDelim);
+
+            if (count >= out.size())
+                impl::ConversionFailure<T>(str, FMT("expected at most {} numbers", out.size()));
+
+            // On failure, let `FromString()` handle the digit separators, or produce the error message.
+            if (!impl::ParseInt(cur, end, out[count]))
+                out[count] = FromString<T>(std::string_view(cur, end));
+            count++;
+            cur = end;
+        }
+        return count;
+    }
+
     // Works as either `ToString` (T = std::string) or `FromString()` (T is arithmetic).
     // Throws on failure.
     template <std::same_as<std::string> T, Meta::deduce..., typename U>
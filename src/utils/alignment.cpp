@@ -0,0 +1,59 @@
+#include "alignment.h"
+
+#include "program/alloc_stats.h"
+#include "program/platform.h"
+
+#if IMP_PLATFORM_IS(windows)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace Storage::impl
+{
+    void *AllocatePages(std::size_t bytes)
+    {
+        if (bytes > std::size_t(-1) - huge_page_size * 2)
+            throw std::bad_alloc{}; // The alignment below would overflow.
+
+        #if IMP_PLATFORM_IS(windows)
+        void *ret = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+        if (!ret)
+            throw std::bad_alloc{};
+        Program::AllocStats::AddExternalAlloc(bytes);
+        return ret;
+        #else
+        // Map one huge page more than needed, to be able to align the start, then unmap the extra parts on both sides.
+        // The huge pages can only be used for the aligned parts of the mapping.
+        std::size_t size = Align<huge_page_size>(bytes);
+        std::size_t mapped_size = size + huge_page_size;
+        void *mapped = mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED)
+            throw std::bad_alloc{};
+
+        char *begin = Align<huge_page_size>(static_cast<char *>(mapped));
+        std::size_t head = std::size_t(begin - static_cast<char *>(mapped));
+        if (head > 0)
+            munmap(mapped, head);
+        if (mapped_size - head - size > 0)
+            munmap(begin + size, mapped_size - head - size);
+
+        #ifdef MADV_HUGEPAGE
+        madvise(begin, size, MADV_HUGEPAGE); // Only a hint. Fails if the kernel has no transparent huge pages, that's fine.
+        #endif
+        Program::AllocStats::AddExternalAlloc(bytes);
+        return begin;
+        #endif
+    }
+
+    void FreePages(void *ptr, std::size_t bytes) noexcept
+    {
+        Program::AllocStats::AddExternalFree(bytes);
+        #if IMP_PLATFORM_IS(windows)
+        (void)bytes;
+        VirtualFree(ptr, 0, MEM_RELEASE);
+        #else
+        munmap(ptr, Align<huge_page_size>(bytes));
+        #endif
+    }
+}
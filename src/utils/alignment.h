@@ -1,6 +1,8 @@
 #pragma once
 
 #include <cstddef>
+#include <new>
+#include <type_traits>
 
 #include "utils/bit_manip.h"
 
@@ -29,4 +31,101 @@ namespace Storage
         static_assert(sizeof(std::size_t) >= sizeof(void *)); // If this somehow fires, the integral overload of `Align` must be rewritten to use `uintptr_t`.
         return reinterpret_cast<T *>(Align<Alignment>(reinterpret_cast<std::size_t>(ptr)));
     }
+
+    // An allocator that aligns the storage to `Alignment` bytes, or to `alignof(T)` if that's larger.
+    // Usable with `std::vector` and `MultiArray`, e.g. `std::vector<float, Storage::AlignedAllocator<float, 32>>` for the AVX loads.
+    template <typename T, std::size_t Alignment = 64>
+    struct AlignedAllocator
+    {
+        static_assert(is_valid_alignment_v<Alignment>, "The alignment is invalid.");
+
+        using value_type = T;
+        static constexpr std::align_val_t alignment = std::align_val_t(Alignment > alignof(T) ? Alignment : alignof(T));
+
+        // Needed because of the non-type template parameter.
+        template <typename U>
+        struct rebind {using other = AlignedAllocator<U, Alignment>;};
+
+        AlignedAllocator() = default;
+        template <typename U> AlignedAllocator(const AlignedAllocator<U, Alignment> &) noexcept {}
+
+        [[nodiscard]] static constexpr std::size_t max_size() noexcept
+        {
+            return std::size_t(-1) / sizeof(T);
+        }
+
+        [[nodiscard]] T *allocate(std::size_t n)
+        {
+            if (n > max_size())
+                throw std::bad_array_new_length{}; // Like `std::allocator`, instead of overflowing the size.
+            return static_cast<T *>(::operator new(n * sizeof(T), alignment));
+        }
+        void deallocate(T *ptr, std::size_t n) noexcept
+        {
+            ::operator delete(ptr, n * sizeof(T), alignment);
+        }
+
+        template <typename U> [[nodiscard]] bool operator==(const AlignedAllocator<U, Alignment> &) const noexcept {return true;}
+    };
+
+    // The size of a huge page on x86 and ARM64 (with 4 KiB pages).
+    inline constexpr std::size_t huge_page_size = std::size_t(1) << 21;
+
+    namespace impl
+    {
+        // Maps the memory directly from the OS. On Linux it's aligned to `huge_page_size`, and is marked for the transparent huge pages.
+        // Elsewhere it's only page-aligned. Throws `std::bad_alloc` on failure.
+        // This bypasses `operator new`, so it reports the memory to `Program::AllocStats` manually.
+        [[nodiscard]] void *AllocatePages(std::size_t bytes);
+        // `bytes` must be the same as in `AllocatePages()`.
+        void FreePages(void *ptr, std::size_t bytes) noexcept;
+    }
+
+    // An allocator for the multi-megabyte buffers. The allocations of at least `Threshold` bytes are mapped from the OS directly,
+    // on Linux with a hint to back them with the transparent huge pages, which means less TLB misses when they're traversed.
+    // They are returned to the OS when freed, instead of staying in the heap. The smaller allocations use `AlignedAllocator`.
+    // On Windows the large pages need a special privilege, so those buffers use the normal pages.
+    template <typename T, std::size_t Alignment = 64, std::size_t Threshold = huge_page_size>
+    struct LargeBufferAllocator
+    {
+        static_assert(is_valid_alignment_v<Alignment>, "The alignment is invalid.");
+        static_assert(Alignment <= 4096 && alignof(T) <= 4096, "The mapped memory is only guaranteed to be page-aligned.");
+
+        using value_type = T;
+
+        template <typename U>
+        struct rebind {using other = LargeBufferAllocator<U, Alignment, Threshold>;};
+
+        LargeBufferAllocator() = default;
+        template <typename U> LargeBufferAllocator(const LargeBufferAllocator<U, Alignment, Threshold> &) noexcept {}
+
+        [[nodiscard]] static constexpr std::size_t max_size() noexcept
+        {
+            return std::size_t(-1) / sizeof(T);
+        }
+
+        // `n` must be at most `max_size()`.
+        [[nodiscard]] static bool IsLarge(std::size_t n)
+        {
+            return n * sizeof(T) >= Threshold;
+        }
+
+        [[nodiscard]] T *allocate(std::size_t n)
+        {
+            if (n > max_size())
+                throw std::bad_array_new_length{};
+            if (IsLarge(n))
+                return static_cast<T *>(impl::AllocatePages(n * sizeof(T)));
+            return AlignedAllocator<T, Alignment>{}.allocate(n);
+        }
+        void deallocate(T *ptr, std::size_t n) noexcept
+        {
+            if (IsLarge(n))
+                impl::FreePages(ptr, n * sizeof(T));
+            else
+                AlignedAllocator<T, Alignment>{}.deallocate(ptr, n);
+        }
+
+        template <typename U> [[nodiscard]] bool operator==(const LargeBufferAllocator<U, Alignment, Threshold> &) const noexcept {return true;}
+    };
 }
@@ -5,6 +5,7 @@
 #include <zlib.h>
 
 #include "program/errors.h"
+#include "utils/jobs.h"
 #include "utils/robust_math.h"
 
 namespace Archive
@@ -65,11 +66,36 @@ namespace Archive
         return Raw::Compress(src_begin, src_end, dst_begin + sizeof(size_type), dst_end);
     }
 
+    static void WriteSize(size_type value, uint8_t *dst)
+    {
+        for (std::size_t i = 0; i < sizeof(size_type); i++)
+            dst[i] = (value >> (i * 8)) & 0xff;
+    }
+
+    [[nodiscard]] static size_type ReadSize(const uint8_t *src)
+    {
+        size_type ret = 0;
+        for (std::size_t i = 0; i < sizeof(size_type); i++)
+            ret |= (size_type(src[i]) << (i * 8));
+        return ret;
+    }
+
+    [[nodiscard]] static std::size_t ReadSizeChecked(const uint8_t *src)
+    {
+        std::size_t ret;
+        if (Robust::conversion_fails(ReadSize(src), ret))
+            Program::Error("Unable to uncompress: The object is too large.");
+        return ret;
+    }
+
     [[nodiscard]] std::size_t UncompressedSize(const uint8_t *src_begin, const uint8_t *src_end)
     {
         if (src_end - src_begin < std::ptrdiff_t(sizeof(size_type)))
             Program::Error("Uncompression failure.");
 
+        if (Blocks::IsBlockFormat(src_begin, src_end))
+            return Blocks::ReadHeader(src_begin, src_end).size;
+
         size_type size = 0;
         for (std::size_t i = 0; i < sizeof(size_type); i++)
             size |= (size_type(src_begin[i]) << (i * 8));
@@ -83,7 +109,98 @@ namespace Archive
 
     void Uncompress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin)
     {
+        if (Blocks::IsBlockFormat(src_begin, src_end))
+        {
+            Blocks::Header header = Blocks::ReadHeader(src_begin, src_end);
+            const uint8_t *data = src_begin + header.header_size;
+            if (std::size_t(src_end - data) < (header.block_ends.empty() ? 0 : header.block_ends.back()))
+                Program::Error("Uncompression failure.");
+
+            Jobs::DefaultPool().ParallelFor(header.BlockCount(), [&](std::size_t i)
+            {
+                uint8_t *dst = dst_begin + header.block_size * i;
+                Raw::Uncompress(data + header.BlockBegin(i), data + header.block_ends[i], dst, dst + header.BlockUncompressedSize(i));
+            }, 1);
+            return;
+        }
+
         std::size_t size = UncompressedSize(src_begin, src_end);
         Raw::Uncompress(src_begin + sizeof(size_type), src_end, dst_begin, dst_begin + size);
     }
+
+    namespace Blocks
+    {
+        bool IsBlockFormat(const uint8_t *src_begin, const uint8_t *src_end)
+        {
+            return src_end - src_begin >= std::ptrdiff_t(sizeof(size_type)) && ReadSize(src_begin) == format_tag;
+        }
+
+        Header ReadHeader(const uint8_t *src_begin, const uint8_t *src_end)
+        {
+            if (src_end - src_begin < std::ptrdiff_t(min_header_size) || ReadSize(src_begin) != format_tag)
+                Program::Error("Uncompression failure.");
+
+            Header ret;
+            ret.size = ReadSizeChecked(src_begin + 8);
+            ret.block_size = ReadSizeChecked(src_begin + 16);
+            std::size_t num_blocks = ReadSizeChecked(src_begin + 24);
+
+            // Each block except the last one is full, and the last one is not empty.
+            if (ret.block_size == 0 || num_blocks != (ret.size + ret.block_size - 1) / ret.block_size)
+                Program::Error("Uncompression failure.");
+            if (std::size_t(src_end - src_begin - min_header_size) / sizeof(size_type) < num_blocks)
+                Program::Error("Uncompression failure.");
+
+            ret.header_size = HeaderSize(num_blocks);
+            ret.block_ends.resize(num_blocks);
+            for (std::size_t i = 0; i < num_blocks; i++)
+            {
+                ret.block_ends[i] = ReadSizeChecked(src_begin + min_header_size + i * sizeof(size_type));
+                if (ret.block_ends[i] < ret.BlockBegin(i))
+                    Program::Error("Uncompression failure.");
+            }
+            return ret;
+        }
+
+        std::size_t HeaderSize(std::size_t num_blocks)
+        {
+            return min_header_size + num_blocks * sizeof(size_type);
+        }
+
+        std::vector<uint8_t> Compress(const uint8_t *src_begin, const uint8_t *src_end, std::size_t block_size)
+        {
+            if (block_size == 0)
+                Program::Error("Compression failure.");
+
+            std::size_t size = src_end - src_begin;
+            std::size_t num_blocks = (size + block_size - 1) / block_size;
+
+            std::vector<std::vector<uint8_t>> blocks(num_blocks);
+            Jobs::DefaultPool().ParallelFor(num_blocks, [&](std::size_t i)
+            {
+                const uint8_t *begin = src_begin + block_size * i;
+                const uint8_t *end = begin + std::min(block_size, std::size_t(src_end - begin));
+                std::vector<uint8_t> &block = blocks[i];
+                block.resize(Raw::MaxCompressedSize(begin, end));
+                block.resize(Raw::Compress(begin, end, block.data(), block.data() + block.size()) - block.data());
+            }, 1);
+
+            std::vector<uint8_t> ret(HeaderSize(num_blocks));
+            WriteSize(format_tag, ret.data());
+            WriteSize(size, ret.data() + 8);
+            WriteSize(block_size, ret.data() + 16);
+            WriteSize(num_blocks, ret.data() + 24);
+            std::size_t end = 0;
+            for (std::size_t i = 0; i < num_blocks; i++)
+            {
+                end += blocks[i].size();
+                WriteSize(end, ret.data() + min_header_size + i * sizeof(size_type));
+            }
+
+            ret.reserve(ret.size() + end);
+            for (const std::vector<uint8_t> &block : blocks)
+                ret.insert(ret.end(), block.begin(), block.end());
+            return ret;
+        }
+    }
 }
@@ -2,6 +2,7 @@
 
 #include <cstdint>
 #include <cstddef>
+#include <vector>
 
 namespace Archive
 {
@@ -18,4 +19,37 @@ namespace Archive
     [[nodiscard]] uint8_t *Compress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin, uint8_t *dst_end); // Compresses and returns compressed data end. Throws on failure.
     [[nodiscard]] std::size_t UncompressedSize(const uint8_t *src_begin, const uint8_t *src_end); // Extracts size from decompressed data. Throws on failure.
     void Uncompress(const uint8_t *src_begin, const uint8_t *src_end, uint8_t *dst_begin); // Decompresses. Throws on failure. The buffer must have size returned by `UncompressedSize()`.
+
+    // A format for the large objects: the data is split into blocks, which are compressed independently on `Jobs::DefaultPool()`, and can be decompressed in parallel or one by one.
+    // It begins with `format_tag` where the other format has the size, so `UncompressedSize()` and `Uncompress()` accept both. `Uncompress()` decompresses the blocks in parallel.
+    namespace Blocks
+    {
+        // No real size can be this large.
+        constexpr std::uint64_t format_tag = std::uint64_t(-1);
+        constexpr std::size_t default_block_size = 1 << 20;
+
+        // After the tag: the uncompressed size, the block size, the block count, then the end offset of each compressed block (from the end of the header), all as 64-bit little-endian integers.
+        // Then the blocks, compressed with `Raw::Compress()`. All blocks except the last one have the block size.
+        struct Header
+        {
+            std::size_t size = 0;
+            std::size_t block_size = 0;
+            std::vector<std::size_t> block_ends;
+            std::size_t header_size = 0; // In bytes, including the tag.
+
+            [[nodiscard]] std::size_t BlockCount() const {return block_ends.size();}
+            [[nodiscard]] std::size_t BlockBegin(std::size_t i) const {return i == 0 ? 0 : block_ends[i - 1];} // Relative to the end of the header.
+            [[nodiscard]] std::size_t BlockUncompressedSize(std::size_t i) const {return i + 1 < block_ends.size() ? block_size : size - block_size * i;}
+        };
+
+        [[nodiscard]] bool IsBlockFormat(const uint8_t *src_begin, const uint8_t *src_end);
+        // Parses and validates the header. Only the header has to be in the buffer. Throws on failure.
+        [[nodiscard]] Header ReadHeader(const uint8_t *src_begin, const uint8_t *src_end);
+        // The header size for the given block count, to know how much to read before calling `ReadHeader()`.
+        [[nodiscard]] std::size_t HeaderSize(std::size_t num_blocks);
+        constexpr std::size_t min_header_size = 8 * 4; // With the block count, but without the block offsets.
+
+        // Compresses the blocks in parallel. Throws on failure.
+        [[nodiscard]] std::vector<uint8_t> Compress(const uint8_t *src_begin, const uint8_t *src_end, std::size_t block_size = default_block_size);
+    }
 }
@@ -1,10 +1,18 @@
 #pragma once
 
 #include <algorithm>
+#include <bit>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <type_traits>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 #include "program/platform.h"
 
 namespace ByteOrder
@@ -41,6 +49,74 @@ namespace ByteOrder
             Swap(value);
     }
 
+    namespace impl
+    {
+        // Reverses the bytes of each `Size`-byte value in a 16-byte block.
+        template <std::size_t Size>
+        void SwapBlock(unsigned char *data)
+        {
+            #if defined(__SSE2__)
+            // SSE2 has no byte shuffle, so reverse the 16-bit parts of the values, then swap the bytes in each part.
+            __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+            if constexpr (Size == 4)
+                block = _mm_shufflehi_epi16(_mm_shufflelo_epi16(block, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+            else if constexpr (Size == 8)
+                block = _mm_shufflehi_epi16(_mm_shufflelo_epi16(block, _MM_SHUFFLE(0, 1, 2, 3)), _MM_SHUFFLE(0, 1, 2, 3));
+            block = _mm_or_si128(_mm_slli_epi16(block, 8), _mm_srli_epi16(block, 8));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(data), block);
+            #elif defined(__aarch64__) && defined(__ARM_NEON)
+            uint8x16_t block = vld1q_u8(data);
+            if constexpr (Size == 2)
+                block = vrev16q_u8(block);
+            else if constexpr (Size == 4)
+                block = vrev32q_u8(block);
+            else
+                block = vrev64q_u8(block);
+            vst1q_u8(data, block);
+            #else
+            (void)data;
+            #endif
+        }
+    }
+
+    // Converts an array of values in place.
+    // With SSE2 or NEON the values are swapped 16 bytes at a time, otherwise in a loop over `std::byteswap()`, which the compilers can often vectorize too.
+    template <typename T> void ConvertSpan(T *data, std::size_t count, Order order)
+    {
+        static_assert(std::is_arithmetic_v<T>, "The parameter has to be arithmetic.");
+
+        if constexpr (sizeof(T) > 1)
+        {
+            if (order == native)
+                return;
+
+            using uint_t = std::conditional_t<sizeof(T) == 2, std::uint16_t, std::conditional_t<sizeof(T) == 4, std::uint32_t, std::conditional_t<sizeof(T) == 8, std::uint64_t, void>>>;
+            if constexpr (std::is_void_v<uint_t>)
+            {
+                // Something like `long double`.
+                for (std::size_t i = 0; i < count; i++)
+                    Swap(data[i]);
+            }
+            else
+            {
+                std::size_t i = 0;
+                #if defined(__SSE2__) || (defined(__aarch64__) && defined(__ARM_NEON))
+                constexpr std::size_t per_block = 16 / sizeof(T);
+                for (; count - i >= per_block; i += per_block)
+                    impl::SwapBlock<sizeof(T)>(reinterpret_cast<unsigned char *>(data + i));
+                #endif
+
+                for (; i < count; i++)
+                {
+                    uint_t value;
+                    std::memcpy(&value, data + i, sizeof value);
+                    value = std::byteswap(value);
+                    std::memcpy(data + i, &value, sizeof value);
+                }
+            }
+        }
+    }
+
     template <typename T> [[nodiscard]] T Little(T value)
     {
         static_assert(std::is_arithmetic_v<T>, "The parameter has to be arithmetic.");
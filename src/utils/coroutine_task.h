@@ -0,0 +1,231 @@
+#pragma once
+
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <new>
+#include <utility>
+
+#include "program/errors.h"
+
+/* `class CoroTask` is a stackless coroutine, a replacement for `CoTask` from `utils/tasks.h`.
+ * Unlike `CoTask`, it can keep local variables across the yields, and can wait for other tasks.
+ *
+ * Example usage:
+ *
+ *     CoroTask Blink(int times)
+ *     {
+ *         for (int i = 0; i < times; i++)
+ *         {
+ *             std::cout << i << '\n';
+ *             co_yield {}; // Suspends until the next call.
+ *         }
+ *     }
+ *
+ *     CoroTask Script()
+ *     {
+ *         co_await Blink(3); // Runs the other task to completion, one step per call.
+ *         std::cout << "Done!\n";
+ *     }
+ *
+ *     CoroTask t = Script();
+ *     while (!t.finished())
+ *         t();
+ *
+ * The task starts suspended, the first call runs it up to the first `co_yield`.
+ * The frames are allocated from a pool (per thread, by size), so creating tasks doesn't normally hit the heap, and resuming them never does.
+ * The tasks can't be copied, only moved. Don't put them in the objects that need to be copied (e.g. the game states).
+ */
+
+class CoroTask
+{
+    // The frame allocator. Keeps the freed frames in lists, one per size class.
+    // It's trivially destructible (the free frames are never returned to the heap), so the tasks destroyed during the program shutdown can still use it.
+    class FramePool
+    {
+        static constexpr std::size_t granularity = 64, num_classes = 16; // Frames larger than `granularity * num_classes` bytes use the heap.
+
+        struct FreeFrame
+        {
+            FreeFrame *next;
+        };
+        std::array<FreeFrame *, num_classes> free_lists{};
+
+      public:
+        [[nodiscard]] static FramePool &Get()
+        {
+            thread_local FramePool ret;
+            return ret;
+        }
+
+        [[nodiscard]] void *Allocate(std::size_t size)
+        {
+            std::size_t size_class = (size + granularity - 1) / granularity;
+            if (size_class > num_classes)
+                return ::operator new(size);
+
+            if (FreeFrame *frame = free_lists[size_class - 1])
+            {
+                free_lists[size_class - 1] = frame->next;
+                return frame;
+            }
+            return ::operator new(size_class * granularity);
+        }
+
+        void Free(void *ptr, std::size_t size) noexcept
+        {
+            std::size_t size_class = (size + granularity - 1) / granularity;
+            if (size_class > num_classes)
+            {
+                ::operator delete(ptr);
+                return;
+            }
+
+            // Note that the frame can be freed on a different thread than the one it was allocated on. It's fine, since all blocks are allocated with `::operator new`.
+            FreeFrame *frame = static_cast<FreeFrame *>(ptr);
+            frame->next = free_lists[size_class - 1];
+            free_lists[size_class - 1] = frame;
+        }
+    };
+
+  public:
+    // `co_yield {}` accepts this.
+    struct Yield {};
+
+    struct promise_type
+    {
+        std::coroutine_handle<promise_type> child; // The task we're `co_await`ing, if any.
+        std::exception_ptr exception;
+        std::exception_ptr child_exception; // Rethrown from `co_await`.
+
+        [[nodiscard]] static void *operator new(std::size_t size)
+        {
+            return FramePool::Get().Allocate(size);
+        }
+        static void operator delete(void *ptr, std::size_t size) noexcept
+        {
+            FramePool::Get().Free(ptr, size);
+        }
+
+        CoroTask get_return_object()
+        {
+            return CoroTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept {return {};}
+        std::suspend_always final_suspend() noexcept {return {};}
+        void return_void() {}
+        void unhandled_exception() {exception = std::current_exception();}
+
+        std::suspend_always yield_value(Yield) {return {};}
+    };
+
+  private:
+    std::coroutine_handle<promise_type> handle;
+
+    explicit CoroTask(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    // Resumes the innermost awaited task. Rethrows its exceptions.
+    static void Step(std::coroutine_handle<promise_type> h)
+    {
+        promise_type &promise = h.promise();
+        if (promise.child)
+        {
+            try
+            {
+                Step(promise.child);
+            }
+            catch (...)
+            {
+                promise.child_exception = std::current_exception();
+            }
+            if (!promise.child.done())
+                return;
+            // The child has finished, continue the parent during the same step.
+            promise.child.destroy();
+            promise.child = nullptr;
+        }
+
+        h.resume();
+        if (promise.exception)
+            std::rethrow_exception(std::exchange(promise.exception, {}));
+    }
+
+  public:
+    CoroTask() {}
+
+    CoroTask(CoroTask &&other) noexcept : handle(std::exchange(other.handle, {})) {}
+    CoroTask &operator=(CoroTask other) noexcept
+    {
+        std::swap(handle, other.handle);
+        return *this;
+    }
+
+    ~CoroTask()
+    {
+        if (handle)
+        {
+            if (handle.promise().child)
+                handle.promise().child.destroy();
+            handle.destroy();
+        }
+    }
+
+    explicit operator bool() const
+    {
+        return bool(handle);
+    }
+
+    bool operator()() // Returns 1 if the task has finished.
+    {
+        if (finished())
+            return 1;
+        Step(handle);
+        return finished();
+    }
+
+    bool finished() const
+    {
+        return !handle || handle.done();
+    }
+
+    // `co_await`ing a task from another task runs it until it finishes, one step per call of the outer task.
+    // The first step runs immediately.
+    // The exceptions from the awaited task are rethrown in the outer task.
+    struct Awaiter
+    {
+        std::coroutine_handle<promise_type> child, parent;
+
+        bool await_ready()
+        {
+            Step(child);
+            return child.done();
+        }
+        void await_suspend(std::coroutine_handle<promise_type> new_parent) noexcept
+        {
+            parent = new_parent;
+            parent.promise().child = std::exchange(child, nullptr);
+        }
+        void await_resume()
+        {
+            if (parent && parent.promise().child_exception)
+                std::rethrow_exception(std::exchange(parent.promise().child_exception, {}));
+        }
+
+        Awaiter(std::coroutine_handle<promise_type> child) : child(child) {}
+        Awaiter(const Awaiter &) = delete;
+        Awaiter &operator=(const Awaiter &) = delete;
+        ~Awaiter()
+        {
+            if (child)
+                child.destroy();
+        }
+    };
+
+    friend Awaiter operator co_await(CoroTask &&task)
+    {
+        ASSERT(task.handle, "Attempt to `co_await` a null task.");
+        return Awaiter(std::exchange(task.handle, {}));
+    }
+};
@@ -1,5 +1,10 @@
 #include "filesystem.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string_view>
 #include <utility>
 
 #include <dirent.h>
@@ -7,6 +12,19 @@
 
 #include "macros/finally.h"
 #include "program/errors.h"
+#include "program/platform.h"
+
+#if IMP_PLATFORM_IS(windows)
+#include <filesystem>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if IMP_PLATFORM_IS(linux)
+#include <sys/inotify.h>
+#endif
 
 namespace Filesystem
 {
@@ -125,4 +143,304 @@ namespace Filesystem
     {
         return GetObjectTreeLow(entry_name, entry_name, max_depth, ok);
     }
+
+    #if IMP_PLATFORM_IS(windows)
+    // `dir` ends with a slash. `FindFirstFileExW()` returns the times along with the names, so nothing is opened or stat'ed per file.
+    static std::time_t GetTimeModifiedRecursiveLow(const std::wstring &dir, int max_depth)
+    {
+        WIN32_FIND_DATAW entry;
+        HANDLE handle = FindFirstFileExW((dir + L'*').c_str(), FindExInfoBasic, &entry, FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
+        if (handle == INVALID_HANDLE_VALUE)
+            return 0; // Silently ignore the directories we can no longer access.
+        FINALLY( FindClose(handle); )
+
+        std::time_t ret = 0;
+        do
+        {
+            std::wstring_view name = entry.cFileName;
+            if (name == L"." || name == L"..")
+                continue;
+
+            // From 100ns intervals since 1601 to seconds since 1970, like `stat()` does in MinGW.
+            std::uint64_t time = std::uint64_t(entry.ftLastWriteTime.dwHighDateTime) << 32 | entry.ftLastWriteTime.dwLowDateTime;
+            std::time_t time_modified = std::time_t((time - 116444736000000000ull) / 10000000);
+            if (time_modified > ret)
+                ret = time_modified;
+
+            if ((entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && max_depth - 1 != 0)
+            {
+                time_modified = GetTimeModifiedRecursiveLow(dir + std::wstring(name) + L'\\', max_depth - 1);
+                if (time_modified > ret)
+                    ret = time_modified;
+            }
+        }
+        while (FindNextFileW(handle, &entry));
+
+        return ret;
+    }
+    #else
+    // Takes ownership of `dir_fd`. Uses `fstatat()` relative to the directory, to avoid building and resolving the full paths.
+    static std::time_t GetTimeModifiedRecursiveLow(int dir_fd, int max_depth)
+    {
+        DIR *dir = fdopendir(dir_fd);
+        if (!dir)
+        {
+            close(dir_fd);
+            return 0; // Silently ignore the directories we can no longer access.
+        }
+        FINALLY( closedir(dir); )
+
+        std::time_t ret = 0;
+        while (dirent *entry = readdir(dir))
+        {
+            std::string_view name = entry->d_name;
+            if (name == "." || name == "..")
+                continue;
+
+            struct stat info;
+            if (fstatat(dir_fd, entry->d_name, &info, 0))
+                continue; // Silently ignore this entry if something goes wrong.
+
+            if (info.st_mtime > ret)
+                ret = info.st_mtime;
+
+            if (S_ISDIR(info.st_mode) && max_depth - 1 != 0)
+            {
+                int sub_fd = openat(dir_fd, entry->d_name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                if (sub_fd < 0)
+                    continue;
+                std::time_t time_modified = GetTimeModifiedRecursiveLow(sub_fd, max_depth - 1);
+                if (time_modified > ret)
+                    ret = time_modified;
+            }
+        }
+
+        return ret;
+    }
+    #endif
+
+    std::time_t GetTimeModifiedRecursive(const std::string &entry_name, int max_depth, bool *ok)
+    {
+        bool info_ok = true;
+        ObjInfo info = GetObjectInfo(entry_name, ok ? &info_ok : 0);
+        if (ok)
+            *ok = info_ok;
+        if (!info_ok)
+            return 0;
+
+        std::time_t ret = info.time_modified;
+        if (info.category != directory || max_depth == 0)
+            return ret;
+
+        #if IMP_PLATFORM_IS(windows)
+        std::time_t time_modified = GetTimeModifiedRecursiveLow(std::filesystem::u8path(entry_name).wstring() + L'\\', max_depth);
+        #else
+        int dir_fd = open(entry_name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        std::time_t time_modified = dir_fd < 0 ? 0 : GetTimeModifiedRecursiveLow(dir_fd, max_depth);
+        #endif
+        if (time_modified > ret)
+            ret = time_modified;
+        return ret;
+    }
+
+    struct ChangeWatcher::Data
+    {
+        std::string dir_name;
+        bool recursive = true;
+
+        #if IMP_PLATFORM_IS(windows)
+        HANDLE dir = INVALID_HANDLE_VALUE;
+        OVERLAPPED overlapped{};
+        alignas(DWORD) unsigned char buffer[0x10000]; // Can't be larger than 64 KiB for network drives.
+
+        // Starts waiting for the next batch of changes.
+        bool StartRead()
+        {
+            ResetEvent(overlapped.hEvent);
+            constexpr DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+            return ReadDirectoryChangesW(dir, buffer, sizeof buffer, recursive, filter, nullptr, &overlapped, nullptr);
+        }
+        #elif IMP_PLATFORM_IS(linux)
+        int fd = -1;
+        std::map<int, std::string> watches; // Watch descriptors to the directory paths relative to `dir_name`, each either empty or ending with `/`.
+
+        // `IN_MODIFY` is not here, because it's sent for every write, while the file is incomplete.
+        static constexpr std::uint32_t mask = IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+        // Watches a directory, and if `recursive` is true, all nested directories. Adds the files in them to `*found_files`, if it's not null.
+        void AddWatch(const std::string &rel_path, std::set<std::string> *found_files)
+        {
+            std::string path = rel_path.empty() ? dir_name : dir_name + '/' + rel_path;
+            int wd = inotify_add_watch(fd, path.c_str(), mask);
+            if (wd < 0)
+            {
+                if (rel_path.empty())
+                    Program::Error("Unable to watch directory `", dir_name, "` for changes.");
+                return; // Silently ignore the nested directories that disappeared or can't be accessed, like `GetObjectTree()` does.
+            }
+            watches[wd] = rel_path;
+
+            if (!recursive && !found_files)
+                return;
+
+            bool contents_ok;
+            for (const std::string &name : GetDirectoryContents(path, &contents_ok))
+            {
+                if (name == "." || name == "..")
+                    continue;
+                bool info_ok;
+                ObjInfo info = GetObjectInfo(path + '/' + name, &info_ok);
+                if (!info_ok)
+                    continue;
+                if (info.category == directory)
+                {
+                    if (recursive)
+                        AddWatch(rel_path + name + '/', found_files);
+                }
+                else if (found_files)
+                {
+                    found_files->insert(rel_path + name);
+                }
+            }
+        }
+        #endif
+    };
+
+    ChangeWatcher::ChangeWatcher() {}
+
+    ChangeWatcher::ChangeWatcher(const std::string &dir_name, bool recursive) : data(std::make_unique<Data>())
+    {
+        data->dir_name = dir_name;
+        data->recursive = recursive;
+
+        #if IMP_PLATFORM_IS(windows)
+        data->dir = CreateFileW(std::filesystem::u8path(dir_name).c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+        if (data->dir == INVALID_HANDLE_VALUE)
+            Program::Error("Unable to watch directory `", dir_name, "` for changes.");
+        FINALLY_ON_THROW( CloseHandle(data->dir); )
+
+        data->overlapped.hEvent = CreateEventW(nullptr, true, false, nullptr);
+        if (!data->overlapped.hEvent)
+            Program::Error("Unable to create an event to watch directory `", dir_name, "` for changes.");
+        FINALLY_ON_THROW( CloseHandle(data->overlapped.hEvent); )
+
+        if (!data->StartRead())
+            Program::Error("Unable to watch directory `", dir_name, "` for changes.");
+        #elif IMP_PLATFORM_IS(linux)
+        data->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (data->fd < 0)
+            Program::Error("Unable to initialize inotify to watch directory `", dir_name, "` for changes.");
+        FINALLY_ON_THROW( close(data->fd); )
+
+        data->AddWatch("", nullptr);
+        #endif
+    }
+
+    ChangeWatcher::ChangeWatcher(ChangeWatcher &&) noexcept = default;
+    ChangeWatcher &ChangeWatcher::operator=(ChangeWatcher &&) noexcept = default;
+
+    ChangeWatcher::~ChangeWatcher()
+    {
+        if (!data)
+            return;
+
+        #if IMP_PLATFORM_IS(windows)
+        CancelIo(data->dir);
+        // Wait for the cancellation, otherwise the OS could write to the buffer after we free it.
+        DWORD bytes;
+        GetOverlappedResult(data->dir, &data->overlapped, &bytes, true);
+        CloseHandle(data->overlapped.hEvent);
+        CloseHandle(data->dir);
+        #elif IMP_PLATFORM_IS(linux)
+        close(data->fd); // This removes the watches too.
+        #endif
+    }
+
+    ChangeWatcher::operator bool() const
+    {
+        return bool(data);
+    }
+
+    bool ChangeWatcher::IsSupported()
+    {
+        return IMP_PLATFORM_IS(windows) || IMP_PLATFORM_IS(linux);
+    }
+
+    std::vector<std::string> ChangeWatcher::Poll()
+    {
+        ASSERT(*this, "Attempt to use a null change watcher.");
+        if (!*this)
+            return {};
+
+        std::set<std::string> ret;
+
+        #if IMP_PLATFORM_IS(windows)
+        while (true)
+        {
+            DWORD bytes = 0;
+            if (!GetOverlappedResult(data->dir, &data->overlapped, &bytes, false))
+            {
+                if (GetLastError() == ERROR_IO_INCOMPLETE)
+                    break; // Nothing new.
+                bytes = 0; // Treat the errors as overflows, and try to continue.
+            }
+
+            // Zero bytes means that the changes didn't fit into the buffer, and were lost.
+            for (std::size_t offset = 0; offset < bytes;)
+            {
+                const auto &info = *reinterpret_cast<const FILE_NOTIFY_INFORMATION *>(data->buffer + offset);
+                std::u8string name = std::filesystem::path(std::wstring_view(info.FileName, info.FileNameLength / sizeof(WCHAR))).generic_u8string();
+                ret.emplace(name.begin(), name.end());
+
+                if (info.NextEntryOffset == 0)
+                    break;
+                offset += info.NextEntryOffset;
+            }
+
+            if (!data->StartRead())
+                break; // Probably the directory was deleted. There's nothing we can do.
+        }
+        #elif IMP_PLATFORM_IS(linux)
+        alignas(inotify_event) char buffer[0x1000];
+        while (true)
+        {
+            ssize_t bytes = read(data->fd, buffer, sizeof buffer);
+            if (bytes <= 0)
+                break; // `EAGAIN` means there's nothing new.
+
+            for (ssize_t offset = 0; offset < bytes;)
+            {
+                const auto &event = *reinterpret_cast<const inotify_event *>(buffer + offset);
+                offset += sizeof(inotify_event) + event.len;
+
+                if (event.mask & IN_IGNORED)
+                {
+                    // The directory was deleted or moved away.
+                    data->watches.erase(event.wd);
+                    continue;
+                }
+
+                auto it = data->watches.find(event.wd);
+                if (it == data->watches.end() || event.len == 0)
+                    continue;
+                std::string rel_path = it->second + event.name;
+
+                if (event.mask == IN_CREATE)
+                    continue; // A new file, wait for `IN_CLOSE_WRITE`.
+
+                if (event.mask & IN_ISDIR)
+                {
+                    // Report the contents of the new directories, since we won't get the events for them.
+                    if (data->recursive && (event.mask & (IN_CREATE | IN_MOVED_TO)))
+                        data->AddWatch(rel_path + '/', &ret);
+                    continue;
+                }
+
+                ret.insert(std::move(rel_path));
+            }
+        }
+        #endif
+
+        return std::vector<std::string>(ret.begin(), ret.end());
+    }
 }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <ctime>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -39,10 +40,41 @@ namespace Filesystem
     // Using a negative `max_depth` disables depth limit. But then a circular symlink might cause stack overflow.
     TreeNode GetObjectTree(const std::string &entry_name, int max_depth, bool *ok = 0);
 
+    // Returns the same as `GetObjectTree(...).time_modified_recursive`, but much faster, since it doesn't build the tree.
+    // Throws if the specified file or directory can't be accessed.
+    // If `ok != 0`, sets `*ok` to 0 instead of throwing. The nested entries that can't be accessed are silently skipped, like in `GetObjectTree`.
+    [[nodiscard]] std::time_t GetTimeModifiedRecursive(const std::string &entry_name, int max_depth, bool *ok = 0);
+
     template <typename F> void ForEachObject(const TreeNode &tree, F &&func) // `func` should be `void func(const TreeNode &node)`.
     {
         func(tree);
         for (const auto &elem : tree.contents)
             ForEachObject(elem, func);
     }
+
+    // Reports the files that were created, modified, moved or deleted in a directory, without rescanning it.
+    // Uses inotify on Linux and `ReadDirectoryChangesW()` on Windows. On other platforms nothing is ever reported, check `IsSupported()`.
+    class ChangeWatcher
+    {
+        struct Data;
+        std::unique_ptr<Data> data;
+
+      public:
+        ChangeWatcher();
+        // Throws if the directory can't be watched.
+        ChangeWatcher(const std::string &dir_name, bool recursive = true);
+
+        ChangeWatcher(ChangeWatcher &&) noexcept;
+        ChangeWatcher &operator=(ChangeWatcher &&) noexcept;
+        ~ChangeWatcher();
+
+        [[nodiscard]] explicit operator bool() const;
+
+        [[nodiscard]] static bool IsSupported();
+
+        // Returns the paths of the changed files since the last call, relative to the directory, with `/` as the separator. Never blocks.
+        // The list is sorted and has no duplicates. The deleted files are included too, check them with `GetObjectInfo()` if needed.
+        // On Windows, the changed directories can be reported as well. If the OS event queue overflows, some changes can be lost.
+        [[nodiscard]] std::vector<std::string> Poll();
+    };
 }
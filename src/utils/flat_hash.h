@@ -0,0 +1,720 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "utils/hash.h"
+
+// Open-addressing hash containers, `FlatMap` and `FlatSet`. The layout follows the SwissTable (Abseil's `flat_hash_map`):
+// the elements are stored in a single flat array, and each slot has a control byte, which is either "empty", "deleted", or the low 7 bits of the element hash.
+// A lookup compares a whole group of control bytes at once (16 with SSE2, 8 otherwise), and only touches the elements with the matching bits.
+// The API mimics `std::unordered_map` and `std::unordered_set`, so the reflection treats them as containers automatically.
+// Unlike `std::map`, the iteration order is unspecified. Inserting can invalidate all references and iterators (when the table grows), erasing only invalidates the erased element.
+// The elements must be nothrow-move-constructible.
+
+namespace FlatHash
+{
+    namespace impl
+    {
+        using ctrl_t = std::int8_t;
+        // The full slots have non-negative control bytes.
+        inline constexpr ctrl_t ctrl_empty = -128, ctrl_deleted = -2;
+
+        #if defined(__SSE2__)
+        inline constexpr std::size_t group_width = 16;
+        #else
+        inline constexpr std::size_t group_width = 8;
+        #endif
+
+        // One bit per slot of a group, the lowest bit is the first slot.
+        using mask_t = std::uint32_t;
+
+        // A group of control bytes, starting at an arbitrary position.
+        class Group
+        {
+            #if defined(__SSE2__)
+            __m128i ctrl;
+            #else
+            ctrl_t ctrl[group_width];
+            #endif
+
+          public:
+            explicit Group(const ctrl_t *pos)
+            {
+                #if defined(__SSE2__)
+                ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i *>(pos));
+                #else
+                std::memcpy(ctrl, pos, group_width);
+                #endif
+            }
+
+            [[nodiscard]] mask_t Match(ctrl_t value) const
+            {
+                #if defined(__SSE2__)
+                return mask_t(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(value), ctrl)));
+                #else
+                mask_t ret = 0;
+                for (std::size_t i = 0; i < group_width; i++)
+                    ret |= mask_t(ctrl[i] == value) << i;
+                return ret;
+                #endif
+            }
+
+            [[nodiscard]] mask_t MatchEmpty() const
+            {
+                return Match(ctrl_empty);
+            }
+
+            [[nodiscard]] mask_t MatchEmptyOrDeleted() const
+            {
+                #if defined(__SSE2__)
+                return mask_t(_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(-1), ctrl)));
+                #else
+                mask_t ret = 0;
+                for (std::size_t i = 0; i < group_width; i++)
+                    ret |= mask_t(ctrl[i] < -1) << i;
+                return ret;
+                #endif
+            }
+        };
+
+        template <typename H, typename E>
+        concept transparent = requires{typename H::is_transparent; typename E::is_transparent;};
+
+        // `type<K, Key>` is `K` if the lookup is transparent, `Key` otherwise. An alias template, rather than `std::conditional_t`, keeps `K` deducible.
+        template <bool Transparent>
+        struct KeyArg
+        {
+            template <typename K, typename Key>
+            using type = K;
+        };
+        template <>
+        struct KeyArg<false>
+        {
+            template <typename K, typename Key>
+            using type = Key;
+        };
+
+        // The common part of the map and the set.
+        // `Policy` has `key_type`, `value_type`, `static const key_type &Key(const value_type &)`,
+        // and `static void Transfer(value_type *to, value_type *from) noexcept`, which move-constructs `*to` from `*from` and destroys `*from`.
+        template <typename Policy, typename Hasher, typename Equal>
+        class Table
+        {
+          public:
+            using key_type = typename Policy::key_type;
+            using value_type = typename Policy::value_type;
+            using size_type = std::size_t;
+            using difference_type = std::ptrdiff_t;
+            using hasher = Hasher;
+            using key_equal = Equal;
+            using reference = value_type &;
+            using const_reference = const value_type &;
+
+          private:
+            static constexpr std::size_t npos = std::size_t(-1);
+
+            // The control bytes. `capacity + group_width - 1` of them, the last `group_width - 1` mirror the first ones, so any group can be loaded without wrapping around.
+            ctrl_t *ctrl = nullptr;
+            value_type *slots = nullptr;
+            std::size_t capacity = 0; // Zero or a power of two, at least `group_width`.
+            std::size_t elem_count = 0;
+            std::size_t growth_left = 0; // How many more empty slots we can fill before growing. Deleted slots don't count as empty.
+
+            [[no_unique_address]] Hasher hash_func;
+            [[no_unique_address]] Equal equal_func;
+
+            // Looks up key arguments as is if the hasher and the comparator are transparent, otherwise converts them to `key_type` first.
+            using key_arg_impl = KeyArg<transparent<Hasher, Equal>>;
+            template <typename K>
+            using key_arg = typename key_arg_impl::template type<K, key_type>;
+
+            // The max number of elements for a capacity, for the max load factor of 7/8.
+            [[nodiscard]] static constexpr std::size_t MaxElemCount(std::size_t cap)
+            {
+                return cap - cap / 8;
+            }
+
+            // The starting slot of the probe sequence.
+            [[nodiscard]] static std::size_t H1(std::size_t hash)
+            {
+                return hash >> 7;
+            }
+            // The value stored in the control byte.
+            [[nodiscard]] static ctrl_t H2(std::size_t hash)
+            {
+                return ctrl_t(hash & 0x7f);
+            }
+
+            void SetCtrl(std::size_t index, ctrl_t value)
+            {
+                ctrl[index] = value;
+                // The mirrored byte, if any. Otherwise this writes to `index` again.
+                ctrl[((index - (group_width - 1)) & (capacity - 1)) + (group_width - 1)] = value;
+            }
+
+            // The probing visits the groups with triangular steps, which covers the entire table when the capacity is a power of two.
+            template <typename K>
+            [[nodiscard]] std::size_t FindIndex(const K &key, std::size_t hash) const
+            {
+                if (capacity == 0)
+                    return npos;
+                std::size_t mask = capacity - 1;
+                std::size_t pos = H1(hash) & mask;
+                ctrl_t h2 = H2(hash);
+                for (std::size_t step = group_width;; step += group_width)
+                {
+                    Group group(ctrl + pos);
+                    for (mask_t m = group.Match(h2); m; m &= m - 1)
+                    {
+                        std::size_t index = (pos + std::countr_zero(m)) & mask;
+                        if (equal_func(Policy::Key(slots[index]), key))
+                            return index;
+                    }
+                    if (group.MatchEmpty())
+                        return npos;
+                    pos = (pos + step) & mask;
+                }
+            }
+
+            // Returns the first empty or deleted slot in the probe sequence. Requires a non-zero capacity.
+            [[nodiscard]] std::size_t FindFreeIndex(std::size_t hash) const
+            {
+                std::size_t mask = capacity - 1;
+                std::size_t pos = H1(hash) & mask;
+                for (std::size_t step = group_width;; step += group_width)
+                {
+                    if (mask_t m = Group(ctrl + pos).MatchEmptyOrDeleted())
+                        return (pos + std::countr_zero(m)) & mask;
+                    pos = (pos + step) & mask;
+                }
+            }
+
+            // Moves the elements to new storage of capacity `new_capacity`, which must fit them. This also gets rid of the deleted slots.
+            void Resize(std::size_t new_capacity)
+            {
+                ctrl_t *old_ctrl = ctrl;
+                value_type *old_slots = slots;
+                std::size_t old_capacity = capacity;
+
+                slots = std::allocator<value_type>{}.allocate(new_capacity);
+                try
+                {
+                    ctrl = std::allocator<ctrl_t>{}.allocate(new_capacity + group_width - 1);
+                }
+                catch (...)
+                {
+                    std::allocator<value_type>{}.deallocate(slots, new_capacity);
+                    slots = old_slots;
+                    throw;
+                }
+                std::fill_n(ctrl, new_capacity + group_width - 1, ctrl_empty);
+                capacity = new_capacity;
+                growth_left = MaxElemCount(new_capacity) - elem_count;
+
+                for (std::size_t i = 0; i < old_capacity; i++)
+                {
+                    if (old_ctrl[i] < 0)
+                        continue;
+                    std::size_t hash = hash_func(Policy::Key(old_slots[i]));
+                    std::size_t index = FindFreeIndex(hash);
+                    Policy::Transfer(slots + index, old_slots + i);
+                    SetCtrl(index, H2(hash));
+                }
+
+                if (old_capacity)
+                {
+                    std::allocator<value_type>{}.deallocate(old_slots, old_capacity);
+                    std::allocator<ctrl_t>{}.deallocate(old_ctrl, old_capacity + group_width - 1);
+                }
+            }
+
+            // Makes room for one more element.
+            void GrowForInsertion()
+            {
+                if (capacity == 0)
+                    Resize(group_width);
+                else if (elem_count <= MaxElemCount(capacity) / 2)
+                    Resize(capacity); // Mostly deleted slots, rehash in place.
+                else
+                    Resize(capacity * 2);
+            }
+
+            void DestroyElements() noexcept
+            {
+                if constexpr (!std::is_trivially_destructible_v<value_type>)
+                {
+                    for (std::size_t i = 0; i < capacity; i++)
+                    {
+                        if (ctrl[i] >= 0)
+                            std::destroy_at(slots + i);
+                    }
+                }
+            }
+
+            void Deallocate() noexcept
+            {
+                if (capacity == 0)
+                    return;
+                DestroyElements();
+                std::allocator<value_type>{}.deallocate(slots, capacity);
+                std::allocator<ctrl_t>{}.deallocate(ctrl, capacity + group_width - 1);
+                ctrl = nullptr;
+                slots = nullptr;
+                capacity = 0;
+                elem_count = 0;
+                growth_left = 0;
+            }
+
+            template <bool IsConst>
+            class Iterator
+            {
+                friend class Table;
+                friend class Iterator<!IsConst>;
+
+              public:
+                using iterator_category = std::forward_iterator_tag;
+                using value_type = typename Table::value_type;
+                using difference_type = std::ptrdiff_t;
+                using reference = std::conditional_t<IsConst, const value_type &, value_type &>;
+                using pointer = std::conditional_t<IsConst, const value_type *, value_type *>;
+
+              private:
+                const ctrl_t *cur = nullptr, *end = nullptr;
+                value_type *slot = nullptr;
+
+                Iterator(const ctrl_t *cur, const ctrl_t *end, value_type *slot) : cur(cur), end(end), slot(slot)
+                {
+                    SkipFreeSlots();
+                }
+
+                void SkipFreeSlots()
+                {
+                    while (cur != end && *cur < 0)
+                    {
+                        cur++;
+                        slot++;
+                    }
+                }
+
+              public:
+                Iterator() {}
+
+                // Non-const to const.
+                template <bool C = IsConst> requires C
+                Iterator(const Iterator<false> &other) : cur(other.cur), end(other.end), slot(other.slot) {}
+
+                [[nodiscard]] reference operator*() const {return *slot;}
+                [[nodiscard]] pointer operator->() const {return slot;}
+
+                Iterator &operator++()
+                {
+                    cur++;
+                    slot++;
+                    SkipFreeSlots();
+                    return *this;
+                }
+                Iterator operator++(int)
+                {
+                    Iterator ret = *this;
+                    ++*this;
+                    return ret;
+                }
+
+                [[nodiscard]] friend bool operator==(const Iterator &a, const Iterator &b)
+                {
+                    return a.slot == b.slot;
+                }
+            };
+
+          public:
+            using iterator = Iterator<false>;
+            using const_iterator = Iterator<true>;
+
+          private:
+            [[nodiscard]] iterator IteratorAt(std::size_t index) const
+            {
+                return iterator(ctrl + index, ctrl + capacity, slots + index);
+            }
+
+            [[nodiscard]] std::size_t IndexOf(const_iterator it) const
+            {
+                return std::size_t(it.slot - slots);
+            }
+
+          protected:
+            // Inserts an element if `key` isn't in the table. `construct(value_type *)` must construct the element at the pointer, with the key equal to `key`.
+            template <typename K, typename F>
+            std::pair<iterator, bool> InsertWith(const K &key, F &&construct)
+            {
+                std::size_t hash = hash_func(key);
+                std::size_t index = FindIndex(key, hash);
+                if (index != npos)
+                    return {IteratorAt(index), false};
+
+                if (capacity == 0)
+                    GrowForInsertion();
+                index = FindFreeIndex(hash);
+                if (growth_left == 0 && ctrl[index] != ctrl_deleted)
+                {
+                    GrowForInsertion();
+                    index = FindFreeIndex(hash);
+                }
+
+                std::forward<F>(construct)(slots + index); // If this throws, the slot remains free.
+                if (ctrl[index] == ctrl_empty)
+                    growth_left--;
+                SetCtrl(index, H2(hash));
+                elem_count++;
+                return {IteratorAt(index), true};
+            }
+
+            // Returns the element, or null if not found.
+            template <typename K>
+            [[nodiscard]] value_type *FindPtr(const K &key) const
+            {
+                std::size_t index = FindIndex(key, hash_func(key));
+                return index == npos ? nullptr : slots + index;
+            }
+
+          public:
+            Table() {}
+
+            explicit Table(std::size_t bucket_count, const Hasher &hash_func = Hasher{}, const Equal &equal_func = Equal{})
+                : hash_func(hash_func), equal_func(equal_func)
+            {
+                reserve(bucket_count);
+            }
+
+            template <std::input_iterator I>
+            Table(I first, I last)
+            {
+                insert(first, last);
+            }
+
+            Table(std::initializer_list<value_type> list)
+            {
+                insert(list.begin(), list.end());
+            }
+
+            Table(const Table &other) : hash_func(other.hash_func), equal_func(other.equal_func)
+            {
+                reserve(other.size());
+                for (const value_type &elem : other)
+                    insert(elem);
+            }
+
+            Table(Table &&other) noexcept
+                : ctrl(std::exchange(other.ctrl, nullptr)), slots(std::exchange(other.slots, nullptr)),
+                capacity(std::exchange(other.capacity, 0)), elem_count(std::exchange(other.elem_count, 0)), growth_left(std::exchange(other.growth_left, 0)),
+                hash_func(other.hash_func), equal_func(other.equal_func)
+            {}
+
+            Table &operator=(Table other) noexcept
+            {
+                swap(other);
+                return *this;
+            }
+
+            ~Table()
+            {
+                Deallocate();
+            }
+
+            void swap(Table &other) noexcept
+            {
+                std::swap(ctrl, other.ctrl);
+                std::swap(slots, other.slots);
+                std::swap(capacity, other.capacity);
+                std::swap(elem_count, other.elem_count);
+                std::swap(growth_left, other.growth_left);
+                std::swap(hash_func, other.hash_func);
+                std::swap(equal_func, other.equal_func);
+            }
+            friend void swap(Table &a, Table &b) noexcept
+            {
+                a.swap(b);
+            }
+
+            [[nodiscard]] iterator begin() {return IteratorAt(0);}
+            [[nodiscard]] iterator end() {return IteratorAt(capacity);}
+            [[nodiscard]] const_iterator begin() const {return IteratorAt(0);}
+            [[nodiscard]] const_iterator end() const {return IteratorAt(capacity);}
+            [[nodiscard]] const_iterator cbegin() const {return begin();}
+            [[nodiscard]] const_iterator cend() const {return end();}
+
+            [[nodiscard]] bool empty() const {return elem_count == 0;}
+            [[nodiscard]] std::size_t size() const {return elem_count;}
+            [[nodiscard]] std::size_t bucket_count() const {return capacity;}
+
+            [[nodiscard]] const Hasher &hash_function() const {return hash_func;}
+            [[nodiscard]] const Equal &key_eq() const {return equal_func;}
+
+            // Destroys the elements, but keeps the storage.
+            void clear() noexcept
+            {
+                if (capacity == 0)
+                    return;
+                DestroyElements();
+                std::fill_n(ctrl, capacity + group_width - 1, ctrl_empty);
+                elem_count = 0;
+                growth_left = MaxElemCount(capacity);
+            }
+
+            // Makes sure `new_count` elements fit without growing.
+            void reserve(std::size_t new_count)
+            {
+                if (new_count <= MaxElemCount(capacity))
+                    return;
+                std::size_t new_capacity = std::max(group_width, std::bit_ceil(new_count + new_count / 7 + 1));
+                while (MaxElemCount(new_capacity) < new_count)
+                    new_capacity *= 2;
+                Resize(new_capacity);
+            }
+
+            std::pair<iterator, bool> insert(const value_type &value)
+            {
+                return InsertWith(Policy::Key(value), [&](value_type *ptr){std::construct_at(ptr, value);});
+            }
+            std::pair<iterator, bool> insert(value_type &&value)
+            {
+                return InsertWith(Policy::Key(value), [&](value_type *ptr){std::construct_at(ptr, std::move(value));});
+            }
+            template <std::input_iterator I>
+            void insert(I first, I last)
+            {
+                if constexpr (std::forward_iterator<I>)
+                    reserve(size() + std::size_t(std::distance(first, last)));
+                for (; first != last; ++first)
+                    insert(*first);
+            }
+            void insert(std::initializer_list<value_type> list)
+            {
+                insert(list.begin(), list.end());
+            }
+
+            // Constructs a temporary element first, to know the key.
+            template <typename ...P>
+            std::pair<iterator, bool> emplace(P &&... params)
+            {
+                return insert(value_type(std::forward<P>(params)...));
+            }
+
+            template <typename K = key_type>
+            [[nodiscard]] iterator find(const key_arg<K> &key)
+            {
+                std::size_t index = FindIndex(key, hash_func(key));
+                return index == npos ? end() : IteratorAt(index);
+            }
+            template <typename K = key_type>
+            [[nodiscard]] const_iterator find(const key_arg<K> &key) const
+            {
+                return const_cast<Table &>(*this).find(key);
+            }
+
+            template <typename K = key_type>
+            [[nodiscard]] bool contains(const key_arg<K> &key) const
+            {
+                return FindPtr(key) != nullptr;
+            }
+            template <typename K = key_type>
+            [[nodiscard]] std::size_t count(const key_arg<K> &key) const
+            {
+                return contains(key);
+            }
+
+            // Returns the iterator to the next element.
+            iterator erase(const_iterator it) noexcept
+            {
+                std::size_t index = IndexOf(it);
+                std::destroy_at(slots + index);
+                elem_count--;
+
+                // If no probe sequence could have passed through this slot without stopping (there's an empty slot in every group containing it), it can be marked as empty.
+                std::size_t index_before = (index - group_width) & (capacity - 1);
+                mask_t empty_after = Group(ctrl + index).MatchEmpty();
+                mask_t empty_before = Group(ctrl + index_before).MatchEmpty();
+                bool was_never_full = empty_before && empty_after &&
+                    std::size_t(std::countr_zero(empty_after)) + std::size_t(std::countl_zero(mask_t(empty_before << (32 - group_width)))) < group_width;
+                if (was_never_full)
+                    growth_left++;
+                SetCtrl(index, was_never_full ? ctrl_empty : ctrl_deleted);
+
+                return IteratorAt(index); // This skips the now free slot.
+            }
+            iterator erase(iterator it) noexcept
+            {
+                return erase(const_iterator(it));
+            }
+
+            // Returns the number of erased elements, 0 or 1.
+            template <typename K = key_type>
+            std::size_t erase(const key_arg<K> &key)
+            {
+                std::size_t index = FindIndex(key, hash_func(key));
+                if (index == npos)
+                    return 0;
+                erase(const_iterator(IteratorAt(index)));
+                return 1;
+            }
+
+            // Erases the elements matching the predicate. Returns the number of erased elements.
+            template <typename F>
+            friend std::size_t erase_if(Table &table, F &&pred)
+            {
+                std::size_t old_count = table.elem_count;
+                for (auto it = table.begin(); it != table.end();)
+                {
+                    if (pred(std::as_const(*it)))
+                        it = table.erase(it);
+                    else
+                        ++it;
+                }
+                return old_count - table.elem_count;
+            }
+
+            // Order-independent.
+            [[nodiscard]] friend bool operator==(const Table &a, const Table &b)
+            {
+                if (a.size() != b.size())
+                    return false;
+                for (const value_type &elem : a)
+                {
+                    const value_type *other = b.FindPtr(Policy::Key(elem));
+                    if (!other || !(*other == elem))
+                        return false;
+                }
+                return true;
+            }
+        };
+
+        template <typename K, typename V>
+        struct MapPolicy
+        {
+            using key_type = K;
+            using value_type = std::pair<const K, V>;
+
+            [[nodiscard]] static const K &Key(const value_type &value) {return value.first;}
+
+            static void Transfer(value_type *to, value_type *from) noexcept
+            {
+                static_assert(std::is_nothrow_move_constructible_v<K> && std::is_nothrow_move_constructible_v<V>, "The keys and values must be nothrow-move-constructible.");
+                // Moving from the const key is fine, since the source is destroyed right away. This way we don't have to copy it.
+                std::construct_at(to, std::move(const_cast<K &>(from->first)), std::move(from->second));
+                std::destroy_at(from);
+            }
+        };
+
+        template <typename K>
+        struct SetPolicy
+        {
+            using key_type = K;
+            using value_type = K;
+
+            [[nodiscard]] static const K &Key(const value_type &value) {return value;}
+
+            static void Transfer(value_type *to, value_type *from) noexcept
+            {
+                static_assert(std::is_nothrow_move_constructible_v<K>, "The elements must be nothrow-move-constructible.");
+                std::construct_at(to, std::move(*from));
+                std::destroy_at(from);
+            }
+        };
+    }
+}
+
+// An open-addressing hash map. See the comment at the top of the file.
+template <typename K, typename V, typename Hasher = Hash::Hasher<>, typename Equal = std::equal_to<>>
+class FlatMap : public FlatHash::impl::Table<FlatHash::impl::MapPolicy<K, V>, Hasher, Equal>
+{
+    using base = FlatHash::impl::Table<FlatHash::impl::MapPolicy<K, V>, Hasher, Equal>;
+
+  public:
+    using mapped_type = V;
+    using typename base::key_type;
+    using typename base::value_type;
+    using typename base::iterator;
+    using typename base::const_iterator;
+
+    using base::base;
+
+    template <typename ...P>
+    std::pair<iterator, bool> try_emplace(const K &key, P &&... params)
+    {
+        return this->InsertWith(key, [&](value_type *ptr)
+        {
+            std::construct_at(ptr, std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<P>(params)...));
+        });
+    }
+    template <typename ...P>
+    std::pair<iterator, bool> try_emplace(K &&key, P &&... params)
+    {
+        return this->InsertWith(key, [&](value_type *ptr)
+        {
+            std::construct_at(ptr, std::piecewise_construct, std::forward_as_tuple(std::move(key)), std::forward_as_tuple(std::forward<P>(params)...));
+        });
+    }
+
+    template <typename VV>
+    std::pair<iterator, bool> insert_or_assign(const K &key, VV &&value)
+    {
+        auto ret = try_emplace(key, std::forward<VV>(value));
+        if (!ret.second)
+            ret.first->second = std::forward<VV>(value);
+        return ret;
+    }
+    template <typename VV>
+    std::pair<iterator, bool> insert_or_assign(K &&key, VV &&value)
+    {
+        auto ret = try_emplace(std::move(key), std::forward<VV>(value));
+        if (!ret.second)
+            ret.first->second = std::forward<VV>(value);
+        return ret;
+    }
+
+    V &operator[](const K &key)
+    {
+        return try_emplace(key).first->second;
+    }
+    V &operator[](K &&key)
+    {
+        return try_emplace(std::move(key)).first->second;
+    }
+
+    [[nodiscard]] V &at(const K &key)
+    {
+        return const_cast<V &>(std::as_const(*this).at(key));
+    }
+    [[nodiscard]] const V &at(const K &key) const
+    {
+        auto it = this->find(key);
+        if (it == this->end())
+            throw std::out_of_range("No such key in the `FlatMap`.");
+        return it->second;
+    }
+};
+
+// An open-addressing hash set. See the comment at the top of the file.
+template <typename K, typename Hasher = Hash::Hasher<>, typename Equal = std::equal_to<>>
+class FlatSet : public FlatHash::impl::Table<FlatHash::impl::SetPolicy<K>, Hasher, Equal>
+{
+    using base = FlatHash::impl::Table<FlatHash::impl::SetPolicy<K>, Hasher, Equal>;
+
+  public:
+    using base::base;
+};
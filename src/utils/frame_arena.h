@@ -0,0 +1,117 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// A bump-pointer allocator for the temporary objects that live at most until the end of the frame.
+// Use it through the `std::pmr` containers: `std::pmr::string str(&arena);`, `std::pmr::vector<T> vec(&arena);`.
+// Deallocation does nothing, all memory is reclaimed at once by `Reset()`, which should be called once per frame.
+// If a frame needs more than one chunk, `Reset()` replaces them with a single larger one, so the steady state has no allocations at all.
+class FrameArena : public std::pmr::memory_resource
+{
+    struct Chunk
+    {
+        std::unique_ptr<unsigned char[]> bytes;
+        std::size_t size = 0;
+    };
+
+    std::vector<Chunk> chunks; // Only the last one is being filled.
+    std::size_t pos = 0; // In the last chunk.
+
+    std::size_t min_chunk_size = 0;
+
+    // The statistics.
+    std::size_t used_bytes = 0;
+    std::size_t peak_used_bytes = 0;
+
+    void AddChunk(std::size_t min_size)
+    {
+        std::size_t size = std::max({min_size, min_chunk_size, chunks.empty() ? 0 : chunks.back().size * 2});
+        chunks.push_back({std::make_unique_for_overwrite<unsigned char[]>(size), size});
+        pos = 0;
+    }
+
+    void *do_allocate(std::size_t bytes, std::size_t alignment) override
+    {
+        if (!chunks.empty())
+        {
+            void *ptr = chunks.back().bytes.get() + pos;
+            std::size_t space = chunks.back().size - pos;
+            if (std::align(alignment, bytes, ptr, space))
+            {
+                pos = std::size_t(static_cast<unsigned char *>(ptr) - chunks.back().bytes.get()) + bytes;
+                used_bytes += bytes;
+                return ptr;
+            }
+        }
+
+        // The chunks are only aligned for `new`, so reserve some space for the alignment.
+        AddChunk(bytes + alignment);
+        void *ptr = chunks.back().bytes.get();
+        std::size_t space = chunks.back().size;
+        std::align(alignment, bytes, ptr, space);
+        pos = std::size_t(static_cast<unsigned char *>(ptr) - chunks.back().bytes.get()) + bytes;
+        used_bytes += bytes;
+        return ptr;
+    }
+
+    void do_deallocate(void *ptr, std::size_t bytes, std::size_t alignment) override
+    {
+        // Nothing to do, the memory is reclaimed by `Reset()`.
+        (void)ptr;
+        (void)bytes;
+        (void)alignment;
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+        return this == &other;
+    }
+
+  public:
+    explicit FrameArena(std::size_t min_chunk_size = 64 * 1024) : min_chunk_size(min_chunk_size) {}
+
+    // The memory is referenced by the containers.
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    // Invalidates everything allocated so far.
+    void Reset()
+    {
+        peak_used_bytes = std::max(peak_used_bytes, used_bytes);
+        used_bytes = 0;
+        pos = 0;
+
+        if (chunks.size() > 1)
+        {
+            // Merge the chunks into one, large enough for the entire frame.
+            std::size_t total = 0;
+            for (const Chunk &chunk : chunks)
+                total += chunk.size;
+            chunks.clear();
+            AddChunk(total);
+        }
+    }
+
+    // The number of bytes allocated since the last `Reset()`, not counting the alignment.
+    [[nodiscard]] std::size_t UsedBytes() const
+    {
+        return used_bytes;
+    }
+    // The max of `UsedBytes()` at the moments of `Reset()`.
+    [[nodiscard]] std::size_t PeakUsedBytes() const
+    {
+        return peak_used_bytes;
+    }
+
+    [[nodiscard]] std::size_t CapacityBytes() const
+    {
+        std::size_t ret = 0;
+        for (const Chunk &chunk : chunks)
+            ret += chunk.size;
+        return ret;
+    }
+};
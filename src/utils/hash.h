@@ -2,19 +2,130 @@
 
 #include <concepts>
 #include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <functional>
 #include <initializer_list>
+#include <ranges>
 #include <tuple>
+#include <type_traits>
 #include <utility>
 
+#if defined(_MSC_VER) && !defined(__SIZEOF_INT128__) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
 #include "meta/common.h"
+#include "utils/mat.h"
 
 namespace Hash
 {
+    namespace impl
+    {
+        // Those are from wyhash, which the byte hasher below is based on.
+        inline constexpr std::uint64_t secret[4] = {0xa0761d6478bd642f, 0xe7037ed1a0b428db, 0x8ebc6af09c88c6e3, 0x589965cc75374cc3};
+
+        // Multiplies two numbers into 128 bits, replaces `a` with the low half and `b` with the high half.
+        inline void Multiply(std::uint64_t &a, std::uint64_t &b)
+        {
+            #if defined(__SIZEOF_INT128__)
+            unsigned __int128 r = (unsigned __int128)a * b;
+            a = std::uint64_t(r);
+            b = std::uint64_t(r >> 64);
+            #elif defined(_MSC_VER) && defined(_M_X64)
+            a = _umul128(a, b, &b);
+            #else
+            std::uint64_t ha = a >> 32, hb = b >> 32, la = std::uint32_t(a), lb = std::uint32_t(b);
+            std::uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32);
+            std::uint64_t c = t < rl;
+            a = t + (rm1 << 32);
+            c += a < t;
+            b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+            #endif
+        }
+
+        // Multiplies two numbers into 128 bits, then xors the halves.
+        [[nodiscard]] inline std::uint64_t Mix(std::uint64_t a, std::uint64_t b)
+        {
+            Multiply(a, b);
+            return a ^ b;
+        }
+
+        [[nodiscard]] inline std::uint64_t Read8(const unsigned char *p)
+        {
+            std::uint64_t ret;
+            std::memcpy(&ret, p, sizeof ret);
+            return ret;
+        }
+        [[nodiscard]] inline std::uint64_t Read4(const unsigned char *p)
+        {
+            std::uint32_t ret;
+            std::memcpy(&ret, p, sizeof ret);
+            return ret;
+        }
+    }
+
+    // Hashes a range of bytes. This is wyhash, and it processes 48 bytes per iteration in three independent lanes.
+    // The result depends on the byte order of the platform, so don't save it anywhere.
+    [[nodiscard]] inline std::size_t Bytes(const void *data, std::size_t size, std::uint64_t seed = 0)
+    {
+        using impl::secret, impl::Mix, impl::Read8, impl::Read4;
+
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        seed ^= Mix(seed ^ secret[0], secret[1]);
+
+        std::uint64_t a = 0, b = 0;
+        if (size <= 16)
+        {
+            if (size >= 4)
+            {
+                std::size_t offset = (size >> 3) << 2;
+                a = (Read4(p) << 32) | Read4(p + offset);
+                b = (Read4(p + size - 4) << 32) | Read4(p + size - 4 - offset);
+            }
+            else if (size > 0)
+            {
+                a = (std::uint64_t(p[0]) << 16) | (std::uint64_t(p[size >> 1]) << 8) | p[size - 1];
+            }
+        }
+        else
+        {
+            std::size_t i = size;
+            if (i > 48)
+            {
+                std::uint64_t seed1 = seed, seed2 = seed;
+                do
+                {
+                    seed = Mix(Read8(p) ^ secret[1], Read8(p + 8) ^ seed);
+                    seed1 = Mix(Read8(p + 16) ^ secret[2], Read8(p + 24) ^ seed1);
+                    seed2 = Mix(Read8(p + 32) ^ secret[3], Read8(p + 40) ^ seed2);
+                    p += 48;
+                    i -= 48;
+                }
+                while (i > 48);
+                seed ^= seed1 ^ seed2;
+            }
+            while (i > 16)
+            {
+                seed = Mix(Read8(p) ^ secret[1], Read8(p + 8) ^ seed);
+                p += 16;
+                i -= 16;
+            }
+            a = Read8(p + i - 16);
+            b = Read8(p + i - 8);
+        }
+
+        a ^= secret[1];
+        b ^= seed;
+        impl::Multiply(a, b);
+        return std::size_t(Mix(a ^ secret[0] ^ size, b ^ secret[1]));
+    }
+
     // Combines hashes.
+    // Uses a multiplicative mix rather than the Boost-style shifts, so that the poorly distributed inputs (e.g. `std::hash` of integers, which is often an identity) still spread over all bits.
     inline void Append(std::size_t &dst, std::size_t src)
     {
-        dst ^= src + std::size_t(0x9E3779B97F4A7C16) + (dst << 6) + (dst >> 2); // That number is a fractional part of the golden ratio. Boost uses a similar thing.
+        dst = std::size_t(impl::Mix(std::uint64_t(dst) ^ impl::secret[0], std::uint64_t(src) ^ impl::secret[1]));
     }
 
     // Combines hashes.
@@ -86,10 +197,31 @@ namespace Hash
         // Checks if `std::hash` is specialized for the given type.
         template <typename T>
         concept std_hashable = requires(const T obj){std::hash<T>{}(obj);};
+
+        template <typename T>
+        concept has_custom_hash = requires(const T obj){impl::CallAdlHash(obj);} || requires(const T obj){{obj.hash()} -> std::same_as<std::size_t>;};
+
+        // Whether a class can be hashed by its bytes, if it has unique object representations.
+        // The classes with `std::hash` are excluded by default, since it can hash something other than the bytes (e.g. `std::string_view` hashes the referenced characters).
+        template <typename T> struct HashClassAsBytes : std::bool_constant<!std_hashable<T>> {};
+        template <int D, typename T> struct HashClassAsBytes<Math::vec<D, T>> : std::true_type {};
+
+        // The types that are hashed by their bytes: the ones where equal values have equal bytes (no padding, no floating-point), unless they provide a custom hash.
+        // This includes integers, enums, pointers, integer vectors, and the structs made of those.
+        template <typename T>
+        concept bytes_hashable = std::has_unique_object_representations_v<T> && !has_custom_hash<T> && (std::is_scalar_v<T> || HashClassAsBytes<T>::value);
     }
 
+    // Specialization using the object bytes.
+    // This is preferred over `std::hash`, which is usually an identity for integers (and a weak combination of those for vectors), which is bad for the hash tables.
+    template <typename T> requires impl::bytes_hashable<T>
+    struct Hasher<T>
+    {
+        [[nodiscard]] std::size_t operator()(const T &obj) const {return Hash::Bytes(&obj, sizeof obj);}
+    };
+
     // Specialization using `std::hash`.
-    template <typename T> requires impl::std_hashable<T>
+    template <typename T> requires (impl::std_hashable<T> && !impl::bytes_hashable<T>)
     struct Hasher<T>
     {
         [[nodiscard]] std::size_t operator()(const T &obj) const {return std::hash<T>{}(obj);}
@@ -131,11 +263,15 @@ namespace Hash
     }
 
     // Containers.
-    template <typename T> requires (impl::container<T> && !impl::std_hashable<T>)
+    template <typename T> requires (impl::container<T> && !impl::std_hashable<T> && !impl::bytes_hashable<T>)
     struct Hasher<T>
     {
         [[nodiscard]] std::size_t operator()(const T &obj) const
         {
+            // Hash the contiguous elements in bulk if possible.
+            if constexpr (std::ranges::contiguous_range<const T> && std::ranges::sized_range<const T> && impl::bytes_hashable<typename T::value_type>)
+                return Hash::Bytes(std::ranges::data(obj), std::ranges::size(obj) * sizeof(typename T::value_type));
+
             std::size_t ret = 0;
             for (const auto &elem : obj)
                 Append(ret, Hash::Compute(elem)); // Qualified calls to `Hash::Compute` prevent unwanted ADL.
@@ -144,7 +280,7 @@ namespace Hash
     };
 
     // Tuple-like types.
-    template <typename T> requires (impl::tuple_like<T> && !impl::container<T> && !impl::std_hashable<T>)
+    template <typename T> requires (impl::tuple_like<T> && !impl::container<T> && !impl::std_hashable<T> && !impl::bytes_hashable<T>)
     struct Hasher<T>
     {
         [[nodiscard]] std::size_t operator()(const T &obj) const
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "program/errors.h"
+
+// A bit set that can quickly find the next set or clear bit, even if it's far away.
+// In addition to the bits themselves, stores two summaries with one bit per 64-bit word: whether the word has any set bits, and whether it has any clear bits.
+// Then searching skips 4096 bits per summary word, so e.g. finding a free slot in a mostly full pool is cheap.
+class HierarchicalBitSet
+{
+  public:
+    using word_t = std::uint64_t;
+    static constexpr std::size_t word_bits = 64;
+
+    // Returned by the search functions when nothing is found.
+    static constexpr std::size_t npos = std::size_t(-1);
+
+  private:
+    std::size_t bit_count = 0;
+    std::vector<word_t> words; // The bits past `bit_count` are always zero.
+    std::vector<word_t> summary_any_set; // Bit `i` is set if `words[i]` has any set bits.
+    std::vector<word_t> summary_any_clear; // Bit `i` is set if `words[i]` has any clear bits, among the first `bit_count` bits.
+
+    // The bits of `words[i]` that are less than `bit_count`.
+    [[nodiscard]] word_t ValidMask(std::size_t i) const
+    {
+        if (i + 1 < words.size() || bit_count % word_bits == 0)
+            return word_t(-1);
+        return (word_t(1) << bit_count % word_bits) - 1;
+    }
+
+    void UpdateSummary(std::size_t i)
+    {
+        word_t mask = word_t(1) << i % word_bits;
+        if (words[i])
+            summary_any_set[i / word_bits] |= mask;
+        else
+            summary_any_set[i / word_bits] &= ~mask;
+        if (words[i] != ValidMask(i))
+            summary_any_clear[i / word_bits] |= mask;
+        else
+            summary_any_clear[i / word_bits] &= ~mask;
+    }
+
+    void UpdateAllSummaries()
+    {
+        for (std::size_t i = 0; i < words.size(); i++)
+            UpdateSummary(i);
+    }
+
+    // Finds the first bit at or after `from` in `words`, which is set after applying `transform` to each word and `summary` is set for it.
+    template <typename F>
+    [[nodiscard]] std::size_t FindNext(std::size_t from, const std::vector<word_t> &summary, F &&transform) const
+    {
+        if (from >= bit_count)
+            return npos;
+
+        std::size_t i = from / word_bits;
+        if (word_t word = transform(i) & (word_t(-1) << from % word_bits))
+            return i * word_bits + std::size_t(std::countr_zero(word));
+
+        // Search the summary, starting from the next word.
+        i++;
+        for (std::size_t s = i / word_bits; s < summary.size(); s++)
+        {
+            word_t summary_word = summary[s];
+            if (s == i / word_bits)
+                summary_word &= word_t(-1) << i % word_bits;
+            if (summary_word)
+            {
+                std::size_t word_index = s * word_bits + std::size_t(std::countr_zero(summary_word));
+                return word_index * word_bits + std::size_t(std::countr_zero(transform(word_index)));
+            }
+        }
+        return npos;
+    }
+
+  public:
+    HierarchicalBitSet() {}
+    explicit HierarchicalBitSet(std::size_t size)
+    {
+        Resize(size);
+    }
+
+    [[nodiscard]] std::size_t Size() const
+    {
+        return bit_count;
+    }
+
+    // The new bits are cleared.
+    void Resize(std::size_t new_size)
+    {
+        bit_count = new_size;
+        words.resize((new_size + word_bits - 1) / word_bits);
+        if (!words.empty())
+            words.back() &= ValidMask(words.size() - 1);
+        summary_any_set.assign((words.size() + word_bits - 1) / word_bits, 0);
+        summary_any_clear.assign(summary_any_set.size(), 0);
+        UpdateAllSummaries();
+    }
+
+    [[nodiscard]] bool Get(std::size_t i) const
+    {
+        ASSERT(i < bit_count, "Bit index is out of range.");
+        return words[i / word_bits] >> i % word_bits & 1;
+    }
+
+    void Set(std::size_t i, bool value = true)
+    {
+        ASSERT(i < bit_count, "Bit index is out of range.");
+        word_t &word = words[i / word_bits];
+        word_t mask = word_t(1) << i % word_bits;
+        word_t new_word = value ? word | mask : word & ~mask;
+        if (new_word == word)
+            return;
+        word = new_word;
+        UpdateSummary(i / word_bits);
+    }
+
+    // Sets or clears the bits in `[begin, end)`, a word at a time.
+    void SetRange(std::size_t begin, std::size_t end, bool value = true)
+    {
+        ASSERT(begin <= end && end <= bit_count, "Bit range is out of range.");
+        if (begin == end)
+            return;
+
+        std::size_t first_word = begin / word_bits, last_word = (end - 1) / word_bits;
+        for (std::size_t i = first_word; i <= last_word; i++)
+        {
+            word_t mask = word_t(-1);
+            if (i == first_word)
+                mask &= word_t(-1) << begin % word_bits;
+            if (i == last_word && end % word_bits != 0)
+                mask &= (word_t(1) << end % word_bits) - 1;
+
+            if (value)
+                words[i] |= mask;
+            else
+                words[i] &= ~mask;
+            UpdateSummary(i);
+        }
+    }
+
+    // Clears all bits.
+    void Clear()
+    {
+        std::fill(words.begin(), words.end(), 0);
+        UpdateAllSummaries();
+    }
+
+    // Returns the index of the first set bit at or after `from`, or `npos` if none.
+    [[nodiscard]] std::size_t FindNextSet(std::size_t from = 0) const
+    {
+        return FindNext(from, summary_any_set, [&](std::size_t i){return words[i];});
+    }
+    // Returns the index of the first clear bit at or after `from`, or `npos` if none.
+    [[nodiscard]] std::size_t FindNextClear(std::size_t from = 0) const
+    {
+        return FindNext(from, summary_any_clear, [&](std::size_t i){return ~words[i] & ValidMask(i);});
+    }
+
+    [[nodiscard]] bool Any() const
+    {
+        return std::any_of(summary_any_set.begin(), summary_any_set.end(), [](word_t word){return word != 0;});
+    }
+
+    [[nodiscard]] std::size_t Count() const
+    {
+        std::size_t ret = 0;
+        for (word_t word : words)
+            ret += std::size_t(std::popcount(word));
+        return ret;
+    }
+
+    // Bitwise operations with another set of the same size.
+    HierarchicalBitSet &operator|=(const HierarchicalBitSet &other)
+    {
+        ASSERT(bit_count == other.bit_count, "Bit set sizes don't match.");
+        for (std::size_t i = 0; i < words.size(); i++)
+            words[i] |= other.words[i];
+        UpdateAllSummaries();
+        return *this;
+    }
+    HierarchicalBitSet &operator&=(const HierarchicalBitSet &other)
+    {
+        ASSERT(bit_count == other.bit_count, "Bit set sizes don't match.");
+        for (std::size_t i = 0; i < words.size(); i++)
+            words[i] &= other.words[i];
+        UpdateAllSummaries();
+        return *this;
+    }
+
+    // The raw words, for the bulk reads. The bits past `Size()` are zero.
+    [[nodiscard]] const std::vector<word_t> &Words() const
+    {
+        return words;
+    }
+};
@@ -0,0 +1,152 @@
+#include "jobs.h"
+
+namespace Jobs
+{
+    bool Handle::IsDone() const
+    {
+        return state && state->done.load(std::memory_order_acquire);
+    }
+
+    void Handle::Wait()
+    {
+        if (!state)
+            return;
+
+        while (!IsDone())
+        {
+            if (pool->RunOne())
+                continue;
+
+            // Nothing to help with, the job must be running on another thread.
+            std::unique_lock lock(pool->done_mutex);
+            pool->done_cond.wait(lock, [&]{return IsDone() || pool->num_queued > 0;});
+        }
+
+        if (state->exception)
+            std::rethrow_exception(state->exception);
+    }
+
+    bool Pool::RunOne()
+    {
+        std::shared_ptr<impl::JobState> job;
+
+        std::size_t first = current_pool == this ? current_worker : 0;
+        for (std::size_t i = 0; i < workers.size() && !job; i++)
+        {
+            Worker &worker = *workers[(first + i) % workers.size()];
+            std::lock_guard lock(worker.mutex);
+            if (worker.queue.empty())
+                continue;
+
+            // Our own queue is used as a stack, for locality. The others are stolen from the other end.
+            if (i == 0 && current_pool == this)
+            {
+                job = std::move(worker.queue.back());
+                worker.queue.pop_back();
+            }
+            else
+            {
+                job = std::move(worker.queue.front());
+                worker.queue.pop_front();
+            }
+        }
+
+        if (!job)
+            return false;
+        num_queued--;
+
+        try
+        {
+            job->func();
+        }
+        catch (...)
+        {
+            job->exception = std::current_exception();
+        }
+        job->func = nullptr; // Release the captures early.
+
+        {
+            std::lock_guard lock(done_mutex);
+            job->done.store(true, std::memory_order_release);
+        }
+        done_cond.notify_all();
+        return true;
+    }
+
+    void Pool::WorkerFunc(std::size_t index)
+    {
+        current_pool = this;
+        current_worker = index;
+
+        while (true)
+        {
+            if (RunOne())
+                continue;
+
+            std::unique_lock lock(sleep_mutex);
+            sleep_cond.wait(lock, [&]{return stopping || num_queued > 0;});
+            if (stopping && num_queued == 0)
+                return;
+        }
+    }
+
+    Pool::Pool(std::size_t num_threads)
+    {
+        if (num_threads == 0)
+            num_threads = std::max(1u, std::thread::hardware_concurrency()) - 1u;
+        num_threads = std::max(num_threads, std::size_t(1));
+
+        workers.reserve(num_threads);
+        for (std::size_t i = 0; i < num_threads; i++)
+            workers.push_back(std::make_unique<Worker>());
+        // Start the threads after all workers exist, since they steal from each other.
+        for (std::size_t i = 0; i < num_threads; i++)
+            workers[i]->thread = std::thread([this, i]{WorkerFunc(i);});
+    }
+
+    Pool::~Pool()
+    {
+        {
+            std::lock_guard lock(sleep_mutex);
+            stopping = true;
+        }
+        sleep_cond.notify_all();
+        for (auto &worker : workers)
+            worker->thread.join();
+    }
+
+    Handle Pool::Submit(std::function<void()> func)
+    {
+        Handle ret;
+        ret.pool = this;
+        ret.state = std::make_shared<impl::JobState>();
+        ret.state->func = std::move(func);
+
+        // Count the job before queueing it, so the counter can't go below zero. The threads that wake up too early simply try again.
+        {
+            std::lock_guard lock(sleep_mutex);
+            num_queued++;
+        }
+
+        std::size_t index = current_pool == this ? current_worker : next_queue++ % workers.size();
+        {
+            std::lock_guard lock(workers[index]->mutex);
+            workers[index]->queue.push_back(ret.state);
+        }
+        sleep_cond.notify_one();
+
+        // Wake up the threads waiting in `Handle::Wait()`, so they can help.
+        {
+            std::lock_guard lock(done_mutex);
+        }
+        done_cond.notify_all();
+
+        return ret;
+    }
+
+    Pool &DefaultPool()
+    {
+        static Pool ret;
+        return ret;
+    }
+}
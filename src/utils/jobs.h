@@ -0,0 +1,196 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "utils/mat.h"
+
+namespace Jobs
+{
+    class Pool;
+
+    namespace impl
+    {
+        struct JobState
+        {
+            std::function<void()> func;
+            std::atomic<bool> done = false;
+            std::exception_ptr exception; // Written before `done` is set.
+        };
+    }
+
+    // Refers to a job submitted to a `Pool`.
+    class Handle
+    {
+        friend Pool;
+
+        Pool *pool = nullptr;
+        std::shared_ptr<impl::JobState> state;
+
+      public:
+        Handle() {}
+
+        [[nodiscard]] explicit operator bool() const
+        {
+            return bool(state);
+        }
+
+        // Returns true if the job finished (or failed).
+        [[nodiscard]] bool IsDone() const;
+
+        // Blocks until the job finishes, running other jobs from the pool in the meantime. Rethrows the exception thrown by the job, if any.
+        void Wait();
+    };
+
+    // A work-stealing thread pool.
+    // Each worker has its own queue. It takes the newest job from its own queue, and if it's empty, steals the oldest jobs from the others.
+    // The jobs submitted from the workers go into their own queues, so nested parallelism works well. Waiting in a job runs other jobs instead of blocking.
+    class Pool
+    {
+        friend Handle;
+
+        struct Worker
+        {
+            std::mutex mutex;
+            std::deque<std::shared_ptr<impl::JobState>> queue;
+            std::thread thread;
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers;
+
+        std::mutex sleep_mutex;
+        std::condition_variable sleep_cond; // Notified when a job is submitted.
+        std::atomic<std::size_t> num_queued = 0; // Increments are made under `sleep_mutex`, to not miss the wakeups.
+        bool stopping = false;
+
+        std::mutex done_mutex;
+        std::condition_variable done_cond; // Notified when a job finishes.
+
+        std::atomic<std::size_t> next_queue = 0; // The jobs submitted from outside of the pool are spread across the queues.
+
+        inline static thread_local const Pool *current_pool = nullptr;
+        inline static thread_local std::size_t current_worker = 0;
+
+        // Runs one queued job, if any, preferring the queue of the current worker. Returns false if all queues are empty.
+        bool RunOne();
+
+        void WorkerFunc(std::size_t index);
+
+      public:
+        // If `num_threads` is 0, uses one less than the number of cores (since the thread that waits for the jobs helps running them), but at least 1.
+        Pool(std::size_t num_threads = 0);
+
+        Pool(const Pool &) = delete;
+        Pool &operator=(const Pool &) = delete;
+
+        // Runs the remaining jobs, then stops the threads.
+        ~Pool();
+
+        [[nodiscard]] std::size_t ThreadCount() const
+        {
+            return workers.size();
+        }
+
+        // Returns `i + 1` when called from the `i`-th worker of this pool, or 0 from any other thread, including the one waiting for the jobs.
+        // The result is less than `ThreadCount() + 1`. Use this to index per-thread scratch data, see `PerThread`.
+        [[nodiscard]] std::size_t CurrentThreadIndex() const
+        {
+            return current_pool == this ? current_worker + 1 : 0;
+        }
+
+        // Queues a job. Can be called from any thread, including from other jobs.
+        Handle Submit(std::function<void()> func);
+
+        // Calls `func(i)` for every `i` in `[0, count)`, spread across the pool, and waits for it to finish. Rethrows the first exception, if any.
+        // `chunk_size` is the number of consecutive indices per job. If 0, splits the range into several jobs per thread.
+        template <typename F>
+        void ParallelFor(std::size_t count, F &&func, std::size_t chunk_size = 0)
+        {
+            if (count == 0)
+                return;
+            if (chunk_size == 0)
+                chunk_size = std::max(std::size_t(1), count / ((ThreadCount() + 1) * 4));
+
+            std::vector<Handle> handles;
+            handles.reserve((count + chunk_size - 1) / chunk_size);
+            for (std::size_t begin = 0; begin < count; begin += chunk_size)
+            {
+                std::size_t end = std::min(count, begin + chunk_size);
+                handles.push_back(Submit([&func, begin, end]
+                {
+                    for (std::size_t i = begin; i < end; i++)
+                        func(i);
+                }));
+            }
+
+            std::exception_ptr exception;
+            for (Handle &handle : handles)
+            {
+                try
+                {
+                    handle.Wait();
+                }
+                catch (...)
+                {
+                    if (!exception)
+                        exception = std::current_exception();
+                }
+            }
+            if (exception)
+                std::rethrow_exception(exception);
+        }
+
+        // Calls `func(pos)` for every `pos` in `vector_range(size)`. Each job handles one slice along the last coordinate (so a row for 2D vectors).
+        template <typename T, typename F> requires Math::vector<T>
+        void ParallelFor(T size, F &&func)
+        {
+            constexpr int last = Math::vec_size_v<T> - 1;
+            if ((size <= 0).any())
+                return;
+
+            ParallelFor(std::size_t(size[last]), [&](std::size_t i)
+            {
+                T begin(0), end = size;
+                begin[last] = Math::vec_base_t<T>(i);
+                end[last] = Math::vec_base_t<T>(i + 1);
+                for (T pos : begin <= vector_range < end)
+                    func(pos);
+            }, 1);
+        }
+    };
+
+    // The pool shared by the whole program, created on first use.
+    [[nodiscard]] Pool &DefaultPool();
+
+    // Scratch data for the jobs, one object per thread of a pool (plus one for the threads outside of it).
+    // Only one thread outside of the pool should run the jobs at a time, since all of them share the same object.
+    template <typename T>
+    class PerThread
+    {
+        const Pool *pool = nullptr;
+        std::vector<T> objects;
+
+      public:
+        explicit PerThread(const Pool &pool = DefaultPool()) : pool(&pool), objects(pool.ThreadCount() + 1) {}
+
+        // Returns the object for the current thread.
+        [[nodiscard]] T &Local()
+        {
+            return objects[pool->CurrentThreadIndex()];
+        }
+
+        // Lets you access all objects, e.g. to merge the results.
+        [[nodiscard]] auto begin() {return objects.begin();}
+        [[nodiscard]] auto end() {return objects.end();}
+    };
+}
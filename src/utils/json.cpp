@@ -1,18 +1,162 @@
 #include "json.h"
 
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstdint>
 #include <cstring>
-#include <limits>
 #include <ostream>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "strings/lexical_cast.h"
 #include "strings/symbol_position.h"
 
+// The scanning kernels. Each finds the first character that ends a run (whitespace, string characters without escapes, or digits).
+// The null terminator always ends the runs, so they never read past the block containing it.
+// The SIMD versions only use aligned loads, which can't cross a page boundary, so reading past the terminator can't fault.
+namespace JsonScan
+{
+    #if defined(__SSE2__) || (defined(__aarch64__) && defined(__ARM_NEON))
+    constexpr std::size_t block_size = 16;
+
+    #if defined(__SSE2__)
+    using block_t = __m128i;
+    constexpr int bits_per_char = 1;
+
+    [[nodiscard]] __attribute__((no_sanitize("address"))) static block_t Load(const char *ptr) {return _mm_load_si128(reinterpret_cast<const __m128i *>(ptr));}
+    [[nodiscard]] static block_t Splat(char ch) {return _mm_set1_epi8(ch);}
+    [[nodiscard]] static block_t Equal(block_t a, block_t b) {return _mm_cmpeq_epi8(a, b);}
+    [[nodiscard]] static block_t Less(block_t a, block_t b) {return _mm_cmplt_epi8(a, b);} // Signed.
+    [[nodiscard]] static block_t Or(block_t a, block_t b) {return _mm_or_si128(a, b);}
+    [[nodiscard]] static block_t AndNot(block_t a, block_t b) {return _mm_andnot_si128(b, a);} // `a & ~b`.
+    [[nodiscard]] static std::uint64_t ToMask(block_t a) {return unsigned(_mm_movemask_epi8(a));}
+    #else
+    using block_t = int8x16_t;
+    constexpr int bits_per_char = 4;
+
+    [[nodiscard]] __attribute__((no_sanitize("address"))) static block_t Load(const char *ptr) {return vld1q_s8(reinterpret_cast<const std::int8_t *>(ptr));}
+    [[nodiscard]] static block_t Splat(char ch) {return vdupq_n_s8(ch);}
+    [[nodiscard]] static block_t Equal(block_t a, block_t b) {return vreinterpretq_s8_u8(vceqq_s8(a, b));}
+    [[nodiscard]] static block_t Less(block_t a, block_t b) {return vreinterpretq_s8_u8(vcltq_s8(a, b));} // Signed.
+    [[nodiscard]] static block_t Or(block_t a, block_t b) {return vorrq_s8(a, b);}
+    [[nodiscard]] static block_t AndNot(block_t a, block_t b) {return vbicq_s8(a, b);} // `a & ~b`.
+    [[nodiscard]] static std::uint64_t ToMask(block_t a)
+    {
+        // Narrowing with a shift leaves 4 bits per character.
+        return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_s8(a), 4)), 0);
+    }
+    #endif
+
+    // Returns the first character for which `stop(block)` sets the mask bits.
+    template <typename F>
+    [[nodiscard]] static const char *FindFirst(const char *cur, F &&stop)
+    {
+        std::uintptr_t offset = reinterpret_cast<std::uintptr_t>(cur) % block_size;
+        const char *block = cur - offset;
+
+        // Discard the characters before `cur` in the first block.
+        std::uint64_t mask = ToMask(stop(Load(block))) >> (offset * bits_per_char);
+        if (mask)
+            return cur + std::countr_zero(mask) / bits_per_char;
+
+        while (true)
+        {
+            block += block_size;
+            mask = ToMask(stop(Load(block)));
+            if (mask)
+                return block + std::countr_zero(mask) / bits_per_char;
+        }
+    }
+
+    [[nodiscard]] __attribute__((noinline)) static const char *FindNonWhitespace(const char *cur)
+    {
+        return FindFirst(cur, [](block_t b)
+        {
+            block_t is_space = AndNot(Less(b, Splat(' ' + 1)), Less(b, Splat(1)));
+            return AndNot(Splat(-1), is_space);
+        });
+    }
+
+    [[nodiscard]] __attribute__((noinline)) static const char *FindNonDigit(const char *cur)
+    {
+        return FindFirst(cur, [](block_t b)
+        {
+            block_t is_digit = AndNot(Less(b, Splat('9' + 1)), Less(b, Splat('0')));
+            return AndNot(Splat(-1), is_digit);
+        });
+    }
+
+    // Most runs of whitespace and digits are short, so we check a few characters one by one before switching to SIMD.
+    constexpr int num_scalar_chars = 8;
+
+    // Skips `1..32`.
+    [[nodiscard]] inline static const char *SkipWhitespace(const char *cur)
+    {
+        const char *scalar_end = cur + num_scalar_chars;
+        while (*cur > '\0' && *cur <= ' ')
+        {
+            if (++cur == scalar_end)
+                return FindNonWhitespace(cur);
+        }
+        return cur;
+    }
+
+    // Skips anything other than `"`, `\` and `0..31`.
+    [[nodiscard]] static const char *SkipStringChars(const char *cur)
+    {
+        return FindFirst(cur, [](block_t b)
+        {
+            block_t is_control = AndNot(Less(b, Splat(' ')), Less(b, Splat(0)));
+            return Or(Or(Equal(b, Splat('"')), Equal(b, Splat('\\'))), is_control);
+        });
+    }
+
+    // Skips `0..9`.
+    [[nodiscard]] inline static const char *SkipDigits(const char *cur)
+    {
+        const char *scalar_end = cur + num_scalar_chars;
+        while (*cur >= '0' && *cur <= '9')
+        {
+            if (++cur == scalar_end)
+                return FindNonDigit(cur);
+        }
+        return cur;
+    }
+    #else
+    [[nodiscard]] static const char *SkipWhitespace(const char *cur)
+    {
+        while (*cur > '\0' && *cur <= ' ')
+            cur++;
+        return cur;
+    }
+
+    [[nodiscard]] static const char *SkipStringChars(const char *cur)
+    {
+        while (*cur != '"' && *cur != '\\' && !(*cur >= '\0' && *cur < ' '))
+            cur++;
+        return cur;
+    }
+
+    [[nodiscard]] static const char *SkipDigits(const char *cur)
+    {
+        while (*cur >= '0' && *cur <= '9')
+            cur++;
+        return cur;
+    }
+    #endif
+}
+
 void Json::ParseSkipWhitespace(const char *&cur)
 {
-    while (*cur > '\0' && *cur <= ' ')
-        cur++;
+    cur = JsonScan::SkipWhitespace(cur);
 }
 
-std::string Json::ParseStringLow(const char *&cur)
+const char *Json::ScanStringLow(const char *&cur, bool &has_escapes)
 {
     ParseSkipWhitespace(cur);
 
@@ -21,16 +165,28 @@ std::string Json::ParseStringLow(const char *&cur)
     cur++;
 
     const char *begin = cur;
-    bool backslash_preceding = false;
+    has_escapes = false;
 
     while (true)
     {
+        // Skip the regular characters in bulk.
+        cur = JsonScan::SkipStringChars(cur);
+
         // Stop on `"`.
-        if (*cur == '"' && !backslash_preceding)
+        if (*cur == '"')
             break;
 
-        // Handle `\`.
-        backslash_preceding = (*cur == '\\' && !backslash_preceding);
+        // Handle `\`. Skip the next character, unless it's invalid.
+        if (*cur == '\\')
+        {
+            has_escapes = true;
+            cur++;
+            if (!(*cur >= '\0' && *cur < ' '))
+            {
+                cur++;
+                continue;
+            }
+        }
 
         // Error if no more data.
         if (*cur == '\0')
@@ -40,20 +196,23 @@ std::string Json::ParseStringLow(const char *&cur)
         }
 
         // Error on non-printable character.
-        if (*cur > '\0' && *cur < ' ')
-            Program::Error("Invalid character in a string: 0x", STR(((unsigned char)*cur)"02x"), "."); // Writing `0x` manually instead of with `#` because I want a lowercase `x`.
-
-        cur++;
+        Program::Error("Invalid character in a string: 0x", STR(((unsigned char)*cur)"02x"), "."); // Writing `0x` manually instead of with `#` because I want a lowercase `x`.
     }
 
-    const char *end = cur;
+    return begin;
+}
 
-    std::string ret;
+void Json::UnescapeStringLow(const char *begin, const char *end, std::string &out)
+{
+    const char *cur;
     for (cur = begin; cur != end; cur++)
     {
         if (*cur != '\\')
         {
-            ret += *cur;
+            // Copy everything up to the next escape sequence.
+            const char *next = std::find(cur, end, '\\');
+            out.append(cur, next);
+            cur = next - 1; // This is needed because of the auto increment at the end of loop.
         }
         else
         {
@@ -65,22 +224,22 @@ std::string Json::ParseStringLow(const char *&cur)
               case '\\':
               case '/':
               case '"':
-                ret += *cur;
+                out += *cur;
                 break;
               case 'b':
-                ret += '\b';
+                out += '\b';
                 break;
               case 'f':
-                ret += '\f';
+                out += '\f';
                 break;
               case 'n':
-                ret += '\n';
+                out += '\n';
                 break;
               case 'r':
-                ret += '\r';
+                out += '\r';
                 break;
               case 't':
-                ret += '\t';
+                out += '\t';
                 break;
               case 'u':
                 {
@@ -104,30 +263,230 @@ std::string Json::ParseStringLow(const char *&cur)
                     }
                     if (value < 128)
                     {
-                        ret += char(value);
+                        out += char(value);
                     }
                     else if (value < 2048) // 2048 = 2^11
                     {
-                        ret += char(0b1100'0000 + (value >> 6));
-                        ret += char(0b1000'0000 + (value & 0b0011'1111));
+                        out += char(0b1100'0000 + (value >> 6));
+                        out += char(0b1000'0000 + (value & 0b0011'1111));
                     }
                     else
                     {
-                        ret += char(0b1110'0000 + (value >> 12));
-                        ret += char(0b1000'0000 + ((value >> 6) & 0b0011'1111));
-                        ret += char(0b1000'0000 + (value & 0b0011'1111));
+                        out += char(0b1110'0000 + (value >> 12));
+                        out += char(0b1000'0000 + ((value >> 6) & 0b0011'1111));
+                        out += char(0b1000'0000 + (value & 0b0011'1111));
                     }
                     cur--; // This is needed because of the auto increment at the end of loop.
                 }
             }
         }
     }
+}
+
+Json::Node Json::ParseStringLow(const char *&cur)
+{
+    bool has_escapes;
+    const char *begin = ScanStringLow(cur, has_escapes);
+
+    Node ret;
+    ret.kind = string;
+    ret.index = chars.size();
+    if (has_escapes)
+        UnescapeStringLow(begin, cur, chars);
+    else
+        chars.append(begin, cur);
+    ret.size = chars.size() - ret.index;
 
     cur++; // Skip the `"`.
     return ret;
 }
 
-Json Json::ParseLow(const char *&cur, int allowed_depth)
+bool Json::ScanIntArrayLow(const char *&cur, std::vector<int> &out)
+{
+    // This is a fast path for the arrays of integers, parsed with `std::from_chars()` directly from the input into `out`.
+    // On anything unusual we return false without moving `cur` or changing `out`, and let the generic parser handle it, including the errors.
+
+    const char *pos = cur;
+    if (*pos != '[')
+        return false;
+    pos++;
+
+    std::size_t first = out.size();
+
+    while (true)
+    {
+        ParseSkipWhitespace(pos);
+
+        int value = 0;
+        const char *end = JsonScan::SkipDigits(pos + (*pos == '-'));
+        auto [ptr, ec] = std::from_chars(pos, end, value);
+        if (ec != std::errc{} || ptr != end || ptr == pos)
+        {
+            out.resize(first);
+            return false;
+        }
+        out.push_back(value);
+        pos = end;
+
+        ParseSkipWhitespace(pos);
+        if (*pos == ']')
+            break;
+        if (*pos != ',')
+        {
+            out.resize(first);
+            return false;
+        }
+        pos++;
+    }
+
+    cur = pos + 1; // Skip `]`.
+    return true;
+}
+
+bool Json::TryParseIntArrayLow(const char *&cur, Node &ret)
+{
+    std::size_t first = ints.size();
+    if (!ScanIntArrayLow(cur, ints))
+        return false;
+    ret.kind = int_array;
+    ret.index = first;
+    ret.size = ints.size() - first;
+    return true;
+}
+
+Json::Node Json::FinishArray(ParseStacks &stacks, std::size_t first)
+{
+    auto begin = stacks.elements.begin() + first;
+    auto end = stacks.elements.end();
+
+    Node ret;
+    ret.kind = array;
+    ret.size = end - begin;
+
+    // Store the arrays of the same numeric type compactly.
+    if (begin != end && std::all_of(begin, end, [](const Node &node){return node.kind == num_int;}))
+    {
+        ret.kind = int_array;
+        ret.index = ints.size();
+        for (auto it = begin; it != end; it++)
+            ints.push_back(it->num_int);
+    }
+    else if (begin != end && std::all_of(begin, end, [](const Node &node){return node.kind == num_real;}))
+    {
+        ret.kind = real_array;
+        ret.index = reals.size();
+        for (auto it = begin; it != end; it++)
+            reals.push_back(it->num_real);
+    }
+    else
+    {
+        ret.index = nodes.size();
+        nodes.insert(nodes.end(), begin, end);
+    }
+
+    stacks.elements.erase(begin, end);
+    return ret;
+}
+
+Json::Node Json::FinishObject(ParseStacks &stacks, std::size_t first)
+{
+    auto begin = stacks.members.begin() + first;
+    auto end = stacks.members.end();
+
+    // Stable, because the first one of the duplicate keys wins.
+    std::stable_sort(begin, end, [&](const auto &a, const auto &b){return StringOf(a.first) < StringOf(b.first);});
+
+    Node ret;
+    ret.kind = object;
+    ret.index = nodes.size();
+
+    for (auto it = begin; it != end; it++)
+    {
+        if (it != begin && StringOf(it->first) == StringOf(std::prev(it)->first))
+            continue;
+        nodes.push_back(it->first);
+        nodes.push_back(it->second);
+        ret.size++;
+    }
+
+    stacks.members.erase(begin, end);
+    return ret;
+}
+
+bool Json::ParseNumberLow(const char *&cur, Node &ret)
+{
+    std::string str;
+    bool real = false;
+
+    if (*cur == '-')
+    {
+        str += '-';
+        cur++;
+    }
+
+    const char *digits_end = JsonScan::SkipDigits(cur);
+    str.append(cur, digits_end);
+    cur = digits_end;
+
+    if (str.empty())
+        return false;
+
+    if (*cur == '.')
+    {
+        cur++;
+
+        real = true;
+        str += '.';
+
+        digits_end = JsonScan::SkipDigits(cur);
+        str.append(cur, digits_end);
+        cur = digits_end;
+
+        if (str.back() == '.')
+            Program::Error("Expected a digit after decimal point.");
+    }
+
+    if (*cur == 'e' || *cur == 'E')
+    {
+        cur++;
+
+        real = true;
+        str += 'e';
+
+        if (*cur == '+' || *cur == '-')
+            str += *cur++;
+
+        digits_end = JsonScan::SkipDigits(cur);
+        str.append(cur, digits_end);
+        cur = digits_end;
+
+        if (str.back() == 'e' || str.back() == '+' || str.back() == '-')
+            Program::Error("Expected a digit after `e`, possibly after a sign.");
+    }
+
+    if (real)
+    {
+        // Not `std::strtod()`, because it depends on the locale.
+        ret.kind = num_real;
+        ret.num_real = Strings::FromString<double>(str);
+        return true;
+    }
+    else
+    {
+        int num = 0;
+        auto [ptr, ec] = std::from_chars(str.data(), str.data() + str.size(), num);
+        if (ec == std::errc::result_out_of_range)
+            Program::Error("Overflow in integral constant.");
+        if (ec != std::errc{} || ptr != str.data() + str.size())
+            Program::Error("Unable to parse a number.");
+
+        ret.kind = num_int;
+        ret.num_int = num;
+        return true;
+    }
+}
+
+Json::Node Json::ParseLow(const char *&cur, int allowed_depth, ParseStacks &stacks)
 {
     if (allowed_depth < 0)
         Program::Error("Too many nested elements.");
@@ -147,106 +506,50 @@ Json Json::ParseLow(const char *&cur, int allowed_depth)
 
     ParseSkipWhitespace(cur);
 
+    Node ret;
+
     switch (*cur)
     {
       case 'n': // null
         if (TryGetString("null"))
-            return FromVariant(std::monostate{});
+            return ret;
         break;
 
       case 'f': // boolean, false
         if (TryGetString("false"))
-            return FromVariant(false);
+        {
+            ret.kind = boolean;
+            ret.boolean = false;
+            return ret;
+        }
         break;
 
       case 't': // boolean, true
         if (TryGetString("true"))
-            return FromVariant(true);
+        {
+            ret.kind = boolean;
+            ret.boolean = true;
+            return ret;
+        }
         break;
 
       default: // number
-        {
-            std::string str;
-            bool real = false;
-
-            if (*cur == '-')
-            {
-                str += '-';
-                cur++;
-            }
-
-            while (*cur >= '0' && *cur <= '9')
-                str += *cur++;
-
-            if (str.empty())
-                break;
-
-            if (*cur == '.')
-            {
-                cur++;
-
-                real = true;
-                str += '.';
-
-                while (*cur >= '0' && *cur <= '9')
-                    str += *cur++;
-
-                if (str.back() == '.')
-                    Program::Error("Expected a digit after decimal point.");
-            }
-
-            if (*cur == 'e' || *cur == 'E')
-            {
-                cur++;
-
-                real = true;
-                str += 'e';
-
-                if (*cur == '+' || *cur == '-')
-                    str += *cur++;
-
-                while (*cur >= '0' && *cur <= '9')
-                    str += *cur++;
-
-                if (str.back() == 'e' || str.back() == '+' || str.back() == '-')
-                    Program::Error("Expected a digit after `e`, possibly after a sign.");
-            }
-
-            if (real)
-            {
-                char *end = 0;
-                double num = std::strtod(str.c_str(), &end);
-                if (end == str.c_str())
-                    Program::Error("Unable to parse a number.");
-
-                return FromVariant(num);
-            }
-            else
-            {
-                char *end = 0;
-                long num = std::strtol(str.c_str(), &end, 10);
-                if (end == str.c_str())
-                    Program::Error("Unable to parse a number.");
-
-                if constexpr (sizeof(int) < sizeof(long))
-                    if (num < std::numeric_limits<int>::min() || num > std::numeric_limits<int>::max())
-                        Program::Error("Overflow in integral constant.");
-
-                return FromVariant(int(num));
-            }
-        }
+        if (ParseNumberLow(cur, ret))
+            return ret;
         break;
 
       case '"': // string
-        return FromVariant(ParseStringLow(cur));
-        break;
+        return ParseStringLow(cur);
 
       case '[': // array
         {
+            if (TryParseIntArrayLow(cur, ret))
+                return ret;
+
             const char *begin = cur;
             cur++; // Skip `[`.
 
-            array_t vec;
+            std::size_t first_element = stacks.elements.size();
 
             bool first = true;
             while (true)
@@ -277,11 +580,12 @@ Json Json::ParseLow(const char *&cur, int allowed_depth)
                     Program::Error("This array lacks a terminating `]` character.");
                 }
 
-                vec.push_back(ParseLow(cur, allowed_depth-1));
+                Node elem = ParseLow(cur, allowed_depth-1, stacks);
+                stacks.elements.push_back(elem);
             }
 
             cur++; // Skip `]`.
-            return FromVariant(std::move(vec));
+            return FinishArray(stacks, first_element);
         }
         break;
 
@@ -290,7 +594,7 @@ Json Json::ParseLow(const char *&cur, int allowed_depth)
             const char *begin = cur;
             cur++; // Skip `{`.
 
-            object_t map;
+            std::size_t first_member = stacks.members.size();
 
             bool first = true;
             while (true)
@@ -321,7 +625,7 @@ Json Json::ParseLow(const char *&cur, int allowed_depth)
                     Program::Error("This array lacks a terminating `]` character.");
                 }
 
-                std::string name = ParseStringLow(cur);
+                Node name = ParseStringLow(cur);
 
                 ParseSkipWhitespace(cur);
 
@@ -331,11 +635,12 @@ Json Json::ParseLow(const char *&cur, int allowed_depth)
 
                 // No need to skip whitespace here, nested ParseLow() will do that.
 
-                map.insert({name, ParseLow(cur, allowed_depth-1)});
+                Node value = ParseLow(cur, allowed_depth-1, stacks);
+                stacks.members.emplace_back(name, value);
             }
 
             cur++; // Skip `}`.
-            return FromVariant(std::move(map));
+            return FinishObject(stacks, first_member);
         }
         break;
     }
@@ -348,7 +653,8 @@ Json::Json(const char *string, int allowed_depth)
     const char *begin = string;
     try
     {
-        *this = ParseLow(string, allowed_depth);
+        ParseStacks stacks;
+        root = ParseLow(string, allowed_depth, stacks);
         ParseSkipWhitespace(string);
         if (*string != '\0')
             Program::Error("Unexpected data after JSON.");
@@ -360,6 +666,263 @@ Json::Json(const char *string, int allowed_depth)
     }
 }
 
+template <typename F>
+auto Json::Reader::WithPosition(F &&func) -> decltype(func())
+{
+    try
+    {
+        return func();
+    }
+    catch (std::exception &e)
+    {
+        auto pos = Strings::GetSymbolPosition(begin, cur);
+        Program::Error("JSON parsing failed, at ", pos.ToString(), ": ", e.what());
+    }
+}
+
+void Json::Reader::EnterContainer(char open)
+{
+    WithPosition([&]
+    {
+        ParseSkipWhitespace(cur);
+        if (*cur != open)
+            Program::Error("Expected `", open, "`.");
+        if (depth >= allowed_depth)
+            Program::Error("Too many nested elements.");
+        cur++;
+        depth++;
+    });
+}
+
+bool Json::Reader::NextArrayElement(bool first)
+{
+    return WithPosition([&]
+    {
+        ParseSkipWhitespace(cur);
+        if (!first && *cur == ',')
+        {
+            cur++;
+            ParseSkipWhitespace(cur);
+        }
+        else if (!first && *cur != ']' && *cur != '\0')
+        {
+            Program::Error("Expected `,`.");
+        }
+
+        if (*cur == ']')
+        {
+            cur++;
+            depth--;
+            return false;
+        }
+        if (*cur == '\0')
+            Program::Error("This array lacks a terminating `]` character.");
+        return true;
+    });
+}
+
+bool Json::Reader::NextObjectElement(bool first, std::string_view &key)
+{
+    return WithPosition([&]
+    {
+        ParseSkipWhitespace(cur);
+        if (!first && *cur == ',')
+        {
+            cur++;
+            ParseSkipWhitespace(cur);
+        }
+        else if (!first && *cur != '}' && *cur != '\0')
+        {
+            Program::Error("Expected `,`.");
+        }
+
+        if (*cur == '}')
+        {
+            cur++;
+            depth--;
+            return false;
+        }
+        if (*cur == '\0')
+            Program::Error("This object lacks a terminating `}` character.");
+
+        // The keys without escapes point into the input.
+        bool has_escapes;
+        const char *key_begin = ScanStringLow(cur, has_escapes);
+        if (has_escapes)
+        {
+            if (key_buffers.size() < std::size_t(depth))
+                key_buffers.resize(depth);
+            std::string &buffer = key_buffers[depth - 1];
+            buffer.clear();
+            UnescapeStringLow(key_begin, cur, buffer);
+            key = buffer;
+        }
+        else
+        {
+            key = std::string_view(key_begin, cur);
+        }
+        cur++; // Skip the `"`.
+
+        ParseSkipWhitespace(cur);
+        if (*cur != ':')
+            Program::Error("Expected `:`.");
+        cur++;
+        return true;
+    });
+}
+
+Json::Node Json::Reader::ReadNumber()
+{
+    return WithPosition([&]
+    {
+        ParseSkipWhitespace(cur);
+        Node ret;
+        if (!ParseNumberLow(cur, ret))
+            Program::Error("Expected a number.");
+        return ret;
+    });
+}
+
+Json::type_t Json::Reader::PeekType()
+{
+    return WithPosition([&]
+    {
+        ParseSkipWhitespace(cur);
+        switch (*cur)
+        {
+            case 'n': return null;
+            case 't': case 'f': return boolean;
+            case '"': return string;
+            case '[': return array;
+            case '{': return object;
+        }
+
+        // Parse the number without consuming it.
+        const char *pos = cur;
+        Node node;
+        if (!ParseNumberLow(pos, node))
+            Program::Error("Unknown entity.");
+        return type_t(node.kind);
+    });
+}
+
+void Json::Reader::ReadNull()
+{
+    WithPosition([&]
+    {
+        ParseSkipWhitespace(cur);
+        if (std::strncmp(cur, "null", 4) != 0)
+            Program::Error("Expected `null`.");
+        cur += 4;
+    });
+}
+
+bool Json::Reader::ReadBool()
+{
+    return WithPosition([&]
+    {
+        ParseSkipWhitespace(cur);
+        if (std::strncmp(cur, "true", 4) == 0)
+        {
+            cur += 4;
+            return true;
+        }
+        if (std::strncmp(cur, "false", 5) == 0)
+        {
+            cur += 5;
+            return false;
+        }
+        Program::Error("Expected a boolean.");
+    });
+}
+
+int Json::Reader::ReadInt()
+{
+    const char *value_begin = cur;
+    Node node = ReadNumber();
+    if (node.kind != num_int)
+    {
+        cur = value_begin; // We do this to get a better error message.
+        WithPosition([]{Program::Error("Expected an integer.");});
+    }
+    return node.num_int;
+}
+
+double Json::Reader::ReadReal()
+{
+    Node node = ReadNumber();
+    return node.kind == num_int ? node.num_int : node.num_real;
+}
+
+void Json::Reader::ReadIntArray(std::vector<int> &out)
+{
+    bool done = WithPosition([&]
+    {
+        ParseSkipWhitespace(cur);
+        return depth < allowed_depth && ScanIntArrayLow(cur, out);
+    });
+    if (done)
+        return;
+    ForEachArrayElement([&]{out.push_back(ReadInt());});
+}
+
+std::string Json::Reader::ReadString()
+{
+    return WithPosition([&]
+    {
+        bool has_escapes;
+        const char *string_begin = ScanStringLow(cur, has_escapes);
+        std::string ret;
+        if (has_escapes)
+            UnescapeStringLow(string_begin, cur, ret);
+        else
+            ret.assign(string_begin, cur);
+        cur++; // Skip the `"`.
+        return ret;
+    });
+}
+
+void Json::Reader::Skip()
+{
+    switch (PeekType())
+    {
+      case null:
+        ReadNull();
+        break;
+      case boolean:
+        (void)ReadBool();
+        break;
+      case num_int:
+      case num_real:
+        (void)ReadNumber();
+        break;
+      case string:
+        WithPosition([&]
+        {
+            bool has_escapes;
+            (void)ScanStringLow(cur, has_escapes);
+            cur++; // Skip the `"`.
+        });
+        break;
+      case array:
+        ForEachArrayElement([&]{Skip();});
+        break;
+      case object:
+        ForEachObjectElement([&](std::string_view){Skip();});
+        break;
+    }
+}
+
+void Json::Reader::Finish()
+{
+    WithPosition([&]
+    {
+        ParseSkipWhitespace(cur);
+        if (*cur != '\0')
+            Program::Error("Unexpected data after JSON.");
+    });
+}
+
 void Json::View::DebugPrint(std::ostream &stream) const
 {
     switch (Type())
@@ -377,38 +940,36 @@ void Json::View::DebugPrint(std::ostream &stream) const
         stream << GetReal();
         break;
       case string:
-        stream << '"' << GetString() << '"';
+        stream << '"' << GetStringView() << '"';
         break;
       case array:
         {
-            const array_t &obj = *std::get_if<int(array)>(&ptr->variant);
             bool first = true;
             stream << '[';
-            for (const auto &it : obj)
+            ForEachArrayElement([&](const View &elem)
             {
                 if (first)
                     first = false;
                 else
                     stream << ',';
-                it.GetView().DebugPrint(stream);
-            }
+                elem.DebugPrint(stream);
+            });
             stream << ']';
         }
         break;
       case object:
         {
-            const object_t &obj = *std::get_if<int(object)>(&ptr->variant);
             bool first = true;
             stream << '{';
-            for (const auto &it : obj)
+            ForEachObjectElement([&](std::string_view name, const View &elem)
             {
                 if (first)
                     first = false;
                 else
                     stream << ',';
-                stream << "\"" << it.first << "\":";
-                it.second.GetView().DebugPrint(stream);
-            }
+                stream << "\"" << name << "\":";
+                elem.DebugPrint(stream);
+            });
             stream << '}';
         }
         break;
@@ -1,10 +1,12 @@
 #pragma once
 
-#include <iosfwd>
+#include <cstdint>
 #include <exception>
-#include <map>
+#include <iosfwd>
+#include <span>
 #include <string>
-#include <variant>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include "program/errors.h"
@@ -12,46 +14,149 @@
 class Json
 {
   public:
-    // Sync order with `variant_t`.
     enum type_t {null, boolean, num_int, num_real, string, array, object};
 
   private:
-    using array_t = std::vector<Json>;
-    using object_t = std::map<std::string, Json>;
-
-    // Sync order with `enum type_t`.
-    using variant_t = std::variant<
-        std::monostate, // type_t::null
-        bool,           // type_t::boolean
-        int,            // type_t::num_int
-        double,         // type_t::num_real
-        std::string,    // type_t::string
-        array_t,        // type_t::array
-        object_t        // type_t::object
-    >;
-
-    variant_t variant;
-
-    static Json FromVariant(const variant_t &var)
+    // The node kinds, in addition to `type_t`. Those arrays are reported as `type_t::array`.
+    static constexpr std::uint8_t int_array = 7, real_array = 8;
+
+    // The whole document is stored in a few flat arrays, instead of a node per heap allocation.
+    // Strings point to `chars`. Arrays point to `size` consecutive `nodes`, or to `ints` or `reals` if all elements are integers or all are reals.
+    // This is much more compact, the tile layers in Tiled maps are huge arrays of integers.
+    // Objects point to `size` consecutive pairs of `nodes`, a string key followed by the value, sorted by the key.
+    struct Node
     {
-        Json ret;
-        ret.variant = var;
-        return ret;
-    }
+        std::uint8_t kind = null; // `type_t`, `int_array` or `real_array`.
+        std::uint32_t size = 0; // The string length, or the number of elements.
+        union
+        {
+            bool boolean;
+            int num_int;
+            double num_real;
+            std::uint32_t index; // The first character or element, in the array that depends on `kind`.
+        };
+
+        Node() : num_real(0) {}
+    };
+    static_assert(sizeof(Node) == 16);
+
+    Node root;
+    std::vector<Node> nodes;
+    std::string chars;
+    std::vector<int> ints;
+    std::vector<double> reals;
+
+    // The elements of the arrays and objects that are being parsed. They are moved to `nodes` when the array or object ends, so that they end up consecutive.
+    struct ParseStacks
+    {
+        std::vector<Node> elements;
+        std::vector<std::pair<Node, Node>> members;
+    };
 
     static void ParseSkipWhitespace(const char *&cur);
-    static std::string ParseStringLow(const char *&cur);
-    static Json ParseLow(const char *&cur, int allowed_depth);
+    // Checks the string and stops at the closing `"`. Returns the first character after the opening `"`.
+    static const char *ScanStringLow(const char *&cur, bool &has_escapes);
+    static void UnescapeStringLow(const char *begin, const char *end, std::string &out);
+    // Returns false without an error if there's no number at `cur`.
+    static bool ParseNumberLow(const char *&cur, Node &ret);
+    [[nodiscard]] Node ParseStringLow(const char *&cur);
+    // Appends the elements to `out`. Returns false if it's not a simple array of integers, then doesn't change anything.
+    static bool ScanIntArrayLow(const char *&cur, std::vector<int> &out);
+    bool TryParseIntArrayLow(const char *&cur, Node &ret);
+    [[nodiscard]] Node ParseLow(const char *&cur, int allowed_depth, ParseStacks &stacks);
+    // Moves the elements (from `first`) or the members (from `first`) from the stacks to `nodes`, and returns the array or object node.
+    [[nodiscard]] Node FinishArray(ParseStacks &stacks, std::size_t first);
+    [[nodiscard]] Node FinishObject(ParseStacks &stacks, std::size_t first);
+
+    [[nodiscard]] std::string_view StringOf(const Node &node) const
+    {
+        return std::string_view(chars.data() + node.index, node.size);
+    }
 
   public:
     Json() {}
     Json(const char *string, int allowed_depth);
 
+    // Reads a JSON string sequentially, without building the document. The unneeded elements are skipped without storing them.
+    // Each value must be consumed exactly once, with one of the `Read...()` functions, `Skip()`, or `ForEach...Element()`.
+    // Usage:
+    //     Json::Reader reader(string, 32);
+    //     reader.ForEachObjectElement([&](std::string_view key)
+    //     {
+    //         if (key == "width")
+    //             width = reader.ReadInt();
+    //         else
+    //             reader.Skip();
+    //     });
+    //     reader.Finish();
+    // Like the `Json` constructor, the string must be null-terminated, and the errors include the position in it.
+    class Reader
+    {
+        const char *begin = nullptr;
+        const char *cur = nullptr;
+        int allowed_depth = 0;
+        int depth = 0;
+        std::vector<std::string> key_buffers; // Indexed by `depth`, for the keys with escape sequences.
+
+        // Calls `func()`, adding the current position to the exception messages.
+        template <typename F>
+        auto WithPosition(F &&func) -> decltype(func());
+
+        void EnterContainer(char open);
+        // Those consume the separators, and return false after consuming the closing bracket.
+        [[nodiscard]] bool NextArrayElement(bool first);
+        [[nodiscard]] bool NextObjectElement(bool first, std::string_view &key);
+        [[nodiscard]] Node ReadNumber();
+
+      public:
+        Reader() {}
+        // The string has to remain alive.
+        Reader(const char *string, int allowed_depth) : begin(string), cur(string), allowed_depth(allowed_depth) {}
+
+        // Returns the type of the next value, without consuming it.
+        [[nodiscard]] type_t PeekType();
+
+        void ReadNull();
+        [[nodiscard]] bool ReadBool();
+        [[nodiscard]] int ReadInt();
+        [[nodiscard]] double ReadReal(); // Accepts integers too.
+        [[nodiscard]] std::string ReadString();
+        // Appends the elements of an array of integers to `out`.
+        void ReadIntArray(std::vector<int> &out);
+
+        // Skips the next value, including everything nested in it.
+        void Skip();
+
+        template <typename F> void ForEachArrayElement(F &&func) // `func` should be `void func()`, and consume one value.
+        {
+            EnterContainer('[');
+            for (bool first = true; NextArrayElement(first); first = false)
+                func();
+        }
+        // The key remains valid until the next key of the same object.
+        template <typename F> void ForEachObjectElement(F &&func) // `func` should be `void func(std::string_view key)`, and consume one value.
+        {
+            EnterContainer('{');
+            std::string_view key;
+            for (bool first = true; NextObjectElement(first, key); first = false)
+                func(key);
+        }
+
+        // Throws if there's anything but whitespace after the last value.
+        void Finish();
+    };
+
     class View
     {
-        const Json *ptr = 0;
+        const Json *json = 0;
+        const Node *node = 0;
+        // Used instead of `node` for elements of the typed arrays.
+        const int *int_elem_ptr = 0;
+        const double *real_elem_ptr = 0;
         std::string path;
 
+        View(const Json &json, const Node &node, std::string path) : json(&json), node(&node), path(std::move(path)) {}
+
         void ThrowExpectedType(std::string type) const
         {
             Program::Error("Expected JSON element `", path, "` to be ", type, ".");
@@ -65,56 +170,79 @@ class Json
             ret += ']';
             return ret;
         }
-        std::string AppendElementNameToPath(std::string name) const
+        std::string AppendElementNameToPath(std::string_view name) const
         {
             if (path.empty())
-                return name;
+                return std::string(name);
             std::string ret = path;
             ret += '.';
             ret += name;
             return ret;
         }
+
+        // Returns the object member with this key (the key node, followed by the value node), or null if none.
+        const Node *FindMember(std::string_view key) const
+        {
+            if (!IsObject())
+                ThrowExpectedType("an object");
+            const Node *members = json->nodes.data() + node->index;
+            std::uint32_t begin = 0, end = node->size;
+            while (begin < end)
+            {
+                std::uint32_t mid = begin + (end - begin) / 2;
+                int cmp = json->StringOf(members[mid * 2]).compare(key);
+                if (cmp == 0)
+                    return members + mid * 2;
+                if (cmp < 0)
+                    begin = mid + 1;
+                else
+                    end = mid;
+            }
+            return nullptr;
+        }
+
       public:
         View() {}
 
         // Passed object has to remain alive.
-        View(const Json &json, std::string name = "") : ptr(&json), path(std::move(name)) {}
+        View(const Json &json, std::string name = "") : View(json, json.root, std::move(name)) {}
         View(Json &&, std::string = "") = delete;
 
         explicit operator bool() const
         {
-            return bool(ptr);
-        }
-
-        const Json &Target() const
-        {
-            return *ptr;
+            return node || int_elem_ptr || real_elem_ptr;
         }
 
         type_t Type() const
         {
-            return type_t(ptr->variant.index());
+            if (int_elem_ptr)
+                return num_int;
+            if (real_elem_ptr)
+                return num_real;
+            return node->kind == int_array || node->kind == real_array ? array : type_t(node->kind);
         }
 
-        bool IsNull()   const {return !ptr || Type() == null;}
-        bool IsBool()   const {return ptr && Type() == boolean;}
-        bool IsInt()    const {return ptr && Type() == num_int;}
-        bool IsReal()   const {return ptr && (Type() == num_real || IsInt());}
-        bool IsString() const {return ptr && Type() == string;}
-        bool IsArray()  const {return ptr && Type() == array;}
-        bool IsObject() const {return ptr && Type() == object;}
+        bool IsNull()   const {return !*this || Type() == null;}
+        bool IsBool()   const {return *this && Type() == boolean;}
+        bool IsInt()    const {return *this && Type() == num_int;}
+        bool IsReal()   const {return *this && (Type() == num_real || IsInt());}
+        bool IsString() const {return *this && Type() == string;}
+        bool IsArray()  const {return *this && Type() == array;}
+        bool IsObject() const {return *this && Type() == object;}
 
         bool GetBool() const
         {
             if (!IsBool())
                 ThrowExpectedType("a boolean");
-            return *std::get_if<int(boolean)>(&ptr->variant);
+            return node->boolean;
         }
         int GetInt() const
         {
             if (!IsInt())
                 ThrowExpectedType("an integer");
-            return *std::get_if<int(num_int)>(&ptr->variant);
+            if (int_elem_ptr)
+                return *int_elem_ptr;
+            return node->num_int;
         }
         double GetReal() const
         {
@@ -123,37 +251,71 @@ class Json
 
             if (!IsReal())
                 ThrowExpectedType("a real number");
-            return *std::get_if<int(num_real)>(&ptr->variant);
+            if (real_elem_ptr)
+                return *real_elem_ptr;
+            return node->num_real;
         }
         std::string GetString() const
+        {
+            return std::string(GetStringView());
+        }
+        // Points into the `Json` object.
+        std::string_view GetStringView() const
         {
             if (!IsString())
                 ThrowExpectedType("a string");
-            return *std::get_if<int(string)>(&ptr->variant);
+            return json->StringOf(*node);
         }
 
         int GetArraySize() const
         {
             if (!IsArray())
                 ThrowExpectedType("an array");
-            return std::get_if<int(array)>(&ptr->variant)->size();
+            return node->size;
         }
         View GetElement(int index) const
+        {
+            int size = GetArraySize();
+            if (index < 0 || index >= size)
+                Program::Error("Attempt to access element #", index, " of JSON object `", path, "`, but it only contains ", size, " elements.");
+            View ret;
+            ret.json = json;
+            ret.path = AppendElementIndexToPath(index);
+            if (node->kind == int_array)
+                ret.int_elem_ptr = json->ints.data() + node->index + index;
+            else if (node->kind == real_array)
+                ret.real_elem_ptr = json->reals.data() + node->index + index;
+            else
+                ret.node = json->nodes.data() + node->index + index;
+            return ret;
+        }
+        template <typename F> void ForEachArrayElement(F &&func) const // `func` should be `void func(const View &elem)`.
+        {
+            int size = GetArraySize();
+            for (int i = 0; i < size; i++)
+                func(GetElement(i));
+        }
+        // Returns the contents of an array consisting only of integers, without creating a view for each element.
+        std::span<const int> GetIntArray() const
         {
             if (!IsArray())
                 ThrowExpectedType("an array");
-            const array_t &arr = *std::get_if<int(array)>(&ptr->variant);
-            if (index < 0 || decltype(arr.size())(index) >= arr.size())
-                Program::Error("Attempt to access element #", index, " of JSON object `", path, "`, but it only contains ", arr.size(), " elements.");
-            return View(arr[index], AppendElementIndexToPath(index));
+            if (node->kind == int_array)
+                return std::span<const int>(json->ints.data() + node->index, node->size);
+            if (GetArraySize() != 0)
+                ThrowExpectedType("an array of integers");
+            return {};
         }
-        template <typename F> void ForEachArrayElement(F &&func) const // `func` should be `void func(const View &elem)`.
+        // Same, but for an array consisting only of reals. Note that an array consisting only of integers doesn't count.
+        std::span<const double> GetRealArray() const
         {
             if (!IsArray())
                 ThrowExpectedType("an array");
-            const array_t &arr = *std::get_if<int(array)>(&ptr->variant);
-            for (array_t::size_type i = 0; i < arr.size(); i++)
-                func(View(arr[i], AppendElementIndexToPath(i)));
+            if (node->kind == real_array)
+                return std::span<const double>(json->reals.data() + node->index, node->size);
+            if (GetArraySize() != 0)
+                ThrowExpectedType("an array of real numbers");
+            return {};
         }
         bool HasElement(int index) const
         {
@@ -164,33 +326,29 @@ class Json
         {
             if (!IsObject())
                 ThrowExpectedType("an object");
-            return std::get_if<int(object)>(&ptr->variant)->size();
+            return node->size;
         }
-        View GetElement(std::string key) const
+        View GetElement(std::string_view key) const
         {
-            if (!IsObject())
-                ThrowExpectedType("an object");
-            const object_t &obj = *std::get_if<int(object)>(&ptr->variant);
-            auto it = obj.find(key);
-            if (it == obj.end())
+            const Node *member = FindMember(key);
+            if (!member)
                 Program::Error("Attempt to access nonexistent element `", key, "` of JSON object `", path, "`.");
-            return View(it->second, AppendElementNameToPath(key));
+            return View(*json, member[1], AppendElementNameToPath(key));
         }
-        template <typename F> void ForEachObjectElement(F &&func) const // `func` should be `void func(const std::string &name, const View &elem)`.
+        // Visits the elements sorted by name.
+        template <typename F> void ForEachObjectElement(F &&func) const // `func` should be `void func(std::string_view name, const View &elem)`.
         {
-            if (!IsObject())
-                ThrowExpectedType("an object");
-            const object_t &obj = *std::get_if<int(object)>(&ptr->variant);
-            for (const auto &elem : obj)
-                func(View(elem.second, AppendElementNameToPath(elem.first)));
+            int size = GetObjectSize();
+            const Node *members = json->nodes.data() + node->index;
+            for (int i = 0; i < size; i++)
+            {
+                std::string_view name = json->StringOf(members[i * 2]);
+                func(name, View(*json, members[i * 2 + 1], AppendElementNameToPath(name)));
+            }
         }
-        bool HasElement(std::string key) const
+        bool HasElement(std::string_view key) const
         {
-            if (!IsObject())
-                ThrowExpectedType("an object");
-            const object_t &obj = *std::get_if<int(object)>(&ptr->variant);
-            auto it = obj.find(key);
-            return it != obj.end();
+            return FindMember(key) != nullptr;
         }
 
         View operator[](int index) const // Same as GetElement(int).
@@ -198,7 +356,7 @@ class Json
             return GetElement(index);
         }
 
-        View operator[](std::string key) const // Same as GetElement(std::string).
+        View operator[](std::string_view key) const // Same as GetElement(std::string_view).
         {
             return GetElement(key);
         }
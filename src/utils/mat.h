@@ -1,6 +1,6 @@
 // mat.h
 // Vector and matrix math
-// Version 3.3.3
+// Version 3.4.0
 // Generated, don't touch.
 
 #pragma once
@@ -12,10 +12,20 @@
 #include <cstdint>
 #include <istream>
 #include <ostream>
+#include <span>
 #include <tuple>
 #include <type_traits>
 #include <utility>
 
+// Define `MATH_NO_SIMD` to disable the SSE and NEON code paths.
+#if !defined(MATH_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define MATH_IMPL_SSE
+#include <xmmintrin.h>
+#elif !defined(MATH_NO_SIMD) && defined(__ARM_NEON) && defined(__aarch64__)
+#define MATH_IMPL_NEON
+#include <arm_neon.h>
+#endif
+
 // Vectors and matrices
 
 namespace Math
@@ -1332,6 +1342,69 @@ namespace Math
         }
         //}  input/output
 
+        //{  simd
+        // The SIMD versions of the most common `float` operations, used by the operators below when possible.
+        // They add the products in the same order as the scalar code, so the results are the same.
+        #if defined(MATH_IMPL_SSE) || defined(MATH_IMPL_NEON)
+        template <typename A, typename B> inline constexpr bool impl_simd_available = std::is_same_v<A, float> && std::is_same_v<B, float>;
+        #else
+        template <typename A, typename B> inline constexpr bool impl_simd_available = false;
+        #endif
+
+        #if defined(MATH_IMPL_SSE)
+        using impl_simd_float4 = __m128;
+        [[nodiscard]] inline impl_simd_float4 impl_simd_load(const vec4<float> &v) {return _mm_loadu_ps(&v.x);}
+        [[nodiscard]] inline impl_simd_float4 impl_simd_load2x2(const vec2<float> *v) {return _mm_loadu_ps(&v->x);} // Two consecutive vectors.
+        [[nodiscard]] inline impl_simd_float4 impl_simd_splat(float x) {return _mm_set1_ps(x);}
+        [[nodiscard]] inline impl_simd_float4 impl_simd_repeat2(vec2<float> v) {return _mm_setr_ps(v.x, v.y, v.x, v.y);}
+        [[nodiscard]] inline impl_simd_float4 impl_simd_even(impl_simd_float4 v) {return _mm_shuffle_ps(v, v, _MM_SHUFFLE(2,2,0,0));} // `x0 x0 x1 x1`.
+        [[nodiscard]] inline impl_simd_float4 impl_simd_odd(impl_simd_float4 v) {return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3,3,1,1));} // `y0 y0 y1 y1`.
+        [[nodiscard]] inline impl_simd_float4 impl_simd_add(impl_simd_float4 a, impl_simd_float4 b) {return _mm_add_ps(a, b);}
+        [[nodiscard]] inline impl_simd_float4 impl_simd_mul(impl_simd_float4 a, impl_simd_float4 b) {return _mm_mul_ps(a, b);}
+        inline void impl_simd_store(vec4<float> &dst, impl_simd_float4 v) {_mm_storeu_ps(&dst.x, v);}
+        inline void impl_simd_store2x2(vec2<float> *dst, impl_simd_float4 v) {_mm_storeu_ps(&dst->x, v);}
+        #elif defined(MATH_IMPL_NEON)
+        using impl_simd_float4 = float32x4_t;
+        [[nodiscard]] inline impl_simd_float4 impl_simd_load(const vec4<float> &v) {return vld1q_f32(&v.x);}
+        [[nodiscard]] inline impl_simd_float4 impl_simd_load2x2(const vec2<float> *v) {return vld1q_f32(&v->x);} // Two consecutive vectors.
+        [[nodiscard]] inline impl_simd_float4 impl_simd_splat(float x) {return vdupq_n_f32(x);}
+        [[nodiscard]] inline impl_simd_float4 impl_simd_repeat2(vec2<float> v) {float32x2_t h = vld1_f32(&v.x); return vcombine_f32(h, h);}
+        [[nodiscard]] inline impl_simd_float4 impl_simd_even(impl_simd_float4 v) {return vtrn1q_f32(v, v);} // `x0 x0 x1 x1`.
+        [[nodiscard]] inline impl_simd_float4 impl_simd_odd(impl_simd_float4 v) {return vtrn2q_f32(v, v);} // `y0 y0 y1 y1`.
+        [[nodiscard]] inline impl_simd_float4 impl_simd_add(impl_simd_float4 a, impl_simd_float4 b) {return vaddq_f32(a, b);}
+        [[nodiscard]] inline impl_simd_float4 impl_simd_mul(impl_simd_float4 a, impl_simd_float4 b) {return vmulq_f32(a, b);} // Not `vfmaq_f32()`, to match the scalar code.
+        inline void impl_simd_store(vec4<float> &dst, impl_simd_float4 v) {vst1q_f32(&dst.x, v);}
+        inline void impl_simd_store2x2(vec2<float> *dst, impl_simd_float4 v) {vst1q_f32(&dst->x, v);}
+        #endif
+
+        #if defined(MATH_IMPL_SSE) || defined(MATH_IMPL_NEON)
+        // Returns `a.x * x + a.y * y + a.z * z + a.w * w`, where `a.?` are the matrix columns.
+        [[nodiscard]] inline impl_simd_float4 impl_simd_combine_columns(const mat4x4<float> &a, float x, float y, float z, float w)
+        {
+            impl_simd_float4 ret = impl_simd_mul(impl_simd_load(a.x), impl_simd_splat(x));
+            ret = impl_simd_add(ret, impl_simd_mul(impl_simd_load(a.y), impl_simd_splat(y)));
+            ret = impl_simd_add(ret, impl_simd_mul(impl_simd_load(a.z), impl_simd_splat(z)));
+            ret = impl_simd_add(ret, impl_simd_mul(impl_simd_load(a.w), impl_simd_splat(w)));
+            return ret;
+        }
+        [[nodiscard]] inline vec4<float> impl_simd_mul(const mat4x4<float> &a, const vec4<float> &b)
+        {
+            vec4<float> ret;
+            impl_simd_store(ret, impl_simd_combine_columns(a, b.x, b.y, b.z, b.w));
+            return ret;
+        }
+        [[nodiscard]] inline mat4x4<float> impl_simd_mul(const mat4x4<float> &a, const mat4x4<float> &b)
+        {
+            mat4x4<float> ret;
+            impl_simd_store(ret.x, impl_simd_combine_columns(a, b.x.x, b.x.y, b.x.z, b.x.w));
+            impl_simd_store(ret.y, impl_simd_combine_columns(a, b.y.x, b.y.y, b.y.z, b.y.w));
+            impl_simd_store(ret.z, impl_simd_combine_columns(a, b.z.x, b.z.y, b.z.z, b.z.w));
+            impl_simd_store(ret.w, impl_simd_combine_columns(a, b.w.x, b.w.y, b.w.z, b.w.w));
+            return ret;
+        }
+        #endif
+        //}  simd
+
         //{  matrix multiplication
         template <typename A, typename B> [[nodiscard]] constexpr vec2<larger_t<A,B>> operator*(const mat2x2<A> &a, const vec2<B> &b) {return {a.x.x*b.x + a.y.x*b.y, a.x.y*b.x + a.y.y*b.y};}
         template <typename A, typename B> [[nodiscard]] constexpr vec2<larger_t<A,B>> operator*(const mat3x2<A> &a, const vec3<B> &b) {return {a.x.x*b.x + a.y.x*b.y + a.z.x*b.z, a.x.y*b.x + a.y.y*b.y + a.z.y*b.z};}
@@ -1341,7 +1414,7 @@ namespace Math
         template <typename A, typename B> [[nodiscard]] constexpr vec3<larger_t<A,B>> operator*(const mat4x3<A> &a, const vec4<B> &b) {return {a.x.x*b.x + a.y.x*b.y + a.z.x*b.z + a.w.x*b.w, a.x.y*b.x + a.y.y*b.y + a.z.y*b.z + a.w.y*b.w, a.x.z*b.x + a.y.z*b.y + a.z.z*b.z + a.w.z*b.w};}
         template <typename A, typename B> [[nodiscard]] constexpr vec4<larger_t<A,B>> operator*(const mat2x4<A> &a, const vec2<B> &b) {return {a.x.x*b.x + a.y.x*b.y, a.x.y*b.x + a.y.y*b.y, a.x.z*b.x + a.y.z*b.y, a.x.w*b.x + a.y.w*b.y};}
         template <typename A, typename B> [[nodiscard]] constexpr vec4<larger_t<A,B>> operator*(const mat3x4<A> &a, const vec3<B> &b) {return {a.x.x*b.x + a.y.x*b.y + a.z.x*b.z, a.x.y*b.x + a.y.y*b.y + a.z.y*b.z, a.x.z*b.x + a.y.z*b.y + a.z.z*b.z, a.x.w*b.x + a.y.w*b.y + a.z.w*b.z};}
-        template <typename A, typename B> [[nodiscard]] constexpr vec4<larger_t<A,B>> operator*(const mat4x4<A> &a, const vec4<B> &b) {return {a.x.x*b.x + a.y.x*b.y + a.z.x*b.z + a.w.x*b.w, a.x.y*b.x + a.y.y*b.y + a.z.y*b.z + a.w.y*b.w, a.x.z*b.x + a.y.z*b.y + a.z.z*b.z + a.w.z*b.w, a.x.w*b.x + a.y.w*b.y + a.z.w*b.z + a.w.w*b.w};}
+        template <typename A, typename B> [[nodiscard]] constexpr vec4<larger_t<A,B>> operator*(const mat4x4<A> &a, const vec4<B> &b) {if constexpr (impl_simd_available<A,B>) {if (!std::is_constant_evaluated()) return impl_simd_mul(a, b);} return {a.x.x*b.x + a.y.x*b.y + a.z.x*b.z + a.w.x*b.w, a.x.y*b.x + a.y.y*b.y + a.z.y*b.z + a.w.y*b.w, a.x.z*b.x + a.y.z*b.y + a.z.z*b.z + a.w.z*b.w, a.x.w*b.x + a.y.w*b.y + a.z.w*b.z + a.w.w*b.w};}
         template <typename A, typename B> [[nodiscard]] constexpr vec2<larger_t<A,B>> operator*(const vec2<A> &a, const mat2x2<B> &b) {return {a.x*b.x.x + a.y*b.x.y, a.x*b.y.x + a.y*b.y.y};}
         template <typename A, typename B> [[nodiscard]] constexpr vec2<larger_t<A,B>> operator*(const vec3<A> &a, const mat2x3<B> &b) {return {a.x*b.x.x + a.y*b.x.y + a.z*b.x.z, a.x*b.y.x + a.y*b.y.y + a.z*b.y.z};}
         template <typename A, typename B> [[nodiscard]] constexpr vec2<larger_t<A,B>> operator*(const vec4<A> &a, const mat2x4<B> &b) {return {a.x*b.x.x + a.y*b.x.y + a.z*b.x.z + a.w*b.x.w, a.x*b.y.x + a.y*b.y.y + a.z*b.y.z + a.w*b.y.w};}
@@ -1377,7 +1450,7 @@ namespace Math
         template <typename A, typename B> [[nodiscard]] constexpr mat4x3<larger_t<A,B>> operator*(const mat4x3<A> &a, const mat4x4<B> &b) {return {a.x.x*b.x.x + a.y.x*b.x.y + a.z.x*b.x.z + a.w.x*b.x.w, a.x.x*b.y.x + a.y.x*b.y.y + a.z.x*b.y.z + a.w.x*b.y.w, a.x.x*b.z.x + a.y.x*b.z.y + a.z.x*b.z.z + a.w.x*b.z.w, a.x.x*b.w.x + a.y.x*b.w.y + a.z.x*b.w.z + a.w.x*b.w.w, a.x.y*b.x.x + a.y.y*b.x.y + a.z.y*b.x.z + a.w.y*b.x.w, a.x.y*b.y.x + a.y.y*b.y.y + a.z.y*b.y.z + a.w.y*b.y.w, a.x.y*b.z.x + a.y.y*b.z.y + a.z.y*b.z.z + a.w.y*b.z.w, a.x.y*b.w.x + a.y.y*b.w.y + a.z.y*b.w.z + a.w.y*b.w.w, a.x.z*b.x.x + a.y.z*b.x.y + a.z.z*b.x.z + a.w.z*b.x.w, a.x.z*b.y.x + a.y.z*b.y.y + a.z.z*b.y.z + a.w.z*b.y.w, a.x.z*b.z.x + a.y.z*b.z.y + a.z.z*b.z.z + a.w.z*b.z.w, a.x.z*b.w.x + a.y.z*b.w.y + a.z.z*b.w.z + a.w.z*b.w.w};}
         template <typename A, typename B> [[nodiscard]] constexpr mat4x4<larger_t<A,B>> operator*(const mat2x4<A> &a, const mat4x2<B> &b) {return {a.x.x*b.x.x + a.y.x*b.x.y, a.x.x*b.y.x + a.y.x*b.y.y, a.x.x*b.z.x + a.y.x*b.z.y, a.x.x*b.w.x + a.y.x*b.w.y, a.x.y*b.x.x + a.y.y*b.x.y, a.x.y*b.y.x + a.y.y*b.y.y, a.x.y*b.z.x + a.y.y*b.z.y, a.x.y*b.w.x + a.y.y*b.w.y, a.x.z*b.x.x + a.y.z*b.x.y, a.x.z*b.y.x + a.y.z*b.y.y, a.x.z*b.z.x + a.y.z*b.z.y, a.x.z*b.w.x + a.y.z*b.w.y, a.x.w*b.x.x + a.y.w*b.x.y, a.x.w*b.y.x + a.y.w*b.y.y, a.x.w*b.z.x + a.y.w*b.z.y, a.x.w*b.w.x + a.y.w*b.w.y};}
         template <typename A, typename B> [[nodiscard]] constexpr mat4x4<larger_t<A,B>> operator*(const mat3x4<A> &a, const mat4x3<B> &b) {return {a.x.x*b.x.x + a.y.x*b.x.y + a.z.x*b.x.z, a.x.x*b.y.x + a.y.x*b.y.y + a.z.x*b.y.z, a.x.x*b.z.x + a.y.x*b.z.y + a.z.x*b.z.z, a.x.x*b.w.x + a.y.x*b.w.y + a.z.x*b.w.z, a.x.y*b.x.x + a.y.y*b.x.y + a.z.y*b.x.z, a.x.y*b.y.x + a.y.y*b.y.y + a.z.y*b.y.z, a.x.y*b.z.x + a.y.y*b.z.y + a.z.y*b.z.z, a.x.y*b.w.x + a.y.y*b.w.y + a.z.y*b.w.z, a.x.z*b.x.x + a.y.z*b.x.y + a.z.z*b.x.z, a.x.z*b.y.x + a.y.z*b.y.y + a.z.z*b.y.z, a.x.z*b.z.x + a.y.z*b.z.y + a.z.z*b.z.z, a.x.z*b.w.x + a.y.z*b.w.y + a.z.z*b.w.z, a.x.w*b.x.x + a.y.w*b.x.y + a.z.w*b.x.z, a.x.w*b.y.x + a.y.w*b.y.y + a.z.w*b.y.z, a.x.w*b.z.x + a.y.w*b.z.y + a.z.w*b.z.z, a.x.w*b.w.x + a.y.w*b.w.y + a.z.w*b.w.z};}
-        template <typename A, typename B> [[nodiscard]] constexpr mat4x4<larger_t<A,B>> operator*(const mat4x4<A> &a, const mat4x4<B> &b) {return {a.x.x*b.x.x + a.y.x*b.x.y + a.z.x*b.x.z + a.w.x*b.x.w, a.x.x*b.y.x + a.y.x*b.y.y + a.z.x*b.y.z + a.w.x*b.y.w, a.x.x*b.z.x + a.y.x*b.z.y + a.z.x*b.z.z + a.w.x*b.z.w, a.x.x*b.w.x + a.y.x*b.w.y + a.z.x*b.w.z + a.w.x*b.w.w, a.x.y*b.x.x + a.y.y*b.x.y + a.z.y*b.x.z + a.w.y*b.x.w, a.x.y*b.y.x + a.y.y*b.y.y + a.z.y*b.y.z + a.w.y*b.y.w, a.x.y*b.z.x + a.y.y*b.z.y + a.z.y*b.z.z + a.w.y*b.z.w, a.x.y*b.w.x + a.y.y*b.w.y + a.z.y*b.w.z + a.w.y*b.w.w, a.x.z*b.x.x + a.y.z*b.x.y + a.z.z*b.x.z + a.w.z*b.x.w, a.x.z*b.y.x + a.y.z*b.y.y + a.z.z*b.y.z + a.w.z*b.y.w, a.x.z*b.z.x + a.y.z*b.z.y + a.z.z*b.z.z + a.w.z*b.z.w, a.x.z*b.w.x + a.y.z*b.w.y + a.z.z*b.w.z + a.w.z*b.w.w, a.x.w*b.x.x + a.y.w*b.x.y + a.z.w*b.x.z + a.w.w*b.x.w, a.x.w*b.y.x + a.y.w*b.y.y + a.z.w*b.y.z + a.w.w*b.y.w, a.x.w*b.z.x + a.y.w*b.z.y + a.z.w*b.z.z + a.w.w*b.z.w, a.x.w*b.w.x + a.y.w*b.w.y + a.z.w*b.w.z + a.w.w*b.w.w};}
+        template <typename A, typename B> [[nodiscard]] constexpr mat4x4<larger_t<A,B>> operator*(const mat4x4<A> &a, const mat4x4<B> &b) {if constexpr (impl_simd_available<A,B>) {if (!std::is_constant_evaluated()) return impl_simd_mul(a, b);} return {a.x.x*b.x.x + a.y.x*b.x.y + a.z.x*b.x.z + a.w.x*b.x.w, a.x.x*b.y.x + a.y.x*b.y.y + a.z.x*b.y.z + a.w.x*b.y.w, a.x.x*b.z.x + a.y.x*b.z.y + a.z.x*b.z.z + a.w.x*b.z.w, a.x.x*b.w.x + a.y.x*b.w.y + a.z.x*b.w.z + a.w.x*b.w.w, a.x.y*b.x.x + a.y.y*b.x.y + a.z.y*b.x.z + a.w.y*b.x.w, a.x.y*b.y.x + a.y.y*b.y.y + a.z.y*b.y.z + a.w.y*b.y.w, a.x.y*b.z.x + a.y.y*b.z.y + a.z.y*b.z.z + a.w.y*b.z.w, a.x.y*b.w.x + a.y.y*b.w.y + a.z.y*b.w.z + a.w.y*b.w.w, a.x.z*b.x.x + a.y.z*b.x.y + a.z.z*b.x.z + a.w.z*b.x.w, a.x.z*b.y.x + a.y.z*b.y.y + a.z.z*b.y.z + a.w.z*b.y.w, a.x.z*b.z.x + a.y.z*b.z.y + a.z.z*b.z.z + a.w.z*b.z.w, a.x.z*b.w.x + a.y.z*b.w.y + a.z.z*b.w.z + a.w.z*b.w.w, a.x.w*b.x.x + a.y.w*b.x.y + a.z.w*b.x.z + a.w.w*b.x.w, a.x.w*b.y.x + a.y.w*b.y.y + a.z.w*b.y.z + a.w.w*b.y.w, a.x.w*b.z.x + a.y.w*b.z.y + a.z.w*b.z.z + a.w.w*b.z.w, a.x.w*b.w.x + a.y.w*b.w.y + a.z.w*b.w.z + a.w.w*b.w.w};}
 
         template <typename A, typename B, int D> constexpr vec<D,A> &operator*=(vec<D,A> &a, const mat<D,D,B> &b) {a = a * b; return a;}
         template <typename A, typename B, int W, int H> constexpr mat<W,H,A> &operator*=(mat<W,H,A> &a, const mat<W,W,B> &b) {a = a * b; return a;}
@@ -2020,12 +2093,131 @@ namespace Math
         }
     }
 
+    inline namespace Batch // Transforming arrays of points
+    {
+        // Writes `(m * in[i].to_vec3(1)).to_vec2()` to `out[i]`. `out` must be at least as large as `in`, and can be the same array.
+        // Uses SIMD for `float` if possible, two points at a time.
+        template <typename T> constexpr void transform_points(const mat3<T> &m, std::span<const vec2<std::type_identity_t<T>>> in, std::span<vec2<std::type_identity_t<T>>> out)
+        {
+            std::size_t i = 0;
+            #if defined(MATH_IMPL_SSE) || defined(MATH_IMPL_NEON)
+            if constexpr (impl_simd_available<T,T>)
+            {
+                if (!std::is_constant_evaluated())
+                {
+                    auto c0 = impl_simd_repeat2(m.x.to_vec2()), c1 = impl_simd_repeat2(m.y.to_vec2()), c2 = impl_simd_repeat2(m.z.to_vec2());
+                    for (; i + 2 <= in.size(); i += 2)
+                    {
+                        auto p = impl_simd_load2x2(in.data() + i);
+                        impl_simd_store2x2(out.data() + i, impl_simd_add(impl_simd_add(impl_simd_mul(c0, impl_simd_even(p)), impl_simd_mul(c1, impl_simd_odd(p))), c2));
+                    }
+                }
+            }
+            #endif
+            for (; i < in.size(); i++)
+                out[i] = (m * in[i].to_vec3(1)).to_vec2();
+        }
+
+        // Writes `(m * in[i].to_vec4(1)).to_vec3()` to `out[i]`. `out` must be at least as large as `in`, and can be the same array.
+        // Uses SIMD for `float` if possible.
+        template <typename T> constexpr void transform_points(const mat4<T> &m, std::span<const vec3<std::type_identity_t<T>>> in, std::span<vec3<std::type_identity_t<T>>> out)
+        {
+            #if defined(MATH_IMPL_SSE) || defined(MATH_IMPL_NEON)
+            if constexpr (impl_simd_available<T,T>)
+            {
+                if (!std::is_constant_evaluated())
+                {
+                    for (std::size_t i = 0; i < in.size(); i++)
+                    {
+                        vec4<float> result;
+                        impl_simd_store(result, impl_simd_combine_columns(m, in[i].x, in[i].y, in[i].z, 1));
+                        out[i] = result.to_vec3();
+                    }
+                    return;
+                }
+            }
+            #endif
+            for (std::size_t i = 0; i < in.size(); i++)
+                out[i] = (m * in[i].to_vec4(1)).to_vec3();
+        }
+
+        // Simple kernels over arrays, for the structure-of-arrays code. They are written to be auto-vectorized.
+        // They are not templates, to allow implicit conversions to spans. All spans must have the same size.
+
+        // `dst[i] += src[i]`.
+        constexpr void add_to(std::span<vec2<float>> dst, std::span<const vec2<float>> src) {for (std::size_t i = 0; i < dst.size(); i++) dst[i] += src[i];}
+        // `dst[i] += src[i] * factor`.
+        constexpr void add_scaled_to(std::span<vec2<float>> dst, std::span<const vec2<float>> src, float factor) {for (std::size_t i = 0; i < dst.size(); i++) dst[i] += src[i] * factor;}
+        // `pos[i] += vel[i]; vel[i] += acc[i]; vel[i] *= 1 - damp[i]`.
+        constexpr void integrate_damped(std::span<vec2<float>> pos, std::span<vec2<float>> vel, std::span<const vec2<float>> acc, std::span<const float> damp) {for (std::size_t i = 0; i < pos.size(); i++) {pos[i] += vel[i]; vel[i] += acc[i]; vel[i] *= 1 - damp[i];}}
+        // `out[i] = mix(factor, a[i], b[i])`. `out` can be the same as `a` or `b`.
+        constexpr void mix_arrays(float factor, std::span<const vec2<float>> a, std::span<const vec2<float>> b, std::span<vec2<float>> out) {for (std::size_t i = 0; i < out.size(); i++) out[i] = mix(factor, a[i], b[i]);}
+        // `out[i] = (abs(points[i] - center) > half_size).any()`, i.e. 1 if the point is outside of the box, 0 otherwise.
+        constexpr void mask_outside(std::span<const vec2<float>> points, vec2<float> center, vec2<float> half_size, std::span<std::uint8_t> out) {for (std::size_t i = 0; i < out.size(); i++) out[i] = (abs(points[i] - center) > half_size).any();}
+
+        // `dst[i] += src[i]`.
+        constexpr void add_to(std::span<vec3<float>> dst, std::span<const vec3<float>> src) {for (std::size_t i = 0; i < dst.size(); i++) dst[i] += src[i];}
+        // `dst[i] += src[i] * factor`.
+        constexpr void add_scaled_to(std::span<vec3<float>> dst, std::span<const vec3<float>> src, float factor) {for (std::size_t i = 0; i < dst.size(); i++) dst[i] += src[i] * factor;}
+        // `pos[i] += vel[i]; vel[i] += acc[i]; vel[i] *= 1 - damp[i]`.
+        constexpr void integrate_damped(std::span<vec3<float>> pos, std::span<vec3<float>> vel, std::span<const vec3<float>> acc, std::span<const float> damp) {for (std::size_t i = 0; i < pos.size(); i++) {pos[i] += vel[i]; vel[i] += acc[i]; vel[i] *= 1 - damp[i];}}
+        // `out[i] = mix(factor, a[i], b[i])`. `out` can be the same as `a` or `b`.
+        constexpr void mix_arrays(float factor, std::span<const vec3<float>> a, std::span<const vec3<float>> b, std::span<vec3<float>> out) {for (std::size_t i = 0; i < out.size(); i++) out[i] = mix(factor, a[i], b[i]);}
+        // `out[i] = (abs(points[i] - center) > half_size).any()`, i.e. 1 if the point is outside of the box, 0 otherwise.
+        constexpr void mask_outside(std::span<const vec3<float>> points, vec3<float> center, vec3<float> half_size, std::span<std::uint8_t> out) {for (std::size_t i = 0; i < out.size(); i++) out[i] = (abs(points[i] - center) > half_size).any();}
+
+        // `dst[i] += src[i]`.
+        constexpr void add_to(std::span<vec4<float>> dst, std::span<const vec4<float>> src) {for (std::size_t i = 0; i < dst.size(); i++) dst[i] += src[i];}
+        // `dst[i] += src[i] * factor`.
+        constexpr void add_scaled_to(std::span<vec4<float>> dst, std::span<const vec4<float>> src, float factor) {for (std::size_t i = 0; i < dst.size(); i++) dst[i] += src[i] * factor;}
+        // `pos[i] += vel[i]; vel[i] += acc[i]; vel[i] *= 1 - damp[i]`.
+        constexpr void integrate_damped(std::span<vec4<float>> pos, std::span<vec4<float>> vel, std::span<const vec4<float>> acc, std::span<const float> damp) {for (std::size_t i = 0; i < pos.size(); i++) {pos[i] += vel[i]; vel[i] += acc[i]; vel[i] *= 1 - damp[i];}}
+        // `out[i] = mix(factor, a[i], b[i])`. `out` can be the same as `a` or `b`.
+        constexpr void mix_arrays(float factor, std::span<const vec4<float>> a, std::span<const vec4<float>> b, std::span<vec4<float>> out) {for (std::size_t i = 0; i < out.size(); i++) out[i] = mix(factor, a[i], b[i]);}
+        // `out[i] = (abs(points[i] - center) > half_size).any()`, i.e. 1 if the point is outside of the box, 0 otherwise.
+        constexpr void mask_outside(std::span<const vec4<float>> points, vec4<float> center, vec4<float> half_size, std::span<std::uint8_t> out) {for (std::size_t i = 0; i < out.size(); i++) out[i] = (abs(points[i] - center) > half_size).any();}
+
+        // `dst[i] += src[i]`.
+        constexpr void add_to(std::span<vec2<double>> dst, std::span<const vec2<double>> src) {for (std::size_t i = 0; i < dst.size(); i++) dst[i] += src[i];}
+        // `dst[i] += src[i] * factor`.
+        constexpr void add_scaled_to(std::span<vec2<double>> dst, std::span<const vec2<double>> src, double factor) {for (std::size_t i = 0; i < dst.size(); i++) dst[i] += src[i] * factor;}
+        // `pos[i] += vel[i]; vel[i] += acc[i]; vel[i] *= 1 - damp[i]`.
+        constexpr void integrate_damped(std::span<vec2<double>> pos, std::span<vec2<double>> vel, std::span<const vec2<double>> acc, std::span<const double> damp) {for (std::size_t i = 0; i < pos.size(); i++) {pos[i] += vel[i]; vel[i] += acc[i]; vel[i] *= 1 - damp[i];}}
+        // `out[i] = mix(factor, a[i], b[i])`. `out` can be the same as `a` or `b`.
+        constexpr void mix_arrays(double factor, std::span<const vec2<double>> a, std::span<const vec2<double>> b, std::span<vec2<double>> out) {for (std::size_t i = 0; i < out.size(); i++) out[i] = mix(factor, a[i], b[i]);}
+        // `out[i] = (abs(points[i] - center) > half_size).any()`, i.e. 1 if the point is outside of the box, 0 otherwise.
+        constexpr void mask_outside(std::span<const vec2<double>> points, vec2<double> center, vec2<double> half_size, std::span<std::uint8_t> out) {for (std::size_t i = 0; i < out.size(); i++) out[i] = (abs(points[i] - center) > half_size).any();}
+
+        // `dst[i] += src[i]`.
+        constexpr void add_to(std::span<vec3<double>> dst, std::span<const vec3<double>> src) {for (std::size_t i = 0; i < dst.size(); i++) dst[i] += src[i];}
+        // `dst[i] += src[i] * factor`.
+        constexpr void add_scaled_to(std::span<vec3<double>> dst, std::span<const vec3<double>> src, double factor) {for (std::size_t i = 0; i < dst.size(); i++) dst[i] += src[i] * factor;}
+        // `pos[i] += vel[i]; vel[i] += acc[i]; vel[i] *= 1 - damp[i]`.
+        constexpr void integrate_damped(std::span<vec3<double>> pos, std::span<vec3<double>> vel, std::span<const vec3<double>> acc, std::span<const double> damp) {for (std::size_t i = 0; i < pos.size(); i++) {pos[i] += vel[i]; vel[i] += acc[i]; vel[i] *= 1 - damp[i];}}
+        // `out[i] = mix(factor, a[i], b[i])`. `out` can be the same as `a` or `b`.
+        constexpr void mix_arrays(double factor, std::span<const vec3<double>> a, std::span<const vec3<double>> b, std::span<vec3<double>> out) {for (std::size_t i = 0; i < out.size(); i++) out[i] = mix(factor, a[i], b[i]);}
+        // `out[i] = (abs(points[i] - center) > half_size).any()`, i.e. 1 if the point is outside of the box, 0 otherwise.
+        constexpr void mask_outside(std::span<const vec3<double>> points, vec3<double> center, vec3<double> half_size, std::span<std::uint8_t> out) {for (std::size_t i = 0; i < out.size(); i++) out[i] = (abs(points[i] - center) > half_size).any();}
+
+        // `dst[i] += src[i]`.
+        constexpr void add_to(std::span<vec4<double>> dst, std::span<const vec4<double>> src) {for (std::size_t i = 0; i < dst.size(); i++) dst[i] += src[i];}
+        // `dst[i] += src[i] * factor`.
+        constexpr void add_scaled_to(std::span<vec4<double>> dst, std::span<const vec4<double>> src, double factor) {for (std::size_t i = 0; i < dst.size(); i++) dst[i] += src[i] * factor;}
+        // `pos[i] += vel[i]; vel[i] += acc[i]; vel[i] *= 1 - damp[i]`.
+        constexpr void integrate_damped(std::span<vec4<double>> pos, std::span<vec4<double>> vel, std::span<const vec4<double>> acc, std::span<const double> damp) {for (std::size_t i = 0; i < pos.size(); i++) {pos[i] += vel[i]; vel[i] += acc[i]; vel[i] *= 1 - damp[i];}}
+        // `out[i] = mix(factor, a[i], b[i])`. `out` can be the same as `a` or `b`.
+        constexpr void mix_arrays(double factor, std::span<const vec4<double>> a, std::span<const vec4<double>> b, std::span<vec4<double>> out) {for (std::size_t i = 0; i < out.size(); i++) out[i] = mix(factor, a[i], b[i]);}
+        // `out[i] = (abs(points[i] - center) > half_size).any()`, i.e. 1 if the point is outside of the box, 0 otherwise.
+        constexpr void mask_outside(std::span<const vec4<double>> points, vec4<double> center, vec4<double> half_size, std::span<std::uint8_t> out) {for (std::size_t i = 0; i < out.size(); i++) out[i] = (abs(points[i] - center) > half_size).any();}
+    }
+
     namespace Export
     {
         using Vector::vec; // Vector and matrix definitions. We use this instead of `using namespace Vector` to avoid bringing...
         using Vector::mat; // ...the overloaded operators into the global namespace, mostly for better error messages and build speed.
         using namespace Alias; // Convenient type aliases.
         using namespace Common; // Common functions.
+        using namespace Batch; // Transforming arrays of points.
 
         // Common types.
         using std::int8_t;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
 #include <cstddef>
 
@@ -17,6 +18,26 @@ class Metronome
     float comp_th = 0, comp_amount = 0;
     int comp_dir = 0; // Internal. 1 means forward, -1 means backwards, 0 means whatever is better.
 
+    uint64_t tick_time_budget = 0; // See `SetTickTimeBudget()`. 0 if disabled.
+    bool slow_motion = false; // See `SetSlowMotion()`.
+    uint64_t tick_cost = 0; // A moving average of `AddTickCost()`. 0 if unknown.
+    int frame_ticks = 0; // The ticks in the current frame.
+    double dropped_ticks = 0;
+
+    uint64_t fast_forward_budget = 0; // See `SetFastForward()`. 0 if disabled.
+    int fast_forward_max_ticks = 0;
+    uint64_t frame_cost = 0; // The sum of `AddTickCost()` in the current frame.
+    double speed = 0; // See `SpeedMultiplier()`. 0 if unknown.
+
+    // Call on a new frame, before resetting `frame_ticks`. `delta` is the duration of the last frame.
+    void UpdateSpeed(uint64_t delta)
+    {
+        if (delta == 0)
+            return;
+        double cur_speed = frame_ticks * double(tick_len) / delta;
+        speed = speed ? speed * 0.9 + cur_speed * 0.1 : cur_speed;
+    }
+
   public:
     uint64_t ticks = 0;
 
@@ -47,6 +68,41 @@ class Metronome
         comp_th = threshold;
         comp_amount = amount;
     }
+    // Limits the catch-up ticks, so that a frame spends at most `secs` on them, according to the measured tick cost (see `AddTickCost()`).
+    // This stops a slow tick from causing more ticks per frame, which make the frames even slower. At least one tick per frame is always allowed. 0 disables the limit.
+    void SetTickTimeBudget(double secs)
+    {
+        tick_time_budget = Clock::SecondsToTicks(secs);
+    }
+    // If enabled, the time that didn't fit into the budget is dropped, so the game slows down smoothly.
+    // Otherwise it's kept as a `TimeDebt()`, and is caught up on later (but never more than the max ticks per frame).
+    void SetSlowMotion(bool enable)
+    {
+        slow_motion = enable;
+    }
+    // In the fast-forward mode, the elapsed time is ignored, and each frame runs as many ticks as fit into `frame_budget_secs` (at least one, at most `max_ticks_per_frame`).
+    // The budget is checked against the actual costs of the ticks in this frame, as reported by `AddTickCost()`, so it must be less than the frame time to leave room for the rendering.
+    // 0 disables the mode. Switching either way drops the accumulated time, so the game doesn't try to catch up.
+    void SetFastForward(double frame_budget_secs, int max_ticks_per_frame = 1000)
+    {
+        uint64_t new_budget = Clock::SecondsToTicks(frame_budget_secs);
+        if (bool(new_budget) != bool(fast_forward_budget))
+            accumulator = 0;
+        fast_forward_budget = new_budget;
+        fast_forward_max_ticks = max_ticks_per_frame;
+    }
+    [[nodiscard]] bool FastForward() const
+    {
+        return fast_forward_budget;
+    }
+
+    // Call this after each tick, with its duration in clock ticks.
+    void AddTickCost(uint64_t clock_ticks)
+    {
+        tick_cost = tick_cost ? (tick_cost * 7 + clock_ticks) / 8 : clock_ticks;
+        frame_cost += clock_ticks;
+    }
+
     void Reset()
     {
         accumulator = 0;
@@ -54,6 +110,10 @@ class Metronome
         lag = 0;
         comp_dir = 0;
         ticks = 0;
+        frame_ticks = 0;
+        dropped_ticks = 0;
+        frame_cost = 0;
+        speed = 0;
     }
 
     bool Lag() // Flag resets after this function is called. The flag is set to 1 if the amount of ticks per last frame is at maximum value.
@@ -81,10 +141,55 @@ class Metronome
         return max_ticks;
     }
 
+    // The average duration of a tick, in seconds, as reported by `AddTickCost()`.
+    double TickCost() const
+    {
+        return Clock::TicksToSeconds(tick_cost);
+    }
+
+    // Between the frames, the number of whole ticks that are due, but were postponed by the tick time budget.
+    double TimeDebt() const
+    {
+        return std::floor(Time());
+    }
+
+    // The number of ticks skipped since `Reset()`, because of the max ticks per frame, or in the slow motion mode.
+    double DroppedTicks() const
+    {
+        return dropped_ticks;
+    }
+
+    // The game time per real time, averaged over the last frames. Less than 1 when lagging or in the slow motion, more than 1 in the fast-forward mode. 0 if unknown.
+    double SpeedMultiplier() const
+    {
+        return speed;
+    }
+
     bool Tick(uint64_t delta)
     {
         if (new_frame)
-            accumulator += delta;
+        {
+            UpdateSpeed(delta);
+            frame_ticks = 0;
+            frame_cost = 0;
+            if (!fast_forward_budget)
+                accumulator += delta;
+        }
+
+        if (fast_forward_budget)
+        {
+            // Stop if the next tick wouldn't fit into the budget.
+            if (frame_ticks > 0 && ((fast_forward_max_ticks && frame_ticks >= fast_forward_max_ticks) || frame_cost + tick_cost > fast_forward_budget))
+            {
+                new_frame = 1;
+                return 0;
+            }
+
+            new_frame = 0;
+            frame_ticks++;
+            ticks++;
+            return 1;
+        }
 
         if (std::abs(int64_t(accumulator - tick_len)) < tick_len * comp_th)
         {
@@ -102,11 +207,28 @@ class Metronome
         {
             if (max_ticks && accumulator > tick_len * max_ticks)
             {
+                dropped_ticks += (accumulator - tick_len * max_ticks) / double(tick_len);
                 accumulator = tick_len * max_ticks;
                 lag = 1;
             }
+
+            // Stop if the next tick wouldn't fit into the budget.
+            if (tick_time_budget && frame_ticks > 0 && tick_cost * (frame_ticks + 1) > tick_time_budget)
+            {
+                if (slow_motion)
+                {
+                    // Keep the fractional part of a tick, to not disturb the pacing.
+                    dropped_ticks += accumulator / tick_len;
+                    accumulator %= tick_len;
+                }
+                lag = 1;
+                new_frame = 1;
+                return 0;
+            }
+
             accumulator -= tick_len;
             new_frame = 0;
+            frame_ticks++;
             ticks++;
             return 1;
         }
@@ -121,4 +243,13 @@ class Metronome
     {
         return accumulator / double(tick_len);
     }
+
+    // How far we are from the last tick to the next one, in `0..1`. Use this to interpolate the rendering between the ticks.
+    // Always 1 in the fast-forward mode, since each frame ends right after its last tick.
+    float TickFraction() const
+    {
+        if (fast_forward_budget)
+            return 1;
+        return std::clamp(float(Time()), 0.f, 1.f);
+    }
 };
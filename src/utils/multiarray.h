@@ -3,6 +3,7 @@
 #include <algorithm>
 #include <array>
 #include <cstddef>
+#include <memory>
 #include <type_traits>
 #include <vector>
 #include <utility>
@@ -12,8 +13,8 @@
 #include "strings/format.h"
 #include "utils/mat.h"
 
-
-template <int D, typename T>
+// The allocator can be changed, e.g. to `Storage::AlignedAllocator` for the SIMD loops, or to `Storage::LargeBufferAllocator` for the huge arrays.
+template <int D, typename T, typename Allocator = std::allocator<T>>
 class MultiArray
 {
   public:
@@ -22,6 +23,7 @@ class MultiArray
     static_assert(dimensions <= 4, "Arrays with more than 4 dimensions are not supported.");
 
     using type = T;
+    using allocator_type = Allocator;
     using index_t = std::ptrdiff_t;
     using index_vec_t = index_vec<D>;
 
@@ -29,7 +31,7 @@ class MultiArray
 
   private:
     index_vec_t size_vec{};
-    std::vector<type> storage;
+    std::vector<type, Allocator> storage;
 
   public:
     constexpr MultiArray() {}
@@ -139,6 +141,22 @@ class MultiArray
         return const_cast<MultiArray *>(this)->try_set(pos, std::move(obj));
     }
 
+    // Calls `func(pos, elem)` for every element, in the storage order (the first coordinate changes the fastest).
+    template <typename F>
+    void for_each(F &&func)
+    {
+        type *ptr = storage.data();
+        for (auto pos : vector_range(size_vec))
+            func(pos, *ptr++);
+    }
+    template <typename F>
+    void for_each(F &&func) const
+    {
+        const type *ptr = storage.data();
+        for (auto pos : vector_range(size_vec))
+            func(pos, *ptr++);
+    }
+
     [[nodiscard]] index_t element_count() const
     {
         return storage.size();
@@ -153,6 +171,6 @@ class MultiArray
     }
 };
 
-template <typename T> using Array2D = MultiArray<2, T>;
-template <typename T> using Array3D = MultiArray<3, T>;
-template <typename T> using Array4D = MultiArray<4, T>;
+template <typename T, typename Allocator = std::allocator<T>> using Array2D = MultiArray<2, T, Allocator>;
+template <typename T, typename Allocator = std::allocator<T>> using Array3D = MultiArray<3, T, Allocator>;
+template <typename T, typename Allocator = std::allocator<T>> using Array4D = MultiArray<4, T, Allocator>;
@@ -6,6 +6,8 @@
 
 #include <stb_rect_pack.h>
 
+#include "program/errors.h"
+
 namespace Packing
 {
     int PackRects(ivec2 target_size, Rect *data, int count, int inner_gaps, int outer_gaps)
@@ -49,4 +51,151 @@ namespace Packing
 
         return rects_not_packed;
     }
+
+    MaxRectsPacker::MaxRectsPacker(ivec2 target_size, int inner_gaps)
+        : target_size(target_size), inner_gaps(inner_gaps)
+    {
+        // Like in `PackRects()`, the gap after the last rectangle in a row can go past the edge.
+        free_boxes.push_back({.pos = ivec2(0), .size = target_size + inner_gaps});
+    }
+
+    void MaxRectsPacker::SplitFreeBoxes(const Box &placed)
+    {
+        std::size_t old_count = free_boxes.size();
+        for (std::size_t i = 0; i < old_count;)
+        {
+            Box free = free_boxes[i];
+            if (!free.Intersects(placed))
+            {
+                i++;
+                continue;
+            }
+
+            // Replace the box with up to four maximal boxes around the placed one.
+            for (int axis = 0; axis < 2; axis++)
+            {
+                if (placed.pos[axis] > free.pos[axis])
+                {
+                    Box part = free;
+                    part.size[axis] = placed.pos[axis] - free.pos[axis];
+                    free_boxes.push_back(part);
+                }
+                if (placed.pos[axis] + placed.size[axis] < free.pos[axis] + free.size[axis])
+                {
+                    Box part = free;
+                    part.pos[axis] = placed.pos[axis] + placed.size[axis];
+                    part.size[axis] = free.pos[axis] + free.size[axis] - part.pos[axis];
+                    free_boxes.push_back(part);
+                }
+            }
+
+            free_boxes[i] = free_boxes[old_count - 1];
+            free_boxes[old_count - 1] = free_boxes.back();
+            free_boxes.pop_back();
+            old_count--;
+        }
+    }
+
+    void MaxRectsPacker::PruneFreeBoxes()
+    {
+        for (std::size_t i = 0; i < free_boxes.size(); i++)
+        {
+            for (std::size_t j = i + 1; j < free_boxes.size();)
+            {
+                if (free_boxes[i].Contains(free_boxes[j]))
+                {
+                    free_boxes[j] = free_boxes.back();
+                    free_boxes.pop_back();
+                }
+                else if (free_boxes[j].Contains(free_boxes[i]))
+                {
+                    free_boxes[i] = free_boxes[j];
+                    free_boxes[j] = free_boxes.back();
+                    free_boxes.pop_back();
+                    j = i + 1; // The new box at `i` can contain some of the boxes we've already checked.
+                }
+                else
+                {
+                    j++;
+                }
+            }
+        }
+    }
+
+    std::optional<ivec2> MaxRectsPacker::Insert(ivec2 size)
+    {
+        ivec2 padded_size = size + inner_gaps;
+
+        const Box *best = nullptr;
+        ivec2 best_score; // Short side leftover, then long side leftover.
+        for (const Box &free : free_boxes)
+        {
+            ivec2 leftover = free.size - padded_size;
+            if ((leftover < 0).any())
+                continue;
+            ivec2 score(leftover.min(), leftover.max());
+            if (!best || score.x < best_score.x || (score.x == best_score.x && score.y < best_score.y))
+            {
+                best = &free;
+                best_score = score;
+            }
+        }
+        if (!best)
+            return {};
+
+        Box placed = {.pos = best->pos, .size = padded_size};
+        SplitFreeBoxes(placed);
+        PruneFreeBoxes();
+
+        used_boxes.push_back(placed);
+        used_area += size.prod();
+        return placed.pos;
+    }
+
+    bool MaxRectsPacker::InsertAt(ivec2 pos, ivec2 size)
+    {
+        Box placed = {.pos = pos, .size = size + inner_gaps};
+        if ((pos < 0).any() || (placed.pos + placed.size > target_size + inner_gaps).any())
+            return false;
+        for (const Box &used : used_boxes)
+        {
+            if (used.Intersects(placed))
+                return false;
+        }
+
+        SplitFreeBoxes(placed);
+        PruneFreeBoxes();
+
+        used_boxes.push_back(placed);
+        used_area += size.prod();
+        return true;
+    }
+
+    void MaxRectsPacker::Remove(ivec2 pos, ivec2 size)
+    {
+        Box box = {.pos = pos, .size = size + inner_gaps};
+        auto it = std::find_if(used_boxes.begin(), used_boxes.end(), [&](const Box &used){return used.pos == box.pos && used.size == box.size;});
+        if (it == used_boxes.end())
+            Program::Error("Attempt to remove a rectangle that wasn't packed.");
+        *it = used_boxes.back();
+        used_boxes.pop_back();
+        used_area -= size.prod();
+
+        free_boxes.push_back(box);
+        PruneFreeBoxes();
+    }
+
+    ivec2 MaxRectsPacker::UsedBounds() const
+    {
+        ivec2 ret(0);
+        for (const Box &used : used_boxes)
+            ret = max(ret, used.pos + used.size - inner_gaps);
+        return ret;
+    }
+
+    float MaxRectsPacker::Density() const
+    {
+        long long bounds_area = UsedBounds().prod();
+        return bounds_area > 0 ? float(double(used_area) / bounds_area) : 0;
+    }
 }
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <optional>
+#include <vector>
+
 #include "utils/mat.h"
 
 namespace Packing
@@ -20,4 +23,54 @@ namespace Packing
     // Returns 0 on success. On failure returns the amount of rectangles that didn't fit into the box.
     // Note that coordinates outside of [0;65535] range are not supported by default. This can be changed in `stb_rect_pack.h`.
     int PackRects(ivec2 target_size, Rect *data, int count, int inner_gaps = 0, int outer_gaps = 0);
+
+    // A packer for adding and removing rectangles one by one, without repacking the existing ones.
+    // Uses the MaxRects algorithm with the "best short side fit" heuristic.
+    // Removal returns the space to the free list, but doesn't merge it with the neighboring free space, so heavy churn fragments the box over time.
+    class MaxRectsPacker
+    {
+        struct Box
+        {
+            ivec2 pos, size;
+
+            [[nodiscard]] bool Intersects(const Box &other) const
+            {
+                return (pos < other.pos + other.size).all() && (other.pos < pos + size).all();
+            }
+            [[nodiscard]] bool Contains(const Box &other) const
+            {
+                return (pos <= other.pos).all() && (other.pos + other.size <= pos + size).all();
+            }
+        };
+
+        ivec2 target_size = ivec2(0);
+        int inner_gaps = 0;
+        std::vector<Box> free_boxes; // Maximal free rectangles, can overlap.
+        std::vector<Box> used_boxes; // Including the gaps.
+        long long used_area = 0; // Excluding the gaps.
+
+        void SplitFreeBoxes(const Box &placed);
+        void PruneFreeBoxes();
+
+      public:
+        MaxRectsPacker() {}
+        // Same meaning of `inner_gaps` as in `PackRects()`.
+        MaxRectsPacker(ivec2 target_size, int inner_gaps = 0);
+
+        [[nodiscard]] ivec2 TargetSize() const {return target_size;}
+
+        // Returns the position of the new rectangle, or nothing if it doesn't fit.
+        [[nodiscard]] std::optional<ivec2> Insert(ivec2 size);
+        // Inserts a rectangle at a fixed position, e.g. to restore an existing layout. Returns false if it's out of bounds or overlaps the existing ones.
+        [[nodiscard]] bool InsertAt(ivec2 pos, ivec2 size);
+        // Frees a rectangle previously returned by `Insert()`. Throws if there's no such rectangle.
+        void Remove(ivec2 pos, ivec2 size);
+
+        // The total area of the inserted rectangles, not counting the gaps.
+        [[nodiscard]] long long UsedArea() const {return used_area;}
+        // The size of the bounding box of all inserted rectangles, starting at the origin. The target size can be shrunk to this.
+        [[nodiscard]] ivec2 UsedBounds() const;
+        // `UsedArea()` divided by the area of `UsedBounds()`, from 0 to 1. Higher is better.
+        [[nodiscard]] float Density() const;
+    };
 }
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+#include "program/errors.h"
+#include "strings/format.h"
+#include "utils/mat.h"
+#include "utils/multiarray.h"
+
+// A 2D array surrounded by a border of extra cells, so `unsafe_at()` also works for the positions slightly outside of it.
+// This lets the loops over small neighbourhoods skip the bounds checks and clamping.
+// With `replicate`, the border repeats the edge cells, like `clamped_at()` does. Modify the cells with `set()` to keep it in sync,
+// or call `refresh_border()` after modifying them directly.
+// With `fill`, the border always holds the value passed to the constructor.
+template <typename T>
+class PaddedArray2D
+{
+  public:
+    enum class BorderMode {replicate, fill};
+
+    using type = T;
+    using index_t = std::ptrdiff_t;
+    using index_vec_t = index_vec2;
+
+  private:
+    index_vec_t size_vec{};
+    index_t border_width = 0;
+    BorderMode mode = BorderMode::replicate;
+    Array2D<type> storage; // Includes the border.
+
+  public:
+    constexpr PaddedArray2D() {}
+
+    PaddedArray2D(index_vec_t size_vec, index_t border_width, BorderMode mode = BorderMode::replicate, const T &init = T{})
+        : size_vec(size_vec), border_width(border_width), mode(mode), storage(size_vec + border_width * 2, init)
+    {
+        ASSERT(size_vec.min() >= 0 && border_width >= 0, "Invalid padded array size.");
+    }
+
+    // The size without the border.
+    [[nodiscard]] index_vec_t size() const
+    {
+        return size_vec;
+    }
+    [[nodiscard]] index_t border() const
+    {
+        return border_width;
+    }
+
+    // Checks the position against the array size, without the border.
+    [[nodiscard]] bool pos_in_range(index_vec_t pos) const
+    {
+        return (pos >= 0).all() && (pos < size_vec).all();
+    }
+    // Checks the position against the array size, including the border.
+    [[nodiscard]] bool pos_in_padded_range(index_vec_t pos) const
+    {
+        return (pos >= -border_width).all() && (pos < size_vec + border_width).all();
+    }
+
+    // Works both inside of the array and in the border.
+    [[nodiscard]] type &unsafe_at(index_vec_t pos)
+    {
+        ASSERT(pos_in_padded_range(pos), STR("Padded array indices out of range. Indices are ", (pos), " but the array size is ", (size_vec), " with a border of ", (border_width), "."));
+        return storage.unsafe_at(pos + border_width);
+    }
+    // Those check the position against the array size without the border.
+    [[nodiscard]] type &safe_throwing_at(index_vec_t pos)
+    {
+        if (!pos_in_range(pos))
+            Program::Error("Padded array index ", pos, " is out of range. The array size is ", size_vec, ".");
+        return unsafe_at(pos);
+    }
+    [[nodiscard]] type &safe_nonthrowing_at(index_vec_t pos)
+    {
+        if (!pos_in_range(pos))
+            Program::HardError("Padded array index ", pos, " is out of range. The array size is ", size_vec, ".");
+        return unsafe_at(pos);
+    }
+    // Clamps the position to the border. With `replicate`, this is equivalent to clamping it to the array itself.
+    [[nodiscard]] type &clamped_at(index_vec_t pos)
+    {
+        return storage.clamped_at(pos + border_width);
+    }
+
+    [[nodiscard]] const type &unsafe_at(index_vec_t pos) const
+    {
+        return const_cast<PaddedArray2D *>(this)->unsafe_at(pos);
+    }
+    [[nodiscard]] const type &safe_throwing_at(index_vec_t pos) const
+    {
+        return const_cast<PaddedArray2D *>(this)->safe_throwing_at(pos);
+    }
+    [[nodiscard]] const type &safe_nonthrowing_at(index_vec_t pos) const
+    {
+        return const_cast<PaddedArray2D *>(this)->safe_nonthrowing_at(pos);
+    }
+    [[nodiscard]] const type &clamped_at(index_vec_t pos) const
+    {
+        return const_cast<PaddedArray2D *>(this)->clamped_at(pos);
+    }
+
+    // Sets a cell inside of the array, and its copies in the border, if any.
+    void set(index_vec_t pos, const type &obj)
+    {
+        ASSERT(pos_in_range(pos), STR("Padded array indices out of range. Indices are ", (pos), " but the array size is ", (size_vec), "."));
+
+        if (mode == BorderMode::fill)
+        {
+            unsafe_at(pos) = obj;
+            return;
+        }
+
+        // The edge cells are repeated up to the outer edge of the border.
+        index_vec_t a = pos, b = pos;
+        for (int i = 0; i < 2; i++)
+        {
+            if (pos[i] == 0)
+                a[i] = -border_width;
+            if (pos[i] == size_vec[i] - 1)
+                b[i] = size_vec[i] - 1 + border_width;
+        }
+        for (index_vec_t border_pos : a <= vector_range <= b)
+            unsafe_at(border_pos) = obj;
+    }
+
+    // Copies the edge cells to the border. Does nothing with `fill`.
+    void refresh_border()
+    {
+        if (mode == BorderMode::fill || size_vec.min() == 0)
+            return;
+
+        for (index_vec_t pos : index_vec_t(-border_width) <= vector_range < size_vec + border_width)
+        {
+            if (!pos_in_range(pos))
+                unsafe_at(pos) = unsafe_at(clamp(pos, 0, size_vec - 1));
+        }
+    }
+};
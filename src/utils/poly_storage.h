@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cassert>
+#include <cstddef>
 #include <stdexcept>
 #include <type_traits>
 #include <utility>
@@ -14,6 +15,10 @@ namespace Poly
      *
      * When copied, it copies the underlying object. The copy is done properly even if `Poly::Storage<Base>` holds a derived class.
      *
+     * If the third template parameter is non-zero, the objects that fit into that many bytes (and are nothrow-move-constructible) are stored inline, without allocating.
+     * Then moving the storage moves the object, so its address isn't stable. The bigger objects are still stored on the heap.
+     * The default comes from `Poly::default_inline_size<T>`, which is zero unless specialized.
+     *
      * You can't modify objects through `const Poly::Storage<T>` (unlike std::unique_ptr).
      *
      * How to construct:
@@ -103,9 +108,12 @@ namespace Poly
     template <typename T> inline constexpr derived_tag<T> derived;
 
 
-    template <typename T, typename UserData = DefaultData<T>>
+    // The default size of the inline buffer of `Poly::Storage<T>`, in bytes. Specialize this to enable the inline storage for a specific base.
+    template <typename T> inline constexpr std::size_t default_inline_size = 0;
+
+    template <typename T, typename UserData = DefaultData<T>, std::size_t InlineSize = default_inline_size<T>>
     class Storage
-        : Meta::copyable_if<Storage<T, UserData>, impl::assume_copy_constructible<T>>
+        : Meta::copyable_if<Storage<T, UserData, InlineSize>, impl::assume_copy_constructible<T>>
     {
         static_assert(!std::is_const_v<T> && !std::is_volatile_v<T>, "The template parameter has to have no cv-qualifiers.");
         static_assert(std::is_class_v<T>, "The template parameter has to be a structure or a class.");
@@ -115,72 +123,19 @@ namespace Poly
         static constexpr bool is_copyable = impl::assume_copy_constructible<T>;
 
       private:
+        // Whether `D` is stored in the inline buffer rather than on the heap.
+        // The inline objects are moved when the storage is moved, so we require a non-throwing move constructor.
+        template <typename D>
+        static constexpr bool fits_inline = sizeof(D) <= InlineSize && std::is_nothrow_move_constructible_v<D>;
+
         struct Low
         {
-            class Unique
-            {
-                // A poor man's `std::unique_ptr`.
-                // Unlike `unique_ptr`, it also stores a downcasted pointer so that we don't have to use `dynamic_cast` every time if the base turns out to be virtual.
-                // This also allows for a relatively graceful deletion even if base doesn't have a virtual destructor.
-                // (If multiple inheritance is involved and the base doesn't have a virtual destructor, `unique_ptr` could attempt to `free` an invalid (not adjusted) pointer, causing a crash.
-                // This is caused by naively calling `delete` on a pointer to base. We don't do that. Instead, we call the destructor via the base pointer, and then `delete` the downcasted pointer as `char` array.)
-
-                struct Data
-                {
-                    unsigned char *bytes = 0;
-                    T *base = 0;
-                };
-                Data data;
-
-              public:
-                Unique() {}
-
-                template <typename D, typename ...P> static Unique make(P &&... params)
-                {
-                    Unique ret;
-
-                    ret.data.bytes = new unsigned char[sizeof(D)];
-                    FINALLY_ON_THROW( delete[] ret.data.bytes; ret.data.bytes = nullptr; ) // Zeroing the pointer is important, because the destructor of `ret` will look at it.
-
-                    D *derived = new(ret.data.bytes) D(std::forward<P>(params)...);
-                    // Not needed because nothing below this point can throw:
-                    // FINALLY_ON_THROW( derived->~D(); )
-
-                    ret.data.base = derived;
-
-                    return ret;
-                }
-
-                Unique(Unique &&other) noexcept : data(std::exchange(other.data, {})) {}
-                Unique &operator=(Unique other) noexcept {std::swap(data, other.data); return *this;}
-
-                ~Unique()
-                {
-                    if (data.bytes)
-                    {
-                        if constexpr (std::has_virtual_destructor_v<T>)
-                            data.base->~T();
-                        else
-                            data.base->T::~T(); // This silences some warnings about the destructor being non-virtual. We insteal have some static assertions to catch common mistakes.
-                        delete[] data.bytes;
-                    }
-                }
-
-                explicit operator bool() const
-                {
-                    return bool(data.bytes);
-                }
-
-                      unsigned char *bytes()       {return data.bytes;}
-                const unsigned char *bytes() const {return data.bytes;}
-
-                      T *base()       {return data.base;}
-                const T *base() const {return data.base;}
-            };
-
             struct Table : UserData
             {
-                Unique (*_copy)(const Storage::Low &);
+                // Copy-constructs the object from `from` into `to`, which must be empty.
+                void (*_copy)(Storage::Low &to, const Storage::Low &from);
+                // Move-constructs the object from `from` into `to`, which must be empty, and destroys the original. Only for the inline objects, null otherwise.
+                void (*_move)(Storage::Low &to, Storage::Low &from) noexcept;
 
                 template <typename D> constexpr void _make()
                 {
@@ -188,42 +143,111 @@ namespace Poly
 
                     if constexpr (is_copyable)
                     {
-                        _copy = [](const Storage::Low &param) -> Unique
+                        _copy = [](Storage::Low &to, const Storage::Low &from)
                         {
-                            return Unique::template make<D>(param.template derived_or_assert<D>());
+                            to.template construct<D>(from.template derived_or_assert<D>());
                         };
                     }
                     else
                     {
                         _copy = 0;
                     }
+
+                    if constexpr (fits_inline<D>)
+                    {
+                        _move = [](Storage::Low &to, Storage::Low &from) noexcept
+                        {
+                            to.template construct<D>(std::move(from.template derived_or_assert<D>()));
+                            from.reset();
+                        };
+                    }
+                    else
+                    {
+                        _move = 0;
+                    }
                 }
             };
 
             struct Data
             {
-                Unique pointers;
+                // Points either to `buffer` or to a heap allocation.
+                unsigned char *bytes = 0;
+                // We store a downcasted pointer too, so that we don't have to use `dynamic_cast` every time if the base turns out to be virtual.
+                // This also allows for a relatively graceful deletion even if base doesn't have a virtual destructor.
+                // (If multiple inheritance is involved and the base doesn't have a virtual destructor, `unique_ptr` could attempt to `free` an invalid (not adjusted) pointer, causing a crash.
+                // This is caused by naively calling `delete` on a pointer to base. We don't do that. Instead, we call the destructor via the base pointer, and then `delete` the downcasted pointer as `char` array.)
+                T *base = 0;
                 const Table *table = 0;
             };
             Data data;
 
+            struct EmptyBuffer
+            {
+                unsigned char *bytes() {return nullptr;}
+            };
+            struct Buffer
+            {
+                alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) unsigned char storage[InlineSize];
+                unsigned char *bytes() {return storage;}
+            };
+            [[no_unique_address]] std::conditional_t<InlineSize == 0, EmptyBuffer, Buffer> buffer;
+
             Low() {}
 
-            Low(Low &&other) noexcept : data(std::exchange(other.data, {})) {}
-            Low &operator=(Low other) noexcept {std::swap(data, other.data); return *this;}
+            Low(Low &&other) noexcept
+            {
+                take(other);
+            }
+            Low &operator=(Low other) noexcept
+            {
+                reset();
+                take(other);
+                return *this;
+            }
 
-            ~Low() {}
+            ~Low()
+            {
+                reset();
+            }
 
             Low(const Low &other)
             {
                 if (other)
-                {
-                    data.pointers = other.data.table->_copy(other);
-                    data.table = other.data.table;
-                }
+                    other.data.table->_copy(*this, other);
             }
 
-            template <typename D, typename ...P> static Low make(D **out_ptr, P &&... params)
+            [[nodiscard]] bool is_inline() const
+            {
+                return data.bytes && data.bytes == const_cast<Low *>(this)->buffer.bytes();
+            }
+
+            // Destroys the object, if any.
+            void reset() noexcept
+            {
+                if (!data.bytes)
+                    return;
+
+                if constexpr (std::has_virtual_destructor_v<T>)
+                    data.base->~T();
+                else
+                    data.base->T::~T(); // This silences some warnings about the destructor being non-virtual. We insteal have some static assertions to catch common mistakes.
+
+                if (!is_inline())
+                    delete[] data.bytes;
+                data = {};
+            }
+
+            // Moves the object from `other` into this object, which must be empty. `other` becomes empty.
+            void take(Low &other) noexcept
+            {
+                if (other.is_inline())
+                    other.data.table->_move(*this, other);
+                else
+                    data = std::exchange(other.data, {});
+            }
+
+            // Constructs a `D` in this object, which must be empty.
+            template <typename D, typename ...P> void construct(P &&... params)
             {
                 static_assert(!std::is_const_v<D> && !std::is_volatile_v<D>, "The template parameter has to have no cv-qualifiers.");
                 static_assert(std::is_base_of_v<T, D>, "The template parameter has to be equal to T or to be derived from T.");
@@ -232,17 +256,33 @@ namespace Poly
                               "If you want to store derived classes, the base class has to have a virtual destructor. Alternatively, those derived classes have to have trivial destructors.");
                 static_assert(alignof(D) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "Overaligned types are not supported.");
 
-                Low ret;
-                ret.data.pointers = Unique::template make<D>(std::forward<P>(params)...);
-                ret.data.table = &impl::type_erasure_data_storage<Table, D>;
+                D *derived;
+                if constexpr (fits_inline<D>)
+                {
+                    derived = new(buffer.bytes()) D(std::forward<P>(params)...);
+                    data.bytes = buffer.bytes();
+                }
+                else
+                {
+                    unsigned char *bytes = new unsigned char[sizeof(D)];
+                    FINALLY_ON_THROW( delete[] bytes; )
+                    derived = new(bytes) D(std::forward<P>(params)...);
+                    data.bytes = bytes;
+                }
+                // Nothing below this point can throw.
 
-                if (out_ptr)
-                    *out_ptr = reinterpret_cast<D *>(ret.data.pointers.bytes());
+                data.base = derived;
+                data.table = &impl::type_erasure_data_storage<Table, D>;
+            }
 
+            template <typename D, typename ...P> static Low make(P &&... params)
+            {
+                Low ret;
+                ret.template construct<D>(std::forward<P>(params)...);
                 return ret;
             }
 
-            explicit operator bool() const {return bool(data.pointers);}
+            explicit operator bool() const {return bool(data.bytes);}
 
             template <typename D> bool contains() const
             {
@@ -259,7 +299,7 @@ namespace Poly
             {
                 if (!contains<D>())
                     throw std::runtime_error("Invalid `Poly::Storage` access.");
-                return reinterpret_cast<const D &>(data.pointers.bytes());
+                return *reinterpret_cast<const D *>(data.bytes);
             }
 
             template <typename D> D &derived_or_assert()
@@ -269,7 +309,7 @@ namespace Poly
             template <typename D> const D &derived_or_assert() const
             {
                 assert(contains<D>() && "Invalid Poly::Storage access.");
-                return *reinterpret_cast<const D *>(data.pointers.bytes());
+                return *reinterpret_cast<const D *>(data.bytes);
             }
         };
 
@@ -281,31 +321,30 @@ namespace Poly
         Storage(decltype(nullptr) = nullptr) {}
 
         template <typename ...P, typename = decltype(T(std::declval<P>()...), void())>
-        Storage(base_tag, P &&... params) : low(Low::template make<T>(nullptr, std::forward<P>(params)...)) {}
+        Storage(base_tag, P &&... params) : low(Low::template make<T>(std::forward<P>(params)...)) {}
 
         template <typename D, typename ...P, typename = decltype(D(std::declval<P>()...), void())>
-        Storage(derived_tag<D>, P &&... params) : low(Low::template make<D>(nullptr, std::forward<P>(params)...)) {}
+        Storage(derived_tag<D>, P &&... params) : low(Low::template make<D>(std::forward<P>(params)...)) {}
 
         template <typename D = T, typename ...P, typename = decltype(D(std::declval<P>()...), void())>
         D &assign(P &&... params)
         {
-            D *ret;
-            low = Low::template make<D>(&ret, std::forward<P>(params)...);
-            return *ret;
+            low = Low::template make<D>(std::forward<P>(params)...);
+            return *reinterpret_cast<D *>(low.data.bytes); // Not `derived<D>()`, since that asserts on the exact type.
         }
 
         template <typename D = T, typename ...P, typename = decltype(D(std::declval<P>()...), void())>
         [[nodiscard]] static Storage make(P &&... params)
         {
             Storage ret;
-            ret.low = Low::template make<D>(nullptr, std::forward<P>(params)...);
+            ret.low = Low::template make<D>(std::forward<P>(params)...);
             return ret;
         }
 
         [[nodiscard]] explicit operator bool() const {return bool(low);}
 
-        [[nodiscard]]       T &base()       {return *low.data.pointers.base();}
-        [[nodiscard]] const T &base() const {return *low.data.pointers.base();}
+        [[nodiscard]]       T &base()       {return *low.data.base;}
+        [[nodiscard]] const T &base() const {return *low.data.base;}
 
         [[nodiscard]]       T &operator*()       {return base();}
         [[nodiscard]] const T &operator*() const {return base();}
@@ -314,8 +353,12 @@ namespace Poly
         [[nodiscard]] const T *operator->() const {return &base();}
 
         // Unlike `get()`, this returns the actual pointer to the class even if multiple inheritance is present.
-        [[nodiscard]]       unsigned char *bytes()       {return low.data.pointers.bytes();}
-        [[nodiscard]] const unsigned char *bytes() const {return low.data.pointers.bytes();}
+        [[nodiscard]]       unsigned char *bytes()       {return low.data.bytes;}
+        [[nodiscard]] const unsigned char *bytes() const {return low.data.bytes;}
+
+        // Returns true if the object is stored in the inline buffer rather than on the heap.
+        // That happens when the type fits into `InlineSize` bytes and is nothrow-move-constructible.
+        [[nodiscard]] bool is_inline() const {return low.is_inline();}
 
         [[nodiscard]] const UserData &dynamic() const {return *low.data.table;}
 
@@ -1,11 +1,15 @@
 #pragma once
 
+#include <algorithm>
 #include <cmath>
 #include <concepts>
 #include <cstdint>
+#include <istream>
 #include <iterator>
 #include <limits>
+#include <ostream>
 #include <random>
+#include <span>
 #include <string>
 #include <type_traits>
 #include <utility>
@@ -37,12 +41,162 @@ Usage:
     A <= ra.{i,f}vec{2,3,4} <= B
   For a vector, both scalar and vector bounds are supported.
 
+* Many random numbers at once, with inclusive bounds:
+    ra.f.fill(span, A, B)
+  This computes the bounds only once.
+
 See `Random::Misc` for various helpers.
 */
 
 namespace Random
 {
-    using DefaultGenerator = std::mt19937;
+    // Advances `state` and returns the next SplitMix64 number. Good for expanding seeds.
+    [[nodiscard]] constexpr std::uint64_t SplitMix64(std::uint64_t &state)
+    {
+        state += 0x9e3779b97f4a7c15;
+        std::uint64_t z = state;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+    // xoshiro256++, by David Blackman and Sebastiano Vigna. 32 bytes of state instead of 2.5 KB for `std::mt19937`, and much faster to seed and to copy.
+    // Mimics the standard engines: can be seeded with a number or a seed sequence, compared, and its state can be written to and read from streams.
+    class Xoshiro256pp
+    {
+        std::uint64_t state[4]{};
+
+        [[nodiscard]] static constexpr std::uint64_t Rotl(std::uint64_t x, int k)
+        {
+            return (x << k) | (x >> (64 - k));
+        }
+
+      public:
+        using result_type = std::uint64_t;
+        static constexpr result_type default_seed = 0;
+
+        constexpr Xoshiro256pp() : Xoshiro256pp(default_seed) {}
+        constexpr explicit Xoshiro256pp(result_type value) {seed(value);}
+        template <typename S> requires requires(S &seq, std::uint32_t *ptr){seq.generate(ptr, ptr);}
+        explicit Xoshiro256pp(S &seq) {seed(seq);}
+
+        // Expands the seed with SplitMix64, as recommended by the authors.
+        constexpr void seed(result_type value = default_seed)
+        {
+            for (std::uint64_t &elem : state)
+                elem = SplitMix64(value);
+        }
+        template <typename S> requires requires(S &seq, std::uint32_t *ptr){seq.generate(ptr, ptr);}
+        void seed(S &seq)
+        {
+            std::uint32_t words[8];
+            seq.generate(words, words + 8);
+            for (int i = 0; i < 4; i++)
+                state[i] = words[i * 2] | std::uint64_t(words[i * 2 + 1]) << 32;
+            if (!(state[0] | state[1] | state[2] | state[3]))
+                seed(); // The zero state is the only invalid one.
+        }
+
+        [[nodiscard]] static constexpr result_type min() {return 0;}
+        [[nodiscard]] static constexpr result_type max() {return std::numeric_limits<result_type>::max();}
+
+        constexpr result_type operator()()
+        {
+            result_type ret = Rotl(state[0] + state[3], 23) + state[0];
+            std::uint64_t t = state[1] << 17;
+            state[2] ^= state[0];
+            state[3] ^= state[1];
+            state[1] ^= state[2];
+            state[0] ^= state[3];
+            state[2] ^= t;
+            state[3] = Rotl(state[3], 45);
+            return ret;
+        }
+
+        constexpr void discard(unsigned long long count)
+        {
+            while (count-- > 0)
+                (void)operator()();
+        }
+
+        [[nodiscard]] friend constexpr bool operator==(const Xoshiro256pp &a, const Xoshiro256pp &b)
+        {
+            return std::equal(std::begin(a.state), std::end(a.state), std::begin(b.state));
+        }
+
+        template <typename C, typename T>
+        friend std::basic_ostream<C, T> &operator<<(std::basic_ostream<C, T> &stream, const Xoshiro256pp &gen)
+        {
+            return stream << gen.state[0] << ' ' << gen.state[1] << ' ' << gen.state[2] << ' ' << gen.state[3];
+        }
+        template <typename C, typename T>
+        friend std::basic_istream<C, T> &operator>>(std::basic_istream<C, T> &stream, Xoshiro256pp &gen)
+        {
+            std::uint64_t new_state[4];
+            if (stream >> new_state[0] >> new_state[1] >> new_state[2] >> new_state[3])
+                std::copy(std::begin(new_state), std::end(new_state), std::begin(gen.state));
+            return stream;
+        }
+    };
+
+    using DefaultGenerator = Xoshiro256pp;
+
+    // The "Squares" counter-based generator, by Bernard Widynski. Returns the number `counter` of the stream identified by `key`.
+    // The key must be odd and have a varied bit pattern, use `CounterKey()` to make one.
+    [[nodiscard]] constexpr std::uint64_t Squares64(std::uint64_t counter, std::uint64_t key)
+    {
+        std::uint64_t x = counter * key, y = x, z = y + key;
+        x = x * x + y; x = (x >> 32) | (x << 32);
+        x = x * x + z; x = (x >> 32) | (x << 32);
+        x = x * x + y; x = (x >> 32) | (x << 32);
+        std::uint64_t t = x = x * x + z; x = (x >> 32) | (x << 32);
+        return t ^ ((x * x + y) >> 32);
+    }
+
+    // Makes a key for `Squares64()` from an arbitrary stream id.
+    [[nodiscard]] constexpr std::uint64_t CounterKey(std::uint64_t stream)
+    {
+        return SplitMix64(stream) | 1;
+    }
+
+    // A generator with no state other than a counter, where each number is a pure function of (stream, tick, index).
+    // Use it when the numbers must not depend on what else was generated before, e.g. to regenerate a single tick of a replay,
+    // or to generate things in any order (or in parallel) without sharing a generator.
+    // Satisfies the standard generator requirements, so it works with `Interface` and the standard distributions.
+    class CounterGenerator
+    {
+        std::uint64_t key = CounterKey(0);
+        std::uint64_t counter = 0; // The tick is in the high 32 bits, and the index is in the low ones.
+
+      public:
+        using result_type = std::uint64_t;
+
+        constexpr CounterGenerator() {}
+        constexpr CounterGenerator(std::uint64_t stream, std::uint32_t tick, std::uint32_t index = 0)
+            : key(CounterKey(stream)), counter(std::uint64_t(tick) << 32 | index)
+        {}
+
+        // Returns a single number, without making a generator.
+        [[nodiscard]] static constexpr result_type Value(std::uint64_t stream, std::uint32_t tick, std::uint32_t index)
+        {
+            return Squares64(std::uint64_t(tick) << 32 | index, CounterKey(stream));
+        }
+
+        [[nodiscard]] static constexpr result_type min() {return 0;}
+        [[nodiscard]] static constexpr result_type max() {return std::numeric_limits<result_type>::max();}
+
+        constexpr result_type operator()()
+        {
+            return Squares64(counter++, key);
+        }
+
+        constexpr void discard(unsigned long long count)
+        {
+            counter += count;
+        }
+
+        [[nodiscard]] friend constexpr bool operator==(const CounterGenerator &, const CounterGenerator &) = default;
+    };
 
     // Constructs an `std::seed_seq` of size `count` by repeatedly calling `func()`, which must return `uint32_t`.
     // Then uses that sequence to create a generator of type `Generator`.
@@ -329,6 +483,15 @@ namespace Random
         [[nodiscard]] friend HalfRange operator<=(SupportedScalarOrVec auto min, Interface &in) {return HalfRange(in, impl::MakeBound<T, impl::BoundType::lower>(min, false));}
 
         [[nodiscard]] SymmetricRange abs() {return {*this};}
+
+        // Fills `out` with the numbers in `min <= x <= max`.
+        void fill(std::span<T> out, SupportedScalarOrVec auto min, SupportedScalarOrVec auto max)
+        {
+            T a = impl::MakeBound<T, impl::BoundType::lower>(min, false);
+            T b = impl::MakeBound<T, impl::BoundType::upper>(max, false);
+            for (T &elem : out)
+                elem = impl::GenerateNumber(*gen, dist, a, b);
+        }
     };
 
     // Helper for generating various random things.
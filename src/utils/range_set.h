@@ -1,7 +1,11 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <initializer_list>
+#include <span>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -56,6 +60,65 @@ class RangeSet
     mutable std::vector<Range> ranges; // None of those ranges can be empty.
     mutable bool dirty = false;
 
+    // The optional bitmap index for `Contains()`, see `EnableIndex()`.
+    // The values are split into pages of `page_size`, starting from `index_base`. Each page is either empty, full, or has a bitmap.
+    static constexpr int page_bits = 12;
+    static constexpr std::size_t page_size = std::size_t(1) << page_bits, page_words = page_size / 64;
+    static constexpr std::int32_t page_empty = -1, page_full = -2;
+    // If the ranges span more pages than this, the index isn't built, and we fall back to the binary search.
+    static constexpr std::size_t max_index_pages = 1 << 16;
+    bool use_index = false;
+    mutable bool has_index = false;
+    mutable T index_base{};
+    mutable std::vector<std::int32_t> page_index; // Either `page_empty`, `page_full`, or an index into `pages`.
+    mutable std::vector<std::array<std::uint64_t, page_words>> pages;
+
+    void BuildIndex() const
+    {
+        has_index = false;
+        page_index.clear();
+        pages.clear();
+        if (ranges.empty())
+            return;
+
+        using U = std::make_unsigned_t<T>;
+        index_base = ranges.front().begin;
+        U last_offset = U(U(ranges.back().end) - U(index_base));
+        if (last_offset / page_size >= max_index_pages)
+            return;
+
+        page_index.resize(std::size_t(last_offset / page_size) + 1, page_empty);
+        for (const Range &range : ranges)
+        {
+            std::size_t first = std::size_t(U(U(range.begin) - U(index_base)));
+            std::size_t last = std::size_t(U(U(range.end) - U(index_base)));
+            while (first <= last)
+            {
+                std::size_t page = first / page_size;
+                std::size_t page_last = std::min(last, page * page_size + page_size - 1);
+
+                if (first % page_size == 0 && page_last % page_size == page_size - 1)
+                {
+                    page_index[page] = page_full;
+                }
+                else
+                {
+                    if (page_index[page] < 0)
+                    {
+                        page_index[page] = std::int32_t(pages.size());
+                        pages.emplace_back();
+                    }
+                    auto &bits = pages[std::size_t(page_index[page])];
+                    for (std::size_t i = first % page_size; i <= page_last % page_size; i++)
+                        bits[i / 64] |= std::uint64_t(1) << (i % 64);
+                }
+
+                first = page_last + 1;
+            }
+        }
+        has_index = true;
+    }
+
     struct IteratorState
     {
         // We use raw pointers instead of `std::vector<Range>::const_iterator`, because libstdc++ with _GLIBCXX_DEBUG complains when you try to `==`-compare two null iterators.
@@ -108,7 +171,7 @@ class RangeSet
     RangeSet() {}
 
     RangeSet(const Range &range) {Add(range);}
-    RangeSet(std::vector<Range> ranges) : ranges(std::move(ranges)) {}
+    RangeSet(std::vector<Range> ranges) : ranges(std::move(ranges)), dirty(true) {}
 
     RangeSet &Add(Range range)
     {
@@ -120,13 +183,50 @@ class RangeSet
         return *this;
     }
 
+    // Adds many ranges at once, in any order. They are sorted and merged once, on the next access.
+    RangeSet &AddRanges(std::span<const Range> new_ranges)
+    {
+        ranges.reserve(ranges.size() + new_ranges.size());
+        for (const Range &range : new_ranges)
+        {
+            if (range)
+                ranges.push_back(range);
+        }
+        dirty = true;
+        return *this;
+    }
+
     // Sort ranges and merge overlapping ones.
     // Normally you don't need to call this function, this is done automatically.
     const RangeSet &Normalize() const
     {
-        if (!dirty || ranges.empty()) // The code below assumes `ranges.size() > 0`.
+        if (!dirty)
             return *this;
+        dirty = false;
+
+        if (!ranges.empty()) // The code below assumes `ranges.size() > 0`.
+            Merge();
+        if (use_index)
+            BuildIndex();
+        return *this;
+    }
+
+    // Makes `Contains()` O(1), using a two-level bitmap that's rebuilt lazily after the set changes.
+    // Good for the sets that are queried often and rarely changed. Does nothing if the values are spread over a too large range.
+    RangeSet &EnableIndex()
+    {
+        if (!use_index)
+        {
+            use_index = true;
+            dirty = true;
+        }
+        return *this;
+    }
 
+  private:
+    // Sorts the ranges and merges the overlapping ones. The ranges must not be empty.
+    void Merge() const
+    {
         // Sort ranges by `begin`.
         std::sort(ranges.begin(), ranges.end(), [](const Range &a, const Range &b)
         {
@@ -150,8 +250,101 @@ class RangeSet
             }
         }
         ranges.resize(new_size);
+    }
 
-        return *this;
+    // Returns true if `b` starts right after `a`, or overlaps it. `a` must start before or at the same time as `b`.
+    [[nodiscard]] static bool RangesTouch(const Range &a, const Range &b)
+    {
+        return a.end >= b.begin || a.end + 1 == b.begin; // Checking `>=` first avoids overflow in `+ 1`.
+    }
+
+    // Makes a set from the ranges that are already sorted and merged.
+    [[nodiscard]] static RangeSet FromNormalized(std::vector<Range> normalized_ranges)
+    {
+        RangeSet ret;
+        ret.ranges = std::move(normalized_ranges);
+        return ret;
+    }
+
+  public:
+    // The set operations run in linear time, by walking both sorted lists of ranges at once.
+    // The result doesn't inherit `EnableIndex()`.
+
+    [[nodiscard]] RangeSet Union(const RangeSet &other) const
+    {
+        const std::vector<Range> &a = Ranges(), &b = other.Ranges();
+        std::vector<Range> ret;
+        ret.reserve(a.size() + b.size());
+
+        std::size_t i = 0, j = 0;
+        while (i < a.size() || j < b.size())
+        {
+            const Range &next = j >= b.size() || (i < a.size() && a[i].begin <= b[j].begin) ? a[i++] : b[j++];
+            if (!ret.empty() && RangesTouch(ret.back(), next))
+            {
+                if (ret.back().end < next.end)
+                    ret.back().end = next.end;
+            }
+            else
+            {
+                ret.push_back(next);
+            }
+        }
+        return FromNormalized(std::move(ret));
+    }
+
+    [[nodiscard]] RangeSet Intersect(const RangeSet &other) const
+    {
+        const std::vector<Range> &a = Ranges(), &b = other.Ranges();
+        std::vector<Range> ret;
+
+        std::size_t i = 0, j = 0;
+        while (i < a.size() && j < b.size())
+        {
+            Range overlap = Range::Inclusive(std::max(a[i].begin, b[j].begin), std::min(a[i].end, b[j].end));
+            if (overlap)
+                ret.push_back(overlap);
+            // Advance the range that ends first, it can't overlap anything else.
+            if (a[i].end < b[j].end)
+                i++;
+            else
+                j++;
+        }
+        return FromNormalized(std::move(ret));
+    }
+
+    // Returns the elements of this set that aren't in `other`.
+    [[nodiscard]] RangeSet Subtract(const RangeSet &other) const
+    {
+        const std::vector<Range> &a = Ranges(), &b = other.Ranges();
+        std::vector<Range> ret;
+        ret.reserve(a.size());
+
+        std::size_t j = 0;
+        for (Range range : a)
+        {
+            // Skip the ranges of `other` that end before this one.
+            while (j < b.size() && b[j].end < range.begin)
+                j++;
+
+            // Cut out the ranges of `other` that overlap this one.
+            bool finished = false;
+            for (std::size_t k = j; k < b.size() && b[k].begin <= range.end; k++)
+            {
+                if (b[k].begin > range.begin)
+                    ret.push_back(Range::Inclusive(range.begin, b[k].begin - 1));
+                if (b[k].end >= range.end)
+                {
+                    finished = true;
+                    break;
+                }
+                range.begin = b[k].end + 1;
+                j = k + 1;
+            }
+            if (!finished)
+                ret.push_back(range);
+        }
+        return FromNormalized(std::move(ret));
     }
 
     [[nodiscard]] auto begin() const
@@ -175,6 +368,21 @@ class RangeSet
     [[nodiscard]] bool Contains(T value) const
     {
         Normalize();
+
+        if (has_index)
+        {
+            using U = std::make_unsigned_t<T>;
+            if (value < index_base)
+                return false;
+            std::size_t offset = std::size_t(U(U(value) - U(index_base)));
+            if (offset / page_size >= page_index.size())
+                return false;
+            std::int32_t page = page_index[offset / page_size];
+            if (page < 0)
+                return page == page_full;
+            return pages[std::size_t(page)][offset % page_size / 64] >> (offset % 64) & 1;
+        }
+
         auto range_iter = std::lower_bound(ranges.begin(), ranges.end(), value, [](const Range &range, T value){return range.end < value;});
         return range_iter != ranges.end() && range_iter->Contains(value);
     }
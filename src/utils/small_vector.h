@@ -0,0 +1,288 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "program/errors.h"
+
+// A vector that stores up to `N` elements inline, and only allocates on the heap when it grows larger than that.
+// Good for the short lists that are created or copied often, since those never touch the heap.
+// The API mimics `std::vector` (the most common parts of it), so the reflection treats it as a container automatically.
+// Unlike `std::vector`, moving a small vector moves the individual elements, and invalidates the iterators.
+template <typename T, std::size_t N>
+class SmallVector
+{
+    static_assert(N > 0, "The inline capacity must be positive.");
+
+  public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference = T &;
+    using const_reference = const T &;
+    using pointer = T *;
+    using const_pointer = const T *;
+    using iterator = T *;
+    using const_iterator = const T *;
+
+  private:
+    T *ptr = reinterpret_cast<T *>(storage); // Points either to `storage` or to the heap.
+    std::size_t count = 0;
+    std::size_t cap = N;
+    alignas(T) unsigned char storage[sizeof(T) * N];
+
+    [[nodiscard]] bool IsInline() const
+    {
+        return ptr == reinterpret_cast<const T *>(storage);
+    }
+
+    // Moves the elements to a new heap buffer of the specified capacity, which must fit them.
+    void Reallocate(std::size_t new_cap)
+    {
+        T *new_ptr = std::allocator<T>{}.allocate(new_cap);
+        if constexpr (std::is_nothrow_move_constructible_v<T> || !std::is_copy_constructible_v<T>)
+        {
+            std::uninitialized_move(ptr, ptr + count, new_ptr);
+        }
+        else
+        {
+            try
+            {
+                std::uninitialized_copy(ptr, ptr + count, new_ptr);
+            }
+            catch (...)
+            {
+                std::allocator<T>{}.deallocate(new_ptr, new_cap);
+                throw;
+            }
+        }
+        std::destroy(ptr, ptr + count);
+        FreeHeap();
+        ptr = new_ptr;
+        cap = new_cap;
+    }
+
+    void FreeHeap() noexcept
+    {
+        if (!IsInline())
+            std::allocator<T>{}.deallocate(ptr, cap);
+    }
+
+    // Makes room for one more element.
+    void GrowIfFull()
+    {
+        if (count == cap)
+            Reallocate(cap * 2);
+    }
+
+  public:
+    SmallVector() {}
+
+    SmallVector(std::initializer_list<T> list)
+    {
+        assign(list.begin(), list.end());
+    }
+
+    explicit SmallVector(std::size_t new_size)
+    {
+        resize(new_size);
+    }
+
+    SmallVector(std::size_t new_size, const T &value)
+    {
+        resize(new_size, value);
+    }
+
+    template <std::input_iterator I>
+    SmallVector(I first, I last)
+    {
+        assign(first, last);
+    }
+
+    SmallVector(const SmallVector &other)
+    {
+        assign(other.begin(), other.end());
+    }
+
+    SmallVector(SmallVector &&other) noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+        *this = std::move(other);
+    }
+
+    SmallVector &operator=(const SmallVector &other)
+    {
+        if (this != &other)
+            assign(other.begin(), other.end());
+        return *this;
+    }
+
+    SmallVector &operator=(SmallVector &&other) noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+        if (this == &other)
+            return *this;
+
+        clear();
+        if (!other.IsInline())
+        {
+            // Steal the heap buffer.
+            FreeHeap();
+            ptr = std::exchange(other.ptr, reinterpret_cast<T *>(other.storage));
+            count = std::exchange(other.count, 0);
+            cap = std::exchange(other.cap, N);
+        }
+        else
+        {
+            // Move the inline elements. They always fit.
+            std::uninitialized_move(other.ptr, other.ptr + other.count, ptr);
+            count = other.count;
+            other.clear();
+        }
+        return *this;
+    }
+
+    ~SmallVector()
+    {
+        std::destroy(ptr, ptr + count);
+        FreeHeap();
+    }
+
+    template <std::input_iterator I>
+    void assign(I first, I last)
+    {
+        clear();
+        if constexpr (std::forward_iterator<I>)
+            reserve(std::size_t(std::distance(first, last)));
+        for (; first != last; ++first)
+            emplace_back(*first);
+    }
+
+    [[nodiscard]] iterator begin() {return ptr;}
+    [[nodiscard]] iterator end() {return ptr + count;}
+    [[nodiscard]] const_iterator begin() const {return ptr;}
+    [[nodiscard]] const_iterator end() const {return ptr + count;}
+    [[nodiscard]] const_iterator cbegin() const {return begin();}
+    [[nodiscard]] const_iterator cend() const {return end();}
+
+    [[nodiscard]] T *data() {return ptr;}
+    [[nodiscard]] const T *data() const {return ptr;}
+
+    [[nodiscard]] bool empty() const {return count == 0;}
+    [[nodiscard]] std::size_t size() const {return count;}
+    [[nodiscard]] std::size_t capacity() const {return cap;}
+    [[nodiscard]] static constexpr std::size_t inline_capacity() {return N;}
+
+    [[nodiscard]] T &operator[](std::size_t i)
+    {
+        ASSERT(i < count, "Small vector index is out of range.");
+        return ptr[i];
+    }
+    [[nodiscard]] const T &operator[](std::size_t i) const
+    {
+        ASSERT(i < count, "Small vector index is out of range.");
+        return ptr[i];
+    }
+
+    [[nodiscard]] T &at(std::size_t i)
+    {
+        if (i >= count)
+            throw std::out_of_range("Small vector index is out of range.");
+        return ptr[i];
+    }
+    [[nodiscard]] const T &at(std::size_t i) const
+    {
+        return const_cast<SmallVector &>(*this).at(i);
+    }
+
+    [[nodiscard]] T &front() {return (*this)[0];}
+    [[nodiscard]] const T &front() const {return (*this)[0];}
+    [[nodiscard]] T &back() {return (*this)[count - 1];}
+    [[nodiscard]] const T &back() const {return (*this)[count - 1];}
+
+    void reserve(std::size_t new_cap)
+    {
+        if (new_cap > cap)
+            Reallocate(std::max(new_cap, cap * 2));
+    }
+
+    template <typename ...P>
+    T &emplace_back(P &&... params)
+    {
+        if (count == cap)
+        {
+            // Construct the element first, in case the arguments refer to our own elements.
+            T elem(std::forward<P>(params)...);
+            GrowIfFull();
+            std::construct_at(ptr + count, std::move(elem));
+        }
+        else
+        {
+            std::construct_at(ptr + count, std::forward<P>(params)...);
+        }
+        return ptr[count++];
+    }
+
+    void push_back(const T &value)
+    {
+        emplace_back(value);
+    }
+    void push_back(T &&value)
+    {
+        emplace_back(std::move(value));
+    }
+
+    void pop_back()
+    {
+        ASSERT(count > 0, "Attempt to pop from an empty small vector.");
+        std::destroy_at(ptr + --count);
+    }
+
+    // Destroys the elements, but keeps the capacity.
+    void clear() noexcept
+    {
+        std::destroy(ptr, ptr + count);
+        count = 0;
+    }
+
+    void resize(std::size_t new_size)
+    {
+        reserve(new_size);
+        while (count < new_size)
+            emplace_back();
+        while (count > new_size)
+            pop_back();
+    }
+    void resize(std::size_t new_size, const T &value)
+    {
+        reserve(new_size);
+        while (count < new_size)
+            emplace_back(value);
+        while (count > new_size)
+            pop_back();
+    }
+
+    // Returns the iterator to the element after the erased ones.
+    iterator erase(const_iterator first, const_iterator last)
+    {
+        T *dst = ptr + (first - ptr);
+        T *new_end = std::move(const_cast<T *>(last), end(), dst);
+        std::destroy(new_end, end());
+        count = std::size_t(new_end - ptr);
+        return dst;
+    }
+    iterator erase(const_iterator it)
+    {
+        return erase(it, it + 1);
+    }
+
+    [[nodiscard]] friend bool operator==(const SmallVector &a, const SmallVector &b)
+    {
+        return std::equal(a.begin(), a.end(), b.begin(), b.end());
+    }
+};
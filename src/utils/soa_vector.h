@@ -0,0 +1,244 @@
+#pragma once
+
+#include <cstddef>
+#include <span>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "meta/common.h"
+#include "meta/string_template_params.h"
+#include "program/errors.h"
+#include "reflection/structs.h"
+#include "utils/alignment.h"
+
+// A vector of a reflected struct, in the struct-of-arrays form: each member is stored in its own array.
+// The loops that only touch a few members then read less memory, and can be vectorized.
+// The members come from `Refl::Class`, so the struct must be reflected, and can't have bases (their members wouldn't be stored).
+// Usage:
+//     SoAVector<Particle::State> v;
+//     v.push_back(state);
+//     for (fvec2 &pos : v.Span<"pos">()) ...
+//     Particle::State copy = v[i]; // Or `v.Get(i)`.
+//     v[i] = copy;
+//     v.Member<"pos">(i) = fvec2(1);
+// The arrays are aligned to `Alignment` bytes, or more if a member needs it.
+template <typename T, std::size_t Alignment = 32>
+class SoAVector
+{
+    static_assert(Refl::Class::members_known<T>, "The struct must be reflected.");
+    static_assert(Meta::list_size<Refl::Class::regular_bases<T>> == 0 && Meta::list_size<Refl::Class::direct_virtual_bases<T>> == 0, "Structs with bases are not supported.");
+
+  public:
+    static constexpr std::size_t member_count = Refl::Class::member_count<T>;
+
+    template <std::size_t I>
+    using member_type = Refl::Class::member_type<T, I>;
+
+    static_assert(Meta::cexpr_all<member_count>([](auto index){return !std::is_same_v<member_type<index.value>, bool>;}), "`bool` members are not supported, since `std::vector<bool>` is packed.");
+
+    // Returns the index of the member with this name. Causes a compilation error if there's no such member.
+    template <Meta::ConstString Name>
+    [[nodiscard]] static consteval std::size_t MemberIndex()
+    {
+        static_assert(Refl::Class::member_names_known<T>, "The member names of this struct are not known.");
+        std::size_t ret = 0;
+        while (ret < member_count && std::string_view(Refl::Class::MemberName<T>(ret)) != std::string_view(Name.str, Name.size))
+            ret++;
+        if (ret == member_count)
+            throw "No member with this name."; // Not a constant expression, so this is a compilation error.
+        return ret;
+    }
+
+  private:
+    template <std::size_t I>
+    using array_type = std::vector<member_type<I>, ::Storage::AlignedAllocator<member_type<I>, Alignment>>;
+
+    template <typename Seq> struct Storage {};
+    template <std::size_t ...I> struct Storage<std::index_sequence<I...>> {using type = std::tuple<array_type<I>...>;};
+    typename Storage<std::make_index_sequence<member_count>>::type arrays;
+
+    std::size_t count = 0;
+
+    // Calls `func(array, member_index)` for each array.
+    template <typename F>
+    void ForEachArray(F &&func)
+    {
+        Meta::cexpr_for<member_count>([&](auto index)
+        {
+            func(std::get<index.value>(arrays), index);
+        });
+    }
+    template <typename F>
+    void ForEachArray(F &&func) const
+    {
+        Meta::cexpr_for<member_count>([&](auto index)
+        {
+            func(std::get<index.value>(arrays), index);
+        });
+    }
+
+  public:
+    // A proxy for the element, returned by `operator[]`. Converts to `T` and can be assigned from it.
+    template <bool IsConst>
+    class BasicReference
+    {
+        friend SoAVector;
+        std::conditional_t<IsConst, const SoAVector, SoAVector> *target = nullptr;
+        std::size_t index = 0;
+
+        BasicReference(decltype(target) target, std::size_t index) : target(target), index(index) {}
+
+      public:
+        [[nodiscard]] operator T() const
+        {
+            return target->Get(index);
+        }
+
+        const BasicReference &operator=(const T &value) const requires(!IsConst)
+        {
+            target->Set(index, value);
+            return *this;
+        }
+        const BasicReference &operator=(const BasicReference &other) const requires(!IsConst)
+        {
+            target->Set(index, other);
+            return *this;
+        }
+
+        template <std::size_t I>
+        [[nodiscard]] auto &Member() const
+        {
+            return target->template Member<I>(index);
+        }
+        template <Meta::ConstString Name>
+        [[nodiscard]] auto &Member() const
+        {
+            return target->template Member<Name>(index);
+        }
+    };
+    using Reference = BasicReference<false>;
+    using ConstReference = BasicReference<true>;
+
+    SoAVector() {}
+
+    [[nodiscard]] std::size_t size() const {return count;}
+    [[nodiscard]] bool empty() const {return count == 0;}
+
+    void reserve(std::size_t n)
+    {
+        ForEachArray([&](auto &array, auto){array.reserve(n);});
+    }
+
+    // The new elements are value-initialized, member by member.
+    void resize(std::size_t n)
+    {
+        ForEachArray([&](auto &array, auto){array.resize(n);});
+        count = n;
+    }
+
+    void clear()
+    {
+        ForEachArray([&](auto &array, auto){array.clear();});
+        count = 0;
+    }
+
+    void push_back(const T &value)
+    {
+        ForEachArray([&](auto &array, auto index){array.push_back(Refl::Class::Member<index.value>(value));});
+        count++;
+    }
+
+    void pop_back()
+    {
+        ASSERT(count > 0, "Popping from an empty `SoAVector`.");
+        ForEachArray([&](auto &array, auto){array.pop_back();});
+        count--;
+    }
+
+    // Removes an element by moving the last one in its place. Doesn't preserve the order, but is O(1).
+    void RemoveUnordered(std::size_t i)
+    {
+        ASSERT(i < count, "`SoAVector` index is out of range.");
+        ForEachArray([&](auto &array, auto)
+        {
+            if (i != count - 1)
+                array[i] = std::move(array.back());
+            array.pop_back();
+        });
+        count--;
+    }
+
+    // Gathers the members of an element.
+    [[nodiscard]] T Get(std::size_t i) const
+    {
+        ASSERT(i < count, "`SoAVector` index is out of range.");
+        T ret{};
+        ForEachArray([&](const auto &array, auto index){Refl::Class::Member<index.value>(ret) = array[i];});
+        return ret;
+    }
+
+    // Scatters the members of an element.
+    void Set(std::size_t i, const T &value)
+    {
+        ASSERT(i < count, "`SoAVector` index is out of range.");
+        ForEachArray([&](auto &array, auto index){array[i] = Refl::Class::Member<index.value>(value);});
+    }
+
+    [[nodiscard]] Reference operator[](std::size_t i)
+    {
+        return Reference(this, i);
+    }
+    [[nodiscard]] ConstReference operator[](std::size_t i) const
+    {
+        return ConstReference(this, i);
+    }
+
+    // One member of an element.
+    template <std::size_t I>
+    [[nodiscard]] member_type<I> &Member(std::size_t i)
+    {
+        ASSERT(i < count, "`SoAVector` index is out of range.");
+        return std::get<I>(arrays)[i];
+    }
+    template <std::size_t I>
+    [[nodiscard]] const member_type<I> &Member(std::size_t i) const
+    {
+        ASSERT(i < count, "`SoAVector` index is out of range.");
+        return std::get<I>(arrays)[i];
+    }
+    template <Meta::ConstString Name>
+    [[nodiscard]] auto &Member(std::size_t i)
+    {
+        return Member<MemberIndex<Name>()>(i);
+    }
+    template <Meta::ConstString Name>
+    [[nodiscard]] auto &Member(std::size_t i) const
+    {
+        return Member<MemberIndex<Name>()>(i);
+    }
+
+    // The array of one member, for all elements.
+    template <std::size_t I>
+    [[nodiscard]] std::span<member_type<I>> Span()
+    {
+        return {std::get<I>(arrays).data(), count};
+    }
+    template <std::size_t I>
+    [[nodiscard]] std::span<const member_type<I>> Span() const
+    {
+        return {std::get<I>(arrays).data(), count};
+    }
+    template <Meta::ConstString Name>
+    [[nodiscard]] auto Span()
+    {
+        return Span<MemberIndex<Name>()>();
+    }
+    template <Meta::ConstString Name>
+    [[nodiscard]] auto Span() const
+    {
+        return Span<MemberIndex<Name>()>();
+    }
+};
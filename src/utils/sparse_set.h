@@ -1,8 +1,11 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
-#include <numeric>
+#include <limits>
 #include <ostream>
+#include <span>
+#include <stdexcept>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -15,7 +18,9 @@
 // The capacity can only be increased manually, and can never be decreased (without losing all elements).
 // Like a vector, provides O(1) insertion and element access, O(n) erase (or O(1) if you don't care about preserving order).
 // Also lets you find element indices in O(1), or check if they are present or not.
-// Under the hood, uses two vectors of the specified capacity.
+// Under the hood, uses a dense vector of the elements that were ever inserted, and a sparse index split into pages that are allocated on demand,
+// so the memory usage depends on the elements that were actually used, rather than on the capacity.
+// Iterating over the set visits the existing elements, which are stored contiguously.
 template <typename T = int>
 class SparseSet
 {
@@ -24,13 +29,52 @@ class SparseSet
     using elem_t = T;
 
   private:
+    static constexpr std::size_t page_size = 4096;
+    // Marks the elements that were never inserted in `pages`.
+    static constexpr elem_t untouched = std::numeric_limits<elem_t>::max();
+
     Meta::ResetIfMovedFrom<elem_t> pos = 0;
+    Meta::ResetIfMovedFrom<elem_t> capacity = 0;
+    // All elements less than this were inserted at some point, so they are in `values`.
+    Meta::ResetIfMovedFrom<elem_t> next_untouched = 0;
+
+    // Contains unique elements, each of which was inserted at some point.
+    // `values` is always ordered so that the existing elements come first, followed by the erased ones.
+    // At any point, `values[index(x)] == x` for every `x` in `values`, and `index(x) == untouched` for the rest.
+    std::vector<elem_t> values;
+    // The sparse index. Each page is either empty, meaning that all its elements are untouched, or has `page_size` elements.
+    std::vector<std::vector<elem_t>> pages;
 
-    // Those vectors have the same size.
-    // Both contain unique sequental integers starting from 0.
-    // At any point, `values[indices[x]] == x`, and vice versa.
-    // `values` is always ordered so that the existing elements come first.
-    std::vector<elem_t> values, indices;
+    [[nodiscard]] elem_t GetIndex(elem_t elem) const
+    {
+        const std::vector<elem_t> &page = pages[std::size_t(elem) / page_size];
+        return page.empty() ? untouched : page[std::size_t(elem) % page_size];
+    }
+    void SetIndex(elem_t elem, elem_t index)
+    {
+        std::vector<elem_t> &page = pages[std::size_t(elem) / page_size];
+        if (page.empty())
+            page.resize(page_size, untouched);
+        page[std::size_t(elem) % page_size] = index;
+    }
+
+    // Adds an untouched element to the end of `values`.
+    void Touch(elem_t elem)
+    {
+        values.push_back(elem);
+        FINALLY_ON_THROW( values.pop_back(); )
+        SetIndex(elem, elem_t(values.size() - 1));
+    }
+
+    // Swaps two elements in `values`, and updates the index.
+    void SwapValues(elem_t index_a, elem_t index_b)
+    {
+        elem_t value_a = values[index_a];
+        elem_t value_b = values[index_b];
+        std::swap(values[index_a], values[index_b]);
+        SetIndex(value_a, index_b);
+        SetIndex(value_b, index_a);
+    }
 
   public:
     constexpr SparseSet() {}
@@ -43,7 +87,7 @@ class SparseSet
     // The maximum number of elements.
     [[nodiscard]] elem_t Capacity() const
     {
-        return values.size();
+        return capacity.value;
     }
     // The current number of elements.
     [[nodiscard]] elem_t ElemCount() const
@@ -62,22 +106,15 @@ class SparseSet
     }
 
     // Increase the capacity up to the specified value. Can't decrease capacity.
+    // This is cheap, since the memory is only allocated when the elements are inserted.
     void Reserve(elem_t new_capacity)
     {
         if (new_capacity <= Capacity())
             return;
 
-        std::size_t old_capacity = Capacity();
-
-        values.resize(new_capacity);
-        FINALLY_ON_THROW( values.resize(old_capacity); )
-
-        indices.resize(new_capacity);
-        // Not needed since nothing throws below this point.
-        // FINALLY_ON_THROW( indices.resize(old_capacity); )
-
-        std::iota(values.begin() + old_capacity, values.end(), old_capacity);
-        std::iota(indices.begin() + old_capacity, indices.end(), old_capacity);
+        ASSERT(new_capacity != untouched, "The `SparseSet` capacity is too large.");
+        pages.resize((std::size_t(new_capacity) + page_size - 1) / page_size);
+        capacity.value = new_capacity;
     }
 
     // Returns true if the element exists in the set.
@@ -86,33 +123,43 @@ class SparseSet
     {
         if (elem < 0 || elem >= Capacity())
             return false;
-        return indices[elem] < ElemCount();
+        elem_t index = GetIndex(elem);
+        return index != untouched && index < ElemCount();
     }
 
     // Adds a new element to the set, a one that wasn't there before.
+    // Prefers reusing the erased elements, otherwise returns the smallest element that was never inserted.
     // Throws if no free capacity.
     [[nodiscard]] elem_t InsertAny()
     {
         if (IsFull())
             throw std::runtime_error("Attempt to insert into a full `SparseSet`.");
 
+        if (std::size_t(ElemCount()) == values.size())
+        {
+            // Since the set isn't full, there's an untouched element below the capacity.
+            while (GetIndex(next_untouched.value) != untouched)
+                next_untouched.value++;
+            Touch(next_untouched.value++);
+        }
+
         return values[pos.value++];
     }
 
     // Adds a new element to the set, returns true on success.
     // Returns false if the element was already present.
+    // Throws if the element is out of range.
     bool Insert(elem_t elem)
     {
+        if (elem < 0 || elem >= Capacity())
+            Program::Error("Out of range elem for an `SparseSet` insertion.");
         if (Contains(elem))
             return false;
 
-        elem_t last_index = pos.value++;
-        elem_t this_index = indices[elem];
-        elem_t last_value = values[last_index];
-        elem_t this_value = elem;
+        if (GetIndex(elem) == untouched)
+            Touch(elem);
 
-        std::swap(values[this_index], values[last_index]);
-        std::swap(indices[this_value], indices[last_value]);
+        SwapValues(GetIndex(elem), pos.value++);
         return true;
     }
 
@@ -124,13 +171,7 @@ class SparseSet
         if (!Contains(elem))
             return false;
 
-        elem_t last_index = --pos.value;
-        elem_t this_index = indices[elem];
-        elem_t last_value = values[last_index];
-        elem_t this_value = elem;
-
-        std::swap(values[this_index], values[last_index]);
-        std::swap(indices[this_value], indices[last_value]);
+        SwapValues(GetIndex(elem), --pos.value);
         return true;
     }
 
@@ -143,13 +184,13 @@ class SparseSet
             return false;
 
         // Move elements.
-        elem_t index = GetElemIndex(elem);
+        elem_t index = GetIndex(elem);
         std::rotate(values.begin() + index, values.begin() + index + 1, values.begin() + ElemCount());
 
         // Fix indices.
         // Note that we loop over the last element too.
         for (elem_t i = index; i < ElemCount(); i++)
-            indices[values[i]] = i;
+            SetIndex(values[i], i);
 
         // Decrement size.
         pos.value--;
@@ -163,11 +204,11 @@ class SparseSet
     }
 
     // Returns i-th element.
-    // If `index >= ElemCount()`, starts returning all missing elements.
-    // If `index >= Capacity()` or is negative, throws.
+    // If `index >= ElemCount()`, starts returning the erased elements.
+    // If `index` is negative or not less than the number of elements that were ever inserted, throws.
     [[nodiscard]] elem_t GetElem(elem_t index) const
     {
-        if (index < 0 || index >= Capacity())
+        if (index < 0 || std::size_t(index) >= values.size())
             Program::Error("Out of range index for an `SparseSet` element.");
         return values[index];
     }
@@ -179,7 +220,33 @@ class SparseSet
     {
         if (elem < 0 || elem >= Capacity())
             Program::Error("Out of range elem for an `SparseSet` index search.");
-        return indices[elem];
+        elem_t index = GetIndex(elem);
+        return index == untouched ? Capacity() : index;
+    }
+
+    // Iterates over the existing elements, in the same order as `GetElem()`.
+    // Erasing the elements invalidates the iterators, and inserting them invalidates them if the set never had that many elements before.
+    [[nodiscard]] const elem_t *begin() const
+    {
+        return values.data();
+    }
+    [[nodiscard]] const elem_t *end() const
+    {
+        return values.data() + ElemCount();
+    }
+    // The existing elements, as a contiguous array.
+    [[nodiscard]] std::span<const elem_t> Elems() const
+    {
+        return {begin(), end()};
+    }
+
+    // For `Refl::EstimateMemory()`.
+    [[nodiscard]] std::size_t EstimateOwnedMemory() const
+    {
+        std::size_t ret = values.capacity() * sizeof(elem_t) + pages.capacity() * sizeof(std::vector<elem_t>);
+        for (const std::vector<elem_t> &page : pages)
+            ret += page.capacity() * sizeof(elem_t);
+        return ret;
     }
 
     // Prints the set and asserts consistency.
@@ -197,9 +264,9 @@ class SparseSet
 
         // Assert consistency.
         ASSERT([&]{
-            for (elem_t i = 0; i < Capacity(); i++)
+            for (std::size_t i = 0; i < values.size(); i++)
             {
-                if (GetElem(GetElemIndex(i)) != i)
+                if (std::size_t(GetElemIndex(values[i])) != i)
                     return false;
             }
             return true;
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "program/errors.h"
+#include "utils/flat_hash.h"
+#include "utils/mat.h"
+
+// A uniform grid of square cells, for finding the boxes near a point without checking every box.
+// Only the non-empty cells are stored, in a hash map, so the grid is unbounded.
+// Meant to be rebuilt often, e.g. every tick. `Clear()` keeps the memory.
+// Usage:
+//     grid.Clear();
+//     grid.Insert(a, b, value); // For each box.
+//     grid.Finalize();
+//     grid.Query(a, b, [](const T &value){...}); // Any number of times.
+// The boxes are half-open, `b` is exclusive. A box larger than the cell is stored in every cell it touches, but is reported only once per query.
+template <typename T>
+class SpatialHash
+{
+    struct Item
+    {
+        ivec2 a, b;
+        T value;
+    };
+    std::vector<Item> items;
+
+    // A range of `cell_items`.
+    struct CellRange
+    {
+        std::uint32_t begin = 0, end = 0;
+    };
+    FlatMap<ivec2, CellRange> cells;
+    // The indices into `items`, grouped by cell.
+    std::vector<std::uint32_t> cell_items;
+
+    int cell_size = 1;
+    bool finalized = true;
+
+    [[nodiscard]] ivec2 CellOf(ivec2 pos) const
+    {
+        return div_ex(pos, cell_size);
+    }
+
+    // Calls `func(ivec2 cell)` for each cell touched by a box.
+    template <typename F>
+    void ForEachCell(ivec2 a, ivec2 b, F &&func) const
+    {
+        ivec2 cell_a = CellOf(a), cell_b = CellOf(b - 1);
+        for (ivec2 cell : cell_a <= vector_range <= cell_b)
+            func(cell);
+    }
+
+  public:
+    constexpr SpatialHash() {}
+    SpatialHash(int cell_size) : cell_size(cell_size)
+    {
+        ASSERT(cell_size > 0, "Invalid spatial hash cell size.");
+    }
+
+    [[nodiscard]] int CellSize() const
+    {
+        return cell_size;
+    }
+
+    [[nodiscard]] std::size_t Size() const
+    {
+        return items.size();
+    }
+
+    // Removes all boxes, but keeps the memory.
+    void Clear()
+    {
+        items.clear();
+        cells.clear();
+        cell_items.clear();
+        finalized = true;
+    }
+
+    // Adds a box. Call `Finalize()` before querying.
+    void Insert(ivec2 a, ivec2 b, T value)
+    {
+        ASSERT((a < b).all(), "Attempt to insert an empty box into a spatial hash.");
+        items.push_back({.a = a, .b = b, .value = std::move(value)});
+        finalized = false;
+    }
+
+    // Sorts the inserted boxes into cells. First counts the boxes per cell, then places them into their ranges.
+    void Finalize()
+    {
+        if (finalized)
+            return;
+        finalized = true;
+
+        cells.clear();
+        for (const Item &item : items)
+            ForEachCell(item.a, item.b, [&](ivec2 cell){cells[cell].end++;});
+
+        std::uint32_t offset = 0;
+        for (auto &[cell, range] : cells)
+        {
+            range.begin = offset;
+            offset += range.end;
+            range.end = range.begin;
+        }
+
+        cell_items.resize(offset);
+        for (std::uint32_t i = 0; i < items.size(); i++)
+            ForEachCell(items[i].a, items[i].b, [&](ivec2 cell){cell_items[cells.find(cell)->second.end++] = i;});
+    }
+
+    // Calls `func(const T &value)` for each box overlapping the box `a`..`b`, exactly once. The order is unspecified.
+    template <typename F>
+    void Query(ivec2 a, ivec2 b, F &&func) const
+    {
+        ASSERT(finalized, "Attempt to query a spatial hash that wasn't finalized.");
+        if (items.empty() || !(a < b).all())
+            return;
+
+        ForEachCell(a, b, [&](ivec2 cell)
+        {
+            auto it = cells.find(cell);
+            if (it == cells.end())
+                return;
+            for (std::uint32_t i = it->second.begin; i < it->second.end; i++)
+            {
+                const Item &item = items[cell_items[i]];
+                if (!(item.a < b).all() || !(a < item.b).all())
+                    continue;
+                // A box can be in several cells. Only report it from the cell containing the min corner of the overlap.
+                if (CellOf(max(item.a, a)) != cell)
+                    continue;
+                func(std::as_const(item.value));
+            }
+        });
+    }
+};
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <bit>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ranges>
+#include <type_traits>
+
+#include "meta/common.h"
+#include "reflection/structs.h"
+#include "utils/hash.h"
+#include "utils/mat.h"
+
+// Hashes the values of objects, to detect when two simulations diverge (e.g. when checking replays).
+// Unlike `Hash::Bytes()`, this doesn't depend on the byte order, the pointer size, or the padding, so the result can be saved to files.
+// Supports scalars (floats are hashed by their bits, so `-0` and `0` differ), enums, vectors, `std::optional`, ranges, and the reflected structs (member by member).
+// Usage:
+//     StateHash h;
+//     h(player, time, map.overlay_hash);
+//     std::uint32_t result = h.Value32();
+class StateHash
+{
+    std::uint64_t state = 0;
+
+    void AddWord(std::uint64_t value)
+    {
+        // The wyhash mixing step, same as in `Hash::Bytes()`.
+        state = Hash::impl::Mix(state ^ Hash::impl::secret[0], value ^ Hash::impl::secret[1]);
+    }
+
+  public:
+    constexpr StateHash() {}
+    constexpr explicit StateHash(std::uint64_t seed) : state(seed) {}
+
+    template <typename T>
+    void Add(const T &value)
+    {
+        if constexpr (std::is_same_v<T, bool>)
+            AddWord(value);
+        else if constexpr (std::is_enum_v<T>)
+            AddWord(std::uint64_t(std::underlying_type_t<T>(value)));
+        else if constexpr (std::integral<T>)
+            AddWord(std::uint64_t(value)); // Sign-extends, so it doesn't matter what type was used to store the value.
+        else if constexpr (std::is_same_v<T, float>)
+            AddWord(std::bit_cast<std::uint32_t>(value));
+        else if constexpr (std::is_same_v<T, double>)
+            AddWord(std::bit_cast<std::uint64_t>(value));
+        else if constexpr (Math::vector<T>)
+            Math::apply_elementwise([&](const auto &elem){Add(elem);}, value);
+        else if constexpr (Meta::specialization_of<T, std::optional>)
+        {
+            AddWord(value.has_value());
+            if (value)
+                Add(*value);
+        }
+        else if constexpr (std::ranges::range<T>)
+        {
+            std::uint64_t size = 0;
+            for (const auto &elem : value)
+            {
+                Add(elem);
+                size++;
+            }
+            AddWord(size);
+        }
+        else if constexpr (Refl::Class::members_known<T>)
+        {
+            static_assert(Meta::list_size<Refl::Class::regular_bases<T>> == 0 && Meta::list_size<Refl::Class::direct_virtual_bases<T>> == 0, "Structs with bases are not supported.");
+            Meta::cexpr_for<Refl::Class::member_count<T>>([&](auto index)
+            {
+                Add(Refl::Class::Member<index.value>(value));
+            });
+        }
+        else
+        {
+            static_assert(Meta::value<false, T>, "Don't know how to hash this type.");
+        }
+    }
+
+    // Adds all the arguments, in order.
+    template <typename ...P>
+    StateHash &operator()(const P &... values)
+    {
+        (Add(values), ...);
+        return *this;
+    }
+
+    [[nodiscard]] std::uint64_t Value() const
+    {
+        return Hash::impl::Mix(state ^ Hash::impl::secret[2], Hash::impl::secret[3]);
+    }
+
+    // The 64-bit hash folded in half, for storing compactly.
+    [[nodiscard]] std::uint32_t Value32() const
+    {
+        std::uint64_t ret = Value();
+        return std::uint32_t(ret ^ (ret >> 32));
+    }
+};
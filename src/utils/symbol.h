@@ -0,0 +1,133 @@
+#pragma once
+
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "meta/string_template_params.h"
+#include "utils/flat_hash.h"
+#include "utils/hash.h"
+
+// An interned string. Each distinct string is stored once in a global table, and gets a stable integer ID.
+// Copying, comparing and hashing the symbols is as cheap as for integers, so the registries keyed on them don't touch the characters.
+// The IDs depend on the interning order, so don't save them to files, save the strings instead. The order of the symbols is the ID order, not alphabetical.
+// The strings never move, so `View()` stays valid until the program exits. Interning is thread-safe, and the rest doesn't touch the table.
+// The default-constructed symbol is the empty string, with ID 0.
+// Usage:
+//     Symbol a("jump"); // Interns the string, or finds the existing one.
+//     Symbol b = Symbol::Of<"jump">(); // Interns once, then caches the result.
+//     a == b; a.View() == "jump";
+//     std::optional<Symbol> c = Symbol::Find(name); // Doesn't intern, returns null if this string wasn't interned yet.
+class Symbol
+{
+    struct Entry
+    {
+        std::string str;
+        std::uint32_t id = 0;
+    };
+
+    struct Table
+    {
+        std::mutex mutex;
+        std::deque<Entry> entries; // Never invalidates the references.
+        FlatMap<std::string_view, const Entry *> lookup; // The keys point into `entries`.
+    };
+
+    [[nodiscard]] static Table &GetTable()
+    {
+        static Table ret;
+        return ret;
+    }
+
+    const Entry *entry = nullptr;
+
+    explicit Symbol(const Entry *entry) : entry(entry) {}
+
+  public:
+    constexpr Symbol() {}
+
+    explicit Symbol(std::string_view str)
+    {
+        if (str.empty())
+            return;
+
+        Table &table = GetTable();
+        std::lock_guard lock(table.mutex);
+        if (auto it = table.lookup.find(str); it != table.lookup.end())
+        {
+            entry = it->second;
+            return;
+        }
+        Entry &new_entry = table.entries.emplace_back(Entry{.str = std::string(str), .id = std::uint32_t(table.entries.size() + 1)});
+        table.lookup.try_emplace(new_entry.str, &new_entry);
+        entry = &new_entry;
+    }
+
+    // Interns the string on the first call, the next calls don't lock or hash anything.
+    template <Meta::ConstString Name>
+    [[nodiscard]] static Symbol Of()
+    {
+        static const Symbol ret(Name.view());
+        return ret;
+    }
+
+    // Returns null if this string wasn't interned yet. Use this for the lookups of the untrusted strings, to not fill the table with garbage.
+    [[nodiscard]] static std::optional<Symbol> Find(std::string_view str)
+    {
+        if (str.empty())
+            return Symbol{};
+
+        Table &table = GetTable();
+        std::lock_guard lock(table.mutex);
+        auto it = table.lookup.find(str);
+        if (it == table.lookup.end())
+            return {};
+        return Symbol(it->second);
+    }
+
+    // The number of the interned strings, not counting the empty one.
+    [[nodiscard]] static std::size_t Count()
+    {
+        Table &table = GetTable();
+        std::lock_guard lock(table.mutex);
+        return table.entries.size();
+    }
+
+    [[nodiscard]] std::uint32_t Id() const
+    {
+        return entry ? entry->id : 0;
+    }
+    [[nodiscard]] bool IsEmpty() const
+    {
+        return !entry;
+    }
+
+    [[nodiscard]] std::string_view View() const
+    {
+        return entry ? std::string_view(entry->str) : std::string_view{};
+    }
+    // Null-terminated.
+    [[nodiscard]] const char *CStr() const
+    {
+        return entry ? entry->str.c_str() : "";
+    }
+
+    [[nodiscard]] bool operator==(const Symbol &other) const
+    {
+        return entry == other.entry;
+    }
+    [[nodiscard]] std::strong_ordering operator<=>(const Symbol &other) const
+    {
+        return Id() <=> other.Id();
+    }
+
+    [[nodiscard]] std::size_t hash() const
+    {
+        return Hash::Compute(Id());
+    }
+};
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "program/errors.h"
+#include "strings/format.h"
+#include "utils/mat.h"
+
+// A 2D array with the same interface as `Array2D`, but the elements are stored in square tiles of `2^TileBits` elements per side.
+// The tiles are stored row by row, and so are the elements inside of them.
+// Good for the large arrays that are accessed by small neighbourhoods, since the neighbours are usually in the same tile,
+// while in a row-major array the vertical neighbours are a whole row apart.
+// Iterate with `for_each()` or `for_each_in_tile()` to visit the elements in the storage order.
+template <typename T, int TileBits = 3>
+class TiledArray2D
+{
+  public:
+    static_assert(TileBits >= 1 && TileBits <= 8, "Invalid tile size.");
+
+    using type = T;
+    using index_t = std::ptrdiff_t;
+    using index_vec_t = index_vec2;
+
+    static constexpr index_t tile_size = index_t(1) << TileBits;
+    static constexpr index_t tile_mask = tile_size - 1;
+    static constexpr index_t tile_elements = tile_size * tile_size;
+
+  private:
+    index_vec_t size_vec{};
+    index_t tiles_x = 0; // The number of tiles per row.
+    std::vector<type> storage; // The size is rounded up to whole tiles.
+
+    [[nodiscard]] index_t index(index_vec_t pos) const
+    {
+        return ((pos.y >> TileBits) * tiles_x + (pos.x >> TileBits)) * tile_elements + ((pos.y & tile_mask) << TileBits) + (pos.x & tile_mask);
+    }
+
+  public:
+    constexpr TiledArray2D() {}
+
+    TiledArray2D(index_vec_t size_vec, const T &init = T{})
+        : size_vec(size_vec), tiles_x((size_vec.x + tile_mask) >> TileBits), storage(tiles_x * ((size_vec.y + tile_mask) >> TileBits) * tile_elements, init)
+    {
+        ASSERT(size_vec.min() >= 0, "Invalid tiled array size.");
+    }
+
+    [[nodiscard]] index_vec_t size() const
+    {
+        return size_vec;
+    }
+
+    // The number of tiles along each dimension, including the partially filled ones.
+    [[nodiscard]] index_vec_t tile_count() const
+    {
+        return (size_vec + tile_mask) >> TileBits;
+    }
+
+    [[nodiscard]] bool pos_in_range(index_vec_t pos) const
+    {
+        return (pos >= 0).all() && (pos < size_vec).all();
+    }
+
+    [[nodiscard]] type &unsafe_at(index_vec_t pos)
+    {
+        ASSERT(pos_in_range(pos), STR("Tiled array indices out of range. Indices are ", (pos), " but the array size is ", (size_vec), "."));
+        return storage[index(pos)];
+    }
+    [[nodiscard]] type &safe_throwing_at(index_vec_t pos)
+    {
+        if (!pos_in_range(pos))
+            Program::Error("Tiled array index ", pos, " is out of range. The array size is ", size_vec, ".");
+        return unsafe_at(pos);
+    }
+    [[nodiscard]] type &safe_nonthrowing_at(index_vec_t pos)
+    {
+        if (!pos_in_range(pos))
+            Program::HardError("Tiled array index ", pos, " is out of range. The array size is ", size_vec, ".");
+        return unsafe_at(pos);
+    }
+    [[nodiscard]] type &clamped_at(index_vec_t pos)
+    {
+        clamp_var(pos, 0, size_vec-1);
+        return unsafe_at(pos);
+    }
+    [[nodiscard]] type try_get(index_vec_t pos) const
+    {
+        if (!pos_in_range(pos))
+            return {};
+        return unsafe_at(pos);
+    }
+    void try_set(index_vec_t pos, const type &obj)
+    {
+        if (!pos_in_range(pos))
+            return;
+        unsafe_at(pos) = obj;
+    }
+    void try_set(index_vec_t pos, type &&obj)
+    {
+        if (!pos_in_range(pos))
+            return;
+        unsafe_at(pos) = std::move(obj);
+    }
+
+    [[nodiscard]] const type &unsafe_at(index_vec_t pos) const
+    {
+        return const_cast<TiledArray2D *>(this)->unsafe_at(pos);
+    }
+    [[nodiscard]] const type &safe_throwing_at(index_vec_t pos) const
+    {
+        return const_cast<TiledArray2D *>(this)->safe_throwing_at(pos);
+    }
+    [[nodiscard]] const type &safe_nonthrowing_at(index_vec_t pos) const
+    {
+        return const_cast<TiledArray2D *>(this)->safe_nonthrowing_at(pos);
+    }
+    [[nodiscard]] const type &clamped_at(index_vec_t pos) const
+    {
+        return const_cast<TiledArray2D *>(this)->clamped_at(pos);
+    }
+
+    // Calls `func(pos, elem)` for every element of the tile at `tile_pos` (measured in tiles), in the storage order.
+    // The parts of the edge tiles that are outside of the array are skipped.
+    template <typename F>
+    void for_each_in_tile(index_vec_t tile_pos, F &&func)
+    {
+        ASSERT((tile_pos >= 0).all() && (tile_pos < tile_count()).all(), "Tile index is out of range.");
+
+        index_vec_t base = tile_pos << TileBits;
+        index_vec_t end = min(base + tile_size, size_vec);
+        type *tile = storage.data() + (tile_pos.y * tiles_x + tile_pos.x) * tile_elements;
+        for (index_t y = base.y; y < end.y; y++)
+        {
+            type *row = tile + ((y & tile_mask) << TileBits);
+            for (index_t x = base.x; x < end.x; x++)
+                func(index_vec_t(x, y), row[x & tile_mask]);
+        }
+    }
+    template <typename F>
+    void for_each_in_tile(index_vec_t tile_pos, F &&func) const
+    {
+        const_cast<TiledArray2D *>(this)->for_each_in_tile(tile_pos, [&](index_vec_t pos, type &elem){func(pos, std::as_const(elem));});
+    }
+
+    // Calls `func(pos, elem)` for every element, tile by tile.
+    template <typename F>
+    void for_each(F &&func)
+    {
+        for (auto tile_pos : vector_range(tile_count()))
+            for_each_in_tile(tile_pos, func);
+    }
+    template <typename F>
+    void for_each(F &&func) const
+    {
+        for (auto tile_pos : vector_range(tile_count()))
+            for_each_in_tile(tile_pos, func);
+    }
+};
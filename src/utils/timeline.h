@@ -0,0 +1,435 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "program/errors.h"
+#include "reflection/structs.h"
+#include "utils/archive.h"
+#include "utils/jobs.h"
+
+// Stores a sequence of states of a trivially copyable type, one per tick, for rewinding.
+// Every `KeyframeInterval` states a full copy is stored. Between them, we only store the 4-byte words that changed since the previous state,
+// XORed with their old values and with the leading zero bytes stripped. This works best when only a few fields change per tick.
+// Appending and truncating are amortized O(1) (truncating decodes at most `KeyframeInterval - 1` deltas).
+// Sequential reads are cheap, and random reads decode at most `KeyframeInterval - 1` deltas.
+// The rarely used timelines can be compressed with `CompressInBackground()`, then they are decompressed on the next access, or by `Decompress()` ahead of time.
+template <typename T, int KeyframeInterval = 32>
+class Timeline
+{
+    static_assert(std::is_trivially_copyable_v<T>, "The states are stored as raw bytes.");
+    static_assert(KeyframeInterval >= 1, "Invalid keyframe interval.");
+
+    using word_t = std::uint32_t;
+    using mask_t = std::uint64_t;
+
+    static constexpr int num_words = (sizeof(T) + sizeof(word_t) - 1) / sizeof(word_t);
+    static_assert(num_words <= sizeof(mask_t) * 8, "The type is too large, increase the size of `mask_t`.");
+    // The mask is stored with this many bytes.
+    static constexpr std::size_t mask_bytes = (num_words + 7) / 8;
+
+    struct Words
+    {
+        word_t words[num_words]{};
+    };
+
+    int size = 0;
+
+    // Those are empty while `compressed` isn't. They're mutable, to be decompressed on access.
+    mutable std::vector<Words> keyframes;
+    mutable std::vector<std::size_t> keyframe_delta_offsets; // Where the deltas following each keyframe start in `deltas`.
+    mutable std::vector<unsigned char> deltas;
+
+    Words last_appended;
+
+    // If not empty, the three vectors above are serialized and compressed into this.
+    mutable std::vector<std::uint8_t> compressed;
+
+    // A compression running in the background. The job only touches this object, so the timeline can be moved or copied meanwhile.
+    struct PendingCompression
+    {
+        std::vector<std::uint8_t> input, output;
+    };
+    std::shared_ptr<PendingCompression> pending;
+    Jobs::Handle pending_job;
+    int pending_size = 0; // `size` when the compression started. If it changes, the result is discarded.
+
+    // The last decoded state, to make sequential reads fast.
+    mutable int cursor_index = -1;
+    mutable std::size_t cursor_offset = 0; // Where the delta for `cursor_index + 1` starts.
+    mutable Words cursor_state;
+
+    [[nodiscard]] static Words ToWords(const T &value)
+    {
+        Words ret;
+        std::memcpy(ret.words, &value, sizeof(T));
+        return ret;
+    }
+
+    [[nodiscard]] static T FromWords(const Words &w)
+    {
+        T ret;
+        std::memcpy(static_cast<void *>(&ret), w.words, sizeof(T));
+        return ret;
+    }
+
+    // Each delta is: a mask of changed words, then one 2-bit length code per changed word (rounded up to a whole byte), then the XORed words.
+    void AppendDelta(const Words &from, const Words &to)
+    {
+        mask_t mask = 0;
+        for (int i = 0; i < num_words; i++)
+        {
+            if (from.words[i] != to.words[i])
+                mask |= mask_t(1) << i;
+        }
+
+        for (std::size_t i = 0; i < mask_bytes; i++)
+            deltas.push_back((mask >> (i * 8)) & 0xff);
+
+        std::size_t codes_offset = deltas.size();
+        deltas.resize(deltas.size() + (std::popcount(mask) + 3) / 4);
+
+        int changed_index = 0;
+        for (int i = 0; i < num_words; i++)
+        {
+            if (!(mask & mask_t(1) << i))
+                continue;
+
+            word_t value = from.words[i] ^ to.words[i];
+            int len = (std::bit_width(value) + 7) / 8; // Never zero, since the word has changed.
+            deltas[codes_offset + changed_index / 4] |= (len - 1) << (changed_index % 4 * 2);
+            for (int j = 0; j < len; j++)
+                deltas.push_back((value >> (j * 8)) & 0xff);
+
+            changed_index++;
+        }
+    }
+
+    void ApplyDelta(Words &w, std::size_t &offset) const
+    {
+        mask_t mask = 0;
+        for (std::size_t i = 0; i < mask_bytes; i++)
+            mask |= mask_t(deltas[offset++]) << (i * 8);
+
+        std::size_t codes_offset = offset;
+        offset += (std::popcount(mask) + 3) / 4;
+
+        int changed_index = 0;
+        for (int i = 0; i < num_words; i++)
+        {
+            if (!(mask & mask_t(1) << i))
+                continue;
+
+            int len = (deltas[codes_offset + changed_index / 4] >> (changed_index % 4 * 2) & 3) + 1;
+            word_t value = 0;
+            for (int j = 0; j < len; j++)
+                value |= word_t(deltas[offset++]) << (j * 8);
+            w.words[i] ^= value;
+
+            changed_index++;
+        }
+    }
+
+    // Unlike `.clear()` or `= {}`, frees the memory.
+    template <typename V>
+    static void FreeVector(V &vec)
+    {
+        V().swap(vec);
+    }
+
+    // Serializes the three storage vectors, for compressing.
+    [[nodiscard]] std::vector<std::uint8_t> SerializeStorage() const
+    {
+        std::size_t keyframe_bytes = keyframes.size() * sizeof(Words);
+        std::size_t offset_bytes = keyframe_delta_offsets.size() * sizeof(std::size_t);
+        std::vector<std::uint8_t> ret(keyframe_bytes + offset_bytes + deltas.size());
+        if (keyframe_bytes)
+            std::memcpy(ret.data(), keyframes.data(), keyframe_bytes);
+        if (offset_bytes)
+            std::memcpy(ret.data() + keyframe_bytes, keyframe_delta_offsets.data(), offset_bytes);
+        if (!deltas.empty())
+            std::memcpy(ret.data() + keyframe_bytes + offset_bytes, deltas.data(), deltas.size());
+        return ret;
+    }
+
+    // Decompresses `source` into the storage vectors. The number of keyframes is determined from `size`.
+    void DecompressStorage(const std::vector<std::uint8_t> &source, std::vector<Words> &out_keyframes, std::vector<std::size_t> &out_offsets, std::vector<unsigned char> &out_deltas) const
+    {
+        std::vector<std::uint8_t> bytes(Archive::UncompressedSize(source.data(), source.data() + source.size()));
+        Archive::Uncompress(source.data(), source.data() + source.size(), bytes.data());
+
+        std::size_t num_keyframes = std::size_t(size + KeyframeInterval - 1) / KeyframeInterval;
+        std::size_t keyframe_bytes = num_keyframes * sizeof(Words);
+        std::size_t offset_bytes = num_keyframes * sizeof(std::size_t);
+        if (bytes.size() < keyframe_bytes + offset_bytes)
+            Program::Error("Invalid compressed timeline.");
+
+        out_keyframes.resize(num_keyframes);
+        out_offsets.resize(num_keyframes);
+        if (keyframe_bytes)
+            std::memcpy(static_cast<void *>(out_keyframes.data()), bytes.data(), keyframe_bytes);
+        if (offset_bytes)
+            std::memcpy(out_offsets.data(), bytes.data() + keyframe_bytes, offset_bytes);
+        out_deltas.assign(bytes.begin() + keyframe_bytes + offset_bytes, bytes.end());
+    }
+
+    void EnsureDecompressed() const
+    {
+        if (compressed.empty())
+            return;
+        DecompressStorage(compressed, keyframes, keyframe_delta_offsets, deltas);
+        FreeVector(compressed);
+        cursor_index = -1;
+    }
+
+    // Prepares for modification.
+    void CancelCompression()
+    {
+        EnsureDecompressed();
+        pending = {};
+        pending_job = {};
+    }
+
+    // Moves the cursor to `index`.
+    void Seek(int index) const
+    {
+        ASSERT(index >= 0 && index < size);
+        EnsureDecompressed();
+
+        int keyframe = index / KeyframeInterval;
+        if (index < cursor_index || cursor_index < 0 || cursor_index / KeyframeInterval != keyframe)
+        {
+            cursor_index = keyframe * KeyframeInterval;
+            cursor_offset = keyframe_delta_offsets[keyframe];
+            cursor_state = keyframes[keyframe];
+        }
+
+        while (cursor_index < index)
+        {
+            ApplyDelta(cursor_state, cursor_offset);
+            cursor_index++;
+        }
+    }
+
+    template <typename E>
+    [[nodiscard]] static std::vector<std::uint8_t> ToBytes(const std::vector<E> &elems)
+    {
+        std::vector<std::uint8_t> ret(elems.size() * sizeof(E));
+        if (!ret.empty())
+            std::memcpy(ret.data(), elems.data(), ret.size());
+        return ret;
+    }
+
+    template <typename E>
+    [[nodiscard]] static std::vector<E> FromBytes(const std::vector<std::uint8_t> &bytes)
+    {
+        if (bytes.size() % sizeof(E) != 0)
+            Program::Error("Invalid timeline snapshot.");
+        std::vector<E> ret(bytes.size() / sizeof(E));
+        if (!ret.empty())
+            std::memcpy(static_cast<void *>(ret.data()), bytes.data(), bytes.size());
+        return ret;
+    }
+
+  public:
+    using value_type = T;
+    static constexpr int keyframe_interval = KeyframeInterval;
+
+    [[nodiscard]] int Size() const
+    {
+        return size;
+    }
+
+    void Append(const T &value)
+    {
+        CancelCompression();
+
+        Words w = ToWords(value);
+
+        if (size % KeyframeInterval == 0)
+        {
+            keyframes.push_back(w);
+            keyframe_delta_offsets.push_back(deltas.size());
+        }
+        else
+        {
+            AppendDelta(last_appended, w);
+        }
+
+        last_appended = w;
+        size++;
+    }
+
+    // Removes all states, keeping the allocated memory.
+    void Clear()
+    {
+        FreeVector(compressed);
+        pending = {};
+        pending_job = {};
+
+        size = 0;
+        keyframes.clear();
+        keyframe_delta_offsets.clear();
+        deltas.clear();
+        last_appended = {};
+        cursor_index = -1;
+        cursor_offset = 0;
+    }
+
+    // Removes the states starting from `new_size`, keeping the allocated memory. Then `Append()` continues from there.
+    void Truncate(int new_size)
+    {
+        ASSERT(new_size >= 0 && new_size <= size);
+        if (new_size >= size)
+            return;
+        if (new_size <= 0)
+        {
+            Clear();
+            return;
+        }
+
+        CancelCompression();
+
+        // This leaves `cursor_offset` at the end of the last kept delta.
+        Seek(new_size - 1);
+        last_appended = cursor_state;
+
+        std::size_t num_keyframes = std::size_t(new_size + KeyframeInterval - 1) / KeyframeInterval;
+        keyframes.resize(num_keyframes);
+        keyframe_delta_offsets.resize(num_keyframes);
+        deltas.resize(cursor_offset);
+        size = new_size;
+    }
+
+    [[nodiscard]] T Get(int index) const
+    {
+        Seek(index);
+        return FromWords(cursor_state);
+    }
+
+    [[nodiscard]] bool IsCompressed() const
+    {
+        return !compressed.empty();
+    }
+
+    // True if `CompressInBackground()` was called, and `FinishCompression()` didn't apply the result yet.
+    [[nodiscard]] bool IsCompressing() const
+    {
+        return bool(pending);
+    }
+
+    // Starts compressing the states on `pool`, unless they're already compressed or being compressed.
+    // Call `FinishCompression()` periodically to apply the result. The timeline stays usable meanwhile.
+    void CompressInBackground(Jobs::Pool &pool)
+    {
+        if (size == 0 || !compressed.empty() || pending)
+            return;
+
+        pending = std::make_shared<PendingCompression>();
+        pending->input = SerializeStorage();
+        pending_size = size;
+        pending_job = pool.Submit([job = pending]
+        {
+            const std::uint8_t *begin = job->input.data(), *end = begin + job->input.size();
+            job->output.resize(Archive::MaxCompressedSize(begin, end));
+            job->output.resize(Archive::Compress(begin, end, job->output.data(), job->output.data() + job->output.size()) - job->output.data());
+            job->output.shrink_to_fit();
+            FreeVector(job->input);
+        });
+    }
+
+    // If the background compression is done, replaces the states with the compressed ones. Otherwise does nothing.
+    void FinishCompression()
+    {
+        if (!pending || !pending_job.IsDone())
+            return;
+
+        std::shared_ptr<PendingCompression> job = std::move(pending);
+        pending = {};
+        try
+        {
+            pending_job.Wait(); // Rethrows the exception, if any.
+        }
+        catch (std::exception &)
+        {
+            pending_job = {};
+            return; // Keep the states uncompressed.
+        }
+        pending_job = {};
+
+        if (size != pending_size || !compressed.empty())
+            return;
+        compressed = std::move(job->output);
+        FreeVector(keyframes);
+        FreeVector(keyframe_delta_offsets);
+        FreeVector(deltas);
+        cursor_index = -1;
+    }
+
+    // Decompresses the states if they're compressed (otherwise they're decompressed on the next access), and cancels the background compression.
+    void Decompress()
+    {
+        CancelCompression();
+    }
+
+    // The approximate number of bytes used by the stored states, including the unused capacity.
+    [[nodiscard]] std::size_t MemoryUsage() const
+    {
+        return keyframes.capacity() * sizeof(Words) + keyframe_delta_offsets.capacity() * sizeof(std::size_t) + deltas.capacity() + compressed.capacity();
+    }
+
+    // The encoded states as is, the keyframes are stored as raw bytes. Only loadable by the same build.
+    REFL_SIMPLE_STRUCT( Snapshot
+        REFL_DECL(int REFL_INIT = 0) size
+        REFL_DECL(std::vector<std::uint8_t>) keyframes
+        REFL_DECL(std::vector<std::size_t>) keyframe_delta_offsets
+        REFL_DECL(std::vector<unsigned char>) deltas
+        REFL_DECL(std::vector<std::uint8_t>) last_appended
+    )
+
+    // Doesn't decompress the timeline, if it's compressed.
+    [[nodiscard]] Snapshot SaveSnapshot() const
+    {
+        std::vector<Words> temp_keyframes;
+        std::vector<std::size_t> temp_offsets;
+        std::vector<unsigned char> temp_deltas;
+        if (!compressed.empty())
+            DecompressStorage(compressed, temp_keyframes, temp_offsets, temp_deltas);
+        bool use_temp = !compressed.empty();
+
+        return {
+            .size = size,
+            .keyframes = ToBytes(use_temp ? temp_keyframes : keyframes),
+            .keyframe_delta_offsets = use_temp ? temp_offsets : keyframe_delta_offsets,
+            .deltas = use_temp ? temp_deltas : deltas,
+            .last_appended = ToBytes(std::vector<Words>{last_appended}),
+        };
+    }
+
+    [[nodiscard]] static Timeline FromSnapshot(const Snapshot &snapshot)
+    {
+        Timeline ret;
+        ret.size = snapshot.size;
+        ret.keyframes = FromBytes<Words>(snapshot.keyframes);
+        ret.keyframe_delta_offsets = snapshot.keyframe_delta_offsets;
+        ret.deltas = snapshot.deltas;
+
+        std::vector<Words> last = FromBytes<Words>(snapshot.last_appended);
+        std::size_t num_keyframes = std::size_t(ret.size + KeyframeInterval - 1) / KeyframeInterval;
+        if (ret.size < 0 || last.size() != 1 || ret.keyframes.size() != num_keyframes || ret.keyframe_delta_offsets.size() != num_keyframes ||
+            std::any_of(ret.keyframe_delta_offsets.begin(), ret.keyframe_delta_offsets.end(), [&](std::size_t offset){return offset > ret.deltas.size();}))
+        {
+            Program::Error("Invalid timeline snapshot.");
+        }
+        ret.last_appended = last.front();
+        return ret;
+    }
+};
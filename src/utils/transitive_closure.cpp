@@ -1,7 +1,9 @@
 #include "transitive_closure.h"
 
 #include <algorithm>
+#include <bit>
 #include <iostream>
+#include <random>
 
 #include "program/errors.h"
 
@@ -13,7 +15,7 @@ namespace TransitiveClosure
         for (std::size_t i = 0; i < components.size(); i++)
         for (std::size_t j = 0; j < i; j++)
         {
-            if (components[i].next_flags[j])
+            if (components[i].IsNext(j))
                 continue;
             if (callback)
                 callback(j, i);
@@ -27,7 +29,7 @@ namespace TransitiveClosure
         std::size_t ret = 0;
         for (std::size_t i = 0; i < components.size(); i++)
         {
-            if (!components[i].next_flags[i])
+            if (!components[i].IsNext(i))
                 continue;
             if (callback)
                 callback(i);
@@ -36,18 +38,23 @@ namespace TransitiveClosure
         return ret;
     }
 
-    [[nodiscard]] Data Compute(std::size_t n, func_t for_each_connected_node)
+    [[nodiscard]] Data Compute(std::size_t n, func_t for_each_connected_node, Flags flags)
     {
         // Implementation of the 'STACK_TC' algorithm, described by Esko Nuutila (1995), in
         // 'Efficient Transitive Closure Computation in Large Digraphs'.
 
         constexpr std::size_t nil = -1;
 
+        const bool use_bits = bool(flags & bits);
+
         Data ret;
         ret.nodes.resize(n);
         std::vector<std::size_t> vstack, cstack; // Vertex and component stacks.
         vstack.reserve(n);
         cstack.reserve(n);
+        // The order in which the nodes were visited. The roots are compared by it, not by the node indices.
+        std::vector<std::size_t> visit_order(n);
+        std::size_t num_visited = 0;
 
         auto StackTc = [&](auto &StackTc, std::size_t v)
         {
@@ -55,6 +62,7 @@ namespace TransitiveClosure
                 return; // We already visited `v`.
             ret.nodes[v].root = v;
             ret.nodes[v].comp = nil;
+            visit_order[v] = num_visited++;
             vstack.push_back(v);
             std::size_t saved_height = cstack.size();
             bool self_loop = false;
@@ -71,9 +79,14 @@ namespace TransitiveClosure
                 {
                     StackTc(StackTc, w);
                     if (ret.nodes[w].comp == nil)
-                        ret.nodes[v].root = std::min(ret.nodes[v].root, ret.nodes[w].root);
+                    {
+                        if (visit_order[ret.nodes[w].root] < visit_order[ret.nodes[v].root])
+                            ret.nodes[v].root = ret.nodes[w].root;
+                    }
                     else
+                    {
                         cstack.push_back(ret.nodes[w].comp);
+                    }
 
                     // The paper that this is based on had an extra condition on this last `else` branch,
                     // which I wasn't able to understand: `if (v,w) is not a forward edge`.
@@ -91,45 +104,79 @@ namespace TransitiveClosure
                 ret.components.emplace_back();
                 Data::Component &this_comp = ret.components.back();
 
-                this_comp.next_flags.assign(ret.components.size(), false); // Sic.
-
-                if (vstack.back() != v || self_loop)
-                {
-                    this_comp.next.push_back(c);
-                    this_comp.next_flags[c] = true;
-                }
+                bool has_cycle = vstack.back() != v || self_loop;
 
                 // Topologically sort a part of the component stack.
                 std::sort(cstack.begin() + saved_height, cstack.end(), [&comp = ret.components](std::size_t a, std::size_t b) -> bool
                 {
                     if (a == b)
                         return false; // This can happen when we have cycles. Libstdc++ sometiems checks this in debug mode, it seems.
-                    if (b >= comp[a].next_flags.size())
-                        return false;
-                    return comp[a].next_flags[b];
+                    return comp[a].IsNext(b);
                 });
                 // Remove duplicates.
                 cstack.erase(std::unique(cstack.begin() + saved_height, cstack.end()), cstack.end());
 
-                while (cstack.size() != saved_height)
+                if (use_bits)
                 {
-                    std::size_t x = cstack.back();
-                    cstack.pop_back();
-                    if (!this_comp.next_flags[x])
+                    this_comp.next_bits.assign(c / 64 + 1, 0);
+
+                    if (has_cycle)
+                        this_comp.next_bits[c / 64] |= std::uint64_t(1) << (c % 64);
+
+                    while (cstack.size() != saved_height)
                     {
-                        if (!this_comp.next_flags[x])
+                        std::size_t x = cstack.back();
+                        cstack.pop_back();
+                        // If `x` is already reachable, then so is everything reachable from it.
+                        if (this_comp.next_bits[x / 64] >> (x % 64) & 1)
+                            continue;
+
+                        this_comp.next_bits[x / 64] |= std::uint64_t(1) << (x % 64);
+                        // `x < c`, so its row is not longer than ours.
+                        const std::vector<std::uint64_t> &x_bits = ret.components[x].next_bits;
+                        for (std::size_t i = 0; i < x_bits.size(); i++)
+                            this_comp.next_bits[i] |= x_bits[i];
+                    }
+
+                    if (!(flags & no_next_lists))
+                    {
+                        for (std::size_t i = 0; i < this_comp.next_bits.size(); i++)
                         {
-                            this_comp.next.push_back(x);
-                            this_comp.next_flags[x] = true;
+                            for (std::uint64_t word = this_comp.next_bits[i]; word; word &= word - 1)
+                                this_comp.next.push_back(i * 64 + std::size_t(std::countr_zero(word)));
                         }
+                    }
+                }
+                else
+                {
+                    this_comp.next_flags.assign(ret.components.size(), false); // Sic.
 
-                        this_comp.next.reserve(this_comp.next.size() + ret.components[x].next.size());
-                        for (std::size_t c : ret.components[x].next)
+                    if (has_cycle)
+                    {
+                        this_comp.next.push_back(c);
+                        this_comp.next_flags[c] = true;
+                    }
+
+                    while (cstack.size() != saved_height)
+                    {
+                        std::size_t x = cstack.back();
+                        cstack.pop_back();
+                        if (!this_comp.next_flags[x])
                         {
-                            if (!this_comp.next_flags[c])
+                            if (!this_comp.next_flags[x])
+                            {
+                                this_comp.next.push_back(x);
+                                this_comp.next_flags[x] = true;
+                            }
+
+                            this_comp.next.reserve(this_comp.next.size() + ret.components[x].next.size());
+                            for (std::size_t c : ret.components[x].next)
                             {
-                                this_comp.next.push_back(c);
-                                this_comp.next_flags[c] = true;
+                                if (!this_comp.next_flags[c])
+                                {
+                                    this_comp.next.push_back(c);
+                                    this_comp.next_flags[c] = true;
+                                }
                             }
                         }
                     }
@@ -140,6 +187,7 @@ namespace TransitiveClosure
                 {
                     w = vstack.back();
                     vstack.pop_back();
+                    ret.nodes[w].root = v;
                     ret.nodes[w].comp = c;
                     this_comp.nodes.push_back(w);
                 }
@@ -150,9 +198,469 @@ namespace TransitiveClosure
         for (std::size_t v = 0; v < n; v++)
             StackTc(StackTc, v);
 
+        // Without `bits`, the lists are needed until the end.
+        if (!use_bits && (flags & no_next_lists))
+        {
+            for (Data::Component &comp : ret.components)
+            {
+                comp.next.clear();
+                comp.next.shrink_to_fit();
+            }
+        }
+
         return ret;
     }
 
+    std::size_t Incremental::RowSize(std::size_t i) const
+    {
+        return flags & bits ? i / 64 + 1 : i + 1;
+    }
+
+    void Incremental::SetNext(Data::Component &comp, std::size_t i) const
+    {
+        if (flags & bits)
+            comp.next_bits[i / 64] |= std::uint64_t(1) << (i % 64);
+        else
+            comp.next_flags[i] = true;
+    }
+
+    void Incremental::MergeNext(Data::Component &target, const Data::Component &source) const
+    {
+        if (flags & bits)
+        {
+            ASSERT(source.next_bits.size() <= target.next_bits.size());
+            for (std::size_t i = 0; i < source.next_bits.size(); i++)
+                target.next_bits[i] |= source.next_bits[i];
+        }
+        else
+        {
+            ASSERT(source.next_flags.size() <= target.next_flags.size());
+            for (std::size_t i = 0; i < source.next_flags.size(); i++)
+                target.next_flags[i] |= source.next_flags[i];
+        }
+    }
+
+    void Incremental::UpdateNextList(Data::Component &comp) const
+    {
+        if (flags & no_next_lists)
+            return;
+
+        comp.next.clear();
+        if (flags & bits)
+        {
+            for (std::size_t i = 0; i < comp.next_bits.size(); i++)
+            {
+                for (std::uint64_t word = comp.next_bits[i]; word; word &= word - 1)
+                    comp.next.push_back(i * 64 + std::size_t(std::countr_zero(word)));
+            }
+        }
+        else
+        {
+            for (std::size_t i = 0; i < comp.next_flags.size(); i++)
+            {
+                if (comp.next_flags[i])
+                    comp.next.push_back(i);
+            }
+        }
+    }
+
+    bool Incremental::RemapFlags(Data::Component &comp, std::size_t from, std::size_t to, std::size_t new_index, const std::function<std::size_t(std::size_t j)> &map) const
+    {
+        constexpr std::size_t nil = -1;
+
+        // Take the flags out, then put them back at the new positions.
+        std::vector<std::size_t> moved;
+        if (flags & bits)
+        {
+            for (std::size_t i = from / 64; i < comp.next_bits.size() && i <= to / 64; i++)
+            {
+                std::uint64_t mask = -1;
+                if (i == from / 64)
+                    mask &= std::uint64_t(-1) << (from % 64);
+                if (i == to / 64 && to % 64 != 63)
+                    mask &= (std::uint64_t(1) << (to % 64 + 1)) - 1;
+
+                for (std::uint64_t word = comp.next_bits[i] & mask; word; word &= word - 1)
+                    moved.push_back(i * 64 + std::size_t(std::countr_zero(word)));
+                comp.next_bits[i] &= ~mask;
+            }
+            ASSERT(std::none_of(comp.next_bits.begin() + std::min(RowSize(new_index), comp.next_bits.size()), comp.next_bits.end(), [](std::uint64_t word){return bool(word);}), "The flags don't fit into the new index.");
+            comp.next_bits.resize(RowSize(new_index));
+        }
+        else
+        {
+            for (std::size_t i = from; i < comp.next_flags.size() && i <= to; i++)
+            {
+                if (comp.next_flags[i])
+                {
+                    moved.push_back(i);
+                    comp.next_flags[i] = false;
+                }
+            }
+            ASSERT(std::none_of(comp.next_flags.begin() + std::min(RowSize(new_index), comp.next_flags.size()), comp.next_flags.end(), [](unsigned char flag){return bool(flag);}), "The flags don't fit into the new index.");
+            comp.next_flags.resize(RowSize(new_index));
+        }
+
+        for (std::size_t j : moved)
+        {
+            std::size_t k = map(j);
+            if (k == nil)
+                continue;
+            ASSERT(k <= new_index, "The new component indices are not ordered correctly.");
+            SetNext(comp, k);
+        }
+        return !moved.empty();
+    }
+
+    void Incremental::RecomputeComponent(std::size_t i)
+    {
+        Data::Component &comp = data.components[i];
+        if (flags & bits)
+            comp.next_bits.assign(RowSize(i), 0);
+        else
+            comp.next_flags.assign(RowSize(i), false);
+
+        for (std::size_t v : comp.nodes)
+        {
+            for (std::size_t w : edges[v])
+            {
+                std::size_t j = data.nodes[w].comp;
+                // Any edge inside of a component means it has a cycle. If there's more than one node, there is always such edge.
+                if (j == i)
+                {
+                    SetNext(comp, i);
+                }
+                else if (!comp.IsNext(j))
+                {
+                    // If `j` is already reachable, then so is everything reachable from it.
+                    SetNext(comp, j);
+                    MergeNext(comp, data.components[j]);
+                }
+            }
+        }
+
+        UpdateNextList(comp);
+    }
+
+    void Incremental::RecomputeWithAncestors(std::size_t i)
+    {
+        std::vector<unsigned char> old_flags = data.components[i].next_flags;
+        std::vector<std::uint64_t> old_bits = data.components[i].next_bits;
+        RecomputeComponent(i);
+        if (data.components[i].next_flags == old_flags && data.components[i].next_bits == old_bits)
+            return;
+
+        // Removing an edge doesn't change what reaches `i`, and the ancestors have larger indices, so we update them in order.
+        for (std::size_t x = i + 1; x < data.components.size(); x++)
+        {
+            if (data.components[x].IsNext(i))
+                RecomputeComponent(x);
+        }
+    }
+
+    void Incremental::Renumber(std::size_t begin, std::size_t end, const std::vector<std::size_t> &new_index)
+    {
+        ASSERT(begin <= end && end < data.components.size() && new_index.size() == end - begin + 1);
+
+        const std::size_t region_size = *std::max_element(new_index.begin(), new_index.end()) + 1;
+        const std::size_t removed = new_index.size() - region_size;
+        auto map = [&](std::size_t j) -> std::size_t {return j <= end ? begin + new_index[j - begin] : j - removed;};
+
+        // The components in the region. The merged ones are combined.
+        std::vector<Data::Component> region(region_size);
+        for (std::size_t x = begin; x <= end; x++)
+        {
+            std::size_t k = begin + new_index[x - begin];
+            Data::Component &comp = data.components[x];
+            RemapFlags(comp, begin, end, k, map);
+
+            Data::Component &target = region[k - begin];
+            if (target.nodes.empty())
+            {
+                target = std::move(comp);
+            }
+            else
+            {
+                target.nodes.insert(target.nodes.end(), comp.nodes.begin(), comp.nodes.end());
+                MergeNext(target, comp);
+            }
+        }
+
+        // The components after the region keep their order. If nothing was merged, only the flags pointing into the region are moved.
+        for (std::size_t x = end + 1; x < data.components.size(); x++)
+        {
+            Data::Component &comp = data.components[x];
+            if (RemapFlags(comp, begin, removed ? std::size_t(-1) : end, x - removed, map))
+                UpdateNextList(comp);
+        }
+
+        for (std::size_t k = 0; k < region_size; k++)
+        {
+            UpdateNextList(region[k]);
+            data.components[begin + k] = std::move(region[k]);
+        }
+        data.components.erase(data.components.begin() + std::ptrdiff_t(begin + region_size), data.components.begin() + std::ptrdiff_t(end + 1));
+
+        // Update the nodes. The merged components use the root of one of their parts.
+        for (std::size_t x = begin; x < (removed ? data.components.size() : begin + region_size); x++)
+        {
+            const Data::Component &comp = data.components[x];
+            std::size_t root = data.nodes[comp.nodes.front()].root;
+            for (std::size_t v : comp.nodes)
+                data.nodes[v] = {.root = root, .comp = x};
+        }
+    }
+
+    std::size_t Incremental::SplitComponent(std::size_t i)
+    {
+        constexpr std::size_t nil = -1;
+
+        if (data.components[i].nodes.size() <= 1)
+            return 1;
+
+        // Tarjan's algorithm, limited to the nodes of this component.
+        // It emits the parts in the order such that every part can only reach the earlier ones, same as the component numbering.
+        std::vector<std::size_t> local_nodes = data.components[i].nodes;
+        std::sort(local_nodes.begin(), local_nodes.end());
+        auto LocalIndex = [&](std::size_t v){return std::size_t(std::lower_bound(local_nodes.begin(), local_nodes.end(), v) - local_nodes.begin());};
+
+        struct LocalNode
+        {
+            std::size_t index = nil;
+            std::size_t low = nil;
+            bool on_stack = false;
+        };
+        std::vector<LocalNode> state(local_nodes.size());
+        std::vector<std::size_t> stack;
+        std::vector<std::vector<std::size_t>> parts;
+        std::size_t counter = 0;
+
+        auto Visit = [&](auto &Visit, std::size_t l) -> void
+        {
+            state[l].index = state[l].low = counter++;
+            stack.push_back(l);
+            state[l].on_stack = true;
+
+            for (std::size_t w : edges[local_nodes[l]])
+            {
+                if (data.nodes[w].comp != i)
+                    continue;
+                std::size_t m = LocalIndex(w);
+                if (state[m].index == nil)
+                {
+                    Visit(Visit, m);
+                    state[l].low = std::min(state[l].low, state[m].low);
+                }
+                else if (state[m].on_stack)
+                {
+                    state[l].low = std::min(state[l].low, state[m].index);
+                }
+            }
+
+            if (state[l].low == state[l].index)
+            {
+                std::vector<std::size_t> &part = parts.emplace_back();
+                std::size_t m;
+                do
+                {
+                    m = stack.back();
+                    stack.pop_back();
+                    state[m].on_stack = false;
+                    part.push_back(local_nodes[m]);
+                }
+                while (m != l);
+            }
+        };
+        for (std::size_t l = 0; l < local_nodes.size(); l++)
+        {
+            if (state[l].index == nil)
+                Visit(Visit, l);
+        }
+
+        if (parts.size() == 1)
+            return 1;
+
+        // Make room for the new components. Nothing points to `i` except its ancestors, which the caller recomputes.
+        const std::size_t shift = parts.size() - 1;
+        for (std::size_t x = i + 1; x < data.components.size(); x++)
+        {
+            Data::Component &comp = data.components[x];
+            if (RemapFlags(comp, i, nil, x + shift, [&](std::size_t j){return j == i ? nil : j + shift;}))
+                UpdateNextList(comp);
+        }
+        data.components.insert(data.components.begin() + std::ptrdiff_t(i + 1), shift, Data::Component{});
+        for (std::size_t k = 0; k < parts.size(); k++)
+            data.components[i + k].nodes = std::move(parts[k]);
+
+        for (std::size_t x = i; x < data.components.size(); x++)
+        {
+            const Data::Component &comp = data.components[x];
+            for (std::size_t v : comp.nodes)
+            {
+                data.nodes[v].comp = x;
+                if (x < i + parts.size())
+                    data.nodes[v].root = comp.nodes.front();
+            }
+        }
+
+        return parts.size();
+    }
+
+    Incremental::Incremental(std::size_t n, Flags flags)
+        : flags(flags), edges(n), data(Compute(n, [](std::size_t, next_func_t){}, flags))
+    {}
+
+    Incremental::Incremental(std::size_t n, func_t for_each_connected_node, Flags flags)
+        : flags(flags), edges(n)
+    {
+        for (std::size_t a = 0; a < n; a++)
+            for_each_connected_node(a, [&](std::size_t b){edges[a].push_back(b);});
+
+        data = Compute(n, [&](std::size_t a, next_func_t func)
+        {
+            for (std::size_t b : edges[a])
+                func(b);
+        }, flags);
+    }
+
+    bool Incremental::HasEdge(std::size_t a, std::size_t b) const
+    {
+        ASSERT(a < edges.size() && b < edges.size(), "Node index is out of range.");
+        return std::binary_search(edges[a].begin(), edges[a].end(), b);
+    }
+
+    bool Incremental::IsReachable(std::size_t a, std::size_t b) const
+    {
+        ASSERT(a < edges.size() && b < edges.size(), "Node index is out of range.");
+        return data.components[data.nodes[a].comp].IsNext(data.nodes[b].comp);
+    }
+
+    std::size_t Incremental::AddNode()
+    {
+        // Nothing is reachable from the new node, and it's not reachable from anything, so it can go last.
+        std::size_t v = edges.size();
+        std::size_t c = data.components.size();
+        edges.emplace_back();
+        data.nodes.push_back({.root = v, .comp = c});
+
+        Data::Component &comp = data.components.emplace_back();
+        comp.nodes.push_back(v);
+        if (flags & bits)
+            comp.next_bits.assign(RowSize(c), 0);
+        else
+            comp.next_flags.assign(RowSize(c), false);
+        return v;
+    }
+
+    bool Incremental::AddEdge(std::size_t a, std::size_t b)
+    {
+        ASSERT(a < edges.size() && b < edges.size(), "Node index is out of range.");
+
+        auto it = std::lower_bound(edges[a].begin(), edges[a].end(), b);
+        if (it != edges[a].end() && *it == b)
+            return false;
+        edges[a].insert(it, b);
+
+        std::size_t ca = data.nodes[a].comp;
+        std::size_t cb = data.nodes[b].comp;
+        if (data.components[ca].IsNext(cb))
+            return true; // Reachability doesn't change.
+
+        // If `b` comes after `a`, reorder the components between them:
+        // First the ones reachable from `b`, then the ones on the new cycle (if any) merged into one, then the rest.
+        // Each group keeps its order, and anything outside of the range stays in place.
+        const bool cycle = data.components[cb].IsNext(ca);
+        if (cb > ca)
+        {
+            auto Reached = [&](std::size_t x){return x == cb || data.components[cb].IsNext(x);};
+            auto Reaches = [&](std::size_t x){return x == ca || data.components[x].IsNext(ca);};
+
+            std::vector<std::size_t> new_index(cb - ca + 1);
+            std::size_t k = 0;
+            for (std::size_t x = ca; x <= cb; x++)
+            {
+                if (Reached(x) && !(cycle && Reaches(x)))
+                    new_index[x - ca] = k++;
+            }
+            if (cycle)
+            {
+                for (std::size_t x = ca; x <= cb; x++)
+                {
+                    if (Reached(x) && Reaches(x))
+                        new_index[x - ca] = k;
+                }
+                k++;
+            }
+            for (std::size_t x = ca; x <= cb; x++)
+            {
+                if (!Reached(x))
+                    new_index[x - ca] = k++;
+            }
+
+            Renumber(ca, cb, new_index);
+            ca = data.nodes[a].comp;
+            cb = data.nodes[b].comp;
+        }
+
+        // Everything that reaches `a` now reaches `b` and everything after it.
+        for (std::size_t x = ca; x < data.components.size(); x++)
+        {
+            Data::Component &comp = data.components[x];
+            if (x != ca && !comp.IsNext(ca))
+                continue;
+            if (!cycle && comp.IsNext(cb))
+                continue; // Already reaches everything.
+
+            SetNext(comp, cb);
+            if (x != cb)
+                MergeNext(comp, data.components[cb]);
+            UpdateNextList(comp);
+        }
+
+        return true;
+    }
+
+    bool Incremental::RemoveEdge(std::size_t a, std::size_t b)
+    {
+        ASSERT(a < edges.size() && b < edges.size(), "Node index is out of range.");
+
+        auto it = std::lower_bound(edges[a].begin(), edges[a].end(), b);
+        if (it == edges[a].end() || *it != b)
+            return false;
+        edges[a].erase(it);
+
+        std::size_t ca = data.nodes[a].comp;
+        if (ca != data.nodes[b].comp)
+        {
+            // The component order stays valid, only the reachability can shrink.
+            RecomputeWithAncestors(ca);
+            return true;
+        }
+
+        // The edge was inside of a component.
+        std::vector<std::size_t> ancestors;
+        for (std::size_t x = ca + 1; x < data.components.size(); x++)
+        {
+            if (data.components[x].IsNext(ca))
+                ancestors.push_back(x);
+        }
+
+        std::size_t count = SplitComponent(ca);
+        if (count == 1)
+        {
+            // Still strongly connected, unless it was a self-loop on a single node. Either way, the ancestors are unaffected.
+            if (a == b && data.components[ca].nodes.size() == 1)
+                RecomputeComponent(ca);
+            return true;
+        }
+
+        for (std::size_t x = ca; x < ca + count; x++)
+            RecomputeComponent(x);
+        for (std::size_t x : ancestors)
+            RecomputeComponent(x + count - 1);
+        return true;
+    }
+
     namespace Tests
     {
         void RunAll()
@@ -169,7 +677,8 @@ namespace TransitiveClosure
                             process(b);
                     }
                 };
-                std::string result = Compute(n, wrapped_func).DebugToString();
+                Data data = Compute(n, wrapped_func);
+                std::string result = data.DebugToString();
                 if (result == target)
                 {
                     std::cout << "OK\n";
@@ -181,6 +690,24 @@ namespace TransitiveClosure
                     std::cout << "GOT:      " << result << "\n";
                     Program::Error("Transitive closure test failed.");
                 }
+
+                // The bitset mode must give the same components and the same flags.
+                Data bits_data = Compute(n, wrapped_func, bits);
+                bool bits_ok = bits_data.components.size() == data.components.size();
+                for (std::size_t i = 0; bits_ok && i < data.components.size(); i++)
+                {
+                    auto next = data.components[i].next;
+                    std::sort(next.begin(), next.end());
+                    bits_ok = bits_data.components[i].nodes == data.components[i].nodes && bits_data.components[i].next == next;
+                    for (std::size_t j = 0; bits_ok && j < data.components.size(); j++)
+                        bits_ok = bits_data.components[i].IsNext(j) == data.components[i].IsNext(j);
+                }
+                if (!bits_ok)
+                {
+                    std::cout << "NOT OK (bits)\n";
+                    std::cout << "GOT: " << bits_data.DebugToString() << "\n";
+                    Program::Error("Transitive closure test failed.");
+                }
             };
 
             test(8, [](std::size_t a, std::size_t b)
@@ -217,6 +744,69 @@ namespace TransitiveClosure
                 return arr[a][b];
             }, "{nodes=[(0,3),(0,3),(0,3),(3,0),(3,0),(5,1),(5,1),(0,3),(0,3),(9,2)],components=[{nodes=[4,3],next=[0],next_flags=[1]},{nodes=[6,5],next=[1,0],next_flags=[1,1]},{nodes=[9],next=[],next_flags=[0,0,0]},{nodes=[8,7,2,1,0],next=[3,2,0,1],next_flags=[1,1,1,1]}]}");
 
+            // Random edits of `Incremental` must agree with `Compute()` on the same edges.
+            auto test_incremental = [](std::size_t n, Flags flags, std::size_t num_edits, std::uint32_t seed)
+            {
+                std::mt19937 rng(seed);
+                Incremental graph(n, flags);
+
+                for (std::size_t edit = 0; edit < num_edits; edit++)
+                {
+                    std::size_t a = rng() % n, b = rng() % n;
+                    // Prefer adding, so the graph doesn't stay sparse.
+                    if (rng() % 3 != 0)
+                        graph.AddEdge(a, b);
+                    else if (!graph.Edges(a).empty())
+                        graph.RemoveEdge(a, graph.Edges(a)[rng() % graph.Edges(a).size()]);
+
+                    const Data &data = graph.GetData();
+                    Data expected = Compute(n, [&](std::size_t a, next_func_t func)
+                    {
+                        for (std::size_t b : graph.Edges(a))
+                            func(b);
+                    }, flags);
+
+                    bool ok = data.nodes.size() == n && data.components.size() == expected.components.size();
+                    for (std::size_t u = 0; ok && u < n; u++)
+                    {
+                        const Data::Node &node = data.nodes[u];
+                        ok = node.comp < data.components.size() && data.nodes[node.root].comp == node.comp && data.nodes[data.components[node.comp].nodes.front()].root == node.root;
+                        for (std::size_t v = 0; ok && v < n; v++)
+                        {
+                            ok = (node.comp == data.nodes[v].comp) == (expected.nodes[u].comp == expected.nodes[v].comp) &&
+                                graph.IsReachable(u, v) == expected.components[expected.nodes[u].comp].IsNext(expected.nodes[v].comp);
+                        }
+                    }
+                    for (std::size_t i = 0; ok && i < data.components.size(); i++)
+                    {
+                        const Data::Component &comp = data.components[i];
+                        ok = flags & bits ? comp.next_bits.size() == i / 64 + 1 && comp.next_flags.empty() : comp.next_flags.size() == i + 1 && comp.next_bits.empty();
+                        std::vector<std::size_t> next;
+                        for (std::size_t j = 0; ok && j < data.components.size(); j++)
+                        {
+                            if (comp.IsNext(j))
+                                next.push_back(j);
+                            ok = j <= i || !comp.IsNext(j);
+                        }
+                        ok = ok && comp.next == (flags & no_next_lists ? std::vector<std::size_t>{} : next);
+                        for (std::size_t v : comp.nodes)
+                            ok = ok && data.nodes[v].comp == i;
+                    }
+                    if (!ok)
+                    {
+                        std::cout << "NOT OK (incremental, n=" << n << ", edit " << edit << ")\n";
+                        std::cout << "EXPECTED: " << expected.DebugToString() << "\n";
+                        std::cout << "GOT:      " << data.DebugToString() << "\n";
+                        Program::Error("Transitive closure test failed.");
+                    }
+                }
+                std::cout << "OK\n";
+            };
+            test_incremental(10, none, 2000, 1);
+            test_incremental(10, bits, 2000, 2);
+            test_incremental(6, no_next_lists, 1000, 3);
+            test_incremental(150, bits, 400, 4);
+
             std::cout << "All tests passed.\n";
         }
     }
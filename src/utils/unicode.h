@@ -1,11 +1,21 @@
 #pragma once
 
+#include <algorithm>
+#include <bit>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <iterator>
+#include <span>
 #include <string>
 #include <string_view>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 namespace Unicode
 {
     using Char = std::uint32_t;
@@ -185,6 +195,92 @@ namespace Unicode
         return ret;
     }
 
+    // Returns a pointer to the first non-ASCII byte in `[begin, end)`, or `end` if there's none.
+    // Checks 16 bytes at a time with SSE2 or NEON, or 8 bytes at a time otherwise.
+    [[nodiscard]] inline const char *SkipAscii(const char *begin, const char *end)
+    {
+        #if defined(__SSE2__)
+        while (end - begin >= 16)
+        {
+            int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(begin)));
+            if (mask)
+                return begin + std::countr_zero(unsigned(mask));
+            begin += 16;
+        }
+        #elif defined(__aarch64__) && defined(__ARM_NEON)
+        while (end - begin >= 16)
+        {
+            if (vmaxvq_u8(vld1q_u8(reinterpret_cast<const std::uint8_t *>(begin))) >= 0x80)
+                break; // The loop below finds the exact position.
+            begin += 16;
+        }
+        #endif
+
+        while (end - begin >= 8)
+        {
+            std::uint64_t word;
+            std::memcpy(&word, begin, 8);
+            if (word & 0x8080808080808080)
+                break;
+            begin += 8;
+        }
+
+        while (begin != end && (unsigned char)*begin < 0x80)
+            begin++;
+        return begin;
+    }
+
+    // Returns true if the string is valid UTF8.
+    // Unlike `Decode`, rejects the overlong encodings, the surrogates, and the characters above `0x10ffff`.
+    // The ASCII runs are skipped with `SkipAscii`, so mostly-ASCII strings are validated quickly.
+    [[nodiscard]] inline bool IsValidUtf8(std::string_view str)
+    {
+        const char *cur = str.data(), *end = str.data() + str.size();
+        while (true)
+        {
+            cur = SkipAscii(cur, end);
+            if (cur == end)
+                return true;
+
+            int len = FirstByteToCharacterLength(*cur);
+            if (len == 0 || end - cur < len)
+                return false;
+
+            Char ch = (unsigned char)*cur & (0xff >> len);
+            for (int i = 1; i < len; i++)
+            {
+                if ((cur[i] & 0b11000000) != 0b10000000)
+                    return false;
+                ch = ch << 6 | ((unsigned char)cur[i] & 0b00111111);
+            }
+
+            if (CharacterCodeToLength(ch) != len || !IsValidCharacterCode(ch) || (ch >= 0xd800 && ch <= 0xdfff))
+                return false;
+
+            cur += len;
+        }
+    }
+
+    // Decodes characters from `[begin, end)` into `out`, until either of them runs out.
+    // Advances `begin` past the decoded characters, and returns the amount of characters written.
+    // The results are the same as repeatedly calling `Decode`, but the ASCII runs are copied directly.
+    inline std::size_t DecodeToUtf32(const char *&begin, const char *end, std::span<Char> out)
+    {
+        std::size_t count = 0;
+        while (begin != end && count < out.size())
+        {
+            const char *ascii_end = SkipAscii(begin, begin + std::min(std::size_t(end - begin), out.size() - count));
+            while (begin != ascii_end)
+                out[count++] = (unsigned char)*begin++;
+
+            if (begin == end || count == out.size())
+                break;
+
+            out[count++] = Decode(begin, end, &begin);
+        }
+        return count;
+    }
+
 
     class Iterator
     {